@@ -7,6 +7,7 @@ project("xenia-app")
   language("C++")
   links({
     "xenia-apu",
+    "xenia-apu-headless",
     "xenia-apu-nop",
     "xenia-base",
     "xenia-core",
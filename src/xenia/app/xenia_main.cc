@@ -36,6 +36,7 @@
 #include "xenia/vfs/devices/host_path_device.h"
 
 // Available audio systems:
+#include "xenia/apu/headless/headless_audio_system.h"
 #include "xenia/apu/nop/nop_audio_system.h"
 #if !XE_PLATFORM_ANDROID
 #include "xenia/apu/sdl/sdl_audio_system.h"
@@ -63,7 +64,8 @@
 
 #include "third_party/fmt/include/fmt/format.h"
 
-DEFINE_string(apu, "any", "Audio system. Use: [any, nop, sdl, xaudio2]", "APU");
+DEFINE_string(apu, "any",
+              "Audio system. Use: [any, headless, nop, sdl, xaudio2]", "APU");
 DEFINE_string(gpu, "any", "Graphics system. Use: [any, d3d12, vulkan, null]",
               "GPU");
 DEFINE_string(hid, "any", "Input system. Use: [any, nop, sdl, winkey, xinput]",
@@ -266,6 +268,8 @@ std::unique_ptr<apu::AudioSystem> EmulatorApp::CreateAudioSystem(
   factory.Add<apu::sdl::SDLAudioSystem>("sdl");
 #endif  // !XE_PLATFORM_ANDROID
   factory.Add<apu::nop::NopAudioSystem>("nop");
+  // Never picked for "any" as nop is always available before it.
+  factory.Add<apu::headless::HeadlessAudioSystem>("headless");
   return factory.Create(cvars::apu, processor);
 }
 
@@ -10,23 +10,33 @@
 #ifndef XENIA_APU_CONVERSION_H_
 #define XENIA_APU_CONVERSION_H_
 
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
 
+#include "xenia/base/assert.h"
 #include "xenia/base/byte_order.h"
+#include "xenia/base/math.h"
 #include "xenia/base/platform.h"
 
+#if XE_ARCH_ARM64
+#include <arm_neon.h>
+#endif
+
 namespace xe {
 namespace apu {
 namespace conversion {
 
-#if XE_ARCH_AMD64
+// The _generic_ versions are the reference the vector versions must match bit
+// for bit, and are also used for sample counts the vector versions don't
+// handle.
 
 XE_NOINLINE
 static void _generic_sequential_6_BE_to_interleaved_6_LE(
     float* XE_RESTRICT output, const float* XE_RESTRICT input,
-    unsigned ch_sample_count) {
-  for (unsigned sample = 0; sample < ch_sample_count; sample++) {
-    for (unsigned channel = 0; channel < 6; channel++) {
+    size_t ch_sample_count) {
+  for (size_t sample = 0; sample < ch_sample_count; sample++) {
+    for (size_t channel = 0; channel < 6; channel++) {
       unsigned int value = *reinterpret_cast<const unsigned int*>(
           &input[channel * ch_sample_count + sample]);
 
@@ -35,40 +45,160 @@ static void _generic_sequential_6_BE_to_interleaved_6_LE(
     }
   }
 }
-#if XE_COMPILER_CLANG_CL != 1
-// load_be_u32 unavailable on clang-cl
+
 XE_NOINLINE
-static void _movbe_sequential_6_BE_to_interleaved_6_LE(
+static void _generic_sequential_6_BE_to_interleaved_2_LE(
     float* XE_RESTRICT output, const float* XE_RESTRICT input,
-    unsigned ch_sample_count) {
-  for (unsigned sample = 0; sample < ch_sample_count; sample++) {
-    for (unsigned channel = 0; channel < 6; channel++) {
-      *reinterpret_cast<unsigned int*>(&output[sample * 6 + channel]) =
-          _load_be_u32(reinterpret_cast<const unsigned int*>(
-              &input[channel * ch_sample_count + sample]));
+    size_t ch_sample_count) {
+  // Default 5.1 channel mapping is fl, fr, fc, lf, bl, br
+  // https://docs.microsoft.com/en-us/windows/win32/xaudio2/xaudio2-default-channel-mapping
+  for (size_t sample = 0; sample < ch_sample_count; sample++) {
+    // put center on left and right, discard low frequency
+    float fl = xe::byte_swap(input[0 * ch_sample_count + sample]);
+    float fr = xe::byte_swap(input[1 * ch_sample_count + sample]);
+    float fc = xe::byte_swap(input[2 * ch_sample_count + sample]);
+    float bl = xe::byte_swap(input[4 * ch_sample_count + sample]);
+    float br = xe::byte_swap(input[5 * ch_sample_count + sample]);
+    float center_halved = fc * 0.5f;
+    output[sample * 2] = (fl + bl + center_halved) * (1.0f / 2.5f);
+    output[sample * 2 + 1] = (fr + br + center_halved) * (1.0f / 2.5f);
+  }
+}
+
+// Scales a [-1, 1] sample to a signed 16-bit one, rounding to the nearest even
+// and saturating. NaN becomes the minimum, as with minps followed by cvtps2dq
+// returning the integer indefinite value.
+XE_FORCEINLINE static int16_t _generic_float_to_S16(float sample) {
+  return int16_t(std::nearbyint(
+      xe::clamp_float(sample * 32767.0f, -32768.0f, 32767.0f)));
+}
+
+XE_NOINLINE
+static void _generic_planar_1_to_interleaved_1_S16_BE(
+    int16_t* XE_RESTRICT output, const float* XE_RESTRICT input,
+    size_t ch_sample_count) {
+  for (size_t sample = 0; sample < ch_sample_count; sample++) {
+    output[sample] = xe::byte_swap(_generic_float_to_S16(input[sample]));
+  }
+}
+
+XE_NOINLINE
+static void _generic_planar_2_to_interleaved_2_S16_BE(
+    int16_t* XE_RESTRICT output, const float* XE_RESTRICT input_0,
+    const float* XE_RESTRICT input_1, size_t ch_sample_count) {
+  for (size_t sample = 0; sample < ch_sample_count; sample++) {
+    output[sample * 2] = xe::byte_swap(_generic_float_to_S16(input_0[sample]));
+    output[sample * 2 + 1] =
+        xe::byte_swap(_generic_float_to_S16(input_1[sample]));
+  }
+}
+
+#if XE_ARCH_AMD64
+
+// The AVX2 versions are only called after checking kX64EmitAVX2, so they're
+// built for it regardless of the instruction set of the rest of the code.
+#if XE_COMPILER_HAS_GNU_EXTENSIONS == 1
+#define XE_APU_CONVERSION_AVX2 __attribute__((target("avx2")))
+#else
+#define XE_APU_CONVERSION_AVX2
+#endif
+
+// 4 samples of each of the 6 channels, already byte swapped, to 24
+// interleaved samples in out[0...5].
+#define XE_APU_CONVERSION_TRANSPOSE_6(in, out, unpacklo, unpackhi, shuffle) \
+  {                                                                          \
+    auto c01_lo = unpacklo(in[0], in[1]);                                    \
+    auto c01_hi = unpackhi(in[0], in[1]);                                    \
+    auto c23_lo = unpacklo(in[2], in[3]);                                    \
+    auto c23_hi = unpackhi(in[2], in[3]);                                    \
+    auto c45_lo = unpacklo(in[4], in[5]);                                    \
+    auto c45_hi = unpackhi(in[4], in[5]);                                    \
+    out[0] = shuffle(c01_lo, c23_lo, _MM_SHUFFLE(1, 0, 1, 0));               \
+    out[1] = shuffle(c45_lo, c01_lo, _MM_SHUFFLE(3, 2, 1, 0));               \
+    out[2] = shuffle(c23_lo, c45_lo, _MM_SHUFFLE(3, 2, 3, 2));               \
+    out[3] = shuffle(c01_hi, c23_hi, _MM_SHUFFLE(1, 0, 1, 0));               \
+    out[4] = shuffle(c45_hi, c01_hi, _MM_SHUFFLE(3, 2, 1, 0));               \
+    out[5] = shuffle(c23_hi, c45_hi, _MM_SHUFFLE(3, 2, 3, 2));               \
+  }
+
+XE_NOINLINE
+static void _sse_sequential_6_BE_to_interleaved_6_LE(
+    float* XE_RESTRICT output, const float* XE_RESTRICT input,
+    size_t ch_sample_count) {
+  assert_true(ch_sample_count % 4 == 0);
+  const __m128i byte_swap_shuffle =
+      _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+  for (size_t sample = 0; sample < ch_sample_count; sample += 4) {
+    __m128 in[6], out[6];
+    for (size_t channel = 0; channel < 6; channel++) {
+      in[channel] = _mm_castsi128_ps(_mm_shuffle_epi8(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+              &input[channel * ch_sample_count + sample])),
+          byte_swap_shuffle));
+    }
+    XE_APU_CONVERSION_TRANSPOSE_6(in, out, _mm_unpacklo_ps, _mm_unpackhi_ps,
+                                  _mm_shuffle_ps);
+    for (size_t i = 0; i < 6; i++) {
+      _mm_storeu_ps(&output[sample * 6 + i * 4], out[i]);
     }
   }
 }
 
+XE_FORCEINLINE XE_APU_CONVERSION_AVX2 static __m256
+_avx2_load_f32x8_BE(const float* input) {
+  const __m256i byte_swap_shuffle = _mm256_set_epi8(
+      12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3, 12, 13, 14, 15, 8,
+      9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+  return _mm256_castsi256_ps(_mm256_shuffle_epi8(
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input)),
+      byte_swap_shuffle));
+}
+
+XE_NOINLINE XE_APU_CONVERSION_AVX2 static void
+_avx2_sequential_6_BE_to_interleaved_6_LE(float* XE_RESTRICT output,
+                                          const float* XE_RESTRICT input,
+                                          size_t ch_sample_count) {
+  assert_true(ch_sample_count % 8 == 0);
+  for (size_t sample = 0; sample < ch_sample_count; sample += 8) {
+    __m256 in[6], out[6];
+    for (size_t channel = 0; channel < 6; channel++) {
+      in[channel] =
+          _avx2_load_f32x8_BE(&input[channel * ch_sample_count + sample]);
+    }
+    // Samples 0...3 are transposed in the lower halves, 4...7 in the upper.
+    XE_APU_CONVERSION_TRANSPOSE_6(in, out, _mm256_unpacklo_ps,
+                                  _mm256_unpackhi_ps, _mm256_shuffle_ps);
+    float* sample_output = &output[sample * 6];
+    for (size_t i = 0; i < 3; i++) {
+      _mm256_storeu_ps(
+          sample_output + i * 8,
+          _mm256_permute2f128_ps(out[i * 2], out[i * 2 + 1], 0x20));
+      _mm256_storeu_ps(
+          sample_output + 24 + i * 8,
+          _mm256_permute2f128_ps(out[i * 2], out[i * 2 + 1], 0x31));
+    }
+  }
+}
+
+#undef XE_APU_CONVERSION_TRANSPOSE_6
+
 inline static void sequential_6_BE_to_interleaved_6_LE(
-    float* output, const float* input, unsigned ch_sample_count) {
-  if (amd64::GetFeatureFlags() & amd64::kX64EmitMovbe) {
-    _movbe_sequential_6_BE_to_interleaved_6_LE(output, input, ch_sample_count);
+    float* output, const float* input, size_t ch_sample_count) {
+  if ((amd64::GetFeatureFlags() & amd64::kX64EmitAVX2) &&
+      ch_sample_count % 8 == 0) {
+    _avx2_sequential_6_BE_to_interleaved_6_LE(output, input, ch_sample_count);
+  } else if (ch_sample_count % 4 == 0) {
+    _sse_sequential_6_BE_to_interleaved_6_LE(output, input, ch_sample_count);
   } else {
     _generic_sequential_6_BE_to_interleaved_6_LE(output, input,
                                                  ch_sample_count);
   }
 }
-#else
-inline static void sequential_6_BE_to_interleaved_6_LE(
-    float* output, const float* input, unsigned ch_sample_count) {
-  _generic_sequential_6_BE_to_interleaved_6_LE(output, input, ch_sample_count);
-}
-#endif
 
-inline void sequential_6_BE_to_interleaved_2_LE(float* output,
-                                                const float* input,
-                                                size_t ch_sample_count) {
+XE_NOINLINE
+static void _sse_sequential_6_BE_to_interleaved_2_LE(
+    float* XE_RESTRICT output, const float* XE_RESTRICT input,
+    size_t ch_sample_count) {
   assert_true(ch_sample_count % 4 == 0);
   const __m128i byte_swap_shuffle =
       _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
@@ -104,34 +234,342 @@ inline void sequential_6_BE_to_interleaved_2_LE(float* output,
     _mm_storeu_ps(&output[(sample + 2) * 2], _mm_unpackhi_ps(left, right));
   }
 }
-#else
-inline void sequential_6_BE_to_interleaved_6_LE(float* output,
-                                                const float* input,
-                                                size_t ch_sample_count) {
-  for (size_t sample = 0; sample < ch_sample_count; sample++) {
+
+XE_NOINLINE XE_APU_CONVERSION_AVX2 static void
+_avx2_sequential_6_BE_to_interleaved_2_LE(float* XE_RESTRICT output,
+                                          const float* XE_RESTRICT input,
+                                          size_t ch_sample_count) {
+  assert_true(ch_sample_count % 8 == 0);
+  const __m256 half = _mm256_set1_ps(0.5f);
+  const __m256 two_fifths = _mm256_set1_ps(1.0f / 2.5f);
+
+  for (size_t sample = 0; sample < ch_sample_count; sample += 8) {
+    __m256 fl = _avx2_load_f32x8_BE(&input[0 * ch_sample_count + sample]);
+    __m256 fr = _avx2_load_f32x8_BE(&input[1 * ch_sample_count + sample]);
+    __m256 fc = _avx2_load_f32x8_BE(&input[2 * ch_sample_count + sample]);
+    __m256 bl = _avx2_load_f32x8_BE(&input[4 * ch_sample_count + sample]);
+    __m256 br = _avx2_load_f32x8_BE(&input[5 * ch_sample_count + sample]);
+
+    __m256 center_halved = _mm256_mul_ps(fc, half);
+    __m256 left = _mm256_add_ps(_mm256_add_ps(fl, bl), center_halved);
+    __m256 right = _mm256_add_ps(_mm256_add_ps(fr, br), center_halved);
+    left = _mm256_mul_ps(left, two_fifths);
+    right = _mm256_mul_ps(right, two_fifths);
+    // Samples 0, 1, 4, 5 and 2, 3, 6, 7.
+    __m256 lr_lo = _mm256_unpacklo_ps(left, right);
+    __m256 lr_hi = _mm256_unpackhi_ps(left, right);
+    _mm256_storeu_ps(&output[sample * 2],
+                     _mm256_permute2f128_ps(lr_lo, lr_hi, 0x20));
+    _mm256_storeu_ps(&output[(sample + 4) * 2],
+                     _mm256_permute2f128_ps(lr_lo, lr_hi, 0x31));
+  }
+}
+
+inline static void sequential_6_BE_to_interleaved_2_LE(
+    float* output, const float* input, size_t ch_sample_count) {
+  if ((amd64::GetFeatureFlags() & amd64::kX64EmitAVX2) &&
+      ch_sample_count % 8 == 0) {
+    _avx2_sequential_6_BE_to_interleaved_2_LE(output, input, ch_sample_count);
+  } else if (ch_sample_count % 4 == 0) {
+    _sse_sequential_6_BE_to_interleaved_2_LE(output, input, ch_sample_count);
+  } else {
+    _generic_sequential_6_BE_to_interleaved_2_LE(output, input,
+                                                 ch_sample_count);
+  }
+}
+
+// For the conversions to signed 16-bit, minps with the maximum as the first
+// operand saturates positive values and passes NaN through, and cvtps2dq
+// converts NaN and large negative values to the integer indefinite value, which
+// packssdw saturates to the minimum.
+
+XE_NOINLINE
+static void _sse_planar_1_to_interleaved_1_S16_BE(
+    int16_t* XE_RESTRICT output, const float* XE_RESTRICT input,
+    size_t ch_sample_count) {
+  assert_true(ch_sample_count % 8 == 0);
+  const __m128 scale = _mm_set1_ps(32767.0f);
+  const __m128 max = _mm_set1_ps(32767.0f);
+  const __m128i byte_swap_shuffle =
+      _mm_set_epi8(14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1);
+  for (size_t sample = 0; sample < ch_sample_count; sample += 8) {
+    __m128i in_0 = _mm_cvtps_epi32(
+        _mm_min_ps(max, _mm_mul_ps(_mm_loadu_ps(&input[sample]), scale)));
+    __m128i in_1 = _mm_cvtps_epi32(
+        _mm_min_ps(max, _mm_mul_ps(_mm_loadu_ps(&input[sample + 4]), scale)));
+    __m128i out = _mm_shuffle_epi8(_mm_packs_epi32(in_0, in_1),
+                                   byte_swap_shuffle);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&output[sample]), out);
+  }
+}
+
+XE_NOINLINE XE_APU_CONVERSION_AVX2 static void
+_avx2_planar_1_to_interleaved_1_S16_BE(int16_t* XE_RESTRICT output,
+                                       const float* XE_RESTRICT input,
+                                       size_t ch_sample_count) {
+  assert_true(ch_sample_count % 16 == 0);
+  const __m256 scale = _mm256_set1_ps(32767.0f);
+  const __m256 max = _mm256_set1_ps(32767.0f);
+  const __m256i byte_swap_shuffle = _mm256_set_epi8(
+      14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1, 14, 15, 12, 13, 10,
+      11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1);
+  for (size_t sample = 0; sample < ch_sample_count; sample += 16) {
+    __m256i in_0 = _mm256_cvtps_epi32(_mm256_min_ps(
+        max, _mm256_mul_ps(_mm256_loadu_ps(&input[sample]), scale)));
+    __m256i in_1 = _mm256_cvtps_epi32(_mm256_min_ps(
+        max, _mm256_mul_ps(_mm256_loadu_ps(&input[sample + 8]), scale)));
+    // Packing is done within the halves, giving samples 0...3, 8...11,
+    // 4...7, 12...15.
+    __m256i out = _mm256_permute4x64_epi64(_mm256_packs_epi32(in_0, in_1),
+                                           _MM_SHUFFLE(3, 1, 2, 0));
+    out = _mm256_shuffle_epi8(out, byte_swap_shuffle);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(&output[sample]), out);
+  }
+}
+
+inline static void planar_1_to_interleaved_1_S16_BE(int16_t* output,
+                                                    const float* input,
+                                                    size_t ch_sample_count) {
+  if ((amd64::GetFeatureFlags() & amd64::kX64EmitAVX2) &&
+      ch_sample_count % 16 == 0) {
+    _avx2_planar_1_to_interleaved_1_S16_BE(output, input, ch_sample_count);
+  } else if (ch_sample_count % 8 == 0) {
+    _sse_planar_1_to_interleaved_1_S16_BE(output, input, ch_sample_count);
+  } else {
+    _generic_planar_1_to_interleaved_1_S16_BE(output, input, ch_sample_count);
+  }
+}
+
+XE_NOINLINE
+static void _sse_planar_2_to_interleaved_2_S16_BE(
+    int16_t* XE_RESTRICT output, const float* XE_RESTRICT input_0,
+    const float* XE_RESTRICT input_1, size_t ch_sample_count) {
+  assert_true(ch_sample_count % 4 == 0);
+  const __m128 scale = _mm_set1_ps(32767.0f);
+  const __m128 max = _mm_set1_ps(32767.0f);
+  // Interleaves the channels and byte swaps.
+  const __m128i shuffle =
+      _mm_set_epi8(14, 15, 6, 7, 12, 13, 4, 5, 10, 11, 2, 3, 8, 9, 0, 1);
+  for (size_t sample = 0; sample < ch_sample_count; sample += 4) {
+    __m128i in_0 = _mm_cvtps_epi32(
+        _mm_min_ps(max, _mm_mul_ps(_mm_loadu_ps(&input_0[sample]), scale)));
+    __m128i in_1 = _mm_cvtps_epi32(
+        _mm_min_ps(max, _mm_mul_ps(_mm_loadu_ps(&input_1[sample]), scale)));
+    __m128i out = _mm_shuffle_epi8(_mm_packs_epi32(in_0, in_1), shuffle);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&output[sample * 2]), out);
+  }
+}
+
+XE_NOINLINE XE_APU_CONVERSION_AVX2 static void
+_avx2_planar_2_to_interleaved_2_S16_BE(int16_t* XE_RESTRICT output,
+                                       const float* XE_RESTRICT input_0,
+                                       const float* XE_RESTRICT input_1,
+                                       size_t ch_sample_count) {
+  assert_true(ch_sample_count % 8 == 0);
+  const __m256 scale = _mm256_set1_ps(32767.0f);
+  const __m256 max = _mm256_set1_ps(32767.0f);
+  // Packing is done within the halves, so the same interleaving as in the SSE
+  // version gives samples 0...3 in the lower half and 4...7 in the upper.
+  const __m256i shuffle = _mm256_set_epi8(
+      14, 15, 6, 7, 12, 13, 4, 5, 10, 11, 2, 3, 8, 9, 0, 1, 14, 15, 6, 7, 12,
+      13, 4, 5, 10, 11, 2, 3, 8, 9, 0, 1);
+  for (size_t sample = 0; sample < ch_sample_count; sample += 8) {
+    __m256i in_0 = _mm256_cvtps_epi32(_mm256_min_ps(
+        max, _mm256_mul_ps(_mm256_loadu_ps(&input_0[sample]), scale)));
+    __m256i in_1 = _mm256_cvtps_epi32(_mm256_min_ps(
+        max, _mm256_mul_ps(_mm256_loadu_ps(&input_1[sample]), scale)));
+    __m256i out =
+        _mm256_shuffle_epi8(_mm256_packs_epi32(in_0, in_1), shuffle);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(&output[sample * 2]), out);
+  }
+}
+
+inline static void planar_2_to_interleaved_2_S16_BE(int16_t* output,
+                                                    const float* input_0,
+                                                    const float* input_1,
+                                                    size_t ch_sample_count) {
+  if ((amd64::GetFeatureFlags() & amd64::kX64EmitAVX2) &&
+      ch_sample_count % 8 == 0) {
+    _avx2_planar_2_to_interleaved_2_S16_BE(output, input_0, input_1,
+                                           ch_sample_count);
+  } else if (ch_sample_count % 4 == 0) {
+    _sse_planar_2_to_interleaved_2_S16_BE(output, input_0, input_1,
+                                          ch_sample_count);
+  } else {
+    _generic_planar_2_to_interleaved_2_S16_BE(output, input_0, input_1,
+                                              ch_sample_count);
+  }
+}
+
+#undef XE_APU_CONVERSION_AVX2
+
+#elif XE_ARCH_ARM64
+
+XE_FORCEINLINE static float32x4_t _neon_load_f32_BE(const float* input) {
+  return vreinterpretq_f32_u8(
+      vrev32q_u8(vld1q_u8(reinterpret_cast<const uint8_t*>(input))));
+}
+
+XE_NOINLINE
+static void _neon_sequential_6_BE_to_interleaved_6_LE(
+    float* XE_RESTRICT output, const float* XE_RESTRICT input,
+    size_t ch_sample_count) {
+  assert_true(ch_sample_count % 4 == 0);
+  for (size_t sample = 0; sample < ch_sample_count; sample += 4) {
+    float32x4_t in[6];
     for (size_t channel = 0; channel < 6; channel++) {
-      output[sample * 6 + channel] =
-          xe::byte_swap(input[channel * ch_sample_count + sample]);
+      in[channel] =
+          _neon_load_f32_BE(&input[channel * ch_sample_count + sample]);
     }
+    float32x4_t c01_lo = vzip1q_f32(in[0], in[1]);
+    float32x4_t c01_hi = vzip2q_f32(in[0], in[1]);
+    float32x4_t c23_lo = vzip1q_f32(in[2], in[3]);
+    float32x4_t c23_hi = vzip2q_f32(in[2], in[3]);
+    float32x4_t c45_lo = vzip1q_f32(in[4], in[5]);
+    float32x4_t c45_hi = vzip2q_f32(in[4], in[5]);
+    float* sample_output = &output[sample * 6];
+    vst1q_f32(sample_output,
+              vcombine_f32(vget_low_f32(c01_lo), vget_low_f32(c23_lo)));
+    vst1q_f32(sample_output + 4,
+              vcombine_f32(vget_low_f32(c45_lo), vget_high_f32(c01_lo)));
+    vst1q_f32(sample_output + 8,
+              vcombine_f32(vget_high_f32(c23_lo), vget_high_f32(c45_lo)));
+    vst1q_f32(sample_output + 12,
+              vcombine_f32(vget_low_f32(c01_hi), vget_low_f32(c23_hi)));
+    vst1q_f32(sample_output + 16,
+              vcombine_f32(vget_low_f32(c45_hi), vget_high_f32(c01_hi)));
+    vst1q_f32(sample_output + 20,
+              vcombine_f32(vget_high_f32(c23_hi), vget_high_f32(c45_hi)));
   }
 }
-inline void sequential_6_BE_to_interleaved_2_LE(float* output,
-                                                const float* input,
-                                                size_t ch_sample_count) {
-  // Default 5.1 channel mapping is fl, fr, fc, lf, bl, br
-  // https://docs.microsoft.com/en-us/windows/win32/xaudio2/xaudio2-default-channel-mapping
-  for (size_t sample = 0; sample < ch_sample_count; sample++) {
-    // put center on left and right, discard low frequency
-    float fl = xe::byte_swap(input[0 * ch_sample_count + sample]);
-    float fr = xe::byte_swap(input[1 * ch_sample_count + sample]);
-    float fc = xe::byte_swap(input[2 * ch_sample_count + sample]);
-    float br = xe::byte_swap(input[4 * ch_sample_count + sample]);
-    float bl = xe::byte_swap(input[5 * ch_sample_count + sample]);
-    float center_halved = fc * 0.5f;
-    output[sample * 2] = (fl + bl + center_halved) * (1.0f / 2.5f);
-    output[sample * 2 + 1] = (fr + br + center_halved) * (1.0f / 2.5f);
+
+inline static void sequential_6_BE_to_interleaved_6_LE(
+    float* output, const float* input, size_t ch_sample_count) {
+  if (ch_sample_count % 4 == 0) {
+    _neon_sequential_6_BE_to_interleaved_6_LE(output, input, ch_sample_count);
+  } else {
+    _generic_sequential_6_BE_to_interleaved_6_LE(output, input,
+                                                 ch_sample_count);
+  }
+}
+
+XE_NOINLINE
+static void _neon_sequential_6_BE_to_interleaved_2_LE(
+    float* XE_RESTRICT output, const float* XE_RESTRICT input,
+    size_t ch_sample_count) {
+  assert_true(ch_sample_count % 4 == 0);
+  for (size_t sample = 0; sample < ch_sample_count; sample += 4) {
+    float32x4_t fl = _neon_load_f32_BE(&input[0 * ch_sample_count + sample]);
+    float32x4_t fr = _neon_load_f32_BE(&input[1 * ch_sample_count + sample]);
+    float32x4_t fc = _neon_load_f32_BE(&input[2 * ch_sample_count + sample]);
+    float32x4_t bl = _neon_load_f32_BE(&input[4 * ch_sample_count + sample]);
+    float32x4_t br = _neon_load_f32_BE(&input[5 * ch_sample_count + sample]);
+    // Separate multiplications and additions, not fused, to match the scalar
+    // version.
+    float32x4_t center_halved = vmulq_n_f32(fc, 0.5f);
+    float32x4x2_t left_right;
+    left_right.val[0] = vmulq_n_f32(
+        vaddq_f32(vaddq_f32(fl, bl), center_halved), 1.0f / 2.5f);
+    left_right.val[1] = vmulq_n_f32(
+        vaddq_f32(vaddq_f32(fr, br), center_halved), 1.0f / 2.5f);
+    vst2q_f32(&output[sample * 2], left_right);
+  }
+}
+
+inline static void sequential_6_BE_to_interleaved_2_LE(
+    float* output, const float* input, size_t ch_sample_count) {
+  if (ch_sample_count % 4 == 0) {
+    _neon_sequential_6_BE_to_interleaved_2_LE(output, input, ch_sample_count);
+  } else {
+    _generic_sequential_6_BE_to_interleaved_2_LE(output, input,
+                                                 ch_sample_count);
+  }
+}
+
+// For the conversions to signed 16-bit, fmaxnm replaces NaN with the minimum,
+// and fcvtns and sqxtn saturate.
+XE_FORCEINLINE static int16x8_t _neon_float_to_S16_BE(const float* input) {
+  const float32x4_t min = vdupq_n_f32(-32768.0f);
+  int32x4_t in_0 = vcvtnq_s32_f32(
+      vmaxnmq_f32(vmulq_n_f32(vld1q_f32(input), 32767.0f), min));
+  int32x4_t in_1 = vcvtnq_s32_f32(
+      vmaxnmq_f32(vmulq_n_f32(vld1q_f32(input + 4), 32767.0f), min));
+  return vreinterpretq_s16_u8(vrev16q_u8(vreinterpretq_u8_s16(
+      vcombine_s16(vqmovn_s32(in_0), vqmovn_s32(in_1)))));
+}
+
+XE_NOINLINE
+static void _neon_planar_1_to_interleaved_1_S16_BE(
+    int16_t* XE_RESTRICT output, const float* XE_RESTRICT input,
+    size_t ch_sample_count) {
+  assert_true(ch_sample_count % 8 == 0);
+  for (size_t sample = 0; sample < ch_sample_count; sample += 8) {
+    vst1q_s16(&output[sample], _neon_float_to_S16_BE(&input[sample]));
+  }
+}
+
+inline static void planar_1_to_interleaved_1_S16_BE(int16_t* output,
+                                                    const float* input,
+                                                    size_t ch_sample_count) {
+  if (ch_sample_count % 8 == 0) {
+    _neon_planar_1_to_interleaved_1_S16_BE(output, input, ch_sample_count);
+  } else {
+    _generic_planar_1_to_interleaved_1_S16_BE(output, input, ch_sample_count);
   }
 }
+
+XE_NOINLINE
+static void _neon_planar_2_to_interleaved_2_S16_BE(
+    int16_t* XE_RESTRICT output, const float* XE_RESTRICT input_0,
+    const float* XE_RESTRICT input_1, size_t ch_sample_count) {
+  assert_true(ch_sample_count % 8 == 0);
+  for (size_t sample = 0; sample < ch_sample_count; sample += 8) {
+    int16x8x2_t out;
+    out.val[0] = _neon_float_to_S16_BE(&input_0[sample]);
+    out.val[1] = _neon_float_to_S16_BE(&input_1[sample]);
+    vst2q_s16(&output[sample * 2], out);
+  }
+}
+
+inline static void planar_2_to_interleaved_2_S16_BE(int16_t* output,
+                                                    const float* input_0,
+                                                    const float* input_1,
+                                                    size_t ch_sample_count) {
+  if (ch_sample_count % 8 == 0) {
+    _neon_planar_2_to_interleaved_2_S16_BE(output, input_0, input_1,
+                                           ch_sample_count);
+  } else {
+    _generic_planar_2_to_interleaved_2_S16_BE(output, input_0, input_1,
+                                              ch_sample_count);
+  }
+}
+
+#else
+
+inline static void sequential_6_BE_to_interleaved_6_LE(
+    float* output, const float* input, size_t ch_sample_count) {
+  _generic_sequential_6_BE_to_interleaved_6_LE(output, input, ch_sample_count);
+}
+
+inline static void sequential_6_BE_to_interleaved_2_LE(
+    float* output, const float* input, size_t ch_sample_count) {
+  _generic_sequential_6_BE_to_interleaved_2_LE(output, input, ch_sample_count);
+}
+
+inline static void planar_1_to_interleaved_1_S16_BE(int16_t* output,
+                                                    const float* input,
+                                                    size_t ch_sample_count) {
+  _generic_planar_1_to_interleaved_1_S16_BE(output, input, ch_sample_count);
+}
+
+inline static void planar_2_to_interleaved_2_S16_BE(int16_t* output,
+                                                    const float* input_0,
+                                                    const float* input_1,
+                                                    size_t ch_sample_count) {
+  _generic_planar_2_to_interleaved_2_S16_BE(output, input_0, input_1,
+                                            ch_sample_count);
+}
+
 #endif
 
 }  // namespace conversion
@@ -0,0 +1,273 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/apu/headless/headless_audio_driver.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "xenia/apu/apu_flags.h"
+#include "xenia/apu/conversion.h"
+#include "xenia/base/assert.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/profiling.h"
+#include "xenia/base/string.h"
+
+namespace xe {
+namespace apu {
+namespace headless {
+
+// Frames the consumer may fall behind the virtual clock before the clock is
+// reset rather than catching up, which would make frames due in a burst.
+constexpr uint32_t kMaxLagFrames = 8;
+
+HeadlessAudioDriver::HeadlessAudioDriver(Memory* memory,
+                                         xe::threading::Semaphore* semaphore,
+                                         const std::filesystem::path& wav_path,
+                                         double clock_rate)
+    : AudioDriver(memory),
+      semaphore_(semaphore),
+      wav_path_(wav_path),
+      clock_rate_(std::max(clock_rate, 0.0)) {}
+
+HeadlessAudioDriver::~HeadlessAudioDriver() {
+  assert_true(frames_queued_.empty());
+  assert_true(frames_unused_.empty());
+}
+
+bool HeadlessAudioDriver::Initialize() {
+  if (!wav_path_.empty() && !OpenWav()) {
+    XELOGE("Failed to open {} for writing audio", xe::path_to_utf8(wav_path_));
+    return false;
+  }
+
+  start_time_ = std::chrono::steady_clock::now();
+  running_ = true;
+  consumer_thread_ =
+      xe::threading::Thread::Create({}, [this]() { ConsumerThreadMain(); });
+  if (!consumer_thread_) {
+    running_ = false;
+    return false;
+  }
+  consumer_thread_->set_name("Headless Audio");
+  return true;
+}
+
+void HeadlessAudioDriver::SubmitFrame(uint32_t frame_ptr) {
+  const auto input_frame = memory_->TranslateVirtual<float*>(frame_ptr);
+  auto submit_time = std::chrono::steady_clock::now();
+  float* output_frame;
+  {
+    std::unique_lock<std::mutex> guard(frames_mutex_);
+    if (frames_unused_.empty()) {
+      output_frame = new float[frame_samples_];
+    } else {
+      output_frame = frames_unused_.top();
+      frames_unused_.pop();
+    }
+  }
+
+  std::memcpy(output_frame, input_frame, frame_size_);
+
+  {
+    std::unique_lock<std::mutex> guard(frames_mutex_);
+    if (statistics_.frames_submitted) {
+      double interval = std::chrono::duration<double, std::milli>(
+                            submit_time - last_submit_time_)
+                            .count();
+      statistics_.submit_interval_sum += interval;
+      statistics_.submit_interval_square_sum += interval * interval;
+      statistics_.submit_interval_max =
+          std::max(statistics_.submit_interval_max, interval);
+    }
+    last_submit_time_ = submit_time;
+    ++statistics_.frames_submitted;
+    frames_queued_.push(output_frame);
+  }
+  frames_cond_.notify_one();
+}
+
+void HeadlessAudioDriver::Shutdown() {
+  if (consumer_thread_) {
+    {
+      std::unique_lock<std::mutex> guard(frames_mutex_);
+      running_ = false;
+    }
+    frames_cond_.notify_all();
+    xe::threading::Wait(consumer_thread_.get(), false);
+    consumer_thread_.reset();
+    LogStatistics();
+  }
+  CloseWav();
+
+  std::unique_lock<std::mutex> guard(frames_mutex_);
+  while (!frames_unused_.empty()) {
+    delete[] frames_unused_.top();
+    frames_unused_.pop();
+  }
+  while (!frames_queued_.empty()) {
+    delete[] frames_queued_.front();
+    frames_queued_.pop();
+  }
+}
+
+void HeadlessAudioDriver::ConsumerThreadMain() {
+  using clock = std::chrono::steady_clock;
+  const auto period = std::chrono::duration_cast<clock::duration>(
+      std::chrono::duration<double>(double(channel_samples_) /
+                                    frame_frequency_ /
+                                    (clock_rate_ > 0.0 ? clock_rate_ : 1.0)));
+  auto due_time = clock::now() + period;
+
+  std::unique_lock<std::mutex> lock(frames_mutex_);
+  while (running_) {
+    if (clock_rate_ > 0.0) {
+      if (frames_cond_.wait_until(lock, due_time,
+                                  [this]() { return !running_; })) {
+        break;
+      }
+      auto now = clock::now();
+      if (now - due_time > period * kMaxLagFrames) {
+        due_time = now;
+        ++statistics_.clock_resets;
+      }
+      due_time += period;
+    } else {
+      frames_cond_.wait(
+          lock, [this]() { return !running_ || !frames_queued_.empty(); });
+      if (!running_) {
+        break;
+      }
+    }
+
+    if (!statistics_.frames_submitted) {
+      // The title hasn't started playing yet.
+      continue;
+    }
+    statistics_.queue_depth_sum += frames_queued_.size();
+    ++statistics_.queue_depth_samples;
+    statistics_.queue_depth_max =
+        std::max(statistics_.queue_depth_max, frames_queued_.size());
+    if (frames_queued_.empty()) {
+      ++statistics_.underruns;
+      continue;
+    }
+
+    float* frame = frames_queued_.front();
+    frames_queued_.pop();
+    ++statistics_.frames_consumed;
+    lock.unlock();
+    WriteWav(frame);
+    lock.lock();
+    frames_unused_.push(frame);
+
+    auto ret = semaphore_->Release(1, nullptr);
+    assert_true(ret);
+  }
+}
+
+void HeadlessAudioDriver::LogStatistics() {
+  std::unique_lock<std::mutex> guard(frames_mutex_);
+  const Statistics& statistics = statistics_;
+  double elapsed = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start_time_)
+                       .count();
+  double audio_seconds = double(statistics.frames_consumed) *
+                         channel_samples_ / frame_frequency_;
+  XELOGI(
+      "Headless audio: {} frames submitted, {} consumed, {:.2f} s of audio in "
+      "{:.2f} s ({:.2f}x real time)",
+      statistics.frames_submitted, statistics.frames_consumed, audio_seconds,
+      elapsed, elapsed > 0.0 ? audio_seconds / elapsed : 0.0);
+  if (statistics.frames_submitted > 1) {
+    double interval_count = double(statistics.frames_submitted - 1);
+    double interval_mean = statistics.submit_interval_sum / interval_count;
+    double interval_variance =
+        statistics.submit_interval_square_sum / interval_count -
+        interval_mean * interval_mean;
+    XELOGI(
+        "Headless audio: submit interval {:.3f} ms average, {:.3f} ms jitter "
+        "(standard deviation), {:.3f} ms max",
+        interval_mean, std::sqrt(std::max(interval_variance, 0.0)),
+        statistics.submit_interval_max);
+  }
+  if (statistics.queue_depth_samples) {
+    XELOGI(
+        "Headless audio: {:.2f} frames queued on average, {} max, {} "
+        "underruns, {} clock resets",
+        double(statistics.queue_depth_sum) / statistics.queue_depth_samples,
+        statistics.queue_depth_max, statistics.underruns,
+        statistics.clock_resets);
+  }
+}
+
+bool HeadlessAudioDriver::OpenWav() {
+  wav_file_ = xe::filesystem::OpenFile(wav_path_, "wb");
+  if (!wav_file_) {
+    return false;
+  }
+  wav_frame_ = std::make_unique<float[]>(frame_samples_);
+  wav_data_size_ = 0;
+  // Sizes are written when the file is closed.
+  uint8_t header[44] = {};
+  auto write_u16 = [&header](size_t offset, uint16_t value) {
+    std::memcpy(header + offset, &value, sizeof(value));
+  };
+  auto write_u32 = [&header](size_t offset, uint32_t value) {
+    std::memcpy(header + offset, &value, sizeof(value));
+  };
+  std::memcpy(header + 0, "RIFF", 4);
+  std::memcpy(header + 8, "WAVE", 4);
+  std::memcpy(header + 12, "fmt ", 4);
+  write_u32(16, 16);
+  // WAVE_FORMAT_IEEE_FLOAT.
+  write_u16(20, 3);
+  write_u16(22, frame_channels_);
+  write_u32(24, frame_frequency_);
+  write_u32(28, frame_frequency_ * frame_channels_ * sizeof(float));
+  write_u16(32, frame_channels_ * sizeof(float));
+  write_u16(34, 32);
+  std::memcpy(header + 36, "data", 4);
+  return fwrite(header, sizeof(header), 1, wav_file_) == 1;
+}
+
+void HeadlessAudioDriver::WriteWav(const float* frame) {
+  if (!wav_file_) {
+    return;
+  }
+  SCOPE_profile_cpu_f("apu");
+  if (cvars::mute) {
+    std::memset(wav_frame_.get(), 0, frame_size_);
+  } else {
+    conversion::sequential_6_BE_to_interleaved_6_LE(wav_frame_.get(), frame,
+                                                    channel_samples_);
+  }
+  wav_data_size_ += fwrite(wav_frame_.get(), 1, frame_size_, wav_file_);
+}
+
+void HeadlessAudioDriver::CloseWav() {
+  if (!wav_file_) {
+    return;
+  }
+  uint32_t data_size =
+      uint32_t(std::min(wav_data_size_, uint64_t(UINT32_MAX - 36)));
+  uint32_t riff_size = 36 + data_size;
+  xe::filesystem::Seek(wav_file_, 4, SEEK_SET);
+  fwrite(&riff_size, sizeof(riff_size), 1, wav_file_);
+  xe::filesystem::Seek(wav_file_, 40, SEEK_SET);
+  fwrite(&data_size, sizeof(data_size), 1, wav_file_);
+  fclose(wav_file_);
+  wav_file_ = nullptr;
+}
+
+}  // namespace headless
+}  // namespace apu
+}  // namespace xe
@@ -0,0 +1,103 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_APU_HEADLESS_HEADLESS_AUDIO_DRIVER_H_
+#define XENIA_APU_HEADLESS_HEADLESS_AUDIO_DRIVER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stack>
+
+#include "xenia/apu/audio_driver.h"
+#include "xenia/base/threading.h"
+
+namespace xe {
+namespace apu {
+namespace headless {
+
+// Consumes frames on its own thread at the pace of a virtual clock, writing
+// them to a WAV file or dropping them, and records how the frames were
+// submitted. The statistics are logged on shutdown.
+class HeadlessAudioDriver : public AudioDriver {
+ public:
+  // An empty wav_path drops the frames. A clock_rate of 0 consumes frames as
+  // soon as they're submitted instead of pacing them.
+  HeadlessAudioDriver(Memory* memory, xe::threading::Semaphore* semaphore,
+                      const std::filesystem::path& wav_path,
+                      double clock_rate);
+  ~HeadlessAudioDriver() override;
+
+  bool Initialize();
+  void SubmitFrame(uint32_t frame_ptr) override;
+  void Shutdown();
+
+ private:
+  struct Statistics {
+    uint64_t frames_submitted = 0;
+    uint64_t frames_consumed = 0;
+    // Frames due on the virtual clock while none were queued, counted from the
+    // first submitted frame.
+    uint64_t underruns = 0;
+    // Times the virtual clock has been reset because the consumer thread fell
+    // too far behind, such as while the process was suspended.
+    uint64_t clock_resets = 0;
+    // Time between consecutive submissions.
+    double submit_interval_sum = 0.0;
+    double submit_interval_square_sum = 0.0;
+    double submit_interval_max = 0.0;
+    // Queued frames whenever a frame is due.
+    uint64_t queue_depth_sum = 0;
+    uint64_t queue_depth_samples = 0;
+    size_t queue_depth_max = 0;
+  };
+
+  void ConsumerThreadMain();
+  void LogStatistics();
+
+  bool OpenWav();
+  void WriteWav(const float* frame);
+  void CloseWav();
+
+  static const uint32_t frame_frequency_ = 48000;
+  static const uint32_t frame_channels_ = 6;
+  static const uint32_t channel_samples_ = 256;
+  static const uint32_t frame_samples_ = frame_channels_ * channel_samples_;
+  static const uint32_t frame_size_ = sizeof(float) * frame_samples_;
+
+  xe::threading::Semaphore* semaphore_ = nullptr;
+  std::filesystem::path wav_path_;
+  double clock_rate_;
+
+  std::unique_ptr<xe::threading::Thread> consumer_thread_;
+  bool running_ = false;
+
+  std::mutex frames_mutex_;
+  std::condition_variable frames_cond_;
+  std::queue<float*> frames_queued_;
+  std::stack<float*> frames_unused_;
+
+  FILE* wav_file_ = nullptr;
+  uint64_t wav_data_size_ = 0;
+  std::unique_ptr<float[]> wav_frame_;
+
+  std::chrono::steady_clock::time_point start_time_;
+  std::chrono::steady_clock::time_point last_submit_time_;
+  Statistics statistics_;
+};
+
+}  // namespace headless
+}  // namespace apu
+}  // namespace xe
+
+#endif  // XENIA_APU_HEADLESS_HEADLESS_AUDIO_DRIVER_H_
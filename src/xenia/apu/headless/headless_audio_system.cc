@@ -0,0 +1,76 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/apu/headless/headless_audio_system.h"
+
+#include "third_party/fmt/include/fmt/format.h"
+#include "xenia/apu/apu_flags.h"
+#include "xenia/apu/headless/headless_audio_driver.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/string.h"
+
+DEFINE_path(headless_audio_wav_path, "",
+            "WAV file the headless audio system writes the audio to, with the "
+            "client index appended for clients other than the first. The "
+            "audio is dropped if empty.",
+            "APU");
+DEFINE_double(headless_audio_clock_rate, 1.0,
+              "Speed of the virtual clock the headless audio system consumes "
+              "audio frames at, relative to real time. 0 to consume frames as "
+              "soon as they're submitted.",
+              "APU");
+
+namespace xe {
+namespace apu {
+namespace headless {
+
+std::unique_ptr<AudioSystem> HeadlessAudioSystem::Create(
+    cpu::Processor* processor) {
+  return std::make_unique<HeadlessAudioSystem>(processor);
+}
+
+HeadlessAudioSystem::HeadlessAudioSystem(cpu::Processor* processor)
+    : AudioSystem(processor) {}
+
+HeadlessAudioSystem::~HeadlessAudioSystem() = default;
+
+X_STATUS HeadlessAudioSystem::CreateDriver(size_t index,
+                                           xe::threading::Semaphore* semaphore,
+                                           AudioDriver** out_driver) {
+  assert_not_null(out_driver);
+  std::filesystem::path wav_path = cvars::headless_audio_wav_path;
+  if (!wav_path.empty() && index) {
+    wav_path.replace_filename(
+        xe::to_path(fmt::format("{}_{}", xe::path_to_utf8(wav_path.stem()),
+                                index)) +=
+        wav_path.extension());
+  }
+  auto driver = new HeadlessAudioDriver(memory_, semaphore, wav_path,
+                                        cvars::headless_audio_clock_rate);
+  if (!driver->Initialize()) {
+    driver->Shutdown();
+    delete driver;
+    return X_STATUS_UNSUCCESSFUL;
+  }
+
+  *out_driver = driver;
+  return X_STATUS_SUCCESS;
+}
+
+void HeadlessAudioSystem::DestroyDriver(AudioDriver* driver) {
+  assert_not_null(driver);
+  auto headless_driver = dynamic_cast<HeadlessAudioDriver*>(driver);
+  assert_not_null(headless_driver);
+  headless_driver->Shutdown();
+  delete headless_driver;
+}
+
+}  // namespace headless
+}  // namespace apu
+}  // namespace xe
@@ -0,0 +1,40 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_APU_HEADLESS_HEADLESS_AUDIO_SYSTEM_H_
+#define XENIA_APU_HEADLESS_HEADLESS_AUDIO_SYSTEM_H_
+
+#include "xenia/apu/audio_system.h"
+
+namespace xe {
+namespace apu {
+namespace headless {
+
+// Audio system without an output device, for running and profiling titles on
+// machines without sound hardware. Unlike the nop audio system, it accepts
+// clients and consumes their frames like a device would.
+class HeadlessAudioSystem : public AudioSystem {
+ public:
+  explicit HeadlessAudioSystem(cpu::Processor* processor);
+  ~HeadlessAudioSystem() override;
+
+  static bool IsAvailable() { return true; }
+
+  static std::unique_ptr<AudioSystem> Create(cpu::Processor* processor);
+
+  X_STATUS CreateDriver(size_t index, xe::threading::Semaphore* semaphore,
+                        AudioDriver** out_driver) override;
+  void DestroyDriver(AudioDriver* driver) override;
+};
+
+}  // namespace headless
+}  // namespace apu
+}  // namespace xe
+
+#endif  // XENIA_APU_HEADLESS_HEADLESS_AUDIO_SYSTEM_H_
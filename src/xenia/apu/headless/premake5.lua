@@ -0,0 +1,15 @@
+project_root = "../../../.."
+include(project_root.."/tools/build")
+
+group("src")
+project("xenia-apu-headless")
+  uuid("e1048085-0473-4888-976d-61a24859de94")
+  kind("StaticLib")
+  language("C++")
+  links({
+    "xenia-apu",
+    "xenia-base",
+  })
+  defines({
+  })
+  local_platform_files()
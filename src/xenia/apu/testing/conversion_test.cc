@@ -0,0 +1,327 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/apu/conversion.h"
+
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "third_party/catch/include/catch.hpp"
+#include "third_party/fmt/include/fmt/format.h"
+#include "xenia/base/math.h"
+
+namespace xe::apu::test {
+
+using namespace conversion;
+
+using Convert6Function = void (*)(float* output, const float* input,
+                                  size_t ch_sample_count);
+using Convert1Function = void (*)(int16_t* output, const float* input,
+                                  size_t ch_sample_count);
+using Convert2Function = void (*)(int16_t* output, const float* input_0,
+                                  const float* input_1,
+                                  size_t ch_sample_count);
+
+template <typename Function>
+struct Variant {
+  const char* name;
+  Function function;
+  // Sample count per channel the function requires to be a multiple of.
+  size_t sample_count_alignment;
+};
+
+static bool HasAVX2() {
+#if XE_ARCH_AMD64
+  amd64::InitFeatureFlags();
+  return (amd64::GetFeatureFlags() & amd64::kX64EmitAVX2) != 0;
+#else
+  return false;
+#endif
+}
+
+// The vector versions supported by the host, and the dispatching functions.
+static std::vector<Variant<Convert6Function>> Variants6To6() {
+  std::vector<Variant<Convert6Function>> variants;
+  variants.push_back({"dispatch", sequential_6_BE_to_interleaved_6_LE, 1});
+#if XE_ARCH_AMD64
+  variants.push_back({"sse", _sse_sequential_6_BE_to_interleaved_6_LE, 4});
+  if (HasAVX2()) {
+    variants.push_back({"avx2", _avx2_sequential_6_BE_to_interleaved_6_LE, 8});
+  }
+#elif XE_ARCH_ARM64
+  variants.push_back({"neon", _neon_sequential_6_BE_to_interleaved_6_LE, 4});
+#endif
+  return variants;
+}
+
+static std::vector<Variant<Convert6Function>> Variants6To2() {
+  std::vector<Variant<Convert6Function>> variants;
+  variants.push_back({"dispatch", sequential_6_BE_to_interleaved_2_LE, 1});
+#if XE_ARCH_AMD64
+  variants.push_back({"sse", _sse_sequential_6_BE_to_interleaved_2_LE, 4});
+  if (HasAVX2()) {
+    variants.push_back({"avx2", _avx2_sequential_6_BE_to_interleaved_2_LE, 8});
+  }
+#elif XE_ARCH_ARM64
+  variants.push_back({"neon", _neon_sequential_6_BE_to_interleaved_2_LE, 4});
+#endif
+  return variants;
+}
+
+static std::vector<Variant<Convert1Function>> Variants1ToS16() {
+  std::vector<Variant<Convert1Function>> variants;
+  variants.push_back({"dispatch", planar_1_to_interleaved_1_S16_BE, 1});
+#if XE_ARCH_AMD64
+  variants.push_back({"sse", _sse_planar_1_to_interleaved_1_S16_BE, 8});
+  if (HasAVX2()) {
+    variants.push_back({"avx2", _avx2_planar_1_to_interleaved_1_S16_BE, 16});
+  }
+#elif XE_ARCH_ARM64
+  variants.push_back({"neon", _neon_planar_1_to_interleaved_1_S16_BE, 8});
+#endif
+  return variants;
+}
+
+static std::vector<Variant<Convert2Function>> Variants2ToS16() {
+  std::vector<Variant<Convert2Function>> variants;
+  variants.push_back({"dispatch", planar_2_to_interleaved_2_S16_BE, 1});
+#if XE_ARCH_AMD64
+  variants.push_back({"sse", _sse_planar_2_to_interleaved_2_S16_BE, 4});
+  if (HasAVX2()) {
+    variants.push_back({"avx2", _avx2_planar_2_to_interleaved_2_S16_BE, 8});
+  }
+#elif XE_ARCH_ARM64
+  variants.push_back({"neon", _neon_planar_2_to_interleaved_2_S16_BE, 8});
+#endif
+  return variants;
+}
+
+// 256 is the frame size of audio clients, 512 of XMA, the rest are handled by
+// only some of the versions.
+static const size_t kSampleCounts[] = {256, 512, 4, 8, 12, 20, 24, 40, 3, 13};
+
+// Random bit patterns, including NaN with various payloads.
+static std::vector<float> RandomBits(size_t count, uint32_t seed) {
+  std::mt19937 random(seed);
+  std::vector<float> values(count);
+  for (float& value : values) {
+    uint32_t bits = uint32_t(random());
+    std::memcpy(&value, &bits, sizeof(value));
+  }
+  return values;
+}
+
+// Mostly samples in and slightly out of [-1, 1], with the special values the
+// conversion to 16-bit must handle.
+static std::vector<float> RandomSamples(size_t count, uint32_t seed) {
+  static const float kSpecialValues[] = {
+      0.0f,
+      -0.0f,
+      1.0f,
+      -1.0f,
+      1.095f,
+      -1.095f,
+      32768.0f / 32767.0f,
+      -32768.0f / 32767.0f,
+      -32768.5f / 32767.0f,
+      0.5f / 32767.0f,
+      1.5f / 32767.0f,
+      -2.5f / 32767.0f,
+      65536.0f,
+      -65536.0f,
+      3.0e9f,
+      -3.0e9f,
+      std::numeric_limits<float>::denorm_min(),
+      std::numeric_limits<float>::infinity(),
+      -std::numeric_limits<float>::infinity(),
+      std::numeric_limits<float>::quiet_NaN(),
+      -std::numeric_limits<float>::quiet_NaN(),
+  };
+  std::mt19937 random(seed);
+  std::uniform_real_distribution<float> distribution(-1.25f, 1.25f);
+  std::vector<float> values(count);
+  for (size_t i = 0; i < count; ++i) {
+    if (random() % 8 == 0) {
+      values[i] = kSpecialValues[random() % xe::countof(kSpecialValues)];
+    } else {
+      values[i] = distribution(random);
+    }
+  }
+  return values;
+}
+
+template <typename T>
+static bool BitsEqual(const std::vector<T>& a, const std::vector<T>& b) {
+  return a.size() == b.size() &&
+         !std::memcmp(a.data(), b.data(), sizeof(T) * a.size());
+}
+
+TEST_CASE("Interleave 6 big-endian channels", "[conversion]") {
+  for (size_t sample_count : kSampleCounts) {
+    std::vector<float> input = RandomBits(sample_count * 6, 1);
+    std::vector<float> expected(sample_count * 6);
+    _generic_sequential_6_BE_to_interleaved_6_LE(expected.data(),
+                                                 input.data(), sample_count);
+    // Sample 0 of channel 1 is the second in the output.
+    uint32_t input_bits, output_bits;
+    std::memcpy(&input_bits, &input[sample_count], sizeof(uint32_t));
+    std::memcpy(&output_bits, &expected[1], sizeof(uint32_t));
+    REQUIRE(output_bits == xe::byte_swap(input_bits));
+    for (const auto& variant : Variants6To6()) {
+      if (sample_count % variant.sample_count_alignment) {
+        continue;
+      }
+      INFO(variant.name << ", " << sample_count << " samples");
+      std::vector<float> output(sample_count * 6);
+      variant.function(output.data(), input.data(), sample_count);
+      REQUIRE(BitsEqual(output, expected));
+    }
+  }
+}
+
+TEST_CASE("Downmix 6 big-endian channels to 2", "[conversion]") {
+  for (size_t sample_count : kSampleCounts) {
+    // Arithmetic on NaN may give a different payload depending on the operand
+    // order the compiler picks, so only finite samples are downmixed.
+    std::vector<float> input = RandomSamples(sample_count * 6, 2);
+    for (float& sample : input) {
+      if (!std::isfinite(sample)) {
+        sample = 1.0f;
+      }
+      sample = xe::byte_swap(sample);
+    }
+    std::vector<float> expected(sample_count * 2);
+    _generic_sequential_6_BE_to_interleaved_2_LE(expected.data(),
+                                                 input.data(), sample_count);
+    for (const auto& variant : Variants6To2()) {
+      if (sample_count % variant.sample_count_alignment) {
+        continue;
+      }
+      INFO(variant.name << ", " << sample_count << " samples");
+      std::vector<float> output(sample_count * 2);
+      variant.function(output.data(), input.data(), sample_count);
+      REQUIRE(BitsEqual(output, expected));
+    }
+  }
+}
+
+TEST_CASE("Convert float samples to 16-bit big-endian", "[conversion]") {
+  REQUIRE(_generic_float_to_S16(1.0f) == 32767);
+  REQUIRE(_generic_float_to_S16(-1.0f) == -32767);
+  REQUIRE(_generic_float_to_S16(1.095f) == 32767);
+  REQUIRE(_generic_float_to_S16(-1.095f) == -32768);
+  REQUIRE(_generic_float_to_S16(3.0e9f) == 32767);
+  REQUIRE(_generic_float_to_S16(std::numeric_limits<float>::quiet_NaN()) ==
+          -32768);
+  REQUIRE(_generic_float_to_S16(0.5f / 32767.0f) == 0);
+  REQUIRE(_generic_float_to_S16(1.5f / 32767.0f) == 2);
+
+  for (size_t sample_count : kSampleCounts) {
+    std::vector<float> input_0 = RandomSamples(sample_count, 3);
+    std::vector<float> input_1 = RandomSamples(sample_count, 4);
+
+    std::vector<int16_t> expected_1(sample_count);
+    _generic_planar_1_to_interleaved_1_S16_BE(expected_1.data(),
+                                              input_0.data(), sample_count);
+    for (const auto& variant : Variants1ToS16()) {
+      if (sample_count % variant.sample_count_alignment) {
+        continue;
+      }
+      INFO(variant.name << ", 1 channel, " << sample_count << " samples");
+      std::vector<int16_t> output(sample_count);
+      variant.function(output.data(), input_0.data(), sample_count);
+      REQUIRE(BitsEqual(output, expected_1));
+    }
+
+    std::vector<int16_t> expected_2(sample_count * 2);
+    _generic_planar_2_to_interleaved_2_S16_BE(
+        expected_2.data(), input_0.data(), input_1.data(), sample_count);
+    REQUIRE(expected_2[0] == expected_1[0]);
+    for (const auto& variant : Variants2ToS16()) {
+      if (sample_count % variant.sample_count_alignment) {
+        continue;
+      }
+      INFO(variant.name << ", 2 channels, " << sample_count << " samples");
+      std::vector<int16_t> output(sample_count * 2);
+      variant.function(output.data(), input_0.data(), input_1.data(),
+                       sample_count);
+      REQUIRE(BitsEqual(output, expected_2));
+    }
+  }
+}
+
+// Not run by default. Run with the "[conversion_benchmark]" tag.
+TEST_CASE("Sample conversion performance", "[.][conversion_benchmark]") {
+  constexpr size_t kSampleCount = 512;
+  constexpr uint32_t kIterations = 200000;
+  // Samples as decoded, without the special values, some of which are slow to
+  // do arithmetic on.
+  std::vector<float> input(kSampleCount * 6);
+  std::mt19937 random(5);
+  std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+  for (float& sample : input) {
+    sample = distribution(random);
+  }
+  std::vector<float> input_be(input.size());
+  for (size_t i = 0; i < input.size(); ++i) {
+    input_be[i] = xe::byte_swap(input[i]);
+  }
+  std::vector<float> output(kSampleCount * 6);
+  std::vector<int16_t> output_s16(kSampleCount * 2);
+
+  auto benchmark = [&](const char* conversion, auto variants,
+                       auto generic_variant, auto&& convert) {
+    variants.push_back(generic_variant);
+    for (const auto& variant : variants) {
+      for (uint32_t i = 0; i < kIterations / 16; ++i) {
+        convert(variant.function);
+      }
+      auto start = std::chrono::steady_clock::now();
+      for (uint32_t i = 0; i < kIterations; ++i) {
+        convert(variant.function);
+      }
+      double seconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+      fmt::print("{} {}: {:.1f} ns per {}-sample frame\n", conversion,
+                 variant.name, seconds * 1.0e9 / kIterations, kSampleCount);
+    }
+  };
+
+  benchmark("6 to 6", Variants6To6(),
+            Variant<Convert6Function>{
+                "generic", _generic_sequential_6_BE_to_interleaved_6_LE, 1},
+            [&](Convert6Function function) {
+              function(output.data(), input_be.data(), kSampleCount);
+            });
+  benchmark("6 to 2", Variants6To2(),
+            Variant<Convert6Function>{
+                "generic", _generic_sequential_6_BE_to_interleaved_2_LE, 1},
+            [&](Convert6Function function) {
+              function(output.data(), input_be.data(), kSampleCount);
+            });
+  benchmark("1 to 16-bit", Variants1ToS16(),
+            Variant<Convert1Function>{
+                "generic", _generic_planar_1_to_interleaved_1_S16_BE, 1},
+            [&](Convert1Function function) {
+              function(output_s16.data(), input.data(), kSampleCount);
+            });
+  benchmark("2 to 16-bit", Variants2ToS16(),
+            Variant<Convert2Function>{
+                "generic", _generic_planar_2_to_interleaved_2_S16_BE, 1},
+            [&](Convert2Function function) {
+              function(output_s16.data(), input.data(),
+                       input.data() + kSampleCount, kSampleCount);
+            });
+}
+
+}  // namespace xe::apu::test
@@ -0,0 +1,105 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/apu/xma_frame_cache.h"
+
+#include <array>
+#include <cstring>
+
+#include "third_party/catch/include/catch.hpp"
+
+namespace xe::apu::test {
+
+using Frame = std::array<uint8_t, XmaFrameCache::kFrameSize>;
+
+static Frame MakeFrame(uint8_t value) {
+  Frame frame;
+  frame.fill(value);
+  return frame;
+}
+
+static XmaFrameCache::Key MakeKey(uint8_t frame, uint8_t previous_frame) {
+  uint8_t frame_data[64];
+  std::memset(frame_data, frame, sizeof(frame_data));
+  uint8_t previous_frame_data[64];
+  std::memset(previous_frame_data, previous_frame,
+              sizeof(previous_frame_data));
+  return {XmaFrameCache::HashFrame(frame_data, sizeof(frame_data)),
+          XmaFrameCache::HashFrame(previous_frame_data,
+                                   sizeof(previous_frame_data)),
+          3, 2};
+}
+
+TEST_CASE("XMA frame cache lookup", "[xma_frame_cache]") {
+  XmaFrameCache cache(16 * XmaFrameCache::kFrameSize + 4096);
+  Frame output;
+
+  REQUIRE_FALSE(cache.Find(MakeKey(1, 0), output.data()));
+  cache.Insert(MakeKey(1, 0), MakeFrame(1).data());
+  REQUIRE(cache.Find(MakeKey(1, 0), output.data()));
+  REQUIRE(output == MakeFrame(1));
+
+  // The same frame after a different one, as in the second iteration of a
+  // loop, has a different output.
+  REQUIRE_FALSE(cache.Find(MakeKey(1, 2), output.data()));
+  XmaFrameCache::Key mono_key = MakeKey(1, 0);
+  mono_key.channel_count = 1;
+  REQUIRE_FALSE(cache.Find(mono_key, output.data()));
+  XmaFrameCache::Key rate_key = MakeKey(1, 0);
+  rate_key.sample_rate = 0;
+  REQUIRE_FALSE(cache.Find(rate_key, output.data()));
+  // Frames whose hashes only share the low 64 bits are different frames.
+  XmaFrameCache::Key high_key = MakeKey(1, 0);
+  high_key.frame_hash.high64 ^= 1;
+  REQUIRE_FALSE(cache.Find(high_key, output.data()));
+  XmaFrameCache::Key previous_high_key = MakeKey(1, 0);
+  previous_high_key.previous_frame_hash.high64 ^= 1;
+  REQUIRE_FALSE(cache.Find(previous_high_key, output.data()));
+
+  auto statistics = cache.statistics();
+  REQUIRE(statistics.hits == 1);
+  REQUIRE(statistics.misses == 6);
+  REQUIRE(statistics.evictions == 0);
+
+  cache.Clear();
+  REQUIRE_FALSE(cache.Find(MakeKey(1, 0), output.data()));
+}
+
+TEST_CASE("XMA frame cache eviction", "[xma_frame_cache]") {
+  // Capacity for at least 4 but less than 5 frames.
+  XmaFrameCache cache(5 * XmaFrameCache::kFrameSize);
+  Frame output;
+  for (uint8_t i = 0; i < 4; ++i) {
+    cache.Insert(MakeKey(i, 0), MakeFrame(i).data());
+  }
+  for (uint8_t i = 0; i < 4; ++i) {
+    REQUIRE(cache.Find(MakeKey(i, 0), output.data()));
+  }
+
+  // Frame 0 is the least recently used one after this.
+  REQUIRE(cache.Find(MakeKey(1, 0), output.data()));
+  REQUIRE(cache.Find(MakeKey(2, 0), output.data()));
+  REQUIRE(cache.Find(MakeKey(3, 0), output.data()));
+  cache.Insert(MakeKey(4, 0), MakeFrame(4).data());
+  REQUIRE(cache.statistics().evictions == 1);
+  REQUIRE_FALSE(cache.Find(MakeKey(0, 0), output.data()));
+  for (uint8_t i = 1; i < 5; ++i) {
+    REQUIRE(cache.Find(MakeKey(i, 0), output.data()));
+    REQUIRE(output == MakeFrame(i));
+  }
+}
+
+TEST_CASE("XMA frame cache disabled", "[xma_frame_cache]") {
+  XmaFrameCache cache(0);
+  Frame output;
+  cache.Insert(MakeKey(1, 0), MakeFrame(1).data());
+  REQUIRE_FALSE(cache.Find(MakeKey(1, 0), output.data()));
+}
+
+}  // namespace xe::apu::test
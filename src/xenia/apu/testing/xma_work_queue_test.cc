@@ -0,0 +1,204 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/apu/xma_work_queue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "third_party/catch/include/catch.hpp"
+#include "third_party/fmt/include/fmt/format.h"
+
+#include "xenia/base/threading.h"
+
+namespace xe::apu::test {
+
+using namespace std::chrono_literals;
+
+// Runs the workers of a queue on host threads.
+class WorkerPool {
+ public:
+  WorkerPool(XmaWorkQueue& queue, uint32_t thread_count) : queue_(queue) {
+    for (uint32_t i = 0; i < thread_count; ++i) {
+      threads_.push_back(
+          xe::threading::Thread::Create({}, [this]() { queue_.WorkerMain(); }));
+      REQUIRE(threads_.back());
+    }
+  }
+  ~WorkerPool() {
+    queue_.Shutdown();
+    for (auto& thread : threads_) {
+      xe::threading::Wait(thread.get(), false);
+    }
+  }
+
+ private:
+  XmaWorkQueue& queue_;
+  std::vector<std::unique_ptr<xe::threading::Thread>> threads_;
+};
+
+template <typename Predicate>
+static bool WaitFor(Predicate predicate) {
+  auto end = std::chrono::steady_clock::now() + 10s;
+  while (!predicate()) {
+    if (std::chrono::steady_clock::now() > end) {
+      return false;
+    }
+    std::this_thread::sleep_for(100us);
+  }
+  return true;
+}
+
+struct TestContext {
+  std::atomic<uint32_t> kicks = 0;
+  std::atomic<uint32_t> handled_kicks = 0;
+  std::atomic<uint32_t> runs = 0;
+  std::atomic<bool> running = false;
+  std::atomic<bool> overlapped = false;
+};
+
+TEST_CASE("XMA work queue runs every kicked context", "[xma_work_queue]") {
+  constexpr uint32_t kContextCount = 64;
+  std::vector<TestContext> contexts(kContextCount);
+  XmaWorkQueue queue(kContextCount, [&](uint32_t context_id) {
+    TestContext& context = contexts[context_id];
+    if (context.running.exchange(true)) {
+      context.overlapped = true;
+    }
+    // Handles all kicks that happened before the run started, like
+    // XmaContext::Work does.
+    context.handled_kicks = context.kicks.load();
+    ++context.runs;
+    std::this_thread::sleep_for(50us);
+    context.running = false;
+  });
+  WorkerPool pool(queue, 4);
+
+  std::vector<std::thread> kick_threads;
+  for (uint32_t i = 0; i < 4; ++i) {
+    kick_threads.emplace_back([&, i]() {
+      for (uint32_t round = 0; round < 200; ++round) {
+        for (uint32_t context_id = i; context_id < kContextCount;
+             context_id += 2) {
+          ++contexts[context_id].kicks;
+          queue.Kick(context_id);
+        }
+      }
+    });
+  }
+  for (auto& kick_thread : kick_threads) {
+    kick_thread.join();
+  }
+
+  for (uint32_t i = 0; i < kContextCount; ++i) {
+    TestContext& context = contexts[i];
+    // Every kick is followed by a run, even if it came while running.
+    REQUIRE(WaitFor([&]() { return context.handled_kicks == context.kicks; }));
+    REQUIRE_FALSE(context.overlapped);
+    REQUIRE(context.runs > 0);
+    REQUIRE(context.runs <= context.kicks);
+  }
+}
+
+TEST_CASE("XMA work queue pause", "[xma_work_queue]") {
+  std::atomic<uint32_t> runs = 0;
+  XmaWorkQueue queue(4, [&](uint32_t context_id) { ++runs; });
+
+  SECTION("Without workers") { queue.Pause(); }
+
+  SECTION("Kicks are deferred while paused") {
+    WorkerPool pool(queue, 2);
+    queue.Kick(0);
+    REQUIRE(WaitFor([&]() { return runs == 1; }));
+    queue.Pause();
+    queue.Kick(1);
+    queue.Kick(2);
+    std::this_thread::sleep_for(10ms);
+    REQUIRE(runs == 1);
+    queue.Resume();
+    REQUIRE(WaitFor([&]() { return runs == 3; }));
+  }
+}
+
+// Not run by default. Run with the "[xma_work_queue_benchmark]" tag.
+// Every voice is kicked once per round, like a title submitting a 512-sample
+// stereo frame for each voice at 48 kHz, and the round ends when all of them
+// are decoded. The decoding is replaced by a fixed amount of floating point
+// work, as there's no XMA data to decode here.
+TEST_CASE("XMA decoding of concurrent voices",
+          "[.][xma_work_queue_benchmark]") {
+  constexpr uint32_t kSamplesPerFrame = 512;
+  constexpr uint32_t kSampleRate = 48000;
+  constexpr uint32_t kRounds = 200;
+
+  struct Voice {
+    std::chrono::steady_clock::time_point kick_time;
+    std::vector<float> samples = std::vector<float>(kSamplesPerFrame * 2);
+    float phase = 0.0f;
+    double latency_sum = 0.0;
+    double latency_max = 0.0;
+  };
+
+  for (uint32_t voice_count : {8u, 32u, 128u}) {
+    for (uint32_t thread_count : {1u, 2u, 4u}) {
+      std::vector<Voice> voices(voice_count);
+      std::atomic<uint32_t> decoded_frames = 0;
+      XmaWorkQueue queue(voice_count, [&](uint32_t voice_id) {
+        Voice& voice = voices[voice_id];
+        // Roughly the cost of the inverse transform and windowing of a frame.
+        for (uint32_t pass = 0; pass < 4; ++pass) {
+          for (float& sample : voice.samples) {
+            voice.phase += 0.001f;
+            sample = sample * 0.5f + std::sin(voice.phase);
+          }
+        }
+        double latency = std::chrono::duration<double, std::micro>(
+                             std::chrono::steady_clock::now() - voice.kick_time)
+                             .count();
+        voice.latency_sum += latency;
+        voice.latency_max = std::max(voice.latency_max, latency);
+        ++decoded_frames;
+      });
+
+      WorkerPool pool(queue, thread_count);
+      auto start = std::chrono::steady_clock::now();
+      for (uint32_t round = 0; round < kRounds; ++round) {
+        for (uint32_t i = 0; i < voice_count; ++i) {
+          voices[i].kick_time = std::chrono::steady_clock::now();
+          queue.Kick(i);
+        }
+        while (decoded_frames < (round + 1) * voice_count) {
+          std::this_thread::yield();
+        }
+      }
+      double seconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+
+      double latency_sum = 0.0, latency_max = 0.0;
+      for (const Voice& voice : voices) {
+        latency_sum += voice.latency_sum;
+        latency_max = std::max(latency_max, voice.latency_max);
+      }
+      double audio_seconds = double(kRounds) * kSamplesPerFrame / kSampleRate;
+      fmt::print(
+          "{} voices, {} threads: {:.1f}x real time, latency {:.0f} us "
+          "average, {:.0f} us max\n",
+          voice_count, thread_count, audio_seconds / seconds,
+          latency_sum / (kRounds * voice_count), latency_max);
+    }
+  }
+}
+
+}  // namespace xe::apu::test
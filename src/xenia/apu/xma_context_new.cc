@@ -33,7 +33,8 @@ extern "C" {
 namespace xe {
 namespace apu {
 
-XmaContextNew::XmaContextNew() = default;
+XmaContextNew::XmaContextNew(XmaFrameCache* frame_cache)
+    : frame_cache_(frame_cache) {}
 
 XmaContextNew::~XmaContextNew() {
   if (av_context_) {
@@ -226,6 +227,18 @@ void XmaContextNew::Clear() {
 
   current_frame_remaining_subframes_ = 0;
   data.Store(context_ptr);
+
+  // The next frame starts a new stream, without overlap with the last one.
+  if (av_context_ && avcodec_is_open(av_context_)) {
+    avcodec_flush_buffers(av_context_);
+  }
+  ResetFrameHistory();
+}
+
+void XmaContextNew::ResetFrameHistory() {
+  previous_frame_hash_ = {};
+  decoder_frame_hash_ = {};
+  previous_xma_frame_size_ = 0;
 }
 
 void XmaContextNew::Disable() {
@@ -405,15 +418,8 @@ void XmaContextNew::Decode(XMA_CONTEXT_DATA* data) {
   const uint32_t padding_start = static_cast<uint8_t>(
       stream.Copy(xma_frame_.data() + 1, packet_info.current_frame_size_));
 
-  raw_frame_.fill(0);
-
-  PrepareDecoder(data->sample_rate, bool(data->is_stereo));
   PreparePacket(packet_info.current_frame_size_, padding_start);
-  if (DecodePacket(av_context_, av_packet_, av_frame_)) {
-    // dump_raw(av_frame_, id());
-    ConvertFrame(reinterpret_cast<const uint8_t**>(&av_frame_->data),
-                 bool(data->is_stereo), raw_frame_.data());
-  }
+  DecodeFrame(data);
 
   // TODO: Write function to regenerate decoder
   // TODO: Be aware of subframe_skips & loops subframes skips
@@ -655,6 +661,9 @@ int XmaContextNew::PrepareDecoder(int sample_rate, bool is_two_channel) {
 
     if (avcodec_open2(av_context_, av_codec_, NULL) < 0) {
       XELOGE("XmaContext: Failed to reopen FFmpeg context");
+      // Retry reopening on the next frame rather than decoding with the
+      // closed codec.
+      av_context_->channels = 0;
       return -1;
     }
     return 1;
@@ -674,6 +683,55 @@ void XmaContextNew::PreparePacket(const uint32_t frame_size,
   xma_frame_[0] = ((frame_padding & 7) << 5) | ((padding_end & 7) << 2);
 }
 
+void XmaContextNew::DecodeFrame(XMA_CONTEXT_DATA* data) {
+  const int prepare_result =
+      PrepareDecoder(data->sample_rate, bool(data->is_stereo));
+  if (prepare_result != 0) {
+    // The decoder has been reopened for a different format (or couldn't be),
+    // and the previous frame belongs to the previous stream - like without
+    // the cache, this frame is decoded without overlap with it.
+    ResetFrameHistory();
+  }
+  if (prepare_result < 0) {
+    raw_frame_.fill(0);
+    return;
+  }
+  const XmaFrameCache::FrameHash frame_hash =
+      XmaFrameCache::HashFrame(av_packet_->data, av_packet_->size);
+  const XmaFrameCache::Key key = {frame_hash, previous_frame_hash_,
+                                  data->sample_rate, data->is_stereo + 1u};
+
+  if (!frame_cache_ || !frame_cache_->Find(key, raw_frame_.data())) {
+    raw_frame_.fill(0);
+
+    if (decoder_frame_hash_ != previous_frame_hash_ &&
+        previous_xma_frame_size_) {
+      // The previous frame came from the cache, decode it again for the
+      // overlap with this one.
+      const int frame_size = av_packet_->size;
+      av_packet_->data = previous_xma_frame_.data();
+      av_packet_->size = previous_xma_frame_size_;
+      DecodePacket(av_context_, av_packet_, av_frame_);
+      av_packet_->data = xma_frame_.data();
+      av_packet_->size = frame_size;
+    }
+    if (DecodePacket(av_context_, av_packet_, av_frame_)) {
+      // dump_raw(av_frame_, id());
+      ConvertFrame(reinterpret_cast<const uint8_t**>(&av_frame_->data),
+                   bool(data->is_stereo), raw_frame_.data());
+      if (frame_cache_) {
+        frame_cache_->Insert(key, raw_frame_.data());
+      }
+    }
+    decoder_frame_hash_ = frame_hash;
+  }
+
+  previous_frame_hash_ = frame_hash;
+  previous_xma_frame_size_ = av_packet_->size;
+  std::memcpy(previous_xma_frame_.data(), xma_frame_.data(),
+              previous_xma_frame_size_);
+}
+
 bool XmaContextNew::DecodePacket(AVCodecContext* av_context,
                                  const AVPacket* av_packet, AVFrame* av_frame) {
   auto ret = avcodec_send_packet(av_context, av_packet);
@@ -16,6 +16,7 @@
 #include <queue>
 
 #include "xenia/apu/xma_context.h"
+#include "xenia/apu/xma_frame_cache.h"
 #include "xenia/base/bit_stream.h"
 #include "xenia/base/ring_buffer.h"
 #include "xenia/memory.h"
@@ -68,7 +69,8 @@ class XmaContextNew : public XmaContext {
   static const uint32_t kLastFrameMarker = 0x7FFF;
   static const uint32_t kMaxFrameSizeinBits = 0x4000 - kBitsPerPacketHeader;
 
-  explicit XmaContextNew();
+  // frame_cache may be null to decode every frame.
+  explicit XmaContextNew(XmaFrameCache* frame_cache = nullptr);
   ~XmaContextNew();
 
   int Setup(uint32_t id, Memory* memory, uint32_t guest_ptr);
@@ -116,15 +118,30 @@ class XmaContextNew : public XmaContext {
 
   bool DecodePacket(AVCodecContext* av_context, const AVPacket* av_packet,
                     AVFrame* av_frame);
+  // Decodes the frame in xma_frame_ to raw_frame_, or copies it from the frame
+  // cache if it has been decoded after the same previous frame before.
+  void DecodeFrame(XMA_CONTEXT_DATA* data);
 
   // This method should be used ONLY when we're at the last packet of the stream
   // and we want to find offset in next buffer
   uint32_t GetPacketFirstFrameOffset(const XMA_CONTEXT_DATA* data);
+  // Forgets the previous frame, so the next one is decoded (and looked up in
+  // the frame cache) without overlap with it.
+  void ResetFrameHistory();
 
   std::array<uint8_t, kBytesPerPacketData * 2> input_buffer_;
   // first byte contains bit offset information
   std::array<uint8_t, 1 + 4096> xma_frame_;
   std::array<uint8_t, kBytesPerFrameChannel * 2> raw_frame_;
+  static_assert(sizeof(raw_frame_) == XmaFrameCache::kFrameSize);
+
+  XmaFrameCache* frame_cache_;
+  // The last frame decoded, and the last one passed to FFmpeg which differs if
+  // the last frame was taken from the cache. All zeros if none.
+  XmaFrameCache::FrameHash previous_frame_hash_ = {};
+  XmaFrameCache::FrameHash decoder_frame_hash_ = {};
+  std::array<uint8_t, 1 + 4096> previous_xma_frame_;
+  int previous_xma_frame_size_ = 0;
 
   int32_t remaining_subframe_blocks_in_output_buffer_ = 0;
   uint8_t current_frame_remaining_subframes_ = 0;
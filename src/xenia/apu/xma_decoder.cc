@@ -9,11 +9,14 @@
 
 #include "xenia/apu/xma_decoder.h"
 
+#include <algorithm>
+
 #include "xenia/apu/xma_context.h"
 #include "xenia/apu/xma_context_new.h"
 #include "xenia/apu/xma_context_old.h"
 
 #include "xenia/base/cvar.h"
+#include "xenia/base/literals.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 #include "xenia/base/profiling.h"
@@ -62,9 +65,23 @@ DEFINE_bool(use_dedicated_xma_thread, true,
             "better results, but decrease performance a bit.",
             "APU");
 
+DEFINE_uint32(xma_decoder_threads, 0,
+              "Number of threads decoding XMA contexts when "
+              "use_dedicated_xma_thread is enabled. 0 to choose based on the "
+              "number of logical processors.",
+              "APU");
+
+DEFINE_uint32(xma_frame_cache_size, 16,
+              "Size in MiB of the cache of decoded XMA frames used by the new "
+              "decoder, so looping music and repeated sound effects aren't "
+              "decoded again. 0 to disable.",
+              "APU");
+
 namespace xe {
 namespace apu {
 
+using namespace xe::literals;
+
 XmaDecoder::XmaDecoder(cpu::Processor* processor)
     : memory_(processor->memory()), processor_(processor) {}
 
@@ -138,9 +155,13 @@ X_STATUS XmaDecoder::Setup(kernel::KernelState* kernel_state) {
       memory()->GetPhysicalAddress(context_data_first_ptr_);
 
   // Setup XMA contexts.
+  if (cvars::use_new_decoder && cvars::xma_frame_cache_size) {
+    frame_cache_ = std::make_unique<XmaFrameCache>(
+        size_t(cvars::xma_frame_cache_size) * 1_MiB);
+  }
   for (int i = 0; i < kContextCount; ++i) {
     if (cvars::use_new_decoder) {
-      contexts_[i] = new XmaContextNew();
+      contexts_[i] = new XmaContextNew(frame_cache_.get());
     } else {
       contexts_[i] = new XmaContextOld();
     }
@@ -153,71 +174,62 @@ X_STATUS XmaDecoder::Setup(kernel::KernelState* kernel_state) {
   register_file_[XmaRegister::NextContextIndex] = 1;
   context_bitmap_.Resize(kContextCount);
 
-  worker_running_ = true;
-  work_event_ = xe::threading::Event::CreateAutoResetEvent(false);
-  assert_not_null(work_event_);
-  worker_thread_ =
-      kernel::object_ref<kernel::XHostThread>(new kernel::XHostThread(
-          kernel_state, 128 * 1024, 0,
-          [this]() {
-            if (cvars::use_dedicated_xma_thread) {
-              WorkerThreadMain();
-            }
-            return 0;
-          },
-          kernel_state
-              ->GetIdleProcess()));  // this one doesnt need any process
-                                     // actually. never calls any guest code
-  worker_thread_->set_name("XMA Decoder");
-  worker_thread_->set_can_debugger_suspend(true);
-  worker_thread_->Create();
-
-  return X_STATUS_SUCCESS;
-}
-
-void XmaDecoder::WorkerThreadMain() {
-  uint32_t idle_loop_count = 0;
-  while (worker_running_) {
-    // Okay, let's loop through XMA contexts to find ones we need to decode!
-    bool did_work = false;
-    for (uint32_t n = 0; n < kContextCount; n++) {
-      did_work = contexts_[n]->Work() || did_work;
-
-      // TODO: Need thread safety to do this.
-      // Probably not too important though.
-      // registers_.current_context = n;
-      // registers_.next_context = (n + 1) % kContextCount;
+  work_queue_ = std::make_unique<XmaWorkQueue>(
+      kContextCount,
+      [this](uint32_t context_id) { contexts_[context_id]->Work(); });
+  if (cvars::use_dedicated_xma_thread) {
+    // A few threads are enough for the voices of any title, more would mostly
+    // compete with the emulated CPU threads.
+    uint32_t thread_count = cvars::xma_decoder_threads;
+    if (!thread_count) {
+      thread_count = std::clamp(
+          xe::threading::logical_processor_count() / 4, uint32_t(1),
+          uint32_t(4));
     }
-
-    if (paused_) {
-      pause_fence_.Signal();
-      resume_fence_.Wait();
+    for (uint32_t i = 0; i < thread_count; ++i) {
+      // These don't need any process actually, they never call any guest code.
+      auto worker_thread =
+          kernel::object_ref<kernel::XHostThread>(new kernel::XHostThread(
+              kernel_state, 128 * 1024, 0,
+              [this]() {
+                work_queue_->WorkerMain();
+                return 0;
+              },
+              kernel_state->GetIdleProcess()));
+      worker_thread->set_name(
+          i ? fmt::format("XMA Decoder {}", i) : "XMA Decoder");
+      worker_thread->set_can_debugger_suspend(true);
+      worker_thread->Create();
+      worker_threads_.push_back(std::move(worker_thread));
     }
-
-    if (!did_work) {
-      idle_loop_count++;
-    } else {
-      idle_loop_count = 0;
-    }
-    xe::threading::Wait(work_event_.get(), false);
   }
+
+  return X_STATUS_SUCCESS;
 }
 
 void XmaDecoder::Shutdown() {
-  worker_running_ = false;
-
-  if (work_event_) {
-    work_event_->Set();
+  if (work_queue_) {
+    work_queue_->Shutdown();
   }
 
   if (paused_) {
     Resume();
   }
 
-  if (worker_thread_) {
-    // Wait for work thread.
-    xe::threading::Wait(worker_thread_->thread(), false);
-    worker_thread_.reset();
+  // Wait for work threads.
+  for (auto& worker_thread : worker_threads_) {
+    xe::threading::Wait(worker_thread->thread(), false);
+  }
+  worker_threads_.clear();
+
+  if (frame_cache_) {
+    auto statistics = frame_cache_->statistics();
+    uint64_t lookups = statistics.hits + statistics.misses;
+    XELOGI(
+        "XMA frame cache: {} hits, {} misses ({:.1f}% hit rate), {} evictions",
+        statistics.hits, statistics.misses,
+        lookups ? 100.0 * statistics.hits / lookups : 0.0,
+        statistics.evictions);
   }
 
   if (context_data_first_ptr_) {
@@ -328,13 +340,13 @@ void XmaDecoder::WriteRegister(uint32_t addr, uint32_t value) {
         uint32_t context_id = base_context_id + i;
         auto& context = *contexts_[context_id];
         context.Enable();
-        if (!cvars::use_dedicated_xma_thread) {
+        if (cvars::use_dedicated_xma_thread) {
+          work_queue_->Kick(context_id);
+        } else {
           context.Work();
         }
       }
     }
-    // Signal the decoder thread to start processing.
-    work_event_->SetBoostPriority();
   } else if (r >= XmaRegister::Context0Lock && r <= XmaRegister::Context9Lock) {
     // Context lock command.
     // This requests a lock by flagging the context.
@@ -388,7 +400,7 @@ void XmaDecoder::Pause() {
   }
   paused_ = true;
 
-  pause_fence_.Wait();
+  work_queue_->Pause();
 }
 
 void XmaDecoder::Resume() {
@@ -397,7 +409,7 @@ void XmaDecoder::Resume() {
   }
   paused_ = false;
 
-  resume_fence_.Signal();
+  work_queue_->Resume();
 }
 
 }  // namespace apu
@@ -11,11 +11,15 @@
 #define XENIA_APU_XMA_DECODER_H_
 
 #include <atomic>
+#include <memory>
 #include <mutex>
 #include <queue>
+#include <vector>
 
 #include "xenia/apu/xma_context.h"
+#include "xenia/apu/xma_frame_cache.h"
 #include "xenia/apu/xma_register_file.h"
+#include "xenia/apu/xma_work_queue.h"
 #include "xenia/base/bit_map.h"
 #include "xenia/kernel/xthread.h"
 #include "xenia/xbox.h"
@@ -55,8 +59,6 @@ class XmaDecoder {
   int GetContextId(uint32_t guest_ptr);
 
  private:
-  void WorkerThreadMain();
-
   static uint32_t MMIOReadRegisterThunk(void* ppc_context, XmaDecoder* as,
                                         uint32_t addr) {
     return as->ReadRegister(addr);
@@ -70,18 +72,18 @@ class XmaDecoder {
   Memory* memory_ = nullptr;
   cpu::Processor* processor_ = nullptr;
 
-  std::atomic<bool> worker_running_ = {false};
-  kernel::object_ref<kernel::XHostThread> worker_thread_;
-  std::unique_ptr<xe::threading::Event> work_event_ = nullptr;
+  // Kicked contexts, decoded by the worker threads.
+  std::unique_ptr<XmaWorkQueue> work_queue_;
+  std::vector<kernel::object_ref<kernel::XHostThread>> worker_threads_;
 
   bool paused_ = false;
-  xe::threading::Fence pause_fence_;   // Signaled when worker paused.
-  xe::threading::Fence resume_fence_;  // Signaled when resume requested.
 
   XmaRegisterFile register_file_;
 
   static const uint32_t kContextCount = 320;
   XmaContext* contexts_[kContextCount];
+  // Shared by the contexts using the new decoder.
+  std::unique_ptr<XmaFrameCache> frame_cache_;
   BitMap context_bitmap_;
 
   uint32_t context_data_first_ptr_ = 0;
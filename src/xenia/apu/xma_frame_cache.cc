@@ -0,0 +1,79 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/apu/xma_frame_cache.h"
+
+#include <cstring>
+#include <iterator>
+
+#include "xenia/base/xxhash.h"
+
+namespace xe {
+namespace apu {
+
+XmaFrameCache::XmaFrameCache(size_t capacity_bytes)
+    : max_frames_(capacity_bytes / sizeof(Frame)) {}
+
+XmaFrameCache::FrameHash XmaFrameCache::HashFrame(const void* data,
+                                                  size_t size) {
+  XXH128_hash_t hash = XXH3_128bits_withSeed(data, size, size);
+  return {hash.low64, hash.high64};
+}
+
+bool XmaFrameCache::Find(const Key& key, uint8_t* output) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = frames_.find(key);
+  if (it == frames_.end()) {
+    ++statistics_.misses;
+    return false;
+  }
+  ++statistics_.hits;
+  lru_.splice(lru_.begin(), lru_, it->second);
+  std::memcpy(output, it->second->data.data(), kFrameSize);
+  return true;
+}
+
+void XmaFrameCache::Insert(const Key& key, const uint8_t* frame) {
+  if (!max_frames_) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = frames_.find(key);
+  if (it != frames_.end()) {
+    // Decoded by another context at the same time.
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return;
+  }
+  if (frames_.size() >= max_frames_) {
+    // Reuse the storage of the least recently used frame.
+    frames_.erase(lru_.back().key);
+    lru_.splice(lru_.begin(), lru_, std::prev(lru_.end()));
+    ++statistics_.evictions;
+  } else {
+    lru_.emplace_front();
+  }
+  Frame& cached_frame = lru_.front();
+  cached_frame.key = key;
+  std::memcpy(cached_frame.data.data(), frame, kFrameSize);
+  frames_.emplace(key, lru_.begin());
+}
+
+void XmaFrameCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  frames_.clear();
+  lru_.clear();
+}
+
+XmaFrameCache::Statistics XmaFrameCache::statistics() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return statistics_;
+}
+
+}  // namespace apu
+}  // namespace xe
@@ -0,0 +1,103 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_APU_XMA_FRAME_CACHE_H_
+#define XENIA_APU_XMA_FRAME_CACHE_H_
+
+#include <array>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace xe {
+namespace apu {
+
+// LRU cache of decoded XMA frames shared by all contexts, so music looping
+// over the same buffer and sound effects played repeatedly are decoded once.
+//
+// The output of a frame also depends on the previous frame through the
+// overlapping transform windows, so the previous frame is part of the key.
+class XmaFrameCache {
+ public:
+  // 512 stereo 16-bit samples, the size of XmaContextNew::raw_frame_.
+  static constexpr size_t kFrameSize = 512 * 2 * 2;
+
+  // 128-bit XXH3 of the data passed to the decoder for a frame, seeded with
+  // the length - a collision would make a context play another frame's audio,
+  // and with 128 bits it is practically impossible even over hours of audio.
+  // All zeros for no frame.
+  struct FrameHash {
+    uint64_t low64;
+    uint64_t high64;
+    bool operator==(const FrameHash& other) const {
+      return low64 == other.low64 && high64 == other.high64;
+    }
+  };
+
+  struct Key {
+    // Hashes of the frame and of the frame decoded before it.
+    FrameHash frame_hash;
+    FrameHash previous_frame_hash;
+    uint32_t sample_rate;
+    uint32_t channel_count;
+
+    bool operator==(const Key& other) const {
+      return frame_hash == other.frame_hash &&
+             previous_frame_hash == other.previous_frame_hash &&
+             sample_rate == other.sample_rate &&
+             channel_count == other.channel_count;
+    }
+  };
+
+  struct Statistics {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+  };
+
+  // A capacity smaller than one frame disables caching.
+  explicit XmaFrameCache(size_t capacity_bytes);
+
+  static FrameHash HashFrame(const void* data, size_t size);
+
+  // Copies kFrameSize bytes of the cached frame to output if present.
+  bool Find(const Key& key, uint8_t* output);
+  void Insert(const Key& key, const uint8_t* frame);
+
+  void Clear();
+
+  Statistics statistics() const;
+
+ private:
+  struct KeyHash {
+    size_t operator()(const Key& key) const {
+      return size_t(key.frame_hash.low64 ^
+                    (key.previous_frame_hash.low64 * 31) ^
+                    (uint64_t(key.sample_rate) << 1) ^ key.channel_count);
+    }
+  };
+  struct Frame {
+    Key key;
+    std::array<uint8_t, kFrameSize> data;
+  };
+
+  size_t max_frames_;
+
+  mutable std::mutex mutex_;
+  // Most recently used at the front.
+  std::list<Frame> lru_;
+  std::unordered_map<Key, std::list<Frame>::iterator, KeyHash> frames_;
+  Statistics statistics_;
+};
+
+}  // namespace apu
+}  // namespace xe
+
+#endif  // XENIA_APU_XMA_FRAME_CACHE_H_
@@ -0,0 +1,104 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/apu/xma_work_queue.h"
+
+#include <utility>
+
+#include "xenia/base/assert.h"
+
+namespace xe {
+namespace apu {
+
+XmaWorkQueue::XmaWorkQueue(
+    uint32_t context_count,
+    std::function<void(uint32_t context_id)> work_function)
+    : work_function_(std::move(work_function)),
+      context_states_(context_count, ContextState::kIdle) {}
+
+void XmaWorkQueue::Kick(uint32_t context_id) {
+  assert_true(context_id < context_states_.size());
+  std::unique_lock<std::mutex> lock(mutex_);
+  ContextState& state = context_states_[context_id];
+  switch (state) {
+    case ContextState::kIdle:
+      state = ContextState::kQueued;
+      queued_contexts_.push(context_id);
+      lock.unlock();
+      work_cond_.notify_one();
+      break;
+    case ContextState::kRunning:
+      state = ContextState::kRunningKicked;
+      break;
+    case ContextState::kQueued:
+    case ContextState::kRunningKicked:
+      // Will run after this kick anyway.
+      break;
+  }
+}
+
+void XmaWorkQueue::WorkerMain() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  ++worker_count_;
+  while (running_) {
+    if (paused_) {
+      ++paused_worker_count_;
+      pause_cond_.notify_all();
+      work_cond_.wait(lock, [this]() { return !paused_ || !running_; });
+      --paused_worker_count_;
+      continue;
+    }
+    if (queued_contexts_.empty()) {
+      work_cond_.wait(lock);
+      continue;
+    }
+    uint32_t context_id = queued_contexts_.front();
+    queued_contexts_.pop();
+    context_states_[context_id] = ContextState::kRunning;
+    lock.unlock();
+    work_function_(context_id);
+    lock.lock();
+    ContextState& state = context_states_[context_id];
+    if (state == ContextState::kRunningKicked) {
+      state = ContextState::kQueued;
+      queued_contexts_.push(context_id);
+    } else {
+      state = ContextState::kIdle;
+    }
+  }
+  --worker_count_;
+  pause_cond_.notify_all();
+}
+
+void XmaWorkQueue::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  work_cond_.notify_all();
+}
+
+void XmaWorkQueue::Pause() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  paused_ = true;
+  work_cond_.notify_all();
+  pause_cond_.wait(lock,
+                   [this]() { return paused_worker_count_ == worker_count_; });
+}
+
+void XmaWorkQueue::Resume() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    paused_ = false;
+  }
+  work_cond_.notify_all();
+}
+
+}  // namespace apu
+}  // namespace xe
@@ -0,0 +1,74 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_APU_XMA_WORK_QUEUE_H_
+#define XENIA_APU_XMA_WORK_QUEUE_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <vector>
+
+namespace xe {
+namespace apu {
+
+// Queue of the XMA contexts that have been kicked, consumed by any number of
+// decoder threads running WorkerMain.
+//
+// A context is worked on by at most one thread at a time. Kicking a context
+// while it's being worked on makes it run again once the current work is done,
+// so every kick is followed by a complete run of the work function.
+class XmaWorkQueue {
+ public:
+  XmaWorkQueue(uint32_t context_count,
+               std::function<void(uint32_t context_id)> work_function);
+
+  void Kick(uint32_t context_id);
+
+  // Runs the work function for kicked contexts until Shutdown is called.
+  void WorkerMain();
+  // Makes all workers return once they're done with their current context.
+  void Shutdown();
+
+  // Waits until all workers are done with their current context, and keeps
+  // them from starting new ones until Resume is called. Kicks are still
+  // queued while paused.
+  void Pause();
+  void Resume();
+
+ private:
+  enum class ContextState : uint8_t {
+    kIdle,
+    kQueued,
+    kRunning,
+    // Kicked again while running, queued again once done.
+    kRunningKicked,
+  };
+
+  std::function<void(uint32_t context_id)> work_function_;
+
+  std::mutex mutex_;
+  // Signaled when contexts are queued, and on Resume and Shutdown.
+  std::condition_variable work_cond_;
+  // Signaled when a worker is paused.
+  std::condition_variable pause_cond_;
+  std::vector<ContextState> context_states_;
+  std::queue<uint32_t> queued_contexts_;
+  bool running_ = true;
+  bool paused_ = false;
+  uint32_t worker_count_ = 0;
+  uint32_t paused_worker_count_ = 0;
+};
+
+}  // namespace apu
+}  // namespace xe
+
+#endif  // XENIA_APU_XMA_WORK_QUEUE_H_
@@ -0,0 +1,124 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/base/bit_range.h"
+
+namespace xe {
+namespace bit_range {
+
+size_t FindNonZeroBlock(const uint64_t* bits, size_t block_first,
+                        size_t block_end) {
+#if XE_ARCH_AMD64
+  if (amd64::GetFeatureFlags() & amd64::kX64EmitAVX2) {
+    return FindNonZeroBlockAVX2(bits, block_first, block_end);
+  }
+  return FindNonZeroBlockScalar(bits, block_first, block_end);
+#else
+  return FindNonZeroBlock<uint64_t>(bits, block_first, block_end);
+#endif  // XE_ARCH_AMD64
+}
+
+size_t FindNonFullBlock(const uint64_t* bits, size_t block_first,
+                        size_t block_end) {
+#if XE_ARCH_AMD64
+  if (amd64::GetFeatureFlags() & amd64::kX64EmitAVX2) {
+    return FindNonFullBlockAVX2(bits, block_first, block_end);
+  }
+  return FindNonFullBlockScalar(bits, block_first, block_end);
+#else
+  return FindNonFullBlock<uint64_t>(bits, block_first, block_end);
+#endif  // XE_ARCH_AMD64
+}
+
+#if XE_ARCH_AMD64
+
+size_t FindNonZeroBlockScalar(const uint64_t* bits, size_t block_first,
+                              size_t block_end) {
+  return FindNonZeroBlock<uint64_t>(bits, block_first, block_end);
+}
+
+size_t FindNonFullBlockScalar(const uint64_t* bits, size_t block_first,
+                              size_t block_end) {
+  return FindNonFullBlock<uint64_t>(bits, block_first, block_end);
+}
+
+// The AVX2 versions are only called after checking kX64EmitAVX2, so they're
+// built for it regardless of the instruction set of the rest of the code.
+#if XE_COMPILER_HAS_GNU_EXTENSIONS == 1
+#define XE_BASE_BIT_RANGE_AVX2 __attribute__((target("avx2")))
+#else
+#define XE_BASE_BIT_RANGE_AVX2
+#endif
+
+// Ranges of a few blocks are common (a texture or a vertex buffer usually
+// spans several pages), so the 1024-bit steps are only taken while there's
+// enough data left, then the exact block is located 256 bits and then 64 bits
+// at a time.
+
+XE_BASE_BIT_RANGE_AVX2
+size_t FindNonZeroBlockAVX2(const uint64_t* bits, size_t block_first,
+                            size_t block_end) {
+  while (block_end - block_first >= 16) {
+    const __m256i* blocks =
+        reinterpret_cast<const __m256i*>(bits + block_first);
+    __m256i blocks_or = _mm256_or_si256(
+        _mm256_or_si256(_mm256_loadu_si256(blocks),
+                        _mm256_loadu_si256(blocks + 1)),
+        _mm256_or_si256(_mm256_loadu_si256(blocks + 2),
+                        _mm256_loadu_si256(blocks + 3)));
+    if (!_mm256_testz_si256(blocks_or, blocks_or)) {
+      break;
+    }
+    block_first += 16;
+  }
+  while (block_end - block_first >= 4) {
+    __m256i blocks = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(bits + block_first));
+    if (!_mm256_testz_si256(blocks, blocks)) {
+      break;
+    }
+    block_first += 4;
+  }
+  return FindNonZeroBlock<uint64_t>(bits, block_first, block_end);
+}
+
+XE_BASE_BIT_RANGE_AVX2
+size_t FindNonFullBlockAVX2(const uint64_t* bits, size_t block_first,
+                            size_t block_end) {
+  const __m256i all_ones = _mm256_set1_epi32(-1);
+  while (block_end - block_first >= 16) {
+    const __m256i* blocks =
+        reinterpret_cast<const __m256i*>(bits + block_first);
+    __m256i blocks_and = _mm256_and_si256(
+        _mm256_and_si256(_mm256_loadu_si256(blocks),
+                         _mm256_loadu_si256(blocks + 1)),
+        _mm256_and_si256(_mm256_loadu_si256(blocks + 2),
+                         _mm256_loadu_si256(blocks + 3)));
+    if (!_mm256_testc_si256(blocks_and, all_ones)) {
+      break;
+    }
+    block_first += 16;
+  }
+  while (block_end - block_first >= 4) {
+    __m256i blocks = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(bits + block_first));
+    if (!_mm256_testc_si256(blocks, all_ones)) {
+      break;
+    }
+    block_first += 4;
+  }
+  return FindNonFullBlock<uint64_t>(bits, block_first, block_end);
+}
+
+#undef XE_BASE_BIT_RANGE_AVX2
+
+#endif  // XE_ARCH_AMD64
+
+}  // namespace bit_range
+}  // namespace xe
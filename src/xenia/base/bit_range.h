@@ -17,10 +17,51 @@
 #include <utility>
 
 #include "xenia/base/math.h"
+#include "xenia/base/platform.h"
 
 namespace xe {
 namespace bit_range {
 
+// Index of the first block in [block_first, block_end) that has any bit set
+// (FindNonZeroBlock) or any bit unset (FindNonFullBlock), or block_end if there
+// are none. Used by the range functions below to skip long runs of uniform
+// blocks - for 64-bit blocks, done 256 bits at a time with AVX2 if available on
+// the host.
+size_t FindNonZeroBlock(const uint64_t* bits, size_t block_first,
+                        size_t block_end);
+size_t FindNonFullBlock(const uint64_t* bits, size_t block_first,
+                        size_t block_end);
+#if XE_ARCH_AMD64
+// The instruction set-specific versions, for testing - the AVX2 ones must only
+// be called after checking kX64EmitAVX2.
+size_t FindNonZeroBlockScalar(const uint64_t* bits, size_t block_first,
+                              size_t block_end);
+size_t FindNonZeroBlockAVX2(const uint64_t* bits, size_t block_first,
+                            size_t block_end);
+size_t FindNonFullBlockScalar(const uint64_t* bits, size_t block_first,
+                              size_t block_end);
+size_t FindNonFullBlockAVX2(const uint64_t* bits, size_t block_first,
+                            size_t block_end);
+#endif  // XE_ARCH_AMD64
+
+template <typename Block>
+size_t FindNonZeroBlock(const Block* bits, size_t block_first,
+                        size_t block_end) {
+  while (block_first < block_end && !bits[block_first]) {
+    ++block_first;
+  }
+  return block_first;
+}
+
+template <typename Block>
+size_t FindNonFullBlock(const Block* bits, size_t block_first,
+                        size_t block_end) {
+  while (block_first < block_end && bits[block_first] == ~Block(0)) {
+    ++block_first;
+  }
+  return block_first;
+}
+
 // Provided length is in bits since the first. Returns <first, length> of the
 // range in bits, with length == 0 if not found.
 template <typename Block>
@@ -35,6 +76,12 @@ std::pair<size_t, size_t> NextUnsetRange(const Block* bits, size_t first,
   size_t block_last = last / block_bits;
   size_t range_start = SIZE_MAX;
   for (size_t i = block_first; i <= block_last; ++i) {
+    if (i != block_first && i < block_last) {
+      // Skip the blocks fully inside the range that can neither open nor close
+      // a range.
+      i = range_start == SIZE_MAX ? FindNonFullBlock(bits, i, block_last)
+                                  : FindNonZeroBlock(bits, i, block_last);
+    }
     Block block = bits[i];
     // Ignore bits in the block outside the specified range by considering them
     // set.
@@ -94,12 +141,61 @@ void SetRange(Block* bits, size_t first, size_t length) {
   }
   bits[block_first] |= set_first;
   if (block_first + 1 < block_last) {
-    std::memset(bits + block_first + 1, CHAR_MAX,
+    std::memset(bits + block_first + 1, UCHAR_MAX,
                 (block_last - (block_first + 1)) * sizeof(Block));
   }
   bits[block_last] |= set_last;
 }
 
+template <typename Block>
+void ClearRange(Block* bits, size_t first, size_t length) {
+  if (!length) {
+    return;
+  }
+  size_t last = first + length - 1;
+  const size_t block_bits = sizeof(Block) * CHAR_BIT;
+  size_t block_first = first / block_bits;
+  size_t block_last = last / block_bits;
+  Block clear_first = ~((Block(1) << (first & (block_bits - 1))) - 1);
+  Block clear_last = ~Block(0);
+  if ((last & (block_bits - 1)) != (block_bits - 1)) {
+    clear_last &= (Block(1) << ((last & (block_bits - 1)) + 1)) - 1;
+  }
+  if (block_first == block_last) {
+    bits[block_first] &= ~(clear_first & clear_last);
+    return;
+  }
+  bits[block_first] &= ~clear_first;
+  if (block_first + 1 < block_last) {
+    std::memset(bits + block_first + 1, 0,
+                (block_last - (block_first + 1)) * sizeof(Block));
+  }
+  bits[block_last] &= ~clear_last;
+}
+
+// Whether any bit in the range is set.
+template <typename Block>
+bool AnySetInRange(const Block* bits, size_t first, size_t length) {
+  if (!length) {
+    return false;
+  }
+  size_t last = first + length - 1;
+  const size_t block_bits = sizeof(Block) * CHAR_BIT;
+  size_t block_first = first / block_bits;
+  size_t block_last = last / block_bits;
+  Block mask_first = ~((Block(1) << (first & (block_bits - 1))) - 1);
+  Block mask_last = ~Block(0);
+  if ((last & (block_bits - 1)) != (block_bits - 1)) {
+    mask_last &= (Block(1) << ((last & (block_bits - 1)) + 1)) - 1;
+  }
+  if (block_first == block_last) {
+    return (bits[block_first] & mask_first & mask_last) != 0;
+  }
+  return (bits[block_first] & mask_first) != 0 ||
+         (bits[block_last] & mask_last) != 0 ||
+         FindNonZeroBlock(bits, block_first + 1, block_last) != block_last;
+}
+
 }  // namespace bit_range
 }  // namespace xe
 
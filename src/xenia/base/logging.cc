@@ -10,10 +10,12 @@
 #include "xenia/base/logging.h"
 
 #include <algorithm>
+#include <array>
 #include <atomic>
 #include <cstdlib>
 #include <cstring>
 #include <mutex>
+#include <utility>
 #include <vector>
 
 #include "third_party/disruptorplus/include/disruptorplus/multi_threaded_claim_strategy.hpp"
@@ -55,6 +57,11 @@ DEFINE_bool(log_to_debugprint, false, "Dump the log to DebugPrint.", "Logging");
 #endif  // XE_PLATFORM_ANDROID
 DEFINE_bool(flush_log, true, "Flush log file after each log line batch.",
             "Logging");
+DEFINE_bool(log_deferred_format, false,
+            "Record raw log arguments on the calling thread and format them on "
+            "the logging writer thread. Reduces the cost of logging on guest "
+            "threads when verbose logging is enabled.",
+            "Logging");
 
 DEFINE_uint32(log_mask, 0,
               "Disables specific categorizes for more granular debug logging. "
@@ -66,6 +73,79 @@ DEFINE_int32(
     "Maximum level to be logged. (0=error, 1=warning, 2=info, 3=debug)",
     "Logging");
 
+namespace xe {
+namespace logging {
+namespace internal {
+
+struct DeferredArgValue {
+  DeferredArgType type = DeferredArgType::kString;
+  union {
+    bool b;
+    char c;
+    int64_t i;
+    uint64_t u;
+    float f;
+    double d;
+    const void* p;
+  };
+  std::string_view s;
+
+  DeferredArgValue() : u(0) {}
+};
+
+}  // namespace internal
+}  // namespace logging
+}  // namespace xe
+
+// Formats the captured value with the formatter of its original type. The
+// format spec can only be parsed once the type is known, so it's stored in
+// parse and handed to the real formatter in format.
+template <>
+struct fmt::formatter<xe::logging::internal::DeferredArgValue> {
+  fmt::string_view spec;
+
+  constexpr auto parse(fmt::format_parse_context& ctx) {
+    auto it = ctx.begin();
+    while (it != ctx.end() && *it != '}') {
+      ++it;
+    }
+    spec = fmt::string_view(ctx.begin(), size_t(it - ctx.begin()));
+    return it;
+  }
+
+  template <typename FormatContext>
+  auto format(const xe::logging::internal::DeferredArgValue& value,
+              FormatContext& ctx) {
+    using xe::logging::internal::DeferredArgType;
+    switch (value.type) {
+      case DeferredArgType::kBool:
+        return FormatAs(value.b, ctx);
+      case DeferredArgType::kChar:
+        return FormatAs(value.c, ctx);
+      case DeferredArgType::kSigned:
+        return FormatAs(value.i, ctx);
+      case DeferredArgType::kUnsigned:
+        return FormatAs(value.u, ctx);
+      case DeferredArgType::kFloat:
+        return FormatAs(value.f, ctx);
+      case DeferredArgType::kDouble:
+        return FormatAs(value.d, ctx);
+      case DeferredArgType::kPointer:
+        return FormatAs(value.p, ctx);
+      default:
+        return FormatAs(value.s, ctx);
+    }
+  }
+
+  template <typename T, typename FormatContext>
+  auto FormatAs(const T& value, FormatContext& ctx) {
+    fmt::formatter<T> formatter;
+    fmt::format_parse_context spec_ctx(spec);
+    formatter.parse(spec_ctx);
+    return formatter.format(value, ctx);
+  }
+};
+
 namespace dp = disruptorplus;
 using namespace xe::literals;
 
@@ -78,7 +158,8 @@ Logger* logger_ = nullptr;
 struct LogLine {
   size_t buffer_length;
   uint32_t thread_id;
-  uint16_t _pad_0;  // (2b) padding
+  bool deferred;    // Buffer is a DeferredRecordWriter record, not text.
+  uint8_t _pad_0;   // (1b) padding
   bool terminate;
   char prefix_char;
 };
@@ -270,6 +351,9 @@ class Logger {
 
   std::unique_ptr<xe::threading::Thread> write_thread_;
 
+  // Contiguous copy of a deferred record that may be split in the ring buffer.
+  std::vector<char> deferred_record_;
+
   void Write(const char* buf, size_t size) {
     for (const auto& sink : sinks_) {
       sink->Write(buf, size);
@@ -336,7 +420,24 @@ class Logger {
             Write(prefix, sizeof(prefix) - 1);
           }
 
-          if (line.buffer_length) {
+          if (line.deferred) {
+            auto line_range = rb.BeginRead(line.buffer_length);
+            deferred_record_.resize(line.buffer_length);
+            std::memcpy(deferred_record_.data(), line_range.first,
+                        line_range.first_length);
+            if (line_range.second_length) {
+              std::memcpy(deferred_record_.data() + line_range.first_length,
+                          line_range.second, line_range.second_length);
+            }
+            rb.EndRead(std::move(line_range));
+
+            std::string text = logging::internal::FormatDeferredRecord(
+                deferred_record_.data(), deferred_record_.size());
+            if (text.empty() || text.back() != '\n') {
+              text.push_back('\n');
+            }
+            Write(text.data(), text.size());
+          } else if (line.buffer_length) {
             // Get access to the line data - which may be split in the ring
             // buffer - and write it out in parts.
             auto line_range = rb.BeginRead(line.buffer_length);
@@ -405,7 +506,7 @@ class Logger {
  public:
   void AppendLine(uint32_t thread_id, const char prefix_char,
                   const char* buffer_data, size_t buffer_length,
-                  bool terminate = false) {
+                  bool terminate = false, bool deferred = false) {
     size_t count = BlockCount(sizeof(LogLine) + buffer_length);
 
     auto range = claim_strategy_.claim(count);
@@ -419,6 +520,7 @@ class Logger {
     line.buffer_length = buffer_length;
     line.thread_id = thread_id;
     line.prefix_char = prefix_char;
+    line.deferred = deferred;
     line.terminate = terminate;
 
     rb.Write(&line, sizeof(LogLine));
@@ -497,6 +599,87 @@ void logging::internal::AppendLogLine(LogLevel log_level,
                       thread_log_buffer_, written);
 }
 
+bool logging::internal::IsFormatDeferred() {
+  return cvars::log_deferred_format;
+}
+
+XE_NOALIAS
+void logging::internal::AppendDeferredLogLine(LogLevel log_level,
+                                              const char prefix_char,
+                                              size_t written) {
+  if (!logger_ || !ShouldLog(log_level) || !written) {
+    return;
+  }
+  logger_->AppendLine(xe::threading::current_thread_id(), prefix_char,
+                      thread_log_buffer_, written, false, true);
+}
+
+namespace logging {
+namespace internal {
+
+template <size_t... I>
+static std::string VFormatDeferred(
+    std::string_view format,
+    std::array<DeferredArgValue, kMaxDeferredArgs>& values,
+    std::index_sequence<I...>) {
+  return fmt::vformat(format, fmt::make_format_args(values[I]...));
+}
+
+std::string FormatDeferredRecord(const char* data, size_t size) {
+  const char* end = data + size;
+  auto read = [&data, end](void* dest, size_t length) {
+    if (size_t(end - data) < length) {
+      return false;
+    }
+    std::memcpy(dest, data, length);
+    data += length;
+    return true;
+  };
+
+  uint32_t format_length;
+  if (!read(&format_length, sizeof(format_length)) ||
+      size_t(end - data) < format_length) {
+    return "<malformed deferred log record>";
+  }
+  std::string_view format(data, format_length);
+  data += format_length;
+  uint8_t arg_count;
+  if (!read(&arg_count, sizeof(arg_count)) || arg_count > kMaxDeferredArgs) {
+    return "<malformed deferred log record>";
+  }
+
+  std::array<DeferredArgValue, kMaxDeferredArgs> values;
+  for (uint8_t i = 0; i < arg_count; ++i) {
+    DeferredArgValue& value = values[i];
+    if (!read(&value.type, sizeof(value.type))) {
+      return std::string(format);
+    }
+    if (value.type == DeferredArgType::kString) {
+      uint32_t length;
+      if (!read(&length, sizeof(length)) || size_t(end - data) < length) {
+        return std::string(format);
+      }
+      value.s = std::string_view(data, length);
+      data += length;
+    } else {
+      // All scalars are stored as 8 bytes from the start of the union.
+      if (!read(&value.u, sizeof(value.u))) {
+        return std::string(format);
+      }
+    }
+  }
+
+  try {
+    return VFormatDeferred(format, values,
+                           std::make_index_sequence<kMaxDeferredArgs>());
+  } catch (const fmt::format_error&) {
+    return std::string(format);
+  }
+}
+
+}  // namespace internal
+}  // namespace logging
+
 void logging::AppendLogLine(LogLevel log_level, const char prefix_char,
                             const std::string_view str, uint32_t log_mask) {
   if (!internal::ShouldLog(log_level, log_mask) || !str.size()) {
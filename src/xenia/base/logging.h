@@ -10,9 +10,13 @@
 #ifndef XENIA_BASE_LOGGING_H_
 #define XENIA_BASE_LOGGING_H_
 
+#include <algorithm>
 #include <cstdarg>
 #include <cstdint>
+#include <cstring>
 #include <string>
+#include <string_view>
+#include <type_traits>
 
 #include "third_party/fmt/include/fmt/format.h"
 #include "xenia/base/string.h"
@@ -91,6 +95,143 @@ std::pair<char*, size_t> GetThreadBuffer();
 XE_NOALIAS
 void AppendLogLine(LogLevel log_level, const char prefix_char, size_t written);
 
+// Deferred formatting (log_deferred_format): instead of running {fmt} on the
+// calling thread, a copy of the format string and a raw copy of the arguments
+// are placed in the thread buffer, and the logging writer thread does the
+// formatting. Only the argument types below can be captured this way; calls
+// with any other argument type (custom formatters, enums) are formatted
+// immediately as usual. The format string is copied rather than referenced
+// because some call sites build it at runtime.
+bool IsFormatDeferred();
+XE_NOALIAS
+void AppendDeferredLogLine(LogLevel log_level, const char prefix_char,
+                           size_t written);
+// Formats a record produced by DeferredRecordWriter, for the writer thread and
+// for tests.
+std::string FormatDeferredRecord(const char* data, size_t size);
+
+enum class DeferredArgType : uint8_t {
+  kBool,
+  kChar,
+  kSigned,
+  kUnsigned,
+  kFloat,
+  kDouble,
+  kPointer,
+  kString,
+};
+
+constexpr size_t kMaxDeferredArgs = 16;
+
+template <typename T>
+constexpr bool IsDeferrableArg() {
+  using U = std::decay_t<T>;
+  if constexpr (std::is_same_v<U, bool> || std::is_same_v<U, char> ||
+                std::is_same_v<U, float> || std::is_same_v<U, double>) {
+    return true;
+  } else if constexpr (std::is_integral_v<U>) {
+    return !std::is_same_v<U, wchar_t> && !std::is_same_v<U, char16_t> &&
+           !std::is_same_v<U, char32_t>;
+  } else {
+    return std::is_same_v<U, const char*> || std::is_same_v<U, char*> ||
+           std::is_same_v<U, const void*> || std::is_same_v<U, void*> ||
+           std::is_same_v<U, std::nullptr_t> ||
+           std::is_same_v<U, std::string> ||
+           std::is_same_v<U, std::string_view>;
+  }
+}
+
+template <typename... Args>
+constexpr bool AreDeferrableArgs() {
+  return sizeof...(Args) <= kMaxDeferredArgs &&
+         (IsDeferrableArg<Args>() && ...);
+}
+
+// Record layout: 32-bit format string length and its characters, argument
+// count, and then for every argument its DeferredArgType followed by 8 bytes of
+// payload, or, for strings, a 32-bit length and the characters (truncated to
+// fit the buffer).
+class DeferredRecordWriter {
+ public:
+  DeferredRecordWriter(char* data, size_t capacity)
+      : data_(data), capacity_(capacity) {}
+
+  size_t size() const { return size_; }
+
+  // Returns false if the format string doesn't fit in the buffer, in which
+  // case the record can't be used.
+  template <typename... Args>
+  bool Write(const char* format, const Args&... args) {
+    uint32_t format_length = uint32_t(std::strlen(format));
+    if (sizeof(format_length) + format_length + sizeof(uint8_t) > capacity_) {
+      return false;
+    }
+    WriteRaw(&format_length, sizeof(format_length));
+    WriteRaw(format, format_length);
+    uint8_t arg_count = uint8_t(sizeof...(Args));
+    WriteRaw(&arg_count, sizeof(arg_count));
+    (WriteArg(args), ...);
+    return true;
+  }
+
+ private:
+  void WriteRaw(const void* src, size_t length) {
+    length = std::min(length, capacity_ - size_);
+    std::memcpy(data_ + size_, src, length);
+    size_ += length;
+  }
+
+  template <typename T>
+  void WriteScalar(DeferredArgType type, T value) {
+    static_assert(sizeof(T) <= sizeof(uint64_t));
+    uint8_t payload[1 + sizeof(uint64_t)] = {uint8_t(type)};
+    std::memcpy(payload + 1, &value, sizeof(T));
+    WriteRaw(payload, sizeof(payload));
+  }
+
+  void WriteString(const char* str, size_t length) {
+    uint8_t type = uint8_t(DeferredArgType::kString);
+    WriteRaw(&type, sizeof(type));
+    size_t header_end = size_ + sizeof(uint32_t);
+    uint32_t stored_length = uint32_t(std::min(
+        length, capacity_ > header_end ? capacity_ - header_end : size_t(0)));
+    WriteRaw(&stored_length, sizeof(stored_length));
+    WriteRaw(str, stored_length);
+  }
+
+  template <typename T>
+  void WriteArg(const T& value) {
+    using U = std::decay_t<T>;
+    if constexpr (std::is_same_v<U, bool>) {
+      WriteScalar(DeferredArgType::kBool, value);
+    } else if constexpr (std::is_same_v<U, char>) {
+      WriteScalar(DeferredArgType::kChar, value);
+    } else if constexpr (std::is_same_v<U, float>) {
+      WriteScalar(DeferredArgType::kFloat, value);
+    } else if constexpr (std::is_same_v<U, double>) {
+      WriteScalar(DeferredArgType::kDouble, value);
+    } else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>) {
+      WriteScalar(DeferredArgType::kSigned, int64_t(value));
+    } else if constexpr (std::is_integral_v<U>) {
+      WriteScalar(DeferredArgType::kUnsigned, uint64_t(value));
+    } else if constexpr (std::is_same_v<U, const char*> ||
+                         std::is_same_v<U, char*>) {
+      const char* str = value;
+      WriteString(str, str ? std::strlen(str) : 0);
+    } else if constexpr (std::is_same_v<U, std::string> ||
+                         std::is_same_v<U, std::string_view>) {
+      WriteString(value.data(), value.size());
+    } else {
+      WriteScalar(DeferredArgType::kPointer,
+                  static_cast<const void*>(value));
+    }
+  }
+
+  char* data_;
+  size_t capacity_;
+  size_t size_ = 0;
+};
+
 }  // namespace internal
 // technically, noalias is incorrect here, these functions do in fact alias
 // global memory, but msvc will not optimize the calls away, and the global
@@ -101,6 +242,15 @@ XE_NOALIAS XE_NOINLINE XE_COLD static void AppendLogLineFormat_Impl(
     LogLevel log_level, const char prefix_char, const char* format,
     const Args&... args) {
   auto target = internal::GetThreadBuffer();
+  if constexpr (internal::AreDeferrableArgs<Args...>()) {
+    if (internal::IsFormatDeferred()) {
+      internal::DeferredRecordWriter writer(target.first, target.second);
+      if (writer.Write(format, args...)) {
+        internal::AppendDeferredLogLine(log_level, prefix_char, writer.size());
+        return;
+      }
+    }
+  }
   auto result = fmt::format_to_n(target.first, target.second, format, args...);
   internal::AppendLogLine(log_level, prefix_char, result.size);
 }
@@ -0,0 +1,286 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/base/bit_range.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "third_party/catch/include/catch.hpp"
+#include "third_party/fmt/include/fmt/format.h"
+
+namespace xe {
+namespace base {
+namespace test {
+
+// 512 MB of 4 KB pages, like the SharedMemory page bitmaps.
+constexpr size_t kBitmapBlocks = (size_t(1) << (29 - 12)) / 64;
+
+static bool GetBit(const std::vector<uint64_t>& bits, size_t bit) {
+  return (bits[bit >> 6] >> (bit & 63)) & 1;
+}
+
+// Mostly set blocks with runs of clear ones and scattered clear bits, so both
+// the long uniform runs and the block edges are covered.
+static std::vector<uint64_t> MakeBitmap(std::mt19937& random) {
+  std::vector<uint64_t> bits(kBitmapBlocks, UINT64_MAX);
+  for (size_t i = 0; i < kBitmapBlocks;) {
+    uint32_t run = random() % 64;
+    switch (random() % 4) {
+      case 0:
+        for (size_t j = 0; j < run && i + j < kBitmapBlocks; ++j) {
+          bits[i + j] = 0;
+        }
+        break;
+      case 1:
+        bits[i] &= ~(uint64_t(1) << (random() % 64));
+        break;
+    }
+    i += run + 1;
+  }
+  return bits;
+}
+
+TEST_CASE("bit_range_find_block", "[bit_range]") {
+  std::vector<uint64_t> bits(64, 0);
+  REQUIRE(bit_range::FindNonZeroBlock(bits.data(), 0, 64) == 64);
+  REQUIRE(bit_range::FindNonFullBlock(bits.data(), 3, 64) == 3);
+#if XE_ARCH_AMD64
+  bool has_avx2 = (amd64::GetFeatureFlags() & amd64::kX64EmitAVX2) != 0;
+#endif  // XE_ARCH_AMD64
+  for (size_t i = 0; i < 64; ++i) {
+    bits.assign(64, 0);
+    bits[i] = uint64_t(1) << (i & 63);
+    REQUIRE(bit_range::FindNonZeroBlock(bits.data(), 0, 64) == i);
+    REQUIRE(bit_range::FindNonZeroBlock(bits.data(), 0, i) == i);
+#if XE_ARCH_AMD64
+    for (size_t first = 0; first <= i; ++first) {
+      REQUIRE(bit_range::FindNonZeroBlockScalar(bits.data(), first, 64) == i);
+      if (has_avx2) {
+        REQUIRE(bit_range::FindNonZeroBlockAVX2(bits.data(), first, 64) == i);
+      }
+    }
+#endif  // XE_ARCH_AMD64
+    bits.assign(64, UINT64_MAX);
+    bits[i] = ~(uint64_t(1) << (i & 63));
+    REQUIRE(bit_range::FindNonFullBlock(bits.data(), 0, 64) == i);
+    REQUIRE(bit_range::FindNonFullBlock(bits.data(), 0, i) == i);
+#if XE_ARCH_AMD64
+    for (size_t first = 0; first <= i; ++first) {
+      REQUIRE(bit_range::FindNonFullBlockScalar(bits.data(), first, 64) == i);
+      if (has_avx2) {
+        REQUIRE(bit_range::FindNonFullBlockAVX2(bits.data(), first, 64) == i);
+      }
+    }
+#endif  // XE_ARCH_AMD64
+  }
+}
+
+TEST_CASE("bit_range_set_clear_any", "[bit_range]") {
+  std::mt19937 random(0x5E7C1EA2);
+  std::vector<uint64_t> bits = MakeBitmap(random);
+  std::vector<uint64_t> expected = bits;
+  for (uint32_t i = 0; i < 2000; ++i) {
+    size_t first = random() % (kBitmapBlocks * 64);
+    size_t length =
+        random() % std::min(size_t(4096), kBitmapBlocks * 64 - first);
+    bool any_set_expected = false;
+    for (size_t j = first; j < first + length; ++j) {
+      any_set_expected |= GetBit(expected, j);
+    }
+    REQUIRE(bit_range::AnySetInRange(bits.data(), first, length) ==
+            any_set_expected);
+    bool set = (i & 1) != 0;
+    for (size_t j = first; j < first + length; ++j) {
+      if (set) {
+        expected[j >> 6] |= uint64_t(1) << (j & 63);
+      } else {
+        expected[j >> 6] &= ~(uint64_t(1) << (j & 63));
+      }
+    }
+    if (set) {
+      bit_range::SetRange(bits.data(), first, length);
+    } else {
+      bit_range::ClearRange(bits.data(), first, length);
+    }
+    REQUIRE(bits == expected);
+  }
+}
+
+TEST_CASE("bit_range_next_unset_range", "[bit_range]") {
+  std::mt19937 random(0x0A11C8E5);
+  std::vector<uint64_t> bits = MakeBitmap(random);
+  for (uint32_t i = 0; i < 500; ++i) {
+    size_t first = random() % (kBitmapBlocks * 64);
+    size_t length = random() % (kBitmapBlocks * 64 - first) + 1;
+    size_t last = first + length - 1;
+    size_t next = first;
+    while (true) {
+      std::pair<size_t, size_t> range =
+          bit_range::NextUnsetRange(bits.data(), next, last + 1 - next);
+      size_t expected_first = next;
+      while (expected_first <= last && GetBit(bits, expected_first)) {
+        ++expected_first;
+      }
+      if (expected_first > last) {
+        REQUIRE(range.second == 0);
+        break;
+      }
+      size_t expected_end = expected_first;
+      while (expected_end <= last && !GetBit(bits, expected_end)) {
+        ++expected_end;
+      }
+      REQUIRE(range.first == expected_first);
+      REQUIRE(range.second == expected_end - expected_first);
+      next = expected_end;
+      if (next > last) {
+        break;
+      }
+    }
+  }
+}
+
+// Not run by default. Run with the "[bit_range_benchmark]" tag.
+// The work SharedMemory does while holding the global critical region for
+// typical requests, with the per-block loops it used before the range
+// functions for comparison.
+TEST_CASE("bit_range_shared_memory_lock_hold_time",
+          "[.][bit_range_benchmark]") {
+  constexpr uint32_t kIterations = 20000;
+  std::mt19937 random(0xB17A4E5);
+  std::vector<uint64_t> valid = MakeBitmap(random);
+  std::vector<uint64_t> resolved(kBitmapBlocks, 0);
+  std::vector<std::pair<size_t, size_t>> uploads;
+  uploads.reserve(kBitmapBlocks * 32);
+
+  auto benchmark = [&](const char* name, size_t page_count, auto&& run) {
+    uint64_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < kIterations; ++i) {
+      size_t page_first =
+          (size_t(i) * 7919) % (kBitmapBlocks * 64 - page_count);
+      checksum += run(page_first, page_count);
+    }
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    fmt::print("{}: {:.1f} ns held per call (checksum {})\n", name,
+               seconds * 1.0e9 / double(kIterations), checksum);
+  };
+
+  // RequestRange - whether any page was resolved, and the ranges to upload.
+  auto request_per_block = [&](size_t page_first, size_t page_count) {
+    size_t page_last = page_first + page_count - 1;
+    size_t block_first = page_first >> 6, block_last = page_last >> 6;
+    bool any_resolved = false;
+    size_t range_start = SIZE_MAX;
+    uploads.clear();
+    for (size_t i = block_first; i <= block_last; ++i) {
+      uint64_t block_valid = valid[i];
+      uint64_t block_resolved = resolved[i];
+      if (i == block_first) {
+        uint64_t block_before = (uint64_t(1) << (page_first & 63)) - 1;
+        block_valid |= block_before;
+        block_resolved &= ~block_before;
+      }
+      if (i == block_last && (page_last & 63) != 63) {
+        uint64_t block_inside = (uint64_t(1) << ((page_last & 63) + 1)) - 1;
+        block_valid |= ~block_inside;
+        block_resolved &= block_inside;
+      }
+      any_resolved |= block_resolved != 0;
+      while (true) {
+        uint32_t block_page;
+        if (range_start == SIZE_MAX) {
+          if (!xe::bit_scan_forward(~block_valid, &block_page)) {
+            break;
+          }
+          range_start = (i << 6) + block_page;
+        } else {
+          uint64_t block_valid_from_start = block_valid;
+          if (i == (range_start >> 6)) {
+            block_valid_from_start &=
+                ~((uint64_t(1) << (range_start & 63)) - 1);
+          }
+          if (!xe::bit_scan_forward(block_valid_from_start, &block_page)) {
+            break;
+          }
+          uploads.emplace_back(range_start,
+                               (i << 6) + block_page - range_start);
+          block_valid |= (uint64_t(1) << block_page) - 1;
+          range_start = SIZE_MAX;
+        }
+      }
+    }
+    if (range_start != SIZE_MAX) {
+      uploads.emplace_back(range_start, page_last + 1 - range_start);
+    }
+    return uploads.size() + any_resolved;
+  };
+  auto request_range = [&](size_t page_first, size_t page_count) {
+    size_t page_end = page_first + page_count;
+    bool any_resolved =
+        bit_range::AnySetInRange(resolved.data(), page_first, page_count);
+    uploads.clear();
+    while (page_first < page_end) {
+      std::pair<size_t, size_t> range = bit_range::NextUnsetRange(
+          valid.data(), page_first, page_end - page_first);
+      if (!range.second) {
+        break;
+      }
+      uploads.push_back(range);
+      page_first = range.first + range.second;
+    }
+    return uploads.size() + any_resolved;
+  };
+
+  // MakeRangeValid and MemoryInvalidationCallback - updating all 3 bitmaps.
+  std::vector<uint64_t> bitmaps[3] = {valid, resolved, resolved};
+  auto update_per_block = [&](size_t page_first, size_t page_count) {
+    size_t page_last = page_first + page_count - 1;
+    size_t block_first = page_first >> 6, block_last = page_last >> 6;
+    for (size_t i = block_first; i <= block_last; ++i) {
+      uint64_t bits = UINT64_MAX;
+      if (i == block_first) {
+        bits &= ~((uint64_t(1) << (page_first & 63)) - 1);
+      }
+      if (i == block_last && (page_last & 63) != 63) {
+        bits &= (uint64_t(1) << ((page_last & 63) + 1)) - 1;
+      }
+      bitmaps[0][i] |= bits;
+      bitmaps[1][i] &= ~bits;
+      bitmaps[2][i] &= ~bits;
+    }
+    return bitmaps[0][block_first];
+  };
+  auto update_range = [&](size_t page_first, size_t page_count) {
+    bit_range::SetRange(bitmaps[0].data(), page_first, page_count);
+    bit_range::ClearRange(bitmaps[1].data(), page_first, page_count);
+    bit_range::ClearRange(bitmaps[2].data(), page_first, page_count);
+    return bitmaps[0][page_first >> 6];
+  };
+
+  // A small vertex buffer, a 1280x720 32bpp render target resolve, and a wide
+  // range like a whole-memory memexport.
+  for (size_t page_count : {size_t(4), size_t(900), size_t(65536)}) {
+    fmt::print("{} pages:\n", page_count);
+    benchmark("  RequestRange, per-block loop", page_count, request_per_block);
+    benchmark("  RequestRange, range functions", page_count, request_range);
+    benchmark("  MakeRangeValid, per-block loop", page_count,
+              update_per_block);
+    benchmark("  MakeRangeValid, range functions", page_count, update_range);
+  }
+}
+
+}  // namespace test
+}  // namespace base
+}  // namespace xe
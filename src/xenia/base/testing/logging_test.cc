@@ -0,0 +1,130 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/base/logging.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+#include "third_party/catch/include/catch.hpp"
+#include "third_party/fmt/include/fmt/format.h"
+
+#include "xenia/base/cvar.h"
+
+DECLARE_bool(log_deferred_format);
+DECLARE_path(log_file);
+DECLARE_bool(log_to_stdout);
+
+namespace xe {
+namespace base {
+namespace test {
+
+template <typename... Args>
+static std::string FormatDeferred(const char* format, const Args&... args) {
+  static_assert(logging::internal::AreDeferrableArgs<Args...>());
+  char buffer[1024];
+  logging::internal::DeferredRecordWriter writer(buffer, sizeof(buffer));
+  REQUIRE(writer.Write(format, args...));
+  return logging::internal::FormatDeferredRecord(buffer, writer.size());
+}
+
+TEST_CASE("Deferred log record matches immediate formatting",
+          "[logging]") {
+  const char* c_string = "c string";
+  std::string string = "std::string";
+  std::string_view string_view = "string_view";
+  int8_t s8 = -8;
+  uint16_t u16 = 0xBEEF;
+  int32_t s32 = -123456;
+  uint32_t u32 = 0x8000F00D;
+  uint64_t u64 = 0x0123456789ABCDEF;
+  float f = 0.1f;
+  double d = 1.0 / 3.0;
+  const void* ptr = reinterpret_cast<const void*>(uintptr_t(0x1000));
+
+  REQUIRE(FormatDeferred("no arguments") == "no arguments");
+  REQUIRE(FormatDeferred("{} {} {}", c_string, string, string_view) ==
+          fmt::format("{} {} {}", c_string, string, string_view));
+  REQUIRE(FormatDeferred("{} {:04X} {:>10} {:08X} {:016X}", s8, u16, s32, u32,
+                         u64) == fmt::format("{} {:04X} {:>10} {:08X} {:016X}",
+                                             s8, u16, s32, u32, u64));
+  REQUIRE(FormatDeferred("{} {} {:.3f}", f, d, d) ==
+          fmt::format("{} {} {:.3f}", f, d, d));
+  REQUIRE(FormatDeferred("{} {} {}", true, 'x', ptr) ==
+          fmt::format("{} {} {}", true, 'x', ptr));
+  REQUIRE(FormatDeferred("{1} {0}", 1, 2) == fmt::format("{1} {0}", 1, 2));
+}
+
+TEST_CASE("Deferred log record copies the format string", "[logging]") {
+  std::string format = "slot {} connected";
+  char buffer[256];
+  logging::internal::DeferredRecordWriter writer(buffer, sizeof(buffer));
+  REQUIRE(writer.Write(format.c_str(), 2));
+  // The writer thread may format the record after the format string is gone.
+  format.assign(format.size(), '#');
+  REQUIRE(logging::internal::FormatDeferredRecord(buffer, writer.size()) ==
+          "slot 2 connected");
+
+  char small_buffer[8];
+  logging::internal::DeferredRecordWriter small_writer(small_buffer,
+                                                       sizeof(small_buffer));
+  REQUIRE(!small_writer.Write("format longer than the buffer", 1));
+}
+
+TEST_CASE("Deferred log record truncates long strings", "[logging]") {
+  std::string long_string(4096, 'a');
+  char buffer[64];
+  logging::internal::DeferredRecordWriter writer(buffer, sizeof(buffer));
+  writer.Write("{}", long_string);
+  REQUIRE(writer.size() == sizeof(buffer));
+  std::string result =
+      logging::internal::FormatDeferredRecord(buffer, writer.size());
+  REQUIRE(!result.empty());
+  REQUIRE(result.size() < long_string.size());
+  REQUIRE(result.find_first_not_of('a') == std::string::npos);
+}
+
+// Not run by default as it writes a log file. Run with the
+// "[logging_benchmark]" tag.
+TEST_CASE("Log call cost", "[.][logging_benchmark]") {
+  constexpr uint32_t kIterations = 200000;
+  // Without a logger, the log calls return before formatting, so attach a real
+  // file sink (and not stdout, which would be dominated by the console).
+  std::filesystem::path old_log_file = cvars::log_file;
+  bool old_log_to_stdout = cvars::log_to_stdout;
+  std::filesystem::path log_path =
+      std::filesystem::temp_directory_path() / "xenia_logging_benchmark.log";
+  cvars::log_file = log_path;
+  cvars::log_to_stdout = false;
+  InitializeLogging("xenia-base-tests");
+  bool old_deferred = cvars::log_deferred_format;
+  for (bool deferred : {false, true}) {
+    cvars::log_deferred_format = deferred;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < kIterations; ++i) {
+      XELOGI("Benchmark {:08X} {} {} {}", i, "NtReadFile", 1.5f, i * 3);
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start);
+    std::printf("%s formatting: %.1f ns per log call\n",
+                deferred ? "Deferred" : "Immediate",
+                double(elapsed.count()) / kIterations);
+  }
+  cvars::log_deferred_format = old_deferred;
+  ShutdownLogging();
+  cvars::log_file = old_log_file;
+  cvars::log_to_stdout = old_log_to_stdout;
+  std::filesystem::remove(log_path);
+}
+
+}  // namespace test
+}  // namespace base
+}  // namespace xe
@@ -319,6 +319,14 @@ X_STATUS Emulator::TerminateTitle() {
   return X_STATUS_SUCCESS;
 }
 
+static std::filesystem::path GetDiscImageIndexCachePath(
+    const std::filesystem::path& cache_root) {
+  if (cache_root.empty()) {
+    return {};
+  }
+  return cache_root / "disc_image_index";
+}
+
 const std::unique_ptr<vfs::Device> Emulator::CreateVfsDevice(
     const std::filesystem::path& path, const std::string_view mount_path) {
   // Must check if the type has changed e.g. XamSwapDisc
@@ -337,7 +345,8 @@ const std::unique_ptr<vfs::Device> Emulator::CreateVfsDevice(
                                                                path);
     } break;
     case FileSignatureType::XISO: {
-      return std::make_unique<vfs::DiscImageDevice>(mount_path, path);
+      return std::make_unique<vfs::DiscImageDevice>(
+          mount_path, path, GetDiscImageIndexCachePath(cache_root_));
     } break;
     case FileSignatureType::ZAR: {
       return std::make_unique<vfs::DiscZarchiveDevice>(mount_path, path);
@@ -479,8 +488,8 @@ Emulator::FileSignatureType Emulator::GetFileSignature(
   }
 
   // Check if XISO
-  std::unique_ptr<vfs::Device> device =
-      std::make_unique<vfs::DiscImageDevice>("", path);
+  std::unique_ptr<vfs::Device> device = std::make_unique<vfs::DiscImageDevice>(
+      "", path, GetDiscImageIndexCachePath(cache_root_));
 
   XELOGI("Checking for XISO");
 
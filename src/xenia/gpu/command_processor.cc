@@ -9,12 +9,15 @@
 
 #include "xenia/gpu/command_processor.h"
 
+#include <algorithm>
 #include <cinttypes>
+#include <utility>
 
 #include "third_party/fmt/include/fmt/format.h"
 #include "xenia/base/byte_stream.h"
 #include "xenia/base/cvar.h"
 #include "xenia/base/logging.h"
+#include "xenia/base/memory.h"
 #include "xenia/base/profiling.h"
 #include "xenia/gpu/gpu_flags.h"
 #include "xenia/gpu/graphics_system.h"
@@ -188,6 +191,7 @@ void CommandProcessor::RestoreRegisters(uint32_t first_register,
   } else {
     std::memcpy(register_file_->values + first_register, register_values,
                 sizeof(uint32_t) * register_count);
+    register_file_->MarkDirty(first_register, register_count);
   }
 }
 
@@ -597,6 +601,7 @@ void CommandProcessor::WriteRegister(uint32_t index, uint32_t value) {
 
   if (XE_LIKELY(index < RegisterFile::kRegisterCount)) {
     register_file_->values[index] = value;
+    register_file_->MarkDirty(index);
 
     // quick pre-test
     // todo: figure out just how unlikely this is. if very (it ought to be,
@@ -626,19 +631,74 @@ void CommandProcessor::WriteRegister(uint32_t index, uint32_t value) {
 void CommandProcessor::WriteRegistersFromMem(uint32_t start_index,
                                              uint32_t* base,
                                              uint32_t num_registers) {
-  for (uint32_t i = 0; i < num_registers; ++i) {
-    uint32_t data = xe::load_and_swap<uint32_t>(base + i);
-    this->WriteRegister(start_index + i, data);
+  if (!num_registers) {
+    return;
+  }
+  if (start_index >= RegisterFile::kRegisterCount ||
+      RegisterFile::kRegisterCount - start_index < num_registers) {
+    XELOGW(
+        "CommandProcessor::WriteRegistersFromMem range out of bounds: {}, {} "
+        "registers",
+        start_index, num_registers);
+    if (start_index >= RegisterFile::kRegisterCount) {
+      return;
+    }
+    num_registers = RegisterFile::kRegisterCount - start_index;
+  }
+  register_file_->MarkDirty(start_index, num_registers);
+  // Registers with side effects on writes (see WriteRegister), sorted. Others
+  // are copied in whole spans between them.
+  static constexpr std::pair<uint32_t, uint32_t> kSpecialRegisterRanges[] = {
+      {XE_GPU_REG_SCRATCH_REG0, XE_GPU_REG_SCRATCH_REG0 + 8},
+      {XE_GPU_REG_COHER_STATUS_HOST, XE_GPU_REG_COHER_STATUS_HOST + 1},
+      {XE_GPU_REG_DC_LUT_RW_INDEX, XE_GPU_REG_DC_LUT_30_COLOR + 1},
+  };
+  uint32_t end_index = start_index + num_registers;
+  uint32_t index = start_index;
+  for (const std::pair<uint32_t, uint32_t>& special_range :
+       kSpecialRegisterRanges) {
+    if (index >= end_index) {
+      return;
+    }
+    uint32_t regular_end = std::min(special_range.first, end_index);
+    if (index < regular_end) {
+      xe::copy_and_swap_32_unaligned(&register_file_->values[index],
+                                     base + (index - start_index),
+                                     regular_end - index);
+      index = regular_end;
+    }
+    uint32_t special_end = std::min(special_range.second, end_index);
+    for (; index < special_end; ++index) {
+      WriteRegister(index,
+                    xe::load_and_swap<uint32_t>(base + (index - start_index)));
+    }
+  }
+  if (index < end_index) {
+    xe::copy_and_swap_32_unaligned(&register_file_->values[index],
+                                   base + (index - start_index),
+                                   end_index - index);
   }
 }
 
 void CommandProcessor::WriteRegisterRangeFromRing(xe::RingBuffer* ring,
                                                   uint32_t base,
                                                   uint32_t num_registers) {
-  for (uint32_t i = 0; i < num_registers; ++i) {
-    uint32_t data = ring->ReadAndSwap<uint32_t>();
-    WriteRegister(base + i, data);
+  // Writing directly from the ring buffer memory, in up to two parts if it
+  // wraps around.
+  RingBuffer::ReadRange range =
+      ring->BeginRead(num_registers * sizeof(uint32_t));
+  uint32_t num_registers_first =
+      uint32_t(range.first_length / sizeof(uint32_t));
+  WriteRegistersFromMem(
+      base, reinterpret_cast<uint32_t*>(const_cast<uint8_t*>(range.first)),
+      num_registers_first);
+  if (range.second) {
+    WriteRegistersFromMem(
+        base + num_registers_first,
+        reinterpret_cast<uint32_t*>(const_cast<uint8_t*>(range.second)),
+        uint32_t(range.second_length / sizeof(uint32_t)));
   }
+  ring->EndRead(range);
 }
 
 void CommandProcessor::WriteALURangeFromRing(xe::RingBuffer* ring,
@@ -753,6 +813,8 @@ void CommandProcessor::PrepareForWait() { trace_writer_.Flush(); }
 void CommandProcessor::ReturnFromWait() {}
 
 void CommandProcessor::InitializeTrace() {
+  trace_frames_since_keyframe_ = 0;
+
   // Write the initial register values, to be loaded directly into the
   // RegisterFile since all registers, including those that may have side
   // effects on setting, will be saved.
@@ -263,6 +263,7 @@ class CommandProcessor {
     kSingleFrame,
   };
   TraceState trace_state_ = TraceState::kDisabled;
+  uint32_t trace_frames_since_keyframe_ = 0;
   std::filesystem::path trace_stream_path_;
   std::filesystem::path trace_frame_path_;
 
@@ -78,7 +78,8 @@ namespace shaders {
 D3D12CommandProcessor::D3D12CommandProcessor(
     D3D12GraphicsSystem* graphics_system, kernel::KernelState* kernel_state)
     : CommandProcessor(graphics_system, kernel_state),
-      deferred_command_list_(*this) {}
+      deferred_command_list_(*this),
+      host_viewport_info_cache_(*register_file_) {}
 D3D12CommandProcessor::~D3D12CommandProcessor() = default;
 
 void D3D12CommandProcessor::ClearCaches() {
@@ -1769,6 +1770,7 @@ void D3D12CommandProcessor::WriteRegisterForceinline(uint32_t index,
   __m128i is_below_upper = _mm_cmplt_epi16(to_rangecheck, upper_bounds);
   __m128i is_within_range = _mm_and_si128(is_above_lower, is_below_upper);
   register_file_->values[index] = value;
+  register_file_->MarkDirty(index);
 
   uint32_t movmask = static_cast<uint32_t>(_mm_movemask_epi8(is_within_range));
 
@@ -2070,6 +2072,7 @@ D3D12CommandProcessor::WriteRegisterRangeFromMem_WithKnownBound(
     uint32_t start_index, uint32_t* base, uint32_t num_registers) {
   uint32_t end = start_index + num_registers;
   LogRegisterSets(start_index, base, num_registers);
+  register_file_->MarkDirty(start_index, num_registers);
   uint32_t current_index = start_index;
 
   auto get_end_before_qty = [&end, current_index](uint32_t regnum) {
@@ -2711,7 +2714,6 @@ bool D3D12CommandProcessor::IssueDraw(xenos::PrimitiveType primitive_type,
   // Get dynamic rasterizer state.
   uint32_t draw_resolution_scale_x = texture_cache_->draw_resolution_scale_x();
   uint32_t draw_resolution_scale_y = texture_cache_->draw_resolution_scale_y();
-  draw_util::ViewportInfo viewport_info;
   draw_util::GetViewportInfoArgs gviargs{};
 
   gviargs.Setup(
@@ -2723,15 +2725,8 @@ bool D3D12CommandProcessor::IssueDraw(xenos::PrimitiveType primitive_type,
       host_render_targets_used &&
           render_target_cache_->depth_float24_convert_in_pixel_shader(),
       host_render_targets_used, pixel_shader && pixel_shader->writes_depth());
-  gviargs.SetupRegisterValues(regs);
-
-  if (gviargs == previous_viewport_info_args_) {
-    viewport_info = previous_viewport_info_;
-  } else {
-    draw_util::GetHostViewportInfo(&gviargs, viewport_info);
-    previous_viewport_info_args_ = gviargs;
-    previous_viewport_info_ = viewport_info;
-  }
+  const draw_util::ViewportInfo& viewport_info =
+      host_viewport_info_cache_.GetHostViewportInfo(gviargs);
   // todo: use SIMD for getscissor + scaling here, should reduce code size more
   draw_util::Scissor scissor;
   draw_util::GetScissor(regs, scissor);
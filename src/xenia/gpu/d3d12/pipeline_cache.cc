@@ -247,6 +247,22 @@ void PipelineCache::InitializeShaderStorage(
     }
   }
 
+  // For the ucode analysis results, which are stored in the host's structure
+  // layout.
+  auto shader_storage_local_root = shader_storage_root / "local";
+  if (!std::filesystem::exists(shader_storage_local_root) &&
+      !std::filesystem::create_directories(shader_storage_local_root)) {
+    XELOGW(
+        "Failed to create the local shader storage directory, the ucode "
+        "analysis results will not be stored: {}",
+        xe::path_to_utf8(shader_storage_local_root));
+  } else {
+    // Before analyzing the shaders from the storage.
+    ucode_analysis_cache_.Open(
+        shader_storage_local_root /
+        fmt::format("{:08X}.ucode_analysis.bin", title_id));
+  }
+
   bool edram_rov_used = render_target_cache_.GetPath() ==
                         RenderTargetCache::Path::kPixelShaderInterlock;
 
@@ -428,7 +444,8 @@ void PipelineCache::InitializeShaderStorage(
           break;
         }
         if (!shader_to_translate->is_ucode_analyzed()) {
-          shader_to_translate->AnalyzeUcode(ucode_disasm_buffer);
+          ucode_analysis_cache_.AnalyzeUcode(*shader_to_translate,
+                                             ucode_disasm_buffer);
         }
         // Translate each needed modification on this thread after performing
         // modification-independent analysis of the whole shader.
@@ -788,6 +805,8 @@ void PipelineCache::ShutdownShaderStorage() {
     shader_storage_file_flush_needed_ = false;
   }
 
+  ucode_analysis_cache_.Close();
+
   shader_storage_cache_root_.clear();
   shader_storage_title_id_ = 0;
 }
@@ -982,9 +1001,7 @@ bool PipelineCache::ConfigurePipeline(
                   xenos::VertexShaderExportMode::kPosition2VectorsEdgeKill);
   assert_false(register_file_.Get<reg::SQ_PROGRAM_CNTL>().gen_index_vtx);
   if (!vertex_shader->is_translated()) {
-    if (!vertex_shader->shader().is_ucode_analyzed()) {
-      vertex_shader->shader().AnalyzeUcode(ucode_disasm_buffer_);
-    }
+    AnalyzeShaderUcode(vertex_shader->shader());
     if (!TranslateAnalyzedShader(*shader_translator_, *vertex_shader,
                                  dxbc_converter_, dxc_utils_, dxc_compiler_)) {
       XELOGE("Failed to translate the vertex shader!");
@@ -1008,9 +1025,7 @@ bool PipelineCache::ConfigurePipeline(
   }
   if (pixel_shader != nullptr) {
     if (!pixel_shader->is_translated()) {
-      if (!pixel_shader->shader().is_ucode_analyzed()) {
-        pixel_shader->shader().AnalyzeUcode(ucode_disasm_buffer_);
-      }
+      AnalyzeShaderUcode(pixel_shader->shader());
       if (!TranslateAnalyzedShader(*shader_translator_, *pixel_shader,
                                    dxbc_converter_, dxc_utils_,
                                    dxc_compiler_)) {
@@ -34,6 +34,7 @@
 #include "xenia/gpu/primitive_processor.h"
 #include "xenia/gpu/register_file.h"
 #include "xenia/gpu/registers.h"
+#include "xenia/gpu/ucode_analysis_cache.h"
 #include "xenia/gpu/xenos.h"
 #include "xenia/ui/d3d12/d3d12_api.h"
 
@@ -72,7 +73,7 @@ class PipelineCache {
   // Analyze shader microcode on the translator thread.
   void AnalyzeShaderUcode(Shader& shader) {
     if (!shader.is_ucode_analyzed()) {
-      shader.AnalyzeUcode(ucode_disasm_buffer_);
+      ucode_analysis_cache_.AnalyzeUcode(shader, ucode_disasm_buffer_);
     }
   }
 
@@ -313,6 +314,9 @@ class PipelineCache {
 
   // Temporary storage for AnalyzeUcode calls on the processor thread.
   StringBuffer ucode_disasm_buffer_;
+  // Analysis results of the shaders from the previous runs, in the local shader
+  // storage of the current title.
+  UcodeAnalysisCache ucode_analysis_cache_;
   // Reusable shader translator for the processor thread.
   std::unique_ptr<DxbcShaderTranslator> shader_translator_;
 
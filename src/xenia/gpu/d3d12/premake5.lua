@@ -51,6 +51,7 @@ project("xenia-gpu-d3d12-trace-viewer")
     "mspack",
     "snappy",
     "xxhash",
+    "zstd",
   })
   files({
     "d3d12_trace_viewer_main.cc",
@@ -103,6 +104,7 @@ project("xenia-gpu-d3d12-trace-dump")
     "mspack",
     "snappy",
     "xxhash",
+    "zstd",
   })
   files({
     "d3d12_trace_dump_main.cc",
@@ -15,6 +15,7 @@
 
 #include "xenia/base/assert.h"
 #include "xenia/base/cvar.h"
+#include "xenia/base/math.h"
 #include "xenia/base/memory.h"
 #include "xenia/base/profiling.h"
 #include "xenia/gpu/registers.h"
@@ -48,27 +49,42 @@ DEFINE_bool(
     "some games draw rectangles (for their UI, for instance) without clipping, "
     "but with a proper scissor rectangle.",
     "GPU");
+DEFINE_bool(
+    execute_unclipped_draw_vs_on_cpu_jit, false,
+    "Compile the vertex shaders executed on the CPU for "
+    "execute_unclipped_draw_vs_on_cpu to native code processing multiple "
+    "vertices at once instead of interpreting them, where possible.\n"
+    "Experimental - may produce results different from the interpreter, and "
+    "only available in builds with the gpu-shader-jit premake option.",
+    "GPU");
 
 namespace xe {
 namespace gpu {
 
-void DrawExtentEstimator::PositionYExportSink::Export(
+void DrawExtentEstimator::PositionYExportSink::ExportBatch(
     ucode::ExportRegister export_register, const float* value,
-    uint32_t value_mask) {
-  if (export_register == ucode::ExportRegister::kVSPosition) {
-    if (value_mask & 0b0010) {
-      position_y_ = value[1];
-    }
-    if (value_mask & 0b1000) {
-      position_w_ = value[3];
-    }
-  } else if (export_register ==
-             ucode::ExportRegister::kVSPointSizeEdgeFlagKillVertex) {
-    if (value_mask & 0b0001) {
-      point_size_ = value[0];
-    }
-    if (value_mask & 0b0100) {
-      vertex_kill_ = xe::memory::Reinterpret<uint32_t>(value[2]);
+    uint32_t value_mask, uint32_t lane_mask) {
+  constexpr uint32_t kBatchSize = ShaderInterpreter::kBatchSize;
+  uint32_t lanes_remaining = lane_mask;
+  uint32_t lane;
+  while (xe::bit_scan_forward(lanes_remaining, &lane)) {
+    lanes_remaining &= ~(UINT32_C(1) << lane);
+    if (export_register == ucode::ExportRegister::kVSPosition) {
+      if (value_mask & 0b0010) {
+        position_y_[lane] = value[kBatchSize * 1 + lane];
+      }
+      if (value_mask & 0b1000) {
+        position_w_[lane] = value[kBatchSize * 3 + lane];
+      }
+    } else if (export_register ==
+               ucode::ExportRegister::kVSPointSizeEdgeFlagKillVertex) {
+      if (value_mask & 0b0001) {
+        point_size_[lane] = value[kBatchSize * 0 + lane];
+      }
+      if (value_mask & 0b0100) {
+        vertex_kill_[lane] =
+            xe::memory::Reinterpret<uint32_t>(value[kBatchSize * 2 + lane]);
+      }
     }
   }
 }
@@ -166,12 +182,8 @@ uint32_t DrawExtentEstimator::EstimateVertexMaxY(const Shader& vertex_shader) {
         float(regs.Get<reg::PA_SU_POINT_SIZE>().height) * (1.0f / 16.0f);
   }
 
-  float max_y = -FLT_MAX;
-
-  shader_interpreter_.SetShader(vertex_shader);
-
-  PositionYExportSink position_y_export_sink;
-  shader_interpreter_.SetExportSink(&position_y_export_sink);
+  vertex_indices_.clear();
+  vertex_indices_.reserve(vgt_draw_initiator.num_indices);
   for (uint32_t i = 0; i < vgt_draw_initiator.num_indices; ++i) {
     uint32_t vertex_index;
     if (vgt_draw_initiator.source_select == xenos::SourceSelect::kDMA) {
@@ -194,35 +206,37 @@ uint32_t DrawExtentEstimator::EstimateVertexMaxY(const Shader& vertex_shader) {
                   xenos::SourceSelect::kAutoIndex);
       vertex_index = i;
     }
-    vertex_index =
-        std::min(max_index,
-                 std::max(min_index, (vertex_index + index_offset) & 0xFFFFFF));
-
-    position_y_export_sink.Reset();
+    vertex_indices_.push_back(std::min(
+        max_index,
+        std::max(min_index, (vertex_index + index_offset) & 0xFFFFFF)));
+  }
 
-    shader_interpreter_.temp_registers()[0] = float(vertex_index);
-    shader_interpreter_.Execute();
+  float max_y = -FLT_MAX;
 
-    if (position_y_export_sink.vertex_kill().has_value() &&
-        (position_y_export_sink.vertex_kill().value() & ~(UINT32_C(1) << 31))) {
-      continue;
+  auto add_vertex = [&](const std::optional<float>& position_y,
+                        const std::optional<float>& position_w,
+                        const std::optional<float>& point_size,
+                        const std::optional<uint32_t>& vertex_kill) {
+    if (vertex_kill.has_value() &&
+        (vertex_kill.value() & ~(UINT32_C(1) << 31))) {
+      return;
     }
-    if (!position_y_export_sink.position_y().has_value()) {
-      continue;
+    if (!position_y.has_value()) {
+      return;
     }
-    float vertex_y = position_y_export_sink.position_y().value();
+    float vertex_y = position_y.value();
     if (!pa_cl_vte_cntl.vtx_xy_fmt) {
-      if (!position_y_export_sink.position_w().has_value()) {
-        continue;
+      if (!position_w.has_value()) {
+        return;
       }
-      vertex_y /= position_y_export_sink.position_w().value();
+      vertex_y /= position_w.value();
     }
 
     vertex_y = vertex_y * viewport_y_scale + viewport_y_offset;
 
     if (vgt_draw_initiator.prim_type == xenos::PrimitiveType::kPointList) {
       float point_radius_y;
-      if (position_y_export_sink.point_size().has_value()) {
+      if (point_size.has_value()) {
         // Vertex-specified diameter. Clamped effectively as a signed integer in
         // the hardware, -NaN, -Infinity ... -0 to the minimum, +Infinity, +NaN
         // to the maximum.
@@ -230,9 +244,9 @@ uint32_t DrawExtentEstimator::EstimateVertexMaxY(const Shader& vertex_shader) {
             0.5f *
             xe::memory::Reinterpret<float>(std::min(
                 point_vertex_max_diameter_float,
-                std::max(point_vertex_min_diameter_float,
-                         xe::memory::Reinterpret<int32_t>(
-                             position_y_export_sink.point_size().value()))));
+                std::max(
+                    point_vertex_min_diameter_float,
+                    xe::memory::Reinterpret<int32_t>(point_size.value()))));
       } else {
         // Constant radius.
         point_radius_y = point_constant_radius_y;
@@ -243,8 +257,63 @@ uint32_t DrawExtentEstimator::EstimateVertexMaxY(const Shader& vertex_shader) {
     // std::max is `a < b ? b : a`, thus in case of NaN, the first argument is
     // always returned - max_y, which is initialized to a normalized value.
     max_y = std::max(max_y, vertex_y);
+  };
+
+  const ShaderJit::CompiledShader* compiled_shader =
+      cvars::execute_unclipped_draw_vs_on_cpu_jit
+          ? shader_jit_.GetCompiledShader(vertex_shader)
+          : nullptr;
+  if (compiled_shader) {
+    uint32_t vertex_count = uint32_t(vertex_indices_.size());
+    vertex_exports_.resize(vertex_count * ShaderJit::kExportComponentCount);
+    shader_jit_.Execute(*compiled_shader, vertex_indices_.data(), vertex_count,
+                        vertex_exports_.data());
+    // Exports are the same for all vertices in the compiled code.
+    uint32_t export_mask = ShaderJit::GetExportMask(*compiled_shader);
+    auto get_export = [export_mask](const float* vertex_exports,
+                                    ShaderJit::ExportComponent component) {
+      return (export_mask & (UINT32_C(1) << component))
+                 ? std::optional<float>(vertex_exports[component])
+                 : std::nullopt;
+    };
+    for (uint32_t i = 0; i < vertex_count; ++i) {
+      const float* vertex_exports =
+          vertex_exports_.data() + i * ShaderJit::kExportComponentCount;
+      std::optional<uint32_t> vertex_kill;
+      if (export_mask & (UINT32_C(1) << ShaderJit::kExportVertexKill)) {
+        vertex_kill = xe::memory::Reinterpret<uint32_t>(
+            vertex_exports[ShaderJit::kExportVertexKill]);
+      }
+      add_vertex(get_export(vertex_exports, ShaderJit::kExportPositionY),
+                 get_export(vertex_exports, ShaderJit::kExportPositionW),
+                 get_export(vertex_exports, ShaderJit::kExportPointSize),
+                 vertex_kill);
+    }
+  } else {
+    shader_interpreter_.SetShader(vertex_shader);
+    PositionYExportSink position_y_export_sink;
+    shader_interpreter_.SetExportSink(&position_y_export_sink);
+    uint32_t vertex_count = uint32_t(vertex_indices_.size());
+    for (uint32_t i = 0; i < vertex_count;
+         i += ShaderInterpreter::kBatchSize) {
+      uint32_t lane_count =
+          std::min(vertex_count - i, ShaderInterpreter::kBatchSize);
+      position_y_export_sink.Reset();
+      // r0.x of each lane.
+      for (uint32_t j = 0; j < lane_count; ++j) {
+        shader_interpreter_.batch_temp_registers()[j] =
+            float(vertex_indices_[i + j]);
+      }
+      shader_interpreter_.ExecuteBatch(lane_count);
+      for (uint32_t j = 0; j < lane_count; ++j) {
+        add_vertex(position_y_export_sink.position_y(j),
+                   position_y_export_sink.position_w(j),
+                   position_y_export_sink.point_size(j),
+                   position_y_export_sink.vertex_kill(j));
+      }
+    }
+    shader_interpreter_.SetExportSink(nullptr);
   }
-  shader_interpreter_.SetExportSink(nullptr);
 
   int32_t max_y_24p8 = ui::FloatToD3D11Fixed16p8(max_y);
   // 16p8 range is -32768 to 32767+255/256, but it's stored as uint32_t here,
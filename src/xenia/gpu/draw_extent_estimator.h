@@ -12,10 +12,12 @@
 
 #include <cstdint>
 #include <optional>
+#include <vector>
 
 #include "xenia/gpu/register_file.h"
 #include "xenia/gpu/shader.h"
 #include "xenia/gpu/shader_interpreter.h"
+#include "xenia/gpu/shader_jit.h"
 #include "xenia/gpu/trace_writer.h"
 #include "xenia/memory.h"
 
@@ -29,8 +31,10 @@ class DrawExtentEstimator {
       : register_file_(register_file),
         memory_(memory),
         trace_writer_(trace_writer),
-        shader_interpreter_(register_file, memory) {
+        shader_interpreter_(register_file, memory),
+        shader_jit_(register_file, memory) {
     shader_interpreter_.SetTraceWriter(trace_writer);
+    shader_jit_.SetTraceWriter(trace_writer);
   }
 
   // The shader must have its ucode analyzed.
@@ -39,28 +43,39 @@ class DrawExtentEstimator {
                         const Shader& vertex_shader);
 
  private:
+  // Receives the exports of a batch of vertices from the interpreter.
   class PositionYExportSink : public ShaderInterpreter::ExportSink {
    public:
-    void Export(ucode::ExportRegister export_register, const float* value,
-                uint32_t value_mask) override;
+    void ExportBatch(ucode::ExportRegister export_register, const float* value,
+                     uint32_t value_mask, uint32_t lane_mask) override;
 
     void Reset() {
-      position_y_.reset();
-      position_w_.reset();
-      point_size_.reset();
-      vertex_kill_.reset();
+      for (uint32_t i = 0; i < ShaderInterpreter::kBatchSize; ++i) {
+        position_y_[i].reset();
+        position_w_[i].reset();
+        point_size_[i].reset();
+        vertex_kill_[i].reset();
+      }
     }
 
-    const std::optional<float>& position_y() const { return position_y_; }
-    const std::optional<float>& position_w() const { return position_w_; }
-    const std::optional<float>& point_size() const { return point_size_; }
-    const std::optional<uint32_t>& vertex_kill() const { return vertex_kill_; }
+    const std::optional<float>& position_y(uint32_t lane) const {
+      return position_y_[lane];
+    }
+    const std::optional<float>& position_w(uint32_t lane) const {
+      return position_w_[lane];
+    }
+    const std::optional<float>& point_size(uint32_t lane) const {
+      return point_size_[lane];
+    }
+    const std::optional<uint32_t>& vertex_kill(uint32_t lane) const {
+      return vertex_kill_[lane];
+    }
 
    private:
-    std::optional<float> position_y_;
-    std::optional<float> position_w_;
-    std::optional<float> point_size_;
-    std::optional<uint32_t> vertex_kill_;
+    std::optional<float> position_y_[ShaderInterpreter::kBatchSize];
+    std::optional<float> position_w_[ShaderInterpreter::kBatchSize];
+    std::optional<float> point_size_[ShaderInterpreter::kBatchSize];
+    std::optional<uint32_t> vertex_kill_[ShaderInterpreter::kBatchSize];
   };
 
   const RegisterFile& register_file_;
@@ -68,6 +83,11 @@ class DrawExtentEstimator {
   TraceWriter* trace_writer_;
 
   ShaderInterpreter shader_interpreter_;
+  ShaderJit shader_jit_;
+
+  // Reused between draws to avoid allocations.
+  std::vector<uint32_t> vertex_indices_;
+  std::vector<float> vertex_exports_;
 };
 
 }  // namespace gpu
@@ -544,6 +544,37 @@ void GetHostViewportInfo(GetViewportInfoArgs* XE_RESTRICT args,
     viewport_info_out.ndc_offset[i] = ndc_offset[i];
   }
 }
+
+const ViewportInfo& HostViewportInfoCache::GetHostViewportInfo(
+    GetViewportInfoArgs& args) {
+  // The registers loaded by GetViewportInfoArgs::SetupRegisterValues.
+  bool registers_dirty =
+      !is_valid_ ||
+      register_dirty_tracker_.IsDirty(XE_GPU_REG_RB_DEPTH_INFO) ||
+      register_dirty_tracker_.IsDirty(XE_GPU_REG_PA_SC_WINDOW_OFFSET) ||
+      register_dirty_tracker_.IsDirty(
+          XE_GPU_REG_PA_CL_VPORT_XSCALE,
+          XE_GPU_REG_PA_CL_VPORT_ZOFFSET + 1 - XE_GPU_REG_PA_CL_VPORT_XSCALE) ||
+      register_dirty_tracker_.IsDirty(
+          XE_GPU_REG_PA_CL_CLIP_CNTL,
+          XE_GPU_REG_PA_CL_VTE_CNTL + 1 - XE_GPU_REG_PA_CL_CLIP_CNTL) ||
+      register_dirty_tracker_.IsDirty(XE_GPU_REG_PA_SU_VTX_CNTL);
+  if (registers_dirty) {
+    register_dirty_tracker_.ClearDirty(RegisterFile::DirtyGroup::kRenderState);
+    args.SetupRegisterValues(regs_);
+  } else {
+    args.CopyRegisterValues(args_);
+  }
+  if (is_valid_ && args == args_) {
+    register_dirty_tracker_.CountUpdates(0, 1);
+    return viewport_info_;
+  }
+  register_dirty_tracker_.CountUpdates(1, 0);
+  args_ = args;
+  draw_util::GetHostViewportInfo(&args, viewport_info_);
+  is_valid_ = true;
+  return viewport_info_;
+}
 template <bool clamp_to_surface_pitch>
 static inline void GetScissorTmpl(const RegisterFile& XE_RESTRICT regs,
                                   Scissor& XE_RESTRICT scissor_out) {
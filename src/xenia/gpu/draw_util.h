@@ -382,6 +382,20 @@ struct GetViewportInfoArgs {
     pa_sc_window_offset = regs.Get<reg::PA_SC_WINDOW_OFFSET>();
     depth_format = regs.Get<reg::RB_DEPTH_INFO>().depth_format;
   }
+  void CopyRegisterValues(const GetViewportInfoArgs& other) {
+    pa_cl_clip_cntl = other.pa_cl_clip_cntl;
+    pa_cl_vte_cntl = other.pa_cl_vte_cntl;
+    pa_su_sc_mode_cntl = other.pa_su_sc_mode_cntl;
+    pa_su_vtx_cntl = other.pa_su_vtx_cntl;
+    PA_CL_VPORT_XSCALE = other.PA_CL_VPORT_XSCALE;
+    PA_CL_VPORT_YSCALE = other.PA_CL_VPORT_YSCALE;
+    PA_CL_VPORT_ZSCALE = other.PA_CL_VPORT_ZSCALE;
+    PA_CL_VPORT_XOFFSET = other.PA_CL_VPORT_XOFFSET;
+    PA_CL_VPORT_YOFFSET = other.PA_CL_VPORT_YOFFSET;
+    PA_CL_VPORT_ZOFFSET = other.PA_CL_VPORT_ZOFFSET;
+    pa_sc_window_offset = other.pa_sc_window_offset;
+    depth_format = other.depth_format;
+  }
   XE_FORCEINLINE
   bool operator==(const GetViewportInfoArgs& prev) {
 #if XE_ARCH_AMD64 == 0
@@ -434,6 +448,30 @@ struct GetViewportInfoArgs {
 void GetHostViewportInfo(GetViewportInfoArgs* XE_RESTRICT args,
                          ViewportInfo& viewport_info_out);
 
+// Reuses the result of GetHostViewportInfo from the previous draw if neither
+// the viewport registers nor the other arguments have been changed, without
+// reloading the registers if they haven't been written.
+class HostViewportInfoCache {
+ public:
+  explicit HostViewportInfoCache(const RegisterFile& regs)
+      : regs_(regs), register_dirty_tracker_(regs) {}
+
+  // The arguments other than the register values must be set up with Setup.
+  const ViewportInfo& GetHostViewportInfo(GetViewportInfoArgs& args);
+
+  // GetHostViewportInfo calculations performed and skipped in the last frame.
+  const RegisterFile::DirtyTracker::Statistics& last_frame_statistics() const {
+    return register_dirty_tracker_.last_frame_statistics();
+  }
+
+ private:
+  const RegisterFile& regs_;
+  RegisterFile::DirtyTracker register_dirty_tracker_;
+  bool is_valid_ = false;
+  GetViewportInfoArgs args_;
+  ViewportInfo viewport_info_;
+};
+
 struct alignas(16) Scissor {
   // Offset from render target UV = 0 to +UV.
   uint32_t offset[2];
@@ -12,6 +12,12 @@
 DEFINE_path(trace_gpu_prefix, "scratch/gpu/",
             "Prefix path for GPU trace files.", "GPU");
 DEFINE_bool(trace_gpu_stream, false, "Trace all GPU packets.", "GPU");
+DEFINE_uint32(trace_gpu_keyframe_interval, 0,
+              "Number of frames between the full GPU state snapshots written "
+              "to streamed GPU traces, which the trace viewer can seek to "
+              "without replaying the trace from the start. 0 to only write "
+              "the snapshot at the beginning of the trace.",
+              "GPU");
 
 DEFINE_path(
     dump_shaders, "",
@@ -13,6 +13,7 @@
 
 DECLARE_path(trace_gpu_prefix);
 DECLARE_bool(trace_gpu_stream);
+DECLARE_uint32(trace_gpu_keyframe_interval);
 
 DECLARE_path(dump_shaders);
 
@@ -0,0 +1,418 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "xenia/base/console_app_main.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/string.h"
+#include "xenia/base/string_buffer.h"
+#include "xenia/base/xxhash.h"
+#include "xenia/emulator.h"
+#include "xenia/gpu/draw_extent_estimator.h"
+#include "xenia/gpu/gpu_flags.h"
+#include "xenia/gpu/null/null_command_processor.h"
+#include "xenia/gpu/null/null_graphics_system.h"
+#include "xenia/gpu/primitive_processor.h"
+#include "xenia/gpu/shared_memory.h"
+#include "xenia/gpu/trace_player.h"
+
+DECLARE_path(target_trace_file);
+
+DEFINE_uint32(trace_benchmark_iterations, 3,
+              "Number of times the trace benchmark plays the trace.", "GPU");
+
+namespace xe {
+namespace gpu {
+namespace null {
+
+// Tracks the validity of the pages like the host backends, but uploads
+// nothing.
+class BenchmarkSharedMemory : public SharedMemory {
+ public:
+  explicit BenchmarkSharedMemory(Memory& memory) : SharedMemory(memory) {}
+  ~BenchmarkSharedMemory() override { ShutdownCommon(); }
+
+  void Initialize() { InitializeCommon(); }
+
+ protected:
+  bool UploadRanges(const std::pair<uint32_t, uint32_t>* upload_page_ranges,
+                    uint32_t num_upload_ranges) override {
+    for (uint32_t i = 0; i < num_upload_ranges; ++i) {
+      MakeRangeValid(upload_page_ranges[i].first << page_size_log2(),
+                     upload_page_ranges[i].second << page_size_log2(), false,
+                     false);
+    }
+    return true;
+  }
+};
+
+// Converts the indices to host memory that is reused every frame.
+class BenchmarkPrimitiveProcessor : public PrimitiveProcessor {
+ public:
+  BenchmarkPrimitiveProcessor(const RegisterFile& register_file,
+                              Memory& memory, TraceWriter& trace_writer,
+                              SharedMemory& shared_memory)
+      : PrimitiveProcessor(register_file, memory, trace_writer,
+                           shared_memory) {}
+  ~BenchmarkPrimitiveProcessor() override { ShutdownCommon(); }
+
+  bool Initialize() {
+    // Without fans, loops and quads, so they're converted on the CPU like on
+    // the hosts not supporting them.
+    return InitializeCommon(true, false, false, false, true, true);
+  }
+
+  void EndFrame() {
+    ClearPerFrameCache();
+    frame_index_buffers_used_ = 0;
+  }
+
+ protected:
+  bool InitializeBuiltinIndexBuffer(
+      size_t size_bytes, std::function<void(void*)> fill_callback) override {
+    builtin_index_buffer_.resize(size_bytes);
+    fill_callback(builtin_index_buffer_.data());
+    return true;
+  }
+
+  void* RequestHostConvertedIndexBufferForCurrentFrame(
+      xenos::IndexFormat format, uint32_t index_count, bool coalign_for_simd,
+      uint32_t coalignment_original_address,
+      size_t& backend_handle_out) override {
+    size_t index_size = format == xenos::IndexFormat::kInt16
+                            ? sizeof(uint16_t)
+                            : sizeof(uint32_t);
+    if (frame_index_buffers_used_ >= frame_index_buffers_.size()) {
+      frame_index_buffers_.emplace_back();
+    }
+    std::vector<uint8_t>& buffer =
+        frame_index_buffers_[frame_index_buffers_used_];
+    buffer.resize(index_size * index_count +
+                  (coalign_for_simd ? XE_GPU_PRIMITIVE_PROCESSOR_SIMD_SIZE
+                                    : 0));
+    uint8_t* mapping = buffer.data();
+    if (coalign_for_simd) {
+      mapping +=
+          GetSimdCoalignmentOffset(mapping, coalignment_original_address);
+    }
+    backend_handle_out = frame_index_buffers_used_++;
+    return mapping;
+  }
+
+ private:
+  std::vector<uint8_t> builtin_index_buffer_;
+  std::vector<std::vector<uint8_t>> frame_index_buffers_;
+  size_t frame_index_buffers_used_ = 0;
+};
+
+// Runs the parts of the draws that don't depend on the host GPU API.
+class BenchmarkCommandProcessor : public NullCommandProcessor {
+ public:
+  enum class Stage {
+    kShaderAnalysis,
+    kVertexBuffers,
+    kPrimitiveProcessing,
+    kDrawExtentEstimation,
+
+    kCount,
+  };
+
+  struct Statistics {
+    uint64_t draws = 0;
+    uint64_t copies = 0;
+    uint64_t swaps = 0;
+    uint64_t shaders_loaded = 0;
+    uint64_t shaders_analyzed = 0;
+    uint64_t index_conversions = 0;
+    uint64_t index_conversions_avoided = 0;
+    std::chrono::steady_clock::duration stage_times[size_t(Stage::kCount)] =
+        {};
+  };
+
+  BenchmarkCommandProcessor(NullGraphicsSystem* graphics_system,
+                            kernel::KernelState* kernel_state)
+      : NullCommandProcessor(graphics_system, kernel_state) {}
+
+  // Only access while the trace isn't playing.
+  Statistics& statistics() { return statistics_; }
+
+  void TracePlaybackWroteMemory(uint32_t base_ptr, uint32_t length) override {
+    shared_memory_->MemoryInvalidationCallback(base_ptr, length, true);
+    primitive_processor_->MemoryInvalidationCallback(base_ptr, length, true);
+  }
+
+  void ClearCaches() override {
+    CommandProcessor::ClearCaches();
+    shared_memory_->ClearCache();
+  }
+
+ private:
+  class StageTimer {
+   public:
+    StageTimer(Statistics& statistics, Stage stage)
+        : time_(statistics.stage_times[size_t(stage)]),
+          start_(std::chrono::steady_clock::now()) {}
+    ~StageTimer() { time_ += std::chrono::steady_clock::now() - start_; }
+
+   private:
+    std::chrono::steady_clock::duration& time_;
+    std::chrono::steady_clock::time_point start_;
+  };
+
+  bool SetupContext() override {
+    if (!CommandProcessor::SetupContext()) {
+      return false;
+    }
+    shared_memory_ = std::make_unique<BenchmarkSharedMemory>(*memory_);
+    shared_memory_->Initialize();
+    primitive_processor_ = std::make_unique<BenchmarkPrimitiveProcessor>(
+        *register_file_, *memory_, trace_writer_, *shared_memory_);
+    if (!primitive_processor_->Initialize()) {
+      XELOGE("Failed to initialize the primitive processor");
+      return false;
+    }
+    draw_extent_estimator_ = std::make_unique<DrawExtentEstimator>(
+        *register_file_, *memory_, nullptr);
+    return true;
+  }
+
+  void ShutdownContext() override {
+    draw_extent_estimator_.reset();
+    primitive_processor_.reset();
+    shared_memory_.reset();
+    shaders_.clear();
+    CommandProcessor::ShutdownContext();
+  }
+
+  void IssueSwap(uint32_t frontbuffer_ptr, uint32_t frontbuffer_width,
+                 uint32_t frontbuffer_height) override {
+    ++statistics_.swaps;
+    primitive_processor_->EndFrame();
+    const PrimitiveProcessor::PersistentCacheStatistics&
+        primitive_processor_statistics =
+            primitive_processor_->last_frame_persistent_cache_statistics();
+    statistics_.index_conversions += primitive_processor_statistics.conversions;
+    statistics_.index_conversions_avoided +=
+        primitive_processor_statistics.conversions_avoided;
+  }
+
+  Shader* LoadShader(xenos::ShaderType shader_type, uint32_t guest_address,
+                     const uint32_t* host_address,
+                     uint32_t dword_count) override {
+    uint64_t data_hash =
+        XXH3_64bits(host_address, dword_count * sizeof(uint32_t));
+    auto it = shaders_.find(data_hash);
+    if (it != shaders_.end()) {
+      return it->second.get();
+    }
+    ++statistics_.shaders_loaded;
+    auto shader = std::make_unique<Shader>(shader_type, data_hash, host_address,
+                                           dword_count);
+    Shader* shader_ptr = shader.get();
+    shaders_.emplace(data_hash, std::move(shader));
+    return shader_ptr;
+  }
+
+  void AnalyzeShaderUcode(Shader& shader) {
+    if (shader.is_ucode_analyzed()) {
+      return;
+    }
+    StageTimer timer(statistics_, Stage::kShaderAnalysis);
+    shader.AnalyzeUcode(ucode_disasm_buffer_);
+    ++statistics_.shaders_analyzed;
+  }
+
+  bool IssueDraw(xenos::PrimitiveType prim_type, uint32_t index_count,
+                 IndexBufferInfo* index_buffer_info,
+                 bool major_mode_explicit) override {
+    ++statistics_.draws;
+    const RegisterFile& regs = *register_file_;
+
+    Shader* vertex_shader = active_vertex_shader();
+    if (!vertex_shader) {
+      return false;
+    }
+    AnalyzeShaderUcode(*vertex_shader);
+    Shader* pixel_shader = active_pixel_shader();
+    if (pixel_shader) {
+      AnalyzeShaderUcode(*pixel_shader);
+    }
+
+    {
+      StageTimer timer(statistics_, Stage::kVertexBuffers);
+      for (const Shader::VertexBinding& vertex_binding :
+           vertex_shader->vertex_bindings()) {
+        xenos::xe_gpu_vertex_fetch_t vfetch_constant =
+            regs.GetVertexFetch(vertex_binding.fetch_constant);
+        if (vfetch_constant.type != xenos::FetchConstantType::kVertex &&
+            (vfetch_constant.type != xenos::FetchConstantType::kInvalidVertex ||
+             !cvars::gpu_allow_invalid_fetch_constants)) {
+          continue;
+        }
+        shared_memory_->RequestRange(vfetch_constant.address << 2,
+                                     vfetch_constant.size << 2);
+      }
+    }
+
+    {
+      StageTimer timer(statistics_, Stage::kPrimitiveProcessing);
+      PrimitiveProcessor::ProcessingResult primitive_processing_result;
+      if (!primitive_processor_->Process(primitive_processing_result)) {
+        return false;
+      }
+    }
+
+    {
+      StageTimer timer(statistics_, Stage::kDrawExtentEstimation);
+      draw_extent_estimator_->EstimateMaxY(true, *vertex_shader);
+    }
+    return true;
+  }
+
+  bool IssueCopy() override {
+    ++statistics_.copies;
+    return true;
+  }
+
+  std::unique_ptr<BenchmarkSharedMemory> shared_memory_;
+  std::unique_ptr<BenchmarkPrimitiveProcessor> primitive_processor_;
+  std::unique_ptr<DrawExtentEstimator> draw_extent_estimator_;
+
+  std::unordered_map<uint64_t, std::unique_ptr<Shader>> shaders_;
+  StringBuffer ucode_disasm_buffer_;
+
+  Statistics statistics_;
+};
+
+class BenchmarkGraphicsSystem : public NullGraphicsSystem {
+ public:
+  X_STATUS Setup(cpu::Processor* processor, kernel::KernelState* kernel_state,
+                 ui::WindowedAppContext* app_context,
+                 bool is_surface_required) override {
+    // Not creating the Vulkan provider that NullGraphicsSystem creates for the
+    // UI, so the benchmark can run without a GPU.
+    return GraphicsSystem::Setup(processor, kernel_state, app_context,
+                                 is_surface_required);
+  }
+
+ private:
+  std::unique_ptr<CommandProcessor> CreateCommandProcessor() override {
+    return std::unique_ptr<CommandProcessor>(
+        new BenchmarkCommandProcessor(this, kernel_state_));
+  }
+};
+
+int trace_benchmark_main(const std::vector<std::string>& args) {
+  std::filesystem::path path = cvars::target_trace_file;
+  if (path.empty() && args.size() >= 2) {
+    path = xe::to_path(args[1]);
+  }
+  if (path.empty()) {
+    XELOGE("No trace file specified");
+    return 5;
+  }
+  path = std::filesystem::absolute(path);
+
+  auto emulator = std::make_unique<Emulator>("", "", "", "");
+  X_STATUS result = emulator->Setup(
+      nullptr, nullptr, false, nullptr,
+      []() { return std::make_unique<BenchmarkGraphicsSystem>(); }, nullptr);
+  if (XFAILED(result)) {
+    XELOGE("Failed to setup emulator: {:08X}", result);
+    return 4;
+  }
+  GraphicsSystem* graphics_system = emulator->graphics_system();
+  auto command_processor = static_cast<BenchmarkCommandProcessor*>(
+      graphics_system->command_processor());
+  auto player = std::make_unique<TracePlayer>(graphics_system);
+  if (!player->Open(xe::path_to_utf8(path))) {
+    XELOGE("Could not load trace file {}", xe::path_to_utf8(path));
+    return 5;
+  }
+
+  uint64_t packets = 0;
+  for (int i = 0; i < player->frame_count(); ++i) {
+    packets += uint64_t(player->frame(i)->packet_count);
+  }
+
+  static const char* const kStageNames[] = {
+      "Shader analysis",
+      "Vertex buffers",
+      "Primitive processing",
+      "Draw extent estimation",
+  };
+  static_assert(xe::countof(kStageNames) ==
+                size_t(BenchmarkCommandProcessor::Stage::kCount));
+
+  double best_seconds = 0.0;
+  for (uint32_t i = 0; i < std::max(cvars::trace_benchmark_iterations, 1u);
+       ++i) {
+    command_processor->statistics() = BenchmarkCommandProcessor::Statistics();
+    auto start_time = std::chrono::steady_clock::now();
+    player->PlayAllFrames();
+    player->WaitOnPlayback();
+    std::chrono::steady_clock::duration total_time =
+        std::chrono::steady_clock::now() - start_time;
+    const BenchmarkCommandProcessor::Statistics& statistics =
+        command_processor->statistics();
+
+    double seconds = std::chrono::duration<double>(total_time).count();
+    if (!i || seconds < best_seconds) {
+      best_seconds = seconds;
+    }
+    XELOGI(
+        "Iteration {}: {} frames, {} packets, {} draws, {} copies in {:.3f} "
+        "s - {:.0f} packets/s, {:.0f} draws/s, {:.1f} frames/s",
+        i, player->frame_count(), packets, statistics.draws, statistics.copies,
+        seconds, packets / seconds, statistics.draws / seconds,
+        player->frame_count() / seconds);
+    XELOGI("  {} shaders loaded, {} analyzed", statistics.shaders_loaded,
+           statistics.shaders_analyzed);
+    XELOGI("  {} cached index conversions, {} reused from earlier frames",
+           statistics.index_conversions, statistics.index_conversions_avoided);
+    std::chrono::steady_clock::duration other_time = total_time;
+    for (size_t j = 0; j < size_t(BenchmarkCommandProcessor::Stage::kCount);
+         ++j) {
+      std::chrono::steady_clock::duration stage_time =
+          statistics.stage_times[j];
+      other_time -= stage_time;
+      XELOGI("  {}: {:.3f} ms ({:.1f}%)", kStageNames[j],
+             std::chrono::duration<double, std::milli>(stage_time).count(),
+             100.0 * std::chrono::duration<double>(stage_time).count() /
+                 seconds);
+    }
+    XELOGI(
+        "  PM4 processing, register writes and trace decoding: {:.3f} ms "
+        "({:.1f}%)",
+        std::chrono::duration<double, std::milli>(other_time).count(),
+        100.0 * std::chrono::duration<double>(other_time).count() / seconds);
+  }
+  XELOGI("Best: {:.3f} s, {:.0f} packets/s", best_seconds,
+         packets / best_seconds);
+
+  player.reset();
+  emulator.reset();
+  return 0;
+}
+
+}  // namespace null
+}  // namespace gpu
+}  // namespace xe
+
+XE_DEFINE_CONSOLE_APP("xenia-gpu-null-trace-benchmark",
+                      xe::gpu::null::trace_benchmark_main, "some.trace",
+                      "target_trace_file");
@@ -17,3 +17,56 @@ project("xenia-gpu-null")
     project_root.."/third_party/Vulkan-Headers/include",
   })
   local_platform_files()
+
+project("xenia-gpu-null-trace-benchmark")
+  uuid("358e64d6-a98a-4902-8e74-3d8ea29c6716")
+  kind("ConsoleApp")
+  language("C++")
+  links({
+    "xenia-apu",
+    "xenia-apu-nop",
+    "xenia-base",
+    "xenia-core",
+    "xenia-cpu",
+    "xenia-gpu",
+    "xenia-gpu-null",
+    "xenia-hid",
+    "xenia-hid-nop",
+    "xenia-kernel",
+    "xenia-ui",
+    "xenia-ui-vulkan",
+    "xenia-vfs",
+    "xenia-patcher",
+  })
+  links({
+    "aes_128",
+    "capstone",
+    "fmt",
+    "glslang-spirv",
+    "imgui",
+    "libavcodec",
+    "libavutil",
+    "mspack",
+    "snappy",
+    "xxhash",
+    "zstd",
+  })
+  includedirs({
+    project_root.."/third_party/Vulkan-Headers/include",
+  })
+  files({
+    "null_trace_benchmark_main.cc",
+    "../../base/console_app_main_"..platform_suffix..".cc",
+  })
+
+  filter("architecture:x86_64")
+    links({
+      "xenia-cpu-backend-x64",
+    })
+
+  filter("platforms:Linux")
+    links({
+      "X11",
+      "xcb",
+      "X11-xcb",
+    })
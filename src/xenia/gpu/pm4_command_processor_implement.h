@@ -572,6 +572,14 @@ bool COMMAND_PROCESSOR::ExecutePacketType3(uint32_t packet) XE_RESTRICT {
       // End the trace writer frame.
       if (trace_writer_.is_open()) {
         trace_writer_.WriteEvent(EventCommand::Type::kSwap);
+        if (trace_state_ == TraceState::kStreaming &&
+            cvars::trace_gpu_keyframe_interval &&
+            ++trace_frames_since_keyframe_ >=
+                cvars::trace_gpu_keyframe_interval) {
+          // Snapshot the state again so the next frame can be seeked to
+          // directly.
+          InitializeTrace();
+        }
         trace_writer_.Flush();
         if (trace_state_ == TraceState::kSingleFrame) {
           trace_state_ = TraceState::kDisabled;
@@ -660,6 +668,7 @@ bool COMMAND_PROCESSOR::ExecutePacketType3_XE_SWAP(uint32_t packet,
   uint32_t frontbuffer_height = reader_.ReadAndSwap<uint32_t>();
   reader_.AdvanceRead((count - 4) * sizeof(uint32_t));
 
+  register_file_->EndDirtyTrackingFrame();
   COMMAND_PROCESSOR::IssueSwap(frontbuffer_ptr, frontbuffer_width,
                                frontbuffer_height);
 
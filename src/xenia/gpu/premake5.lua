@@ -1,6 +1,11 @@
 project_root = "../../.."
 include(project_root.."/tools/build")
 
+newoption({
+  trigger = "gpu-shader-jit",
+  description = "Build the experimental x86-64 vertex shader JIT (needs xbyak)",
+})
+
 group("src")
 project("xenia-gpu")
   uuid("0e8d3370-e4b1-4b05-a2e8-39ebbcdf9b17")
@@ -14,12 +19,21 @@ project("xenia-gpu")
     "xenia-base",
     "xenia-ui",
     "xxhash",
+    "zstd",
   })
   includedirs({
     project_root.."/third_party/Vulkan-Headers/include",
   })
   local_platform_files()
 
+  filter({"options:gpu-shader-jit", "architecture:x86_64"})
+    defines({
+      "XE_GPU_SHADER_JIT=1",
+    })
+  filter({})
+
+include("testing")
+
 group("src")
 project("xenia-gpu-shader-compiler")
   uuid("ad76d3e4-4c62-439b-a0f6-f83fcf0e83c5")
@@ -34,6 +48,7 @@ project("xenia-gpu-shader-compiler")
     "xenia-gpu",
     "xenia-ui",
     "xenia-ui-vulkan",
+    "zstd",
   })
   includedirs({
     project_root.."/third_party/Vulkan-Headers/include",
@@ -19,6 +19,7 @@
 #include "xenia/base/cvar.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
+#include "xenia/base/memory.h"
 #include "xenia/base/profiling.h"
 #include "xenia/gpu/register_file.h"
 #include "xenia/gpu/registers.h"
@@ -68,6 +69,15 @@ DEFINE_int32(
     "while a very low value may result in excessive locking and lookups.\n"
     "Negative values disable caching.",
     "GPU");
+DEFINE_int32(
+    primitive_processor_persistent_cache_size_mb, 32,
+    "Maximum size in megabytes of the processed guest indices kept for reuse "
+    "in later frames, such as for static geometry drawn every frame. The "
+    "least recently used indices are dropped when the limit is reached. Only "
+    "indices large enough for primitive_processor_cache_min_indices are "
+    "kept.\n"
+    "Non-positive values disable caching across frames.",
+    "GPU");
 
 namespace xe {
 namespace gpu {
@@ -252,6 +262,10 @@ void PrimitiveProcessor::ShutdownCommon() {
                   sizeof(cache_buckets_non_empty_l1_));
       std::memset(cache_buckets_non_empty_l2_, 0,
                   sizeof(cache_buckets_non_empty_l2_));
+      persistent_cache_map_.clear();
+      persistent_cache_lru_.clear();
+      persistent_cache_ranges_.clear();
+      persistent_cache_size_bytes_ = 0;
     }
     memory_.UnregisterPhysicalMemoryInvalidationCallback(
         memory_invalidation_callback_handle_);
@@ -261,11 +275,17 @@ void PrimitiveProcessor::ShutdownCommon() {
 }
 
 void PrimitiveProcessor::ClearPerFrameCache() {
+  last_frame_persistent_cache_statistics_ = persistent_cache_frame_statistics_;
+  persistent_cache_frame_statistics_ = PersistentCacheStatistics();
   if (!memory_invalidation_callback_handle_) {
     // Only do clearing if cache has ever been used.
     return;
   }
   auto global_lock = global_critical_region_.Acquire();
+  last_frame_persistent_cache_statistics_.entry_count =
+      uint32_t(persistent_cache_map_.size());
+  last_frame_persistent_cache_statistics_.size_bytes =
+      persistent_cache_size_bytes_;
   for (const std::pair<CacheKey, size_t>& cache_map_entry : cache_map_) {
     cache_entry_pool_[cache_map_entry.second].free_next =
         cache_bucket_free_first_entry_;
@@ -278,6 +298,14 @@ void PrimitiveProcessor::ClearPerFrameCache() {
               sizeof(cache_buckets_non_empty_l2_));
 }
 
+void PrimitiveProcessor::ClearPersistentCache() {
+  auto global_lock = global_critical_region_.Acquire();
+  persistent_cache_map_.clear();
+  persistent_cache_lru_.clear();
+  persistent_cache_ranges_.clear();
+  persistent_cache_size_bytes_ = 0;
+}
+
 bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
   SCOPE_profile_cpu_f("gpu");
 
@@ -685,7 +713,8 @@ bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
       CacheTransaction cache_transaction(
           *this, CacheKey(guest_index_base, guest_draw_vertex_count,
                           guest_index_format, guest_index_endian,
-                          guest_primitive_reset_enabled, guest_primitive_type));
+                          guest_primitive_reset_enabled, guest_primitive_type),
+          guest_primitive_reset_index_guest_endian);
       if (cache_transaction.GetFoundResult()) {
         cacheable = *cache_transaction.GetFoundResult();
       } else {
@@ -735,7 +764,7 @@ bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
                 0, guest_draw_vertex_count, cacheable.host_draw_vertex_count);
           }
           auto host_indices = reinterpret_cast<uint16_t*>(
-              RequestHostConvertedIndexBufferForCurrentFrame(
+              cache_transaction.RequestHostConvertedIndexBuffer(
                   xenos::IndexFormat::kInt16, cacheable.host_draw_vertex_count,
                   false, guest_index_base, cacheable.host_index_buffer_handle));
           if (!host_indices) {
@@ -769,7 +798,7 @@ bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
                 0, guest_draw_vertex_count, cacheable.host_draw_vertex_count);
           }
           auto host_indices = reinterpret_cast<uint32_t*>(
-              RequestHostConvertedIndexBufferForCurrentFrame(
+              cache_transaction.RequestHostConvertedIndexBuffer(
                   xenos::IndexFormat::kInt32, cacheable.host_draw_vertex_count,
                   false, guest_index_base, cacheable.host_index_buffer_handle));
           if (!host_indices) {
@@ -820,7 +849,9 @@ bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
             cacheable.host_shader_index_endian = xenos::Endian::kNone;
           }
         }
-        cache_transaction.SetNewResult(cacheable);
+        if (!cache_transaction.SetNewResult(cacheable)) {
+          return false;
+        }
       }
     } else {
       // Using the same indices on the host as on the guest, either directly or
@@ -848,9 +879,11 @@ bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
             // Not specifying the primitive type in the cache key because not
             // replacing it, only the reset index in a type-independent way.
             CacheTransaction cache_transaction(
-                *this, CacheKey(guest_index_base, guest_draw_vertex_count,
-                                guest_index_format, guest_index_endian,
-                                guest_primitive_reset_enabled));
+                *this,
+                CacheKey(guest_index_base, guest_draw_vertex_count,
+                         guest_index_format, guest_index_endian,
+                         guest_primitive_reset_enabled),
+                guest_primitive_reset_index_guest_endian);
             if (cache_transaction.GetFoundResult()) {
               cacheable = *cache_transaction.GetFoundResult();
             } else {
@@ -868,7 +901,7 @@ bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
                                                   ? xenos::IndexFormat::kInt32
                                                   : xenos::IndexFormat::kInt16;
                 void* host_indices_ptr =
-                    RequestHostConvertedIndexBufferForCurrentFrame(
+                    cache_transaction.RequestHostConvertedIndexBuffer(
                         cacheable.host_index_format, guest_draw_vertex_count,
                         true, guest_index_base,
                         cacheable.host_index_buffer_handle);
@@ -887,7 +920,9 @@ bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
                       guest_primitive_reset_index_guest_endian);
                 }
               }
-              cache_transaction.SetNewResult(cacheable);
+              if (!cache_transaction.SetNewResult(cacheable)) {
+                return false;
+              }
             }
           }
         } else {
@@ -906,9 +941,11 @@ bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
           // Not specifying the primitive type in the cache key because not
           // replacing it, only the reset index in a type-independent way.
           CacheTransaction cache_transaction(
-              *this, CacheKey(guest_index_base, guest_draw_vertex_count,
-                              guest_index_format, guest_index_endian,
-                              guest_primitive_reset_enabled));
+              *this,
+              CacheKey(guest_index_base, guest_draw_vertex_count,
+                       guest_index_format, guest_index_endian,
+                       guest_primitive_reset_enabled),
+              guest_primitive_reset_index_guest_endian);
           if (cache_transaction.GetFoundResult()) {
             cacheable = *cache_transaction.GetFoundResult();
           } else {
@@ -920,7 +957,7 @@ bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
               cacheable.index_buffer_type =
                   ProcessedIndexBufferType::kHostConverted;
               auto host_indices = reinterpret_cast<uint32_t*>(
-                  RequestHostConvertedIndexBufferForCurrentFrame(
+                  cache_transaction.RequestHostConvertedIndexBuffer(
                       xenos::IndexFormat::kInt32, guest_draw_vertex_count, true,
                       guest_index_base, cacheable.host_index_buffer_handle));
               if (!host_indices) {
@@ -955,7 +992,9 @@ bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
                   full_32bit_vertex_indices_used_ ? guest_index_endian
                                                   : xenos::Endian::kNone;
             }
-            cache_transaction.SetNewResult(cacheable);
+            if (!cache_transaction.SetNewResult(cacheable)) {
+              return false;
+            }
           }
         }
       }
@@ -1412,7 +1451,8 @@ uint32_t PrimitiveProcessor::GetMultiPrimitiveHostIndexCountAndRanges(
 }
 
 PrimitiveProcessor::CacheTransaction::CacheTransaction(
-    PrimitiveProcessor& processor, CacheKey key)
+    PrimitiveProcessor& processor, CacheKey key,
+    uint32_t reset_index_guest_endian)
     : processor_(processor), key_(key) {
   assert_zero(processor_.cache_currently_processing_size_bytes_);
   if (cvars::primitive_processor_cache_min_indices < 0 ||
@@ -1423,10 +1463,16 @@ PrimitiveProcessor::CacheTransaction::CacheTransaction(
   if (!key_.count) {
     return;
   }
+  persistent_key_.key = key_;
+  persistent_key_.reset_index_guest_endian =
+      key_.is_reset_enabled ? reset_index_guest_endian : 0;
+  is_persistent_ = cvars::primitive_processor_persistent_cache_size_mb > 0;
   uint32_t size_bytes =
       (key_.format == xenos::IndexFormat::kInt16 ? sizeof(uint16_t)
                                                  : sizeof(uint32_t)) *
       key_.count;
+  std::shared_ptr<const std::vector<uint8_t>> persistent_host_indices;
+  size_t persistent_host_indices_offset = 0;
   {
     auto global_lock = processor_.global_critical_region_.Acquire();
     auto cache_map_it = processor_.cache_map_.find(key_);
@@ -1434,12 +1480,54 @@ PrimitiveProcessor::CacheTransaction::CacheTransaction(
       result_ = processor_.cache_entry_pool_[cache_map_it->second].result;
       result_type_ = ResultType::kExisting;
     } else {
-      // Inhibit writing the new result if the range happens to be modified
-      // during the processing outside the lock.
-      processor_.cache_currently_processing_base_ = key_.base;
-      processor_.cache_currently_processing_size_bytes_ = size_bytes;
+      auto persistent_cache_map_it =
+          is_persistent_
+              ? processor_.persistent_cache_map_.find(persistent_key_)
+              : processor_.persistent_cache_map_.end();
+      if (persistent_cache_map_it != processor_.persistent_cache_map_.end()) {
+        PersistentCacheEntry& persistent_entry =
+            persistent_cache_map_it->second;
+        result_ = persistent_entry.result;
+        persistent_host_indices = persistent_entry.host_indices;
+        persistent_host_indices_offset = persistent_entry.host_indices_offset;
+        processor_.persistent_cache_lru_.splice(
+            processor_.persistent_cache_lru_.begin(),
+            processor_.persistent_cache_lru_, persistent_entry.lru_it);
+        result_type_ = ResultType::kPersistent;
+      } else {
+        // Inhibit writing the new result if the range happens to be modified
+        // during the processing outside the lock.
+        processor_.cache_currently_processing_base_ = key_.base;
+        processor_.cache_currently_processing_size_bytes_ = size_bytes;
+        processor_.cache_currently_processing_invalidated_ = false;
+      }
     }
   }
+  if (result_type_ == ResultType::kPersistent) {
+    // The range is still watched since the indices were stored, so the
+    // invalidation callback doesn't need to be enabled again.
+    if (persistent_host_indices) {
+      void* host_indices =
+          processor_.RequestHostConvertedIndexBufferForCurrentFrame(
+              result_.host_index_format, result_.host_draw_vertex_count, false,
+              key_.base, result_.host_index_buffer_handle);
+      if (!host_indices) {
+        // Let the caller process the indices, without caching.
+        key_.key = 0;
+        result_type_ = ResultType::kNewUnset;
+        return;
+      }
+      std::memcpy(host_indices,
+                  persistent_host_indices->data() +
+                      persistent_host_indices_offset,
+                  result_.host_draw_vertex_count *
+                      (result_.host_index_format == xenos::IndexFormat::kInt16
+                           ? sizeof(uint16_t)
+                           : sizeof(uint32_t)));
+    }
+    ++processor_.persistent_cache_frame_statistics_.conversions_avoided;
+    return;
+  }
   if (result_type_ != ResultType::kExisting) {
     // Enable the invalidation callback before reading the indices.
     // Also, only enable invalidation callbacks if anything needed processing at
@@ -1455,6 +1543,64 @@ PrimitiveProcessor::CacheTransaction::CacheTransaction(
   }
 }
 
+void* PrimitiveProcessor::CacheTransaction::RequestHostConvertedIndexBuffer(
+    xenos::IndexFormat format, uint32_t index_count, bool coalign_for_simd,
+    uint32_t coalignment_original_address, size_t& backend_handle_out) {
+  assert_true(result_type_ == ResultType::kNewUnset);
+  if (!key_.count || !is_persistent_) {
+    return processor_.RequestHostConvertedIndexBufferForCurrentFrame(
+        format, index_count, coalign_for_simd, coalignment_original_address,
+        backend_handle_out);
+  }
+  new_host_indices_ = std::make_shared<std::vector<uint8_t>>(
+      (format == xenos::IndexFormat::kInt16 ? sizeof(uint16_t)
+                                            : sizeof(uint32_t)) *
+          index_count +
+      (coalign_for_simd ? XE_GPU_PRIMITIVE_PROCESSOR_SIMD_SIZE : 0));
+  new_host_indices_offset_ =
+      coalign_for_simd ? size_t(GetSimdCoalignmentOffset(
+                             new_host_indices_->data(),
+                             coalignment_original_address))
+                       : 0;
+  new_host_index_format_ = format;
+  new_host_index_count_ = index_count;
+  // Requested in SetNewResult.
+  backend_handle_out = SIZE_MAX;
+  return new_host_indices_->data() + new_host_indices_offset_;
+}
+
+bool PrimitiveProcessor::CacheTransaction::SetNewResult(
+    CachedResult& new_result) {
+  // Replacement of an existing entry is not allowed.
+  assert_true(result_type_ != ResultType::kExisting &&
+              result_type_ != ResultType::kPersistent);
+  if (new_host_indices_) {
+    // Copying the indices to the host buffer sequentially, which is also
+    // preferable if it's write-combined memory, rather than converting
+    // directly to it.
+    assert_true(new_result.host_index_format == new_host_index_format_);
+    void* host_indices =
+        processor_.RequestHostConvertedIndexBufferForCurrentFrame(
+            new_host_index_format_, new_host_index_count_, false, key_.base,
+            new_result.host_index_buffer_handle);
+    if (!host_indices) {
+      return false;
+    }
+    std::memcpy(host_indices,
+                new_host_indices_->data() + new_host_indices_offset_,
+                new_host_index_count_ *
+                    (new_host_index_format_ == xenos::IndexFormat::kInt16
+                         ? sizeof(uint16_t)
+                         : sizeof(uint32_t)));
+  }
+  result_ = new_result;
+  result_type_ = ResultType::kNewSet;
+  if (key_.count) {
+    ++processor_.persistent_cache_frame_statistics_.conversions;
+  }
+  return true;
+}
+
 PrimitiveProcessor::CacheTransaction::~CacheTransaction() {
   if (!key_.count || result_type_ == ResultType::kExisting) {
     return;
@@ -1462,10 +1608,22 @@ PrimitiveProcessor::CacheTransaction::~CacheTransaction() {
 
   auto global_lock = processor_.global_critical_region_.Acquire();
 
+  bool invalidated_during_processing =
+      result_type_ != ResultType::kPersistent &&
+      processor_.cache_currently_processing_invalidated_;
   processor_.cache_currently_processing_base_ = 0;
   processor_.cache_currently_processing_size_bytes_ = 0;
+  processor_.cache_currently_processing_invalidated_ = false;
+
+  if (result_type_ == ResultType::kNewSet && !invalidated_during_processing &&
+      is_persistent_) {
+    processor_.AddPersistentCacheEntry(persistent_key_, result_,
+                                       std::move(new_host_indices_),
+                                       new_host_indices_offset_, global_lock);
+  }
 
-  if (result_type_ == ResultType::kNewSet) {
+  if ((result_type_ == ResultType::kNewSet && !invalidated_during_processing) ||
+      result_type_ == ResultType::kPersistent) {
     size_t new_entry_index;
     if (processor_.cache_bucket_free_first_entry_ != SIZE_MAX) {
       new_entry_index = processor_.cache_bucket_free_first_entry_;
@@ -1532,6 +1690,16 @@ std::pair<uint32_t, uint32_t> PrimitiveProcessor::MemoryInvalidationCallback(
         xe::align(physical_address_end, kCacheBucketSizeBytes);
   }
   bool any_invalidated = false;
+  auto global_lock = global_critical_region_.Acquire();
+  if (cache_currently_processing_size_bytes_ &&
+      cache_currently_processing_base_ < physical_address_end &&
+      cache_currently_processing_base_ +
+              cache_currently_processing_size_bytes_ >
+          physical_address_start) {
+    // Don't store the indices being processed outside the lock as the guest
+    // has modified them.
+    cache_currently_processing_invalidated_ = true;
+  }
   uint32_t bucket_index_first =
       physical_address_start >> kCacheBucketSizeBytesLog2;
   uint32_t bucket_index_last =
@@ -1540,7 +1708,6 @@ std::pair<uint32_t, uint32_t> PrimitiveProcessor::MemoryInvalidationCallback(
   uint32_t bucket_l1_bits_index_last = bucket_index_last >> 6;
   uint32_t bucket_l2_bits_index_first = bucket_index_first >> 12;
   uint32_t bucket_l2_bits_index_last = bucket_index_last >> 12;
-  auto global_lock = global_critical_region_.Acquire();
   for (uint32_t bucket_l2_bits_index = bucket_l2_bits_index_first;
        bucket_l2_bits_index <= bucket_l2_bits_index_last;
        ++bucket_l2_bits_index) {
@@ -1610,7 +1777,7 @@ std::pair<uint32_t, uint32_t> PrimitiveProcessor::MemoryInvalidationCallback(
           // the specified range.
           if (entry_key.base < physical_address_end) {
             uint32_t entry_end = entry_key.base + entry_key.GetSizeBytes();
-            if (entry_end > physical_address_end) {
+            if (entry_end > physical_address_start) {
               // Invalidate the entry.
               any_invalidated = true;
               // Remove the entry from the cache map.
@@ -1668,10 +1835,101 @@ std::pair<uint32_t, uint32_t> PrimitiveProcessor::MemoryInvalidationCallback(
       }
     }
   }
-  return any_invalidated
-             ? std::make_pair(physical_address_start,
-                              physical_address_end - physical_address_start)
-             : std::make_pair(uint32_t(0), UINT32_MAX);
+  std::pair<uint32_t, uint32_t> unwatch_range =
+      any_invalidated
+          ? std::make_pair(physical_address_start,
+                           physical_address_end - physical_address_start)
+          : std::make_pair(uint32_t(0), UINT32_MAX);
+
+  if (!persistent_cache_ranges_.empty()) {
+    // The persistent cache entries must stay watched as long as they exist, so
+    // invalidate them with the host page granularity of watching, and don't let
+    // the pages of the remaining entries be unwatched.
+    uint32_t page_size = uint32_t(xe::memory::page_size());
+    uint32_t persistent_start = physical_address_start & ~(page_size - 1);
+    uint32_t persistent_end =
+        std::min(xe::align(physical_address_end, page_size),
+                 SharedMemory::kBufferSize);
+    // Entries are smaller than a cache bucket.
+    auto range_it = persistent_cache_ranges_.lower_bound(
+        xe::sat_sub(persistent_start, kCacheBucketSizeBytes));
+    uint32_t remaining_before_end = 0;
+    while (range_it != persistent_cache_ranges_.end() &&
+           range_it->first < persistent_end) {
+      const PersistentCacheKey& entry_key = range_it->second;
+      uint32_t entry_end = entry_key.key.base + entry_key.key.GetSizeBytes();
+      auto range_next_it = std::next(range_it);
+      if (entry_end > persistent_start) {
+        RemovePersistentCacheEntry(persistent_cache_map_.find(entry_key),
+                                   global_lock);
+      } else {
+        remaining_before_end = std::max(remaining_before_end, entry_end);
+      }
+      range_it = range_next_it;
+    }
+    uint32_t unwatch_start =
+        std::max(xe::align(remaining_before_end, page_size),
+                 unwatch_range.first);
+    uint32_t unwatch_end = uint32_t(std::min(
+        uint64_t(unwatch_range.first) + unwatch_range.second,
+        uint64_t(range_it != persistent_cache_ranges_.end()
+                     ? range_it->first & ~(page_size - 1)
+                     : UINT32_MAX)));
+    unwatch_range = std::make_pair(
+        unwatch_start, unwatch_end > unwatch_start ? unwatch_end - unwatch_start
+                                                   : uint32_t(0));
+  }
+
+  return unwatch_range;
+}
+
+void PrimitiveProcessor::AddPersistentCacheEntry(
+    const PersistentCacheKey& key, const CachedResult& result,
+    std::shared_ptr<const std::vector<uint8_t>> host_indices,
+    size_t host_indices_offset, const global_unique_lock_type& global_lock) {
+  uint64_t entry_size =
+      sizeof(PersistentCacheEntry) + (host_indices ? host_indices->size() : 0);
+  uint64_t max_size =
+      uint64_t(std::max(cvars::primitive_processor_persistent_cache_size_mb,
+                        int32_t(0)))
+      << 20;
+  if (entry_size > max_size) {
+    return;
+  }
+  while (!persistent_cache_lru_.empty() &&
+         persistent_cache_size_bytes_ + entry_size > max_size) {
+    RemovePersistentCacheEntry(
+        persistent_cache_map_.find(persistent_cache_lru_.back()), global_lock);
+  }
+  auto emplace_result = persistent_cache_map_.try_emplace(key);
+  if (!emplace_result.second) {
+    return;
+  }
+  PersistentCacheEntry& entry = emplace_result.first->second;
+  entry.result = result;
+  entry.host_indices = std::move(host_indices);
+  entry.host_indices_offset = host_indices_offset;
+  persistent_cache_lru_.push_front(key);
+  entry.lru_it = persistent_cache_lru_.begin();
+  entry.range_it = persistent_cache_ranges_.emplace(key.key.base, key);
+  persistent_cache_size_bytes_ += entry_size;
+}
+
+void PrimitiveProcessor::RemovePersistentCacheEntry(
+    std::unordered_map<PersistentCacheKey, PersistentCacheEntry,
+                       PersistentCacheKey::Hasher>::iterator entry_it,
+    const global_unique_lock_type& global_lock) {
+  assert_true(entry_it != persistent_cache_map_.end());
+  if (entry_it == persistent_cache_map_.end()) {
+    return;
+  }
+  PersistentCacheEntry& entry = entry_it->second;
+  persistent_cache_size_bytes_ -=
+      sizeof(PersistentCacheEntry) +
+      (entry.host_indices ? entry.host_indices->size() : 0);
+  persistent_cache_lru_.erase(entry.lru_it);
+  persistent_cache_ranges_.erase(entry.range_it);
+  persistent_cache_map_.erase(entry_it);
 }
 
 std::pair<uint32_t, uint32_t>
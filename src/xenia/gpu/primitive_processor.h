@@ -17,9 +17,13 @@
 #include <cstring>
 #include <deque>
 #include <functional>
+#include <list>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "xenia/base/assert.h"
 #include "xenia/base/cvar.h"
@@ -185,6 +189,23 @@ class PrimitiveProcessor {
   std::pair<uint32_t, uint32_t> MemoryInvalidationCallback(
       uint32_t physical_address_start, uint32_t length, bool exact_range);
 
+  struct PersistentCacheStatistics {
+    // Processing skipped by copying the indices converted in an earlier frame.
+    uint32_t conversions_avoided = 0;
+    // Processing performed for index buffers large enough to be cached.
+    uint32_t conversions = 0;
+    uint32_t entry_count = 0;
+    uint64_t size_bytes = 0;
+  };
+  // For the frame last ended with ClearPerFrameCache.
+  const PersistentCacheStatistics& last_frame_persistent_cache_statistics()
+      const {
+    return last_frame_persistent_cache_statistics_;
+  }
+
+  // Drops the indices kept for reuse across frames.
+  void ClearPersistentCache();
+
  protected:
   // For host-side index buffer creation, the biggest possibly needed contiguous
   // allocation, in indices.
@@ -709,7 +730,8 @@ class PrimitiveProcessor {
 
   std::deque<SinglePrimitiveRange> single_primitive_ranges_;
 
-  // Caching for reuse of converted indices within a frame.
+  // Caching for reuse of converted indices within a frame, backed by caching of
+  // the converted indices themselves across frames.
 
   // 256 KB as the largest possible guest index buffer - 0xFFFF 32-bit indices -
   // is slightly smaller than 256 KB, thus cache entries need store links within
@@ -803,6 +825,37 @@ class PrimitiveProcessor {
     uint32_t GetBucketCount() const { return GetBucketCount(key); }
   };
 
+  // The per-frame cache key doesn't include the reset index as it's rarely
+  // changed within a frame, but across frames it may be.
+  struct PersistentCacheKey {
+    CacheKey key;
+    // 0 if primitive reset is disabled.
+    uint32_t reset_index_guest_endian;
+
+    struct Hasher {
+      size_t operator()(const PersistentCacheKey& key) const {
+        return std::hash<uint64_t>{}(key.key.key ^
+                                     (uint64_t(key.reset_index_guest_endian)
+                                      << 32));
+      }
+    };
+    bool operator==(const PersistentCacheKey& other_key) const {
+      return key == other_key.key &&
+             reset_index_guest_endian == other_key.reset_index_guest_endian;
+    }
+  };
+
+  struct PersistentCacheEntry {
+    // host_index_buffer_handle is not used, as the buffer is requested for the
+    // current frame on reuse.
+    CachedResult result;
+    // Null if the indices are used directly from the guest memory.
+    std::shared_ptr<const std::vector<uint8_t>> host_indices;
+    size_t host_indices_offset;
+    std::list<PersistentCacheKey>::iterator lru_it;
+    std::multimap<uint32_t, PersistentCacheKey>::iterator range_it;
+  };
+
   // A cache transaction performs a few operations in a RAII-like way (so
   // processing may return an error for any reason, and won't have to clean up
   // cache_currently_processing_base_ / size_bytes_ explicitly):
@@ -825,18 +878,29 @@ class PrimitiveProcessor {
   // If an entry was found in the cache (GetFoundResult results non-null), it
   // MUST be used instead of processing - this class doesn't provide the
   // possibility replace existing entries.
+  // If the indices were converted in an earlier frame, they're copied to a
+  // buffer for the current frame during the initialization, and the result is
+  // returned from GetFoundResult like one from the current frame.
+  // When processing, host index buffers must be requested via the transaction
+  // so the indices can be stored for later frames - and SetNewResult sets the
+  // host index buffer handle in the result in this case.
   class CacheTransaction final {
    public:
-    CacheTransaction(PrimitiveProcessor& processor, CacheKey key);
+    CacheTransaction(PrimitiveProcessor& processor, CacheKey key,
+                     uint32_t reset_index_guest_endian);
     const CachedResult* GetFoundResult() const {
-      return result_type_ == ResultType::kExisting ? &result_ : nullptr;
-    }
-    void SetNewResult(const CachedResult& new_result) {
-      // Replacement of an existing entry is not allowed.
-      assert_true(result_type_ != ResultType::kExisting);
-      result_ = new_result;
-      result_type_ = ResultType::kNewSet;
+      return (result_type_ == ResultType::kExisting ||
+              result_type_ == ResultType::kPersistent)
+                 ? &result_
+                 : nullptr;
     }
+    void* RequestHostConvertedIndexBuffer(xenos::IndexFormat format,
+                                          uint32_t index_count,
+                                          bool coalign_for_simd,
+                                          uint32_t coalignment_original_address,
+                                          size_t& backend_handle_out);
+    // Returns false if failed to request the host index buffer.
+    bool SetNewResult(CachedResult& new_result);
     ~CacheTransaction();
 
    private:
@@ -846,13 +910,23 @@ class PrimitiveProcessor {
     // special logic, and count == 0 is also used as a special indicator for
     // vertex count below the cache usage threshold.
     CacheKey key_;
+    PersistentCacheKey persistent_key_;
+    bool is_persistent_ = false;
     CachedResult result_;
     enum class ResultType {
       kNewUnset,
       kNewSet,
       kExisting,
+      // Found in the persistent cache, not in the current frame yet.
+      kPersistent,
     };
     ResultType result_type_ = ResultType::kNewUnset;
+    // If is_persistent_, the indices are converted to this buffer, and then
+    // copied to the host buffer for the current frame in SetNewResult.
+    std::shared_ptr<std::vector<uint8_t>> new_host_indices_;
+    size_t new_host_indices_offset_ = 0;
+    xenos::IndexFormat new_host_index_format_ = xenos::IndexFormat::kInt16;
+    uint32_t new_host_index_count_ = 0;
   };
 
   std::deque<CacheEntry> cache_entry_pool_;
@@ -871,6 +945,35 @@ class PrimitiveProcessor {
   // 0 if not in a cache transaction that hasn't found an existing entry
   // currently.
   uint32_t cache_currently_processing_size_bytes_ = 0;
+  // Set by the invalidation callback, read by the processor.
+  bool cache_currently_processing_invalidated_ = false;
+
+  // Modified by both the processor and the invalidation callback.
+  std::unordered_map<PersistentCacheKey, PersistentCacheEntry,
+                     PersistentCacheKey::Hasher>
+      persistent_cache_map_;
+  // Most recently used first.
+  // Modified by both the processor and the invalidation callback.
+  std::list<PersistentCacheKey> persistent_cache_lru_;
+  // By the guest base address, for invalidation.
+  // Modified by both the processor and the invalidation callback.
+  std::multimap<uint32_t, PersistentCacheKey> persistent_cache_ranges_;
+  // Modified by both the processor and the invalidation callback.
+  uint64_t persistent_cache_size_bytes_ = 0;
+  // Must be called in a global critical region.
+  void AddPersistentCacheEntry(
+      const PersistentCacheKey& key, const CachedResult& result,
+      std::shared_ptr<const std::vector<uint8_t>> host_indices,
+      size_t host_indices_offset,
+      [[maybe_unused]] const global_unique_lock_type& global_lock);
+  // Must be called in a global critical region.
+  void RemovePersistentCacheEntry(
+      std::unordered_map<PersistentCacheKey, PersistentCacheEntry,
+                         PersistentCacheKey::Hasher>::iterator entry_it,
+      [[maybe_unused]] const global_unique_lock_type& global_lock);
+  // Modified only by the processor.
+  PersistentCacheStatistics persistent_cache_frame_statistics_;
+  PersistentCacheStatistics last_frame_persistent_cache_statistics_;
   // Modified by both the processor and the invalidation callback.
   size_t cache_bucket_free_first_entry_ = SIZE_MAX;
   // Modified by both the processor and the invalidation callback.
@@ -8,6 +8,7 @@
  */
 
 #include "xenia/gpu/register_file.h"
+#include <algorithm>
 #include <array>
 #include <cstring>
 
@@ -93,5 +94,111 @@ bool RegisterFile::IsValidRegister(uint32_t index) {
   return (valid_register_bitset[register_linear_index / 64] &
           (1ULL << (register_linear_index % 64))) != 0;
 }
+
+static constexpr bool AreDirtyGroupsValid() {
+  uint32_t word_count = 0;
+  for (const RegisterFile::DirtyGroupInfo& group_info :
+       RegisterFile::kDirtyGroups) {
+    if (group_info.first_word != word_count ||
+        group_info.register_count % group_info.registers_per_bit) {
+      return false;
+    }
+    word_count +=
+        (group_info.register_count / group_info.registers_per_bit + 63) / 64;
+  }
+  return word_count == RegisterFile::kDirtyWordCount;
+}
+static_assert(AreDirtyGroupsValid(),
+              "Dirty register group bits must be laid out consecutively");
+
+// Calls word_function(word_index, bit_mask) for the dirty bits of every group
+// overlapping the register range.
+template <typename WordFunction>
+static void ForEachDirtyWord(uint32_t first_register, uint32_t register_count,
+                             WordFunction word_function) {
+  uint32_t end_register = first_register + register_count;
+  for (const RegisterFile::DirtyGroupInfo& group_info :
+       RegisterFile::kDirtyGroups) {
+    uint32_t group_first_register =
+        std::max(first_register, group_info.first_register);
+    uint32_t group_end_register =
+        std::min(end_register,
+                 group_info.first_register + group_info.register_count);
+    if (group_first_register >= group_end_register) {
+      continue;
+    }
+    uint32_t first_bit = (group_first_register - group_info.first_register) /
+                         group_info.registers_per_bit;
+    uint32_t last_bit = (group_end_register - 1 - group_info.first_register) /
+                        group_info.registers_per_bit;
+    uint32_t first_word = first_bit >> 6;
+    uint32_t last_word = last_bit >> 6;
+    for (uint32_t i = first_word; i <= last_word; ++i) {
+      uint64_t bit_mask = ~UINT64_C(0);
+      if (i == first_word) {
+        bit_mask &= ~UINT64_C(0) << (first_bit & 63);
+      }
+      if (i == last_word) {
+        bit_mask &= ~UINT64_C(0) >> (63 - (last_bit & 63));
+      }
+      word_function(group_info.first_word + i, bit_mask);
+    }
+  }
+}
+
+RegisterFile::DirtyTracker::DirtyTracker(const RegisterFile& register_file)
+    : register_file_(register_file) {
+  MarkAllDirty();
+  register_file_.dirty_trackers_.push_back(this);
+}
+
+RegisterFile::DirtyTracker::~DirtyTracker() {
+  std::vector<DirtyTracker*>& dirty_trackers = register_file_.dirty_trackers_;
+  auto it = std::find(dirty_trackers.begin(), dirty_trackers.end(), this);
+  assert_true(it != dirty_trackers.end());
+  if (it != dirty_trackers.end()) {
+    dirty_trackers.erase(it);
+  }
+}
+
+bool RegisterFile::DirtyTracker::IsDirty(uint32_t first_register,
+                                         uint32_t register_count) const {
+  bool is_dirty = false;
+  ForEachDirtyWord(first_register, register_count,
+                   [this, &is_dirty](uint32_t word_index, uint64_t bit_mask) {
+                     is_dirty |= (bits_[word_index] & bit_mask) != 0;
+                   });
+  return is_dirty;
+}
+
+bool RegisterFile::DirtyTracker::IsDirty(DirtyGroup group) const {
+  const DirtyGroupInfo& group_info = kDirtyGroups[size_t(group)];
+  return IsDirty(group_info.first_register, group_info.register_count);
+}
+
+void RegisterFile::DirtyTracker::ClearDirty(DirtyGroup group) {
+  const DirtyGroupInfo& group_info = kDirtyGroups[size_t(group)];
+  std::memset(
+      &bits_[group_info.first_word], 0,
+      sizeof(uint64_t) *
+          ((group_info.register_count / group_info.registers_per_bit + 63) /
+           64));
+}
+
+void RegisterFile::DirtyTracker::MarkAllDirty() {
+  std::memset(bits_, 0, sizeof(bits_));
+  for (const DirtyGroupInfo& group_info : kDirtyGroups) {
+    MarkDirty(group_info.first_register, group_info.register_count);
+  }
+}
+
+void RegisterFile::DirtyTracker::MarkDirty(uint32_t first_register,
+                                           uint32_t register_count) {
+  ForEachDirtyWord(first_register, register_count,
+                   [this](uint32_t word_index, uint64_t bit_mask) {
+                     bits_[word_index] |= bit_mask;
+                   });
+}
+
 }  //  namespace gpu
 }  //  namespace xe
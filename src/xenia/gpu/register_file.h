@@ -13,6 +13,7 @@
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <vector>
 
 #include "xenia/base/assert.h"
 #include "xenia/base/memory.h"
@@ -33,6 +34,91 @@ struct RegisterInfo {
 
 class RegisterFile {
  public:
+  // Groups of registers whose writes are tracked, so state derived from them
+  // can be reused until they're modified.
+  enum class DirtyGroup : uint32_t {
+    // One bit per float4 constant.
+    kAluConstants,
+    // One bit per texture fetch constant (or 3 vertex fetch constants).
+    kFetchConstants,
+    // One bit per register, 8 bool constant registers followed by 32 loop
+    // constants.
+    kBoolLoopConstants,
+    // One bit per context register in 0x2000...0x23FF (RB_, PA_, as well as
+    // SQ_ and VGT_ state).
+    kRenderState,
+
+    kCount,
+  };
+
+  struct DirtyGroupInfo {
+    uint32_t first_register;
+    uint32_t register_count;
+    uint32_t registers_per_bit;
+    // Offset of the bits of the group in DirtyTracker.
+    uint32_t first_word;
+  };
+  static constexpr DirtyGroupInfo kDirtyGroups[size_t(DirtyGroup::kCount)] = {
+      {XE_GPU_REG_SHADER_CONSTANT_000_X, 512 * 4, 4, 0},
+      {XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0, 32 * 6, 6, 8},
+      {XE_GPU_REG_SHADER_CONSTANT_BOOL_000_031, 8 + 32, 1, 9},
+      {0x2000, 0x400, 1, 10},
+  };
+  static constexpr uint32_t kDirtyWordCount = 26;
+
+  // Accumulates the registers written since the owner last cleared the bits,
+  // to skip recomputation of state derived from them. Every consumer has its
+  // own tracker so it doesn't miss writes made between its invocations. All
+  // registers are initially dirty.
+  class DirtyTracker {
+   public:
+    struct Statistics {
+      uint32_t updates = 0;
+      uint32_t updates_skipped = 0;
+    };
+
+    explicit DirtyTracker(const RegisterFile& register_file);
+    DirtyTracker(const DirtyTracker& tracker) = delete;
+    DirtyTracker& operator=(const DirtyTracker& tracker) = delete;
+    ~DirtyTracker();
+
+    // Whether any tracked register in the range has been written. The range
+    // must be within one group.
+    bool IsDirty(uint32_t first_register, uint32_t register_count = 1) const;
+    bool IsDirty(DirtyGroup group) const;
+    // Bits 64 * word_index and above of the group.
+    uint64_t GetDirtyBits(DirtyGroup group, uint32_t word_index = 0) const {
+      const DirtyGroupInfo& group_info = kDirtyGroups[size_t(group)];
+      assert_true(word_index * 64 * group_info.registers_per_bit <
+                  group_info.register_count);
+      return bits_[group_info.first_word + word_index];
+    }
+    void ClearDirty(DirtyGroup group);
+    void MarkAllDirty();
+
+    void MarkDirty(uint32_t first_register, uint32_t register_count);
+
+    // Counting of updates done and skipped by the owner in a frame.
+    void CountUpdates(uint32_t updates, uint32_t updates_skipped) {
+      frame_statistics_.updates += updates;
+      frame_statistics_.updates_skipped += updates_skipped;
+    }
+    void EndFrame() {
+      last_frame_statistics_ = frame_statistics_;
+      frame_statistics_ = Statistics();
+    }
+    // For the frame last ended with EndDirtyTrackingFrame.
+    const Statistics& last_frame_statistics() const {
+      return last_frame_statistics_;
+    }
+
+   private:
+    const RegisterFile& register_file_;
+    uint64_t bits_[kDirtyWordCount];
+    Statistics frame_statistics_;
+    Statistics last_frame_statistics_;
+  };
+
   RegisterFile();
 
   static const RegisterInfo* GetRegisterInfo(uint32_t index);
@@ -40,6 +126,28 @@ class RegisterFile {
   static constexpr size_t kRegisterCount = 0x5003;
   uint32_t values[kRegisterCount];
 
+  // Must be called after writing registers directly to values for the dirty
+  // trackers to be notified.
+  void MarkDirty(uint32_t first_register, uint32_t register_count = 1) {
+    // Only the context registers and the shader constants are tracked.
+    uint32_t end_register = first_register + register_count;
+    if (dirty_trackers_.empty() || end_register <= 0x2000 ||
+        (first_register >= 0x2400 &&
+         end_register <= XE_GPU_REG_SHADER_CONSTANT_000_X) ||
+        first_register > XE_GPU_REG_SHADER_CONSTANT_LOOP_31) {
+      return;
+    }
+    for (DirtyTracker* dirty_tracker : dirty_trackers_) {
+      dirty_tracker->MarkDirty(first_register, register_count);
+    }
+  }
+  // Called on swaps by the command processor.
+  void EndDirtyTrackingFrame() {
+    for (DirtyTracker* dirty_tracker : dirty_trackers_) {
+      dirty_tracker->EndFrame();
+    }
+  }
+
   const uint32_t& operator[](uint32_t reg) const { return values[reg]; }
   uint32_t& operator[](uint32_t reg) { return values[reg]; }
 
@@ -86,6 +194,11 @@ class RegisterFile {
         sizeof(stream));
     return stream;
   }
+
+ private:
+  // Trackers are not a part of the register state, so they can be attached to
+  // a read-only register file.
+  mutable std::vector<DirtyTracker*> dirty_trackers_;
 };
 
 }  // namespace gpu
@@ -571,10 +571,9 @@ void RenderTargetCache::ClearCache() {
 
 void RenderTargetCache::BeginFrame() { ResetAccumulatedRenderTargets(); }
 
-bool RenderTargetCache::Update(bool is_rasterization_done,
-                               reg::RB_DEPTHCONTROL normalized_depth_control,
-                               uint32_t normalized_color_mask,
-                               const Shader& vertex_shader) {
+bool RenderTargetCache::SelectRenderTargets(
+    bool is_rasterization_done, reg::RB_DEPTHCONTROL normalized_depth_control,
+    uint32_t normalized_color_mask, RenderTargetSelection& selection) const {
   const RegisterFile& regs = register_file();
   bool interlock_barrier_only = GetPath() == Path::kPixelShaderInterlock;
 
@@ -632,8 +631,8 @@ bool RenderTargetCache::Update(bool is_rasterization_done,
   // Depth / stencil testing / writing is before color in the pipeline.
   uint32_t depth_and_color_rts_used_bits = 0;
   // depth_and_color_rts_used_bits -> EDRAM base.
-  uint32_t edram_bases[1 + xenos::kMaxColorRenderTargets];
-  uint32_t resource_formats[1 + xenos::kMaxColorRenderTargets];
+  uint32_t* edram_bases = selection.edram_bases;
+  uint32_t* resource_formats = selection.resource_formats;
   uint32_t rts_are_64bpp = 0;
   uint32_t color_rts_are_gamma = 0;
   if (is_rasterization_done) {
@@ -721,6 +720,60 @@ bool RenderTargetCache::Update(bool is_rasterization_done,
     }
   }
 
+  selection.msaa_samples = msaa_samples;
+  selection.pitch_tiles_at_32bpp = pitch_tiles_at_32bpp;
+  selection.depth_and_color_rts_used_bits = depth_and_color_rts_used_bits;
+  selection.rts_are_64bpp = rts_are_64bpp;
+  selection.color_rts_are_gamma = color_rts_are_gamma;
+  return true;
+}
+
+bool RenderTargetCache::Update(bool is_rasterization_done,
+                               reg::RB_DEPTHCONTROL normalized_depth_control,
+                               uint32_t normalized_color_mask,
+                               const Shader& vertex_shader) {
+  bool interlock_barrier_only = GetPath() == Path::kPixelShaderInterlock;
+
+  // The render targets to bind depend only on the RB_ surface, color and depth
+  // info registers and on the arguments - reuse the previous selection if none
+  // of them have been changed.
+  RenderTargetSelection& selection = last_update_selection_;
+  bool depth_stencil_enabled = normalized_depth_control.z_enable ||
+                               normalized_depth_control.stencil_enable;
+  bool selection_reused =
+      selection.is_valid &&
+      selection.is_rasterization_done == is_rasterization_done &&
+      selection.depth_stencil_enabled == depth_stencil_enabled &&
+      selection.normalized_color_mask == normalized_color_mask &&
+      !register_dirty_tracker_.IsDirty(
+          XE_GPU_REG_RB_SURFACE_INFO,
+          XE_GPU_REG_RB_COLOR3_INFO + 1 - XE_GPU_REG_RB_SURFACE_INFO);
+  register_dirty_tracker_.CountUpdates(uint32_t(!selection_reused),
+                                       uint32_t(selection_reused));
+  if (!selection_reused) {
+    register_dirty_tracker_.ClearDirty(RegisterFile::DirtyGroup::kRenderState);
+    selection.is_valid = false;
+    if (!SelectRenderTargets(is_rasterization_done, normalized_depth_control,
+                             normalized_color_mask, selection)) {
+      return false;
+    }
+    selection.is_valid = true;
+    selection.is_rasterization_done = is_rasterization_done;
+    selection.depth_stencil_enabled = depth_stencil_enabled;
+    selection.normalized_color_mask = normalized_color_mask;
+  }
+  xenos::MsaaSamples msaa_samples = selection.msaa_samples;
+  uint32_t pitch_tiles_at_32bpp = selection.pitch_tiles_at_32bpp;
+  uint32_t depth_and_color_rts_used_bits =
+      selection.depth_and_color_rts_used_bits;
+  const uint32_t* edram_bases = selection.edram_bases;
+  const uint32_t* resource_formats = selection.resource_formats;
+  uint32_t rts_are_64bpp = selection.rts_are_64bpp;
+  uint32_t color_rts_are_gamma = selection.color_rts_are_gamma;
+
+  uint32_t rts_remaining;
+  uint32_t rt_index;
+
   // Clear ownership transfers before adding any.
   if (!interlock_barrier_only) {
     for (size_t i = 0; i < xe::countof(last_update_transfers_); ++i) {
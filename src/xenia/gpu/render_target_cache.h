@@ -215,6 +215,11 @@ class RenderTargetCache {
                       reg::RB_DEPTHCONTROL normalized_depth_control,
                       uint32_t normalized_color_mask,
                       const Shader& vertex_shader);
+  // Render target selections performed and reused in Update in the last frame.
+  const RegisterFile::DirtyTracker::Statistics&
+  last_frame_render_target_selection_statistics() const {
+    return register_dirty_tracker_.last_frame_statistics();
+  }
 
   // Returns bits where 0 is whether a depth render target is currently bound on
   // the host and 1... are whether the same applies to color render targets, and
@@ -229,6 +234,7 @@ class RenderTargetCache {
                     TraceWriter* trace_writer, uint32_t draw_resolution_scale_x,
                     uint32_t draw_resolution_scale_y)
       : register_file_(register_file),
+        register_dirty_tracker_(register_file),
         draw_resolution_scale_x_(draw_resolution_scale_x),
         draw_resolution_scale_y_(draw_resolution_scale_y),
         draw_extent_estimator_(register_file, memory, trace_writer) {
@@ -617,7 +623,33 @@ class RenderTargetCache {
   void PixelShaderInterlockFullEdramBarrierPlaced();
 
  private:
+  // Render targets needed by the guest state, derived from the RB_ registers in
+  // Update.
+  struct RenderTargetSelection {
+    bool is_valid = false;
+    // Update arguments the selection was made for.
+    bool is_rasterization_done;
+    bool depth_stencil_enabled;
+    uint32_t normalized_color_mask;
+
+    xenos::MsaaSamples msaa_samples;
+    uint32_t pitch_tiles_at_32bpp;
+    // 0 is depth / stencil, 1...4 are color.
+    uint32_t depth_and_color_rts_used_bits;
+    uint32_t edram_bases[1 + xenos::kMaxColorRenderTargets];
+    uint32_t resource_formats[1 + xenos::kMaxColorRenderTargets];
+    uint32_t rts_are_64bpp;
+    // Bits 0...3 for color render targets.
+    uint32_t color_rts_are_gamma;
+  };
+  bool SelectRenderTargets(bool is_rasterization_done,
+                           reg::RB_DEPTHCONTROL normalized_depth_control,
+                           uint32_t normalized_color_mask,
+                           RenderTargetSelection& selection) const;
+
   const RegisterFile& register_file_;
+  // For the RB_ registers the render target selection depends on.
+  RegisterFile::DirtyTracker register_dirty_tracker_;
   uint32_t draw_resolution_scale_x_;
   uint32_t draw_resolution_scale_y_;
 
@@ -763,6 +795,7 @@ class RenderTargetCache {
   // last_update_accumulated_render_targets_ - it's not beneficial or even
   // incorrect to keep the previously bound render targets.
   bool are_accumulated_render_targets_valid_ = false;
+  RenderTargetSelection last_update_selection_;
   // After an update (for simplicity, even an unsuccessful update invalidates
   // this), contains needed ownership transfer sources for each of the current
   // render targets. They are reordered so for one source, all transfers are
@@ -9,21 +9,170 @@
 
 #include "xenia/gpu/shader.h"
 
+#include <algorithm>
 #include <cinttypes>
 #include <cstring>
+#include <iterator>
+#include <type_traits>
 #include <utility>
 
 #include "third_party/fmt/include/fmt/format.h"
+#include "xenia/base/assert.h"
 #include "xenia/base/filesystem.h"
 #include "xenia/base/math.h"
 #include "xenia/base/memory.h"
 #include "xenia/base/string.h"
+#include "xenia/gpu/gpu_flags.h"
 #include "xenia/gpu/ucode.h"
 
 namespace xe {
 namespace gpu {
 using namespace ucode;
 
+namespace {
+// Serialized results of Shader::AnalyzeUcode, followed by the disassembly, the
+// vertex bindings (each with its attributes), the texture bindings, the label
+// addresses, the memexport info and the memexport stream constants.
+struct UcodeAnalysisHeader {
+  Shader::ConstantRegisterMap constant_register_map;
+  uint32_t ucode_disassembly_length;
+  uint32_t vertex_binding_count;
+  uint32_t texture_binding_count;
+  uint32_t label_address_count;
+  uint32_t cf_memexport_info_count;
+  uint32_t memexport_stream_constant_count;
+  uint32_t cf_pair_index_bound;
+  uint32_t register_static_address_bound;
+  uint32_t writes_interpolators;
+  uint32_t writes_point_size_edge_flag_kill_vertex;
+  uint32_t writes_color_targets;
+  uint8_t uses_register_dynamic_addressing;
+  uint8_t kills_pixels;
+  uint8_t uses_texture_fetch_instruction_results;
+  uint8_t writes_depth;
+  uint8_t memexport_eM_written;
+  uint8_t memexport_eM_potentially_written_before_end;
+};
+// Followed by attribute_count VertexBinding::Attribute structures.
+struct UcodeAnalysisVertexBindingHeader {
+  int32_t binding_index;
+  uint32_t fetch_constant;
+  uint32_t stride_words;
+  uint32_t attribute_count;
+};
+// The opcode names in the parsed fetch instructions are pointers, they're
+// written as null and restored on deserialization.
+static_assert(std::is_trivially_copyable_v<Shader::ConstantRegisterMap>);
+static_assert(std::is_trivially_copyable_v<Shader::VertexBinding::Attribute>);
+static_assert(std::is_trivially_copyable_v<Shader::TextureBinding>);
+static_assert(std::is_trivially_copyable_v<Shader::ControlFlowMemExportInfo>);
+
+// Copying the structures stored directly member by member into zeroed memory
+// so the padding doesn't contain leftovers from the stack or the heap, and the
+// stored data is deterministic. Must be updated when adding members.
+void CopyWithoutPadding(InstructionResult& dest,
+                        const InstructionResult& source) {
+  std::memset(static_cast<void*>(&dest), 0, sizeof(dest));
+  dest.storage_target = source.storage_target;
+  dest.storage_index = source.storage_index;
+  dest.storage_addressing_mode = source.storage_addressing_mode;
+  dest.is_clamped = source.is_clamped;
+  dest.original_write_mask = source.original_write_mask;
+  std::copy(std::begin(source.components), std::end(source.components),
+            dest.components);
+}
+
+void CopyWithoutPadding(InstructionOperand& dest,
+                        const InstructionOperand& source) {
+  std::memset(static_cast<void*>(&dest), 0, sizeof(dest));
+  dest.storage_source = source.storage_source;
+  dest.storage_index = source.storage_index;
+  dest.storage_addressing_mode = source.storage_addressing_mode;
+  dest.is_negated = source.is_negated;
+  dest.is_absolute_value = source.is_absolute_value;
+  dest.component_count = source.component_count;
+  std::copy(std::begin(source.components), std::end(source.components),
+            dest.components);
+}
+
+// The opcode name is not copied.
+void CopyWithoutPadding(ParsedVertexFetchInstruction& dest,
+                        const ParsedVertexFetchInstruction& source) {
+  std::memset(static_cast<void*>(&dest), 0, sizeof(dest));
+  dest.opcode = source.opcode;
+  dest.is_mini_fetch = source.is_mini_fetch;
+  dest.is_predicated = source.is_predicated;
+  dest.predicate_condition = source.predicate_condition;
+  CopyWithoutPadding(dest.result, source.result);
+  dest.operand_count = source.operand_count;
+  for (size_t i = 0; i < std::size(source.operands); ++i) {
+    CopyWithoutPadding(dest.operands[i], source.operands[i]);
+  }
+  ParsedVertexFetchInstruction::Attributes& dest_attributes = dest.attributes;
+  const ParsedVertexFetchInstruction::Attributes& source_attributes =
+      source.attributes;
+  dest_attributes.data_format = source_attributes.data_format;
+  dest_attributes.offset = source_attributes.offset;
+  dest_attributes.stride = source_attributes.stride;
+  dest_attributes.exp_adjust = source_attributes.exp_adjust;
+  dest_attributes.prefetch_count = source_attributes.prefetch_count;
+  dest_attributes.signed_rf_mode = source_attributes.signed_rf_mode;
+  dest_attributes.is_index_rounded = source_attributes.is_index_rounded;
+  dest_attributes.is_signed = source_attributes.is_signed;
+  dest_attributes.is_integer = source_attributes.is_integer;
+}
+
+// The opcode name is not copied.
+void CopyWithoutPadding(ParsedTextureFetchInstruction& dest,
+                        const ParsedTextureFetchInstruction& source) {
+  std::memset(static_cast<void*>(&dest), 0, sizeof(dest));
+  dest.opcode = source.opcode;
+  dest.dimension = source.dimension;
+  dest.is_predicated = source.is_predicated;
+  dest.predicate_condition = source.predicate_condition;
+  CopyWithoutPadding(dest.result, source.result);
+  dest.operand_count = source.operand_count;
+  for (size_t i = 0; i < std::size(source.operands); ++i) {
+    CopyWithoutPadding(dest.operands[i], source.operands[i]);
+  }
+  ParsedTextureFetchInstruction::Attributes& dest_attributes =
+      dest.attributes;
+  const ParsedTextureFetchInstruction::Attributes& source_attributes =
+      source.attributes;
+  dest_attributes.fetch_valid_only = source_attributes.fetch_valid_only;
+  dest_attributes.unnormalized_coordinates =
+      source_attributes.unnormalized_coordinates;
+  dest_attributes.mag_filter = source_attributes.mag_filter;
+  dest_attributes.min_filter = source_attributes.min_filter;
+  dest_attributes.mip_filter = source_attributes.mip_filter;
+  dest_attributes.aniso_filter = source_attributes.aniso_filter;
+  dest_attributes.vol_mag_filter = source_attributes.vol_mag_filter;
+  dest_attributes.vol_min_filter = source_attributes.vol_min_filter;
+  dest_attributes.use_computed_lod = source_attributes.use_computed_lod;
+  dest_attributes.use_register_lod = source_attributes.use_register_lod;
+  dest_attributes.use_register_gradients =
+      source_attributes.use_register_gradients;
+  dest_attributes.lod_bias = source_attributes.lod_bias;
+  dest_attributes.offset_x = source_attributes.offset_x;
+  dest_attributes.offset_y = source_attributes.offset_y;
+  dest_attributes.offset_z = source_attributes.offset_z;
+}
+
+void CopyWithoutPadding(Shader::ConstantRegisterMap& dest,
+                        const Shader::ConstantRegisterMap& source) {
+  std::memset(static_cast<void*>(&dest), 0, sizeof(dest));
+  std::copy(std::begin(source.float_bitmap), std::end(source.float_bitmap),
+            dest.float_bitmap);
+  dest.loop_bitmap = source.loop_bitmap;
+  std::copy(std::begin(source.bool_bitmap), std::end(source.bool_bitmap),
+            dest.bool_bitmap);
+  std::copy(std::begin(source.vertex_fetch_bitmap),
+            std::end(source.vertex_fetch_bitmap), dest.vertex_fetch_bitmap);
+  dest.float_count = source.float_count;
+  dest.float_dynamic_addressing = source.float_dynamic_addressing;
+}
+}  // namespace
+
 Shader::Shader(xenos::ShaderType shader_type, uint64_t ucode_data_hash,
                const uint32_t* ucode_dwords, size_t ucode_dword_count,
                std::endian ucode_source_endian)
@@ -44,6 +193,216 @@ Shader::~Shader() {
   }
 }
 
+void Shader::SerializeUcodeAnalysis(std::vector<uint8_t>& data_out) const {
+  assert_true(is_ucode_analyzed_);
+  data_out.clear();
+  auto append = [&data_out](const void* data, size_t size) {
+    size_t offset = data_out.size();
+    data_out.resize(offset + size);
+    std::memcpy(data_out.data() + offset, data, size);
+  };
+
+  UcodeAnalysisHeader header;
+  // Not leaving the padding uninitialized.
+  std::memset(&header, 0, sizeof(header));
+  CopyWithoutPadding(header.constant_register_map, constant_register_map_);
+  header.ucode_disassembly_length = uint32_t(ucode_disassembly_.size());
+  header.vertex_binding_count = uint32_t(vertex_bindings_.size());
+  header.texture_binding_count = uint32_t(texture_bindings_.size());
+  header.label_address_count = uint32_t(label_addresses_.size());
+  header.cf_memexport_info_count = uint32_t(cf_memexport_info_.size());
+  header.memexport_stream_constant_count =
+      uint32_t(memexport_stream_constants_.size());
+  header.cf_pair_index_bound = cf_pair_index_bound_;
+  header.register_static_address_bound = register_static_address_bound_;
+  header.writes_interpolators = writes_interpolators_;
+  header.writes_point_size_edge_flag_kill_vertex =
+      writes_point_size_edge_flag_kill_vertex_;
+  header.writes_color_targets = writes_color_targets_;
+  header.uses_register_dynamic_addressing = uses_register_dynamic_addressing_;
+  header.kills_pixels = kills_pixels_;
+  header.uses_texture_fetch_instruction_results =
+      uses_texture_fetch_instruction_results_;
+  header.writes_depth = writes_depth_;
+  header.memexport_eM_written = memexport_eM_written_;
+  header.memexport_eM_potentially_written_before_end =
+      memexport_eM_potentially_written_before_end_;
+  append(&header, sizeof(header));
+
+  append(ucode_disassembly_.data(), ucode_disassembly_.size());
+
+  for (const VertexBinding& vertex_binding : vertex_bindings_) {
+    UcodeAnalysisVertexBindingHeader vertex_binding_header;
+    vertex_binding_header.binding_index = vertex_binding.binding_index;
+    vertex_binding_header.fetch_constant = vertex_binding.fetch_constant;
+    vertex_binding_header.stride_words = vertex_binding.stride_words;
+    vertex_binding_header.attribute_count =
+        uint32_t(vertex_binding.attributes.size());
+    append(&vertex_binding_header, sizeof(vertex_binding_header));
+    for (const VertexBinding::Attribute& attribute :
+         vertex_binding.attributes) {
+      VertexBinding::Attribute attribute_stored;
+      CopyWithoutPadding(attribute_stored.fetch_instr, attribute.fetch_instr);
+      append(&attribute_stored, sizeof(attribute_stored));
+    }
+  }
+
+  for (const TextureBinding& texture_binding : texture_bindings_) {
+    TextureBinding texture_binding_stored;
+    std::memset(static_cast<void*>(&texture_binding_stored), 0,
+                sizeof(texture_binding_stored));
+    texture_binding_stored.binding_index = texture_binding.binding_index;
+    texture_binding_stored.fetch_constant = texture_binding.fetch_constant;
+    CopyWithoutPadding(texture_binding_stored.fetch_instr,
+                       texture_binding.fetch_instr);
+    append(&texture_binding_stored, sizeof(texture_binding_stored));
+  }
+
+  for (uint32_t label_address : label_addresses_) {
+    append(&label_address, sizeof(label_address));
+  }
+
+  // Only bytes, no padding.
+  append(cf_memexport_info_.data(),
+         sizeof(ControlFlowMemExportInfo) * cf_memexport_info_.size());
+
+  for (uint32_t memexport_stream_constant : memexport_stream_constants_) {
+    append(&memexport_stream_constant, sizeof(memexport_stream_constant));
+  }
+}
+
+bool Shader::DeserializeUcodeAnalysis(const uint8_t* data, size_t data_size) {
+  assert_false(is_ucode_analyzed_);
+  size_t data_offset = 0;
+  auto read = [&](void* value, size_t size) {
+    if (data_size - data_offset < size) {
+      return false;
+    }
+    std::memcpy(value, data + data_offset, size);
+    data_offset += size;
+    return true;
+  };
+
+  UcodeAnalysisHeader header;
+  if (!read(&header, sizeof(header))) {
+    return false;
+  }
+
+  // Gather everything before modifying the shader in case the data is
+  // malformed.
+  std::string ucode_disassembly;
+  if (data_size - data_offset < header.ucode_disassembly_length) {
+    return false;
+  }
+  ucode_disassembly.assign(
+      reinterpret_cast<const char*>(data + data_offset),
+      header.ucode_disassembly_length);
+  data_offset += header.ucode_disassembly_length;
+
+  std::vector<VertexBinding> vertex_bindings;
+  vertex_bindings.reserve(header.vertex_binding_count);
+  for (uint32_t i = 0; i < header.vertex_binding_count; ++i) {
+    UcodeAnalysisVertexBindingHeader vertex_binding_header;
+    if (!read(&vertex_binding_header, sizeof(vertex_binding_header))) {
+      return false;
+    }
+    VertexBinding& vertex_binding = vertex_bindings.emplace_back();
+    vertex_binding.binding_index = vertex_binding_header.binding_index;
+    vertex_binding.fetch_constant = vertex_binding_header.fetch_constant;
+    vertex_binding.stride_words = vertex_binding_header.stride_words;
+    if ((data_size - data_offset) / sizeof(VertexBinding::Attribute) <
+        vertex_binding_header.attribute_count) {
+      return false;
+    }
+    vertex_binding.attributes.resize(vertex_binding_header.attribute_count);
+    for (VertexBinding::Attribute& attribute : vertex_binding.attributes) {
+      read(&attribute, sizeof(attribute));
+      ParsedVertexFetchInstruction& fetch_instr = attribute.fetch_instr;
+      if (fetch_instr.opcode != FetchOpcode::kVertexFetch) {
+        return false;
+      }
+      fetch_instr.opcode_name =
+          fetch_instr.is_mini_fetch ? "vfetch_mini" : "vfetch_full";
+    }
+  }
+
+  if ((data_size - data_offset) / sizeof(TextureBinding) <
+      header.texture_binding_count) {
+    return false;
+  }
+  std::vector<TextureBinding> texture_bindings(header.texture_binding_count);
+  for (TextureBinding& texture_binding : texture_bindings) {
+    read(&texture_binding, sizeof(texture_binding));
+    ParsedTextureFetchInstruction& fetch_instr = texture_binding.fetch_instr;
+    fetch_instr.opcode_name =
+        GetTextureFetchOpcodeName(fetch_instr.opcode, fetch_instr.dimension);
+    if (!fetch_instr.opcode_name) {
+      return false;
+    }
+  }
+
+  std::set<uint32_t> label_addresses;
+  for (uint32_t i = 0; i < header.label_address_count; ++i) {
+    uint32_t label_address;
+    if (!read(&label_address, sizeof(label_address))) {
+      return false;
+    }
+    label_addresses.insert(label_address);
+  }
+
+  if ((data_size - data_offset) / sizeof(ControlFlowMemExportInfo) <
+      header.cf_memexport_info_count) {
+    return false;
+  }
+  std::vector<ControlFlowMemExportInfo> cf_memexport_info(
+      header.cf_memexport_info_count);
+  read(cf_memexport_info.data(),
+       sizeof(ControlFlowMemExportInfo) * cf_memexport_info.size());
+
+  std::set<uint32_t> memexport_stream_constants;
+  for (uint32_t i = 0; i < header.memexport_stream_constant_count; ++i) {
+    uint32_t memexport_stream_constant;
+    if (!read(&memexport_stream_constant, sizeof(memexport_stream_constant))) {
+      return false;
+    }
+    memexport_stream_constants.insert(memexport_stream_constant);
+  }
+
+  if (data_offset != data_size) {
+    return false;
+  }
+
+  ucode_disassembly_ = std::move(ucode_disassembly);
+  vertex_bindings_ = std::move(vertex_bindings);
+  texture_bindings_ = std::move(texture_bindings);
+  CopyWithoutPadding(constant_register_map_, header.constant_register_map);
+  label_addresses_ = std::move(label_addresses);
+  cf_pair_index_bound_ = header.cf_pair_index_bound;
+  register_static_address_bound_ = header.register_static_address_bound;
+  writes_interpolators_ = header.writes_interpolators;
+  writes_point_size_edge_flag_kill_vertex_ =
+      header.writes_point_size_edge_flag_kill_vertex;
+  writes_color_targets_ = header.writes_color_targets;
+  uses_register_dynamic_addressing_ =
+      header.uses_register_dynamic_addressing != 0;
+  kills_pixels_ = header.kills_pixels != 0;
+  uses_texture_fetch_instruction_results_ =
+      header.uses_texture_fetch_instruction_results != 0;
+  writes_depth_ = header.writes_depth != 0;
+  cf_memexport_info_ = std::move(cf_memexport_info);
+  memexport_eM_written_ = header.memexport_eM_written;
+  memexport_eM_potentially_written_before_end_ =
+      header.memexport_eM_potentially_written_before_end;
+  memexport_stream_constants_ = std::move(memexport_stream_constants);
+  is_ucode_analyzed_ = true;
+
+  // Like after AnalyzeUcode, which this replaces.
+  if (!cvars::dump_shaders.empty() && !ucode_data().empty()) {
+    DumpUcode(cvars::dump_shaders);
+  }
+  return true;
+}
+
 std::string Shader::Translation::GetTranslatedBinaryString() const {
   std::string result;
   result.resize(translated_binary_.size());
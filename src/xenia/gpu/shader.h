@@ -646,6 +646,9 @@ bool ParseVertexFetchInstruction(
     ParsedVertexFetchInstruction& instr);
 void ParseTextureFetchInstruction(const ucode::TextureFetchInstruction& op,
                                   ParsedTextureFetchInstruction& instr);
+// Returns nullptr for opcodes that are not texture fetch opcodes.
+const char* GetTextureFetchOpcodeName(ucode::FetchOpcode opcode,
+                                      xenos::FetchOpDimension dimension);
 void ParseAluInstruction(const ucode::AluInstruction& op,
                          xenos::ShaderType shader_type,
                          ParsedAluInstruction& instr);
@@ -865,6 +868,19 @@ class Shader {
   // externally so it won't need to be reallocated for every shader).
   void AnalyzeUcode(StringBuffer& ucode_disasm_buffer);
 
+  // Version of the results of AnalyzeUcode for persistent storage (see
+  // UcodeAnalysisCache) - must be updated when changing what is gathered or
+  // how.
+  static constexpr uint32_t kUcodeAnalysisVersion = 0x20241019;
+  // Writes the results of AnalyzeUcode in the host's native layout. Must be
+  // called only after the analysis.
+  void SerializeUcodeAnalysis(std::vector<uint8_t>& data_out) const;
+  // Restores the results of AnalyzeUcode written by SerializeUcodeAnalysis for
+  // the same ucode, as an alternative to the analysis. Returns false without
+  // modifying the shader if the data is malformed. Must be called only before
+  // the analysis.
+  bool DeserializeUcodeAnalysis(const uint8_t* data, size_t data_size);
+
   // The following parameters, until the translation, are valid if ucode
   // information has been gathered.
 
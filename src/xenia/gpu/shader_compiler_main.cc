@@ -7,10 +7,16 @@
  ******************************************************************************
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cinttypes>
 #include <cstring>
+#include <filesystem>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -18,14 +24,19 @@
 #include "xenia/base/assert.h"
 #include "xenia/base/console_app_main.h"
 #include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/platform.h"
 #include "xenia/base/string.h"
 #include "xenia/base/string_buffer.h"
+#include "xenia/base/threading.h"
+#include "xenia/base/xxhash.h"
 #include "xenia/gpu/dxbc_shader_translator.h"
 #include "xenia/gpu/shader_translator.h"
 #include "xenia/gpu/spirv_shader_translator.h"
+#include "xenia/gpu/ucode_analysis_cache.h"
 #include "xenia/gpu/xenos.h"
+#include "xenia/ui/vulkan/spirv_optimization_cache.h"
 #include "xenia/ui/vulkan/spirv_tools_context.h"
 
 // For D3DDisassemble:
@@ -33,7 +44,12 @@
 #include "xenia/ui/d3d12/d3d12_api.h"
 #endif  // XE_PLATFORM_WIN32
 
-DEFINE_path(shader_input, "", "Input shader binary file path.", "GPU");
+DEFINE_path(
+    shader_input, "",
+    "Input shader binary file path. For batch translation, a directory with "
+    ".vs and .ps files or with dump_shaders .ucode.bin files, or an .xsh "
+    "shader storage file.",
+    "GPU");
 DEFINE_string(shader_input_type, "",
               "'vs', 'ps', or unspecified to infer from the given filename.",
               "GPU");
@@ -42,7 +58,9 @@ DEFINE_bool(
     "Whether the input shader binary is little-endian (from an Arm device with "
     "the Qualcomm Adreno 200, for instance).",
     "GPU");
-DEFINE_path(shader_output, "", "Output shader file path.", "GPU");
+DEFINE_path(shader_output, "",
+            "Output shader file path, or directory for batch translation.",
+            "GPU");
 DEFINE_string(shader_output_type, "ucode",
               "Translator to use: [ucode, spirv, spirvtext, dxbc, dxbctext].",
               "GPU");
@@ -50,7 +68,8 @@ DEFINE_string(
     vertex_shader_output_type, "",
     "Type of the host interface to produce the vertex or domain shader for: "
     "[vertex or unspecified, linedomaincp, linedomainpatch, triangledomaincp, "
-    "triangledomainpatch, quaddomaincp, quaddomainpatch].",
+    "triangledomainpatch, quaddomaincp, quaddomainpatch], or all of them for "
+    "batch translation with 'all'.",
     "GPU");
 DEFINE_bool(shader_output_bindless_resources, false,
             "Output host shader with bindless resources used.", "GPU");
@@ -59,11 +78,533 @@ DEFINE_bool(
     "Output host shader with a render backend implementation based on pixel "
     "shader interlock.",
     "GPU");
+DEFINE_bool(
+    shader_output_spirv_optimize, false,
+    "Optimize the SPIR-V output with SPIRV-Tools, like the Vulkan backend with "
+    "vulkan_spirv_optimization. For batch translation, the instruction counts "
+    "and the time before and after the optimization are reported.",
+    "GPU");
+DEFINE_path(
+    shader_output_spirv_optimization_cache, "",
+    "File to load the previously optimized SPIR-V from and to store the newly "
+    "optimized SPIR-V to for batch translation with "
+    "shader_output_spirv_optimize.",
+    "GPU");
+DEFINE_path(
+    shader_ucode_analysis_cache, "",
+    "File to load the previously gathered ucode analysis results from and to "
+    "store the new ones to for batch translation, for comparing the cold and "
+    "the warm analysis time.",
+    "GPU");
+DEFINE_uint32(shader_batch_threads, 0,
+              "Number of threads for batch translation, or 0 to use all "
+              "logical processors.",
+              "GPU");
 
 namespace xe {
 namespace gpu {
 
+static Shader::HostVertexShaderType GetHostVertexShaderType(
+    const std::string& vertex_shader_output_type) {
+  if (vertex_shader_output_type == "linedomaincp") {
+    return Shader::HostVertexShaderType::kLineDomainCPIndexed;
+  }
+  if (vertex_shader_output_type == "linedomainpatch") {
+    return Shader::HostVertexShaderType::kLineDomainPatchIndexed;
+  }
+  if (vertex_shader_output_type == "triangledomaincp") {
+    return Shader::HostVertexShaderType::kTriangleDomainCPIndexed;
+  }
+  if (vertex_shader_output_type == "triangledomainpatch") {
+    return Shader::HostVertexShaderType::kTriangleDomainPatchIndexed;
+  }
+  if (vertex_shader_output_type == "quaddomaincp") {
+    return Shader::HostVertexShaderType::kQuadDomainCPIndexed;
+  }
+  if (vertex_shader_output_type == "quaddomainpatch") {
+    return Shader::HostVertexShaderType::kQuadDomainPatchIndexed;
+  }
+  return Shader::HostVertexShaderType::kVertex;
+}
+
+static std::unique_ptr<ShaderTranslator> CreateTranslator(
+    const SpirvShaderTranslator::Features& spirv_features) {
+  if (cvars::shader_output_type == "spirv" ||
+      cvars::shader_output_type == "spirvtext") {
+    return std::make_unique<SpirvShaderTranslator>(
+        spirv_features, true, true,
+        cvars::shader_output_pixel_shader_interlock);
+  }
+  if (cvars::shader_output_type == "dxbc" ||
+      cvars::shader_output_type == "dxbctext") {
+    return std::make_unique<DxbcShaderTranslator>(
+        ui::GraphicsProvider::GpuVendorID(0),
+        cvars::shader_output_bindless_resources,
+        cvars::shader_output_pixel_shader_interlock);
+  }
+  return nullptr;
+}
+
+// Number of instructions after the 5-word header of a SPIR-V module.
+static size_t CountSpirvInstructions(const uint32_t* words, size_t word_count) {
+  size_t instruction_count = 0;
+  size_t word_index = 5;
+  while (word_index < word_count) {
+    uint32_t instruction_word_count = words[word_index] >> 16;
+    if (!instruction_word_count) {
+      break;
+    }
+    ++instruction_count;
+    word_index += instruction_word_count;
+  }
+  return instruction_count;
+}
+
+// The format of the guest shader storage of the Direct3D 12 pipeline cache
+// (<title ID>.xsh).
+XEPACKEDSTRUCT(ShaderStoredHeader, {
+  uint64_t ucode_data_hash;
+
+  uint32_t ucode_dword_count : 31;
+  xenos::ShaderType type : 1;
+
+  // Must match the version in the pipeline cache.
+  static constexpr uint32_t kVersion = 0x20201219;
+});
+// 'XESH'.
+constexpr uint32_t kShaderStorageMagic = 0x48534558;
+
+static bool LoadShaderStorage(const std::filesystem::path& path,
+                              std::vector<std::unique_ptr<Shader>>& shaders) {
+  FILE* file = filesystem::OpenFile(path, "rb");
+  if (!file) {
+    XELOGE("Unable to open the shader storage file: {}",
+           xe::path_to_utf8(path));
+    return false;
+  }
+  struct {
+    uint32_t magic;
+    uint32_t version_swapped;
+  } file_header;
+  if (!fread(&file_header, sizeof(file_header), 1, file) ||
+      file_header.magic != kShaderStorageMagic ||
+      xe::byte_swap(file_header.version_swapped) !=
+          ShaderStoredHeader::kVersion) {
+    XELOGE("{} is not a shader storage file of a supported version",
+           xe::path_to_utf8(path));
+    fclose(file);
+    return false;
+  }
+  std::unordered_set<uint64_t> shaders_loaded;
+  ShaderStoredHeader shader_header;
+  std::vector<uint32_t> ucode_dwords;
+  while (fread(&shader_header, sizeof(shader_header), 1, file)) {
+    size_t ucode_byte_count =
+        shader_header.ucode_dword_count * sizeof(uint32_t);
+    ucode_dwords.resize(shader_header.ucode_dword_count);
+    if (shader_header.ucode_dword_count &&
+        !fread(ucode_dwords.data(), ucode_byte_count, 1, file)) {
+      break;
+    }
+    uint64_t ucode_data_hash =
+        XXH3_64bits(ucode_dwords.data(), ucode_byte_count);
+    if (shader_header.ucode_data_hash != ucode_data_hash) {
+      XELOGW("Stopping at a corrupted shader in the storage file");
+      break;
+    }
+    if (!shaders_loaded.insert(ucode_data_hash).second) {
+      continue;
+    }
+    shaders.push_back(std::make_unique<Shader>(
+        xenos::ShaderType(shader_header.type), ucode_data_hash,
+        ucode_dwords.data(), ucode_dwords.size()));
+  }
+  fclose(file);
+  return true;
+}
+
+// Loads .vs and .ps files (big-endian unless specified otherwise), and
+// .ucode.bin.vert and .ucode.bin.frag files written with dump_shaders.
+static bool LoadShaderDirectory(const std::filesystem::path& path,
+                                std::vector<std::unique_ptr<Shader>>& shaders) {
+  std::vector<filesystem::FileInfo> files = filesystem::ListFiles(path);
+  std::sort(files.begin(), files.end(),
+            [](const filesystem::FileInfo& a, const filesystem::FileInfo& b) {
+              return a.name < b.name;
+            });
+  std::unordered_set<uint64_t> shaders_loaded;
+  std::vector<uint32_t> ucode_dwords;
+  for (const filesystem::FileInfo& file_info : files) {
+    if (file_info.type != filesystem::FileInfo::Type::kFile) {
+      continue;
+    }
+    std::filesystem::path extension = file_info.name.extension();
+    std::endian ucode_endian = cvars::shader_input_little_endian
+                                   ? std::endian::little
+                                   : std::endian::big;
+    xenos::ShaderType shader_type;
+    if (extension == ".vs") {
+      shader_type = xenos::ShaderType::kVertex;
+    } else if (extension == ".ps") {
+      shader_type = xenos::ShaderType::kPixel;
+    } else if (file_info.name.stem().extension() == ".bin" &&
+               (extension == ".vert" || extension == ".frag")) {
+      // Dumped after the conversion to the host endianness.
+      shader_type = extension == ".vert" ? xenos::ShaderType::kVertex
+                                         : xenos::ShaderType::kPixel;
+      ucode_endian = std::endian::native;
+    } else {
+      continue;
+    }
+    std::filesystem::path file_path = file_info.path / file_info.name;
+    FILE* file = filesystem::OpenFile(file_path, "rb");
+    if (!file) {
+      XELOGW("Unable to open {}", xe::path_to_utf8(file_path));
+      continue;
+    }
+    ucode_dwords.resize(size_t(file_info.total_size / sizeof(uint32_t)));
+    size_t ucode_byte_count = ucode_dwords.size() * sizeof(uint32_t);
+    bool read = !ucode_byte_count ||
+                fread(ucode_dwords.data(), ucode_byte_count, 1, file);
+    fclose(file);
+    if (!read) {
+      XELOGW("Unable to read {}", xe::path_to_utf8(file_path));
+      continue;
+    }
+    uint64_t ucode_data_hash =
+        XXH3_64bits(ucode_dwords.data(), ucode_byte_count);
+    if (!shaders_loaded.insert(ucode_data_hash).second) {
+      continue;
+    }
+    shaders.push_back(std::make_unique<Shader>(
+        shader_type, ucode_data_hash, ucode_dwords.data(), ucode_dwords.size(),
+        ucode_endian));
+  }
+  return true;
+}
+
+// Translates many shaders on multiple threads, mainly for benchmarking the
+// translators.
+static int shader_compiler_batch_main() {
+  std::vector<std::unique_ptr<Shader>> shaders;
+  if (std::filesystem::is_directory(cvars::shader_input)) {
+    if (!LoadShaderDirectory(cvars::shader_input, shaders)) {
+      return 1;
+    }
+  } else {
+    if (!LoadShaderStorage(cvars::shader_input, shaders)) {
+      return 1;
+    }
+  }
+  XELOGI("Loaded {} shaders from {}", shaders.size(),
+         xe::path_to_utf8(cvars::shader_input));
+
+  SpirvShaderTranslator::Features spirv_features(true);
+  const char* output_extension;
+  if (cvars::shader_output_type == "spirv" ||
+      cvars::shader_output_type == "spirvtext") {
+    output_extension = "spv";
+  } else if (cvars::shader_output_type == "dxbc" ||
+             cvars::shader_output_type == "dxbctext") {
+    output_extension = "dxbc";
+  } else {
+    // Only the microcode analysis.
+    output_extension = nullptr;
+  }
+  if (!cvars::shader_output.empty()) {
+    std::filesystem::create_directories(cvars::shader_output);
+  }
+
+  UcodeAnalysisCache ucode_analysis_cache;
+  if (!cvars::shader_ucode_analysis_cache.empty() &&
+      !ucode_analysis_cache.Open(cvars::shader_ucode_analysis_cache)) {
+    return 1;
+  }
+
+  // Shared between the translation threads, so the optimization of identical
+  // translations is done only once.
+  ui::vulkan::SpirvToolsContext spirv_tools_context;
+  std::unique_ptr<ui::vulkan::SpirvOptimizationCache> spirv_optimization_cache;
+  if (cvars::shader_output_spirv_optimize &&
+      (cvars::shader_output_type == "spirv" ||
+       cvars::shader_output_type == "spirvtext")) {
+    if (!spirv_tools_context.Initialize(spirv_features.spirv_version) ||
+        !spirv_tools_context.IsOptimizerAvailable()) {
+      XELOGE("The SPIRV-Tools optimizer is not available");
+      return 1;
+    }
+    spirv_optimization_cache =
+        std::make_unique<ui::vulkan::SpirvOptimizationCache>(
+            spirv_tools_context);
+    if (!cvars::shader_output_spirv_optimization_cache.empty()) {
+      spirv_optimization_cache->Open(
+          cvars::shader_output_spirv_optimization_cache);
+    }
+  }
+
+  std::vector<Shader::HostVertexShaderType> host_vertex_shader_types;
+  if (cvars::vertex_shader_output_type == "all") {
+    host_vertex_shader_types = {
+        Shader::HostVertexShaderType::kVertex,
+        Shader::HostVertexShaderType::kLineDomainCPIndexed,
+        Shader::HostVertexShaderType::kLineDomainPatchIndexed,
+        Shader::HostVertexShaderType::kTriangleDomainCPIndexed,
+        Shader::HostVertexShaderType::kTriangleDomainPatchIndexed,
+        Shader::HostVertexShaderType::kQuadDomainCPIndexed,
+        Shader::HostVertexShaderType::kQuadDomainPatchIndexed,
+    };
+  } else {
+    host_vertex_shader_types.push_back(
+        GetHostVertexShaderType(cvars::vertex_shader_output_type));
+  }
+
+  // Not all fields are assigned on every path (the ucode-only mode has no
+  // modifications, and optimization may be disabled), but all are printed.
+  struct TranslationResult {
+    const Shader* shader = nullptr;
+    uint64_t modification = 0;
+    bool succeeded = false;
+    size_t size = 0;
+    std::chrono::steady_clock::duration duration{};
+    // SPIR-V optimization results, if enabled.
+    bool optimized = false;
+    bool optimization_cached = false;
+    size_t instruction_count = 0;
+    size_t optimized_instruction_count = 0;
+    size_t optimized_size = 0;
+    std::chrono::steady_clock::duration optimization_duration{};
+  };
+  // Written only by the thread processing the shader.
+  std::vector<std::vector<TranslationResult>> shader_results(shaders.size());
+  std::vector<std::chrono::steady_clock::duration> analysis_durations(
+      shaders.size());
+  std::vector<uint8_t> analyses_cached(shaders.size());
+  std::atomic<size_t> next_shader_index{0};
+  auto translation_thread_function = [&]() {
+    StringBuffer ucode_disasm_buffer;
+    std::unique_ptr<ShaderTranslator> translator =
+        CreateTranslator(spirv_features);
+    std::vector<uint32_t> optimized_spirv;
+    for (;;) {
+      size_t shader_index = next_shader_index.fetch_add(1);
+      if (shader_index >= shaders.size()) {
+        return;
+      }
+      Shader& shader = *shaders[shader_index];
+      std::vector<TranslationResult>& results = shader_results[shader_index];
+      auto analysis_start = std::chrono::steady_clock::now();
+      analyses_cached[shader_index] =
+          ucode_analysis_cache.AnalyzeUcode(shader, ucode_disasm_buffer);
+      analysis_durations[shader_index] =
+          std::chrono::steady_clock::now() - analysis_start;
+      if (!translator) {
+        TranslationResult& result = results.emplace_back();
+        result.shader = &shader;
+        result.succeeded = true;
+        result.size = shader.ucode_disassembly().size();
+        result.duration = analysis_durations[shader_index];
+        continue;
+      }
+      // Each modification of the shader is translated on this thread, after
+      // the modification-independent analysis.
+      uint64_t modifications[7];
+      size_t modification_count = 0;
+      if (shader.type() == xenos::ShaderType::kVertex) {
+        for (Shader::HostVertexShaderType host_vertex_shader_type :
+             host_vertex_shader_types) {
+          modifications[modification_count++] =
+              translator->GetDefaultVertexShaderModification(
+                  xenos::kMaxShaderTempRegisters, host_vertex_shader_type);
+        }
+      } else {
+        modifications[modification_count++] =
+            translator->GetDefaultPixelShaderModification(
+                xenos::kMaxShaderTempRegisters);
+      }
+      for (size_t i = 0; i < modification_count; ++i) {
+        auto translation_start = std::chrono::steady_clock::now();
+        Shader::Translation* translation =
+            shader.GetOrCreateTranslation(modifications[i]);
+        bool succeeded = translator->TranslateAnalyzedShader(*translation);
+        auto translation_duration =
+            std::chrono::steady_clock::now() - translation_start;
+        const std::vector<uint8_t>& translated_binary =
+            translation->translated_binary();
+        TranslationResult& result = results.emplace_back();
+        result.shader = &shader;
+        result.modification = modifications[i];
+        result.succeeded = succeeded;
+        result.size = translated_binary.size();
+        result.duration = translation_duration;
+        const void* output_data = translated_binary.data();
+        size_t output_size = translated_binary.size();
+        if (succeeded && spirv_optimization_cache) {
+          const uint32_t* spirv_words =
+              reinterpret_cast<const uint32_t*>(translated_binary.data());
+          size_t spirv_word_count = translated_binary.size() / sizeof(uint32_t);
+          result.instruction_count =
+              CountSpirvInstructions(spirv_words, spirv_word_count);
+          auto optimization_start = std::chrono::steady_clock::now();
+          result.optimized = spirv_optimization_cache->GetOptimized(
+              spirv_words, spirv_word_count, optimized_spirv,
+              &result.optimization_cached);
+          result.optimization_duration =
+              std::chrono::steady_clock::now() - optimization_start;
+          if (result.optimized) {
+            result.optimized_instruction_count = CountSpirvInstructions(
+                optimized_spirv.data(), optimized_spirv.size());
+            result.optimized_size = sizeof(uint32_t) * optimized_spirv.size();
+            output_data = optimized_spirv.data();
+            output_size = result.optimized_size;
+          }
+        }
+        if (succeeded && !cvars::shader_output.empty()) {
+          FILE* output_file = filesystem::OpenFile(
+              cvars::shader_output /
+                  fmt::format("shader_{:016X}_{:016X}.{}",
+                              shader.ucode_data_hash(), modifications[i],
+                              output_extension),
+              "wb");
+          if (output_file) {
+            fwrite(output_data, 1, output_size, output_file);
+            fclose(output_file);
+          }
+        }
+        // Only the statistics are needed from now on.
+        shader.DestroyTranslation(modifications[i]);
+      }
+    }
+  };
+
+  uint32_t thread_count = cvars::shader_batch_threads;
+  if (!thread_count) {
+    thread_count = std::max(xe::threading::logical_processor_count(),
+                            uint32_t(1));
+  }
+  thread_count = uint32_t(std::min(size_t(thread_count),
+                                   std::max(shaders.size(), size_t(1))));
+  auto batch_start = std::chrono::steady_clock::now();
+  std::vector<std::unique_ptr<xe::threading::Thread>> translation_threads;
+  for (uint32_t i = 0; i < thread_count; ++i) {
+    auto thread =
+        xe::threading::Thread::Create({}, translation_thread_function);
+    assert_not_null(thread);
+    thread->set_name("Shader Translation");
+    translation_threads.push_back(std::move(thread));
+  }
+  for (auto& translation_thread : translation_threads) {
+    xe::threading::Wait(translation_thread.get(), false);
+  }
+  double batch_seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - batch_start)
+                             .count();
+
+  size_t translation_count = 0;
+  size_t translations_failed = 0;
+  uint64_t total_size = 0;
+  double total_translation_seconds = 0.0;
+  size_t optimization_count = 0;
+  size_t optimizations_failed = 0;
+  size_t optimizations_cached = 0;
+  uint64_t total_instruction_count = 0;
+  uint64_t total_optimized_instruction_count = 0;
+  uint64_t total_optimized_size = 0;
+  double total_optimization_seconds = 0.0;
+  for (const std::vector<TranslationResult>& results : shader_results) {
+    for (const TranslationResult& result : results) {
+      double milliseconds =
+          std::chrono::duration<double, std::milli>(result.duration).count();
+      XELOGI("{:016X} {} {:016X}: {}, {:.3f} ms, {} bytes",
+             result.shader->ucode_data_hash(),
+             result.shader->type() == xenos::ShaderType::kVertex ? "vs" : "ps",
+             result.modification, result.succeeded ? "translated" : "FAILED",
+             milliseconds, result.size);
+      ++translation_count;
+      if (!result.succeeded) {
+        ++translations_failed;
+      }
+      total_size += result.size;
+      total_translation_seconds += milliseconds * 0.001;
+      if (!spirv_optimization_cache || !result.succeeded) {
+        continue;
+      }
+      double optimization_milliseconds =
+          std::chrono::duration<double, std::milli>(
+              result.optimization_duration)
+              .count();
+      ++optimization_count;
+      total_optimization_seconds += optimization_milliseconds * 0.001;
+      if (result.optimization_cached) {
+        ++optimizations_cached;
+      }
+      if (!result.optimized) {
+        ++optimizations_failed;
+        XELOGI("  optimization FAILED, {:.3f} ms", optimization_milliseconds);
+        continue;
+      }
+      XELOGI("  optimized{}: {} -> {} instructions, {:.3f} ms, {} bytes",
+             result.optimization_cached ? " (cached)" : "",
+             result.instruction_count, result.optimized_instruction_count,
+             optimization_milliseconds, result.optimized_size);
+      total_instruction_count += result.instruction_count;
+      total_optimized_instruction_count += result.optimized_instruction_count;
+      total_optimized_size += result.optimized_size;
+    }
+  }
+  XELOGI(
+      "{} {} ({} failed) of {} shaders on {} threads in {:.3f} s, {:.1f} per "
+      "second, {:.3f} ms per shader on a thread, {} bytes of output",
+      translation_count, output_extension ? "translations" : "analyses",
+      translations_failed, shaders.size(), thread_count, batch_seconds,
+      batch_seconds > 0.0 ? double(translation_count) / batch_seconds : 0.0,
+      translation_count
+          ? total_translation_seconds * 1000.0 / double(translation_count)
+          : 0.0,
+      total_size);
+  if (ucode_analysis_cache.is_open()) {
+    double total_analysis_seconds = 0.0;
+    for (std::chrono::steady_clock::duration analysis_duration :
+         analysis_durations) {
+      total_analysis_seconds +=
+          std::chrono::duration<double>(analysis_duration).count();
+    }
+    XELOGI(
+        "{} ucode analyses ({} from the cache) in {:.3f} s on threads, {:.3f} "
+        "ms per shader on a thread",
+        shaders.size(),
+        std::count(analyses_cached.cbegin(), analyses_cached.cend(), 1),
+        total_analysis_seconds,
+        shaders.empty()
+            ? 0.0
+            : total_analysis_seconds * 1000.0 / double(shaders.size()));
+  }
+  if (spirv_optimization_cache) {
+    // Instruction counts only of the successfully optimized translations.
+    XELOGI(
+        "{} optimizations ({} failed, {} cached) in {:.3f} s on threads, "
+        "{:.3f} ms per shader on a thread, {} -> {} instructions ({:.1f}%), {} "
+        "bytes of optimized output",
+        optimization_count, optimizations_failed, optimizations_cached,
+        total_optimization_seconds,
+        optimization_count
+            ? total_optimization_seconds * 1000.0 / double(optimization_count)
+            : 0.0,
+        total_instruction_count, total_optimized_instruction_count,
+        total_instruction_count
+            ? double(total_optimized_instruction_count) * 100.0 /
+                  double(total_instruction_count)
+            : 100.0,
+        total_optimized_size);
+  }
+  return translations_failed ? 1 : 0;
+}
+
 int shader_compiler_main(const std::vector<std::string>& args) {
+  if (std::filesystem::is_directory(cvars::shader_input) ||
+      cvars::shader_input.extension() == ".xsh") {
+    return shader_compiler_batch_main();
+  }
+
   xenos::ShaderType shader_type;
   if (!cvars::shader_input_type.empty()) {
     if (cvars::shader_input_type == "vs") {
@@ -120,20 +661,10 @@ int shader_compiler_main(const std::vector<std::string>& args) {
   StringBuffer ucode_disasm_buffer;
   shader->AnalyzeUcode(ucode_disasm_buffer);
 
-  std::unique_ptr<ShaderTranslator> translator;
   SpirvShaderTranslator::Features spirv_features(true);
-  if (cvars::shader_output_type == "spirv" ||
-      cvars::shader_output_type == "spirvtext") {
-    translator = std::make_unique<SpirvShaderTranslator>(
-        spirv_features, true, true,
-        cvars::shader_output_pixel_shader_interlock);
-  } else if (cvars::shader_output_type == "dxbc" ||
-             cvars::shader_output_type == "dxbctext") {
-    translator = std::make_unique<DxbcShaderTranslator>(
-        ui::GraphicsProvider::GpuVendorID(0),
-        cvars::shader_output_bindless_resources,
-        cvars::shader_output_pixel_shader_interlock);
-  } else {
+  std::unique_ptr<ShaderTranslator> translator =
+      CreateTranslator(spirv_features);
+  if (!translator) {
     // Just output microcode disassembly generated during microcode information
     // gathering.
     if (!cvars::shader_output.empty()) {
@@ -148,25 +679,8 @@ int shader_compiler_main(const std::vector<std::string>& args) {
   Shader::HostVertexShaderType host_vertex_shader_type =
       Shader::HostVertexShaderType::kVertex;
   if (shader_type == xenos::ShaderType::kVertex) {
-    if (cvars::vertex_shader_output_type == "linedomaincp") {
-      host_vertex_shader_type =
-          Shader::HostVertexShaderType::kLineDomainCPIndexed;
-    } else if (cvars::vertex_shader_output_type == "linedomainpatch") {
-      host_vertex_shader_type =
-          Shader::HostVertexShaderType::kLineDomainPatchIndexed;
-    } else if (cvars::vertex_shader_output_type == "triangledomaincp") {
-      host_vertex_shader_type =
-          Shader::HostVertexShaderType::kTriangleDomainCPIndexed;
-    } else if (cvars::vertex_shader_output_type == "triangledomainpatch") {
-      host_vertex_shader_type =
-          Shader::HostVertexShaderType::kTriangleDomainPatchIndexed;
-    } else if (cvars::vertex_shader_output_type == "quaddomaincp") {
-      host_vertex_shader_type =
-          Shader::HostVertexShaderType::kQuadDomainCPIndexed;
-    } else if (cvars::vertex_shader_output_type == "quaddomainpatch") {
-      host_vertex_shader_type =
-          Shader::HostVertexShaderType::kQuadDomainPatchIndexed;
-    }
+    host_vertex_shader_type =
+        GetHostVertexShaderType(cvars::vertex_shader_output_type);
   }
   uint64_t modification;
   switch (shader_type) {
@@ -190,6 +704,33 @@ int shader_compiler_main(const std::vector<std::string>& args) {
   const void* source_data = translation->translated_binary().data();
   size_t source_data_size = translation->translated_binary().size();
 
+  ui::vulkan::SpirvToolsContext spirv_tools_context;
+  bool spirv_tools_initialized = false;
+  if (cvars::shader_output_type == "spirv" ||
+      cvars::shader_output_type == "spirvtext") {
+    spirv_tools_initialized =
+        spirv_tools_context.Initialize(spirv_features.spirv_version);
+  }
+
+  std::vector<uint32_t> optimized_spirv;
+  if (cvars::shader_output_spirv_optimize && spirv_tools_initialized) {
+    const uint32_t* spirv_words =
+        reinterpret_cast<const uint32_t*>(source_data);
+    size_t spirv_word_count = source_data_size / sizeof(uint32_t);
+    if (spirv_tools_context.IsOptimizerAvailable() &&
+        spirv_tools_context.Optimize(spirv_words, spirv_word_count,
+                                     optimized_spirv) == SPV_SUCCESS) {
+      XELOGI("Optimized SPIR-V from {} to {} instructions.",
+             CountSpirvInstructions(spirv_words, spirv_word_count),
+             CountSpirvInstructions(optimized_spirv.data(),
+                                    optimized_spirv.size()));
+      source_data = optimized_spirv.data();
+      source_data_size = sizeof(uint32_t) * optimized_spirv.size();
+    } else {
+      XELOGE("Failed to optimize the SPIR-V, writing the unoptimized version.");
+    }
+  }
+
   std::string spirv_disasm;
   if (cvars::shader_output_type == "spirvtext") {
     std::ostringstream spirv_disasm_stream;
@@ -201,8 +742,7 @@ int shader_compiler_main(const std::vector<std::string>& args) {
                             source_data_size / sizeof(unsigned int));
     spv::Disassemble(spirv_disasm_stream, spirv_source);
     spirv_disasm = std::move(spirv_disasm_stream.str());
-    ui::vulkan::SpirvToolsContext spirv_tools_context;
-    if (spirv_tools_context.Initialize(spirv_features.spirv_version)) {
+    if (spirv_tools_initialized) {
       std::string spirv_validation_error;
       spirv_tools_context.Validate(
           reinterpret_cast<const uint32_t*>(spirv_source.data()),
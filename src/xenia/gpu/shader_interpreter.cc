@@ -9,35 +9,313 @@
 
 #include "xenia/gpu/shader_interpreter.h"
 
+#include <algorithm>
 #include <cfloat>
 #include <cmath>
 #include <cstring>
+#include <iterator>
+
+#include "xenia/base/math.h"
+#include "xenia/base/memory.h"
+#include "xenia/base/platform.h"
+
+#if XE_ARCH_AMD64
+#include <immintrin.h>
+#endif  // XE_ARCH_AMD64
 
 namespace xe {
 namespace gpu {
 
+namespace {
+
+// Vector of ShaderInterpreter::kBatchSize floats, one per lane. AVX on x86-64,
+// which is the minimum requirement of Xenia. Elsewhere, loops over the lanes,
+// vectorized by the compiler where possible.
+#if XE_ARCH_AMD64
+static_assert(ShaderInterpreter::kBatchSize == 8,
+              "Batch lanes must match the width of AVX vectors");
+
+using BatchVector = __m256;
+
+BatchVector BatchLoad(const float* source) { return _mm256_loadu_ps(source); }
+void BatchStore(float* dest, BatchVector value) {
+  _mm256_storeu_ps(dest, value);
+}
+BatchVector BatchSplat(float value) { return _mm256_set1_ps(value); }
+BatchVector BatchAdd(BatchVector a, BatchVector b) {
+  return _mm256_add_ps(a, b);
+}
+BatchVector BatchSub(BatchVector a, BatchVector b) {
+  return _mm256_sub_ps(a, b);
+}
+BatchVector BatchMul(BatchVector a, BatchVector b) {
+  return _mm256_mul_ps(a, b);
+}
+BatchVector BatchDiv(BatchVector a, BatchVector b) {
+  return _mm256_div_ps(a, b);
+}
+BatchVector BatchSqrt(BatchVector a) { return _mm256_sqrt_ps(a); }
+BatchVector BatchFloor(BatchVector a) {
+  return _mm256_round_ps(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+}
+BatchVector BatchTrunc(BatchVector a) {
+  return _mm256_round_ps(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+}
+BatchVector BatchAnd(BatchVector a, BatchVector b) {
+  return _mm256_and_ps(a, b);
+}
+// ~a & b.
+BatchVector BatchAndNot(BatchVector a, BatchVector b) {
+  return _mm256_andnot_ps(a, b);
+}
+BatchVector BatchOr(BatchVector a, BatchVector b) { return _mm256_or_ps(a, b); }
+BatchVector BatchXor(BatchVector a, BatchVector b) {
+  return _mm256_xor_ps(a, b);
+}
+// Comparisons return all bits set in the lanes where they're true, and have
+// the same behavior with NaN as the C++ operators and comparison functions.
+// ==
+BatchVector BatchEqual(BatchVector a, BatchVector b) {
+  return _mm256_cmp_ps(a, b, _CMP_EQ_OQ);
+}
+// !=
+BatchVector BatchNotEqual(BatchVector a, BatchVector b) {
+  return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ);
+}
+// std::isgreater
+BatchVector BatchGreater(BatchVector a, BatchVector b) {
+  return _mm256_cmp_ps(a, b, _CMP_GT_OQ);
+}
+// std::isgreaterequal
+BatchVector BatchGreaterEqual(BatchVector a, BatchVector b) {
+  return _mm256_cmp_ps(a, b, _CMP_GE_OQ);
+}
+// std::isless
+BatchVector BatchLess(BatchVector a, BatchVector b) {
+  return _mm256_cmp_ps(a, b, _CMP_LT_OQ);
+}
+BatchVector BatchSelect(BatchVector mask, BatchVector if_true,
+                        BatchVector if_false) {
+  return _mm256_blendv_ps(if_false, if_true, mask);
+}
+uint32_t BatchGetMaskBits(BatchVector mask) {
+  return uint32_t(_mm256_movemask_ps(mask));
+}
+BatchVector BatchMaskFromBits(uint32_t bits) {
+  return _mm256_castsi256_ps(_mm256_setr_epi32(
+      -int32_t(bits & 1), -int32_t((bits >> 1) & 1), -int32_t((bits >> 2) & 1),
+      -int32_t((bits >> 3) & 1), -int32_t((bits >> 4) & 1),
+      -int32_t((bits >> 5) & 1), -int32_t((bits >> 6) & 1),
+      -int32_t((bits >> 7) & 1)));
+}
+#else
+struct BatchVector {
+  float lanes[ShaderInterpreter::kBatchSize];
+};
+
+template <typename Function>
+BatchVector BatchMap(BatchVector a, Function function) {
+  BatchVector result;
+  for (uint32_t i = 0; i < ShaderInterpreter::kBatchSize; ++i) {
+    result.lanes[i] = function(a.lanes[i]);
+  }
+  return result;
+}
+template <typename Function>
+BatchVector BatchMap(BatchVector a, BatchVector b, Function function) {
+  BatchVector result;
+  for (uint32_t i = 0; i < ShaderInterpreter::kBatchSize; ++i) {
+    result.lanes[i] = function(a.lanes[i], b.lanes[i]);
+  }
+  return result;
+}
+template <typename Function>
+BatchVector BatchMapBits(BatchVector a, BatchVector b, Function function) {
+  return BatchMap(a, b, [function](float a_lane, float b_lane) {
+    return xe::memory::Reinterpret<float>(
+        uint32_t(function(xe::memory::Reinterpret<uint32_t>(a_lane),
+                          xe::memory::Reinterpret<uint32_t>(b_lane))));
+  });
+}
+template <typename Function>
+BatchVector BatchCompare(BatchVector a, BatchVector b, Function function) {
+  return BatchMap(a, b, [function](float a_lane, float b_lane) {
+    return xe::memory::Reinterpret<float>(function(a_lane, b_lane)
+                                              ? ~UINT32_C(0)
+                                              : UINT32_C(0));
+  });
+}
+
+BatchVector BatchLoad(const float* source) {
+  BatchVector result;
+  std::memcpy(result.lanes, source, sizeof(result.lanes));
+  return result;
+}
+void BatchStore(float* dest, BatchVector value) {
+  std::memcpy(dest, value.lanes, sizeof(value.lanes));
+}
+BatchVector BatchSplat(float value) {
+  BatchVector result;
+  std::fill(std::begin(result.lanes), std::end(result.lanes), value);
+  return result;
+}
+BatchVector BatchAdd(BatchVector a, BatchVector b) {
+  return BatchMap(a, b, [](float a_lane, float b_lane) {
+    return a_lane + b_lane;
+  });
+}
+BatchVector BatchSub(BatchVector a, BatchVector b) {
+  return BatchMap(a, b, [](float a_lane, float b_lane) {
+    return a_lane - b_lane;
+  });
+}
+BatchVector BatchMul(BatchVector a, BatchVector b) {
+  return BatchMap(a, b, [](float a_lane, float b_lane) {
+    return a_lane * b_lane;
+  });
+}
+BatchVector BatchDiv(BatchVector a, BatchVector b) {
+  return BatchMap(a, b, [](float a_lane, float b_lane) {
+    return a_lane / b_lane;
+  });
+}
+BatchVector BatchSqrt(BatchVector a) {
+  return BatchMap(a, [](float a_lane) { return std::sqrt(a_lane); });
+}
+BatchVector BatchFloor(BatchVector a) {
+  return BatchMap(a, [](float a_lane) { return std::floor(a_lane); });
+}
+BatchVector BatchTrunc(BatchVector a) {
+  return BatchMap(a, [](float a_lane) { return std::trunc(a_lane); });
+}
+BatchVector BatchAnd(BatchVector a, BatchVector b) {
+  return BatchMapBits(
+      a, b, [](uint32_t a_lane, uint32_t b_lane) { return a_lane & b_lane; });
+}
+// ~a & b.
+BatchVector BatchAndNot(BatchVector a, BatchVector b) {
+  return BatchMapBits(
+      a, b, [](uint32_t a_lane, uint32_t b_lane) { return ~a_lane & b_lane; });
+}
+BatchVector BatchOr(BatchVector a, BatchVector b) {
+  return BatchMapBits(
+      a, b, [](uint32_t a_lane, uint32_t b_lane) { return a_lane | b_lane; });
+}
+BatchVector BatchXor(BatchVector a, BatchVector b) {
+  return BatchMapBits(
+      a, b, [](uint32_t a_lane, uint32_t b_lane) { return a_lane ^ b_lane; });
+}
+// Comparisons return all bits set in the lanes where they're true, and have
+// the same behavior with NaN as the C++ operators and comparison functions.
+BatchVector BatchEqual(BatchVector a, BatchVector b) {
+  return BatchCompare(
+      a, b, [](float a_lane, float b_lane) { return a_lane == b_lane; });
+}
+BatchVector BatchNotEqual(BatchVector a, BatchVector b) {
+  return BatchCompare(
+      a, b, [](float a_lane, float b_lane) { return a_lane != b_lane; });
+}
+BatchVector BatchGreater(BatchVector a, BatchVector b) {
+  return BatchCompare(a, b, [](float a_lane, float b_lane) {
+    return std::isgreater(a_lane, b_lane);
+  });
+}
+BatchVector BatchGreaterEqual(BatchVector a, BatchVector b) {
+  return BatchCompare(a, b, [](float a_lane, float b_lane) {
+    return std::isgreaterequal(a_lane, b_lane);
+  });
+}
+BatchVector BatchLess(BatchVector a, BatchVector b) {
+  return BatchCompare(a, b, [](float a_lane, float b_lane) {
+    return std::isless(a_lane, b_lane);
+  });
+}
+BatchVector BatchSelect(BatchVector mask, BatchVector if_true,
+                        BatchVector if_false) {
+  return BatchOr(BatchAnd(mask, if_true), BatchAndNot(mask, if_false));
+}
+uint32_t BatchGetMaskBits(BatchVector mask) {
+  uint32_t bits = 0;
+  for (uint32_t i = 0; i < ShaderInterpreter::kBatchSize; ++i) {
+    bits |= (xe::memory::Reinterpret<uint32_t>(mask.lanes[i]) >> 31) << i;
+  }
+  return bits;
+}
+BatchVector BatchMaskFromBits(uint32_t bits) {
+  BatchVector result;
+  for (uint32_t i = 0; i < ShaderInterpreter::kBatchSize; ++i) {
+    result.lanes[i] = xe::memory::Reinterpret<float>(
+        ((bits >> i) & 1) ? ~UINT32_C(0) : UINT32_C(0));
+  }
+  return result;
+}
+#endif  // XE_ARCH_AMD64
+
+BatchVector BatchSplatBits(uint32_t value) {
+  return BatchSplat(xe::memory::Reinterpret<float>(value));
+}
+
+// Same as ShaderInterpreter::FlushDenormal.
+BatchVector BatchFlushDenormal(BatchVector value) {
+  BatchVector sign = BatchSplatBits(UINT32_C(1) << 31);
+  return BatchSelect(
+      BatchLess(BatchAndNot(sign, value), BatchSplat(FLT_MIN)),
+      BatchAnd(value, sign), value);
+}
+
+// Direct3D 9 behavior (0 or denormal * anything = +0).
+BatchVector BatchMulD3D9(BatchVector a, BatchVector b) {
+  BatchVector zero = BatchSplat(0.0f);
+  return BatchAnd(
+      BatchAnd(BatchNotEqual(a, zero), BatchNotEqual(b, zero)),
+      BatchMul(a, b));
+}
+
+// Same as xe::saturate.
+BatchVector BatchSaturate(BatchVector value) {
+  BatchVector zero = BatchSplat(0.0f), one = BatchSplat(1.0f);
+  BatchVector clamped_to_min =
+      BatchSelect(BatchGreater(value, zero), value, zero);
+  return BatchSelect(BatchLess(clamped_to_min, one), clamped_to_min, one);
+}
+
+// Replaces the infinities in the lanes with the specified values.
+BatchVector BatchReplaceInfinity(BatchVector value, float negative_replacement,
+                                 float positive_replacement) {
+  value = BatchSelect(BatchEqual(value, BatchSplat(-INFINITY)),
+                      BatchSplat(negative_replacement), value);
+  return BatchSelect(BatchEqual(value, BatchSplat(INFINITY)),
+                     BatchSplat(positive_replacement), value);
+}
+
+}  // namespace
+
+
+ucode::ControlFlowInstruction ShaderInterpreter::GetControlFlowInstruction(
+    uint32_t cf_index) const {
+  const uint32_t* cf_pair = &ucode_[3 * (cf_index >> 1)];
+  ucode::ControlFlowInstruction cf_instr;
+  if (cf_index & 1) {
+    cf_instr.dword_0 = (cf_pair[1] >> 16) | (cf_pair[2] << 16);
+    cf_instr.dword_1 = cf_pair[2] >> 16;
+  } else {
+    cf_instr.dword_0 = cf_pair[0];
+    cf_instr.dword_1 = cf_pair[1] & 0xFFFF;
+  }
+  return cf_instr;
+}
+
 void ShaderInterpreter::Execute() {
   // For more consistency between invocations in case of a malformed shader.
   state_.Reset();
 
-  const uint32_t* bool_constants =
-      &register_file_[XE_GPU_REG_SHADER_CONSTANT_BOOL_000_031];
-
   bool exec_ended = false;
   uint32_t cf_index_next = 1;
   for (uint32_t cf_index = 0; !exec_ended; cf_index = cf_index_next) {
     cf_index_next = cf_index + 1;
 
-    const uint32_t* cf_pair = &ucode_[3 * (cf_index >> 1)];
-    ucode::ControlFlowInstruction cf_instr;
-    if (cf_index & 1) {
-      cf_instr.dword_0 = (cf_pair[1] >> 16) | (cf_pair[2] << 16);
-      cf_instr.dword_1 = cf_pair[2] >> 16;
-    } else {
-      cf_instr.dword_0 = cf_pair[0];
-      cf_instr.dword_1 = cf_pair[1] & 0xFFFF;
-    }
-
+    ucode::ControlFlowInstruction cf_instr =
+        GetControlFlowInstruction(cf_index);
     ucode::ControlFlowOpcode cf_opcode = cf_instr.opcode();
     switch (cf_opcode) {
       case ucode::ControlFlowOpcode::kNop: {
@@ -63,10 +341,8 @@ void ShaderInterpreter::Execute() {
             const ucode::ControlFlowCondExecInstruction cf_cond_exec =
                 *reinterpret_cast<const ucode::ControlFlowCondExecInstruction*>(
                     &cf_exec);
-            uint32_t bool_address = cf_cond_exec.bool_address();
             if (cf_cond_exec.condition() !=
-                ((bool_constants[bool_address >> 5] &
-                  (UINT32_C(1) << (bool_address & 31))) != 0)) {
+                GetBoolConstant(cf_cond_exec.bool_address())) {
               continue;
             }
           } break;
@@ -100,9 +376,9 @@ void ShaderInterpreter::Execute() {
             } else {
               // Not supporting texture fetching (very complex).
               float zero_result[4] = {};
-              StoreFetchResult(fetch_instr.dest(),
-                               fetch_instr.is_dest_relative(),
-                               fetch_instr.dest_swizzle(), zero_result);
+              StoreFetchResult(GetTempRegister(fetch_instr.dest(),
+                                               fetch_instr.is_dest_relative()),
+                               1, fetch_instr.dest_swizzle(), zero_result);
             }
           } else {
             const ucode::AluInstruction& alu_instr =
@@ -121,115 +397,12 @@ void ShaderInterpreter::Execute() {
         }
       } break;
 
-      case ucode::ControlFlowOpcode::kLoopStart: {
-        ucode::ControlFlowLoopStartInstruction cf_loop_start =
-            *reinterpret_cast<const ucode::ControlFlowLoopStartInstruction*>(
-                &cf_instr);
-        assert_true(state_.loop_stack_depth < 4);
-        if (++state_.loop_stack_depth > 4) {
-          cf_index_next = cf_loop_start.address();
-          continue;
-        }
-        auto loop_constant = register_file_.Get<xenos::LoopConstant>(
-            XE_GPU_REG_SHADER_CONSTANT_LOOP_00 + cf_loop_start.loop_id());
-        state_.loop_constants[state_.loop_stack_depth] = loop_constant;
-        uint32_t& loop_iterator_ref =
-            state_.loop_iterators[state_.loop_stack_depth];
-        if (!cf_loop_start.is_repeat()) {
-          loop_iterator_ref = 0;
-        }
-        if (loop_iterator_ref >= loop_constant.count) {
-          cf_index_next = cf_loop_start.address();
-          continue;
-        }
-        ++state_.loop_stack_depth;
-      } break;
-
-      case ucode::ControlFlowOpcode::kLoopEnd: {
-        assert_not_zero(state_.loop_stack_depth);
-        if (!state_.loop_stack_depth) {
-          continue;
-        }
-        assert_true(state_.loop_stack_depth <= 4);
-        if (state_.loop_stack_depth > 4) {
-          --state_.loop_stack_depth;
-          continue;
-        }
-        ucode::ControlFlowLoopEndInstruction cf_loop_end =
-            *reinterpret_cast<const ucode::ControlFlowLoopEndInstruction*>(
-                &cf_instr);
-        xenos::LoopConstant loop_constant =
-            state_.loop_constants[state_.loop_stack_depth - 1];
-        assert_zero(
-            std::memcmp(&loop_constant,
-                        &register_file_[XE_GPU_REG_SHADER_CONSTANT_LOOP_00 +
-                                        cf_loop_end.loop_id()],
-                        sizeof(loop_constant)));
-        uint32_t loop_iterator =
-            ++state_.loop_iterators[state_.loop_stack_depth - 1];
-        if (loop_iterator < loop_constant.count &&
-            (!cf_loop_end.is_predicated_break() ||
-             cf_loop_end.condition() != state_.predicate)) {
-          cf_index_next = cf_loop_end.address();
-          continue;
-        }
-        --state_.loop_stack_depth;
-      } break;
-
-      case ucode::ControlFlowOpcode::kCondCall: {
-        assert_true(state_.call_stack_depth < 4);
-        if (state_.call_stack_depth >= 4) {
-          continue;
-        }
-        const ucode::ControlFlowCondCallInstruction cf_cond_call =
-            *reinterpret_cast<const ucode::ControlFlowCondCallInstruction*>(
-                &cf_instr);
-        if (!cf_cond_call.is_unconditional()) {
-          if (cf_cond_call.is_predicated()) {
-            if (cf_cond_call.condition() != state_.predicate) {
-              continue;
-            }
-          } else {
-            uint32_t bool_address = cf_cond_call.bool_address();
-            if (cf_cond_call.condition() !=
-                ((bool_constants[bool_address >> 5] &
-                  (UINT32_C(1) << (bool_address & 31))) != 0)) {
-              continue;
-            }
-          }
-        }
-        state_.call_return_addresses[state_.call_stack_depth++] = cf_index + 1;
-        cf_index_next = cf_cond_call.address();
-      } break;
-
-      case ucode::ControlFlowOpcode::kReturn: {
-        // No stack depth assertion - skipping the return is a well-defined
-        // behavior for `return` outside a function call.
-        if (!state_.call_stack_depth) {
-          continue;
-        }
-        cf_index_next = state_.call_return_addresses[--state_.call_stack_depth];
-      } break;
-
+      case ucode::ControlFlowOpcode::kLoopStart:
+      case ucode::ControlFlowOpcode::kLoopEnd:
+      case ucode::ControlFlowOpcode::kCondCall:
+      case ucode::ControlFlowOpcode::kReturn:
       case ucode::ControlFlowOpcode::kCondJmp: {
-        const ucode::ControlFlowCondJmpInstruction cf_cond_jmp =
-            *reinterpret_cast<const ucode::ControlFlowCondJmpInstruction*>(
-                &cf_instr);
-        if (!cf_cond_jmp.is_unconditional()) {
-          if (cf_cond_jmp.is_predicated()) {
-            if (cf_cond_jmp.condition() != state_.predicate) {
-              continue;
-            }
-          } else {
-            uint32_t bool_address = cf_cond_jmp.bool_address();
-            if (cf_cond_jmp.condition() !=
-                ((bool_constants[bool_address >> 5] &
-                  (UINT32_C(1) << (bool_address & 31))) != 0)) {
-              continue;
-            }
-          }
-        }
-        cf_index_next = cf_cond_jmp.address();
+        cf_index_next = ExecuteControlFlowBranch(state_, cf_instr, cf_index);
       } break;
 
       case ucode::ControlFlowOpcode::kAlloc: {
@@ -250,12 +423,124 @@ void ShaderInterpreter::Execute() {
   }
 }
 
+uint32_t ShaderInterpreter::ExecuteControlFlowBranch(
+    State& state, ucode::ControlFlowInstruction cf_instr,
+    uint32_t cf_index) const {
+  ucode::ControlFlowOpcode cf_opcode = cf_instr.opcode();
+  switch (cf_opcode) {
+    case ucode::ControlFlowOpcode::kLoopStart: {
+      ucode::ControlFlowLoopStartInstruction cf_loop_start =
+          *reinterpret_cast<const ucode::ControlFlowLoopStartInstruction*>(
+              &cf_instr);
+      assert_true(state.loop_stack_depth < 4);
+      if (++state.loop_stack_depth > 4) {
+        return cf_loop_start.address();
+      }
+      auto loop_constant = register_file_.Get<xenos::LoopConstant>(
+          XE_GPU_REG_SHADER_CONSTANT_LOOP_00 + cf_loop_start.loop_id());
+      state.loop_constants[state.loop_stack_depth] = loop_constant;
+      uint32_t& loop_iterator_ref =
+          state.loop_iterators[state.loop_stack_depth];
+      if (!cf_loop_start.is_repeat()) {
+        loop_iterator_ref = 0;
+      }
+      if (loop_iterator_ref >= loop_constant.count) {
+        return cf_loop_start.address();
+      }
+      ++state.loop_stack_depth;
+    } break;
+
+    case ucode::ControlFlowOpcode::kLoopEnd: {
+      assert_not_zero(state.loop_stack_depth);
+      if (!state.loop_stack_depth) {
+        return cf_index + 1;
+      }
+      assert_true(state.loop_stack_depth <= 4);
+      if (state.loop_stack_depth > 4) {
+        --state.loop_stack_depth;
+        return cf_index + 1;
+      }
+      ucode::ControlFlowLoopEndInstruction cf_loop_end =
+          *reinterpret_cast<const ucode::ControlFlowLoopEndInstruction*>(
+              &cf_instr);
+      xenos::LoopConstant loop_constant =
+          state.loop_constants[state.loop_stack_depth - 1];
+      assert_zero(
+          std::memcmp(&loop_constant,
+                      &register_file_[XE_GPU_REG_SHADER_CONSTANT_LOOP_00 +
+                                      cf_loop_end.loop_id()],
+                      sizeof(loop_constant)));
+      uint32_t loop_iterator =
+          ++state.loop_iterators[state.loop_stack_depth - 1];
+      if (loop_iterator < loop_constant.count &&
+          (!cf_loop_end.is_predicated_break() ||
+           cf_loop_end.condition() != state.predicate)) {
+        return cf_loop_end.address();
+      }
+      --state.loop_stack_depth;
+    } break;
+
+    case ucode::ControlFlowOpcode::kCondCall: {
+      assert_true(state.call_stack_depth < 4);
+      if (state.call_stack_depth >= 4) {
+        return cf_index + 1;
+      }
+      const ucode::ControlFlowCondCallInstruction cf_cond_call =
+          *reinterpret_cast<const ucode::ControlFlowCondCallInstruction*>(
+              &cf_instr);
+      if (!cf_cond_call.is_unconditional()) {
+        if (cf_cond_call.is_predicated()) {
+          if (cf_cond_call.condition() != state.predicate) {
+            return cf_index + 1;
+          }
+        } else if (cf_cond_call.condition() !=
+                   GetBoolConstant(cf_cond_call.bool_address())) {
+          return cf_index + 1;
+        }
+      }
+      state.call_return_addresses[state.call_stack_depth++] = cf_index + 1;
+      return cf_cond_call.address();
+    }
+
+    case ucode::ControlFlowOpcode::kReturn: {
+      // No stack depth assertion - skipping the return is a well-defined
+      // behavior for `return` outside a function call.
+      if (!state.call_stack_depth) {
+        return cf_index + 1;
+      }
+      return state.call_return_addresses[--state.call_stack_depth];
+    }
+
+    case ucode::ControlFlowOpcode::kCondJmp: {
+      const ucode::ControlFlowCondJmpInstruction cf_cond_jmp =
+          *reinterpret_cast<const ucode::ControlFlowCondJmpInstruction*>(
+              &cf_instr);
+      if (!cf_cond_jmp.is_unconditional()) {
+        if (cf_cond_jmp.is_predicated()) {
+          if (cf_cond_jmp.condition() != state.predicate) {
+            return cf_index + 1;
+          }
+        } else if (cf_cond_jmp.condition() !=
+                   GetBoolConstant(cf_cond_jmp.bool_address())) {
+          return cf_index + 1;
+        }
+      }
+      return cf_cond_jmp.address();
+    }
+
+    default:
+      assert_unhandled_case(cf_opcode);
+  }
+  return cf_index + 1;
+}
+
 const std::array<float, 4> ShaderInterpreter::GetFloatConstant(
-    uint32_t address, bool is_relative, bool relative_address_is_a0) const {
+    const State& state, uint32_t address, bool is_relative,
+    bool relative_address_is_a0) const {
   int32_t index = int32_t(address);
   if (is_relative) {
-    index += relative_address_is_a0 ? state_.address_register
-                                    : state_.GetLoopAddress();
+    index += relative_address_is_a0 ? state.address_register
+                                    : state.GetLoopAddress();
   }
   if (index < 0) {
     return std::array<float, 4>();
@@ -277,6 +562,51 @@ const std::array<float, 4> ShaderInterpreter::GetFloatConstant(
   return value;
 }
 
+void ShaderInterpreter::CalculateCube(const float* operand, float* result) {
+  // Operand [0] is .z_xy.
+  float x = operand[2];
+  float y = operand[3];
+  float z = operand[0];
+  float x_abs = std::abs(x), y_abs = std::abs(y), z_abs = std::abs(z);
+  // Result is T coordinate, S coordinate, 2 * major axis, face ID.
+  if (z_abs >= x_abs && z_abs >= y_abs) {
+    bool z_negative = std::isless(z, 0.0f);
+    result[0] = -y;
+    result[1] = z_negative ? -x : x;
+    result[2] = z;
+    result[3] = z_negative ? 5.0f : 4.0f;
+  } else if (y_abs >= x_abs) {
+    bool y_negative = std::isless(y, 0.0f);
+    result[0] = y_negative ? -z : z;
+    result[1] = x;
+    result[2] = y;
+    result[3] = y_negative ? 3.0f : 2.0f;
+  } else {
+    bool x_negative = std::isless(x, 0.0f);
+    result[0] = -y;
+    result[1] = x_negative ? z : -z;
+    result[2] = x;
+    result[3] = x_negative ? 1.0f : 0.0f;
+  }
+  result[2] *= 2.0f;
+}
+
+float ShaderInterpreter::CalculateMax4(const float* operand) {
+  if (std::isgreaterequal(operand[0], operand[1]) &&
+      std::isgreaterequal(operand[0], operand[2]) &&
+      std::isgreaterequal(operand[0], operand[3])) {
+    return operand[0];
+  }
+  if (std::isgreaterequal(operand[1], operand[2]) &&
+      std::isgreaterequal(operand[1], operand[3])) {
+    return operand[1];
+  }
+  if (std::isgreaterequal(operand[2], operand[3])) {
+    return operand[2];
+  }
+  return operand[3];
+}
+
 void ShaderInterpreter::ExecuteAluInstruction(ucode::AluInstruction instr) {
   // Vector operation.
   float vector_result[4] = {};
@@ -302,7 +632,7 @@ void ShaderInterpreter::ExecuteAluInstruction(ucode::AluInstruction instr) {
             vector_src_register);
       } else {
         vector_src_float_constant = GetFloatConstant(
-            vector_src_register, instr.src_const_is_addressed(1 + i),
+            state_, vector_src_register, instr.src_const_is_addressed(1 + i),
             instr.is_const_address_register_relative());
         vector_src_ptr = vector_src_float_constant.data();
       }
@@ -466,49 +796,10 @@ void ShaderInterpreter::ExecuteAluInstruction(ucode::AluInstruction instr) {
         replicate_vector_result_x = true;
       } break;
       case ucode::AluVectorOpcode::kCube: {
-        // Operand [0] is .z_xy.
-        float x = vector_operands[0][2];
-        float y = vector_operands[0][3];
-        float z = vector_operands[0][0];
-        float x_abs = std::abs(x), y_abs = std::abs(y), z_abs = std::abs(z);
-        // Result is T coordinate, S coordinate, 2 * major axis, face ID.
-        if (z_abs >= x_abs && z_abs >= y_abs) {
-          bool z_negative = std::isless(z, 0.0f);
-          vector_result[0] = -y;
-          vector_result[1] = z_negative ? -x : x;
-          vector_result[2] = z;
-          vector_result[3] = z_negative ? 5.0f : 4.0f;
-        } else if (y_abs >= x_abs) {
-          bool y_negative = std::isless(y, 0.0f);
-          vector_result[0] = y_negative ? -z : z;
-          vector_result[1] = x;
-          vector_result[2] = y;
-          vector_result[3] = y_negative ? 3.0f : 2.0f;
-        } else {
-          bool x_negative = std::isless(x, 0.0f);
-          vector_result[0] = -y;
-          vector_result[1] = x_negative ? z : -z;
-          vector_result[2] = x;
-          vector_result[3] = x_negative ? 1.0f : 0.0f;
-        }
-        vector_result[2] *= 2.0f;
+        CalculateCube(vector_operands[0], vector_result);
       } break;
       case ucode::AluVectorOpcode::kMax4: {
-        if (std::isgreaterequal(vector_operands[0][0], vector_operands[0][1]) &&
-            std::isgreaterequal(vector_operands[0][0], vector_operands[0][2]) &&
-            std::isgreaterequal(vector_operands[0][0], vector_operands[0][3])) {
-          vector_result[0] = vector_operands[0][0];
-        } else if (std::isgreaterequal(vector_operands[0][1],
-                                       vector_operands[0][2]) &&
-                   std::isgreaterequal(vector_operands[0][1],
-                                       vector_operands[0][3])) {
-          vector_result[0] = vector_operands[0][1];
-        } else if (std::isgreaterequal(vector_operands[0][2],
-                                       vector_operands[0][3])) {
-          vector_result[0] = vector_operands[0][2];
-        } else {
-          vector_result[0] = vector_operands[0][3];
-        }
+        vector_result[0] = CalculateMax4(vector_operands[0]);
         replicate_vector_result_x = true;
       } break;
       case ucode::AluVectorOpcode::kSetpEqPush: {
@@ -632,7 +923,7 @@ void ShaderInterpreter::ExecuteAluInstruction(ucode::AluInstruction instr) {
             scalar_src_register);
       } else {
         scalar_src_float_constant = GetFloatConstant(
-            scalar_src_register, instr.src_const_is_addressed(3),
+            state_, scalar_src_register, instr.src_const_is_addressed(3),
             instr.is_const_address_register_relative());
         scalar_src_ptr = scalar_src_float_constant.data();
       }
@@ -653,7 +944,8 @@ void ShaderInterpreter::ExecuteAluInstruction(ucode::AluInstruction instr) {
       uint32_t scalar_src_swizzle = instr.src_swizzle(3);
       // c#.w.
       scalar_operands[0] =
-          GetFloatConstant(instr.src_reg(3), instr.src_const_is_addressed(3),
+          GetFloatConstant(state_, instr.src_reg(3),
+                           instr.src_const_is_addressed(3),
                            instr.is_const_address_register_relative())
               [ucode::AluInstruction::GetSwizzledComponentIndex(
                   scalar_src_swizzle, 3)];
@@ -950,27 +1242,28 @@ void ShaderInterpreter::ExecuteAluInstruction(ucode::AluInstruction instr) {
   }
 }
 
-void ShaderInterpreter::StoreFetchResult(uint32_t dest, bool is_dest_relative,
+void ShaderInterpreter::StoreFetchResult(float* dest,
+                                         uint32_t dest_component_stride,
                                          uint32_t swizzle, const float* value) {
-  float* dest_data = GetTempRegister(dest, is_dest_relative);
   for (uint32_t i = 0; i < 4; ++i) {
+    float& dest_component = dest[dest_component_stride * i];
     ucode::FetchDestinationSwizzle component_swizzle =
         ucode::GetFetchDestinationComponentSwizzle(swizzle, i);
     switch (component_swizzle) {
       case ucode::FetchDestinationSwizzle::kX:
-        dest_data[i] = value[0];
+        dest_component = value[0];
         break;
       case ucode::FetchDestinationSwizzle::kY:
-        dest_data[i] = value[1];
+        dest_component = value[1];
         break;
       case ucode::FetchDestinationSwizzle::kZ:
-        dest_data[i] = value[2];
+        dest_component = value[2];
         break;
       case ucode::FetchDestinationSwizzle::kW:
-        dest_data[i] = value[3];
+        dest_component = value[3];
         break;
       case ucode::FetchDestinationSwizzle::k1:
-        dest_data[i] = 1.0f;
+        dest_component = 1.0f;
         break;
       case ucode::FetchDestinationSwizzle::kKeep:
         break;
@@ -978,37 +1271,36 @@ void ShaderInterpreter::StoreFetchResult(uint32_t dest, bool is_dest_relative,
         // ucode::FetchDestinationSwizzle::k0 or the invalid swizzle 6.
         // TODO(Triang3l): Find the correct handling of the invalid swizzle 6.
         assert_true(component_swizzle == ucode::FetchDestinationSwizzle::k0);
-        dest_data[i] = 0.0f;
+        dest_component = 0.0f;
         break;
     }
   }
 }
 
-void ShaderInterpreter::ExecuteVertexFetchInstruction(
-    ucode::VertexFetchInstruction instr) {
+void ShaderInterpreter::FetchVertex(State& state,
+                                    ucode::VertexFetchInstruction instr,
+                                    float index_operand, float* result) const {
   // FIXME(Triang3l): Bit scan loops over components cause a link-time
   // optimization internal error in Visual Studio 2019, mainly in the format
   // unpacking. Using loops with up to 4 iterations here instead.
 
   if (!instr.is_mini_fetch()) {
-    state_.vfetch_full_last = instr;
+    state.vfetch_full_last = instr;
   }
 
   xenos::xe_gpu_vertex_fetch_t fetch_constant = register_file_.GetVertexFetch(
-      state_.vfetch_full_last.fetch_constant_index());
+      state.vfetch_full_last.fetch_constant_index());
 
   if (!instr.is_mini_fetch()) {
     // Get the part of the address that depends on vfetch_full data.
     uint32_t vertex_index = uint32_t(std::floor(
-        GetTempRegister(instr.src(),
-                        instr.is_src_relative())[instr.src_swizzle()] +
-        (instr.is_index_rounded() ? 0.5f : 0.0f)));
-    state_.vfetch_address_dwords =
+        index_operand + (instr.is_index_rounded() ? 0.5f : 0.0f)));
+    state.vfetch_address_dwords =
         instr.stride() * vertex_index + fetch_constant.address;
   }
 
   // TODO(Triang3l): Find the default values for unused components.
-  float result[4] = {};
+  std::memset(result, 0, sizeof(float) * 4);
   uint32_t dest_swizzle = instr.dest_swizzle();
   uint32_t used_result_components = 0b0000;
   for (uint32_t i = 0; i < 4; ++i) {
@@ -1025,7 +1317,7 @@ void ShaderInterpreter::ExecuteVertexFetchInstruction(
         reinterpret_cast<const uint32_t*>(memory_.physical_membase());
     uint32_t buffer_end_dwords = fetch_constant.address + fetch_constant.size;
     uint32_t dword_0_address_dwords =
-        uint32_t(int32_t(state_.vfetch_address_dwords) + instr.offset());
+        uint32_t(int32_t(state.vfetch_address_dwords) + instr.offset());
     for (uint32_t i = 0; i < 4; ++i) {
       if (!(needed_dwords & (UINT32_C(1) << i))) {
         continue;
@@ -1214,9 +1506,910 @@ void ShaderInterpreter::ExecuteVertexFetchInstruction(
       result[i] *= exp_adjust_factor;
     }
   }
+}
+
+void ShaderInterpreter::ExecuteVertexFetchInstruction(
+    ucode::VertexFetchInstruction instr) {
+  float index_operand = 0.0f;
+  if (!instr.is_mini_fetch()) {
+    index_operand = GetTempRegister(
+        instr.src(), instr.is_src_relative())[instr.src_swizzle()];
+  }
+  float result[4];
+  FetchVertex(state_, instr, index_operand, result);
+  StoreFetchResult(GetTempRegister(instr.dest(), instr.is_dest_relative()), 1,
+                   instr.dest_swizzle(), result);
+}
+
+void ShaderInterpreter::ExecuteBatch(uint32_t lane_count) {
+  assert_true(lane_count <= kBatchSize);
+
+  // For more consistency between invocations in case of a malformed shader.
+  batch_state_.Reset();
+
+  uint32_t cf_indices[kBatchSize] = {};
+  uint32_t running_lanes = (UINT32_C(1) << lane_count) - 1;
+  while (running_lanes) {
+    // Execute the lanes at the earliest control flow instruction together -
+    // the lanes that have branched forward wait for the rest, so lanes that
+    // have diverged are joined again where their paths meet.
+    uint32_t cf_index = UINT32_MAX;
+    uint32_t lanes_remaining = running_lanes;
+    uint32_t lane;
+    while (xe::bit_scan_forward(lanes_remaining, &lane)) {
+      lanes_remaining &= ~(UINT32_C(1) << lane);
+      cf_index = std::min(cf_index, cf_indices[lane]);
+    }
+    uint32_t lanes = 0;
+    lanes_remaining = running_lanes;
+    while (xe::bit_scan_forward(lanes_remaining, &lane)) {
+      lanes_remaining &= ~(UINT32_C(1) << lane);
+      if (cf_indices[lane] == cf_index) {
+        lanes |= UINT32_C(1) << lane;
+        cf_indices[lane] = cf_index + 1;
+      }
+    }
+
+    ucode::ControlFlowInstruction cf_instr =
+        GetControlFlowInstruction(cf_index);
+    ucode::ControlFlowOpcode cf_opcode = cf_instr.opcode();
+    switch (cf_opcode) {
+      case ucode::ControlFlowOpcode::kNop: {
+      } break;
+
+      case ucode::ControlFlowOpcode::kExec:
+      case ucode::ControlFlowOpcode::kExecEnd:
+      case ucode::ControlFlowOpcode::kCondExec:
+      case ucode::ControlFlowOpcode::kCondExecEnd:
+      case ucode::ControlFlowOpcode::kCondExecPred:
+      case ucode::ControlFlowOpcode::kCondExecPredEnd:
+      case ucode::ControlFlowOpcode::kCondExecPredClean:
+      case ucode::ControlFlowOpcode::kCondExecPredCleanEnd: {
+        ucode::ControlFlowExecInstruction cf_exec =
+            *reinterpret_cast<const ucode::ControlFlowExecInstruction*>(
+                &cf_instr);
+
+        uint32_t exec_lanes = lanes;
+        switch (cf_opcode) {
+          case ucode::ControlFlowOpcode::kCondExec:
+          case ucode::ControlFlowOpcode::kCondExecEnd:
+          case ucode::ControlFlowOpcode::kCondExecPredClean:
+          case ucode::ControlFlowOpcode::kCondExecPredCleanEnd: {
+            const ucode::ControlFlowCondExecInstruction cf_cond_exec =
+                *reinterpret_cast<const ucode::ControlFlowCondExecInstruction*>(
+                    &cf_exec);
+            if (cf_cond_exec.condition() !=
+                GetBoolConstant(cf_cond_exec.bool_address())) {
+              exec_lanes = 0;
+            }
+          } break;
+          case ucode::ControlFlowOpcode::kCondExecPred:
+          case ucode::ControlFlowOpcode::kCondExecPredEnd: {
+            const ucode::ControlFlowCondExecPredInstruction cf_cond_exec_pred =
+                *reinterpret_cast<
+                    const ucode::ControlFlowCondExecPredInstruction*>(&cf_exec);
+            uint32_t predicate_mask = batch_state_.GetPredicateMask();
+            exec_lanes &= cf_cond_exec_pred.condition() ? predicate_mask
+                                                        : ~predicate_mask;
+          } break;
+          default:
+            break;
+        }
+        if (!exec_lanes) {
+          break;
+        }
+
+        for (uint32_t exec_index = 0; exec_index < cf_exec.count();
+             ++exec_index) {
+          const uint32_t* exec_instruction =
+              &ucode_[3 * (cf_exec.address() + exec_index)];
+          uint32_t instruction_lanes = exec_lanes;
+          if ((cf_exec.sequence() >> (exec_index << 1)) & 0b01) {
+            const ucode::FetchInstruction& fetch_instr =
+                *reinterpret_cast<const ucode::FetchInstruction*>(
+                    exec_instruction);
+            if (fetch_instr.is_predicated()) {
+              uint32_t predicate_mask = batch_state_.GetPredicateMask();
+              instruction_lanes &= fetch_instr.predicate_condition()
+                                       ? predicate_mask
+                                       : ~predicate_mask;
+            }
+            if (!instruction_lanes) {
+              continue;
+            }
+            if (fetch_instr.opcode() == ucode::FetchOpcode::kVertexFetch) {
+              ExecuteBatchVertexFetchInstruction(fetch_instr.vertex_fetch(),
+                                                 instruction_lanes);
+            } else {
+              // Not supporting texture fetching (very complex).
+              float zero_result[4] = {};
+              uint32_t fetch_lanes_remaining = instruction_lanes;
+              uint32_t fetch_lane;
+              while (
+                  xe::bit_scan_forward(fetch_lanes_remaining, &fetch_lane)) {
+                fetch_lanes_remaining &= ~(UINT32_C(1) << fetch_lane);
+                StoreFetchResult(
+                    &batch_temp_registers_[GetBatchTempRegisterIndex(
+                        fetch_lane, fetch_instr.dest(),
+                        fetch_instr.is_dest_relative())][0][fetch_lane],
+                    kBatchSize, fetch_instr.dest_swizzle(), zero_result);
+              }
+            }
+          } else {
+            const ucode::AluInstruction& alu_instr =
+                *reinterpret_cast<const ucode::AluInstruction*>(
+                    exec_instruction);
+            if (alu_instr.is_predicated()) {
+              uint32_t predicate_mask = batch_state_.GetPredicateMask();
+              instruction_lanes &= alu_instr.predicate_condition()
+                                       ? predicate_mask
+                                       : ~predicate_mask;
+            }
+            if (!instruction_lanes) {
+              continue;
+            }
+            ExecuteBatchAluInstruction(alu_instr, instruction_lanes);
+          }
+        }
+
+        if (ucode::DoesControlFlowOpcodeEndShader(cf_opcode)) {
+          running_lanes &= ~exec_lanes;
+        }
+      } break;
+
+      case ucode::ControlFlowOpcode::kLoopStart:
+      case ucode::ControlFlowOpcode::kLoopEnd:
+      case ucode::ControlFlowOpcode::kCondCall:
+      case ucode::ControlFlowOpcode::kReturn:
+      case ucode::ControlFlowOpcode::kCondJmp: {
+        // Predicated branches may diverge.
+        lanes_remaining = lanes;
+        while (xe::bit_scan_forward(lanes_remaining, &lane)) {
+          lanes_remaining &= ~(UINT32_C(1) << lane);
+          cf_indices[lane] = ExecuteControlFlowBranch(batch_state_.lanes[lane],
+                                                      cf_instr, cf_index);
+        }
+      } break;
+
+      case ucode::ControlFlowOpcode::kAlloc: {
+        if (export_sink_) {
+          const ucode::ControlFlowAllocInstruction& cf_alloc =
+              *reinterpret_cast<const ucode::ControlFlowAllocInstruction*>(
+                  &cf_instr);
+          export_sink_->AllocExport(cf_alloc.alloc_type(), cf_alloc.size());
+        }
+      } break;
 
-  StoreFetchResult(instr.dest(), instr.is_dest_relative(), instr.dest_swizzle(),
-                   result);
+      case ucode::ControlFlowOpcode::kMarkVsFetchDone: {
+      } break;
+
+      default:
+        assert_unhandled_case(cf_opcode);
+    }
+  }
+}
+
+const float* ShaderInterpreter::GetBatchAluSource(ucode::AluInstruction instr,
+                                                  uint32_t operand_index,
+                                                  uint32_t lane_mask,
+                                                  float* buffer) const {
+  uint32_t src_register = instr.src_reg(operand_index);
+  if (instr.src_is_temp(operand_index)) {
+    uint32_t temp_register =
+        ucode::AluInstruction::src_temp_reg(src_register);
+    if (!ucode::AluInstruction::is_src_temp_relative(src_register)) {
+      return &batch_temp_registers_[GetBatchTempRegisterIndex(
+          0, temp_register, false)][0][0];
+    }
+    // Only the lanes being executed have a valid loop state.
+    std::memset(buffer, 0, sizeof(float) * 4 * kBatchSize);
+    uint32_t lanes_remaining = lane_mask;
+    uint32_t lane;
+    while (xe::bit_scan_forward(lanes_remaining, &lane)) {
+      lanes_remaining &= ~(UINT32_C(1) << lane);
+      const float(*lane_register)[kBatchSize] =
+          batch_temp_registers_[GetBatchTempRegisterIndex(lane, temp_register,
+                                                          true)];
+      for (uint32_t i = 0; i < 4; ++i) {
+        buffer[kBatchSize * i + lane] = lane_register[i][lane];
+      }
+    }
+    return buffer;
+  }
+  bool is_addressed = instr.src_const_is_addressed(operand_index);
+  bool relative_address_is_a0 = instr.is_const_address_register_relative();
+  if (!is_addressed) {
+    std::array<float, 4> float_constant = GetFloatConstant(
+        batch_state_.lanes[0], src_register, false, relative_address_is_a0);
+    for (uint32_t i = 0; i < 4; ++i) {
+      BatchStore(buffer + kBatchSize * i, BatchSplat(float_constant[i]));
+    }
+    return buffer;
+  }
+  std::memset(buffer, 0, sizeof(float) * 4 * kBatchSize);
+  uint32_t lanes_remaining = lane_mask;
+  uint32_t lane;
+  while (xe::bit_scan_forward(lanes_remaining, &lane)) {
+    lanes_remaining &= ~(UINT32_C(1) << lane);
+    std::array<float, 4> float_constant =
+        GetFloatConstant(batch_state_.lanes[lane], src_register, true,
+                         relative_address_is_a0);
+    for (uint32_t i = 0; i < 4; ++i) {
+      buffer[kBatchSize * i + lane] = float_constant[i];
+    }
+  }
+  return buffer;
+}
+
+void ShaderInterpreter::ExecuteBatchAluInstruction(ucode::AluInstruction instr,
+                                                   uint32_t lane_mask) {
+  BatchVector zero = BatchSplat(0.0f);
+  BatchVector one = BatchSplat(1.0f);
+
+  // Updates the predicate in the lanes being executed.
+  auto set_predicate = [this, lane_mask](BatchVector predicate) {
+    uint32_t predicate_mask = BatchGetMaskBits(predicate);
+    uint32_t lanes_remaining = lane_mask;
+    uint32_t lane;
+    while (xe::bit_scan_forward(lanes_remaining, &lane)) {
+      lanes_remaining &= ~(UINT32_C(1) << lane);
+      batch_state_.lanes[lane].predicate = (predicate_mask >> lane) & 1;
+    }
+  };
+
+  // Vector operation.
+  alignas(32) float vector_result[4][kBatchSize] = {};
+  ucode::AluVectorOpcode vector_opcode = instr.vector_opcode();
+  const ucode::AluVectorOpcodeInfo& vector_opcode_info =
+      ucode::GetAluVectorOpcodeInfo(vector_opcode);
+  uint32_t vector_result_write_mask = instr.GetVectorOpResultWriteMask();
+  if (vector_result_write_mask || vector_opcode_info.changed_state) {
+    alignas(32) float vector_operands[3][4][kBatchSize];
+    for (uint32_t i = 0; i < 3; ++i) {
+      if (!vector_opcode_info.operand_components_used[i]) {
+        continue;
+      }
+      alignas(32) float vector_src_buffer[4][kBatchSize];
+      const float* vector_src =
+          GetBatchAluSource(instr, 1 + i, lane_mask,
+                            &vector_src_buffer[0][0]);
+      bool vector_src_absolute =
+          instr.src_is_temp(1 + i) &&
+          ucode::AluInstruction::is_src_temp_value_absolute(
+              instr.src_reg(1 + i));
+      BatchVector vector_src_absolute_mask = BatchSplatBits(
+          ~(uint32_t(vector_src_absolute) << 31));
+      BatchVector vector_src_negate_bit =
+          BatchSplatBits(uint32_t(instr.src_negate(1 + i)) << 31);
+      uint32_t vector_src_swizzle = instr.src_swizzle(1 + i);
+      for (uint32_t j = 0; j < 4; ++j) {
+        BatchVector vector_src_component = BatchFlushDenormal(BatchLoad(
+            vector_src +
+            kBatchSize * ucode::AluInstruction::GetSwizzledComponentIndex(
+                             vector_src_swizzle, j)));
+        BatchStore(vector_operands[i][j],
+                   BatchXor(BatchAnd(vector_src_component,
+                                     vector_src_absolute_mask),
+                            vector_src_negate_bit));
+      }
+    }
+    auto operand = [&vector_operands](uint32_t i, uint32_t j) {
+      return BatchLoad(vector_operands[i][j]);
+    };
+
+    bool replicate_vector_result_x = false;
+    switch (vector_opcode) {
+      case ucode::AluVectorOpcode::kAdd: {
+        for (uint32_t i = 0; i < 4; ++i) {
+          BatchStore(vector_result[i], BatchAdd(operand(0, i), operand(1, i)));
+        }
+      } break;
+      case ucode::AluVectorOpcode::kMul: {
+        for (uint32_t i = 0; i < 4; ++i) {
+          BatchStore(vector_result[i],
+                     BatchMulD3D9(operand(0, i), operand(1, i)));
+        }
+      } break;
+      case ucode::AluVectorOpcode::kMax:
+      case ucode::AluVectorOpcode::kMaxA: {
+        if (vector_opcode == ucode::AluVectorOpcode::kMaxA) {
+          uint32_t lanes_remaining = lane_mask;
+          uint32_t lane;
+          while (xe::bit_scan_forward(lanes_remaining, &lane)) {
+            lanes_remaining &= ~(UINT32_C(1) << lane);
+            batch_state_.lanes[lane].address_register =
+                int32_t(std::floor(xe::clamp_float(vector_operands[0][3][lane],
+                                                   -256.0f, 255.0f) +
+                                   0.5f));
+          }
+        }
+        for (uint32_t i = 0; i < 4; ++i) {
+          BatchVector a = operand(0, i), b = operand(1, i);
+          BatchStore(vector_result[i],
+                     BatchSelect(BatchGreaterEqual(a, b), a, b));
+        }
+      } break;
+      case ucode::AluVectorOpcode::kMin: {
+        for (uint32_t i = 0; i < 4; ++i) {
+          BatchVector a = operand(0, i), b = operand(1, i);
+          BatchStore(vector_result[i], BatchSelect(BatchLess(a, b), a, b));
+        }
+      } break;
+      case ucode::AluVectorOpcode::kSeq: {
+        for (uint32_t i = 0; i < 4; ++i) {
+          BatchStore(vector_result[i],
+                     BatchAnd(BatchEqual(operand(0, i), operand(1, i)), one));
+        }
+      } break;
+      case ucode::AluVectorOpcode::kSgt: {
+        for (uint32_t i = 0; i < 4; ++i) {
+          BatchStore(
+              vector_result[i],
+              BatchAnd(BatchGreater(operand(0, i), operand(1, i)), one));
+        }
+      } break;
+      case ucode::AluVectorOpcode::kSge: {
+        for (uint32_t i = 0; i < 4; ++i) {
+          BatchStore(
+              vector_result[i],
+              BatchAnd(BatchGreaterEqual(operand(0, i), operand(1, i)), one));
+        }
+      } break;
+      case ucode::AluVectorOpcode::kSne: {
+        for (uint32_t i = 0; i < 4; ++i) {
+          BatchStore(
+              vector_result[i],
+              BatchAnd(BatchNotEqual(operand(0, i), operand(1, i)), one));
+        }
+      } break;
+      case ucode::AluVectorOpcode::kFrc: {
+        for (uint32_t i = 0; i < 4; ++i) {
+          BatchVector a = operand(0, i);
+          BatchStore(vector_result[i], BatchSub(a, BatchFloor(a)));
+        }
+      } break;
+      case ucode::AluVectorOpcode::kTrunc: {
+        for (uint32_t i = 0; i < 4; ++i) {
+          BatchStore(vector_result[i], BatchTrunc(operand(0, i)));
+        }
+      } break;
+      case ucode::AluVectorOpcode::kFloor: {
+        for (uint32_t i = 0; i < 4; ++i) {
+          BatchStore(vector_result[i], BatchFloor(operand(0, i)));
+        }
+      } break;
+      case ucode::AluVectorOpcode::kMad: {
+        for (uint32_t i = 0; i < 4; ++i) {
+          // Doing the addition rather than conditional assignment even for zero
+          // operands because +0 + -0 must be +0.
+          BatchStore(vector_result[i],
+                     BatchAdd(BatchMulD3D9(operand(0, i), operand(1, i)),
+                              operand(2, i)));
+        }
+      } break;
+      case ucode::AluVectorOpcode::kCndEq: {
+        for (uint32_t i = 0; i < 4; ++i) {
+          BatchStore(vector_result[i],
+                     BatchSelect(BatchEqual(operand(0, i), zero),
+                                 operand(1, i), operand(2, i)));
+        }
+      } break;
+      case ucode::AluVectorOpcode::kCndGe: {
+        for (uint32_t i = 0; i < 4; ++i) {
+          BatchStore(vector_result[i],
+                     BatchSelect(BatchGreaterEqual(operand(0, i), zero),
+                                 operand(1, i), operand(2, i)));
+        }
+      } break;
+      case ucode::AluVectorOpcode::kCndGt: {
+        for (uint32_t i = 0; i < 4; ++i) {
+          BatchStore(vector_result[i],
+                     BatchSelect(BatchGreater(operand(0, i), zero),
+                                 operand(1, i), operand(2, i)));
+        }
+      } break;
+      case ucode::AluVectorOpcode::kDp4:
+      case ucode::AluVectorOpcode::kDp3:
+      case ucode::AluVectorOpcode::kDp2Add: {
+        uint32_t component_count =
+            vector_opcode == ucode::AluVectorOpcode::kDp4
+                ? 4
+                : (vector_opcode == ucode::AluVectorOpcode::kDp3 ? 3 : 2);
+        // Doing the addition even for zero operands because +0 + -0 must be
+        // +0.
+        BatchVector dot = zero;
+        for (uint32_t i = 0; i < component_count; ++i) {
+          dot = BatchAdd(dot, BatchMulD3D9(operand(0, i), operand(1, i)));
+        }
+        if (vector_opcode == ucode::AluVectorOpcode::kDp2Add) {
+          dot = BatchAdd(dot, operand(2, 0));
+        }
+        BatchStore(vector_result[0], dot);
+        replicate_vector_result_x = true;
+      } break;
+      case ucode::AluVectorOpcode::kCube:
+      case ucode::AluVectorOpcode::kMax4: {
+        for (uint32_t lane = 0; lane < kBatchSize; ++lane) {
+          float lane_operand[4], lane_result[4];
+          for (uint32_t i = 0; i < 4; ++i) {
+            lane_operand[i] = vector_operands[0][i][lane];
+          }
+          if (vector_opcode == ucode::AluVectorOpcode::kCube) {
+            CalculateCube(lane_operand, lane_result);
+            for (uint32_t i = 0; i < 4; ++i) {
+              vector_result[i][lane] = lane_result[i];
+            }
+          } else {
+            vector_result[0][lane] = CalculateMax4(lane_operand);
+          }
+        }
+        replicate_vector_result_x =
+            vector_opcode == ucode::AluVectorOpcode::kMax4;
+      } break;
+      case ucode::AluVectorOpcode::kSetpEqPush:
+      case ucode::AluVectorOpcode::kSetpNePush:
+      case ucode::AluVectorOpcode::kSetpGtPush:
+      case ucode::AluVectorOpcode::kSetpGePush: {
+        auto compare = [vector_opcode, zero](BatchVector value) {
+          switch (vector_opcode) {
+            case ucode::AluVectorOpcode::kSetpEqPush:
+              return BatchEqual(value, zero);
+            case ucode::AluVectorOpcode::kSetpNePush:
+              return BatchNotEqual(value, zero);
+            case ucode::AluVectorOpcode::kSetpGtPush:
+              return BatchGreater(value, zero);
+            default:
+              return BatchGreaterEqual(value, zero);
+          }
+        };
+        set_predicate(BatchAnd(BatchEqual(operand(0, 3), zero),
+                               compare(operand(1, 3))));
+        BatchStore(vector_result[0],
+                   BatchSelect(BatchAnd(BatchEqual(operand(0, 0), zero),
+                                        compare(operand(1, 0))),
+                               zero, BatchAdd(operand(0, 0), one)));
+        replicate_vector_result_x = true;
+      } break;
+      // Not implementing pixel kill currently, the interpreter is currently
+      // used only for vertex shaders.
+      case ucode::AluVectorOpcode::kKillEq:
+      case ucode::AluVectorOpcode::kKillGt:
+      case ucode::AluVectorOpcode::kKillGe:
+      case ucode::AluVectorOpcode::kKillNe: {
+        BatchVector kill = zero;
+        for (uint32_t i = 0; i < 4; ++i) {
+          BatchVector a = operand(0, i), b = operand(1, i);
+          BatchVector kill_component;
+          switch (vector_opcode) {
+            case ucode::AluVectorOpcode::kKillEq:
+              kill_component = BatchEqual(a, b);
+              break;
+            case ucode::AluVectorOpcode::kKillGt:
+              kill_component = BatchGreater(a, b);
+              break;
+            case ucode::AluVectorOpcode::kKillGe:
+              kill_component = BatchGreaterEqual(a, b);
+              break;
+            default:
+              kill_component = BatchNotEqual(a, b);
+              break;
+          }
+          kill = BatchOr(kill, kill_component);
+        }
+        BatchStore(vector_result[0], BatchAnd(kill, one));
+        replicate_vector_result_x = true;
+      } break;
+      case ucode::AluVectorOpcode::kDst: {
+        BatchStore(vector_result[0], one);
+        BatchStore(vector_result[1],
+                   BatchMulD3D9(operand(0, 1), operand(1, 1)));
+        BatchStore(vector_result[2], operand(0, 2));
+        BatchStore(vector_result[3], operand(1, 3));
+      } break;
+      default: {
+        assert_unhandled_case(vector_opcode);
+      }
+    }
+    if (replicate_vector_result_x) {
+      for (uint32_t i = 1; i < 4; ++i) {
+        std::memcpy(vector_result[i], vector_result[0],
+                    sizeof(float) * kBatchSize);
+      }
+    }
+  }
+
+  // Scalar operation.
+  ucode::AluScalarOpcode scalar_opcode = instr.scalar_opcode();
+  const ucode::AluScalarOpcodeInfo& scalar_opcode_info =
+      ucode::GetAluScalarOpcodeInfo(scalar_opcode);
+  alignas(32) float scalar_operands[2][kBatchSize] = {};
+  uint32_t scalar_operand_component_count = 0;
+  bool scalar_src_absolute = false;
+  uint32_t scalar_src_swizzle = instr.src_swizzle(3);
+  switch (scalar_opcode_info.operand_count) {
+    case 1: {
+      // r#/c#.w or r#/c#.wx.
+      alignas(32) float scalar_src_buffer[4][kBatchSize];
+      const float* scalar_src =
+          GetBatchAluSource(instr, 3, lane_mask, &scalar_src_buffer[0][0]);
+      if (instr.src_is_temp(3)) {
+        scalar_src_absolute = ucode::AluInstruction::is_src_temp_value_absolute(
+            instr.src_reg(3));
+      }
+      scalar_operand_component_count =
+          scalar_opcode_info.single_operand_is_two_component ? 2 : 1;
+      for (uint32_t i = 0; i < scalar_operand_component_count; ++i) {
+        std::memcpy(
+            scalar_operands[i],
+            scalar_src +
+                kBatchSize * ucode::AluInstruction::GetSwizzledComponentIndex(
+                                 scalar_src_swizzle, (3 + i) & 3),
+            sizeof(float) * kBatchSize);
+      }
+    } break;
+    case 2: {
+      scalar_operand_component_count = 2;
+      // c#.w.
+      uint32_t scalar_src_constant_component =
+          ucode::AluInstruction::GetSwizzledComponentIndex(scalar_src_swizzle,
+                                                           3);
+      if (instr.src_const_is_addressed(3)) {
+        uint32_t lanes_remaining = lane_mask;
+        uint32_t lane;
+        while (xe::bit_scan_forward(lanes_remaining, &lane)) {
+          lanes_remaining &= ~(UINT32_C(1) << lane);
+          scalar_operands[0][lane] = GetFloatConstant(
+              batch_state_.lanes[lane], instr.src_reg(3), true,
+              instr.is_const_address_register_relative())
+              [scalar_src_constant_component];
+        }
+      } else {
+        std::fill(std::begin(scalar_operands[0]),
+                  std::end(scalar_operands[0]),
+                  GetFloatConstant(batch_state_.lanes[0], instr.src_reg(3),
+                                   false,
+                                   instr.is_const_address_register_relative())
+                      [scalar_src_constant_component]);
+      }
+      // r#.x.
+      const float(*scalar_src_temp)[kBatchSize] =
+          batch_temp_registers_[GetBatchTempRegisterIndex(
+              0, instr.scalar_const_reg_op_src_temp_reg(), false)];
+      std::memcpy(scalar_operands[1],
+                  scalar_src_temp[ucode::AluInstruction::
+                                      GetSwizzledComponentIndex(
+                                          scalar_src_swizzle, 0)],
+                  sizeof(float) * kBatchSize);
+    } break;
+  }
+  if (scalar_operand_component_count) {
+    BatchVector scalar_src_absolute_mask =
+        BatchSplatBits(~(uint32_t(scalar_src_absolute) << 31));
+    BatchVector scalar_src_negate_bit =
+        BatchSplatBits(uint32_t(instr.src_negate(3)) << 31);
+    for (uint32_t i = 0; i < scalar_operand_component_count; ++i) {
+      BatchStore(scalar_operands[i],
+                 BatchXor(BatchAnd(BatchFlushDenormal(
+                                       BatchLoad(scalar_operands[i])),
+                                   scalar_src_absolute_mask),
+                          scalar_src_negate_bit));
+    }
+  }
+  BatchVector scalar_operand_0 = BatchLoad(scalar_operands[0]);
+  BatchVector scalar_operand_1 = BatchLoad(scalar_operands[1]);
+  BatchVector previous_scalar_old = BatchLoad(batch_state_.previous_scalar);
+  BatchVector previous_scalar = previous_scalar_old;
+  switch (scalar_opcode) {
+    case ucode::AluScalarOpcode::kAdds:
+    case ucode::AluScalarOpcode::kAddsc0:
+    case ucode::AluScalarOpcode::kAddsc1: {
+      previous_scalar = BatchAdd(scalar_operand_0, scalar_operand_1);
+    } break;
+    case ucode::AluScalarOpcode::kAddsPrev: {
+      previous_scalar = BatchAdd(scalar_operand_0, previous_scalar);
+    } break;
+    case ucode::AluScalarOpcode::kMuls:
+    case ucode::AluScalarOpcode::kMulsc0:
+    case ucode::AluScalarOpcode::kMulsc1: {
+      previous_scalar = BatchMulD3D9(scalar_operand_0, scalar_operand_1);
+    } break;
+    case ucode::AluScalarOpcode::kMulsPrev: {
+      previous_scalar = BatchMulD3D9(scalar_operand_0, previous_scalar);
+    } break;
+    case ucode::AluScalarOpcode::kMaxs: {
+      previous_scalar =
+          BatchSelect(BatchGreaterEqual(scalar_operand_0, scalar_operand_1),
+                      scalar_operand_0, scalar_operand_1);
+    } break;
+    case ucode::AluScalarOpcode::kMins: {
+      previous_scalar =
+          BatchSelect(BatchLess(scalar_operand_0, scalar_operand_1),
+                      scalar_operand_0, scalar_operand_1);
+    } break;
+    case ucode::AluScalarOpcode::kSeqs:
+    // Not implementing pixel kill currently, the interpreter is currently used
+    // only for vertex shaders.
+    case ucode::AluScalarOpcode::kKillsEq: {
+      previous_scalar = BatchAnd(BatchEqual(scalar_operand_0, zero), one);
+    } break;
+    case ucode::AluScalarOpcode::kSgts:
+    case ucode::AluScalarOpcode::kKillsGt: {
+      previous_scalar = BatchAnd(BatchGreater(scalar_operand_0, zero), one);
+    } break;
+    case ucode::AluScalarOpcode::kSges:
+    case ucode::AluScalarOpcode::kKillsGe: {
+      previous_scalar =
+          BatchAnd(BatchGreaterEqual(scalar_operand_0, zero), one);
+    } break;
+    case ucode::AluScalarOpcode::kSnes:
+    case ucode::AluScalarOpcode::kKillsNe: {
+      previous_scalar = BatchAnd(BatchNotEqual(scalar_operand_0, zero), one);
+    } break;
+    case ucode::AluScalarOpcode::kKillsOne: {
+      previous_scalar = BatchAnd(BatchEqual(scalar_operand_0, one), one);
+    } break;
+    case ucode::AluScalarOpcode::kFrcs: {
+      previous_scalar =
+          BatchSub(scalar_operand_0, BatchFloor(scalar_operand_0));
+    } break;
+    case ucode::AluScalarOpcode::kTruncs: {
+      previous_scalar = BatchTrunc(scalar_operand_0);
+    } break;
+    case ucode::AluScalarOpcode::kFloors: {
+      previous_scalar = BatchFloor(scalar_operand_0);
+    } break;
+    case ucode::AluScalarOpcode::kRcpc: {
+      previous_scalar = BatchReplaceInfinity(BatchDiv(one, scalar_operand_0),
+                                             -FLT_MAX, FLT_MAX);
+    } break;
+    case ucode::AluScalarOpcode::kRcpf: {
+      previous_scalar = BatchReplaceInfinity(BatchDiv(one, scalar_operand_0),
+                                             -0.0f, 0.0f);
+    } break;
+    case ucode::AluScalarOpcode::kRcp: {
+      previous_scalar = BatchDiv(one, scalar_operand_0);
+    } break;
+    case ucode::AluScalarOpcode::kRsqc: {
+      previous_scalar = BatchReplaceInfinity(
+          BatchDiv(one, BatchSqrt(scalar_operand_0)), -FLT_MAX, FLT_MAX);
+    } break;
+    case ucode::AluScalarOpcode::kRsqf: {
+      previous_scalar = BatchReplaceInfinity(
+          BatchDiv(one, BatchSqrt(scalar_operand_0)), -0.0f, 0.0f);
+    } break;
+    case ucode::AluScalarOpcode::kRsq: {
+      previous_scalar = BatchDiv(one, BatchSqrt(scalar_operand_0));
+    } break;
+    case ucode::AluScalarOpcode::kSubs:
+    case ucode::AluScalarOpcode::kSubsc0:
+    case ucode::AluScalarOpcode::kSubsc1: {
+      previous_scalar = BatchSub(scalar_operand_0, scalar_operand_1);
+    } break;
+    case ucode::AluScalarOpcode::kSubsPrev: {
+      previous_scalar = BatchSub(scalar_operand_0, previous_scalar);
+    } break;
+    case ucode::AluScalarOpcode::kSetpEq:
+    case ucode::AluScalarOpcode::kSetpNe:
+    case ucode::AluScalarOpcode::kSetpGt:
+    case ucode::AluScalarOpcode::kSetpGe: {
+      BatchVector predicate;
+      switch (scalar_opcode) {
+        case ucode::AluScalarOpcode::kSetpEq:
+          predicate = BatchEqual(scalar_operand_0, zero);
+          break;
+        case ucode::AluScalarOpcode::kSetpNe:
+          predicate = BatchNotEqual(scalar_operand_0, zero);
+          break;
+        case ucode::AluScalarOpcode::kSetpGt:
+          predicate = BatchGreater(scalar_operand_0, zero);
+          break;
+        default:
+          predicate = BatchGreaterEqual(scalar_operand_0, zero);
+          break;
+      }
+      set_predicate(predicate);
+      previous_scalar = BatchAndNot(predicate, one);
+    } break;
+    case ucode::AluScalarOpcode::kSqrt: {
+      previous_scalar = BatchSqrt(scalar_operand_0);
+    } break;
+    case ucode::AluScalarOpcode::kRetainPrev: {
+    } break;
+    default: {
+      // Less common operations, and ones with scalar results, executed for
+      // each lane.
+      alignas(32) float lane_previous_scalars[kBatchSize];
+      BatchStore(lane_previous_scalars, previous_scalar);
+      uint32_t lanes_remaining = lane_mask;
+      uint32_t lane;
+      while (xe::bit_scan_forward(lanes_remaining, &lane)) {
+        lanes_remaining &= ~(UINT32_C(1) << lane);
+        State& lane_state = batch_state_.lanes[lane];
+        float& lane_previous_scalar = lane_previous_scalars[lane];
+        float lane_operand_0 = scalar_operands[0][lane];
+        float lane_operand_1 = scalar_operands[1][lane];
+        switch (scalar_opcode) {
+          case ucode::AluScalarOpcode::kMulsPrev2: {
+            if (lane_previous_scalar == -FLT_MAX ||
+                !std::isfinite(lane_previous_scalar) ||
+                !std::isfinite(lane_operand_1) ||
+                std::islessequal(lane_operand_1, 0.0f)) {
+              lane_previous_scalar = -FLT_MAX;
+            } else {
+              // Direct3D 9 behavior (0 or denormal * anything = +0).
+              lane_previous_scalar =
+                  (lane_operand_0 && lane_previous_scalar)
+                      ? lane_operand_0 * lane_previous_scalar
+                      : 0.0f;
+            }
+          } break;
+          case ucode::AluScalarOpcode::kExp: {
+            lane_previous_scalar = std::exp2(lane_operand_0);
+          } break;
+          case ucode::AluScalarOpcode::kLogc: {
+            lane_previous_scalar = std::log2(lane_operand_0);
+            if (lane_previous_scalar == -INFINITY) {
+              lane_previous_scalar = -FLT_MAX;
+            }
+          } break;
+          case ucode::AluScalarOpcode::kLog: {
+            lane_previous_scalar = std::log2(lane_operand_0);
+          } break;
+          case ucode::AluScalarOpcode::kMaxAs:
+          case ucode::AluScalarOpcode::kMaxAsf: {
+            float address =
+                xe::clamp_float(lane_operand_0, -256.0f, 255.0f);
+            if (scalar_opcode == ucode::AluScalarOpcode::kMaxAs) {
+              address += 0.5f;
+            }
+            lane_state.address_register = int32_t(std::floor(address));
+            lane_previous_scalar =
+                std::isgreaterequal(lane_operand_0, lane_operand_1)
+                    ? lane_operand_0
+                    : lane_operand_1;
+          } break;
+          case ucode::AluScalarOpcode::kSetpInv: {
+            lane_state.predicate = lane_operand_0 == 1.0f;
+            lane_previous_scalar =
+                lane_state.predicate
+                    ? 0.0f
+                    : (lane_operand_0 == 0.0f ? 1.0f : lane_operand_0);
+          } break;
+          case ucode::AluScalarOpcode::kSetpPop: {
+            float new_counter = lane_operand_0 - 1.0f;
+            lane_state.predicate = std::islessequal(new_counter, 0.0f);
+            lane_previous_scalar = lane_state.predicate ? 0.0f : new_counter;
+          } break;
+          case ucode::AluScalarOpcode::kSetpClr: {
+            lane_state.predicate = false;
+            lane_previous_scalar = FLT_MAX;
+          } break;
+          case ucode::AluScalarOpcode::kSetpRstr: {
+            lane_state.predicate = lane_operand_0 == 0.0f;
+            lane_previous_scalar =
+                lane_state.predicate ? 0.0f : lane_operand_0;
+          } break;
+          case ucode::AluScalarOpcode::kSin: {
+            lane_previous_scalar = std::sin(lane_operand_0);
+          } break;
+          case ucode::AluScalarOpcode::kCos: {
+            lane_previous_scalar = std::cos(lane_operand_0);
+          } break;
+          default: {
+            assert_unhandled_case(scalar_opcode);
+          }
+        }
+      }
+      previous_scalar = BatchLoad(lane_previous_scalars);
+    }
+  }
+
+  BatchVector lane_mask_vector = BatchMaskFromBits(lane_mask);
+  BatchStore(batch_state_.previous_scalar,
+             BatchSelect(lane_mask_vector, previous_scalar,
+                         previous_scalar_old));
+
+  if (instr.vector_clamp()) {
+    for (uint32_t i = 0; i < 4; ++i) {
+      BatchStore(vector_result[i], BatchSaturate(BatchLoad(vector_result[i])));
+    }
+  }
+  alignas(32) float scalar_result[kBatchSize];
+  BatchStore(scalar_result, instr.scalar_clamp()
+                                ? BatchSaturate(previous_scalar)
+                                : previous_scalar);
+
+  uint32_t scalar_result_write_mask = instr.GetScalarOpResultWriteMask();
+  if (instr.is_export()) {
+    if (export_sink_) {
+      alignas(32) float export_value[4][kBatchSize];
+      uint32_t export_constant_1_mask = instr.GetConstant1WriteMask();
+      for (uint32_t i = 0; i < 4; ++i) {
+        uint32_t export_component_bit = UINT32_C(1) << i;
+        const float* export_component;
+        if (vector_result_write_mask & export_component_bit) {
+          export_component = vector_result[i];
+        } else if (scalar_result_write_mask & export_component_bit) {
+          export_component = scalar_result;
+        } else {
+          std::fill(std::begin(export_value[i]), std::end(export_value[i]),
+                    (export_constant_1_mask & export_component_bit) ? 1.0f
+                                                                    : 0.0f);
+          continue;
+        }
+        std::memcpy(export_value[i], export_component,
+                    sizeof(float) * kBatchSize);
+      }
+      export_sink_->ExportBatch(
+          ucode::ExportRegister(instr.vector_dest()), &export_value[0][0],
+          vector_result_write_mask | scalar_result_write_mask |
+              instr.GetConstant0WriteMask() | export_constant_1_mask,
+          lane_mask);
+    }
+  } else {
+    auto store_result = [this, lane_mask, lane_mask_vector](
+                            uint32_t dest, bool is_dest_relative,
+                            uint32_t write_mask, const float* const* result) {
+      if (!is_dest_relative) {
+        float(*dest_register)[kBatchSize] =
+            batch_temp_registers_[GetBatchTempRegisterIndex(0, dest, false)];
+        for (uint32_t i = 0; i < 4; ++i) {
+          if (write_mask & (UINT32_C(1) << i)) {
+            BatchStore(dest_register[i],
+                       BatchSelect(lane_mask_vector, BatchLoad(result[i]),
+                                   BatchLoad(dest_register[i])));
+          }
+        }
+        return;
+      }
+      uint32_t lanes_remaining = lane_mask;
+      uint32_t lane;
+      while (xe::bit_scan_forward(lanes_remaining, &lane)) {
+        lanes_remaining &= ~(UINT32_C(1) << lane);
+        float(*dest_register)[kBatchSize] =
+            batch_temp_registers_[GetBatchTempRegisterIndex(lane, dest, true)];
+        for (uint32_t i = 0; i < 4; ++i) {
+          if (write_mask & (UINT32_C(1) << i)) {
+            dest_register[i][lane] = result[i][lane];
+          }
+        }
+      }
+    };
+    if (vector_result_write_mask) {
+      const float* vector_result_components[] = {
+          vector_result[0], vector_result[1], vector_result[2],
+          vector_result[3]};
+      store_result(instr.vector_dest(), instr.is_vector_dest_relative(),
+                   vector_result_write_mask, vector_result_components);
+    }
+    if (scalar_result_write_mask) {
+      const float* scalar_result_components[] = {scalar_result, scalar_result,
+                                                 scalar_result, scalar_result};
+      store_result(instr.scalar_dest(), instr.is_scalar_dest_relative(),
+                   scalar_result_write_mask, scalar_result_components);
+    }
+  }
+}
+
+void ShaderInterpreter::ExecuteBatchVertexFetchInstruction(
+    ucode::VertexFetchInstruction instr, uint32_t lane_mask) {
+  uint32_t lanes_remaining = lane_mask;
+  uint32_t lane;
+  while (xe::bit_scan_forward(lanes_remaining, &lane)) {
+    lanes_remaining &= ~(UINT32_C(1) << lane);
+    float index_operand = 0.0f;
+    if (!instr.is_mini_fetch()) {
+      index_operand = batch_temp_registers_[GetBatchTempRegisterIndex(
+          lane, instr.src(), instr.is_src_relative())][instr.src_swizzle()]
+                                           [lane];
+    }
+    float result[4];
+    FetchVertex(batch_state_.lanes[lane], instr, index_operand, result);
+    StoreFetchResult(
+        &batch_temp_registers_[GetBatchTempRegisterIndex(
+            lane, instr.dest(), instr.is_dest_relative())][0][lane],
+        kBatchSize, instr.dest_swizzle(), result);
+  }
 }
 
 }  // namespace gpu
@@ -25,15 +25,26 @@ namespace gpu {
 
 class ShaderInterpreter {
  public:
+  // Number of invocations executed at once by ExecuteBatch, one per lane of
+  // the vectors.
+  static constexpr uint32_t kBatchSize = 8;
+
   ShaderInterpreter(const RegisterFile& register_file, const Memory& memory)
       : register_file_(register_file), memory_(memory) {}
 
   class ExportSink {
    public:
     virtual ~ExportSink() = default;
+    // In ExecuteBatch, called once for all the lanes reaching the alloc
+    // together.
     virtual void AllocExport(ucode::AllocType type, uint32_t size) {}
     virtual void Export(ucode::ExportRegister export_register,
                         const float* value, uint32_t value_mask) {}
+    // Export from ExecuteBatch, with kBatchSize values of each component in
+    // value, for the lanes in lane_mask.
+    virtual void ExportBatch(ucode::ExportRegister export_register,
+                             const float* value, uint32_t value_mask,
+                             uint32_t lane_mask) {}
   };
 
   void SetTraceWriter(TraceWriter* new_trace_writer) {
@@ -48,6 +59,13 @@ class ShaderInterpreter {
   const float* temp_registers() const { return &temp_registers_[0][0]; }
   float* temp_registers() { return &temp_registers_[0][0]; }
 
+  // Structure of arrays - kBatchSize values of each component of each
+  // register.
+  const float* batch_temp_registers() const {
+    return &batch_temp_registers_[0][0][0];
+  }
+  float* batch_temp_registers() { return &batch_temp_registers_[0][0][0]; }
+
   static bool CanInterpretShader(const Shader& shader) {
     assert_true(shader.is_ucode_analyzed());
     // Texture instructions are not very common in vertex shaders (and not used
@@ -68,6 +86,12 @@ class ShaderInterpreter {
   }
 
   void Execute();
+  // Executes the shader for the first lane_count lanes of the batch temporary
+  // registers, with the same results as Execute for each lane. Lanes on the
+  // same control flow path are processed together using vector instructions,
+  // lanes diverging on predicated branches or loops are scheduled separately
+  // until they reconverge.
+  void ExecuteBatch(uint32_t lane_count = kBatchSize);
 
  private:
   struct State {
@@ -102,6 +126,23 @@ class ShaderInterpreter {
     }
   };
 
+  struct BatchState {
+    // Control flow and vertex fetch state of each lane. previous_scalar is
+    // stored in the structure of arrays instead.
+    State lanes[kBatchSize];
+    alignas(32) float previous_scalar[kBatchSize];
+
+    void Reset() { std::memset(this, 0, sizeof(*this)); }
+
+    uint32_t GetPredicateMask() const {
+      uint32_t predicate_mask = 0;
+      for (uint32_t i = 0; i < kBatchSize; ++i) {
+        predicate_mask |= uint32_t(lanes[i].predicate) << i;
+      }
+      return predicate_mask;
+    }
+  };
+
   static float FlushDenormal(float value) {
     uint32_t bits = *reinterpret_cast<const uint32_t*>(&value);
     bits &= (bits & UINT32_C(0x7F800000)) ? ~UINT32_C(0) : (UINT32_C(1) << 31);
@@ -118,14 +159,52 @@ class ShaderInterpreter {
   float* GetTempRegister(uint32_t address, bool is_relative) {
     return temp_registers_[GetTempRegisterIndex(address, is_relative)];
   }
+  uint32_t GetBatchTempRegisterIndex(uint32_t lane, uint32_t address,
+                                     bool is_relative) const {
+    return (int32_t(address) +
+            (is_relative ? batch_state_.lanes[lane].GetLoopAddress() : 0)) &
+           ((UINT32_C(1) << xenos::kMaxShaderTempRegistersLog2) - 1);
+  }
   const std::array<float, 4> GetFloatConstant(
-      uint32_t address, bool is_relative, bool relative_address_is_a0) const;
+      const State& state, uint32_t address, bool is_relative,
+      bool relative_address_is_a0) const;
+  bool GetBoolConstant(uint32_t bool_address) const {
+    return (register_file_[XE_GPU_REG_SHADER_CONSTANT_BOOL_000_031 +
+                           (bool_address >> 5)] &
+            (UINT32_C(1) << (bool_address & 31))) != 0;
+  }
+
+  ucode::ControlFlowInstruction GetControlFlowInstruction(
+      uint32_t cf_index) const;
+  // Executes loop, call, return and jump control flow instructions, returning
+  // the index of the next control flow instruction.
+  uint32_t ExecuteControlFlowBranch(State& state,
+                                    ucode::ControlFlowInstruction cf_instr,
+                                    uint32_t cf_index) const;
+
+  static void CalculateCube(const float* operand, float* result);
+  static float CalculateMax4(const float* operand);
 
   void ExecuteAluInstruction(ucode::AluInstruction instr);
-  void StoreFetchResult(uint32_t dest, bool is_dest_relative, uint32_t swizzle,
-                        const float* value);
+  // dest_component_stride is the distance between components in floats.
+  static void StoreFetchResult(float* dest, uint32_t dest_component_stride,
+                               uint32_t swizzle, const float* value);
+  // Updates the vertex fetch state and loads the data of the vertex.
+  void FetchVertex(State& state, ucode::VertexFetchInstruction instr,
+                   float index_operand, float* result) const;
   void ExecuteVertexFetchInstruction(ucode::VertexFetchInstruction instr);
 
+  // Returns the 4 components, kBatchSize lanes each, of the operand without
+  // modifiers, either in the temporary registers or gathered into buffer (for
+  // the lanes in lane_mask, zeros in others).
+  const float* GetBatchAluSource(ucode::AluInstruction instr,
+                                 uint32_t operand_index, uint32_t lane_mask,
+                                 float* buffer) const;
+  void ExecuteBatchAluInstruction(ucode::AluInstruction instr,
+                                  uint32_t lane_mask);
+  void ExecuteBatchVertexFetchInstruction(ucode::VertexFetchInstruction instr,
+                                          uint32_t lane_mask);
+
   const RegisterFile& register_file_;
   const Memory& memory_;
 
@@ -140,6 +219,11 @@ class ShaderInterpreter {
   float temp_registers_[xenos::kMaxShaderTempRegisters][4];
 
   State state_;
+
+  alignas(32) float batch_temp_registers_[xenos::kMaxShaderTempRegisters][4]
+                                         [kBatchSize];
+
+  BatchState batch_state_;
 };
 
 }  // namespace gpu
@@ -0,0 +1,1418 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/shader_jit.h"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include "xenia/base/assert.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/math.h"
+#include "xenia/base/memory.h"
+#include "xenia/base/platform.h"
+#include "xenia/gpu/registers.h"
+#include "xenia/gpu/xenos.h"
+
+#if XE_GPU_SHADER_JIT
+#define XBYAK_NO_OP_NAMES
+#include "third_party/xbyak/xbyak/xbyak.h"
+#endif  // XE_GPU_SHADER_JIT
+
+namespace xe {
+namespace gpu {
+
+namespace {
+
+// Values loaded by broadcasting from the beginning of the constant buffer.
+enum SpecialConstant : uint32_t {
+  kSpecialConstantSignMask,
+  kSpecialConstantAbsMask,
+  kSpecialConstantExponentMask,
+  kSpecialConstantOne,
+  kSpecialConstantInfinity,
+  kSpecialConstantFltMax,
+
+  kSpecialConstantCount,
+};
+
+constexpr uint32_t kNoSlot = UINT32_MAX;
+
+// ExportComponent to the export register and its component.
+constexpr ucode::ExportRegister
+    kExportComponentRegisters[ShaderJit::kExportComponentCount] = {
+        ucode::ExportRegister::kVSPosition,
+        ucode::ExportRegister::kVSPosition,
+        ucode::ExportRegister::kVSPointSizeEdgeFlagKillVertex,
+        ucode::ExportRegister::kVSPointSizeEdgeFlagKillVertex,
+};
+constexpr uint32_t
+    kExportComponentRegisterComponents[ShaderJit::kExportComponentCount] = {
+        1, 3, 0, 2};
+
+// Same as in the ShaderInterpreter.
+float FlushDenormal(float value) {
+  uint32_t bits = xe::memory::Reinterpret<uint32_t>(value);
+  bits &= (bits & UINT32_C(0x7F800000)) ? ~UINT32_C(0) : (UINT32_C(1) << 31);
+  return xe::memory::Reinterpret<float>(bits);
+}
+
+bool IsVertexFormatSupported(xenos::VertexFormat format) {
+  switch (format) {
+    case xenos::VertexFormat::k_16_16_FLOAT:
+    case xenos::VertexFormat::k_16_16_16_16_FLOAT:
+    case xenos::VertexFormat::k_32_FLOAT:
+    case xenos::VertexFormat::k_32_32_FLOAT:
+    case xenos::VertexFormat::k_32_32_32_FLOAT:
+    case xenos::VertexFormat::k_32_32_32_32_FLOAT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool IsAluVectorOpcodeSupported(ucode::AluVectorOpcode opcode) {
+  switch (opcode) {
+    case ucode::AluVectorOpcode::kAdd:
+    case ucode::AluVectorOpcode::kMul:
+    case ucode::AluVectorOpcode::kMax:
+    case ucode::AluVectorOpcode::kMin:
+    case ucode::AluVectorOpcode::kSeq:
+    case ucode::AluVectorOpcode::kSgt:
+    case ucode::AluVectorOpcode::kSge:
+    case ucode::AluVectorOpcode::kSne:
+    case ucode::AluVectorOpcode::kFrc:
+    case ucode::AluVectorOpcode::kTrunc:
+    case ucode::AluVectorOpcode::kFloor:
+    case ucode::AluVectorOpcode::kMad:
+    case ucode::AluVectorOpcode::kCndEq:
+    case ucode::AluVectorOpcode::kCndGe:
+    case ucode::AluVectorOpcode::kCndGt:
+    case ucode::AluVectorOpcode::kDp4:
+    case ucode::AluVectorOpcode::kDp3:
+    case ucode::AluVectorOpcode::kDp2Add:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool IsAluScalarOpcodeSupported(ucode::AluScalarOpcode opcode) {
+  switch (opcode) {
+    case ucode::AluScalarOpcode::kAdds:
+    case ucode::AluScalarOpcode::kAddsPrev:
+    case ucode::AluScalarOpcode::kMuls:
+    case ucode::AluScalarOpcode::kMulsPrev:
+    case ucode::AluScalarOpcode::kMaxs:
+    case ucode::AluScalarOpcode::kMins:
+    case ucode::AluScalarOpcode::kSeqs:
+    case ucode::AluScalarOpcode::kSgts:
+    case ucode::AluScalarOpcode::kSges:
+    case ucode::AluScalarOpcode::kSnes:
+    case ucode::AluScalarOpcode::kFrcs:
+    case ucode::AluScalarOpcode::kTruncs:
+    case ucode::AluScalarOpcode::kFloors:
+    case ucode::AluScalarOpcode::kRcpc:
+    case ucode::AluScalarOpcode::kRcpf:
+    case ucode::AluScalarOpcode::kRcp:
+    case ucode::AluScalarOpcode::kRsqc:
+    case ucode::AluScalarOpcode::kRsqf:
+    case ucode::AluScalarOpcode::kRsq:
+    case ucode::AluScalarOpcode::kSubs:
+    case ucode::AluScalarOpcode::kSubsPrev:
+    case ucode::AluScalarOpcode::kSqrt:
+    case ucode::AluScalarOpcode::kMulsc0:
+    case ucode::AluScalarOpcode::kMulsc1:
+    case ucode::AluScalarOpcode::kAddsc0:
+    case ucode::AluScalarOpcode::kAddsc1:
+    case ucode::AluScalarOpcode::kSubsc0:
+    case ucode::AluScalarOpcode::kSubsc1:
+    case ucode::AluScalarOpcode::kRetainPrev:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool DoesAluScalarOpcodeReadPrevious(ucode::AluScalarOpcode opcode) {
+  switch (opcode) {
+    case ucode::AluScalarOpcode::kAddsPrev:
+    case ucode::AluScalarOpcode::kMulsPrev:
+    case ucode::AluScalarOpcode::kMulsPrev2:
+    case ucode::AluScalarOpcode::kSubsPrev:
+    case ucode::AluScalarOpcode::kRetainPrev:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// An instruction of the shader with the control flow resolved.
+struct LinearInstruction {
+  uint32_t dwords[3];
+  bool is_fetch;
+  // For vertex fetches, the vfetch_full providing the address and the fetch
+  // constant, and whether its index was not overwritten before it (in this
+  // case, it's the vertex index as provided in r0.x, and the fetch can be
+  // done before the shader).
+  ucode::VertexFetchInstruction vfetch_full;
+  bool vfetch_full_index_is_vertex_index;
+  // Results of the liveness analysis.
+  // Components of the vector operation result (or the fetch) that are used.
+  uint32_t vector_result_mask;
+  // Components of the scalar operation result written to a temporary register
+  // that are used, and whether the scalar operation needs to be executed at
+  // all (if previous_scalar is needed later, for instance).
+  uint32_t scalar_result_mask;
+  bool scalar_needed;
+  // ExportComponent bits for which this instruction is the last export.
+  uint32_t export_components;
+
+  const ucode::AluInstruction& alu() const {
+    return *reinterpret_cast<const ucode::AluInstruction*>(dwords);
+  }
+  const ucode::FetchInstruction& fetch() const {
+    return *reinterpret_cast<const ucode::FetchInstruction*>(dwords);
+  }
+};
+
+}  // namespace
+
+class ShaderJit::CompiledShader {
+ public:
+  using Function = void (*)(float* registers, const float* constants);
+
+  struct VertexFetch {
+    ucode::VertexFetchInstruction instruction;
+    uint32_t fetch_constant_index;
+    uint32_t stride;
+    uint32_t needed_dwords;
+  };
+
+  bool Compile(const Shader& shader, const uint32_t* bool_constants);
+
+  bool AreBoolConstantConditionsMet(const uint32_t* bool_constants) const {
+    for (const std::pair<uint32_t, bool>& condition :
+         bool_constant_conditions_) {
+      if (((bool_constants[condition.first >> 5] >> (condition.first & 31)) &
+           1) != uint32_t(condition.second)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  Function function() const { return function_; }
+  uint32_t export_mask() const { return export_mask_; }
+  const std::vector<uint32_t>& float_constants() const {
+    return float_constants_;
+  }
+  const std::vector<VertexFetch>& vertex_fetches() const {
+    return vertex_fetches_;
+  }
+
+  // Layout of the registers, in kVertexBatchSize-float vectors.
+  uint32_t register_vector_count() const {
+    return fetch_vector_base_ +
+           4 * uint32_t(vertex_fetches_.size());
+  }
+  uint32_t temp_vector(uint32_t slot, uint32_t component) const {
+    return slot * 4 + component;
+  }
+  uint32_t previous_scalar_vector() const { return temp_slot_count_ * 4; }
+  uint32_t vector_result_vector(uint32_t component) const {
+    return temp_slot_count_ * 4 + 1 + component;
+  }
+  uint32_t export_vector(uint32_t export_component) const {
+    return temp_slot_count_ * 4 + 5 + export_component;
+  }
+  uint32_t fetch_vector(uint32_t fetch_index, uint32_t component) const {
+    return fetch_vector_base_ + fetch_index * 4 + component;
+  }
+
+ private:
+  bool Linearize(const Shader& shader, const uint32_t* bool_constants,
+                 std::vector<LinearInstruction>& instructions);
+  void AnalyzeLiveness(std::vector<LinearInstruction>& instructions);
+  bool AllocateSlots(const std::vector<LinearInstruction>& instructions);
+
+  std::vector<std::pair<uint32_t, bool>> bool_constant_conditions_;
+  uint32_t export_mask_ = 0;
+  // Temporary register to its slot in the register vectors, r0 is always in
+  // slot 0 as it contains the vertex index.
+  std::array<uint32_t, xenos::kMaxShaderTempRegisters> temp_slots_;
+  uint32_t temp_slot_count_ = 0;
+  // Float constant register indices, relative to SQ_VS_CONST base.
+  std::vector<uint32_t> float_constants_;
+  std::array<uint32_t, 256> float_constant_slots_;
+  std::vector<VertexFetch> vertex_fetches_;
+  uint32_t fetch_vector_base_ = 0;
+
+#if XE_GPU_SHADER_JIT
+  class CodeGenerator;
+  std::unique_ptr<CodeGenerator> code_generator_;
+#endif  // XE_GPU_SHADER_JIT
+  Function function_ = nullptr;
+};
+
+bool ShaderJit::CompiledShader::Linearize(
+    const Shader& shader, const uint32_t* bool_constants,
+    std::vector<LinearInstruction>& instructions) {
+  const uint32_t* ucode = shader.ucode_dwords();
+  uint32_t ucode_instruction_count = uint32_t(shader.ucode_dword_count() / 3);
+  uint32_t cf_index_bound = shader.cf_pair_index_bound() * 2;
+  ucode::VertexFetchInstruction vfetch_full_last = {};
+  bool vfetch_full_seen = false;
+  bool vfetch_full_last_index_is_vertex_index = false;
+  bool r0_x_written = false;
+  for (uint32_t cf_index = 0; cf_index < cf_index_bound; ++cf_index) {
+    const uint32_t* cf_pair = &ucode[3 * (cf_index >> 1)];
+    ucode::ControlFlowInstruction cf_instr;
+    if (cf_index & 1) {
+      cf_instr.dword_0 = (cf_pair[1] >> 16) | (cf_pair[2] << 16);
+      cf_instr.dword_1 = cf_pair[2] >> 16;
+    } else {
+      cf_instr.dword_0 = cf_pair[0];
+      cf_instr.dword_1 = cf_pair[1] & 0xFFFF;
+    }
+
+    ucode::ControlFlowOpcode cf_opcode = cf_instr.opcode();
+    switch (cf_opcode) {
+      case ucode::ControlFlowOpcode::kNop:
+      case ucode::ControlFlowOpcode::kAlloc:
+      case ucode::ControlFlowOpcode::kMarkVsFetchDone:
+        continue;
+      case ucode::ControlFlowOpcode::kExec:
+      case ucode::ControlFlowOpcode::kExecEnd:
+        break;
+      case ucode::ControlFlowOpcode::kCondExec:
+      case ucode::ControlFlowOpcode::kCondExecEnd:
+      case ucode::ControlFlowOpcode::kCondExecPredClean:
+      case ucode::ControlFlowOpcode::kCondExecPredCleanEnd: {
+        // Same for all vertices, resolved at compile time.
+        const ucode::ControlFlowCondExecInstruction& cf_cond_exec =
+            *reinterpret_cast<const ucode::ControlFlowCondExecInstruction*>(
+                &cf_instr);
+        uint32_t bool_address = cf_cond_exec.bool_address();
+        bool bool_value = ((bool_constants[bool_address >> 5] >>
+                            (bool_address & 31)) &
+                           1) != 0;
+        bool_constant_conditions_.emplace_back(bool_address, bool_value);
+        if (cf_cond_exec.condition() != bool_value) {
+          continue;
+        }
+      } break;
+      default:
+        // Predicated execs, loops, calls and jumps.
+        return false;
+    }
+
+    const ucode::ControlFlowExecInstruction& cf_exec =
+        *reinterpret_cast<const ucode::ControlFlowExecInstruction*>(&cf_instr);
+    if (cf_exec.address() + cf_exec.count() > ucode_instruction_count) {
+      return false;
+    }
+    for (uint32_t exec_index = 0; exec_index < cf_exec.count(); ++exec_index) {
+      LinearInstruction& instruction = instructions.emplace_back();
+      std::memcpy(instruction.dwords,
+                  &ucode[3 * (cf_exec.address() + exec_index)],
+                  sizeof(instruction.dwords));
+      instruction.is_fetch = ((cf_exec.sequence() >> (exec_index << 1)) & 1);
+      instruction.vector_result_mask = 0;
+      instruction.scalar_result_mask = 0;
+      instruction.scalar_needed = false;
+      instruction.export_components = 0;
+      instruction.vfetch_full_index_is_vertex_index = false;
+      if (instruction.is_fetch) {
+        const ucode::FetchInstruction& fetch_instr = instruction.fetch();
+        // Not supporting texture fetching, as well as vertex-dependent
+        // predication and relative addressing.
+        if (fetch_instr.opcode() != ucode::FetchOpcode::kVertexFetch ||
+            fetch_instr.is_predicated() || fetch_instr.is_dest_relative()) {
+          return false;
+        }
+        const ucode::VertexFetchInstruction& vfetch_instr =
+            fetch_instr.vertex_fetch();
+        if (!vfetch_instr.is_mini_fetch()) {
+          vfetch_full_last = vfetch_instr;
+          vfetch_full_seen = true;
+          vfetch_full_last_index_is_vertex_index =
+              !vfetch_instr.is_src_relative() && !vfetch_instr.src() &&
+              !vfetch_instr.src_swizzle() && !r0_x_written;
+        } else if (!vfetch_full_seen) {
+          return false;
+        }
+        instruction.vfetch_full = vfetch_full_last;
+        instruction.vfetch_full_index_is_vertex_index =
+            vfetch_full_last_index_is_vertex_index;
+        if (!vfetch_instr.dest() &&
+            ucode::GetFetchDestinationComponentSwizzle(
+                vfetch_instr.dest_swizzle(), 0) !=
+                ucode::FetchDestinationSwizzle::kKeep) {
+          r0_x_written = true;
+        }
+      } else {
+        const ucode::AluInstruction& alu_instr = instruction.alu();
+        if (alu_instr.is_predicated()) {
+          return false;
+        }
+        if (alu_instr.is_export()) {
+          if (alu_instr.is_vector_dest_relative()) {
+            return false;
+          }
+        } else {
+          // Relative writes may overwrite any register.
+          if ((alu_instr.vector_write_mask() &&
+               alu_instr.is_vector_dest_relative()) ||
+              (alu_instr.scalar_write_mask() &&
+               alu_instr.is_scalar_dest_relative())) {
+            return false;
+          }
+          if ((!alu_instr.vector_dest() &&
+               (alu_instr.GetVectorOpResultWriteMask() & 0b0001)) ||
+              (!alu_instr.scalar_dest() &&
+               (alu_instr.GetScalarOpResultWriteMask() & 0b0001))) {
+            r0_x_written = true;
+          }
+        }
+      }
+    }
+
+    if (ucode::DoesControlFlowOpcodeEndShader(cf_opcode)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void ShaderJit::CompiledShader::AnalyzeLiveness(
+    std::vector<LinearInstruction>& instructions) {
+  std::array<uint8_t, xenos::kMaxShaderTempRegisters> temps_live = {};
+  bool previous_scalar_live = false;
+  uint32_t exports_pending = (UINT32_C(1) << kExportComponentCount) - 1;
+  for (auto it = instructions.rbegin(); it != instructions.rend(); ++it) {
+    LinearInstruction& instruction = *it;
+
+    if (instruction.is_fetch) {
+      const ucode::VertexFetchInstruction& vfetch_instr =
+          instruction.fetch().vertex_fetch();
+      uint32_t written_mask = 0;
+      for (uint32_t i = 0; i < 4; ++i) {
+        if (ucode::GetFetchDestinationComponentSwizzle(
+                vfetch_instr.dest_swizzle(), i) !=
+            ucode::FetchDestinationSwizzle::kKeep) {
+          written_mask |= UINT32_C(1) << i;
+        }
+      }
+      uint8_t& dest_live = temps_live[vfetch_instr.dest()];
+      instruction.vector_result_mask = written_mask & dest_live;
+      dest_live &= ~written_mask;
+      continue;
+    }
+
+    const ucode::AluInstruction& alu_instr = instruction.alu();
+    ucode::AluVectorOpcode vector_opcode = alu_instr.vector_opcode();
+    ucode::AluScalarOpcode scalar_opcode = alu_instr.scalar_opcode();
+    uint32_t vector_write_mask = alu_instr.GetVectorOpResultWriteMask();
+    uint32_t scalar_write_mask = alu_instr.GetScalarOpResultWriteMask();
+
+    // Which results are needed.
+    if (alu_instr.is_export()) {
+      uint32_t export_write_mask = vector_write_mask | scalar_write_mask |
+                                   alu_instr.GetConstant0WriteMask() |
+                                   alu_instr.GetConstant1WriteMask();
+      for (uint32_t i = 0; i < kExportComponentCount; ++i) {
+        uint32_t component_bit = UINT32_C(1)
+                                 << kExportComponentRegisterComponents[i];
+        if (!(exports_pending & (UINT32_C(1) << i)) ||
+            ucode::ExportRegister(alu_instr.vector_dest()) !=
+                kExportComponentRegisters[i] ||
+            !(export_write_mask & component_bit)) {
+          continue;
+        }
+        exports_pending &= ~(UINT32_C(1) << i);
+        instruction.export_components |= UINT32_C(1) << i;
+        if (vector_write_mask & component_bit) {
+          instruction.vector_result_mask |= component_bit;
+        } else if (scalar_write_mask & component_bit) {
+          instruction.scalar_needed = true;
+        }
+      }
+    } else {
+      uint8_t& scalar_dest_live = temps_live[alu_instr.scalar_dest()];
+      instruction.scalar_result_mask = scalar_write_mask & scalar_dest_live;
+      scalar_dest_live &= ~scalar_write_mask;
+      uint8_t& vector_dest_live = temps_live[alu_instr.vector_dest()];
+      instruction.vector_result_mask = vector_write_mask & vector_dest_live;
+      vector_dest_live &= ~vector_write_mask;
+      if (instruction.scalar_result_mask) {
+        instruction.scalar_needed = true;
+      }
+    }
+    if (scalar_opcode != ucode::AluScalarOpcode::kRetainPrev) {
+      if (previous_scalar_live) {
+        instruction.scalar_needed = true;
+      }
+      previous_scalar_live = false;
+    }
+
+    // Which sources are needed.
+    if (instruction.vector_result_mask) {
+      for (uint32_t i = 1; i <= 3; ++i) {
+        uint32_t needed_components =
+            ucode::GetAluVectorOpNeededSourceComponents(
+                vector_opcode, i, instruction.vector_result_mask);
+        if (!needed_components || !alu_instr.src_is_temp(i)) {
+          continue;
+        }
+        uint32_t src_reg = alu_instr.src_reg(i);
+        uint32_t swizzle = alu_instr.src_swizzle(i);
+        uint8_t& src_live =
+            temps_live[ucode::AluInstruction::src_temp_reg(src_reg)];
+        for (uint32_t j = 0; j < 4; ++j) {
+          if (needed_components & (UINT32_C(1) << j)) {
+            src_live |= uint8_t(
+                1 << ucode::AluInstruction::GetSwizzledComponentIndex(swizzle,
+                                                                       j));
+          }
+        }
+      }
+    }
+    if (instruction.scalar_needed) {
+      if (DoesAluScalarOpcodeReadPrevious(scalar_opcode)) {
+        previous_scalar_live = true;
+      }
+      const ucode::AluScalarOpcodeInfo& scalar_opcode_info =
+          ucode::GetAluScalarOpcodeInfo(scalar_opcode);
+      uint32_t swizzle = alu_instr.src_swizzle(3);
+      if (scalar_opcode_info.operand_count == 1 && alu_instr.src_is_temp(3)) {
+        uint8_t& src_live = temps_live[ucode::AluInstruction::src_temp_reg(
+            alu_instr.src_reg(3))];
+        src_live |= uint8_t(
+            1 << ucode::AluInstruction::GetSwizzledComponentIndex(swizzle, 3));
+        if (scalar_opcode_info.single_operand_is_two_component) {
+          src_live |= uint8_t(
+              1 << ucode::AluInstruction::GetSwizzledComponentIndex(swizzle,
+                                                                     0));
+        }
+      } else if (scalar_opcode_info.operand_count == 2) {
+        temps_live[alu_instr.scalar_const_reg_op_src_temp_reg()] |= uint8_t(
+            1 << ucode::AluInstruction::GetSwizzledComponentIndex(swizzle, 0));
+      }
+    }
+  }
+  export_mask_ =
+      ((UINT32_C(1) << kExportComponentCount) - 1) & ~exports_pending;
+}
+
+bool ShaderJit::CompiledShader::AllocateSlots(
+    const std::vector<LinearInstruction>& instructions) {
+  temp_slots_.fill(kNoSlot);
+  // The vertex index is written to r0.x.
+  temp_slots_[0] = 0;
+  temp_slot_count_ = 1;
+  auto use_temp = [this](uint32_t temp) {
+    uint32_t& slot = temp_slots_[temp];
+    if (slot == kNoSlot) {
+      slot = temp_slot_count_++;
+    }
+  };
+  float_constant_slots_.fill(kNoSlot);
+  auto use_float_constant = [this](uint32_t constant) {
+    uint32_t& slot = float_constant_slots_[constant];
+    if (slot == kNoSlot) {
+      slot = uint32_t(float_constants_.size());
+      float_constants_.push_back(constant);
+    }
+  };
+
+  for (const LinearInstruction& instruction : instructions) {
+    if (instruction.is_fetch) {
+      if (!instruction.vector_result_mask) {
+        continue;
+      }
+      const ucode::VertexFetchInstruction& vfetch_instr =
+          instruction.fetch().vertex_fetch();
+      if (!instruction.vfetch_full_index_is_vertex_index) {
+        return false;
+      }
+      if (!IsVertexFormatSupported(vfetch_instr.data_format())) {
+        return false;
+      }
+      use_temp(vfetch_instr.dest());
+      continue;
+    }
+
+    const ucode::AluInstruction& alu_instr = instruction.alu();
+    if (instruction.vector_result_mask) {
+      ucode::AluVectorOpcode vector_opcode = alu_instr.vector_opcode();
+      if (!IsAluVectorOpcodeSupported(vector_opcode)) {
+        return false;
+      }
+      for (uint32_t i = 1; i <= 3; ++i) {
+        if (!ucode::GetAluVectorOpNeededSourceComponents(
+                vector_opcode, i, instruction.vector_result_mask)) {
+          continue;
+        }
+        uint32_t src_reg = alu_instr.src_reg(i);
+        if (alu_instr.src_is_temp(i)) {
+          if (ucode::AluInstruction::is_src_temp_relative(src_reg)) {
+            return false;
+          }
+          use_temp(ucode::AluInstruction::src_temp_reg(src_reg));
+        } else {
+          if (alu_instr.src_const_is_addressed(i)) {
+            return false;
+          }
+          use_float_constant(src_reg);
+        }
+      }
+      if (!alu_instr.is_export()) {
+        use_temp(alu_instr.vector_dest());
+      }
+    }
+    if (instruction.scalar_needed) {
+      ucode::AluScalarOpcode scalar_opcode = alu_instr.scalar_opcode();
+      if (!IsAluScalarOpcodeSupported(scalar_opcode)) {
+        return false;
+      }
+      const ucode::AluScalarOpcodeInfo& scalar_opcode_info =
+          ucode::GetAluScalarOpcodeInfo(scalar_opcode);
+      uint32_t src_reg = alu_instr.src_reg(3);
+      if (scalar_opcode_info.operand_count == 1) {
+        if (alu_instr.src_is_temp(3)) {
+          if (ucode::AluInstruction::is_src_temp_relative(src_reg)) {
+            return false;
+          }
+          use_temp(ucode::AluInstruction::src_temp_reg(src_reg));
+        } else {
+          if (alu_instr.src_const_is_addressed(3)) {
+            return false;
+          }
+          use_float_constant(src_reg);
+        }
+      } else if (scalar_opcode_info.operand_count == 2) {
+        if (alu_instr.src_const_is_addressed(3)) {
+          return false;
+        }
+        use_float_constant(src_reg);
+        use_temp(alu_instr.scalar_const_reg_op_src_temp_reg());
+      }
+      if (instruction.scalar_result_mask) {
+        use_temp(alu_instr.scalar_dest());
+      }
+    }
+  }
+  return true;
+}
+
+#if XE_GPU_SHADER_JIT
+
+class ShaderJit::CompiledShader::CodeGenerator : public Xbyak::CodeGenerator {
+ public:
+  CodeGenerator(const CompiledShader& compiled_shader, size_t max_size)
+      : Xbyak::CodeGenerator(max_size), compiled_shader_(compiled_shader) {}
+
+  void EmitShader(const std::vector<LinearInstruction>& instructions);
+
+ private:
+  // vcmpps predicates.
+  static constexpr uint8_t kCmpEqOq = 0x00;
+  static constexpr uint8_t kCmpNeqUq = 0x04;
+  static constexpr uint8_t kCmpNeqOq = 0x0C;
+  static constexpr uint8_t kCmpGeOq = 0x1D;
+  static constexpr uint8_t kCmpGtOq = 0x1E;
+  // vroundps modes, with the precision exception suppressed.
+  static constexpr uint8_t kRoundFloor = 0b1001;
+  static constexpr uint8_t kRoundTrunc = 0b1011;
+
+  struct SourceOperand {
+    bool is_temp;
+    // Temporary register slot or float constant slot.
+    uint32_t slot;
+    uint32_t swizzle;
+    bool absolute;
+    bool negate;
+  };
+
+  Xbyak::Address RegisterVector(uint32_t vector) {
+    return yword[reg_registers_ +
+                 vector * uint32_t(sizeof(float) * kVertexBatchSize)];
+  }
+  Xbyak::Address SpecialConstantAddress(SpecialConstant constant) {
+    return dword[reg_constants_ + uint32_t(sizeof(float)) * constant];
+  }
+  Xbyak::Address FloatConstantAddress(uint32_t slot, uint32_t component) {
+    return dword[reg_constants_ +
+                 uint32_t(sizeof(float)) *
+                     (kSpecialConstantCount + slot * 4 + component)];
+  }
+
+  SourceOperand GetAluSourceOperand(const ucode::AluInstruction& instr,
+                                    uint32_t src_index) const;
+  // Loads the absolute component of the operand, ymm4 and ymm5 are clobbered.
+  void EmitLoadOperand(const Xbyak::Ymm& dest, const SourceOperand& operand,
+                       uint32_t component);
+  // Direct3D 9 behavior (0 or denormal * anything = +0), ymm4 and ymm5 are
+  // clobbered.
+  void EmitMulD3D9(const Xbyak::Ymm& a_and_result, const Xbyak::Ymm& b);
+  // xe::saturate, ymm4 is clobbered.
+  void EmitSaturate(const Xbyak::Ymm& value);
+  // Replaces infinities in the value with the specified values with the sign
+  // of the infinity - FLT_MAX or 0, for the clamping variants of rcp and rsq.
+  // ymm1, ymm2, ymm4 and ymm5 are clobbered.
+  void EmitReplaceInfinity(const Xbyak::Ymm& value, bool with_flt_max);
+
+  void EmitVertexFetch(const LinearInstruction& instruction,
+                       uint32_t fetch_index);
+  void EmitAluInstruction(const LinearInstruction& instruction);
+  void EmitAluVectorOperation(const LinearInstruction& instruction);
+  void EmitAluScalarOperation(const LinearInstruction& instruction);
+
+  const CompiledShader& compiled_shader_;
+#if XE_PLATFORM_WIN32
+  const Xbyak::Reg64 reg_registers_ = rcx;
+  const Xbyak::Reg64 reg_constants_ = rdx;
+#else
+  const Xbyak::Reg64 reg_registers_ = rdi;
+  const Xbyak::Reg64 reg_constants_ = rsi;
+#endif  // XE_PLATFORM_WIN32
+};
+
+void ShaderJit::CompiledShader::CodeGenerator::EmitShader(
+    const std::vector<LinearInstruction>& instructions) {
+  // Only ymm0-ymm5 are used as xmm6-xmm15 are callee-saved on Windows.
+  // previous_scalar is reset for every vertex in the interpreter.
+  vxorps(ymm0, ymm0, ymm0);
+  vmovups(RegisterVector(compiled_shader_.previous_scalar_vector()), ymm0);
+  uint32_t fetch_index = 0;
+  for (const LinearInstruction& instruction : instructions) {
+    if (instruction.is_fetch) {
+      if (instruction.vector_result_mask) {
+        EmitVertexFetch(instruction, fetch_index++);
+      }
+    } else {
+      EmitAluInstruction(instruction);
+    }
+  }
+  vzeroupper();
+  ret();
+}
+
+ShaderJit::CompiledShader::CodeGenerator::SourceOperand
+ShaderJit::CompiledShader::CodeGenerator::GetAluSourceOperand(
+    const ucode::AluInstruction& instr, uint32_t src_index) const {
+  SourceOperand operand;
+  uint32_t src_reg = instr.src_reg(src_index);
+  operand.is_temp = instr.src_is_temp(src_index);
+  if (operand.is_temp) {
+    operand.slot =
+        compiled_shader_
+            .temp_slots_[ucode::AluInstruction::src_temp_reg(src_reg)];
+    operand.absolute =
+        ucode::AluInstruction::is_src_temp_value_absolute(src_reg);
+  } else {
+    operand.slot = compiled_shader_.float_constant_slots_[src_reg];
+    operand.absolute = false;
+  }
+  operand.swizzle = instr.src_swizzle(src_index);
+  operand.negate = instr.src_negate(src_index);
+  return operand;
+}
+
+void ShaderJit::CompiledShader::CodeGenerator::EmitLoadOperand(
+    const Xbyak::Ymm& dest, const SourceOperand& operand, uint32_t component) {
+  if (operand.is_temp) {
+    vmovups(dest, RegisterVector(
+                      compiled_shader_.temp_vector(operand.slot, component)));
+    // Flush denormals, keeping the sign. Constants are flushed when they're
+    // written to the constant buffer.
+    vbroadcastss(ymm5, SpecialConstantAddress(kSpecialConstantExponentMask));
+    vandps(ymm4, dest, ymm5);
+    vxorps(ymm5, ymm5, ymm5);
+    vcmpps(ymm4, ymm4, ymm5, kCmpNeqOq);
+    vbroadcastss(ymm5, SpecialConstantAddress(kSpecialConstantSignMask));
+    vorps(ymm4, ymm4, ymm5);
+    vandps(dest, dest, ymm4);
+    if (operand.absolute) {
+      vbroadcastss(ymm5, SpecialConstantAddress(kSpecialConstantAbsMask));
+      vandps(dest, dest, ymm5);
+    }
+  } else {
+    vbroadcastss(dest, FloatConstantAddress(operand.slot, component));
+  }
+  if (operand.negate) {
+    vbroadcastss(ymm5, SpecialConstantAddress(kSpecialConstantSignMask));
+    vxorps(dest, dest, ymm5);
+  }
+}
+
+void ShaderJit::CompiledShader::CodeGenerator::EmitMulD3D9(
+    const Xbyak::Ymm& a_and_result, const Xbyak::Ymm& b) {
+  vxorps(ymm5, ymm5, ymm5);
+  vcmpps(ymm4, a_and_result, ymm5, kCmpNeqUq);
+  vcmpps(ymm5, b, ymm5, kCmpNeqUq);
+  vandps(ymm4, ymm4, ymm5);
+  vmulps(a_and_result, a_and_result, b);
+  vandps(a_and_result, a_and_result, ymm4);
+}
+
+void ShaderJit::CompiledShader::CodeGenerator::EmitSaturate(
+    const Xbyak::Ymm& value) {
+  // maxps and minps return the second operand if any is NaN.
+  vxorps(ymm4, ymm4, ymm4);
+  vmaxps(value, value, ymm4);
+  vbroadcastss(ymm4, SpecialConstantAddress(kSpecialConstantOne));
+  vminps(value, value, ymm4);
+}
+
+void ShaderJit::CompiledShader::CodeGenerator::EmitReplaceInfinity(
+    const Xbyak::Ymm& value, bool with_flt_max) {
+  vbroadcastss(ymm5, SpecialConstantAddress(kSpecialConstantAbsMask));
+  vandps(ymm1, value, ymm5);
+  vbroadcastss(ymm5, SpecialConstantAddress(kSpecialConstantInfinity));
+  vcmpps(ymm1, ymm1, ymm5, kCmpEqOq);
+  vbroadcastss(ymm4, SpecialConstantAddress(kSpecialConstantSignMask));
+  vandps(ymm2, value, ymm4);
+  if (with_flt_max) {
+    vbroadcastss(ymm4, SpecialConstantAddress(kSpecialConstantFltMax));
+    vorps(ymm2, ymm2, ymm4);
+  }
+  vblendvps(value, value, ymm2, ymm1);
+}
+
+void ShaderJit::CompiledShader::CodeGenerator::EmitVertexFetch(
+    const LinearInstruction& instruction, uint32_t fetch_index) {
+  const ucode::VertexFetchInstruction& vfetch_instr =
+      instruction.fetch().vertex_fetch();
+  uint32_t dest_slot = compiled_shader_.temp_slots_[vfetch_instr.dest()];
+  for (uint32_t i = 0; i < 4; ++i) {
+    ucode::FetchDestinationSwizzle component_swizzle =
+        ucode::GetFetchDestinationComponentSwizzle(vfetch_instr.dest_swizzle(),
+                                                   i);
+    switch (component_swizzle) {
+      case ucode::FetchDestinationSwizzle::kX:
+      case ucode::FetchDestinationSwizzle::kY:
+      case ucode::FetchDestinationSwizzle::kZ:
+      case ucode::FetchDestinationSwizzle::kW:
+        vmovups(ymm0, RegisterVector(compiled_shader_.fetch_vector(
+                          fetch_index, uint32_t(component_swizzle))));
+        break;
+      case ucode::FetchDestinationSwizzle::k1:
+        vbroadcastss(ymm0, SpecialConstantAddress(kSpecialConstantOne));
+        break;
+      case ucode::FetchDestinationSwizzle::kKeep:
+        continue;
+      default:
+        vxorps(ymm0, ymm0, ymm0);
+        break;
+    }
+    vmovups(RegisterVector(compiled_shader_.temp_vector(dest_slot, i)), ymm0);
+  }
+}
+
+void ShaderJit::CompiledShader::CodeGenerator::EmitAluInstruction(
+    const LinearInstruction& instruction) {
+  const ucode::AluInstruction& instr = instruction.alu();
+  if (instruction.vector_result_mask) {
+    EmitAluVectorOperation(instruction);
+  }
+  if (instruction.scalar_needed) {
+    EmitAluScalarOperation(instruction);
+  }
+
+  // Write the results after both operations have read their operands.
+  if (instr.is_export()) {
+    uint32_t vector_write_mask = instr.GetVectorOpResultWriteMask();
+    uint32_t scalar_write_mask = instr.GetScalarOpResultWriteMask();
+    uint32_t constant_1_write_mask = instr.GetConstant1WriteMask();
+    for (uint32_t i = 0; i < kExportComponentCount; ++i) {
+      if (!(instruction.export_components & (UINT32_C(1) << i))) {
+        continue;
+      }
+      uint32_t component = kExportComponentRegisterComponents[i];
+      uint32_t component_bit = UINT32_C(1) << component;
+      if (vector_write_mask & component_bit) {
+        vmovups(ymm0, RegisterVector(
+                          compiled_shader_.vector_result_vector(component)));
+        if (instr.vector_clamp()) {
+          EmitSaturate(ymm0);
+        }
+      } else if (scalar_write_mask & component_bit) {
+        vmovups(ymm0,
+                RegisterVector(compiled_shader_.previous_scalar_vector()));
+        if (instr.scalar_clamp()) {
+          EmitSaturate(ymm0);
+        }
+      } else if (constant_1_write_mask & component_bit) {
+        vbroadcastss(ymm0, SpecialConstantAddress(kSpecialConstantOne));
+      } else {
+        vxorps(ymm0, ymm0, ymm0);
+      }
+      vmovups(RegisterVector(compiled_shader_.export_vector(i)), ymm0);
+    }
+    return;
+  }
+
+  if (instruction.vector_result_mask) {
+    uint32_t dest_slot = compiled_shader_.temp_slots_[instr.vector_dest()];
+    for (uint32_t i = 0; i < 4; ++i) {
+      if (!(instruction.vector_result_mask & (UINT32_C(1) << i))) {
+        continue;
+      }
+      vmovups(ymm0, RegisterVector(compiled_shader_.vector_result_vector(i)));
+      if (instr.vector_clamp()) {
+        EmitSaturate(ymm0);
+      }
+      vmovups(RegisterVector(compiled_shader_.temp_vector(dest_slot, i)),
+              ymm0);
+    }
+  }
+  if (instruction.scalar_result_mask) {
+    uint32_t dest_slot = compiled_shader_.temp_slots_[instr.scalar_dest()];
+    vmovups(ymm0, RegisterVector(compiled_shader_.previous_scalar_vector()));
+    if (instr.scalar_clamp()) {
+      EmitSaturate(ymm0);
+    }
+    for (uint32_t i = 0; i < 4; ++i) {
+      if (instruction.scalar_result_mask & (UINT32_C(1) << i)) {
+        vmovups(RegisterVector(compiled_shader_.temp_vector(dest_slot, i)),
+                ymm0);
+      }
+    }
+  }
+}
+
+void ShaderJit::CompiledShader::CodeGenerator::EmitAluVectorOperation(
+    const LinearInstruction& instruction) {
+  const ucode::AluInstruction& instr = instruction.alu();
+  ucode::AluVectorOpcode opcode = instr.vector_opcode();
+  SourceOperand operands[3];
+  for (uint32_t i = 0; i < 3; ++i) {
+    operands[i] = GetAluSourceOperand(instr, 1 + i);
+  }
+  auto load_operand = [&](const Xbyak::Ymm& dest, uint32_t operand_index,
+                          uint32_t component) {
+    const SourceOperand& operand = operands[operand_index];
+    EmitLoadOperand(dest, operand,
+                    ucode::AluInstruction::GetSwizzledComponentIndex(
+                        operand.swizzle, component));
+  };
+
+  uint32_t dot_component_count = 0;
+  switch (opcode) {
+    case ucode::AluVectorOpcode::kDp4:
+      dot_component_count = 4;
+      break;
+    case ucode::AluVectorOpcode::kDp3:
+      dot_component_count = 3;
+      break;
+    case ucode::AluVectorOpcode::kDp2Add:
+      dot_component_count = 2;
+      break;
+    default:
+      break;
+  }
+  if (dot_component_count) {
+    // Accumulating from +0 in order, as +0 + -0 must be +0.
+    vxorps(ymm3, ymm3, ymm3);
+    for (uint32_t i = 0; i < dot_component_count; ++i) {
+      load_operand(ymm0, 0, i);
+      load_operand(ymm1, 1, i);
+      EmitMulD3D9(ymm0, ymm1);
+      vaddps(ymm3, ymm3, ymm0);
+    }
+    if (opcode == ucode::AluVectorOpcode::kDp2Add) {
+      load_operand(ymm0, 2, 0);
+      vaddps(ymm3, ymm3, ymm0);
+    }
+    for (uint32_t i = 0; i < 4; ++i) {
+      if (instruction.vector_result_mask & (UINT32_C(1) << i)) {
+        vmovups(RegisterVector(compiled_shader_.vector_result_vector(i)),
+                ymm3);
+      }
+    }
+    return;
+  }
+
+  for (uint32_t i = 0; i < 4; ++i) {
+    if (!(instruction.vector_result_mask & (UINT32_C(1) << i))) {
+      continue;
+    }
+    switch (opcode) {
+      case ucode::AluVectorOpcode::kAdd:
+        load_operand(ymm0, 0, i);
+        load_operand(ymm1, 1, i);
+        vaddps(ymm0, ymm0, ymm1);
+        break;
+      case ucode::AluVectorOpcode::kMul:
+        load_operand(ymm0, 0, i);
+        load_operand(ymm1, 1, i);
+        EmitMulD3D9(ymm0, ymm1);
+        break;
+      case ucode::AluVectorOpcode::kMax:
+        // a >= b ? a : b, unlike maxps returning b if equal.
+        load_operand(ymm0, 0, i);
+        load_operand(ymm1, 1, i);
+        vcmpps(ymm2, ymm0, ymm1, kCmpGeOq);
+        vblendvps(ymm0, ymm1, ymm0, ymm2);
+        break;
+      case ucode::AluVectorOpcode::kMin:
+        // a < b ? a : b, same as minps.
+        load_operand(ymm0, 0, i);
+        load_operand(ymm1, 1, i);
+        vminps(ymm0, ymm0, ymm1);
+        break;
+      case ucode::AluVectorOpcode::kSeq:
+      case ucode::AluVectorOpcode::kSgt:
+      case ucode::AluVectorOpcode::kSge:
+      case ucode::AluVectorOpcode::kSne: {
+        load_operand(ymm0, 0, i);
+        load_operand(ymm1, 1, i);
+        uint8_t predicate;
+        switch (opcode) {
+          case ucode::AluVectorOpcode::kSeq:
+            predicate = kCmpEqOq;
+            break;
+          case ucode::AluVectorOpcode::kSgt:
+            predicate = kCmpGtOq;
+            break;
+          case ucode::AluVectorOpcode::kSge:
+            predicate = kCmpGeOq;
+            break;
+          default:
+            predicate = kCmpNeqUq;
+            break;
+        }
+        vcmpps(ymm0, ymm0, ymm1, predicate);
+        vbroadcastss(ymm1, SpecialConstantAddress(kSpecialConstantOne));
+        vandps(ymm0, ymm0, ymm1);
+      } break;
+      case ucode::AluVectorOpcode::kFrc:
+        load_operand(ymm0, 0, i);
+        vroundps(ymm1, ymm0, kRoundFloor);
+        vsubps(ymm0, ymm0, ymm1);
+        break;
+      case ucode::AluVectorOpcode::kTrunc:
+        load_operand(ymm0, 0, i);
+        vroundps(ymm0, ymm0, kRoundTrunc);
+        break;
+      case ucode::AluVectorOpcode::kFloor:
+        load_operand(ymm0, 0, i);
+        vroundps(ymm0, ymm0, kRoundFloor);
+        break;
+      case ucode::AluVectorOpcode::kMad:
+        load_operand(ymm0, 0, i);
+        load_operand(ymm1, 1, i);
+        EmitMulD3D9(ymm0, ymm1);
+        load_operand(ymm1, 2, i);
+        vaddps(ymm0, ymm0, ymm1);
+        break;
+      case ucode::AluVectorOpcode::kCndEq:
+      case ucode::AluVectorOpcode::kCndGe:
+      case ucode::AluVectorOpcode::kCndGt: {
+        load_operand(ymm0, 0, i);
+        vxorps(ymm3, ymm3, ymm3);
+        vcmpps(ymm3, ymm0, ymm3,
+               opcode == ucode::AluVectorOpcode::kCndEq
+                   ? kCmpEqOq
+                   : (opcode == ucode::AluVectorOpcode::kCndGe ? kCmpGeOq
+                                                               : kCmpGtOq));
+        load_operand(ymm1, 1, i);
+        load_operand(ymm2, 2, i);
+        vblendvps(ymm0, ymm2, ymm1, ymm3);
+      } break;
+      default:
+        // Checked in AllocateSlots.
+        assert_unhandled_case(opcode);
+        vxorps(ymm0, ymm0, ymm0);
+        break;
+    }
+    vmovups(RegisterVector(compiled_shader_.vector_result_vector(i)), ymm0);
+  }
+}
+
+void ShaderJit::CompiledShader::CodeGenerator::EmitAluScalarOperation(
+    const LinearInstruction& instruction) {
+  const ucode::AluInstruction& instr = instruction.alu();
+  ucode::AluScalarOpcode opcode = instr.scalar_opcode();
+  const ucode::AluScalarOpcodeInfo& opcode_info =
+      ucode::GetAluScalarOpcodeInfo(opcode);
+  Xbyak::Address previous_scalar =
+      RegisterVector(compiled_shader_.previous_scalar_vector());
+
+  // Operands to ymm0 and ymm1.
+  uint32_t swizzle = instr.src_swizzle(3);
+  if (opcode_info.operand_count == 1) {
+    // r#/c#.w or r#/c#.wx.
+    SourceOperand operand = GetAluSourceOperand(instr, 3);
+    EmitLoadOperand(
+        ymm0, operand,
+        ucode::AluInstruction::GetSwizzledComponentIndex(swizzle, 3));
+    if (opcode_info.single_operand_is_two_component) {
+      EmitLoadOperand(
+          ymm1, operand,
+          ucode::AluInstruction::GetSwizzledComponentIndex(swizzle, 0));
+    }
+  } else if (opcode_info.operand_count == 2) {
+    // c#.w and r#.x, the absolute flag is not applied.
+    SourceOperand operand;
+    operand.is_temp = false;
+    operand.slot = compiled_shader_.float_constant_slots_[instr.src_reg(3)];
+    operand.swizzle = swizzle;
+    operand.absolute = false;
+    operand.negate = instr.src_negate(3);
+    EmitLoadOperand(
+        ymm0, operand,
+        ucode::AluInstruction::GetSwizzledComponentIndex(swizzle, 3));
+    operand.is_temp = true;
+    operand.slot =
+        compiled_shader_.temp_slots_[instr.scalar_const_reg_op_src_temp_reg()];
+    EmitLoadOperand(
+        ymm1, operand,
+        ucode::AluInstruction::GetSwizzledComponentIndex(swizzle, 0));
+  }
+
+  switch (opcode) {
+    case ucode::AluScalarOpcode::kAdds:
+    case ucode::AluScalarOpcode::kAddsc0:
+    case ucode::AluScalarOpcode::kAddsc1:
+      vaddps(ymm0, ymm0, ymm1);
+      break;
+    case ucode::AluScalarOpcode::kAddsPrev:
+      vaddps(ymm0, ymm0, previous_scalar);
+      break;
+    case ucode::AluScalarOpcode::kMuls:
+    case ucode::AluScalarOpcode::kMulsc0:
+    case ucode::AluScalarOpcode::kMulsc1:
+      EmitMulD3D9(ymm0, ymm1);
+      break;
+    case ucode::AluScalarOpcode::kMulsPrev:
+      vmovups(ymm1, previous_scalar);
+      EmitMulD3D9(ymm0, ymm1);
+      break;
+    case ucode::AluScalarOpcode::kMaxs:
+      vcmpps(ymm2, ymm0, ymm1, kCmpGeOq);
+      vblendvps(ymm0, ymm1, ymm0, ymm2);
+      break;
+    case ucode::AluScalarOpcode::kMins:
+      vminps(ymm0, ymm0, ymm1);
+      break;
+    case ucode::AluScalarOpcode::kSeqs:
+    case ucode::AluScalarOpcode::kSgts:
+    case ucode::AluScalarOpcode::kSges:
+    case ucode::AluScalarOpcode::kSnes: {
+      uint8_t predicate;
+      switch (opcode) {
+        case ucode::AluScalarOpcode::kSeqs:
+          predicate = kCmpEqOq;
+          break;
+        case ucode::AluScalarOpcode::kSgts:
+          predicate = kCmpGtOq;
+          break;
+        case ucode::AluScalarOpcode::kSges:
+          predicate = kCmpGeOq;
+          break;
+        default:
+          predicate = kCmpNeqUq;
+          break;
+      }
+      vxorps(ymm1, ymm1, ymm1);
+      vcmpps(ymm0, ymm0, ymm1, predicate);
+      vbroadcastss(ymm1, SpecialConstantAddress(kSpecialConstantOne));
+      vandps(ymm0, ymm0, ymm1);
+    } break;
+    case ucode::AluScalarOpcode::kFrcs:
+      vroundps(ymm1, ymm0, kRoundFloor);
+      vsubps(ymm0, ymm0, ymm1);
+      break;
+    case ucode::AluScalarOpcode::kTruncs:
+      vroundps(ymm0, ymm0, kRoundTrunc);
+      break;
+    case ucode::AluScalarOpcode::kFloors:
+      vroundps(ymm0, ymm0, kRoundFloor);
+      break;
+    case ucode::AluScalarOpcode::kRcpc:
+    case ucode::AluScalarOpcode::kRcpf:
+    case ucode::AluScalarOpcode::kRcp:
+    case ucode::AluScalarOpcode::kRsqc:
+    case ucode::AluScalarOpcode::kRsqf:
+    case ucode::AluScalarOpcode::kRsq:
+      if (opcode == ucode::AluScalarOpcode::kRsqc ||
+          opcode == ucode::AluScalarOpcode::kRsqf ||
+          opcode == ucode::AluScalarOpcode::kRsq) {
+        vsqrtps(ymm0, ymm0);
+      }
+      vbroadcastss(ymm1, SpecialConstantAddress(kSpecialConstantOne));
+      vdivps(ymm0, ymm1, ymm0);
+      if (opcode == ucode::AluScalarOpcode::kRcpc ||
+          opcode == ucode::AluScalarOpcode::kRsqc) {
+        EmitReplaceInfinity(ymm0, true);
+      } else if (opcode == ucode::AluScalarOpcode::kRcpf ||
+                 opcode == ucode::AluScalarOpcode::kRsqf) {
+        EmitReplaceInfinity(ymm0, false);
+      }
+      break;
+    case ucode::AluScalarOpcode::kSubs:
+    case ucode::AluScalarOpcode::kSubsc0:
+    case ucode::AluScalarOpcode::kSubsc1:
+      vsubps(ymm0, ymm0, ymm1);
+      break;
+    case ucode::AluScalarOpcode::kSubsPrev:
+      vsubps(ymm0, ymm0, previous_scalar);
+      break;
+    case ucode::AluScalarOpcode::kSqrt:
+      vsqrtps(ymm0, ymm0);
+      break;
+    case ucode::AluScalarOpcode::kRetainPrev:
+      return;
+    default:
+      // Checked in AllocateSlots.
+      assert_unhandled_case(opcode);
+      vxorps(ymm0, ymm0, ymm0);
+      break;
+  }
+  vmovups(previous_scalar, ymm0);
+}
+
+#endif  // XE_GPU_SHADER_JIT
+
+bool ShaderJit::CompiledShader::Compile(const Shader& shader,
+                                        const uint32_t* bool_constants) {
+  std::vector<LinearInstruction> instructions;
+  if (!Linearize(shader, bool_constants, instructions)) {
+    return false;
+  }
+  AnalyzeLiveness(instructions);
+  if (!AllocateSlots(instructions)) {
+    return false;
+  }
+
+  for (const LinearInstruction& instruction : instructions) {
+    if (!instruction.is_fetch || !instruction.vector_result_mask) {
+      continue;
+    }
+    const ucode::VertexFetchInstruction& vfetch_instr =
+        instruction.fetch().vertex_fetch();
+    uint32_t used_result_components = 0b0000;
+    for (uint32_t i = 0; i < 4; ++i) {
+      uint32_t dest_component_swizzle =
+          (vfetch_instr.dest_swizzle() >> (3 * i)) & 0b111;
+      if (dest_component_swizzle <= 3) {
+        used_result_components |= UINT32_C(1) << dest_component_swizzle;
+      }
+    }
+    VertexFetch& vertex_fetch = vertex_fetches_.emplace_back();
+    vertex_fetch.instruction = vfetch_instr;
+    vertex_fetch.fetch_constant_index =
+        instruction.vfetch_full.fetch_constant_index();
+    vertex_fetch.stride = instruction.vfetch_full.stride();
+    vertex_fetch.needed_dwords = xenos::GetVertexFormatNeededWords(
+        vfetch_instr.data_format(), used_result_components);
+  }
+  fetch_vector_base_ = temp_slot_count_ * 4 + 5 + kExportComponentCount;
+
+#if XE_GPU_SHADER_JIT
+  try {
+    code_generator_ = std::make_unique<CodeGenerator>(
+        *this, 4096 + 4096 * instructions.size());
+    code_generator_->EmitShader(instructions);
+    function_ = code_generator_->getCode<Function>();
+  } catch (const Xbyak::Error& error) {
+    XELOGE("ShaderJit: Failed to generate code for shader {:016X}: {}",
+           shader.ucode_data_hash(), error.what());
+    code_generator_.reset();
+    function_ = nullptr;
+  }
+#endif  // XE_GPU_SHADER_JIT
+  return function_ != nullptr;
+}
+
+ShaderJit::ShaderJit(const RegisterFile& register_file, const Memory& memory)
+    : register_file_(register_file), memory_(memory) {}
+
+ShaderJit::~ShaderJit() = default;
+
+bool ShaderJit::IsSupported() {
+  // AVX is required by the rest of the emulator on x86-64 anyway.
+#if XE_GPU_SHADER_JIT
+  return true;
+#else
+  return false;
+#endif  // XE_GPU_SHADER_JIT
+}
+
+const ShaderJit::CompiledShader* ShaderJit::GetCompiledShader(
+    const Shader& shader) {
+  assert_true(shader.is_ucode_analyzed());
+  if (!IsSupported()) {
+    return nullptr;
+  }
+  const uint32_t* bool_constants =
+      &register_file_[XE_GPU_REG_SHADER_CONSTANT_BOOL_000_031];
+  std::vector<std::unique_ptr<CompiledShader>>& variants =
+      compiled_shaders_[shader.ucode_data_hash()];
+  for (const std::unique_ptr<CompiledShader>& variant : variants) {
+    if (variant->AreBoolConstantConditionsMet(bool_constants)) {
+      return variant->function() ? variant.get() : nullptr;
+    }
+  }
+  std::unique_ptr<CompiledShader>& compiled_shader =
+      variants.emplace_back(std::make_unique<CompiledShader>());
+  if (!compiled_shader->Compile(shader, bool_constants)) {
+    return nullptr;
+  }
+  return compiled_shader.get();
+}
+
+uint32_t ShaderJit::GetExportMask(const CompiledShader& compiled_shader) {
+  return compiled_shader.export_mask();
+}
+
+void ShaderJit::Execute(const CompiledShader& compiled_shader,
+                        const uint32_t* vertex_indices, uint32_t vertex_count,
+                        float* exports_out) {
+  assert_not_null(compiled_shader.function());
+  UpdateConstants(compiled_shader);
+  batch_registers_.clear();
+  batch_registers_.resize(compiled_shader.register_vector_count() *
+                          kVertexBatchSize);
+  float* registers = batch_registers_.data();
+  float* registers_export =
+      registers + compiled_shader.export_vector(0) * kVertexBatchSize;
+  for (uint32_t batch_first = 0; batch_first < vertex_count;
+       batch_first += kVertexBatchSize) {
+    uint32_t batch_count =
+        std::min(kVertexBatchSize, vertex_count - batch_first);
+    const uint32_t* batch_indices = vertex_indices + batch_first;
+    // The vertex index in r0.x, the unused lanes are executed with the last
+    // vertex.
+    for (uint32_t i = 0; i < kVertexBatchSize; ++i) {
+      registers[compiled_shader.temp_vector(0, 0) * kVertexBatchSize + i] =
+          float(batch_indices[std::min(i, batch_count - 1)]);
+    }
+    FetchVertices(compiled_shader, batch_indices, batch_count);
+    compiled_shader.function()(registers, batch_constants_.data());
+    for (uint32_t i = 0; i < batch_count; ++i) {
+      float* vertex_exports_out =
+          exports_out + (batch_first + i) * kExportComponentCount;
+      for (uint32_t j = 0; j < kExportComponentCount; ++j) {
+        vertex_exports_out[j] = registers_export[j * kVertexBatchSize + i];
+      }
+    }
+  }
+}
+
+void ShaderJit::ClearCache() { compiled_shaders_.clear(); }
+
+void ShaderJit::UpdateConstants(const CompiledShader& compiled_shader) {
+  const std::vector<uint32_t>& float_constants =
+      compiled_shader.float_constants();
+  batch_constants_.resize(kSpecialConstantCount + 4 * float_constants.size());
+  float* constants = batch_constants_.data();
+  constants[kSpecialConstantSignMask] =
+      xe::memory::Reinterpret<float>(UINT32_C(0x80000000));
+  constants[kSpecialConstantAbsMask] =
+      xe::memory::Reinterpret<float>(UINT32_C(0x7FFFFFFF));
+  constants[kSpecialConstantExponentMask] =
+      xe::memory::Reinterpret<float>(UINT32_C(0x7F800000));
+  constants[kSpecialConstantOne] = 1.0f;
+  constants[kSpecialConstantInfinity] = INFINITY;
+  constants[kSpecialConstantFltMax] = FLT_MAX;
+  // Same addressing as in the ShaderInterpreter.
+  auto base_and_size_minus_1 = register_file_.Get<reg::SQ_VS_CONST>();
+  for (size_t i = 0; i < float_constants.size(); ++i) {
+    float* constant = constants + kSpecialConstantCount + 4 * i;
+    uint32_t index = float_constants[i];
+    if (index > base_and_size_minus_1.size ||
+        index + base_and_size_minus_1.base >= 512) {
+      std::memset(constant, 0, sizeof(float) * 4);
+      continue;
+    }
+    std::memcpy(constant,
+                &register_file_[XE_GPU_REG_SHADER_CONSTANT_000_X +
+                                4 * (index + base_and_size_minus_1.base)],
+                sizeof(float) * 4);
+    for (uint32_t j = 0; j < 4; ++j) {
+      constant[j] = FlushDenormal(constant[j]);
+    }
+  }
+}
+
+void ShaderJit::FetchVertices(const CompiledShader& compiled_shader,
+                              const uint32_t* vertex_indices,
+                              uint32_t vertex_count) {
+  const std::vector<CompiledShader::VertexFetch>& vertex_fetches =
+      compiled_shader.vertex_fetches();
+  const uint32_t* memory_dwords =
+      reinterpret_cast<const uint32_t*>(memory_.physical_membase());
+  float* registers = batch_registers_.data();
+  for (uint32_t fetch_index = 0; fetch_index < uint32_t(vertex_fetches.size());
+       ++fetch_index) {
+    const CompiledShader::VertexFetch& vertex_fetch =
+        vertex_fetches[fetch_index];
+    const ucode::VertexFetchInstruction& instr = vertex_fetch.instruction;
+    xenos::xe_gpu_vertex_fetch_t fetch_constant =
+        register_file_.GetVertexFetch(vertex_fetch.fetch_constant_index);
+    uint32_t buffer_end_dwords = fetch_constant.address + fetch_constant.size;
+    int32_t exp_adjust = instr.exp_adjust();
+    float exp_adjust_factor = exp_adjust ? std::ldexp(1.0f, exp_adjust) : 1.0f;
+    float* fetch_registers =
+        registers +
+        compiled_shader.fetch_vector(fetch_index, 0) * kVertexBatchSize;
+    for (uint32_t i = 0; i < vertex_count; ++i) {
+      // The index is an integer in r0.x, not affected by the rounding.
+      uint32_t dword_0_address_dwords = uint32_t(
+          int32_t(vertex_fetch.stride * vertex_indices[i] +
+                  fetch_constant.address) +
+          instr.offset());
+      uint32_t data[4] = {};
+      for (uint32_t j = 0; j < 4; ++j) {
+        if (!(vertex_fetch.needed_dwords & (UINT32_C(1) << j))) {
+          continue;
+        }
+        uint32_t dword_address_dwords = dword_0_address_dwords + j;
+        if (dword_address_dwords >= fetch_constant.address &&
+            dword_address_dwords < buffer_end_dwords) {
+          if (trace_writer_) {
+            trace_writer_->WriteMemoryRead(
+                sizeof(uint32_t) * dword_address_dwords, sizeof(uint32_t));
+          }
+          data[j] = xenos::GpuSwap(memory_dwords[dword_address_dwords],
+                                   fetch_constant.endian);
+        }
+      }
+      float result[4] = {};
+      switch (instr.data_format()) {
+        case xenos::VertexFormat::k_16_16_16_16_FLOAT:
+          result[3] = xe::xenos_half_to_float(uint16_t(data[1] >> 16));
+          result[2] = xe::xenos_half_to_float(uint16_t(data[1]));
+          [[fallthrough]];
+        case xenos::VertexFormat::k_16_16_FLOAT:
+          result[1] = xe::xenos_half_to_float(uint16_t(data[0] >> 16));
+          result[0] = xe::xenos_half_to_float(uint16_t(data[0]));
+          break;
+        default:
+          // 32-bit float formats, checked in AllocateSlots.
+          std::memcpy(result, data, sizeof(result));
+          break;
+      }
+      for (uint32_t j = 0; j < 4; ++j) {
+        fetch_registers[j * kVertexBatchSize + i] =
+            result[j] * exp_adjust_factor;
+      }
+    }
+  }
+}
+
+}  // namespace gpu
+}  // namespace xe
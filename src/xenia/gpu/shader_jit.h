@@ -0,0 +1,113 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_GPU_SHADER_JIT_H_
+#define XENIA_GPU_SHADER_JIT_H_
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "xenia/gpu/register_file.h"
+#include "xenia/gpu/shader.h"
+#include "xenia/gpu/trace_writer.h"
+#include "xenia/gpu/ucode.h"
+#include "xenia/memory.h"
+
+// The code generator is experimental and is only built with the gpu-shader-jit
+// premake option, on x86-64 - otherwise IsSupported returns false.
+#ifndef XE_GPU_SHADER_JIT
+#define XE_GPU_SHADER_JIT 0
+#endif  // XE_GPU_SHADER_JIT
+
+namespace xe {
+namespace gpu {
+
+// Native code generator for the subset of vertex shaders that the
+// DrawExtentEstimator needs to execute on the CPU - only the instructions
+// contributing to the Y and W of the position, the point size and the vertex
+// kill flag are compiled, to straight-line code processing kVertexBatchSize
+// vertices at once, one per SIMD lane. Results must be the same as those of
+// the ShaderInterpreter. Shaders with control flow depending on the vertex
+// (loops, calls, jumps, predication), relative addressing, texture fetches,
+// and vertex fetches that can't be done before the execution of the shader are
+// not supported, and must be interpreted instead.
+class ShaderJit {
+ public:
+  // One vertex per lane of an AVX register.
+  static constexpr uint32_t kVertexBatchSize = 8;
+
+  enum ExportComponent : uint32_t {
+    kExportPositionY,
+    kExportPositionW,
+    kExportPointSize,
+    // Bits of the float written to the vertex kill component.
+    kExportVertexKill,
+
+    kExportComponentCount,
+  };
+
+  class CompiledShader;
+
+  ShaderJit(const RegisterFile& register_file, const Memory& memory);
+  ~ShaderJit();
+
+  void SetTraceWriter(TraceWriter* new_trace_writer) {
+    trace_writer_ = new_trace_writer;
+  }
+
+  // Whether native code can be generated on this host at all.
+  static bool IsSupported();
+
+  // The shader must have its ucode analyzed. Returns nullptr if the shader,
+  // with the current boolean constants, can't be compiled - the interpreter
+  // must be used for it then. Results, including failures, are cached by the
+  // ucode hash and the boolean constants used in the control flow.
+  const CompiledShader* GetCompiledShader(const Shader& shader);
+
+  // Mask of ExportComponent bits written by the shader - the exported values
+  // of the rest are undefined.
+  static uint32_t GetExportMask(const CompiledShader& compiled_shader);
+
+  // Executes the shader for the vertices, writing kExportComponentCount
+  // values for each vertex to exports_out.
+  void Execute(const CompiledShader& compiled_shader,
+               const uint32_t* vertex_indices, uint32_t vertex_count,
+               float* exports_out);
+
+  void ClearCache();
+
+ private:
+  void UpdateConstants(const CompiledShader& compiled_shader);
+  void FetchVertices(const CompiledShader& compiled_shader,
+                     const uint32_t* vertex_indices, uint32_t vertex_count);
+
+  const RegisterFile& register_file_;
+  const Memory& memory_;
+
+  TraceWriter* trace_writer_ = nullptr;
+
+  // Compiled shaders (or failures to compile) by the ucode hash, for different
+  // values of the boolean constants they depend on.
+  std::unordered_map<uint64_t, std::vector<std::unique_ptr<CompiledShader>>>
+      compiled_shaders_;
+
+  // Registers of the current batch, structure of arrays, kVertexBatchSize
+  // floats for each component.
+  std::vector<float> batch_registers_;
+  // Special values and float constants used by the current shader.
+  std::vector<float> batch_constants_;
+};
+
+}  // namespace gpu
+}  // namespace xe
+
+#endif  // XENIA_GPU_SHADER_JIT_H_
@@ -1045,33 +1045,34 @@ bool ParseVertexFetchInstruction(const VertexFetchInstruction& op,
   return !op.is_mini_fetch();
 }
 
-void ParseTextureFetchInstruction(const TextureFetchInstruction& op,
-                                  ParsedTextureFetchInstruction& instr) {
-  struct TextureFetchOpcodeInfo {
-    const char* name;
-    bool has_dest;
-    bool has_const;
-    bool has_attributes;
-    uint32_t override_component_count;
-  } opcode_info;
-  switch (op.opcode()) {
+namespace {
+struct TextureFetchOpcodeInfo {
+  const char* name;
+  bool has_dest;
+  bool has_const;
+  bool has_attributes;
+  uint32_t override_component_count;
+};
+}  // namespace
+
+static bool GetTextureFetchOpcodeInfo(FetchOpcode opcode,
+                                      xenos::FetchOpDimension dimension,
+                                      TextureFetchOpcodeInfo& opcode_info) {
+  switch (opcode) {
     case FetchOpcode::kTextureFetch: {
       static const char* kNames[] = {"tfetch1D", "tfetch2D", "tfetch3D",
                                      "tfetchCube"};
-      opcode_info = {kNames[static_cast<int>(op.dimension())], true, true, true,
-                     0};
+      opcode_info = {kNames[static_cast<int>(dimension)], true, true, true, 0};
     } break;
     case FetchOpcode::kGetTextureBorderColorFrac: {
       static const char* kNames[] = {"getBCF1D", "getBCF2D", "getBCF3D",
                                      "getBCFCube"};
-      opcode_info = {kNames[static_cast<int>(op.dimension())], true, true, true,
-                     0};
+      opcode_info = {kNames[static_cast<int>(dimension)], true, true, true, 0};
     } break;
     case FetchOpcode::kGetTextureComputedLod: {
       static const char* kNames[] = {"getCompTexLOD1D", "getCompTexLOD2D",
                                      "getCompTexLOD3D", "getCompTexLODCube"};
-      opcode_info = {kNames[static_cast<int>(op.dimension())], true, true, true,
-                     0};
+      opcode_info = {kNames[static_cast<int>(dimension)], true, true, true, 0};
     } break;
     case FetchOpcode::kGetTextureGradients:
       opcode_info = {"getGradients", true, true, true, 2};
@@ -1079,8 +1080,7 @@ void ParseTextureFetchInstruction(const TextureFetchInstruction& op,
     case FetchOpcode::kGetTextureWeights: {
       static const char* kNames[] = {"getWeights1D", "getWeights2D",
                                      "getWeights3D", "getWeightsCube"};
-      opcode_info = {kNames[static_cast<int>(op.dimension())], true, true, true,
-                     0};
+      opcode_info = {kNames[static_cast<int>(dimension)], true, true, true, 0};
     } break;
     case FetchOpcode::kSetTextureLod:
       opcode_info = {"setTexLOD", false, false, false, 1};
@@ -1092,8 +1092,26 @@ void ParseTextureFetchInstruction(const TextureFetchInstruction& op,
       opcode_info = {"setGradientV", false, false, false, 3};
       break;
     default:
-      assert_unhandled_case(fetch_opcode);
-      return;
+      return false;
+  }
+  return true;
+}
+
+const char* GetTextureFetchOpcodeName(FetchOpcode opcode,
+                                      xenos::FetchOpDimension dimension) {
+  TextureFetchOpcodeInfo opcode_info;
+  if (!GetTextureFetchOpcodeInfo(opcode, dimension, opcode_info)) {
+    return nullptr;
+  }
+  return opcode_info.name;
+}
+
+void ParseTextureFetchInstruction(const TextureFetchInstruction& op,
+                                  ParsedTextureFetchInstruction& instr) {
+  TextureFetchOpcodeInfo opcode_info;
+  if (!GetTextureFetchOpcodeInfo(op.opcode(), op.dimension(), opcode_info)) {
+    assert_unhandled_case(op.opcode());
+    return;
   }
 
   instr.opcode = op.opcode();
@@ -301,6 +301,24 @@ void SharedMemory::RangeWrittenByGpu(uint32_t start, uint32_t length,
   MakeRangeValid(start, length, true, is_resolve);
 }
 
+const uint8_t* SharedMemory::GetCpuWrittenRangeData(uint32_t start,
+                                                    uint32_t length) {
+  if (start > kBufferSize || (kBufferSize - start) < length) {
+    return nullptr;
+  }
+  if (length) {
+    uint32_t page_first = start >> page_size_log2_;
+    uint32_t page_last = (start + length - 1) >> page_size_log2_;
+    auto global_lock = global_critical_region_.Acquire();
+    if (xe::bit_range::AnySetInRange(system_page_flags_valid_and_gpu_written_,
+                                     page_first,
+                                     page_last - page_first + 1)) {
+      return nullptr;
+    }
+  }
+  return memory().TranslatePhysical<const uint8_t*>(start);
+}
+
 bool SharedMemory::AllocateSparseHostGpuMemoryRange(
     uint32_t offset_allocations, uint32_t length_allocations) {
   assert_always(
@@ -320,32 +338,27 @@ void SharedMemory::MakeRangeValid(uint32_t start, uint32_t length,
   uint32_t last = start + length - 1;
   uint32_t valid_page_first = start >> page_size_log2_;
   uint32_t valid_page_last = last >> page_size_log2_;
-  uint32_t valid_block_first = valid_page_first >> 6;
-  uint32_t valid_block_last = valid_page_last >> 6;
+  uint32_t valid_page_count = valid_page_last - valid_page_first + 1;
 
   {
     auto global_lock = global_critical_region_.Acquire();
-
-    for (uint32_t i = valid_block_first; i <= valid_block_last; ++i) {
-      uint64_t valid_bits = UINT64_MAX;
-      if (i == valid_block_first) {
-        valid_bits &= ~((uint64_t(1) << (valid_page_first & 63)) - 1);
-      }
-      if (i == valid_block_last && (valid_page_last & 63) != 63) {
-        valid_bits &= (uint64_t(1) << ((valid_page_last & 63) + 1)) - 1;
-      }
-      // SystemPageFlagsBlock& block = system_page_flags_[i];
-      system_page_flags_valid_[i] |= valid_bits;
-      if (written_by_gpu) {
-        system_page_flags_valid_and_gpu_written_[i] |= valid_bits;
-      } else {
-        system_page_flags_valid_and_gpu_written_[i] &= ~valid_bits;
-      }
-      if (written_by_gpu_resolve) {
-        system_page_flags_valid_and_gpu_resolved_[i] |= valid_bits;
-      } else {
-        system_page_flags_valid_and_gpu_resolved_[i] &= ~valid_bits;
-      }
+    SCOPE_profile_cpu_i("gpu",
+                        "xe::gpu::SharedMemory::MakeRangeValid (locked)");
+    xe::bit_range::SetRange(system_page_flags_valid_, valid_page_first,
+                            valid_page_count);
+    if (written_by_gpu) {
+      xe::bit_range::SetRange(system_page_flags_valid_and_gpu_written_,
+                              valid_page_first, valid_page_count);
+    } else {
+      xe::bit_range::ClearRange(system_page_flags_valid_and_gpu_written_,
+                                valid_page_first, valid_page_count);
+    }
+    if (written_by_gpu_resolve) {
+      xe::bit_range::SetRange(system_page_flags_valid_and_gpu_resolved_,
+                              valid_page_first, valid_page_count);
+    } else {
+      xe::bit_range::ClearRange(system_page_flags_valid_and_gpu_resolved_,
+                                valid_page_first, valid_page_count);
     }
   }
 
@@ -379,7 +392,7 @@ void SharedMemory::UnlinkWatchRange(WatchRange* range) {
   range->next_free = watch_range_first_free_;
   watch_range_first_free_ = range;
 }
-// todo: optimize, an enormous amount of cpu time (1.34%) is spent here.
+
 bool SharedMemory::RequestRange(uint32_t start, uint32_t length,
                                 bool* any_data_resolved_out) {
   if (!length) {
@@ -408,21 +421,31 @@ bool SharedMemory::RequestRange(uint32_t start, uint32_t length,
   std::pair<uint32_t, uint32_t>* uploads =
       reinterpret_cast<std::pair<uint32_t, uint32_t>*>(upload_ranges_.data());
 
-  bool any_data_resolved = false;
-  uint32_t block_first = page_first >> 6;
-  // swcache::PrefetchL1(&system_page_flags_[block_first]);
-  uint32_t block_last = page_last >> 6;
-  uint32_t range_start = UINT32_MAX;
+  bool any_data_resolved;
 
   {
     auto global_lock = global_critical_region_.Acquire();
-    TryFindUploadRange(block_first, block_last, page_first, page_last,
-                       any_data_resolved, range_start, current_upload_range,
-                       uploads);
-  }
-  if (range_start != UINT32_MAX) {
-    uploads[current_upload_range++] =
-        (std::make_pair(range_start, page_last + 1 - range_start));
+    SCOPE_profile_cpu_i("gpu", "xe::gpu::SharedMemory::RequestRange (locked)");
+    any_data_resolved = xe::bit_range::AnySetInRange(
+        system_page_flags_valid_and_gpu_resolved_, page_first,
+        page_last - page_first + 1);
+    uint32_t page_next = page_first;
+    while (page_next <= page_last) {
+      std::pair<size_t, size_t> upload_range = xe::bit_range::NextUnsetRange(
+          system_page_flags_valid_, page_next, page_last - page_next + 1);
+      if (!upload_range.second) {
+        break;
+      }
+      if (current_upload_range >= MAX_UPLOAD_RANGES) {
+        xe::FatalError(
+            "Hit max upload ranges in shared_memory.cc, tell a dev to "
+            "raise the limit!");
+      }
+      uploads[current_upload_range++] =
+          std::make_pair(uint32_t(upload_range.first),
+                         uint32_t(upload_range.second));
+      page_next = uint32_t(upload_range.first + upload_range.second);
+    }
   }
   if (any_data_resolved_out) {
     *any_data_resolved_out = any_data_resolved;
@@ -434,110 +457,6 @@ bool SharedMemory::RequestRange(uint32_t start, uint32_t length,
   return UploadRanges(uploads, current_upload_range);
 }
 
-template <typename T>
-XE_FORCEINLINE XE_NOALIAS static T mod_shift_left(T value, uint32_t by) {
-#if XE_ARCH_AMD64 == 1
-  // arch has modular shifts
-  return value << by;
-#else
-  return value << (by % (sizeof(T) * CHAR_BIT));
-#endif
-}
-void SharedMemory::TryFindUploadRange(const uint32_t& block_first,
-                                      const uint32_t& block_last,
-                                      const uint32_t& page_first,
-                                      const uint32_t& page_last,
-                                      bool& any_data_resolved,
-                                      uint32_t& range_start,
-                                      unsigned int& current_upload_range,
-                                      std::pair<uint32_t, uint32_t>* uploads) {
-  for (uint32_t i = block_first; i <= block_last; ++i) {
-    // const SystemPageFlagsBlock& block = system_page_flags_[i];
-    uint64_t block_valid = system_page_flags_valid_[i];
-    uint64_t block_resolved = 0;
-
-    if (any_data_resolved) {
-      block_resolved = 0;
-    } else {
-      block_resolved = system_page_flags_valid_and_gpu_resolved_[i];
-    }
-    if (i == block_first) {
-      uint64_t block_before = mod_shift_left(uint64_t(1), page_first) - 1;
-      block_valid |= block_before;
-      block_resolved &= ~block_before;
-    }
-    if (i == block_last && (page_last & 63) != 63) {
-      uint64_t block_inside = mod_shift_left(uint64_t(1), page_last + 1) - 1;
-      block_valid |= ~block_inside;
-      block_resolved &= block_inside;
-    }
-    // Consider pages in the block outside the requested range valid.
-    if (!block_resolved) {
-    } else {
-      any_data_resolved = true;
-    }
-    TryGetNextUploadRange(range_start, block_valid, i, current_upload_range,
-                          uploads);
-  }
-}
-
-static bool UploadRange_DoBestScanForward(uint64_t v, uint32_t* out) {
-#if XE_ARCH_AMD64 == 1
-  if (!v) {
-    return false;
-  }
-  if (amd64::GetFeatureFlags() & amd64::kX64EmitBMI1) {
-    *out = static_cast<uint32_t>(_tzcnt_u64(v));
-  } else {
-    unsigned char bsfres = _BitScanForward64((unsigned long*)out, v);
-
-    XE_MSVC_ASSUME(bsfres == 1);
-  }
-  return true;
-#else
-  return xe::bit_scan_forward(v, out);
-#endif
-}
-
-void SharedMemory::TryGetNextUploadRange(
-    uint32_t& range_start, uint64_t& block_valid, const uint32_t& i,
-    unsigned int& current_upload_range,
-    std::pair<uint32_t, uint32_t>* uploads) {
-  while (true) {
-    uint32_t block_page = 0;
-    if (range_start == UINT32_MAX) {
-      // Check if need to open a new range.
-      if (!UploadRange_DoBestScanForward(~block_valid, &block_page)) {
-        break;
-      }
-      range_start = (i << 6) + block_page;
-    } else {
-      // Check if need to close the range.
-      // Ignore the valid pages before the beginning of the range.
-      uint64_t block_valid_from_start = block_valid;
-      if (i == (range_start >> 6)) {
-        block_valid_from_start &=
-            ~(mod_shift_left(uint64_t(1), range_start) - 1);
-      }
-      if (!UploadRange_DoBestScanForward(block_valid_from_start, &block_page)) {
-        break;
-      }
-      if (current_upload_range + 1 < MAX_UPLOAD_RANGES) {
-        uploads[current_upload_range++] =
-            std::make_pair(range_start, (i << 6) + block_page - range_start);
-        // In the next iteration within this block, consider this range valid
-        // since it has been queued for upload.
-        block_valid |= (uint64_t(1) << block_page) - 1;
-        range_start = UINT32_MAX;
-      } else {
-        xe::FatalError(
-            "Hit max upload ranges in shared_memory.cc, tell a dev to "
-            "raise the limit!");
-      }
-    }
-  }
-}
-
 std::pair<uint32_t, uint32_t> SharedMemory::MemoryInvalidationCallbackThunk(
     void* context_ptr, uint32_t physical_address_start, uint32_t length,
     bool exact_range) {
@@ -559,6 +478,8 @@ std::pair<uint32_t, uint32_t> SharedMemory::MemoryInvalidationCallback(
   uint32_t block_last = page_last >> 6;
 
   auto global_lock = global_critical_region_.Acquire();
+  SCOPE_profile_cpu_i(
+      "gpu", "xe::gpu::SharedMemory::MemoryInvalidationCallback (locked)");
 
   if (!exact_range) {
     // Check if a somewhat wider range (up to 256 KB with 4 KB pages) can be
@@ -585,18 +506,12 @@ std::pair<uint32_t, uint32_t> SharedMemory::MemoryInvalidationCallback(
     }
   }
 
-  for (uint32_t i = block_first; i <= block_last; ++i) {
-    uint64_t invalidate_bits = UINT64_MAX;
-    if (i == block_first) {
-      invalidate_bits &= ~((uint64_t(1) << (page_first & 63)) - 1);
-    }
-    if (i == block_last && (page_last & 63) != 63) {
-      invalidate_bits &= (uint64_t(1) << ((page_last & 63) + 1)) - 1;
-    }
-    system_page_flags_valid_[i] &= ~invalidate_bits;
-    system_page_flags_valid_and_gpu_resolved_[i] &= ~invalidate_bits;
-    system_page_flags_valid_and_gpu_written_[i] &= ~invalidate_bits;
-  }
+  uint32_t page_count = page_last - page_first + 1;
+  xe::bit_range::ClearRange(system_page_flags_valid_, page_first, page_count);
+  xe::bit_range::ClearRange(system_page_flags_valid_and_gpu_resolved_,
+                            page_first, page_count);
+  xe::bit_range::ClearRange(system_page_flags_valid_and_gpu_written_,
+                            page_first, page_count);
 
   FireWatches(page_first, page_last, false);
 
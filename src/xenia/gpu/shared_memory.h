@@ -74,18 +74,6 @@ class SharedMemory {
   bool RequestRange(uint32_t start, uint32_t length,
                     bool* any_data_resolved_out = nullptr);
 
-  void TryFindUploadRange(const uint32_t& block_first,
-                          const uint32_t& block_last,
-                          const uint32_t& page_first, const uint32_t& page_last,
-                          bool& any_data_resolved, uint32_t& range_start,
-                          unsigned int& current_upload_range,
-                          std::pair<uint32_t, uint32_t>* uploads);
-
-  void TryGetNextUploadRange(uint32_t& range_start, uint64_t& block_valid,
-                             const uint32_t& i,
-                             unsigned int& current_upload_range,
-                             std::pair<uint32_t, uint32_t>* uploads);
-
   // Marks the range and, if not exact_range, potentially its surroundings
   // (to up to the first GPU-written page, as an access violation exception
   // count optimization) as modified by the CPU, also invalidating GPU-written
@@ -102,6 +90,11 @@ class SharedMemory {
   // regions in those pages.
   void RangeWrittenByGpu(uint32_t start, uint32_t length, bool is_resolve);
 
+  // Returns the guest memory backing the range for reading on the CPU, or
+  // nullptr if the range is out of bounds or contains pages with data written
+  // on the GPU, which may not be in sync with the guest memory.
+  const uint8_t* GetCpuWrittenRangeData(uint32_t start, uint32_t length);
+
  protected:
   SharedMemory(Memory& memory);
   // Call in implementation-specific initialization.
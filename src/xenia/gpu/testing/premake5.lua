@@ -0,0 +1,30 @@
+project_root = "../../../.."
+include(project_root.."/tools/build")
+
+test_suite("xenia-gpu-tests", project_root, ".", {
+  links = {
+    "capstone",
+    "dxbc",
+    "fmt",
+    "glslang-spirv",
+    "imgui",
+    "snappy",
+    "xenia-base",
+    "xenia-core",
+    "xenia-cpu",
+    "xenia-gpu",
+    "xenia-kernel",
+    "xenia-ui",
+    "xenia-patcher",
+    "xxhash",
+    "zstd",
+  },
+  filtered_links = {
+    {
+      filter = 'architecture:x86_64',
+      links = {
+        "xenia-cpu-backend-x64",
+      },
+    }
+  },
+})
@@ -0,0 +1,91 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/register_file.h"
+
+#include <memory>
+
+#include "third_party/catch/include/catch.hpp"
+#include "xenia/gpu/registers.h"
+
+namespace xe::gpu::test {
+
+TEST_CASE("RegisterFile dirty tracking", "[register_file]") {
+  auto register_file = std::make_unique<RegisterFile>();
+  RegisterFile::DirtyTracker tracker(*register_file);
+  using DirtyGroup = RegisterFile::DirtyGroup;
+
+  // Everything is initially dirty.
+  REQUIRE(tracker.IsDirty(DirtyGroup::kAluConstants));
+  REQUIRE(tracker.IsDirty(DirtyGroup::kRenderState));
+  REQUIRE(tracker.GetDirtyBits(DirtyGroup::kFetchConstants) == UINT32_MAX);
+  REQUIRE(tracker.GetDirtyBits(DirtyGroup::kBoolLoopConstants) ==
+          (UINT64_C(1) << 40) - 1);
+  for (uint32_t i = 0; i < uint32_t(DirtyGroup::kCount); ++i) {
+    tracker.ClearDirty(DirtyGroup(i));
+    REQUIRE(!tracker.IsDirty(DirtyGroup(i)));
+  }
+
+  SECTION("Single registers") {
+    register_file->MarkDirty(XE_GPU_REG_RB_COLOR2_INFO);
+    REQUIRE(tracker.IsDirty(XE_GPU_REG_RB_COLOR2_INFO));
+    REQUIRE(!tracker.IsDirty(XE_GPU_REG_RB_COLOR1_INFO));
+    REQUIRE(tracker.IsDirty(XE_GPU_REG_RB_SURFACE_INFO, 6));
+    REQUIRE(!tracker.IsDirty(DirtyGroup::kAluConstants));
+    // Untracked registers.
+    register_file->MarkDirty(XE_GPU_REG_SCRATCH_REG0);
+    register_file->MarkDirty(XE_GPU_REG_SHADER_CONSTANT_LOOP_31 + 1);
+    REQUIRE(!tracker.IsDirty(DirtyGroup::kAluConstants));
+    REQUIRE(!tracker.IsDirty(DirtyGroup::kFetchConstants));
+    REQUIRE(!tracker.IsDirty(DirtyGroup::kBoolLoopConstants));
+  }
+
+  SECTION("Ranges spanning groups") {
+    // c511.w, all of the fetch constants, b0...31.
+    register_file->MarkDirty(XE_GPU_REG_SHADER_CONSTANT_511_W,
+                             XE_GPU_REG_SHADER_CONSTANT_BOOL_000_031 + 1 -
+                                 XE_GPU_REG_SHADER_CONSTANT_511_W);
+    REQUIRE(tracker.GetDirtyBits(DirtyGroup::kAluConstants, 7) ==
+            UINT64_C(1) << 63);
+    REQUIRE(!tracker.IsDirty(XE_GPU_REG_SHADER_CONSTANT_000_X, 511 * 4));
+    REQUIRE(tracker.GetDirtyBits(DirtyGroup::kFetchConstants) == UINT32_MAX);
+    REQUIRE(tracker.GetDirtyBits(DirtyGroup::kBoolLoopConstants) == 1);
+    REQUIRE(!tracker.IsDirty(DirtyGroup::kRenderState));
+  }
+
+  SECTION("Partial constants") {
+    // c1.w...c2.x, the last dword of tf2 and the first of tf3.
+    register_file->MarkDirty(XE_GPU_REG_SHADER_CONSTANT_001_W, 2);
+    register_file->MarkDirty(XE_GPU_REG_SHADER_CONSTANT_FETCH_02_5, 2);
+    REQUIRE(tracker.GetDirtyBits(DirtyGroup::kAluConstants) == 0b110);
+    REQUIRE(tracker.GetDirtyBits(DirtyGroup::kFetchConstants) == 0b1100);
+  }
+
+  SECTION("Multiple trackers") {
+    RegisterFile::DirtyTracker other_tracker(*register_file);
+    other_tracker.ClearDirty(DirtyGroup::kRenderState);
+    register_file->MarkDirty(XE_GPU_REG_PA_SU_VTX_CNTL);
+    REQUIRE(tracker.IsDirty(XE_GPU_REG_PA_SU_VTX_CNTL));
+    REQUIRE(other_tracker.IsDirty(XE_GPU_REG_PA_SU_VTX_CNTL));
+    tracker.ClearDirty(DirtyGroup::kRenderState);
+    REQUIRE(other_tracker.IsDirty(XE_GPU_REG_PA_SU_VTX_CNTL));
+  }
+
+  SECTION("Statistics") {
+    tracker.CountUpdates(2, 3);
+    register_file->EndDirtyTrackingFrame();
+    REQUIRE(tracker.last_frame_statistics().updates == 2);
+    REQUIRE(tracker.last_frame_statistics().updates_skipped == 3);
+    register_file->EndDirtyTrackingFrame();
+    REQUIRE(tracker.last_frame_statistics().updates == 0);
+    REQUIRE(tracker.last_frame_statistics().updates_skipped == 0);
+  }
+}
+
+}  // namespace xe::gpu::test
@@ -0,0 +1,268 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/shader_interpreter.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "third_party/catch/include/catch.hpp"
+#include "third_party/fmt/include/fmt/format.h"
+#include "xenia/base/math.h"
+#include "xenia/base/memory.h"
+#include "xenia/base/string_buffer.h"
+#include "xenia/gpu/register_file.h"
+#include "xenia/gpu/registers.h"
+#include "xenia/gpu/shader.h"
+#include "xenia/gpu/ucode.h"
+#include "xenia/gpu/xenos.h"
+#include "xenia/memory.h"
+
+namespace xe::gpu::test {
+
+// Per-vertex predication and a loop with constant addressing by aL:
+//   alloc position
+//   exec
+//     vfetch_full r1, r0.x, vf0, Format=FMT_32_32_32_32_FLOAT, Stride=4
+//     setp_gt r1.y
+//     (p) mul r2, r1, c0
+//     (!p) add r2, r1, c1
+//   loop i0, L5
+//   L3:
+//   exec
+//     add r2, r2, c[2+aL]
+//     (p) mul r2.xy, r2, c6
+//   endloop i0, L3
+//   L5:
+//   exec_end
+//     mad oPos, r2, c4, c5
+//     max oPts.xz, r1, c3
+static const uint32_t kVertexShaderUcode[] = {
+    0x00000001, 0x4003C200, 0x10000001, 0x00000005, 0x20077000, 0x10000000,
+    0x00000003, 0x20098000, 0x20000000, 0x00081000, 0x00262688, 0x00000004,
+    0x74000000, 0x00000080, 0xE2010101, 0xC80F0002, 0x18000000, 0x81010000,
+    0xC80F0002, 0x10000000, 0x80010100, 0xC80F0002, 0x80000000, 0x80020200,
+    0xC8030002, 0x18000000, 0x81020600, 0xC80F803E, 0x00000000, 0x8B020405,
+    0xC805803F, 0x00000000, 0x82010300,
+};
+constexpr uint32_t kConstantCount = 7;
+
+// Records every exported component, of every lane for batches.
+class ExportSink : public ShaderInterpreter::ExportSink {
+ public:
+  using Exports = std::map<std::pair<ucode::ExportRegister, uint32_t>, float>;
+
+  void Reset() { exports_.clear(); }
+  void ResetBatch() {
+    for (Exports& lane_exports : batch_exports_) {
+      lane_exports.clear();
+    }
+  }
+  void Export(ucode::ExportRegister export_register, const float* value,
+              uint32_t value_mask) override {
+    for (uint32_t i = 0; i < 4; ++i) {
+      if (value_mask & (UINT32_C(1) << i)) {
+        exports_[{export_register, i}] = value[i];
+      }
+    }
+  }
+  void ExportBatch(ucode::ExportRegister export_register, const float* value,
+                   uint32_t value_mask, uint32_t lane_mask) override {
+    uint32_t lanes_remaining = lane_mask;
+    uint32_t lane;
+    while (xe::bit_scan_forward(lanes_remaining, &lane)) {
+      lanes_remaining &= ~(UINT32_C(1) << lane);
+      for (uint32_t i = 0; i < 4; ++i) {
+        if (value_mask & (UINT32_C(1) << i)) {
+          batch_exports_[lane][{export_register, i}] =
+              value[ShaderInterpreter::kBatchSize * i + lane];
+        }
+      }
+    }
+  }
+  const Exports& exports() const { return exports_; }
+  const Exports& batch_exports(uint32_t lane) const {
+    return batch_exports_[lane];
+  }
+
+ private:
+  Exports exports_;
+  Exports batch_exports_[ShaderInterpreter::kBatchSize];
+};
+
+class ShaderInterpreterTest {
+ public:
+  explicit ShaderInterpreterTest(uint32_t vertex_count)
+      : register_file_(std::make_unique<RegisterFile>()),
+        shader_(xenos::ShaderType::kVertex, 0x5348414445524241,
+                kVertexShaderUcode, std::size(kVertexShaderUcode),
+                std::endian::native) {
+    REQUIRE(memory_.Initialize());
+    StringBuffer ucode_disasm_buffer;
+    shader_.AnalyzeUcode(ucode_disasm_buffer);
+
+    std::mt19937 random(40);
+    std::uniform_real_distribution<float> distribution(-2.0f, 2.0f);
+
+    RegisterFile& regs = *register_file_;
+    std::memset(regs.values, 0, sizeof(regs.values));
+    reg::SQ_VS_CONST sq_vs_const = {};
+    sq_vs_const.size = kConstantCount - 1;
+    regs.values[XE_GPU_REG_SQ_VS_CONST] = sq_vs_const.value;
+    for (uint32_t i = 0; i < kConstantCount * 4; ++i) {
+      regs.values[XE_GPU_REG_SHADER_CONSTANT_000_X + i] =
+          xe::memory::Reinterpret<uint32_t>(distribution(random));
+    }
+    xenos::LoopConstant loop_constant = {};
+    loop_constant.count = 3;
+    loop_constant.step = 1;
+    regs.values[XE_GPU_REG_SHADER_CONSTANT_LOOP_00] = loop_constant.value;
+
+    // Vertices with some special values, and both predicate values.
+    uint32_t vertex_data_size = sizeof(float) * 4 * vertex_count;
+    uint32_t vertex_data_address = memory_.SystemHeapAlloc(
+        vertex_data_size, 0x20, kSystemHeapPhysical);
+    REQUIRE(vertex_data_address);
+    auto vertex_data = memory_.TranslateVirtual<float*>(vertex_data_address);
+    for (uint32_t i = 0; i < vertex_count * 4; ++i) {
+      vertex_data[i] = distribution(random);
+    }
+    vertex_data[1] = 0.0f;
+    vertex_data[2] = -0.0f;
+    vertex_data[3] = 1.0e-40f;
+    vertex_data[4] = std::numeric_limits<float>::infinity();
+    vertex_data[5] = std::numeric_limits<float>::quiet_NaN();
+    xenos::xe_gpu_vertex_fetch_t vertex_fetch = {};
+    vertex_fetch.type = xenos::FetchConstantType::kVertex;
+    vertex_fetch.address =
+        memory_.GetPhysicalAddress(vertex_data_address) >> 2;
+    vertex_fetch.endian = xenos::Endian::kNone;
+    vertex_fetch.size = vertex_data_size >> 2;
+    std::memcpy(&regs.values[XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0],
+                &vertex_fetch, sizeof(vertex_fetch));
+
+    // Some reused and out-of-bounds vertices too.
+    vertex_indices_.resize(vertex_count);
+    for (uint32_t i = 0; i < vertex_count; ++i) {
+      vertex_indices_[i] = random() % (vertex_count + 4);
+    }
+  }
+
+  const RegisterFile& register_file() const { return *register_file_; }
+  const Memory& memory() const { return memory_; }
+  const Shader& shader() const { return shader_; }
+  const std::vector<uint32_t>& vertex_indices() const {
+    return vertex_indices_;
+  }
+
+ private:
+  Memory memory_;
+  std::unique_ptr<RegisterFile> register_file_;
+  Shader shader_;
+  std::vector<uint32_t> vertex_indices_;
+};
+
+TEST_CASE("ShaderInterpreter batch matches scalar", "[shader_interpreter]") {
+  // Not a multiple of the batch size.
+  ShaderInterpreterTest test(ShaderInterpreter::kBatchSize * 5 + 3);
+  const std::vector<uint32_t>& vertex_indices = test.vertex_indices();
+  uint32_t vertex_count = uint32_t(vertex_indices.size());
+
+  ShaderInterpreter shader_interpreter(test.register_file(), test.memory());
+  shader_interpreter.SetShader(test.shader());
+  ExportSink export_sink;
+  shader_interpreter.SetExportSink(&export_sink);
+  for (uint32_t i = 0; i < vertex_count; i += ShaderInterpreter::kBatchSize) {
+    uint32_t lane_count =
+        std::min(vertex_count - i, ShaderInterpreter::kBatchSize);
+    export_sink.ResetBatch();
+    for (uint32_t j = 0; j < lane_count; ++j) {
+      shader_interpreter.batch_temp_registers()[j] =
+          float(vertex_indices[i + j]);
+    }
+    shader_interpreter.ExecuteBatch(lane_count);
+    for (uint32_t j = 0; j < lane_count; ++j) {
+      export_sink.Reset();
+      shader_interpreter.temp_registers()[0] = float(vertex_indices[i + j]);
+      shader_interpreter.Execute();
+      const ExportSink::Exports& expected = export_sink.exports();
+      const ExportSink::Exports& actual = export_sink.batch_exports(j);
+      // oPos.xyzw and oPts.xz.
+      REQUIRE(expected.size() == 6);
+      REQUIRE(actual.size() == expected.size());
+      for (const auto& expected_export : expected) {
+        auto actual_export = actual.find(expected_export.first);
+        REQUIRE(actual_export != actual.end());
+        // NaNs may be produced differently.
+        if (std::isnan(expected_export.second)) {
+          REQUIRE(std::isnan(actual_export->second));
+        } else {
+          REQUIRE(xe::memory::Reinterpret<uint32_t>(actual_export->second) ==
+                  xe::memory::Reinterpret<uint32_t>(expected_export.second));
+        }
+      }
+    }
+  }
+}
+
+// Not run by default. Run with the "[shader_interpreter_benchmark]" tag.
+TEST_CASE("ShaderInterpreter batch performance",
+          "[.][shader_interpreter_benchmark]") {
+  constexpr uint32_t kVertexCount = 4096;
+  constexpr uint32_t kIterations = 200;
+  ShaderInterpreterTest test(kVertexCount);
+  const std::vector<uint32_t>& vertex_indices = test.vertex_indices();
+
+  auto benchmark = [&](const char* name, auto&& execute) {
+    for (uint32_t i = 0; i < kIterations / 16; ++i) {
+      execute();
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < kIterations; ++i) {
+      execute();
+    }
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    fmt::print("{}: {:.1f} ns per vertex\n", name,
+               seconds * 1.0e9 / (double(kIterations) * kVertexCount));
+  };
+
+  ShaderInterpreter shader_interpreter(test.register_file(), test.memory());
+  // Only the execution itself, without the export sink overhead.
+  shader_interpreter.SetShader(test.shader());
+  benchmark("Scalar", [&]() {
+    for (uint32_t vertex_index : vertex_indices) {
+      shader_interpreter.temp_registers()[0] = float(vertex_index);
+      shader_interpreter.Execute();
+    }
+  });
+  benchmark("Batch", [&]() {
+    for (uint32_t i = 0; i < kVertexCount;
+         i += ShaderInterpreter::kBatchSize) {
+      for (uint32_t j = 0; j < ShaderInterpreter::kBatchSize; ++j) {
+        shader_interpreter.batch_temp_registers()[j] =
+            float(vertex_indices[i + j]);
+      }
+      shader_interpreter.ExecuteBatch();
+    }
+  });
+}
+
+}  // namespace xe::gpu::test
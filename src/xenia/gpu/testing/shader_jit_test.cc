@@ -0,0 +1,292 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/shader_jit.h"
+
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <random>
+#include <vector>
+
+#include "third_party/catch/include/catch.hpp"
+#include "third_party/fmt/include/fmt/format.h"
+#include "xenia/base/memory.h"
+#include "xenia/base/string_buffer.h"
+#include "xenia/gpu/register_file.h"
+#include "xenia/gpu/registers.h"
+#include "xenia/gpu/shader.h"
+#include "xenia/gpu/shader_interpreter.h"
+#include "xenia/gpu/ucode.h"
+#include "xenia/gpu/xenos.h"
+#include "xenia/memory.h"
+
+namespace xe::gpu::test {
+
+// A typical transformation of a float4 position with a matrix:
+//   alloc position
+//   exec_end
+//     vfetch_full r1, r0.x, vf0, Format=FMT_32_32_32_32_FLOAT, Stride=4
+//     dp4 r2.x, r1, c0
+//     dp4 r2.y, r1, c1
+//     dp4 r2.w, r1, c3
+//     mad oPos.yw, r2, c4, c5
+//     max oPts.xz, r1, c6
+static const uint32_t kVertexShaderUcode[] = {
+    0x00000001, 0x6001C200, 0x20000001, 0x00081000, 0x00262688, 0x00000004,
+    0xC8010002, 0x00000000, 0x8F010000, 0xC8020002, 0x00000000, 0x8F010100,
+    0xC8080002, 0x00000000, 0x8F010300, 0xC80A803E, 0x00000000, 0x8B020405,
+    0xC805803F, 0x00000000, 0x82010600,
+};
+
+// Scalar operations, including ones referencing the previous scalar result,
+// conditional moves and partial writes, across two execs:
+//   alloc position
+//   exec
+//     vfetch_full r1, r0.x, vf0, Format=FMT_32_32_32_32_FLOAT, Stride=4
+//     mul r2, r1, c0
+//       + frcs r3.x, r1.y
+//     frc r4, r2
+//       + rcpc r3.y, r1.z
+//     cndge r5, r1, r2, r4
+//     dp3 r6.x, r4, c1
+//       + maxs r3.z, r1.wx
+//     floor r6.yzw, r5
+//       + rsqc r3.w, r1.x
+//   exec_end
+//     mad r7, r6, c2, r3
+//     mad oPos.yw, r7, c3, r4
+//     add oPts.x, r6, r5
+//       + adds oPts.z, r3.wx
+static const uint32_t kScalarVertexShaderUcode[] = {
+    0x00000001, 0x6002C200, 0x10000001, 0x00003008, 0x00002000, 0x00000000,
+    0x00081000, 0x00262688, 0x00000004, 0x2C1F0302, 0x00000080, 0xA1010001,
+    0x442F0304, 0x000000C0, 0xE8020001, 0xC80F0005, 0x00000000, 0xED010204,
+    0x14410306, 0x00000000, 0xB0040101, 0x508E0306, 0x00000040, 0xEA050001,
+    0xC80F0007, 0x00000000, 0xAB060203, 0xC80A803E, 0x00000000, 0xAB070304,
+    0x0041803F, 0x00000000, 0xE0060503
+};
+
+constexpr uint32_t kConstantCount = 7;
+
+class ExportSink : public ShaderInterpreter::ExportSink {
+ public:
+  void Reset() {
+    for (std::optional<float>& value : values_) {
+      value.reset();
+    }
+  }
+  void Export(ucode::ExportRegister export_register, const float* value,
+              uint32_t value_mask) override {
+    if (export_register == ucode::ExportRegister::kVSPosition) {
+      if (value_mask & 0b0010) {
+        values_[ShaderJit::kExportPositionY] = value[1];
+      }
+      if (value_mask & 0b1000) {
+        values_[ShaderJit::kExportPositionW] = value[3];
+      }
+    } else if (export_register ==
+               ucode::ExportRegister::kVSPointSizeEdgeFlagKillVertex) {
+      if (value_mask & 0b0001) {
+        values_[ShaderJit::kExportPointSize] = value[0];
+      }
+      if (value_mask & 0b0100) {
+        values_[ShaderJit::kExportVertexKill] = value[2];
+      }
+    }
+  }
+  const std::optional<float>& value(uint32_t component) const {
+    return values_[component];
+  }
+
+ private:
+  std::optional<float> values_[ShaderJit::kExportComponentCount];
+};
+
+class ShaderJitTest {
+ public:
+  template <size_t kUcodeDwordCount = std::size(kVertexShaderUcode)>
+  explicit ShaderJitTest(uint32_t vertex_count,
+                         const uint32_t (&ucode)[kUcodeDwordCount] =
+                             kVertexShaderUcode)
+      : register_file_(std::make_unique<RegisterFile>()),
+        shader_(xenos::ShaderType::kVertex, 0x5348414445524A49, ucode,
+                kUcodeDwordCount, std::endian::native) {
+    REQUIRE(memory_.Initialize());
+    StringBuffer ucode_disasm_buffer;
+    shader_.AnalyzeUcode(ucode_disasm_buffer);
+
+    std::mt19937 random(39);
+    std::uniform_real_distribution<float> distribution(-2.0f, 2.0f);
+
+    RegisterFile& regs = *register_file_;
+    std::memset(regs.values, 0, sizeof(regs.values));
+    reg::SQ_VS_CONST sq_vs_const = {};
+    sq_vs_const.size = kConstantCount - 1;
+    regs.values[XE_GPU_REG_SQ_VS_CONST] = sq_vs_const.value;
+    for (uint32_t i = 0; i < kConstantCount * 4; ++i) {
+      regs.values[XE_GPU_REG_SHADER_CONSTANT_000_X + i] =
+          xe::memory::Reinterpret<uint32_t>(distribution(random));
+    }
+
+    // Vertices with some special values.
+    uint32_t vertex_data_size = sizeof(float) * 4 * vertex_count;
+    uint32_t vertex_data_address = memory_.SystemHeapAlloc(
+        vertex_data_size, 0x20, kSystemHeapPhysical);
+    REQUIRE(vertex_data_address);
+    auto vertex_data = memory_.TranslateVirtual<float*>(vertex_data_address);
+    for (uint32_t i = 0; i < vertex_count * 4; ++i) {
+      vertex_data[i] = distribution(random);
+    }
+    vertex_data[1] = 0.0f;
+    vertex_data[2] = -0.0f;
+    vertex_data[3] = 1.0e-40f;
+    vertex_data[4] = std::numeric_limits<float>::infinity();
+    vertex_data[5] = std::numeric_limits<float>::quiet_NaN();
+    xenos::xe_gpu_vertex_fetch_t vertex_fetch = {};
+    vertex_fetch.type = xenos::FetchConstantType::kVertex;
+    vertex_fetch.address =
+        memory_.GetPhysicalAddress(vertex_data_address) >> 2;
+    vertex_fetch.endian = xenos::Endian::kNone;
+    vertex_fetch.size = vertex_data_size >> 2;
+    std::memcpy(&regs.values[XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0],
+                &vertex_fetch, sizeof(vertex_fetch));
+
+    // Some reused and out-of-bounds vertices too.
+    vertex_indices_.resize(vertex_count);
+    for (uint32_t i = 0; i < vertex_count; ++i) {
+      vertex_indices_[i] = random() % (vertex_count + 4);
+    }
+  }
+
+  const RegisterFile& register_file() const { return *register_file_; }
+  const Memory& memory() const { return memory_; }
+  const Shader& shader() const { return shader_; }
+  const std::vector<uint32_t>& vertex_indices() const {
+    return vertex_indices_;
+  }
+
+ private:
+  Memory memory_;
+  std::unique_ptr<RegisterFile> register_file_;
+  Shader shader_;
+  std::vector<uint32_t> vertex_indices_;
+};
+
+static void RequireJitMatchesInterpreter(const ShaderJitTest& test) {
+  const std::vector<uint32_t>& vertex_indices = test.vertex_indices();
+  uint32_t vertex_count = uint32_t(vertex_indices.size());
+
+  ShaderJit shader_jit(test.register_file(), test.memory());
+  const ShaderJit::CompiledShader* compiled_shader =
+      shader_jit.GetCompiledShader(test.shader());
+  REQUIRE(compiled_shader);
+  REQUIRE(shader_jit.GetCompiledShader(test.shader()) == compiled_shader);
+  uint32_t export_mask = ShaderJit::GetExportMask(*compiled_shader);
+  REQUIRE(export_mask == (UINT32_C(1) << ShaderJit::kExportComponentCount) - 1);
+  std::vector<float> exports(vertex_count * ShaderJit::kExportComponentCount);
+  shader_jit.Execute(*compiled_shader, vertex_indices.data(), vertex_count,
+                     exports.data());
+
+  ShaderInterpreter shader_interpreter(test.register_file(), test.memory());
+  shader_interpreter.SetShader(test.shader());
+  ExportSink export_sink;
+  shader_interpreter.SetExportSink(&export_sink);
+  for (uint32_t i = 0; i < vertex_count; ++i) {
+    export_sink.Reset();
+    shader_interpreter.temp_registers()[0] = float(vertex_indices[i]);
+    shader_interpreter.Execute();
+    for (uint32_t j = 0; j < ShaderJit::kExportComponentCount; ++j) {
+      const std::optional<float>& expected = export_sink.value(j);
+      REQUIRE(expected.has_value());
+      float actual = exports[i * ShaderJit::kExportComponentCount + j];
+      // NaNs may be produced differently.
+      if (std::isnan(expected.value())) {
+        REQUIRE(std::isnan(actual));
+      } else {
+        REQUIRE(xe::memory::Reinterpret<uint32_t>(actual) ==
+                xe::memory::Reinterpret<uint32_t>(expected.value()));
+      }
+    }
+  }
+}
+
+TEST_CASE("ShaderJit matches ShaderInterpreter", "[shader_jit]") {
+  if (!ShaderJit::IsSupported()) {
+    return;
+  }
+  // Not a multiple of the batch size.
+  ShaderJitTest test(ShaderJit::kVertexBatchSize * 5 + 3);
+  RequireJitMatchesInterpreter(test);
+}
+
+TEST_CASE("ShaderJit matches ShaderInterpreter for scalar operations",
+          "[shader_jit]") {
+  if (!ShaderJit::IsSupported()) {
+    return;
+  }
+  ShaderJitTest test(ShaderJit::kVertexBatchSize * 5 + 3,
+                     kScalarVertexShaderUcode);
+  RequireJitMatchesInterpreter(test);
+}
+
+// Not run by default. Run with the "[shader_jit_benchmark]" tag.
+TEST_CASE("ShaderJit performance", "[.][shader_jit_benchmark]") {
+  constexpr uint32_t kVertexCount = 4096;
+  constexpr uint32_t kIterations = 200;
+  ShaderJitTest test(kVertexCount);
+  const std::vector<uint32_t>& vertex_indices = test.vertex_indices();
+
+  auto benchmark = [&](const char* name, auto&& execute) {
+    for (uint32_t i = 0; i < kIterations / 16; ++i) {
+      execute();
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < kIterations; ++i) {
+      execute();
+    }
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    fmt::print("{}: {:.1f} ns per vertex\n", name,
+               seconds * 1.0e9 / (double(kIterations) * kVertexCount));
+  };
+
+  ShaderInterpreter shader_interpreter(test.register_file(), test.memory());
+  shader_interpreter.SetShader(test.shader());
+  ExportSink export_sink;
+  shader_interpreter.SetExportSink(&export_sink);
+  benchmark("Interpreter", [&]() {
+    for (uint32_t vertex_index : vertex_indices) {
+      export_sink.Reset();
+      shader_interpreter.temp_registers()[0] = float(vertex_index);
+      shader_interpreter.Execute();
+    }
+  });
+
+  if (ShaderJit::IsSupported()) {
+    ShaderJit shader_jit(test.register_file(), test.memory());
+    const ShaderJit::CompiledShader* compiled_shader =
+        shader_jit.GetCompiledShader(test.shader());
+    REQUIRE(compiled_shader);
+    std::vector<float> exports(kVertexCount *
+                               ShaderJit::kExportComponentCount);
+    benchmark("JIT", [&]() {
+      shader_jit.Execute(*compiled_shader, vertex_indices.data(), kVertexCount,
+                         exports.data());
+    });
+  }
+}
+
+}  // namespace xe::gpu::test
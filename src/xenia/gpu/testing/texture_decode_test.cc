@@ -0,0 +1,409 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/texture_decode.h"
+
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "third_party/catch/include/catch.hpp"
+#include "third_party/fmt/include/fmt/format.h"
+#include "xenia/base/byte_order.h"
+#include "xenia/base/math.h"
+#include "xenia/base/platform.h"
+#include "xenia/gpu/texture_util.h"
+
+namespace xe::gpu::test {
+using namespace texture_decode;
+
+static GuestSubresource MakeLinearGuest(const void* data, uint32_t pitch_bytes,
+                                        uint32_t width, uint32_t height) {
+  GuestSubresource guest = {};
+  guest.data = reinterpret_cast<const uint8_t*>(data);
+  guest.endian = xenos::Endian::kNone;
+  guest.pitch_aligned = pitch_bytes;
+  guest.z_stride_block_rows_aligned = 32;
+  guest.width = width;
+  guest.height = height;
+  guest.depth = 1;
+  return guest;
+}
+
+static HostSubresource MakeHost(std::vector<uint8_t>& data,
+                                size_t row_pitch) {
+  HostSubresource host;
+  host.data = data.data();
+  host.row_pitch = row_pitch;
+  host.slice_pitch = data.size();
+  return host;
+}
+
+template <typename T>
+static T LoadHost(const std::vector<uint8_t>& data, size_t offset) {
+  T value;
+  std::memcpy(&value, data.data() + offset, sizeof(T));
+  return value;
+}
+
+static void GetGuestTextureSize(const Texture& texture,
+                                uint32_t& base_size_out,
+                                uint32_t& mips_size_out) {
+  texture_util::TextureGuestLayout layout = texture_util::GetGuestTextureLayout(
+      texture.dimension, texture.pitch, texture.width, texture.height,
+      texture.depth_or_array_size, texture.is_tiled, texture.format,
+      texture.has_packed_levels, true, texture.mip_max_level);
+  base_size_out = layout.base.level_data_extent_bytes;
+  mips_size_out = layout.mips_total_extent_bytes;
+}
+
+static void FillRandom(std::vector<uint8_t>& data, uint32_t seed) {
+  std::mt19937 random(seed);
+  for (uint8_t& byte : data) {
+    byte = uint8_t(random());
+  }
+}
+
+TEST_CASE("Tiled offsets", "[texture_decode]") {
+  constexpr uint32_t kCount = 83;
+  int32_t offsets[kCount];
+  for (uint32_t bytes_per_block_log2 = 0; bytes_per_block_log2 <= 4;
+       ++bytes_per_block_log2) {
+    for (uint32_t y : {0u, 1u, 7u, 8u, 17u, 31u, 32u, 45u, 95u}) {
+      for (uint32_t x : {0u, 3u, 32u, 61u}) {
+        auto check_2d = [&]() {
+          for (uint32_t i = 0; i < kCount; ++i) {
+            REQUIRE(offsets[i] ==
+                    texture_util::GetTiledOffset2D(int32_t(x + i), int32_t(y),
+                                                   160, bytes_per_block_log2));
+          }
+        };
+        GetTiledOffsets2D(x, y, kCount, 160, bytes_per_block_log2, offsets);
+        check_2d();
+#if XE_ARCH_AMD64
+        GetTiledOffsets2DSSE2(x, y, kCount, 160, bytes_per_block_log2,
+                              offsets);
+        check_2d();
+        if (amd64::GetFeatureFlags() & amd64::kX64EmitAVX2) {
+          GetTiledOffsets2DAVX2(x, y, kCount, 160, bytes_per_block_log2,
+                                offsets);
+          check_2d();
+        }
+#endif  // XE_ARCH_AMD64
+        for (uint32_t z : {0u, 1u, 3u, 4u, 6u, 9u}) {
+          auto check_3d = [&]() {
+            for (uint32_t i = 0; i < kCount; ++i) {
+              REQUIRE(offsets[i] == texture_util::GetTiledOffset3D(
+                                        int32_t(x + i), int32_t(y), int32_t(z),
+                                        160, 96, bytes_per_block_log2));
+            }
+          };
+          GetTiledOffsets3D(x, y, z, kCount, 160, 96, bytes_per_block_log2,
+                            offsets);
+          check_3d();
+#if XE_ARCH_AMD64
+          GetTiledOffsets3DSSE2(x, y, z, kCount, 160, 96,
+                                bytes_per_block_log2, offsets);
+          check_3d();
+          if (amd64::GetFeatureFlags() & amd64::kX64EmitAVX2) {
+            GetTiledOffsets3DAVX2(x, y, z, kCount, 160, 96,
+                                  bytes_per_block_log2, offsets);
+            check_3d();
+          }
+#endif  // XE_ARCH_AMD64
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("DXT block decoding", "[texture_decode]") {
+  std::vector<uint8_t> host_data(4 * 4 * 4);
+  HostSubresource host = MakeHost(host_data, 4 * 4);
+  auto texel = [&](uint32_t x, uint32_t y) {
+    return LoadHost<uint32_t>(host_data, y * 16 + x * 4);
+  };
+
+  SECTION("DXT1 opaque") {
+    // White and black endpoints, each row using a single code.
+    const uint32_t block[] = {0x0000FFFF, 0xFFAA5500};
+    REQUIRE(DecodeSubresource(xenos::TextureFormat::k_DXT1, false,
+                              MakeLinearGuest(block, 8, 4, 4), host));
+    const uint32_t expected_rows[] = {0xFFFFFFFF, 0xFF000000, 0xFFAAAAAA,
+                                      0xFF555555};
+    for (uint32_t y = 0; y < 4; ++y) {
+      for (uint32_t x = 0; x < 4; ++x) {
+        REQUIRE(texel(x, y) == expected_rows[y]);
+      }
+    }
+  }
+
+  SECTION("DXT1 transparent") {
+    // Black and white endpoints, making the block use the 3-color mode.
+    const uint32_t block[] = {0xFFFF0000, 0xFFAA5500};
+    REQUIRE(DecodeSubresource(xenos::TextureFormat::k_DXT1, false,
+                              MakeLinearGuest(block, 8, 4, 4), host));
+    const uint32_t expected_rows[] = {0xFF000000, 0xFFFFFFFF, 0xFF7F7F7F,
+                                      0x00000000};
+    for (uint32_t y = 0; y < 4; ++y) {
+      for (uint32_t x = 0; x < 4; ++x) {
+        REQUIRE(texel(x, y) == expected_rows[y]);
+      }
+    }
+  }
+
+  SECTION("DXT5") {
+    // Alpha 255 and 0 endpoints (8-step mode), with 3-bit codes 0, 1, 2, 7 in
+    // the rows, and white color.
+    const uint32_t alpha_codes[] = {0, 1, 2, 7};
+    uint64_t alpha_block = 255;
+    for (uint32_t i = 0; i < 16; ++i) {
+      alpha_block |= uint64_t(alpha_codes[i >> 2]) << (16 + i * 3);
+    }
+    const uint32_t block[] = {uint32_t(alpha_block),
+                              uint32_t(alpha_block >> 32), 0x0000FFFF, 0};
+    REQUIRE(DecodeSubresource(xenos::TextureFormat::k_DXT4_5, false,
+                              MakeLinearGuest(block, 16, 4, 4), host));
+    const uint32_t expected_alphas[] = {255, 0, 255 * 6 / 7, 255 / 7};
+    for (uint32_t y = 0; y < 4; ++y) {
+      for (uint32_t x = 0; x < 4; ++x) {
+        REQUIRE(texel(x, y) == ((expected_alphas[y] << 24) | 0xFFFFFF));
+      }
+    }
+  }
+
+  SECTION("DXT3A") {
+    const uint32_t block[] = {0xFEDCBA98, 0x76543210};
+    REQUIRE(DecodeSubresource(xenos::TextureFormat::k_DXT3A, false,
+                              MakeLinearGuest(block, 8, 4, 4),
+                              MakeHost(host_data, 4)));
+    for (uint32_t y = 0; y < 4; ++y) {
+      for (uint32_t x = 0; x < 4; ++x) {
+        uint32_t nibble = (block[y >> 1] >> ((y & 1) * 16 + x * 4)) & 0xF;
+        REQUIRE(host_data[y * 4 + x] == nibble * 0x11);
+      }
+    }
+  }
+
+  SECTION("CTX1") {
+    // Endpoint 0 is (R 0x40, G 0xFF), endpoint 1 is (R 0xC1, G 0x00), the rows
+    // use codes 0, 1, 2, 3.
+    const uint32_t block[] = {0xC10040FF, 0xFFAA5500};
+    REQUIRE(DecodeSubresource(xenos::TextureFormat::k_CTX1, false,
+                              MakeLinearGuest(block, 8, 4, 4),
+                              MakeHost(host_data, 4 * 2)));
+    const uint16_t expected_rows[] = {0xFF40, 0x00C1, 0xAA6B, 0x5596};
+    for (uint32_t y = 0; y < 4; ++y) {
+      for (uint32_t x = 0; x < 4; ++x) {
+        REQUIRE(LoadHost<uint16_t>(host_data, y * 8 + x * 2) ==
+                expected_rows[y]);
+      }
+    }
+  }
+
+  SECTION("Clipping") {
+    // A 3x2 DXT1 texture - only the texels within it must be written.
+    std::memset(host_data.data(), 0x5A, host_data.size());
+    const uint32_t block[] = {0x0000FFFF, 0};
+    REQUIRE(DecodeSubresource(xenos::TextureFormat::k_DXT1, false,
+                              MakeLinearGuest(block, 8, 3, 2), host));
+    for (uint32_t y = 0; y < 4; ++y) {
+      for (uint32_t x = 0; x < 4; ++x) {
+        REQUIRE(texel(x, y) ==
+                ((x < 3 && y < 2) ? 0xFFFFFFFF : 0x5A5A5A5A));
+      }
+    }
+  }
+}
+
+TEST_CASE("Texel conversion", "[texture_decode]") {
+  std::vector<uint8_t> host_data(8 * 4);
+  HostSubresource host = MakeHost(host_data, host_data.size());
+
+  SECTION("10:11:11 unsigned") {
+    const uint32_t texels[] = {0xFFFFFFFF, 0x00000000};
+    REQUIRE(DecodeSubresource(xenos::TextureFormat::k_10_11_11, false,
+                              MakeLinearGuest(texels, 8, 2, 1), host));
+    REQUIRE(LoadHost<uint64_t>(host_data, 0) == UINT64_MAX);
+    REQUIRE(LoadHost<uint64_t>(host_data, 8) == UINT64_C(0xFFFF000000000000));
+  }
+
+  SECTION("10:11:11 signed") {
+    // -1 (the most negative value clamped), 1, 0.
+    const uint32_t texels[] = {0x200 | (0x3FF << 10)};
+    REQUIRE(DecodeSubresource(xenos::TextureFormat::k_10_11_11, true,
+                              MakeLinearGuest(texels, 4, 1, 1), host));
+    REQUIRE(LoadHost<uint32_t>(host_data, 0) == 0x7FFF8001);
+    REQUIRE(LoadHost<uint32_t>(host_data, 4) == 0x7FFF0000);
+  }
+
+  SECTION("16-bit normalized to float16") {
+    // 1, 0, 0.5 and 1/65535 as a denormal.
+    const uint16_t unorm_texels[] = {0xFFFF, 0x0000, 0x8000, 0x0001};
+    REQUIRE(DecodeSubresource(xenos::TextureFormat::k_16, false,
+                              MakeLinearGuest(unorm_texels, 8, 4, 1), host));
+    REQUIRE(LoadHost<uint64_t>(host_data, 0) == UINT64_C(0x0100380000003C00));
+    // -1 for both -32768 and -32767, 1 and 1/32767 as a denormal.
+    const uint16_t snorm_texels[] = {0x8000, 0x8001, 0x7FFF, 0x0001};
+    REQUIRE(DecodeSubresource(xenos::TextureFormat::k_16, true,
+                              MakeLinearGuest(snorm_texels, 8, 4, 1), host));
+    REQUIRE(LoadHost<uint64_t>(host_data, 0) == UINT64_C(0x02003C00BC00BC00));
+  }
+}
+
+TEST_CASE("Untiling and endian swapping", "[texture_decode]") {
+  constexpr uint32_t kWidth = 80, kHeight = 40, kDepth = 6;
+  for (bool is_3d : {false, true}) {
+    Texture texture = {};
+    texture.dimension =
+        is_3d ? xenos::DataDimension::k3D : xenos::DataDimension::k2DOrStacked;
+    texture.format = xenos::TextureFormat::k_8_8_8_8;
+    texture.is_tiled = true;
+    texture.endian = xenos::Endian::k8in32;
+    texture.pitch = xe::align(kWidth, uint32_t(32)) / 32;
+    texture.width = kWidth;
+    texture.height = kHeight;
+    texture.depth_or_array_size = is_3d ? kDepth : 1;
+    uint32_t base_size, mip_size;
+    GetGuestTextureSize(texture, base_size, mip_size);
+    std::vector<uint8_t> guest_data(base_size);
+    uint32_t depth = is_3d ? kDepth : 1;
+    for (uint32_t z = 0; z < depth; ++z) {
+      for (uint32_t y = 0; y < kHeight; ++y) {
+        for (uint32_t x = 0; x < kWidth; ++x) {
+          int32_t offset =
+              is_3d ? texture_util::GetTiledOffset3D(
+                          x, y, z, texture.pitch * 32, xe::align(kHeight, 32u),
+                          2)
+                    : texture_util::GetTiledOffset2D(x, y, texture.pitch * 32,
+                                                     2);
+          xe::store_and_swap<uint32_t>(guest_data.data() + offset,
+                                       x | (y << 8) | (z << 16));
+        }
+      }
+    }
+    texture.base_data = guest_data.data();
+    DecodedTexture decoded;
+    REQUIRE(DecodeTexture(texture, 0, 0, decoded, 1));
+    REQUIRE(decoded.format == DecodedFormat::kGuestBlocks);
+    REQUIRE(decoded.levels[0].width == kWidth);
+    REQUIRE(decoded.levels[0].height == kHeight);
+    REQUIRE(decoded.levels[0].depth == depth);
+    for (uint32_t z = 0; z < depth; ++z) {
+      for (uint32_t y = 0; y < kHeight; ++y) {
+        for (uint32_t x = 0; x < kWidth; ++x) {
+          REQUIRE(LoadHost<uint32_t>(decoded.data,
+                                     decoded.levels[0].slice_pitch * z +
+                                         decoded.levels[0].row_pitch * y +
+                                         x * 4) == (x | (y << 8) | (z << 16)));
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("Multithreaded decoding", "[texture_decode]") {
+  // Array layers and mips with a packed tail.
+  Texture texture = {};
+  texture.dimension = xenos::DataDimension::k2DOrStacked;
+  texture.format = xenos::TextureFormat::k_DXT4_5;
+  texture.is_tiled = true;
+  texture.has_packed_levels = true;
+  texture.endian = xenos::Endian::k8in16;
+  texture.pitch = 256 / 32;
+  texture.width = 256;
+  texture.height = 128;
+  texture.depth_or_array_size = 3;
+  texture.mip_max_level = 8;
+  uint32_t base_size, mip_size;
+  GetGuestTextureSize(texture, base_size, mip_size);
+  std::vector<uint8_t> base_data(base_size), mips_data(mip_size);
+  FillRandom(base_data, 1);
+  FillRandom(mips_data, 2);
+  texture.base_data = base_data.data();
+  texture.mips_data = mips_data.data();
+
+  DecodedTexture decoded_single, decoded_multi;
+  REQUIRE(DecodeTexture(texture, 0, texture.mip_max_level, decoded_single, 1));
+  REQUIRE(DecodeTexture(texture, 0, texture.mip_max_level, decoded_multi, 4));
+  REQUIRE(decoded_single.array_size == 3);
+  REQUIRE(decoded_single.levels[8].width == 1);
+  REQUIRE(decoded_single.levels[8].height == 1);
+  REQUIRE(decoded_single.data == decoded_multi.data);
+
+  // Only the mips.
+  DecodedTexture decoded_mips;
+  REQUIRE(DecodeTexture(texture, 1, texture.mip_max_level, decoded_mips));
+  REQUIRE(decoded_mips.data.size() ==
+          decoded_single.data.size() - decoded_single.levels[1].offset_bytes);
+  REQUIRE(std::memcmp(decoded_mips.data.data(),
+                      decoded_single.data.data() +
+                          decoded_single.levels[1].offset_bytes,
+                      decoded_mips.data.size()) == 0);
+}
+
+// Not run by default. Run with the "[texture_decode_benchmark]" tag.
+TEST_CASE("Texture decoding performance", "[.][texture_decode_benchmark]") {
+  constexpr uint32_t kSize = 2048;
+  constexpr uint32_t kIterations = 8;
+
+  auto benchmark = [&](const char* name, xenos::TextureFormat format,
+                       bool is_signed, uint32_t thread_count) {
+    Texture texture = {};
+    texture.dimension = xenos::DataDimension::k2DOrStacked;
+    texture.format = format;
+    texture.is_signed = is_signed;
+    texture.is_tiled = true;
+    texture.has_packed_levels = true;
+    texture.endian = xenos::Endian::k8in32;
+    texture.pitch = kSize / 32;
+    texture.width = kSize;
+    texture.height = kSize;
+    texture.depth_or_array_size = 1;
+    texture.mip_max_level = xe::log2_floor(kSize);
+    uint32_t base_size, mip_size;
+    GetGuestTextureSize(texture, base_size, mip_size);
+    std::vector<uint8_t> base_data(base_size), mips_data(mip_size);
+    FillRandom(base_data, 3);
+    FillRandom(mips_data, 4);
+    texture.base_data = base_data.data();
+    texture.mips_data = mips_data.data();
+    DecodedTexture decoded;
+    // Warm up, also allocating the host data.
+    DecodeTexture(texture, 0, texture.mip_max_level, decoded, thread_count);
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < kIterations; ++i) {
+      DecodeTexture(texture, 0, texture.mip_max_level, decoded, thread_count);
+    }
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    fmt::print("{}, {} thread(s): {:.1f} guest MB/s\n", name,
+               thread_count ? fmt::to_string(thread_count) : "all",
+               double(base_size + mip_size) * kIterations / seconds /
+                   (1024.0 * 1024.0));
+  };
+
+  for (uint32_t thread_count : {1u, 0u}) {
+    benchmark("k_8_8_8_8", xenos::TextureFormat::k_8_8_8_8, false,
+              thread_count);
+    benchmark("k_DXT1", xenos::TextureFormat::k_DXT1, false, thread_count);
+    benchmark("k_DXT4_5", xenos::TextureFormat::k_DXT4_5, false,
+              thread_count);
+    benchmark("k_DXN", xenos::TextureFormat::k_DXN, false, thread_count);
+    benchmark("k_CTX1", xenos::TextureFormat::k_CTX1, false, thread_count);
+    benchmark("k_10_11_11 signed", xenos::TextureFormat::k_10_11_11, true,
+              thread_count);
+    benchmark("k_16_16_16_16", xenos::TextureFormat::k_16_16_16_16, false,
+              thread_count);
+  }
+}
+
+}  // namespace xe::gpu::test
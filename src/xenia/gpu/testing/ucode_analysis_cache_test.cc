@@ -0,0 +1,335 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/ucode_analysis_cache.h"
+
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "third_party/catch/include/catch.hpp"
+#include "third_party/fmt/include/fmt/format.h"
+#include "xenia/base/string_buffer.h"
+#include "xenia/gpu/gpu_flags.h"
+#include "xenia/gpu/shader.h"
+#include "xenia/gpu/xenos.h"
+
+namespace xe::gpu::test {
+
+// Vertex fetch, loop and constant usage:
+//   alloc position
+//   exec
+//     vfetch_full r1, r0.x, vf0, Format=FMT_32_32_32_32_FLOAT, Stride=4
+//     setp_gt r1.y
+//     (p) mul r2, r1, c0
+//     (!p) add r2, r1, c1
+//   loop i0, L5
+//   L3:
+//   exec
+//     add r2, r2, c[2+aL]
+//     (p) mul r2.xy, r2, c6
+//   endloop i0, L3
+//   L5:
+//   exec_end
+//     mad oPos, r2, c4, c5
+//     max oPts.xz, r1, c3
+static const uint32_t kVertexShaderUcode[] = {
+    0x00000001, 0x4003C200, 0x10000001, 0x00000005, 0x20077000, 0x10000000,
+    0x00000003, 0x20098000, 0x20000000, 0x00081000, 0x00262688, 0x00000004,
+    0x74000000, 0x00000080, 0xE2010101, 0xC80F0002, 0x18000000, 0x81010000,
+    0xC80F0002, 0x10000000, 0x80010100, 0xC80F0002, 0x80000000, 0x80020200,
+    0xC8030002, 0x18000000, 0x81020600, 0xC80F803E, 0x00000000, 0x8B020405,
+    0xC805803F, 0x00000000, 0x82010300,
+};
+
+// Texture fetch:
+//   exec_end
+//     tfetch2D r1, r0.xy, tf2
+//     max oC0, r1, r1
+static const uint32_t kPixelShaderUcode[] = {
+    0x00012001, 0x00002000, 0x00000000, 0x10281001, 0x1F1FF688,
+    0x00004000, 0xC80F8000, 0x00000000, 0xC2010100,
+};
+
+static std::unique_ptr<Shader> CreateShader(xenos::ShaderType type,
+                                            const uint32_t* ucode_dwords,
+                                            size_t ucode_dword_count) {
+  return std::make_unique<Shader>(type, 0x5543414E414C5953, ucode_dwords,
+                                  ucode_dword_count, std::endian::native);
+}
+
+static void RequireSameAnalysis(const Shader& expected, const Shader& actual) {
+  REQUIRE(actual.is_ucode_analyzed());
+  REQUIRE(actual.ucode_disassembly() == expected.ucode_disassembly());
+  REQUIRE(actual.vertex_bindings().size() == expected.vertex_bindings().size());
+  for (size_t i = 0; i < expected.vertex_bindings().size(); ++i) {
+    const Shader::VertexBinding& expected_binding =
+        expected.vertex_bindings()[i];
+    const Shader::VertexBinding& actual_binding = actual.vertex_bindings()[i];
+    REQUIRE(actual_binding.binding_index == expected_binding.binding_index);
+    REQUIRE(actual_binding.fetch_constant == expected_binding.fetch_constant);
+    REQUIRE(actual_binding.stride_words == expected_binding.stride_words);
+    REQUIRE(actual_binding.attributes.size() ==
+            expected_binding.attributes.size());
+    for (size_t j = 0; j < expected_binding.attributes.size(); ++j) {
+      const ParsedVertexFetchInstruction& expected_fetch =
+          expected_binding.attributes[j].fetch_instr;
+      const ParsedVertexFetchInstruction& actual_fetch =
+          actual_binding.attributes[j].fetch_instr;
+      REQUIRE(std::strcmp(actual_fetch.opcode_name,
+                          expected_fetch.opcode_name) == 0);
+      REQUIRE(actual_fetch.attributes.data_format ==
+              expected_fetch.attributes.data_format);
+      REQUIRE(actual_fetch.attributes.stride ==
+              expected_fetch.attributes.stride);
+      REQUIRE(actual_fetch.operands[1].storage_index ==
+              expected_fetch.operands[1].storage_index);
+    }
+  }
+  REQUIRE(actual.texture_bindings().size() ==
+          expected.texture_bindings().size());
+  for (size_t i = 0; i < expected.texture_bindings().size(); ++i) {
+    const Shader::TextureBinding& expected_binding =
+        expected.texture_bindings()[i];
+    const Shader::TextureBinding& actual_binding = actual.texture_bindings()[i];
+    REQUIRE(actual_binding.binding_index == expected_binding.binding_index);
+    REQUIRE(actual_binding.fetch_constant == expected_binding.fetch_constant);
+    REQUIRE(std::strcmp(actual_binding.fetch_instr.opcode_name,
+                        expected_binding.fetch_instr.opcode_name) == 0);
+    REQUIRE(actual_binding.fetch_instr.dimension ==
+            expected_binding.fetch_instr.dimension);
+  }
+  REQUIRE(std::memcmp(&actual.constant_register_map(),
+                      &expected.constant_register_map(),
+                      sizeof(Shader::ConstantRegisterMap)) == 0);
+  REQUIRE(actual.label_addresses() == expected.label_addresses());
+  REQUIRE(actual.cf_pair_index_bound() == expected.cf_pair_index_bound());
+  REQUIRE(actual.register_static_address_bound() ==
+          expected.register_static_address_bound());
+  REQUIRE(actual.uses_register_dynamic_addressing() ==
+          expected.uses_register_dynamic_addressing());
+  REQUIRE(actual.kills_pixels() == expected.kills_pixels());
+  REQUIRE(actual.uses_texture_fetch_instruction_results() ==
+          expected.uses_texture_fetch_instruction_results());
+  REQUIRE(actual.writes_interpolators() == expected.writes_interpolators());
+  REQUIRE(actual.writes_point_size_edge_flag_kill_vertex() ==
+          expected.writes_point_size_edge_flag_kill_vertex());
+  REQUIRE(actual.writes_depth() == expected.writes_depth());
+  REQUIRE(actual.writes_color_targets() == expected.writes_color_targets());
+  REQUIRE(actual.cf_memexport_info().size() ==
+          expected.cf_memexport_info().size());
+  REQUIRE(actual.memexport_eM_written() == expected.memexport_eM_written());
+  REQUIRE(actual.memexport_stream_constants() ==
+          expected.memexport_stream_constants());
+}
+
+TEST_CASE("Ucode analysis serialization", "[ucode_analysis_cache]") {
+  StringBuffer ucode_disasm_buffer;
+  auto test_shader = [&](xenos::ShaderType type, const uint32_t* ucode_dwords,
+                         size_t ucode_dword_count) {
+    std::unique_ptr<Shader> analyzed_shader =
+        CreateShader(type, ucode_dwords, ucode_dword_count);
+    analyzed_shader->AnalyzeUcode(ucode_disasm_buffer);
+    std::vector<uint8_t> data;
+    analyzed_shader->SerializeUcodeAnalysis(data);
+
+    // The padding of the structures stored directly must be zeroed, not
+    // carried over from the memory they were in. The constant register map is
+    // in the beginning of the data.
+    size_t constant_register_map_padding_offset =
+        offsetof(Shader::ConstantRegisterMap, float_dynamic_addressing) + 1;
+    REQUIRE(constant_register_map_padding_offset <
+            sizeof(Shader::ConstantRegisterMap));
+    for (size_t i = constant_register_map_padding_offset;
+         i < sizeof(Shader::ConstantRegisterMap); ++i) {
+      REQUIRE(data[i] == 0);
+    }
+    std::vector<uint8_t> padded_data = data;
+    std::memset(padded_data.data() + constant_register_map_padding_offset,
+                0xFF,
+                sizeof(Shader::ConstantRegisterMap) -
+                    constant_register_map_padding_offset);
+
+    std::unique_ptr<Shader> restored_shader =
+        CreateShader(type, ucode_dwords, ucode_dword_count);
+    REQUIRE(restored_shader->DeserializeUcodeAnalysis(padded_data.data(),
+                                                      padded_data.size()));
+    RequireSameAnalysis(*analyzed_shader, *restored_shader);
+    std::vector<uint8_t> restored_data;
+    restored_shader->SerializeUcodeAnalysis(restored_data);
+    REQUIRE(restored_data == data);
+
+    // Truncated data must be rejected without modifying the shader.
+    std::unique_ptr<Shader> truncated_shader =
+        CreateShader(type, ucode_dwords, ucode_dword_count);
+    REQUIRE(!truncated_shader->DeserializeUcodeAnalysis(data.data(),
+                                                        data.size() - 1));
+    REQUIRE(!truncated_shader->is_ucode_analyzed());
+    REQUIRE(truncated_shader->ucode_disassembly().empty());
+  };
+  test_shader(xenos::ShaderType::kVertex, kVertexShaderUcode,
+              std::size(kVertexShaderUcode));
+  test_shader(xenos::ShaderType::kPixel, kPixelShaderUcode,
+              std::size(kPixelShaderUcode));
+}
+
+TEST_CASE("UcodeAnalysisCache persistence", "[ucode_analysis_cache]") {
+  std::filesystem::path cache_path =
+      std::filesystem::temp_directory_path() /
+      "xenia_ucode_analysis_cache_test.bin";
+  std::filesystem::remove(cache_path);
+  StringBuffer ucode_disasm_buffer;
+
+  std::unique_ptr<Shader> expected_shader =
+      CreateShader(xenos::ShaderType::kVertex, kVertexShaderUcode,
+                   std::size(kVertexShaderUcode));
+  expected_shader->AnalyzeUcode(ucode_disasm_buffer);
+
+  {
+    UcodeAnalysisCache cache;
+    REQUIRE(cache.Open(cache_path));
+    std::unique_ptr<Shader> shader =
+        CreateShader(xenos::ShaderType::kVertex, kVertexShaderUcode,
+                     std::size(kVertexShaderUcode));
+    REQUIRE(!cache.AnalyzeUcode(*shader, ucode_disasm_buffer));
+    RequireSameAnalysis(*expected_shader, *shader);
+  }
+
+  {
+    UcodeAnalysisCache cache;
+    REQUIRE(cache.Open(cache_path));
+    std::unique_ptr<Shader> shader =
+        CreateShader(xenos::ShaderType::kVertex, kVertexShaderUcode,
+                     std::size(kVertexShaderUcode));
+    REQUIRE(cache.AnalyzeUcode(*shader, ucode_disasm_buffer));
+    RequireSameAnalysis(*expected_shader, *shader);
+    // Same hash, but different ucode.
+    std::unique_ptr<Shader> mismatching_shader = CreateShader(
+        xenos::ShaderType::kPixel, kPixelShaderUcode,
+        std::size(kPixelShaderUcode));
+    REQUIRE(!cache.AnalyzeUcode(*mismatching_shader, ucode_disasm_buffer));
+    REQUIRE(mismatching_shader->is_ucode_analyzed());
+    REQUIRE(mismatching_shader->texture_bindings().size() == 1);
+  }
+
+  // An entry claiming more data than the file contains must be dropped, not
+  // allocated.
+  {
+    std::vector<uint8_t> data;
+    expected_shader->SerializeUcodeAnalysis(data);
+    FILE* file = std::fopen(cache_path.string().c_str(), "r+b");
+    REQUIRE(file);
+    // The only entry is in the end of the file, and its header ends with the
+    // data size and a reserved field.
+    REQUIRE(std::fseek(file,
+                       long(std::filesystem::file_size(cache_path) -
+                            data.size() - sizeof(uint32_t) * 2),
+                       SEEK_SET) == 0);
+    uint32_t data_size = UINT32_MAX;
+    REQUIRE(std::fwrite(&data_size, sizeof(data_size), 1, file) == 1);
+    std::fclose(file);
+  }
+  {
+    UcodeAnalysisCache cache;
+    REQUIRE(cache.Open(cache_path));
+    std::unique_ptr<Shader> shader =
+        CreateShader(xenos::ShaderType::kVertex, kVertexShaderUcode,
+                     std::size(kVertexShaderUcode));
+    REQUIRE(!cache.AnalyzeUcode(*shader, ucode_disasm_buffer));
+    RequireSameAnalysis(*expected_shader, *shader);
+  }
+
+  std::filesystem::remove(cache_path);
+}
+
+TEST_CASE("UcodeAnalysisCache dumps shaders restored from the cache",
+          "[ucode_analysis_cache]") {
+  std::filesystem::path cache_path =
+      std::filesystem::temp_directory_path() /
+      "xenia_ucode_analysis_cache_dump_test.bin";
+  std::filesystem::path dump_path = std::filesystem::temp_directory_path() /
+                                    "xenia_ucode_analysis_cache_dump_test";
+  std::filesystem::remove(cache_path);
+  std::filesystem::remove_all(dump_path);
+  std::filesystem::path dump_shaders_old = cvars::dump_shaders;
+  cvars::dump_shaders = dump_path;
+  StringBuffer ucode_disasm_buffer;
+
+  {
+    UcodeAnalysisCache cache;
+    REQUIRE(cache.Open(cache_path));
+    std::unique_ptr<Shader> shader =
+        CreateShader(xenos::ShaderType::kVertex, kVertexShaderUcode,
+                     std::size(kVertexShaderUcode));
+    REQUIRE(!cache.AnalyzeUcode(*shader, ucode_disasm_buffer));
+  }
+  std::filesystem::remove_all(dump_path);
+
+  {
+    UcodeAnalysisCache cache;
+    REQUIRE(cache.Open(cache_path));
+    std::unique_ptr<Shader> shader =
+        CreateShader(xenos::ShaderType::kVertex, kVertexShaderUcode,
+                     std::size(kVertexShaderUcode));
+    REQUIRE(cache.AnalyzeUcode(*shader, ucode_disasm_buffer));
+    std::string file_prefix =
+        fmt::format("shader_{:016X}.ucode", shader->ucode_data_hash());
+    REQUIRE(std::filesystem::exists(dump_path / (file_prefix + ".bin.vert")));
+    REQUIRE(std::filesystem::exists(dump_path / (file_prefix + ".vert")));
+  }
+
+  cvars::dump_shaders = dump_shaders_old;
+  std::filesystem::remove_all(dump_path);
+  std::filesystem::remove(cache_path);
+}
+
+// Not run by default. Run with the "[ucode_analysis_cache_benchmark]" tag.
+TEST_CASE("Ucode analysis cold and warm performance",
+          "[.][ucode_analysis_cache_benchmark]") {
+  constexpr uint32_t kIterations = 20000;
+  StringBuffer ucode_disasm_buffer;
+
+  std::unique_ptr<Shader> analyzed_shader =
+      CreateShader(xenos::ShaderType::kVertex, kVertexShaderUcode,
+                   std::size(kVertexShaderUcode));
+  analyzed_shader->AnalyzeUcode(ucode_disasm_buffer);
+  std::vector<uint8_t> data;
+  analyzed_shader->SerializeUcodeAnalysis(data);
+
+  auto benchmark = [&](const char* name, auto&& analyze) {
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < kIterations; ++i) {
+      std::unique_ptr<Shader> shader =
+          CreateShader(xenos::ShaderType::kVertex, kVertexShaderUcode,
+                       std::size(kVertexShaderUcode));
+      analyze(*shader);
+    }
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    fmt::print("{}: {:.2f} us per shader\n", name,
+               seconds * 1.0e6 / double(kIterations));
+  };
+
+  benchmark("Cold (AnalyzeUcode)", [&](Shader& shader) {
+    shader.AnalyzeUcode(ucode_disasm_buffer);
+  });
+  benchmark("Warm (DeserializeUcodeAnalysis)", [&](Shader& shader) {
+    shader.DeserializeUcodeAnalysis(data.data(), data.size());
+  });
+}
+
+}  // namespace xe::gpu::test
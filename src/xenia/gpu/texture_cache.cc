@@ -9,10 +9,13 @@
 
 #include "xenia/gpu/texture_cache.h"
 
+#include <iterator>
+
 #include "xenia/base/clock.h"
 #include "xenia/base/cvar.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/profiling.h"
+#include "xenia/base/xxhash.h"
 #include "xenia/gpu/gpu_flags.h"
 
 DEFINE_int32(
@@ -59,6 +62,14 @@ DEFINE_uint32(
     "textures - so with 2x2 resolution scaling, the soft limit will be 360 + "
     "96 MB, and with 3x3, it will be 360 + 216 MB.",
     "GPU");
+DEFINE_bool(
+    texture_cache_deduplicate, false,
+    "Share host textures between guest textures at different addresses "
+    "containing identical data (with the same format and layout), detected by "
+    "hashing the guest data when loading textures. Saves host memory in games "
+    "copying the same texture data to multiple places, at the cost of hashing "
+    "and comparing the guest data on the CPU.",
+    "GPU");
 
 namespace xe {
 namespace gpu {
@@ -142,6 +153,7 @@ TextureCache::TextureCache(const RegisterFile& register_file,
                            uint32_t draw_resolution_scale_x,
                            uint32_t draw_resolution_scale_y)
     : register_file_(register_file),
+      register_dirty_tracker_(register_file),
       shared_memory_(shared_memory),
       draw_resolution_scale_x_(draw_resolution_scale_x),
       draw_resolution_scale_y_(draw_resolution_scale_y),
@@ -230,6 +242,7 @@ void TextureCache::CompletedSubmissionUpdated(
       // any texture has been destroyed.
       ResetTextureBindings();
     }
+    ForgetTextureContent(*texture);
     // Remove the texture from the map and destroy it via its unique_ptr.
     auto found_texture_it = textures_.find(texture->key());
     assert_true(found_texture_it != textures_.end());
@@ -318,9 +331,22 @@ void TextureCache::RequestTextures(uint32_t used_texture_mask) {
     ResetTextureBindings();
   }
 
+  // Also catch fetch constant writes not reported via
+  // TextureFetchConstantWritten.
+  texture_bindings_in_sync_ &= ~uint32_t(register_dirty_tracker_.GetDirtyBits(
+      RegisterFile::DirtyGroup::kFetchConstants));
+  register_dirty_tracker_.ClearDirty(RegisterFile::DirtyGroup::kFetchConstants);
+
+  uint32_t textures_remaining = used_texture_mask & ~texture_bindings_in_sync_;
+  register_dirty_tracker_.CountUpdates(
+      xe::bit_count(textures_remaining),
+      xe::bit_count(used_texture_mask & texture_bindings_in_sync_));
+  if (!textures_remaining) {
+    return;
+  }
+
   // Update the texture keys and the textures.
   uint32_t bindings_changed = 0;
-  uint32_t textures_remaining = used_texture_mask & ~texture_bindings_in_sync_;
   uint32_t index = 0;
 
   Texture* textures_to_load[64];  // max bits = 32, can be unsigned + signed
@@ -574,6 +600,10 @@ void TextureCache::WatchCallback(const global_unique_lock_type& global_lock,
 
 void TextureCache::DestroyAllTextures(bool from_destructor) {
   ResetTextureBindings(from_destructor);
+  while (!texture_content_aliases_.empty()) {
+    DestroyContentAlias(texture_content_aliases_.begin());
+  }
+  textures_by_content_.clear();
   textures_.clear();
   COUNT_profile_set("gpu/texture_cache/textures", 0);
 }
@@ -623,6 +653,13 @@ TextureCache::Texture* TextureCache::FindOrCreateTexture(TextureKey key) {
     return found_texture_it->second.get();
   }
 
+  if (cvars::texture_cache_deduplicate && !key.scaled_resolve) {
+    Texture* content_alias_texture = FindOrCreateContentAlias(key);
+    if (content_alias_texture) {
+      return content_alias_texture;
+    }
+  }
+
   // Create the texture and add it to the map.
   Texture* texture;
   {
@@ -746,6 +783,7 @@ void TextureCache::LoadTexturesData(Texture** textures, uint32_t n_textures) {
       texture.SetBaseResolved(base_resolved);
       texture.SetMipsResolved(mips_resolved);
     }
+    UpdateTextureContentHash(texture);
     // reque for makeuptodatandwatch
     textures[i] = &texture;
   }
@@ -841,6 +879,7 @@ bool TextureCache::LoadTextureData(Texture& texture) {
     texture.SetBaseResolved(base_resolved);
     texture.SetMipsResolved(mips_resolved);
   }
+  UpdateTextureContentHash(texture);
 
   // Mark the ranges as uploaded and watch them. This is needed for scaled
   // resolves as well to detect when the CPU wants to reuse the memory for a
@@ -975,6 +1014,238 @@ void TextureCache::UpdateTexturesTotalHostMemoryUsage(uint64_t add,
                              20));
 }
 
+TextureCache::TextureKey TextureCache::GetContentKey(TextureKey key) {
+  key.base_page = key.base_page != 0;
+  key.mip_page = key.mip_page != 0;
+  return key;
+}
+
+bool TextureCache::GetTextureContent(const TextureKey& key,
+                                     TextureContent& content_out) {
+  texture_util::TextureGuestLayout guest_layout = key.GetGuestLayout();
+  content_out.base_size = guest_layout.base.level_data_extent_bytes;
+  content_out.mips_size = guest_layout.mips_total_extent_bytes;
+  content_out.base_data = nullptr;
+  content_out.mips_data = nullptr;
+  if (content_out.base_size) {
+    content_out.base_data = shared_memory().GetCpuWrittenRangeData(
+        key.base_page << 12, content_out.base_size);
+    if (!content_out.base_data) {
+      return false;
+    }
+  }
+  if (content_out.mips_size) {
+    content_out.mips_data = shared_memory().GetCpuWrittenRangeData(
+        key.mip_page << 12, content_out.mips_size);
+    if (!content_out.mips_data) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint64_t TextureCache::HashTextureContent(const TextureKey& key,
+                                          const TextureContent& content) {
+  TextureKey content_key = GetContentKey(key);
+  XXH3_state_t hash_state;
+  XXH3_64bits_reset(&hash_state);
+  XXH3_64bits_update(&hash_state, &content_key, sizeof(content_key));
+  XXH3_64bits_update(&hash_state, content.base_data, content.base_size);
+  XXH3_64bits_update(&hash_state, content.mips_data, content.mips_size);
+  return XXH3_64bits_digest(&hash_state);
+}
+
+void TextureCache::UpdateTextureContentHash(Texture& texture) {
+  if (texture.has_content_hash()) {
+    auto content_it = textures_by_content_.find(texture.content_hash());
+    if (content_it != textures_by_content_.end() &&
+        content_it->second == &texture) {
+      textures_by_content_.erase(content_it);
+    }
+    // Aliases using the texture will be dropped if the hash is different now.
+    texture.ResetContentHash();
+  }
+  // Resolved data is only up to date on the GPU.
+  if (!cvars::texture_cache_deduplicate || texture.key().scaled_resolve ||
+      texture.IsResolved()) {
+    return;
+  }
+  TextureContent content;
+  if (!GetTextureContent(texture.key(), content)) {
+    return;
+  }
+  SCOPE_profile_cpu_f("gpu");
+  uint64_t content_hash = HashTextureContent(texture.key(), content);
+  texture.SetContentHash(content_hash);
+  // If another texture with the same data is already registered, keep it as
+  // it's the one the aliases are likely using.
+  textures_by_content_.emplace(content_hash, &texture);
+}
+
+TextureCache::Texture* TextureCache::FindOrCreateContentAlias(
+    const TextureKey& key) {
+  // Check if there's an existing alias that's still up to date.
+  auto alias_it = texture_content_aliases_.find(key);
+  if (alias_it != texture_content_aliases_.end()) {
+    TextureContentAlias& alias = *alias_it->second;
+    bool alias_up_to_date;
+    {
+      auto global_lock = global_critical_region_.Acquire();
+      alias_up_to_date = !alias.outdated &&
+                         !alias.texture->base_outdated(global_lock) &&
+                         !alias.texture->mips_outdated(global_lock);
+    }
+    if (alias_up_to_date && alias.texture->has_content_hash() &&
+        alias.texture->content_hash() == alias.content_hash) {
+      return alias.texture;
+    }
+    DestroyContentAlias(alias_it);
+  }
+
+  if (textures_by_content_.empty()) {
+    return nullptr;
+  }
+
+  SCOPE_profile_cpu_f("gpu");
+
+  // Request the ranges so modifications of them will trigger the watches of
+  // the alias.
+  texture_util::TextureGuestLayout guest_layout = key.GetGuestLayout();
+  bool base_resolved = false, mips_resolved = false;
+  if (!shared_memory().RequestRange(key.base_page << 12,
+                                    guest_layout.base.level_data_extent_bytes,
+                                    &base_resolved) ||
+      !shared_memory().RequestRange(key.mip_page << 12,
+                                    guest_layout.mips_total_extent_bytes,
+                                    &mips_resolved) ||
+      base_resolved || mips_resolved) {
+    return nullptr;
+  }
+  TextureContent content;
+  if (!GetTextureContent(key, content)) {
+    return nullptr;
+  }
+  uint64_t content_hash = HashTextureContent(key, content);
+  auto content_it = textures_by_content_.find(content_hash);
+  if (content_it == textures_by_content_.end()) {
+    return nullptr;
+  }
+  Texture* texture = content_it->second;
+  if (GetContentKey(texture->key()) != GetContentKey(key) ||
+      !texture->has_content_hash() ||
+      texture->content_hash() != content_hash) {
+    return nullptr;
+  }
+  {
+    auto global_lock = global_critical_region_.Acquire();
+    if (texture->base_outdated(global_lock) ||
+        texture->mips_outdated(global_lock)) {
+      return nullptr;
+    }
+  }
+  // Compare the data itself rather than trusting the hash.
+  TextureContent texture_content;
+  if (!GetTextureContent(texture->key(), texture_content) ||
+      std::memcmp(content.base_data, texture_content.base_data,
+                  content.base_size) ||
+      std::memcmp(content.mips_data, texture_content.mips_data,
+                  content.mips_size)) {
+    return nullptr;
+  }
+
+  auto alias = std::make_unique<TextureContentAlias>();
+  alias->key = key;
+  alias->texture = texture;
+  alias->content_hash = content_hash;
+  alias->host_memory_saved = texture->GetHostMemoryUsage();
+  {
+    auto global_lock = global_critical_region_.Acquire();
+    if (content.base_size) {
+      alias->base_watch_handle = shared_memory().WatchMemoryRange(
+          key.base_page << 12, content.base_size, ContentAliasWatchCallback,
+          this, alias.get(), 0);
+    }
+    if (content.mips_size) {
+      alias->mips_watch_handle = shared_memory().WatchMemoryRange(
+          key.mip_page << 12, content.mips_size, ContentAliasWatchCallback,
+          this, alias.get(), 1);
+    }
+  }
+  texture->SetContentAliasCount(texture->content_alias_count() + 1);
+  ++content_deduplication_statistics_.alias_count;
+  content_deduplication_statistics_.host_memory_saved +=
+      alias->host_memory_saved;
+  texture_content_aliases_.emplace(key, std::move(alias));
+  UpdateContentDeduplicationStatistics();
+  key.LogAction("Deduplicated");
+  return texture;
+}
+
+void TextureCache::DestroyContentAlias(
+    TextureContentAliasMap::iterator alias_it) {
+  TextureContentAlias& alias = *alias_it->second;
+  if (alias.mips_watch_handle) {
+    shared_memory().UnwatchMemoryRange(alias.mips_watch_handle);
+  }
+  if (alias.base_watch_handle) {
+    shared_memory().UnwatchMemoryRange(alias.base_watch_handle);
+  }
+  assert_not_zero(alias.texture->content_alias_count());
+  alias.texture->SetContentAliasCount(alias.texture->content_alias_count() -
+                                      1);
+  --content_deduplication_statistics_.alias_count;
+  content_deduplication_statistics_.host_memory_saved -=
+      alias.host_memory_saved;
+  texture_content_aliases_.erase(alias_it);
+  UpdateContentDeduplicationStatistics();
+}
+
+void TextureCache::ForgetTextureContent(Texture& texture) {
+  if (texture.content_alias_count()) {
+    for (auto alias_it = texture_content_aliases_.begin();
+         alias_it != texture_content_aliases_.end();) {
+      auto alias_next_it = std::next(alias_it);
+      if (alias_it->second->texture == &texture) {
+        DestroyContentAlias(alias_it);
+      }
+      alias_it = alias_next_it;
+    }
+    assert_zero(texture.content_alias_count());
+  }
+  if (texture.has_content_hash()) {
+    auto content_it = textures_by_content_.find(texture.content_hash());
+    if (content_it != textures_by_content_.end() &&
+        content_it->second == &texture) {
+      textures_by_content_.erase(content_it);
+    }
+    texture.ResetContentHash();
+  }
+}
+
+void TextureCache::UpdateContentDeduplicationStatistics() {
+  COUNT_profile_set("gpu/texture_cache/content_aliases",
+                    content_deduplication_statistics_.alias_count);
+  COUNT_profile_set(
+      "gpu/texture_cache/content_alias_host_memory_saved_mb",
+      uint32_t((content_deduplication_statistics_.host_memory_saved +
+                ((UINT32_C(1) << 20) - 1)) >>
+               20));
+}
+
+void TextureCache::ContentAliasWatchCallback(
+    [[maybe_unused]] const global_unique_lock_type& global_lock, void* context,
+    void* data, uint64_t argument, bool invalidated_by_gpu) {
+  TextureContentAlias& alias = *static_cast<TextureContentAlias*>(data);
+  alias.outdated = true;
+  if (argument) {
+    alias.mips_watch_handle = nullptr;
+  } else {
+    alias.base_watch_handle = nullptr;
+  }
+  static_cast<TextureCache*>(context)->texture_became_outdated_.store(
+      true, std::memory_order_release);
+}
+
 bool TextureCache::IsRangeScaledResolved(uint32_t start_unscaled,
                                          uint32_t length_unscaled) {
   if (!IsDrawResolutionScaled()) {
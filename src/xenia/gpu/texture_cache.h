@@ -116,6 +116,23 @@ class TextureCache {
   }
 
   virtual void RequestTextures(uint32_t used_texture_mask);
+  // Texture bindings updated and reused in RequestTextures in the last frame.
+  const RegisterFile::DirtyTracker::Statistics&
+  last_frame_texture_binding_statistics() const {
+    return register_dirty_tracker_.last_frame_statistics();
+  }
+
+  struct ContentDeduplicationStatistics {
+    // Texture keys currently using the host texture of another key with the
+    // same guest data.
+    uint32_t alias_count;
+    // Host memory that separate textures for the aliased keys would use.
+    uint64_t host_memory_saved;
+  };
+  const ContentDeduplicationStatistics& content_deduplication_statistics()
+      const {
+    return content_deduplication_statistics_;
+  }
 
   // "ActiveTexture" means as of the latest RequestTextures call.
 
@@ -257,6 +274,22 @@ class TextureCache {
     }
     bool IsResolved() const { return base_resolved_ || mips_resolved_; }
 
+    // Hash of the guest data of the base and the mips, if it was loaded
+    // entirely from CPU-written memory, for sharing the texture with keys at
+    // other addresses containing the same data.
+    bool has_content_hash() const { return has_content_hash_; }
+    uint64_t content_hash() const { return content_hash_; }
+    void SetContentHash(uint64_t content_hash) {
+      content_hash_ = content_hash;
+      has_content_hash_ = true;
+    }
+    void ResetContentHash() { has_content_hash_ = false; }
+    // Number of other keys using this texture.
+    uint32_t content_alias_count() const { return content_alias_count_; }
+    void SetContentAliasCount(uint32_t content_alias_count) {
+      content_alias_count_ = content_alias_count;
+    }
+
     bool base_outdated(const global_unique_lock_type& global_lock) const {
       return base_outdated_;
     }
@@ -305,6 +338,10 @@ class TextureCache {
     bool base_resolved_;
     bool mips_resolved_;
 
+    uint64_t content_hash_ = 0;
+    bool has_content_hash_ = false;
+    uint32_t content_alias_count_ = 0;
+
     // These are to be accessed within the global critical region to synchronize
     // with shared memory.
     // Whether the recent base level data needs reloading from the memory.
@@ -600,8 +637,55 @@ class TextureCache {
   virtual void UpdateTextureBindingsImpl(uint32_t fetch_constant_mask) {}
 
  private:
+  // Guest data of a texture readable on the CPU.
+  struct TextureContent {
+    const uint8_t* base_data;
+    uint32_t base_size;
+    const uint8_t* mips_data;
+    uint32_t mips_size;
+  };
+
+  // A key with the same guest data as an existing texture at other addresses,
+  // using its host texture rather than a separate copy. The alias is dropped
+  // when the data at its own addresses is modified, as well as when the
+  // texture it's using is modified or destroyed.
+  struct TextureContentAlias {
+    TextureKey key;
+    Texture* texture;
+    // Content hash of the texture when the alias was created.
+    uint64_t content_hash;
+    uint64_t host_memory_saved;
+    // To be accessed within the global critical region.
+    bool outdated = false;
+    SharedMemory::WatchHandle base_watch_handle = nullptr;
+    SharedMemory::WatchHandle mips_watch_handle = nullptr;
+  };
+  using TextureContentAliasMap =
+      std::unordered_map<TextureKey, std::unique_ptr<TextureContentAlias>,
+                         TextureKey::Hasher>;
+
   void UpdateTexturesTotalHostMemoryUsage(uint64_t add, uint64_t subtract);
 
+  // The key without the addresses, only with whether the base and the mips
+  // are present, for comparing the layout of textures at different addresses.
+  static TextureKey GetContentKey(TextureKey key);
+  // Returns false if the data can't be read on the CPU.
+  bool GetTextureContent(const TextureKey& key, TextureContent& content_out);
+  static uint64_t HashTextureContent(const TextureKey& key,
+                                     const TextureContent& content);
+  // Called after loading the data of the texture.
+  void UpdateTextureContentHash(Texture& texture);
+  // Returns an existing texture with the same data as the key at different
+  // addresses, or nullptr if there's none or deduplication is not possible.
+  Texture* FindOrCreateContentAlias(const TextureKey& key);
+  void DestroyContentAlias(TextureContentAliasMap::iterator alias_it);
+  // Drops the aliases and the content hash of a texture being destroyed.
+  void ForgetTextureContent(Texture& texture);
+  void UpdateContentDeduplicationStatistics();
+  static void ContentAliasWatchCallback(
+      const global_unique_lock_type& global_lock, void* context, void* data,
+      uint64_t argument, bool invalidated_by_gpu);
+
   // Shared memory callback for texture data invalidation.
   static void WatchCallback(const global_unique_lock_type& global_lock,
                             void* context, void* data, uint64_t argument,
@@ -620,6 +704,8 @@ class TextureCache {
       uint32_t address_last, bool invalidated_by_gpu);
 
   const RegisterFile& register_file_;
+  // For fetch constants written since the last RequestTextures.
+  RegisterFile::DirtyTracker register_dirty_tracker_;
   SharedMemory& shared_memory_;
   uint32_t draw_resolution_scale_x_;
   uint32_t draw_resolution_scale_y_;
@@ -648,6 +734,12 @@ class TextureCache {
 
   uint64_t textures_total_host_memory_usage_ = 0;
 
+  // Textures with a content hash - one for each hash if multiple textures
+  // with the same data were loaded before either was hashed.
+  std::unordered_map<uint64_t, Texture*> textures_by_content_;
+  TextureContentAliasMap texture_content_aliases_;
+  ContentDeduplicationStatistics content_deduplication_statistics_ = {};
+
   Texture* texture_used_first_ = nullptr;
   Texture* texture_used_last_ = nullptr;
 
@@ -0,0 +1,1195 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/texture_decode.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+
+#include "xenia/base/assert.h"
+#include "xenia/base/math.h"
+#include "xenia/base/profiling.h"
+#include "xenia/base/threading.h"
+#include "xenia/gpu/texture_info.h"
+#include "xenia/gpu/texture_util.h"
+
+namespace xe {
+namespace gpu {
+namespace texture_decode {
+
+// The conversion functions below are direct ports of the ones in
+// shaders/pixel_formats.xesli, processing one block or texel at a time instead
+// of several, and must be kept in sync with them.
+
+// Converts the two endpoints of a DXT color block to 8 bits per component
+// with 2 bits of overflow space between each component.
+static void DXTColorEndpointsToBGR8In10(uint32_t bgr_end_565,
+                                        uint32_t& end_0_out,
+                                        uint32_t& end_1_out) {
+  uint32_t end_0 = ((bgr_end_565 << 3) & (31u << 3)) |
+                   ((bgr_end_565 << (12 - 5)) & (63u << 12)) |
+                   ((bgr_end_565 << (23 - 11)) & (31u << 23));
+  uint32_t end_1 = ((bgr_end_565 >> (16 - 3)) & (31u << 3)) |
+                   ((bgr_end_565 >> (21 - 12)) & (63u << 12)) |
+                   ((bgr_end_565 >> (27 - 23)) & (31u << 23));
+  end_0 |= (end_0 >> 5) & (7u | (7u << 20));
+  end_0 |= (end_0 >> 6) & (3u << 10);
+  end_1 |= (end_1 >> 5) & (7u | (7u << 20));
+  end_1 |= (end_1 >> 6) & (3u << 10);
+  end_0_out = end_0;
+  end_1_out = end_1;
+}
+
+static uint32_t DXTHighColorWeights(uint32_t codes) {
+  codes = ((codes & 0x55555555u) << 1) | ((codes & 0xAAAAAAAAu) >> 1);
+  return codes ^ ((codes & 0xAAAAAAAAu) >> 1);
+}
+
+// Writes 4 R8G8B8A8 texels with zero alpha.
+static void DXTOpaqueRowToRGB8(uint32_t end_0, uint32_t end_1,
+                               uint32_t weights_high, uint32_t* row_out) {
+  for (uint32_t i = 0; i < 4; ++i) {
+    uint32_t bgr_3x = ((~weights_high >> (i * 2)) & 3) * end_0 +
+                      ((weights_high >> (i * 2)) & 3) * end_1;
+    row_out[i] = (((bgr_3x & 1023) / 3) << 16) |
+                 ((((bgr_3x >> 10) & 1023) / 3) << 8) | ((bgr_3x >> 20) / 3);
+  }
+}
+
+static uint32_t DXT1TransWeights(uint32_t codes) {
+  codes = ~codes;
+  return codes ^ ((codes & 0x55555555u) << 1);
+}
+
+static void DXT1TransRowToRGBA8(uint32_t end_0, uint32_t end_1,
+                                uint32_t weights, uint32_t* row_out) {
+  uint32_t weights_sums_log2 = weights & ((weights & 0xAAAAAAAAu) >> 1);
+  uint32_t weights_alpha =
+      (weights & 0x55555555u) | ((weights & 0xAAAAAAAAu) >> 1);
+  for (uint32_t i = 0; i < 4; ++i) {
+    uint32_t bgr_scaled = ((weights >> (i * 2)) & 1) * end_0 +
+                          ((weights >> (i * 2 + 1)) & 1) * end_1;
+    uint32_t bgr_shift = (weights_sums_log2 >> (i * 2)) & 1;
+    row_out[i] = (((bgr_scaled & 1023) >> bgr_shift) << 16) +
+                 ((((bgr_scaled >> 10) & 1023) >> bgr_shift) << 8) +
+                 ((bgr_scaled >> 20) >> bgr_shift) +
+                 ((weights_alpha >> (i * 2)) & 1) * 0xFF000000u;
+  }
+}
+
+static uint32_t DXT5High8StepAlphaWeights(uint32_t codes_24b) {
+  uint32_t is_first = ((codes_24b & 0x249249u) |
+                       ((codes_24b & 0x492492u) >> 1) |
+                       ((codes_24b & 0x924924u) >> 2)) ^
+                      0x249249u;
+  uint32_t is_second = (codes_24b & 0x249249u) &
+                       ~((codes_24b & 0x492492u) >> 1) &
+                       ~((codes_24b & 0x924924u) >> 2);
+  return ((codes_24b | is_first) - 0x249249u) | is_second | (is_second << 1) |
+         (is_second << 2);
+}
+
+static uint32_t DXT5High6StepAlphaWeights(uint32_t codes_24b) {
+  uint32_t is_constant = codes_24b & 0x492492u & ((codes_24b & 0x924924u) >> 1);
+  is_constant |= (is_constant << 1) | (is_constant >> 1);
+  uint32_t constant_values =
+      ((codes_24b & 0x249249u) | (0x492492u | 0x924924u)) & is_constant;
+  uint32_t is_first = ((codes_24b & 0x249249u) |
+                       ((codes_24b & 0x492492u) >> 1) |
+                       ((codes_24b & 0x924924u) >> 2)) ^
+                      0x249249u;
+  uint32_t is_second = (codes_24b & 0x249249u) &
+                       ~((codes_24b & 0x492492u) >> 1) &
+                       ~((codes_24b & 0x924924u) >> 2);
+  codes_24b =
+      ((codes_24b | is_first) - 0x249249u) | is_second | (is_second << 2);
+  return (codes_24b & ~is_constant) | constant_values;
+}
+
+static uint32_t DXT5HighAlphaWeights(uint32_t end_0, uint32_t end_1,
+                                     uint32_t codes_24b) {
+  return (end_0 <= end_1) ? DXT5High6StepAlphaWeights(codes_24b)
+                          : DXT5High8StepAlphaWeights(codes_24b);
+}
+
+// Returns 4 packed 8-bit alpha values of a row.
+static uint32_t DXT5RowToA8(uint32_t end_0, uint32_t end_1, uint32_t weights) {
+  uint32_t row = 0;
+  if (end_0 <= end_1) {
+    uint32_t is_constant = weights & 0x492u & ((weights & 0x924u) >> 1);
+    is_constant |= (is_constant << 1) | (is_constant >> 1);
+    uint32_t weights_high = weights & ~is_constant;
+    uint32_t weights_low = ((5u * 0x249u) - weights_high) & ~is_constant;
+    for (uint32_t i = 0; i < 4; ++i) {
+      row |= ((end_0 * ((weights_low >> (i * 3)) & 7) +
+               end_1 * ((weights_high >> (i * 3)) & 7)) /
+              5)
+             << (i * 8);
+    }
+    uint32_t constant_values = weights & is_constant;
+    constant_values = (constant_values & 1) |
+                      ((constant_values & (1u << 3)) << (8 - 3)) |
+                      ((constant_values & (1u << 6)) << (16 - 6)) |
+                      ((constant_values & (1u << 9)) << (24 - 9));
+    row += constant_values * 0xFF;
+  } else {
+    uint32_t weights_low = ~weights;
+    for (uint32_t i = 0; i < 4; ++i) {
+      row |= ((end_0 * ((weights_low >> (i * 3)) & 7) +
+               end_1 * ((weights >> (i * 3)) & 7)) /
+              7)
+             << (i * 8);
+    }
+  }
+  return row;
+}
+
+// Decodes a DXT5 / DXT5A / DXN alpha block to 4 rows of 4 packed A8 values.
+static void DXT5AlphaBlockToA8(uint32_t block_0, uint32_t block_1,
+                               uint32_t* rows_out) {
+  uint32_t end_0 = block_0 & 0xFF;
+  uint32_t end_1 = (block_0 >> 8) & 0xFF;
+  uint32_t weights = DXT5HighAlphaWeights(
+      end_0, end_1, (block_0 >> 16) | ((block_1 & 0xFF) << 16));
+  rows_out[0] = DXT5RowToA8(end_0, end_1, weights);
+  rows_out[1] = DXT5RowToA8(end_0, end_1, weights >> 12);
+  weights = DXT5HighAlphaWeights(end_0, end_1, block_1 >> 8);
+  rows_out[2] = DXT5RowToA8(end_0, end_1, weights);
+  rows_out[3] = DXT5RowToA8(end_0, end_1, weights >> 12);
+}
+
+// Assuming the original number has only 10 bits.
+static uint32_t SNorm10To16(uint32_t s10) {
+  uint32_t sign = s10 >> 9;
+  if (s10 == 0x200) {
+    s10 = 0x201;
+  }
+  s10 = (s10 ^ (sign ? 0x3FFu : 0u)) + sign;
+  s10 = (s10 << 6) | (s10 >> 3);
+  return (s10 ^ (sign ? 0xFFFFu : 0u)) + sign;
+}
+
+// Assuming the original number has only 11 bits.
+static uint32_t SNorm11To16(uint32_t s11) {
+  uint32_t sign = s11 >> 10;
+  if (s11 == 0x400) {
+    s11 = 0x401;
+  }
+  s11 = (s11 ^ (sign ? 0x7FFu : 0u)) + sign;
+  s11 = (s11 << 5) | (s11 >> 5);
+  return (s11 ^ (sign ? 0xFFFFu : 0u)) + sign;
+}
+
+// packHalf2x16 / f32tof16 rounding - to the nearest even, with denormals
+// preserved. Only for the [-1, 1] range of normalized values.
+static uint16_t Float32To16(float value) {
+  uint32_t f32 = xe::memory::Reinterpret<uint32_t>(value);
+  uint32_t sign = (f32 >> 16) & 0x8000;
+  uint32_t f32_abs = f32 & 0x7FFFFFFF;
+  uint32_t f16_abs;
+  if (f32_abs >= 0x38800000u) {
+    // Normalized.
+    f16_abs = (f32_abs >> 13) - (112u << 10);
+    uint32_t remainder = f32_abs & 0x1FFF;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (f16_abs & 1))) {
+      ++f16_abs;
+    }
+  } else {
+    // Denormalized or zero.
+    uint32_t shift = 126 - (f32_abs >> 23);
+    if (shift > 24) {
+      f16_abs = 0;
+    } else {
+      uint32_t mantissa = (f32_abs & 0x7FFFFF) | 0x800000;
+      f16_abs = mantissa >> shift;
+      uint32_t remainder = mantissa & ((UINT32_C(1) << shift) - 1);
+      uint32_t half = UINT32_C(1) << (shift - 1);
+      if (remainder > half || (remainder == half && (f16_abs & 1))) {
+        ++f16_abs;
+      }
+    }
+  }
+  return uint16_t(sign | f16_abs);
+}
+
+static uint16_t UNorm16ToFloat16(uint32_t n16) {
+  return Float32To16(float(n16) * float(1.0 / 65535.0));
+}
+
+static uint16_t SNorm16ToFloat16(uint32_t s16) {
+  return Float32To16(
+      std::max(-1.0f, float(int16_t(s16)) * float(1.0 / 32767.0)));
+}
+
+// Decoders of a single guest block. kGuestBytes of the endian-swapped guest
+// block (for blocks smaller than 4 bytes, in the low bits of the dword) are
+// converted to kOutputWidth x kOutputHeight elements of kBytesPerElement.
+
+struct DecoderDXT1 {
+  static constexpr uint32_t kGuestBytes = 8;
+  static constexpr uint32_t kOutputWidth = 4;
+  static constexpr uint32_t kOutputHeight = 4;
+  static constexpr uint32_t kBytesPerElement = 4;
+  static void Decode(const uint32_t* block, uint8_t* out, size_t row_pitch) {
+    uint32_t end_0, end_1;
+    DXTColorEndpointsToBGR8In10(block[0], end_0, end_1);
+    bool is_trans = end_0 <= end_1;
+    uint32_t weights =
+        is_trans ? DXT1TransWeights(block[1]) : DXTHighColorWeights(block[1]);
+    for (uint32_t i = 0; i < 4; ++i) {
+      uint32_t row[4];
+      if (is_trans) {
+        DXT1TransRowToRGBA8(end_0, end_1, weights >> (i * 8), row);
+      } else {
+        DXTOpaqueRowToRGB8(end_0, end_1, weights >> (i * 8), row);
+        for (uint32_t j = 0; j < 4; ++j) {
+          row[j] |= 0xFF000000u;
+        }
+      }
+      std::memcpy(out + row_pitch * i, row, sizeof(row));
+    }
+  }
+};
+
+struct DecoderDXT3 {
+  static constexpr uint32_t kGuestBytes = 16;
+  static constexpr uint32_t kOutputWidth = 4;
+  static constexpr uint32_t kOutputHeight = 4;
+  static constexpr uint32_t kBytesPerElement = 4;
+  static void Decode(const uint32_t* block, uint8_t* out, size_t row_pitch) {
+    uint32_t end_0, end_1;
+    DXTColorEndpointsToBGR8In10(block[2], end_0, end_1);
+    uint32_t weights = DXTHighColorWeights(block[3]);
+    for (uint32_t i = 0; i < 4; ++i) {
+      uint32_t row[4];
+      DXTOpaqueRowToRGB8(end_0, end_1, weights >> (i * 8), row);
+      uint32_t alphas = block[i >> 1] >> ((i & 1) * 16);
+      for (uint32_t j = 0; j < 4; ++j) {
+        row[j] += ((alphas >> (j * 4)) & 0xF) * 0x11000000u;
+      }
+      std::memcpy(out + row_pitch * i, row, sizeof(row));
+    }
+  }
+};
+
+struct DecoderDXT5 {
+  static constexpr uint32_t kGuestBytes = 16;
+  static constexpr uint32_t kOutputWidth = 4;
+  static constexpr uint32_t kOutputHeight = 4;
+  static constexpr uint32_t kBytesPerElement = 4;
+  static void Decode(const uint32_t* block, uint8_t* out, size_t row_pitch) {
+    uint32_t end_0, end_1;
+    DXTColorEndpointsToBGR8In10(block[2], end_0, end_1);
+    uint32_t weights = DXTHighColorWeights(block[3]);
+    uint32_t alpha_rows[4];
+    DXT5AlphaBlockToA8(block[0], block[1], alpha_rows);
+    for (uint32_t i = 0; i < 4; ++i) {
+      uint32_t row[4];
+      DXTOpaqueRowToRGB8(end_0, end_1, weights >> (i * 8), row);
+      for (uint32_t j = 0; j < 4; ++j) {
+        row[j] |= (alpha_rows[i] << (24 - j * 8)) & 0xFF000000u;
+      }
+      std::memcpy(out + row_pitch * i, row, sizeof(row));
+    }
+  }
+};
+
+struct DecoderDXN {
+  static constexpr uint32_t kGuestBytes = 16;
+  static constexpr uint32_t kOutputWidth = 4;
+  static constexpr uint32_t kOutputHeight = 4;
+  static constexpr uint32_t kBytesPerElement = 2;
+  static void Decode(const uint32_t* block, uint8_t* out, size_t row_pitch) {
+    uint32_t r_rows[4], g_rows[4];
+    DXT5AlphaBlockToA8(block[0], block[1], r_rows);
+    DXT5AlphaBlockToA8(block[2], block[3], g_rows);
+    for (uint32_t i = 0; i < 4; ++i) {
+      uint8_t* row = out + row_pitch * i;
+      for (uint32_t j = 0; j < 4; ++j) {
+        row[j * 2] = uint8_t(r_rows[i] >> (j * 8));
+        row[j * 2 + 1] = uint8_t(g_rows[i] >> (j * 8));
+      }
+    }
+  }
+};
+
+struct DecoderCTX1 {
+  static constexpr uint32_t kGuestBytes = 8;
+  static constexpr uint32_t kOutputWidth = 4;
+  static constexpr uint32_t kOutputHeight = 4;
+  static constexpr uint32_t kBytesPerElement = 2;
+  static void Decode(const uint32_t* block, uint8_t* out, size_t row_pitch) {
+    // R is in the higher bits of each endpoint.
+    uint32_t end_0_r = (block[0] >> 8) & 0xFF;
+    uint32_t end_0_g = block[0] & 0xFF;
+    uint32_t end_1_r = block[0] >> 24;
+    uint32_t end_1_g = (block[0] >> 16) & 0xFF;
+    uint32_t weights_high = DXTHighColorWeights(block[1]);
+    for (uint32_t i = 0; i < 4; ++i) {
+      uint8_t* row = out + row_pitch * i;
+      for (uint32_t j = 0; j < 4; ++j) {
+        uint32_t shift = i * 8 + j * 2;
+        uint32_t weight_low = (~weights_high >> shift) & 3;
+        uint32_t weight_high = (weights_high >> shift) & 3;
+        row[j * 2] =
+            uint8_t((weight_low * end_0_r + weight_high * end_1_r) / 3);
+        row[j * 2 + 1] =
+            uint8_t((weight_low * end_0_g + weight_high * end_1_g) / 3);
+      }
+    }
+  }
+};
+
+struct DecoderDXT3A {
+  static constexpr uint32_t kGuestBytes = 8;
+  static constexpr uint32_t kOutputWidth = 4;
+  static constexpr uint32_t kOutputHeight = 4;
+  static constexpr uint32_t kBytesPerElement = 1;
+  static void Decode(const uint32_t* block, uint8_t* out, size_t row_pitch) {
+    for (uint32_t i = 0; i < 4; ++i) {
+      uint32_t alphas = block[i >> 1] >> ((i & 1) * 16);
+      uint8_t* row = out + row_pitch * i;
+      for (uint32_t j = 0; j < 4; ++j) {
+        row[j] = uint8_t(((alphas >> (j * 4)) & 0xF) * 0x11);
+      }
+    }
+  }
+};
+
+struct DecoderDXT5A {
+  static constexpr uint32_t kGuestBytes = 8;
+  static constexpr uint32_t kOutputWidth = 4;
+  static constexpr uint32_t kOutputHeight = 4;
+  static constexpr uint32_t kBytesPerElement = 1;
+  static void Decode(const uint32_t* block, uint8_t* out, size_t row_pitch) {
+    uint32_t rows[4];
+    DXT5AlphaBlockToA8(block[0], block[1], rows);
+    for (uint32_t i = 0; i < 4; ++i) {
+      std::memcpy(out + row_pitch * i, &rows[i], sizeof(uint32_t));
+    }
+  }
+};
+
+template <bool kIsSigned>
+struct DecoderR10G11B11 {
+  static constexpr uint32_t kGuestBytes = 4;
+  static constexpr uint32_t kOutputWidth = 1;
+  static constexpr uint32_t kOutputHeight = 1;
+  static constexpr uint32_t kBytesPerElement = 8;
+  static void Decode(const uint32_t* block, uint8_t* out, size_t row_pitch) {
+    uint32_t texel = block[0];
+    uint32_t rgba[2];
+    if (kIsSigned) {
+      rgba[0] = SNorm10To16(texel & 1023) |
+                (SNorm11To16((texel >> 10) & 2047) << 16);
+      rgba[1] = SNorm11To16(texel >> 21) | 0x7FFF0000u;
+    } else {
+      rgba[0] = ((texel & 1023) << 6) | ((texel >> 4) & 63) |
+                ((texel & (2047u << 10)) << (21 - 10)) |
+                (texel & (31u << 16));
+      rgba[1] = (((texel >> 21) & 2047) << 5) | ((texel >> 27) & 31) |
+                0xFFFF0000u;
+    }
+    std::memcpy(out, rgba, sizeof(rgba));
+  }
+};
+
+template <bool kIsSigned>
+struct DecoderR11G11B10 {
+  static constexpr uint32_t kGuestBytes = 4;
+  static constexpr uint32_t kOutputWidth = 1;
+  static constexpr uint32_t kOutputHeight = 1;
+  static constexpr uint32_t kBytesPerElement = 8;
+  static void Decode(const uint32_t* block, uint8_t* out, size_t row_pitch) {
+    uint32_t texel = block[0];
+    uint32_t rgba[2];
+    if (kIsSigned) {
+      rgba[0] = SNorm11To16(texel & 2047) |
+                (SNorm11To16((texel >> 11) & 2047) << 16);
+      rgba[1] = SNorm10To16(texel >> 22) | 0x7FFF0000u;
+    } else {
+      rgba[0] = ((texel & 2047) << 5) | ((texel >> 6) & 31) |
+                ((texel & (2047u << 11)) << (21 - 11)) |
+                ((texel & (31u << 17)) >> (17 - 16));
+      rgba[1] = (((texel >> 22) & 1023) << 6) | ((texel >> 26) & 63) |
+                0xFFFF0000u;
+    }
+    std::memcpy(out, rgba, sizeof(rgba));
+  }
+};
+
+template <uint32_t kComponents, bool kIsSigned>
+struct DecoderNorm16ToFloat16 {
+  static constexpr uint32_t kGuestBytes = 2 * kComponents;
+  static constexpr uint32_t kOutputWidth = 1;
+  static constexpr uint32_t kOutputHeight = 1;
+  static constexpr uint32_t kBytesPerElement = 2 * kComponents;
+  static void Decode(const uint32_t* block, uint8_t* out, size_t row_pitch) {
+    uint16_t components[kComponents];
+    for (uint32_t i = 0; i < kComponents; ++i) {
+      uint32_t n16 = (block[i >> 1] >> ((i & 1) * 16)) & 0xFFFF;
+      components[i] = kIsSigned ? SNorm16ToFloat16(n16) : UNorm16ToFloat16(n16);
+    }
+    std::memcpy(out, components, sizeof(components));
+  }
+};
+
+template <uint32_t kBytes>
+struct DecoderCopy {
+  static constexpr uint32_t kGuestBytes = kBytes;
+  static constexpr uint32_t kOutputWidth = 1;
+  static constexpr uint32_t kOutputHeight = 1;
+  static constexpr uint32_t kBytesPerElement = kBytes;
+  static void Decode(const uint32_t* block, uint8_t* out, size_t row_pitch) {
+    std::memcpy(out, block, kBytes);
+  }
+};
+
+// Loads a guest block and swaps the endianness of each 32-bit word like
+// XeEndianSwap32 does. Blocks smaller than 32 bits are swapped as a part of the
+// word containing them, and returned in the low bits.
+template <uint32_t kBytes>
+static void LoadGuestBlock(const uint8_t* source, uint32_t offset,
+                           xenos::Endian endian, uint32_t* block_out) {
+  if (kBytes < 4) {
+    uint32_t word;
+    std::memcpy(&word, source + (offset & ~uint32_t(3)), sizeof(word));
+    block_out[0] =
+        xenos::GpuSwapInline(word, endian) >> ((offset & 3) * 8);
+    return;
+  }
+  std::memcpy(block_out, source + offset, kBytes);
+  for (uint32_t i = 0; i < kBytes / 4; ++i) {
+    block_out[i] = xenos::GpuSwapInline(block_out[i], endian);
+  }
+}
+
+template <typename Decoder>
+static void DecodeSubresourceWithDecoder(const GuestSubresource& guest,
+                                         const HostSubresource& host,
+                                         uint32_t block_width,
+                                         uint32_t block_height) {
+  uint32_t width_blocks = (guest.width + (block_width - 1)) / block_width;
+  uint32_t height_blocks = (guest.height + (block_height - 1)) / block_height;
+  // Elements are texels when decompressing, blocks otherwise.
+  uint32_t width_elements =
+      Decoder::kOutputWidth > 1 ? guest.width : width_blocks;
+  uint32_t height_elements =
+      Decoder::kOutputHeight > 1 ? guest.height : height_blocks;
+  uint32_t bytes_per_block_log2 = xe::log2_floor(Decoder::kGuestBytes);
+  std::unique_ptr<int32_t[]> offsets(new int32_t[width_blocks]);
+  constexpr size_t kBlockRowPitch =
+      Decoder::kOutputWidth * Decoder::kBytesPerElement;
+  uint8_t edge_block[kBlockRowPitch * Decoder::kOutputHeight];
+  // 16 bytes at most, plus padding for sub-dword blocks.
+  uint32_t block[4];
+  for (uint32_t z = 0; z < guest.depth; ++z) {
+    uint32_t guest_z = guest.offset_z + z;
+    uint8_t* host_slice = host.data + host.slice_pitch * z;
+    for (uint32_t y = 0; y < height_blocks; ++y) {
+      uint32_t guest_y = guest.offset_y_blocks + y;
+      if (guest.is_tiled) {
+        if (guest.is_3d) {
+          GetTiledOffsets3D(guest.offset_x_blocks, guest_y, guest_z,
+                            width_blocks, guest.pitch_aligned,
+                            guest.z_stride_block_rows_aligned,
+                            bytes_per_block_log2, offsets.get());
+        } else {
+          GetTiledOffsets2D(guest.offset_x_blocks, guest_y, width_blocks,
+                            guest.pitch_aligned, bytes_per_block_log2,
+                            offsets.get());
+        }
+      } else {
+        int32_t row_offset = int32_t(
+            (guest_z * guest.z_stride_block_rows_aligned + guest_y) *
+            guest.pitch_aligned);
+        for (uint32_t x = 0; x < width_blocks; ++x) {
+          offsets[x] = row_offset + int32_t((guest.offset_x_blocks + x) *
+                                            Decoder::kGuestBytes);
+        }
+      }
+      uint32_t row_first = y * Decoder::kOutputHeight;
+      uint32_t rows =
+          std::min(Decoder::kOutputHeight, height_elements - row_first);
+      uint8_t* host_row = host_slice + host.row_pitch * row_first;
+      for (uint32_t x = 0; x < width_blocks; ++x) {
+        LoadGuestBlock<Decoder::kGuestBytes>(guest.data, uint32_t(offsets[x]),
+                                             guest.endian, block);
+        uint32_t column_first = x * Decoder::kOutputWidth;
+        uint8_t* host_block =
+            host_row + size_t(column_first) * Decoder::kBytesPerElement;
+        uint32_t columns =
+            std::min(Decoder::kOutputWidth, width_elements - column_first);
+        if (rows == Decoder::kOutputHeight &&
+            columns == Decoder::kOutputWidth) {
+          Decoder::Decode(block, host_block, host.row_pitch);
+          continue;
+        }
+        // Clip the texels outside the level.
+        Decoder::Decode(block, edge_block, kBlockRowPitch);
+        for (uint32_t i = 0; i < rows; ++i) {
+          std::memcpy(host_block + host.row_pitch * i,
+                      edge_block + kBlockRowPitch * i,
+                      columns * Decoder::kBytesPerElement);
+        }
+      }
+    }
+  }
+}
+
+DecodedFormat GetDecodedFormat(xenos::TextureFormat format, bool is_signed) {
+  switch (format) {
+    case xenos::TextureFormat::k_DXT1:
+    case xenos::TextureFormat::k_DXT1_AS_16_16_16_16:
+    case xenos::TextureFormat::k_DXT2_3:
+    case xenos::TextureFormat::k_DXT2_3_AS_16_16_16_16:
+    case xenos::TextureFormat::k_DXT4_5:
+    case xenos::TextureFormat::k_DXT4_5_AS_16_16_16_16:
+      return DecodedFormat::kR8G8B8A8;
+    case xenos::TextureFormat::k_DXN:
+    case xenos::TextureFormat::k_CTX1:
+      return DecodedFormat::kR8G8;
+    case xenos::TextureFormat::k_DXT3A:
+    case xenos::TextureFormat::k_DXT5A:
+      return DecodedFormat::kR8;
+    case xenos::TextureFormat::k_10_11_11:
+    case xenos::TextureFormat::k_10_11_11_AS_16_16_16_16:
+    case xenos::TextureFormat::k_11_11_10:
+    case xenos::TextureFormat::k_11_11_10_AS_16_16_16_16:
+      return is_signed ? DecodedFormat::kR16G16B16A16SNorm
+                       : DecodedFormat::kR16G16B16A16UNorm;
+    case xenos::TextureFormat::k_16:
+      return DecodedFormat::kR16Float;
+    case xenos::TextureFormat::k_16_16:
+      return DecodedFormat::kR16G16Float;
+    case xenos::TextureFormat::k_16_16_16_16:
+      return DecodedFormat::kR16G16B16A16Float;
+    default: {
+      // Copying whole bytes only (not k_1).
+      switch (FormatInfo::Get(format)->bytes_per_block()) {
+        case 1:
+        case 2:
+        case 4:
+        case 8:
+        case 12:
+        case 16:
+          return DecodedFormat::kGuestBlocks;
+        default:
+          return DecodedFormat::kUnsupported;
+      }
+    }
+  }
+}
+
+uint32_t GetDecodedBytesPerElement(xenos::TextureFormat format,
+                                   bool is_signed) {
+  switch (GetDecodedFormat(format, is_signed)) {
+    case DecodedFormat::kGuestBlocks:
+      return FormatInfo::Get(format)->bytes_per_block();
+    case DecodedFormat::kR8:
+      return 1;
+    case DecodedFormat::kR8G8:
+    case DecodedFormat::kR16Float:
+      return 2;
+    case DecodedFormat::kR8G8B8A8:
+    case DecodedFormat::kR16G16Float:
+      return 4;
+    case DecodedFormat::kR16G16B16A16UNorm:
+    case DecodedFormat::kR16G16B16A16SNorm:
+    case DecodedFormat::kR16G16B16A16Float:
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+void GetDecodedElementSize(xenos::TextureFormat format, bool is_signed,
+                           uint32_t& width_texels_out,
+                           uint32_t& height_texels_out) {
+  if (GetDecodedFormat(format, is_signed) == DecodedFormat::kGuestBlocks) {
+    const FormatInfo* format_info = FormatInfo::Get(format);
+    width_texels_out = format_info->block_width;
+    height_texels_out = format_info->block_height;
+  } else {
+    width_texels_out = 1;
+    height_texels_out = 1;
+  }
+}
+
+bool DecodeSubresource(xenos::TextureFormat format, bool is_signed,
+                       const GuestSubresource& guest,
+                       const HostSubresource& host) {
+  const FormatInfo* format_info = FormatInfo::Get(format);
+  uint32_t block_width = format_info->block_width;
+  uint32_t block_height = format_info->block_height;
+  switch (GetDecodedFormat(format, is_signed)) {
+    case DecodedFormat::kGuestBlocks:
+      switch (format_info->bytes_per_block()) {
+        case 1:
+          DecodeSubresourceWithDecoder<DecoderCopy<1>>(guest, host,
+                                                       block_width,
+                                                       block_height);
+          return true;
+        case 2:
+          DecodeSubresourceWithDecoder<DecoderCopy<2>>(guest, host,
+                                                       block_width,
+                                                       block_height);
+          return true;
+        case 4:
+          DecodeSubresourceWithDecoder<DecoderCopy<4>>(guest, host,
+                                                       block_width,
+                                                       block_height);
+          return true;
+        case 8:
+          DecodeSubresourceWithDecoder<DecoderCopy<8>>(guest, host,
+                                                       block_width,
+                                                       block_height);
+          return true;
+        case 12:
+          DecodeSubresourceWithDecoder<DecoderCopy<12>>(guest, host,
+                                                        block_width,
+                                                        block_height);
+          return true;
+        case 16:
+          DecodeSubresourceWithDecoder<DecoderCopy<16>>(guest, host,
+                                                        block_width,
+                                                        block_height);
+          return true;
+      }
+      return false;
+    case DecodedFormat::kR8:
+      if (format == xenos::TextureFormat::k_DXT3A) {
+        DecodeSubresourceWithDecoder<DecoderDXT3A>(guest, host, block_width,
+                                                   block_height);
+      } else {
+        DecodeSubresourceWithDecoder<DecoderDXT5A>(guest, host, block_width,
+                                                   block_height);
+      }
+      return true;
+    case DecodedFormat::kR8G8:
+      if (format == xenos::TextureFormat::k_DXN) {
+        DecodeSubresourceWithDecoder<DecoderDXN>(guest, host, block_width,
+                                                 block_height);
+      } else {
+        DecodeSubresourceWithDecoder<DecoderCTX1>(guest, host, block_width,
+                                                  block_height);
+      }
+      return true;
+    case DecodedFormat::kR8G8B8A8:
+      switch (GetBaseFormat(format)) {
+        case xenos::TextureFormat::k_DXT1:
+          DecodeSubresourceWithDecoder<DecoderDXT1>(guest, host, block_width,
+                                                    block_height);
+          break;
+        case xenos::TextureFormat::k_DXT2_3:
+          DecodeSubresourceWithDecoder<DecoderDXT3>(guest, host, block_width,
+                                                    block_height);
+          break;
+        default:
+          DecodeSubresourceWithDecoder<DecoderDXT5>(guest, host, block_width,
+                                                    block_height);
+          break;
+      }
+      return true;
+    case DecodedFormat::kR16G16B16A16UNorm:
+    case DecodedFormat::kR16G16B16A16SNorm:
+      if (GetBaseFormat(format) == xenos::TextureFormat::k_10_11_11) {
+        if (is_signed) {
+          DecodeSubresourceWithDecoder<DecoderR10G11B11<true>>(
+              guest, host, block_width, block_height);
+        } else {
+          DecodeSubresourceWithDecoder<DecoderR10G11B11<false>>(
+              guest, host, block_width, block_height);
+        }
+      } else {
+        if (is_signed) {
+          DecodeSubresourceWithDecoder<DecoderR11G11B10<true>>(
+              guest, host, block_width, block_height);
+        } else {
+          DecodeSubresourceWithDecoder<DecoderR11G11B10<false>>(
+              guest, host, block_width, block_height);
+        }
+      }
+      return true;
+    case DecodedFormat::kR16Float:
+      if (is_signed) {
+        DecodeSubresourceWithDecoder<DecoderNorm16ToFloat16<1, true>>(
+            guest, host, block_width, block_height);
+      } else {
+        DecodeSubresourceWithDecoder<DecoderNorm16ToFloat16<1, false>>(
+            guest, host, block_width, block_height);
+      }
+      return true;
+    case DecodedFormat::kR16G16Float:
+      if (is_signed) {
+        DecodeSubresourceWithDecoder<DecoderNorm16ToFloat16<2, true>>(
+            guest, host, block_width, block_height);
+      } else {
+        DecodeSubresourceWithDecoder<DecoderNorm16ToFloat16<2, false>>(
+            guest, host, block_width, block_height);
+      }
+      return true;
+    case DecodedFormat::kR16G16B16A16Float:
+      if (is_signed) {
+        DecodeSubresourceWithDecoder<DecoderNorm16ToFloat16<4, true>>(
+            guest, host, block_width, block_height);
+      } else {
+        DecodeSubresourceWithDecoder<DecoderNorm16ToFloat16<4, false>>(
+            guest, host, block_width, block_height);
+      }
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool DecodeTexture(const Texture& texture, uint32_t level_first,
+                   uint32_t level_last, DecodedTexture& decoded_texture_out,
+                   uint32_t thread_count) {
+  SCOPE_profile_cpu_f("gpu");
+
+  DecodedFormat decoded_format =
+      GetDecodedFormat(texture.format, texture.is_signed);
+  if (decoded_format == DecodedFormat::kUnsupported ||
+      level_first > level_last || level_last > texture.mip_max_level ||
+      (level_first == 0 && !texture.base_data) ||
+      (level_last != 0 && !texture.mips_data)) {
+    return false;
+  }
+
+  bool is_3d = texture.dimension == xenos::DataDimension::k3D;
+  uint32_t depth = is_3d ? texture.depth_or_array_size : 1;
+  uint32_t array_size = is_3d ? 1 : texture.depth_or_array_size;
+  texture_util::TextureGuestLayout guest_layout =
+      texture_util::GetGuestTextureLayout(
+          texture.dimension, texture.pitch, texture.width, texture.height,
+          texture.depth_or_array_size, texture.is_tiled, texture.format,
+          texture.has_packed_levels, level_first == 0, level_last);
+  const FormatInfo* format_info = FormatInfo::Get(texture.format);
+  uint32_t block_width = format_info->block_width;
+  uint32_t block_height = format_info->block_height;
+  uint32_t bytes_per_block = format_info->bytes_per_block();
+  uint32_t element_width, element_height;
+  GetDecodedElementSize(texture.format, texture.is_signed, element_width,
+                        element_height);
+  uint32_t bytes_per_element =
+      GetDecodedBytesPerElement(texture.format, texture.is_signed);
+
+  decoded_texture_out.format = decoded_format;
+  decoded_texture_out.array_size = array_size;
+  decoded_texture_out.level_first = level_first;
+  decoded_texture_out.level_last = level_last;
+
+  // Each level of each array layer is split into jobs of up to a tile row
+  // (including all the Z slices for 3D textures).
+  constexpr uint32_t kJobBlockRows = xenos::kTextureTileWidthHeight;
+  struct Job {
+    GuestSubresource guest;
+    HostSubresource host;
+  };
+  std::vector<Job> jobs;
+  size_t host_size = 0;
+  for (uint32_t level = level_first; level <= level_last; ++level) {
+    DecodedTexture::Level& decoded_level = decoded_texture_out.levels[level];
+    uint32_t level_width = std::max(texture.width >> level, uint32_t(1));
+    uint32_t level_height = std::max(texture.height >> level, uint32_t(1));
+    uint32_t level_depth = std::max(depth >> level, uint32_t(1));
+    decoded_level.offset_bytes = host_size;
+    decoded_level.width = (level_width + (element_width - 1)) / element_width;
+    decoded_level.height =
+        (level_height + (element_height - 1)) / element_height;
+    decoded_level.depth = level_depth;
+    decoded_level.row_pitch = size_t(bytes_per_element) * decoded_level.width;
+    decoded_level.slice_pitch = decoded_level.row_pitch * decoded_level.height;
+    decoded_level.array_layer_pitch = decoded_level.slice_pitch * level_depth;
+    host_size += decoded_level.array_layer_pitch * array_size;
+
+    bool is_base = level == 0;
+    uint32_t level_stored = std::min(level, guest_layout.packed_level);
+    const texture_util::TextureGuestLayout::Level& level_guest_layout =
+        is_base ? guest_layout.base : guest_layout.mips[level_stored];
+    Job job;
+    job.guest.data = is_base ? texture.base_data
+                             : texture.mips_data +
+                                   guest_layout.mip_offsets_bytes[level_stored];
+    job.guest.is_tiled = texture.is_tiled;
+    job.guest.is_3d = is_3d;
+    job.guest.endian = texture.endian;
+    job.guest.pitch_aligned = level_guest_layout.row_pitch_bytes;
+    if (texture.is_tiled) {
+      job.guest.pitch_aligned /= bytes_per_block;
+    }
+    job.guest.z_stride_block_rows_aligned =
+        level_guest_layout.z_slice_stride_block_rows;
+    if (level >= guest_layout.packed_level) {
+      texture_util::GetPackedMipOffset(
+          texture.width, texture.height, depth, texture.format, level,
+          job.guest.offset_x_blocks, job.guest.offset_y_blocks,
+          job.guest.offset_z);
+    } else {
+      job.guest.offset_x_blocks = 0;
+      job.guest.offset_y_blocks = 0;
+      job.guest.offset_z = 0;
+    }
+    job.guest.width = level_width;
+    job.guest.height = level_height;
+    job.guest.depth = level_depth;
+    job.host.row_pitch = decoded_level.row_pitch;
+    job.host.slice_pitch = decoded_level.slice_pitch;
+    for (uint32_t layer = 0; layer < array_size; ++layer) {
+      for (uint32_t band_y = 0; band_y < level_height;
+           band_y += kJobBlockRows * block_height) {
+        jobs.push_back(job);
+        Job& band_job = jobs.back();
+        band_job.guest.data +=
+            size_t(level_guest_layout.array_slice_stride_bytes) * layer;
+        band_job.guest.offset_y_blocks += band_y / block_height;
+        band_job.guest.height =
+            std::min(kJobBlockRows * block_height, level_height - band_y);
+        // Data pointers are resolved after the allocation.
+        band_job.host.data = reinterpret_cast<uint8_t*>(
+            decoded_level.offset_bytes +
+            decoded_level.array_layer_pitch * layer +
+            decoded_level.row_pitch * (band_y / element_height));
+      }
+    }
+  }
+  decoded_texture_out.data.resize(host_size);
+  for (Job& job : jobs) {
+    job.host.data = decoded_texture_out.data.data() +
+                    reinterpret_cast<size_t>(job.host.data);
+  }
+
+  std::atomic<size_t> next_job_index(0);
+  auto decode_thread_function = [&]() {
+    for (;;) {
+      size_t job_index = next_job_index.fetch_add(1, std::memory_order_relaxed);
+      if (job_index >= jobs.size()) {
+        break;
+      }
+      const Job& job = jobs[job_index];
+      DecodeSubresource(texture.format, texture.is_signed, job.guest,
+                        job.host);
+    }
+  };
+  if (!thread_count) {
+    thread_count = xe::threading::logical_processor_count();
+  }
+  thread_count =
+      uint32_t(std::min(size_t(std::max(thread_count, uint32_t(1))),
+                        jobs.size()));
+  // The calling thread is one of the decoding threads.
+  std::vector<std::unique_ptr<xe::threading::Thread>> decode_threads;
+  for (uint32_t i = 1; i < thread_count; ++i) {
+    auto thread = xe::threading::Thread::Create({}, decode_thread_function);
+    assert_not_null(thread);
+    thread->set_name("Texture Decode");
+    decode_threads.push_back(std::move(thread));
+  }
+  decode_thread_function();
+  for (auto& decode_thread : decode_threads) {
+    xe::threading::Wait(decode_thread.get(), false);
+  }
+  return true;
+}
+
+void GetTiledOffsets2D(uint32_t x, uint32_t y, uint32_t count,
+                       uint32_t pitch_aligned, uint32_t bytes_per_block_log2,
+                       int32_t* offsets_out) {
+#if XE_ARCH_AMD64
+  if (amd64::GetFeatureFlags() & amd64::kX64EmitAVX2) {
+    GetTiledOffsets2DAVX2(x, y, count, pitch_aligned, bytes_per_block_log2,
+                          offsets_out);
+  } else {
+    GetTiledOffsets2DSSE2(x, y, count, pitch_aligned, bytes_per_block_log2,
+                          offsets_out);
+  }
+#else
+  for (uint32_t i = 0; i < count; ++i) {
+    offsets_out[i] = texture_util::GetTiledOffset2D(
+        int32_t(x + i), int32_t(y), pitch_aligned, bytes_per_block_log2);
+  }
+#endif  // XE_ARCH_AMD64
+}
+
+void GetTiledOffsets3D(uint32_t x, uint32_t y, uint32_t z, uint32_t count,
+                       uint32_t pitch_aligned, uint32_t height_aligned,
+                       uint32_t bytes_per_block_log2, int32_t* offsets_out) {
+#if XE_ARCH_AMD64
+  if (amd64::GetFeatureFlags() & amd64::kX64EmitAVX2) {
+    GetTiledOffsets3DAVX2(x, y, z, count, pitch_aligned, height_aligned,
+                          bytes_per_block_log2, offsets_out);
+  } else {
+    GetTiledOffsets3DSSE2(x, y, z, count, pitch_aligned, height_aligned,
+                          bytes_per_block_log2, offsets_out);
+  }
+#else
+  for (uint32_t i = 0; i < count; ++i) {
+    offsets_out[i] = texture_util::GetTiledOffset3D(
+        int32_t(x + i), int32_t(y), int32_t(z), pitch_aligned, height_aligned,
+        bytes_per_block_log2);
+  }
+#endif  // XE_ARCH_AMD64
+}
+
+#if XE_ARCH_AMD64
+
+// The AVX2 versions are only called after checking kX64EmitAVX2, so they're
+// built for it regardless of the instruction set of the rest of the code.
+#if XE_COMPILER_HAS_GNU_EXTENSIONS == 1
+#define XE_GPU_TEXTURE_DECODE_AVX2 __attribute__((target("avx2")))
+#else
+#define XE_GPU_TEXTURE_DECODE_AVX2
+#endif
+
+// The vector versions calculate the same expressions as
+// texture_util::GetTiledOffset2D / 3D for multiple X coordinates at once, with
+// the parts depending only on Y and Z being computed once for the whole row.
+// The remainder not filling a whole vector is handled by the scalar versions.
+
+void GetTiledOffsets2DSSE2(uint32_t x, uint32_t y, uint32_t count,
+                           uint32_t pitch_aligned,
+                           uint32_t bytes_per_block_log2,
+                           int32_t* offsets_out) {
+  int32_t y_macro = int32_t((y >> 5) * (pitch_aligned >> 5));
+  int32_t y_micro = int32_t((y & 0xE) << 2);
+  int32_t y_offset = int32_t((y & 1) << 4);
+  int32_t y_bit_4 = int32_t((y & 16) << 7);
+  int32_t y_bit_3 = int32_t((y & 8) >> 2);
+  __m128i macro_shift = _mm_cvtsi32_si128(int(bytes_per_block_log2 + 7));
+  __m128i micro_shift = _mm_cvtsi32_si128(int(bytes_per_block_log2));
+  __m128i x_vector = _mm_add_epi32(_mm_set1_epi32(int32_t(x)),
+                                   _mm_setr_epi32(0, 1, 2, 3));
+  uint32_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i macro = _mm_sll_epi32(
+        _mm_add_epi32(_mm_srli_epi32(x_vector, 5), _mm_set1_epi32(y_macro)),
+        macro_shift);
+    __m128i micro = _mm_sll_epi32(
+        _mm_add_epi32(_mm_and_si128(x_vector, _mm_set1_epi32(7)),
+                      _mm_set1_epi32(y_micro)),
+        micro_shift);
+    __m128i offset = _mm_add_epi32(
+        _mm_add_epi32(macro, _mm_slli_epi32(_mm_and_si128(
+                                                micro, _mm_set1_epi32(~0xF)),
+                                            1)),
+        _mm_add_epi32(_mm_and_si128(micro, _mm_set1_epi32(0xF)),
+                      _mm_set1_epi32(y_offset)));
+    __m128i address = _mm_add_epi32(
+        _mm_slli_epi32(_mm_and_si128(offset, _mm_set1_epi32(~0x1FF)), 3),
+        _mm_set1_epi32(y_bit_4));
+    address = _mm_add_epi32(
+        address,
+        _mm_slli_epi32(_mm_and_si128(offset, _mm_set1_epi32(0x1C0)), 2));
+    address = _mm_add_epi32(
+        address,
+        _mm_slli_epi32(
+            _mm_and_si128(_mm_add_epi32(_mm_srli_epi32(x_vector, 3),
+                                        _mm_set1_epi32(y_bit_3)),
+                          _mm_set1_epi32(3)),
+            6));
+    address = _mm_add_epi32(address,
+                            _mm_and_si128(offset, _mm_set1_epi32(0x3F)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(offsets_out + i), address);
+    x_vector = _mm_add_epi32(x_vector, _mm_set1_epi32(4));
+  }
+  for (; i < count; ++i) {
+    offsets_out[i] = texture_util::GetTiledOffset2D(
+        int32_t(x + i), int32_t(y), pitch_aligned, bytes_per_block_log2);
+  }
+}
+
+XE_GPU_TEXTURE_DECODE_AVX2
+void GetTiledOffsets2DAVX2(uint32_t x, uint32_t y, uint32_t count,
+                           uint32_t pitch_aligned,
+                           uint32_t bytes_per_block_log2,
+                           int32_t* offsets_out) {
+  int32_t y_macro = int32_t((y >> 5) * (pitch_aligned >> 5));
+  int32_t y_micro = int32_t((y & 0xE) << 2);
+  int32_t y_offset = int32_t((y & 1) << 4);
+  int32_t y_bit_4 = int32_t((y & 16) << 7);
+  int32_t y_bit_3 = int32_t((y & 8) >> 2);
+  __m128i macro_shift = _mm_cvtsi32_si128(int(bytes_per_block_log2 + 7));
+  __m128i micro_shift = _mm_cvtsi32_si128(int(bytes_per_block_log2));
+  __m256i x_vector =
+      _mm256_add_epi32(_mm256_set1_epi32(int32_t(x)),
+                       _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+  uint32_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i macro = _mm256_sll_epi32(
+        _mm256_add_epi32(_mm256_srli_epi32(x_vector, 5),
+                         _mm256_set1_epi32(y_macro)),
+        macro_shift);
+    __m256i micro = _mm256_sll_epi32(
+        _mm256_add_epi32(_mm256_and_si256(x_vector, _mm256_set1_epi32(7)),
+                         _mm256_set1_epi32(y_micro)),
+        micro_shift);
+    __m256i offset = _mm256_add_epi32(
+        _mm256_add_epi32(
+            macro, _mm256_slli_epi32(
+                       _mm256_and_si256(micro, _mm256_set1_epi32(~0xF)), 1)),
+        _mm256_add_epi32(_mm256_and_si256(micro, _mm256_set1_epi32(0xF)),
+                         _mm256_set1_epi32(y_offset)));
+    __m256i address = _mm256_add_epi32(
+        _mm256_slli_epi32(_mm256_and_si256(offset, _mm256_set1_epi32(~0x1FF)),
+                          3),
+        _mm256_set1_epi32(y_bit_4));
+    address = _mm256_add_epi32(
+        address,
+        _mm256_slli_epi32(_mm256_and_si256(offset, _mm256_set1_epi32(0x1C0)),
+                          2));
+    address = _mm256_add_epi32(
+        address,
+        _mm256_slli_epi32(
+            _mm256_and_si256(_mm256_add_epi32(_mm256_srli_epi32(x_vector, 3),
+                                              _mm256_set1_epi32(y_bit_3)),
+                             _mm256_set1_epi32(3)),
+            6));
+    address = _mm256_add_epi32(
+        address, _mm256_and_si256(offset, _mm256_set1_epi32(0x3F)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(offsets_out + i), address);
+    x_vector = _mm256_add_epi32(x_vector, _mm256_set1_epi32(8));
+  }
+  for (; i < count; ++i) {
+    offsets_out[i] = texture_util::GetTiledOffset2D(
+        int32_t(x + i), int32_t(y), pitch_aligned, bytes_per_block_log2);
+  }
+}
+
+void GetTiledOffsets3DSSE2(uint32_t x, uint32_t y, uint32_t z, uint32_t count,
+                           uint32_t pitch_aligned, uint32_t height_aligned,
+                           uint32_t bytes_per_block_log2,
+                           int32_t* offsets_out) {
+  int32_t macro_outer = int32_t(((y >> 4) + (z >> 2) * (height_aligned >> 4)) *
+                                (pitch_aligned >> 5));
+  int32_t offset_outer = int32_t(((y >> 3) + (z >> 2)) & 1);
+  int32_t y_micro = int32_t((y & 6) << 2);
+  int32_t zy_offset = int32_t(((z & 3) << (bytes_per_block_log2 + 6)) +
+                              ((y & 1) << 4));
+  __m128i macro_shift = _mm_cvtsi32_si128(int(bytes_per_block_log2 + 6));
+  __m128i x_vector = _mm_add_epi32(_mm_set1_epi32(int32_t(x)),
+                                   _mm_setr_epi32(0, 1, 2, 3));
+  uint32_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i macro = _mm_slli_epi32(
+        _mm_and_si128(
+            _mm_sll_epi32(_mm_add_epi32(_mm_srli_epi32(x_vector, 5),
+                                        _mm_set1_epi32(macro_outer)),
+                          macro_shift),
+            _mm_set1_epi32(0xFFFFFFF)),
+        1);
+    __m128i micro = _mm_srli_epi32(
+        _mm_sll_epi32(_mm_add_epi32(_mm_and_si128(x_vector, _mm_set1_epi32(7)),
+                                    _mm_set1_epi32(y_micro)),
+                      macro_shift),
+        6);
+    // offset1 & 1 is offset_outer, offset1 & ~1 depends on X.
+    __m128i offset1_high = _mm_slli_epi32(
+        _mm_and_si128(_mm_add_epi32(_mm_srli_epi32(x_vector, 3),
+                                    _mm_set1_epi32(offset_outer << 1)),
+                      _mm_set1_epi32(3)),
+        1);
+    __m128i offset2 = _mm_add_epi32(
+        _mm_slli_epi32(
+            _mm_add_epi32(macro,
+                          _mm_and_si128(micro, _mm_set1_epi32(~15))),
+            1),
+        _mm_add_epi32(_mm_and_si128(micro, _mm_set1_epi32(15)),
+                      _mm_set1_epi32(zy_offset)));
+    __m128i address =
+        _mm_add_epi32(_mm_set1_epi32(offset_outer << 3),
+                      _mm_and_si128(_mm_srli_epi32(offset2, 6),
+                                    _mm_set1_epi32(7)));
+    address = _mm_add_epi32(_mm_slli_epi32(address, 3), offset1_high);
+    address = _mm_add_epi32(_mm_slli_epi32(address, 2),
+                            _mm_and_si128(offset2, _mm_set1_epi32(~511)));
+    address = _mm_add_epi32(_mm_slli_epi32(address, 3),
+                            _mm_and_si128(offset2, _mm_set1_epi32(63)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(offsets_out + i), address);
+    x_vector = _mm_add_epi32(x_vector, _mm_set1_epi32(4));
+  }
+  for (; i < count; ++i) {
+    offsets_out[i] = texture_util::GetTiledOffset3D(
+        int32_t(x + i), int32_t(y), int32_t(z), pitch_aligned, height_aligned,
+        bytes_per_block_log2);
+  }
+}
+
+XE_GPU_TEXTURE_DECODE_AVX2
+void GetTiledOffsets3DAVX2(uint32_t x, uint32_t y, uint32_t z, uint32_t count,
+                           uint32_t pitch_aligned, uint32_t height_aligned,
+                           uint32_t bytes_per_block_log2,
+                           int32_t* offsets_out) {
+  int32_t macro_outer = int32_t(((y >> 4) + (z >> 2) * (height_aligned >> 4)) *
+                                (pitch_aligned >> 5));
+  int32_t offset_outer = int32_t(((y >> 3) + (z >> 2)) & 1);
+  int32_t y_micro = int32_t((y & 6) << 2);
+  int32_t zy_offset = int32_t(((z & 3) << (bytes_per_block_log2 + 6)) +
+                              ((y & 1) << 4));
+  __m128i macro_shift = _mm_cvtsi32_si128(int(bytes_per_block_log2 + 6));
+  __m256i x_vector =
+      _mm256_add_epi32(_mm256_set1_epi32(int32_t(x)),
+                       _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+  uint32_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i macro = _mm256_slli_epi32(
+        _mm256_and_si256(
+            _mm256_sll_epi32(_mm256_add_epi32(_mm256_srli_epi32(x_vector, 5),
+                                              _mm256_set1_epi32(macro_outer)),
+                             macro_shift),
+            _mm256_set1_epi32(0xFFFFFFF)),
+        1);
+    __m256i micro = _mm256_srli_epi32(
+        _mm256_sll_epi32(
+            _mm256_add_epi32(_mm256_and_si256(x_vector, _mm256_set1_epi32(7)),
+                             _mm256_set1_epi32(y_micro)),
+            macro_shift),
+        6);
+    __m256i offset1_high = _mm256_slli_epi32(
+        _mm256_and_si256(_mm256_add_epi32(_mm256_srli_epi32(x_vector, 3),
+                                          _mm256_set1_epi32(offset_outer << 1)),
+                         _mm256_set1_epi32(3)),
+        1);
+    __m256i offset2 = _mm256_add_epi32(
+        _mm256_slli_epi32(
+            _mm256_add_epi32(macro,
+                             _mm256_and_si256(micro, _mm256_set1_epi32(~15))),
+            1),
+        _mm256_add_epi32(_mm256_and_si256(micro, _mm256_set1_epi32(15)),
+                         _mm256_set1_epi32(zy_offset)));
+    __m256i address =
+        _mm256_add_epi32(_mm256_set1_epi32(offset_outer << 3),
+                         _mm256_and_si256(_mm256_srli_epi32(offset2, 6),
+                                          _mm256_set1_epi32(7)));
+    address = _mm256_add_epi32(_mm256_slli_epi32(address, 3), offset1_high);
+    address = _mm256_add_epi32(
+        _mm256_slli_epi32(address, 2),
+        _mm256_and_si256(offset2, _mm256_set1_epi32(~511)));
+    address = _mm256_add_epi32(
+        _mm256_slli_epi32(address, 3),
+        _mm256_and_si256(offset2, _mm256_set1_epi32(63)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(offsets_out + i), address);
+    x_vector = _mm256_add_epi32(x_vector, _mm256_set1_epi32(8));
+  }
+  for (; i < count; ++i) {
+    offsets_out[i] = texture_util::GetTiledOffset3D(
+        int32_t(x + i), int32_t(y), int32_t(z), pitch_aligned, height_aligned,
+        bytes_per_block_log2);
+  }
+}
+
+#undef XE_GPU_TEXTURE_DECODE_AVX2
+
+#endif  // XE_ARCH_AMD64
+
+}  // namespace texture_decode
+}  // namespace gpu
+}  // namespace xe
@@ -0,0 +1,178 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_GPU_TEXTURE_DECODE_H_
+#define XENIA_GPU_TEXTURE_DECODE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "xenia/base/platform.h"
+#include "xenia/gpu/xenos.h"
+
+namespace xe {
+namespace gpu {
+namespace texture_decode {
+
+// CPU reference implementation of loading guest textures - untiling,
+// endian swapping and the decompression and conversion performed by the
+// texture_load_*.cs.xesl compute shaders, producing bit-identical results, for
+// the places where there's no host GPU to run the shaders on (texture dumping,
+// trace dumps, the null backend, tests).
+
+enum class DecodedFormat : uint32_t {
+  kUnsupported,
+  // Endian-swapped, untiled guest blocks, without conversion.
+  kGuestBlocks,
+  // DXT3A, DXT5A.
+  kR8,
+  // DXN, CTX1.
+  kR8G8,
+  // DXT1, DXT2/3, DXT4/5.
+  kR8G8B8A8,
+  // 10:11:11 and 11:11:10, expanded to 16 bits per component.
+  kR16G16B16A16UNorm,
+  kR16G16B16A16SNorm,
+  // 16-bit normalized components (unsigned or signed depending on the
+  // signedness the format is decoded with) converted to float16.
+  kR16Float,
+  kR16G16Float,
+  kR16G16B16A16Float,
+};
+
+DecodedFormat GetDecodedFormat(xenos::TextureFormat format, bool is_signed);
+
+// Elements of the decoded data are texels for all decoded formats except for
+// kGuestBlocks, in which they're guest blocks (like 4x4 for DXT formats).
+uint32_t GetDecodedBytesPerElement(xenos::TextureFormat format,
+                                   bool is_signed);
+void GetDecodedElementSize(xenos::TextureFormat format, bool is_signed,
+                           uint32_t& width_texels_out,
+                           uint32_t& height_texels_out);
+
+// A level of an array layer in guest memory - like the constants of the
+// texture load shaders, but with the origin of the level within the packed mip
+// tail rather than the size of the whole tail.
+struct GuestSubresource {
+  // The beginning of the level (or the packed mip tail) of the array layer.
+  const uint8_t* data;
+  bool is_tiled;
+  bool is_3d;
+  xenos::Endian endian;
+  // For tiled textures - row pitch in guest blocks, aligned to 32.
+  // For linear textures - row pitch in bytes.
+  uint32_t pitch_aligned;
+  // For 3D textures only - distance between Z slices in block rows, aligned to
+  // 32.
+  uint32_t z_stride_block_rows_aligned;
+  // Offset of the level within the packed mip tail.
+  uint32_t offset_x_blocks;
+  uint32_t offset_y_blocks;
+  uint32_t offset_z;
+  // Size of the level in texels.
+  uint32_t width;
+  uint32_t height;
+  uint32_t depth;
+};
+
+struct HostSubresource {
+  uint8_t* data;
+  // In bytes, between rows of elements.
+  size_t row_pitch;
+  // In bytes, between Z slices.
+  size_t slice_pitch;
+};
+
+// Returns false if the format is not supported.
+bool DecodeSubresource(xenos::TextureFormat format, bool is_signed,
+                       const GuestSubresource& guest,
+                       const HostSubresource& host);
+
+struct Texture {
+  xenos::DataDimension dimension;
+  xenos::TextureFormat format;
+  bool is_signed;
+  bool is_tiled;
+  bool has_packed_levels;
+  xenos::Endian endian;
+  // For the base level, in texels divided by 32, from the fetch constant.
+  uint32_t pitch;
+  uint32_t width;
+  uint32_t height;
+  uint32_t depth_or_array_size;
+  uint32_t mip_max_level;
+  // The data starting from the base address and from the mip address - may be
+  // nullptr if not decoding the base or the mips respectively.
+  const uint8_t* base_data;
+  const uint8_t* mips_data;
+};
+
+struct DecodedTexture {
+  struct Level {
+    size_t offset_bytes;
+    // In elements.
+    uint32_t width;
+    uint32_t height;
+    uint32_t depth;
+    size_t row_pitch;
+    size_t slice_pitch;
+    // Distance between array layers (each containing all the Z slices).
+    size_t array_layer_pitch;
+  };
+  DecodedFormat format;
+  uint32_t array_size;
+  uint32_t level_first;
+  uint32_t level_last;
+  // Levels are stored sequentially in the data, tightly packed, with array
+  // layers in each of them.
+  Level levels[xenos::kTextureMaxMips];
+  std::vector<uint8_t> data;
+};
+
+// Decodes the levels from level_first to level_last of all array layers of
+// the texture, extracting levels from packed mip tails. The subresources are
+// split into jobs of tile rows, distributed across up to thread_count threads
+// (0 to use all logical processors, 1 to decode on the calling thread).
+bool DecodeTexture(const Texture& texture, uint32_t level_first,
+                   uint32_t level_last, DecodedTexture& decoded_texture_out,
+                   uint32_t thread_count = 0);
+
+// Offsets (relative to the beginning of the subresource, like
+// texture_util::GetTiledOffset2D / 3D) of count horizontally consecutive tiled
+// blocks starting from (x, y) or (x, y, z), vectorized with SSE2 and AVX2 if
+// available on the host.
+void GetTiledOffsets2D(uint32_t x, uint32_t y, uint32_t count,
+                       uint32_t pitch_aligned, uint32_t bytes_per_block_log2,
+                       int32_t* offsets_out);
+void GetTiledOffsets3D(uint32_t x, uint32_t y, uint32_t z, uint32_t count,
+                       uint32_t pitch_aligned, uint32_t height_aligned,
+                       uint32_t bytes_per_block_log2, int32_t* offsets_out);
+#if XE_ARCH_AMD64
+// The instruction set-specific versions, for testing - the AVX2 ones must only
+// be called after checking kX64EmitAVX2.
+void GetTiledOffsets2DSSE2(uint32_t x, uint32_t y, uint32_t count,
+                           uint32_t pitch_aligned,
+                           uint32_t bytes_per_block_log2, int32_t* offsets_out);
+void GetTiledOffsets2DAVX2(uint32_t x, uint32_t y, uint32_t count,
+                           uint32_t pitch_aligned,
+                           uint32_t bytes_per_block_log2, int32_t* offsets_out);
+void GetTiledOffsets3DSSE2(uint32_t x, uint32_t y, uint32_t z, uint32_t count,
+                           uint32_t pitch_aligned, uint32_t height_aligned,
+                           uint32_t bytes_per_block_log2, int32_t* offsets_out);
+void GetTiledOffsets3DAVX2(uint32_t x, uint32_t y, uint32_t z, uint32_t count,
+                           uint32_t pitch_aligned, uint32_t height_aligned,
+                           uint32_t bytes_per_block_log2, int32_t* offsets_out);
+#endif  // XE_ARCH_AMD64
+
+}  // namespace texture_decode
+}  // namespace gpu
+}  // namespace xe
+
+#endif  // XENIA_GPU_TEXTURE_DECODE_H_
@@ -17,6 +17,8 @@
 #include "xenia/base/threading.h"
 #include "xenia/gpu/command_processor.h"
 #include "xenia/gpu/graphics_system.h"
+#include "xenia/gpu/texture_decode.h"
+#include "xenia/gpu/texture_util.h"
 #include "xenia/memory.h"
 #include "xenia/ui/file_picker.h"
 #include "xenia/ui/presenter.h"
@@ -30,6 +32,12 @@
 
 DEFINE_path(target_trace_file, "", "Specifies the trace file to load.", "GPU");
 DEFINE_path(trace_dump_path, "", "Output path for dumped files.", "GPU");
+DEFINE_bool(trace_dump_textures, false,
+            "Also dump the most detailed level of the textures bound to the "
+            "texture fetch constants at the end of the frame, decoded on the "
+            "CPU, as PNG files next to the framebuffer capture. Only formats "
+            "with 8-bit components (including DXT/DXN) are written.",
+            "GPU");
 
 namespace xe {
 namespace gpu {
@@ -146,10 +154,137 @@ int TraceDump::Run() {
     result = 1;
   }
 
+  if (cvars::trace_dump_textures) {
+    DumpTextures();
+  }
+
   player_.reset();
   emulator_.reset();
   return result;
 }
 
+void TraceDump::DumpTextures() {
+  const RegisterFile& regs = *graphics_system_->register_file();
+  Memory* memory = graphics_system_->memory();
+  for (uint32_t i = 0; i < 32; ++i) {
+    xe_gpu_texture_fetch_t fetch = regs.GetTextureFetch(i);
+    if (fetch.type != FetchConstantType::kTexture) {
+      continue;
+    }
+    uint32_t width_minus_1, height_minus_1, depth_or_array_size_minus_1;
+    uint32_t base_page, mip_page, mip_min_level, mip_max_level;
+    texture_util::GetSubresourcesFromFetchConstant(
+        fetch, &width_minus_1, &height_minus_1, &depth_or_array_size_minus_1,
+        &base_page, &mip_page, &mip_min_level, &mip_max_level);
+    if (!base_page && !mip_page) {
+      continue;
+    }
+
+    texture_decode::Texture texture = {};
+    texture.dimension = fetch.dimension;
+    texture.format = fetch.format;
+    texture.is_signed = fetch.sign_x == TextureSign::kSigned;
+    texture.is_tiled = fetch.tiled != 0;
+    texture.has_packed_levels = fetch.packed_mips != 0;
+    texture.endian = fetch.endianness;
+    texture.pitch = fetch.pitch;
+    texture.width = width_minus_1 + 1;
+    texture.height = height_minus_1 + 1;
+    texture.depth_or_array_size = depth_or_array_size_minus_1 + 1;
+    texture.mip_max_level = mip_max_level;
+    texture.base_data =
+        base_page
+            ? memory->TranslatePhysical<const uint8_t*>(base_page << 12)
+            : nullptr;
+    texture.mips_data =
+        mip_page ? memory->TranslatePhysical<const uint8_t*>(mip_page << 12)
+                 : nullptr;
+
+    // Only the most detailed level that the fetch constant allows.
+    texture_decode::DecodedTexture decoded;
+    if (!texture_decode::DecodeTexture(texture, mip_min_level, mip_min_level,
+                                       decoded)) {
+      XELOGW("Texture fetch constant {}: failed to decode {} texture", i,
+             FormatInfo::GetName(fetch.format));
+      continue;
+    }
+
+    // Expand the first array layer / Z slice to RGBA8 for the PNG.
+    const texture_decode::DecodedTexture::Level& level =
+        decoded.levels[mip_min_level];
+    uint32_t source_components;
+    switch (decoded.format) {
+      case texture_decode::DecodedFormat::kR8:
+        source_components = 1;
+        break;
+      case texture_decode::DecodedFormat::kR8G8:
+        source_components = 2;
+        break;
+      case texture_decode::DecodedFormat::kR8G8B8A8:
+        source_components = 4;
+        break;
+      case texture_decode::DecodedFormat::kGuestBlocks:
+        if (fetch.format == TextureFormat::k_8) {
+          source_components = 1;
+          break;
+        }
+        if (fetch.format == TextureFormat::k_8_8) {
+          source_components = 2;
+          break;
+        }
+        if (fetch.format == TextureFormat::k_8_8_8_8) {
+          source_components = 4;
+          break;
+        }
+        [[fallthrough]];
+      default:
+        XELOGI("Texture fetch constant {}: not dumping {} texture", i,
+               FormatInfo::GetName(fetch.format));
+        continue;
+    }
+    std::vector<uint8_t> rgba(size_t(level.width) * level.height * 4);
+    for (uint32_t y = 0; y < level.height; ++y) {
+      const uint8_t* source_row =
+          decoded.data.data() + level.offset_bytes + y * level.row_pitch;
+      uint8_t* dest_row = rgba.data() + size_t(y) * level.width * 4;
+      for (uint32_t x = 0; x < level.width; ++x) {
+        const uint8_t* source = source_row + x * source_components;
+        uint8_t* dest = dest_row + x * 4;
+        switch (source_components) {
+          case 1:
+            dest[0] = dest[1] = dest[2] = source[0];
+            dest[3] = 0xFF;
+            break;
+          case 2:
+            dest[0] = source[0];
+            dest[1] = source[1];
+            dest[2] = 0;
+            dest[3] = 0xFF;
+            break;
+          default:
+            std::memcpy(dest, source, 4);
+            break;
+        }
+      }
+    }
+
+    auto png_path = base_output_path_;
+    png_path.replace_extension(fmt::format(".tex{:02}.png", i));
+    auto handle = filesystem::OpenFile(png_path, "wb");
+    if (!handle) {
+      XELOGE("Texture fetch constant {}: failed to open {}", i,
+             xe::path_to_utf8(png_path));
+      continue;
+    }
+    auto callback = [](void* context, void* data, int size) {
+      fwrite(data, 1, size, (FILE*)context);
+    };
+    stbi_write_png_to_func(callback, handle, static_cast<int>(level.width),
+                           static_cast<int>(level.height), 4, rgba.data(),
+                           static_cast<int>(level.width * 4));
+    fclose(handle);
+  }
+}
+
 }  //  namespace gpu
 }  //  namespace xe
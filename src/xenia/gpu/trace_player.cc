@@ -9,8 +9,11 @@
 
 #include "xenia/gpu/trace_player.h"
 
+#include <chrono>
 #include <memory>
+#include <vector>
 
+#include "xenia/base/logging.h"
 #include "xenia/gpu/command_processor.h"
 #include "xenia/gpu/graphics_system.h"
 #include "xenia/gpu/registers.h"
@@ -52,8 +55,51 @@ void TracePlayer::SeekFrame(int target_frame) {
   current_command_index_ = int(frame->commands.size()) - 1;
 
   assert_true(frame->start_ptr <= frame->end_ptr);
-  PlayTrace(frame->start_ptr, frame->end_ptr - frame->start_ptr,
-            TracePlaybackMode::kBreakOnSwap, false);
+  if (played_end_ptr_ == frame->start_ptr) {
+    // The next frame.
+    PlayTrace(frame->start_ptr, frame->end_ptr - frame->start_ptr,
+              TracePlaybackMode::kBreakOnSwap, false);
+  } else if (played_end_ptr_ && played_end_ptr_ < frame->start_ptr &&
+             played_end_ptr_ >= frame->keyframe_ptr) {
+    // A later frame with no snapshot in between - continue playing.
+    PlayTrace(played_end_ptr_, frame->end_ptr - played_end_ptr_,
+              TracePlaybackMode::kUntilEnd, false);
+  } else {
+    PlayFromKeyframe(frame);
+  }
+}
+
+void TracePlayer::PlayFromKeyframe(const Frame* frame) {
+  auto seek_start_time = std::chrono::steady_clock::now();
+  // The memory isn't included in the snapshots, but the memory reads up to the
+  // snapshot are much cheaper to restore than playing the trace.
+  auto memory_reads = std::make_shared<std::vector<const MemoryCommand*>>();
+  GetMemoryReadsBefore(frame->keyframe_ptr, *memory_reads);
+  auto command_processor = graphics_system_->command_processor();
+  command_processor->CallInThread([this, memory_reads]() {
+    auto memory = graphics_system_->memory();
+    auto command_processor = graphics_system_->command_processor();
+    for (const MemoryCommand* cmd : *memory_reads) {
+      DecompressMemory(cmd->encoding_format, cmd + 1, cmd->encoded_length,
+                       memory->TranslatePhysical(cmd->base_ptr),
+                       cmd->decoded_length);
+      command_processor->TracePlaybackWroteMemory(cmd->base_ptr,
+                                                  cmd->decoded_length);
+    }
+  });
+  PlayTrace(frame->keyframe_ptr, frame->end_ptr - frame->keyframe_ptr,
+            TracePlaybackMode::kUntilEnd, true);
+  command_processor->CallInThread(
+      [seek_start_time, memory_read_count = memory_reads->size(),
+       played_size = frame->end_ptr - frame->keyframe_ptr]() {
+        XELOGI(
+            "Trace seek: restored {} memory reads and played {} bytes in "
+            "{:.1f} ms",
+            memory_read_count, played_size,
+            std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - seek_start_time)
+                .count());
+      });
 }
 
 void TracePlayer::SeekCommand(int target_command) {
@@ -81,6 +127,19 @@ void TracePlayer::SeekCommand(int target_command) {
   }
 }
 
+void TracePlayer::PlayAllFrames() {
+  if (!frame_count()) {
+    return;
+  }
+  const Frame* first_frame = frame(0);
+  current_frame_index_ = frame_count() - 1;
+  auto last_frame = current_frame();
+  current_command_index_ = int(last_frame->commands.size()) - 1;
+  PlayTrace(first_frame->keyframe_ptr,
+            last_frame->end_ptr - first_frame->keyframe_ptr,
+            TracePlaybackMode::kUntilEnd, true);
+}
+
 void TracePlayer::WaitOnPlayback() {
   xe::threading::Wait(playback_event_.get(), true);
 }
@@ -89,6 +148,7 @@ void TracePlayer::PlayTrace(const uint8_t* trace_data, size_t trace_size,
                             TracePlaybackMode playback_mode,
                             bool clear_caches) {
   playing_trace_ = true;
+  played_end_ptr_ = trace_data + trace_size;
   graphics_system_->command_processor()->CallInThread([=]() {
     PlayTraceOnThread(trace_data, trace_size, playback_mode, clear_caches);
   });
@@ -43,18 +43,25 @@ class TracePlayer : public TraceReader {
 
   void SeekFrame(int target_frame);
   void SeekCommand(int target_command);
+  // Plays the whole trace without stopping, such as for benchmarking.
+  void PlayAllFrames();
 
   void WaitOnPlayback();
 
  private:
   void PlayTrace(const uint8_t* trace_data, size_t trace_size,
                  TracePlaybackMode playback_mode, bool clear_caches);
+  // Plays the frame starting from the nearest state snapshot.
+  void PlayFromKeyframe(const Frame* frame);
   void PlayTraceOnThread(const uint8_t* trace_data, size_t trace_size,
                          TracePlaybackMode playback_mode, bool clear_caches);
 
   GraphicsSystem* graphics_system_;
   int current_frame_index_;
   int current_command_index_;
+  // Where the state was last played up to, or nullptr if nothing has been
+  // played yet.
+  const uint8_t* played_end_ptr_ = nullptr;
   bool playing_trace_ = false;
   std::atomic<uint32_t> playback_percent_ = {0};
   std::unique_ptr<xe::threading::Event> playback_event_;
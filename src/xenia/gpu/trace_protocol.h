@@ -19,11 +19,14 @@ namespace gpu {
 static const char kTraceExtension[] = "xtr";
 
 // Any byte changes to the files should bump this version.
-// Only builds with matching versions will work.
+// Readers accept files from older versions too, so a bump that changes the
+// meaning of existing data rather than adding to it must also make the reader
+// reject the versions it can't read anymore.
+// Version 2 added the kZstd and kReference memory encodings.
 // Other changes besides the file format may require bumps, such as
 // anything that changes what is recorded into the files (new GPU
 // command processor commands, etc).
-constexpr uint32_t kTraceFormatVersion = 1;
+constexpr uint32_t kTraceFormatVersion = 2;
 
 // Trace file header identifying information about the trace.
 // This must be positioned at the start of the file and must only occur once.
@@ -95,6 +98,13 @@ enum class MemoryEncodingFormat {
   kNone,
   // Data is compressed with third_party/snappy.
   kSnappy,
+  // Data is compressed with third_party/zstd.
+  kZstd,
+  // Only for MemoryCommand - data is the same as that of an earlier
+  // MemoryCommand, which is never a reference itself. encoded_length is 8, and
+  // the data is the uint64_t offset of the earlier command from the start of
+  // the file.
+  kReference,
 };
 
 // Represents the GPU reading or writing data from or to memory.
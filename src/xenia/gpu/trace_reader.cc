@@ -9,21 +9,63 @@
 
 #include "xenia/gpu/trace_reader.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cinttypes>
+#include <cstring>
+#include <unordered_set>
 
 #include "third_party/snappy/snappy.h"
+#include "third_party/zstd/lib/zstd.h"
 #include "xenia/base/filesystem.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/mapped_memory.h"
 #include "xenia/base/math.h"
 #include "xenia/base/platform.h"
+#include "xenia/base/xxhash.h"
 #include "xenia/gpu/packet_disassembler.h"
+#include "xenia/gpu/register_file.h"
 #include "xenia/gpu/trace_protocol.h"
 #include "xenia/memory.h"
 
 namespace xe {
 namespace gpu {
 
+namespace {
+
+struct TraceIndexHeader {
+  static constexpr fourcc_t kMagic = make_fourcc("XTRI");
+  static constexpr uint32_t kVersion = 1;
+
+  fourcc_t magic;
+  uint32_t version;
+  // To detect changes of the trace, such as of a trace still being streamed.
+  uint64_t trace_size;
+  uint64_t trace_hash;
+  uint32_t frame_count;
+  uint32_t memory_read_count;
+  // Followed by frame_count TraceIndexFrames and memory_read_count uint64_t
+  // offsets of kMemoryRead commands.
+};
+
+struct TraceIndexFrame {
+  uint64_t start_offset;
+  uint64_t end_offset;
+  uint64_t keyframe_offset;
+};
+
+// Hashing only the beginning, with the header, and the end of the trace, as
+// hashing all of a multi-gigabyte trace would take longer than indexing it.
+uint64_t GetTraceIndexHash(const uint8_t* trace_data, size_t trace_size) {
+  constexpr size_t kHashedPartSize = 64 * 1024;
+  size_t hashed_part_size = std::min(trace_size, kHashedPartSize);
+  uint64_t hash = XXH3_64bits(trace_data, hashed_part_size);
+  return XXH3_64bits_withSeed(
+      trace_data + trace_size - hashed_part_size, hashed_part_size, hash);
+}
+
+}  // namespace
+
 bool TraceReader::Open(const std::string_view path) {
   Close();
 
@@ -46,11 +88,13 @@ bool TraceReader::Open(const std::string_view path) {
 
   // Verify version.
   auto header = reinterpret_cast<const TraceHeader*>(trace_data_);
-  if (header->version != kTraceFormatVersion) {
-    XELOGE("Trace format version mismatch, code has {}, file has {}",
+  // Older versions only lack the encodings added later, which the reader
+  // still handles.
+  if (!header->version || header->version > kTraceFormatVersion) {
+    XELOGE("Trace format version mismatch, code supports up to {}, file has {}",
            kTraceFormatVersion, header->version);
-    if (header->version < kTraceFormatVersion) {
-      XELOGE("You need to regenerate your trace for the latest version");
+    if (header->version > kTraceFormatVersion) {
+      XELOGE("You need a newer build to read this trace");
     }
     return false;
   }
@@ -62,7 +106,27 @@ bool TraceReader::Open(const std::string_view path) {
   XELOGI("    Commit: {}", commit_str);
   XELOGI("  Title ID: {}", header->title_id);
 
-  ParseTrace();
+  auto index_start_time = std::chrono::steady_clock::now();
+  std::filesystem::path index_path = xe::to_path(path);
+  index_path += ".index";
+#if XE_PLATFORM_ANDROID
+  if (xe::filesystem::IsAndroidContentUri(path)) {
+    // Nowhere to put the index next to the trace.
+    index_path.clear();
+  }
+#endif  // XE_PLATFORM_ANDROID
+  bool index_loaded = !index_path.empty() && LoadIndex(index_path);
+  if (!index_loaded) {
+    BuildIndex();
+    if (!index_path.empty()) {
+      SaveIndex(index_path);
+    }
+  }
+  XELOGI("{} the index of {} frames in {:.1f} ms",
+         index_loaded ? "Loaded" : "Built", frames_.size(),
+         std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - index_start_time)
+             .count());
 
   return true;
 }
@@ -71,25 +135,312 @@ void TraceReader::Close() {
   mmap_.reset();
   trace_data_ = nullptr;
   trace_size_ = 0;
+  frames_.clear();
+  memory_read_offsets_.clear();
+}
+
+const TraceReader::Frame* TraceReader::frame(int n) const {
+  Frame& frame = frames_[n];
+  if (!frame.command_tree) {
+    ParseFrame(frame);
+  }
+  return &frame;
 }
 
-void TraceReader::ParseTrace() {
+bool TraceReader::LoadIndex(const std::filesystem::path& index_path) {
+  FILE* file = xe::filesystem::OpenFile(index_path, "rb");
+  if (!file) {
+    return false;
+  }
+  TraceIndexHeader header;
+  bool loaded =
+      fread(&header, sizeof(header), 1, file) == 1 &&
+      header.magic == TraceIndexHeader::kMagic &&
+      header.version == TraceIndexHeader::kVersion &&
+      header.trace_size == trace_size_ &&
+      header.trace_hash == GetTraceIndexHash(trace_data_, trace_size_);
+  if (loaded) {
+    // Validating the counts before allocating the memory for them.
+    xe::filesystem::Seek(file, 0, SEEK_END);
+    int64_t index_told_end = xe::filesystem::Tell(file);
+    uint64_t index_data_size =
+        index_told_end >= int64_t(sizeof(header))
+            ? uint64_t(index_told_end) - sizeof(header)
+            : 0;
+    uint64_t index_frames_size =
+        uint64_t(sizeof(TraceIndexFrame)) * header.frame_count;
+    loaded = xe::filesystem::Seek(file, int64_t(sizeof(header)), SEEK_SET) &&
+             index_frames_size <= index_data_size &&
+             header.memory_read_count <= (index_data_size - index_frames_size) /
+                                             sizeof(uint64_t);
+  }
+  if (loaded) {
+    std::vector<TraceIndexFrame> index_frames(header.frame_count);
+    memory_read_offsets_.resize(header.memory_read_count);
+    loaded = fread(index_frames.data(), sizeof(TraceIndexFrame),
+                   index_frames.size(), file) == index_frames.size() &&
+             fread(memory_read_offsets_.data(), sizeof(uint64_t),
+                   memory_read_offsets_.size(),
+                   file) == memory_read_offsets_.size();
+    for (const TraceIndexFrame& index_frame : index_frames) {
+      if (!loaded) {
+        break;
+      }
+      if (index_frame.start_offset < sizeof(TraceHeader) ||
+          index_frame.start_offset > index_frame.end_offset ||
+          index_frame.end_offset > trace_size_ ||
+          index_frame.keyframe_offset < sizeof(TraceHeader) ||
+          index_frame.keyframe_offset > index_frame.start_offset) {
+        loaded = false;
+        break;
+      }
+      Frame& frame = frames_.emplace_back();
+      frame.start_ptr = trace_data_ + index_frame.start_offset;
+      frame.end_ptr = trace_data_ + index_frame.end_offset;
+      frame.keyframe_ptr = trace_data_ + index_frame.keyframe_offset;
+    }
+    // GetMemoryReadsBefore relies on the offsets being sorted and pointing to
+    // complete kMemoryRead commands.
+    uint64_t memory_read_offset_min = sizeof(TraceHeader);
+    for (uint64_t memory_read_offset : memory_read_offsets_) {
+      if (!loaded) {
+        break;
+      }
+      if (memory_read_offset < memory_read_offset_min ||
+          memory_read_offset > trace_size_ ||
+          trace_size_ - memory_read_offset < sizeof(MemoryCommand)) {
+        loaded = false;
+        break;
+      }
+      auto cmd = reinterpret_cast<const MemoryCommand*>(trace_data_ +
+                                                        memory_read_offset);
+      if (cmd->type != TraceCommandType::kMemoryRead ||
+          cmd->encoded_length >
+              trace_size_ - memory_read_offset - sizeof(MemoryCommand)) {
+        loaded = false;
+        break;
+      }
+      memory_read_offset_min =
+          memory_read_offset + sizeof(MemoryCommand) + cmd->encoded_length;
+    }
+  }
+  fclose(file);
+  if (!loaded) {
+    XELOGW("Trace index {} is outdated or corrupted, rebuilding",
+           xe::path_to_utf8(index_path));
+    frames_.clear();
+    memory_read_offsets_.clear();
+  }
+  return loaded;
+}
+
+void TraceReader::BuildIndex() {
+  frames_.clear();
+  memory_read_offsets_.clear();
+
   // Skip file header.
   auto trace_ptr = trace_data_;
   trace_ptr += sizeof(TraceHeader);
+  const uint8_t* trace_end = trace_data_ + trace_size_;
 
   Frame current_frame;
   current_frame.start_ptr = trace_ptr;
+  current_frame.keyframe_ptr = trace_ptr;
+  bool frame_has_commands = false;
+  bool frame_has_packets = false;
+  bool packet_started = false;
+  bool pending_break = false;
+  // Snapshot written after the swap, belonging to the next frame.
+  const uint8_t* next_keyframe_ptr = nullptr;
+
+  // Only walking the command headers, not touching the data.
+  while (trace_ptr < trace_end) {
+    if (size_t(trace_end - trace_ptr) < sizeof(uint32_t)) {
+      XELOGW("Trace is truncated");
+      break;
+    }
+    const uint8_t* command_ptr = trace_ptr;
+    size_t command_size;
+    auto type = static_cast<TraceCommandType>(xe::load<uint32_t>(trace_ptr));
+    switch (type) {
+      case TraceCommandType::kPrimaryBufferStart:
+        command_size = sizeof(PrimaryBufferStartCommand) +
+                       reinterpret_cast<const PrimaryBufferStartCommand*>(
+                           command_ptr)
+                               ->count *
+                           4;
+        break;
+      case TraceCommandType::kPrimaryBufferEnd:
+        command_size = sizeof(PrimaryBufferEndCommand);
+        break;
+      case TraceCommandType::kIndirectBufferStart:
+        command_size = sizeof(IndirectBufferStartCommand) +
+                       reinterpret_cast<const IndirectBufferStartCommand*>(
+                           command_ptr)
+                               ->count *
+                           4;
+        break;
+      case TraceCommandType::kIndirectBufferEnd:
+        // IB packet is wrapped in a kPacketStart/kPacketEnd. Skip the end.
+        command_size =
+            sizeof(IndirectBufferEndCommand) + sizeof(IndirectBufferEndCommand);
+        break;
+      case TraceCommandType::kPacketStart:
+        command_size =
+            sizeof(PacketStartCommand) +
+            reinterpret_cast<const PacketStartCommand*>(command_ptr)->count * 4;
+        packet_started = true;
+        break;
+      case TraceCommandType::kPacketEnd:
+        command_size = sizeof(PacketEndCommand);
+        break;
+      case TraceCommandType::kMemoryRead:
+      case TraceCommandType::kMemoryWrite:
+        command_size =
+            sizeof(MemoryCommand) +
+            reinterpret_cast<const MemoryCommand*>(command_ptr)->encoded_length;
+        break;
+      case TraceCommandType::kEdramSnapshot:
+        command_size = sizeof(EdramSnapshotCommand) +
+                       reinterpret_cast<const EdramSnapshotCommand*>(
+                           command_ptr)
+                           ->encoded_length;
+        break;
+      case TraceCommandType::kEvent:
+        command_size = sizeof(EventCommand);
+        break;
+      case TraceCommandType::kRegisters:
+        command_size =
+            sizeof(RegistersCommand) +
+            reinterpret_cast<const RegistersCommand*>(command_ptr)
+                ->encoded_length;
+        break;
+      case TraceCommandType::kGammaRamp:
+        command_size =
+            sizeof(GammaRampCommand) +
+            reinterpret_cast<const GammaRampCommand*>(command_ptr)
+                ->encoded_length;
+        break;
+      default:
+        XELOGE("Unknown trace command {} at offset {}", uint32_t(type),
+               command_ptr - trace_data_);
+        command_size = SIZE_MAX;
+        break;
+    }
+    if (command_size > size_t(trace_end - command_ptr)) {
+      XELOGW("Trace is truncated or corrupted at offset {}",
+             command_ptr - trace_data_);
+      break;
+    }
+    trace_ptr += command_size;
+    frame_has_commands = true;
+
+    switch (type) {
+      case TraceCommandType::kPacketEnd: {
+        if (!packet_started) {
+          continue;
+        }
+        frame_has_packets = true;
+        if (pending_break) {
+          current_frame.end_ptr = trace_ptr;
+          const uint8_t* keyframe_ptr = next_keyframe_ptr
+                                            ? next_keyframe_ptr
+                                            : current_frame.keyframe_ptr;
+          frames_.push_back(std::move(current_frame));
+          current_frame = Frame();
+          current_frame.start_ptr = trace_ptr;
+          current_frame.keyframe_ptr = keyframe_ptr;
+          frame_has_commands = false;
+          frame_has_packets = false;
+          pending_break = false;
+          next_keyframe_ptr = nullptr;
+        }
+      } break;
+      case TraceCommandType::kMemoryRead:
+        memory_read_offsets_.push_back(uint64_t(command_ptr - trace_data_));
+        break;
+      case TraceCommandType::kEvent: {
+        auto cmd = reinterpret_cast<const EventCommand*>(command_ptr);
+        if (cmd->event_type == EventCommand::Type::kSwap) {
+          pending_break = true;
+        }
+      } break;
+      case TraceCommandType::kRegisters: {
+        // All registers written at once by InitializeTrace, with the rest of
+        // the state following them.
+        auto cmd = reinterpret_cast<const RegistersCommand*>(command_ptr);
+        if (!cmd->first_register &&
+            cmd->register_count == RegisterFile::kRegisterCount &&
+            !cmd->execute_callbacks) {
+          if (pending_break) {
+            next_keyframe_ptr = command_ptr;
+          } else if (!frame_has_packets) {
+            current_frame.keyframe_ptr = command_ptr;
+          }
+        }
+      } break;
+      default:
+        break;
+    }
+  }
+  if (pending_break || frame_has_commands) {
+    current_frame.end_ptr = trace_ptr;
+    frames_.push_back(std::move(current_frame));
+  }
+}
+
+void TraceReader::SaveIndex(const std::filesystem::path& index_path) const {
+  FILE* file = xe::filesystem::OpenFile(index_path, "wb");
+  if (!file) {
+    XELOGW("Failed to create the trace index {}",
+           xe::path_to_utf8(index_path));
+    return;
+  }
+  TraceIndexHeader header = {};
+  header.magic = TraceIndexHeader::kMagic;
+  header.version = TraceIndexHeader::kVersion;
+  header.trace_size = trace_size_;
+  header.trace_hash = GetTraceIndexHash(trace_data_, trace_size_);
+  header.frame_count = uint32_t(frames_.size());
+  header.memory_read_count = uint32_t(memory_read_offsets_.size());
+  std::vector<TraceIndexFrame> index_frames;
+  index_frames.reserve(frames_.size());
+  for (const Frame& frame : frames_) {
+    TraceIndexFrame& index_frame = index_frames.emplace_back();
+    index_frame.start_offset = uint64_t(frame.start_ptr - trace_data_);
+    index_frame.end_offset = uint64_t(frame.end_ptr - trace_data_);
+    index_frame.keyframe_offset = uint64_t(frame.keyframe_ptr - trace_data_);
+  }
+  bool saved =
+      fwrite(&header, sizeof(header), 1, file) == 1 &&
+      fwrite(index_frames.data(), sizeof(TraceIndexFrame),
+             index_frames.size(), file) == index_frames.size() &&
+      fwrite(memory_read_offsets_.data(), sizeof(uint64_t),
+             memory_read_offsets_.size(),
+             file) == memory_read_offsets_.size();
+  fclose(file);
+  if (!saved) {
+    XELOGW("Failed to write the trace index {}",
+           xe::path_to_utf8(index_path));
+    std::error_code error_code;
+    std::filesystem::remove(index_path, error_code);
+  }
+}
+
+void TraceReader::ParseFrame(Frame& frame) const {
+  auto trace_ptr = frame.start_ptr;
+
   const PacketStartCommand* packet_start = nullptr;
   const uint8_t* packet_start_ptr = nullptr;
   const uint8_t* last_ptr = trace_ptr;
-  bool pending_break = false;
+  frame.command_count = 0;
+  frame.packet_count = 0;
+  frame.commands.clear();
   auto current_command_buffer = new CommandBuffer();
-  current_frame.command_tree =
-      std::unique_ptr<CommandBuffer>(current_command_buffer);
+  frame.command_tree = std::unique_ptr<CommandBuffer>(current_command_buffer);
 
-  while (trace_ptr < trace_data_ + trace_size_) {
-    ++current_frame.command_count;
+  while (trace_ptr < frame.end_ptr) {
+    ++frame.command_count;
     auto type = static_cast<TraceCommandType>(xe::load<uint32_t>(trace_ptr));
     switch (type) {
       case TraceCommandType::kPrimaryBufferStart: {
@@ -137,6 +488,7 @@ void TraceReader::ParseTrace() {
         packet_start_ptr = trace_ptr;
         packet_start = cmd;
         trace_ptr += sizeof(*cmd) + cmd->count * 4;
+        ++frame.packet_count;
         break;
       }
       case TraceCommandType::kPacketEnd: {
@@ -154,10 +506,10 @@ void TraceReader::ParseTrace() {
             command.head_ptr = packet_start_ptr;
             command.start_ptr = last_ptr;
             command.end_ptr = trace_ptr;
-            current_frame.commands.push_back(std::move(command));
+            frame.commands.push_back(std::move(command));
             last_ptr = trace_ptr;
             current_command_buffer->commands.push_back(CommandBuffer::Command(
-                uint32_t(current_frame.commands.size() - 1)));
+                uint32_t(frame.commands.size() - 1)));
             break;
           }
           case PacketCategory::kSwap: {
@@ -166,27 +518,16 @@ void TraceReader::ParseTrace() {
             command.head_ptr = packet_start_ptr;
             command.start_ptr = last_ptr;
             command.end_ptr = trace_ptr;
-            current_frame.commands.push_back(std::move(command));
+            frame.commands.push_back(std::move(command));
             last_ptr = trace_ptr;
             current_command_buffer->commands.push_back(CommandBuffer::Command(
-                uint32_t(current_frame.commands.size() - 1)));
+                uint32_t(frame.commands.size() - 1)));
           } break;
           case PacketCategory::kGeneric: {
             // Ignored.
             break;
           }
         }
-        if (pending_break) {
-          current_frame.end_ptr = trace_ptr;
-          frames_.push_back(std::move(current_frame));
-          current_command_buffer = new CommandBuffer();
-          current_frame.command_tree =
-              std::unique_ptr<CommandBuffer>(current_command_buffer);
-          current_frame.start_ptr = trace_ptr;
-          current_frame.end_ptr = nullptr;
-          current_frame.command_count = 0;
-          pending_break = false;
-        }
         break;
       }
       case TraceCommandType::kMemoryRead: {
@@ -207,12 +548,6 @@ void TraceReader::ParseTrace() {
       case TraceCommandType::kEvent: {
         auto cmd = reinterpret_cast<const EventCommand*>(trace_ptr);
         trace_ptr += sizeof(*cmd);
-        switch (cmd->event_type) {
-          case EventCommand::Type::kSwap: {
-            pending_break = true;
-            break;
-          }
-        }
         break;
       }
       case TraceCommandType::kRegisters: {
@@ -226,15 +561,33 @@ void TraceReader::ParseTrace() {
         break;
       }
       default:
-        // Broken trace file?
+        // The index only covers valid commands.
         assert_unhandled_case(type);
-        break;
+        return;
     }
   }
-  if (pending_break || current_frame.command_count) {
-    current_frame.end_ptr = trace_ptr;
-    frames_.push_back(std::move(current_frame));
+}
+
+void TraceReader::GetMemoryReadsBefore(
+    const uint8_t* end_ptr,
+    std::vector<const MemoryCommand*>& commands_out) const {
+  commands_out.clear();
+  auto offsets_end =
+      std::lower_bound(memory_read_offsets_.cbegin(),
+                       memory_read_offsets_.cend(),
+                       uint64_t(end_ptr - trace_data_));
+  // Going backwards to find the last read of each range.
+  std::unordered_set<uint64_t> ranges_read;
+  for (auto it = offsets_end; it != memory_read_offsets_.cbegin();) {
+    --it;
+    auto cmd = reinterpret_cast<const MemoryCommand*>(trace_data_ + *it);
+    if (ranges_read
+            .insert(uint64_t(cmd->base_ptr) << 32 | cmd->decoded_length)
+            .second) {
+      commands_out.push_back(cmd);
+    }
   }
+  std::reverse(commands_out.begin(), commands_out.end());
 }
 
 bool TraceReader::DecompressMemory(MemoryEncodingFormat encoding_format,
@@ -248,6 +601,35 @@ bool TraceReader::DecompressMemory(MemoryEncodingFormat encoding_format,
     case MemoryEncodingFormat::kSnappy:
       return snappy::RawUncompress(reinterpret_cast<const char*>(src), src_size,
                                    reinterpret_cast<char*>(dest));
+    case MemoryEncodingFormat::kZstd: {
+      size_t result = ZSTD_decompress(dest, dest_size, src, src_size);
+      return !ZSTD_isError(result) && result == dest_size;
+    }
+    case MemoryEncodingFormat::kReference: {
+      if (src_size != sizeof(uint64_t)) {
+        return false;
+      }
+      uint64_t offset;
+      std::memcpy(&offset, src, sizeof(offset));
+      if (offset > trace_size_ ||
+          trace_size_ - offset < sizeof(MemoryCommand)) {
+        return false;
+      }
+      MemoryCommand referenced_cmd;
+      std::memcpy(&referenced_cmd, trace_data_ + offset,
+                  sizeof(referenced_cmd));
+      if ((referenced_cmd.type != TraceCommandType::kMemoryRead &&
+           referenced_cmd.type != TraceCommandType::kMemoryWrite) ||
+          referenced_cmd.encoding_format == MemoryEncodingFormat::kReference ||
+          referenced_cmd.decoded_length != dest_size ||
+          trace_size_ - offset - sizeof(MemoryCommand) <
+              referenced_cmd.encoded_length) {
+        return false;
+      }
+      return DecompressMemory(referenced_cmd.encoding_format,
+                              trace_data_ + offset + sizeof(MemoryCommand),
+                              referenced_cmd.encoded_length, dest, dest_size);
+    }
     default:
       assert_unhandled_case(encoding_format);
       return false;
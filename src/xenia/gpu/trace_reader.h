@@ -10,6 +10,7 @@
 #ifndef XENIA_GPU_TRACE_READER_H_
 #define XENIA_GPU_TRACE_READER_H_
 
+#include <filesystem>
 #include <string_view>
 #include <vector>
 
@@ -80,7 +81,12 @@ class TraceReader {
 
     const uint8_t* start_ptr = nullptr;
     const uint8_t* end_ptr = nullptr;
+    // Nearest full state snapshot at or before the start of the frame, from
+    // which the frame can be played without playing the earlier frames, or the
+    // beginning of the trace if there's none.
+    const uint8_t* keyframe_ptr = nullptr;
     int command_count = 0;
+    int packet_count = 0;
 
     // Flat list of all commands in this frame.
     std::vector<Command> commands;
@@ -96,7 +102,8 @@ class TraceReader {
     return reinterpret_cast<const TraceHeader*>(trace_data_);
   }
 
-  const Frame* frame(int n) const { return &frames_[n]; }
+  // The commands of the frame are parsed on the first access.
+  const Frame* frame(int n) const;
   int frame_count() const { return int(frames_.size()); }
 
   bool Open(const std::string_view path);
@@ -104,14 +111,29 @@ class TraceReader {
   void Close();
 
  protected:
-  void ParseTrace();
+  // Frame boundaries, state snapshots and memory reads, which are enough to
+  // start playback from any frame, are found in a single pass over the command
+  // headers, and cached in a file next to the trace.
+  bool LoadIndex(const std::filesystem::path& index_path);
+  void BuildIndex();
+  void SaveIndex(const std::filesystem::path& index_path) const;
+  void ParseFrame(Frame& frame) const;
+  // Gathers the memory reads before end_ptr, in trace order, excluding those
+  // fully overwritten by a later read of the same range, to bring the memory
+  // to its state at end_ptr without playing the trace.
+  void GetMemoryReadsBefore(
+      const uint8_t* end_ptr,
+      std::vector<const MemoryCommand*>& commands_out) const;
   bool DecompressMemory(MemoryEncodingFormat encoding_format, const void* src,
                         size_t src_size, void* dest, size_t dest_size);
 
   std::unique_ptr<MappedMemory> mmap_;
   const uint8_t* trace_data_ = nullptr;
   size_t trace_size_ = 0;
-  std::vector<Frame> frames_;
+  // Commands of frames are parsed lazily in frame().
+  mutable std::vector<Frame> frames_;
+  // Offsets of all kMemoryRead commands, in trace order.
+  std::vector<uint64_t> memory_read_offsets_;
 };
 
 }  // namespace gpu
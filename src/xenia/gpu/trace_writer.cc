@@ -9,27 +9,52 @@
 
 #include "xenia/gpu/trace_writer.h"
 
+#include <algorithm>
+#include <cstddef>
 #include <cstring>
 #include <memory>
 
-#include "third_party/snappy/snappy-sinksource.h"
 #include "third_party/snappy/snappy.h"
+#include "third_party/zstd/lib/zstd.h"
 
 #include "build/version.h"
 #include "xenia/base/assert.h"
+#include "xenia/base/cvar.h"
 #include "xenia/base/filesystem.h"
+#include "xenia/base/literals.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/string.h"
+#include "xenia/base/xxhash.h"
 #include "xenia/gpu/registers.h"
 #include "xenia/gpu/xenos.h"
 
+DEFINE_string(trace_gpu_compression, "zstd",
+              "Compression of the data in GPU traces.\n"
+              "Use: [none, snappy, zstd]",
+              "GPU");
+DEFINE_int32(trace_gpu_zstd_level, 1,
+             "zstd compression level of the data in GPU traces.", "GPU");
+DEFINE_uint32(trace_gpu_encoder_threads, 0,
+              "Number of threads compressing the data in GPU traces. 0 to "
+              "pick the number based on the number of logical processors.",
+              "GPU");
+DEFINE_uint32(trace_gpu_max_pending_size, 256,
+              "Maximum size in MB of GPU trace data waiting to be compressed "
+              "and written before the GPU waits for the trace writer.",
+              "GPU");
+
 namespace xe {
 namespace gpu {
 #if XE_ENABLE_TRACE_WRITER_INSTRUMENTATION == 1
+using namespace xe::literals;
+
+// Raw commands are submitted in batches of at least this size.
+constexpr size_t kRawJobSize = 64_KiB;
+
 TraceWriter::TraceWriter(uint8_t* membase)
     : membase_(membase), file_(nullptr) {}
 
-TraceWriter::~TraceWriter() = default;
+TraceWriter::~TraceWriter() { Close(); }
 
 bool TraceWriter::Open(const std::filesystem::path& path, uint32_t title_id) {
   Close();
@@ -52,20 +77,75 @@ bool TraceWriter::Open(const std::filesystem::path& path, uint32_t title_id) {
               sizeof(header.build_commit_sha));
   header.title_id = title_id;
   fwrite(&header, sizeof(header), 1, file_);
+  file_offset_ = sizeof(header);
 
   cached_memory_reads_.clear();
+
+  if (cvars::trace_gpu_compression == "zstd") {
+    compression_format_ = MemoryEncodingFormat::kZstd;
+  } else if (cvars::trace_gpu_compression == "snappy") {
+    compression_format_ = MemoryEncodingFormat::kSnappy;
+  } else {
+    if (cvars::trace_gpu_compression != "none") {
+      XELOGW("Unknown GPU trace compression {}, not compressing",
+             cvars::trace_gpu_compression);
+    }
+    compression_format_ = MemoryEncodingFormat::kNone;
+  }
+  zstd_compression_level_ = cvars::trace_gpu_zstd_level;
+
+  // Capturing is done on the command processor thread, while the data is
+  // compressed on the encoder threads, and written in order on the writer
+  // thread.
+  next_job_id_ = 0;
+  pending_job_bytes_ = 0;
+  max_pending_job_bytes_ = size_t(cvars::trace_gpu_max_pending_size) * 1_MiB;
+  shutting_down_ = false;
+  uint32_t encoder_thread_count = cvars::trace_gpu_encoder_threads;
+  if (!encoder_thread_count) {
+    encoder_thread_count =
+        std::clamp(xe::threading::logical_processor_count() / 2, 1u, 4u);
+  }
+  for (uint32_t i = 0; i < encoder_thread_count; ++i) {
+    auto encoder_thread = xe::threading::Thread::Create(
+        {}, [this]() { EncoderThreadMain(); });
+    encoder_thread->set_name(fmt::format("GPU Trace Encoder {}", i));
+    encoder_threads_.push_back(std::move(encoder_thread));
+  }
+  writer_thread_ =
+      xe::threading::Thread::Create({}, [this]() { WriterThreadMain(); });
+  writer_thread_->set_name("GPU Trace Writer");
   return true;
 }
 
 void TraceWriter::Flush() {
   if (file_) {
-    fflush(file_);
+    // Not waiting for the writer, only making sure everything captured so far
+    // reaches the file without further commands.
+    SubmitRawJob(true);
   }
 }
 
 void TraceWriter::Close() {
   if (file_) {
+    SubmitRawJob();
+    {
+      std::unique_lock<std::mutex> lock(jobs_mutex_);
+      shutting_down_ = true;
+    }
+    encode_jobs_cond_.notify_all();
+    write_cond_.notify_all();
+    for (auto& encoder_thread : encoder_threads_) {
+      xe::threading::Wait(encoder_thread.get(), false);
+    }
+    encoder_threads_.clear();
+    xe::threading::Wait(writer_thread_.get(), false);
+    writer_thread_.reset();
+    assert_true(jobs_.empty());
+
     cached_memory_reads_.clear();
+    memory_job_ids_.clear();
+    memory_job_offsets_.clear();
 
     fflush(file_);
     fclose(file_);
@@ -73,6 +153,200 @@ void TraceWriter::Close() {
   }
 }
 
+void TraceWriter::WriteRaw(const void* data, size_t length) {
+  if (!raw_job_) {
+    raw_job_ = std::make_unique<Job>();
+    raw_job_->type = Job::Type::kRaw;
+    raw_job_->data.reserve(kRawJobSize);
+  }
+  raw_job_->data.insert(raw_job_->data.end(),
+                        reinterpret_cast<const uint8_t*>(data),
+                        reinterpret_cast<const uint8_t*>(data) + length);
+  if (raw_job_->data.size() >= kRawJobSize) {
+    SubmitRawJob();
+  }
+}
+
+void TraceWriter::SubmitRawJob(bool flush) {
+  if (!raw_job_) {
+    if (!flush) {
+      return;
+    }
+    raw_job_ = std::make_unique<Job>();
+    raw_job_->type = Job::Type::kRaw;
+  }
+  raw_job_->ready = true;
+  raw_job_->flush = flush;
+  SubmitJob(std::move(raw_job_));
+}
+
+uint64_t TraceWriter::SubmitJob(std::unique_ptr<Job> job) {
+  job->submitted_size = job->data.size();
+  Job* job_ptr = job.get();
+  uint64_t job_id;
+  {
+    std::unique_lock<std::mutex> lock(jobs_mutex_);
+    // Let the writer catch up if too much data is pending, but don't wait
+    // forever for a job larger than the limit.
+    jobs_written_cond_.wait(lock, [this, job_ptr]() {
+      return !pending_job_bytes_ ||
+             pending_job_bytes_ + job_ptr->submitted_size <=
+                 max_pending_job_bytes_;
+    });
+    job_id = next_job_id_++;
+    job->id = job_id;
+    pending_job_bytes_ += job->submitted_size;
+    jobs_.push_back(std::move(job));
+    if (job_ptr->type == Job::Type::kEncode) {
+      encode_jobs_.push_back(job_ptr);
+    }
+  }
+  if (job_ptr->type == Job::Type::kEncode) {
+    encode_jobs_cond_.notify_one();
+  } else {
+    write_cond_.notify_one();
+  }
+  return job_id;
+}
+
+void TraceWriter::EncoderThreadMain() {
+  ZSTD_CCtx* zstd_context = nullptr;
+  std::vector<uint8_t> encoded;
+  while (true) {
+    Job* job;
+    {
+      std::unique_lock<std::mutex> lock(jobs_mutex_);
+      encode_jobs_cond_.wait(lock, [this]() {
+        return shutting_down_ || !encode_jobs_.empty();
+      });
+      if (encode_jobs_.empty()) {
+        break;
+      }
+      job = encode_jobs_.front();
+      encode_jobs_.pop_front();
+    }
+
+    const uint8_t* data = job->data.data() + job->command_size;
+    size_t length = job->data.size() - job->command_size;
+    MemoryEncodingFormat encoding_format = MemoryEncodingFormat::kNone;
+    size_t encoded_length = 0;
+    switch (compression_format_) {
+      case MemoryEncodingFormat::kSnappy:
+        encoded.resize(job->command_size + snappy::MaxCompressedLength(length));
+        snappy::RawCompress(
+            reinterpret_cast<const char*>(data), length,
+            reinterpret_cast<char*>(encoded.data() + job->command_size),
+            &encoded_length);
+        encoding_format = MemoryEncodingFormat::kSnappy;
+        break;
+      case MemoryEncodingFormat::kZstd: {
+        if (!zstd_context) {
+          zstd_context = ZSTD_createCCtx();
+        }
+        encoded.resize(job->command_size + ZSTD_compressBound(length));
+        size_t result = ZSTD_compressCCtx(
+            zstd_context, encoded.data() + job->command_size,
+            encoded.size() - job->command_size, data, length,
+            zstd_compression_level_);
+        if (!ZSTD_isError(result)) {
+          encoded_length = result;
+          encoding_format = MemoryEncodingFormat::kZstd;
+        }
+      } break;
+      default:
+        break;
+    }
+    // Keep the data that doesn't compress as is.
+    if (encoding_format != MemoryEncodingFormat::kNone &&
+        encoded_length < length) {
+      std::memcpy(encoded.data(), job->data.data(), job->command_size);
+      encoded.resize(job->command_size + encoded_length);
+      // The old buffer is reused for the next job.
+      job->data.swap(encoded);
+    } else {
+      encoding_format = MemoryEncodingFormat::kNone;
+      encoded_length = length;
+    }
+    auto encoded_length_32 = uint32_t(encoded_length);
+    std::memcpy(job->data.data() + job->encoding_format_offset,
+                &encoding_format, sizeof(encoding_format));
+    std::memcpy(job->data.data() + job->encoded_length_offset,
+                &encoded_length_32, sizeof(encoded_length_32));
+
+    {
+      std::unique_lock<std::mutex> lock(jobs_mutex_);
+      job->ready = true;
+    }
+    write_cond_.notify_one();
+  }
+  if (zstd_context) {
+    ZSTD_freeCCtx(zstd_context);
+  }
+}
+
+void TraceWriter::WriterThreadMain() {
+  while (true) {
+    std::unique_ptr<Job> job;
+    {
+      std::unique_lock<std::mutex> lock(jobs_mutex_);
+      write_cond_.wait(lock, [this]() {
+        return (!jobs_.empty() && jobs_.front()->ready) ||
+               (shutting_down_ && jobs_.empty());
+      });
+      if (jobs_.empty()) {
+        break;
+      }
+      job = std::move(jobs_.front());
+      jobs_.pop_front();
+    }
+
+    if (job->type == Job::Type::kReference) {
+      auto offset_it = memory_job_offsets_.find(job->referenced_job_id);
+      assert_true(offset_it != memory_job_offsets_.end());
+      uint64_t offset = offset_it->second;
+      job->data.insert(job->data.end(), reinterpret_cast<uint8_t*>(&offset),
+                       reinterpret_cast<uint8_t*>(&offset) + sizeof(offset));
+    } else if (job->referenceable) {
+      memory_job_offsets_.emplace(job->id, file_offset_);
+    }
+    fwrite(job->data.data(), 1, job->data.size(), file_);
+    file_offset_ += job->data.size();
+    if (job->flush) {
+      fflush(file_);
+    }
+
+    {
+      std::unique_lock<std::mutex> lock(jobs_mutex_);
+      pending_job_bytes_ -= job->submitted_size;
+    }
+    jobs_written_cond_.notify_all();
+  }
+}
+
+template <typename Command>
+uint64_t TraceWriter::WriteEncodedCommand(const Command& cmd, const void* data,
+                                          size_t length, bool referenceable,
+                                          const void* data_2,
+                                          size_t length_2) {
+  // Commands must be written in order.
+  SubmitRawJob();
+  auto job = std::make_unique<Job>();
+  job->type = Job::Type::kEncode;
+  job->command_size = sizeof(Command);
+  job->encoding_format_offset = offsetof(Command, encoding_format);
+  job->encoded_length_offset = offsetof(Command, encoded_length);
+  job->referenceable = referenceable;
+  // Copying now as the data may change before it's encoded.
+  job->data.resize(sizeof(Command) + length + length_2);
+  std::memcpy(job->data.data(), &cmd, sizeof(Command));
+  std::memcpy(job->data.data() + sizeof(Command), data, length);
+  if (length_2) {
+    std::memcpy(job->data.data() + sizeof(Command) + length, data_2,
+                length_2);
+  }
+  return SubmitJob(std::move(job));
+}
+
 void TraceWriter::WritePrimaryBufferStart(uint32_t base_ptr, uint32_t count) {
   if (!file_) {
     return;
@@ -82,7 +356,7 @@ void TraceWriter::WritePrimaryBufferStart(uint32_t base_ptr, uint32_t count) {
       base_ptr,
       0,
   };
-  fwrite(&cmd, 1, sizeof(cmd), file_);
+  WriteRaw(&cmd, sizeof(cmd));
 }
 
 void TraceWriter::WritePrimaryBufferEnd() {
@@ -92,7 +366,7 @@ void TraceWriter::WritePrimaryBufferEnd() {
   PrimaryBufferEndCommand cmd = {
       TraceCommandType::kPrimaryBufferEnd,
   };
-  fwrite(&cmd, 1, sizeof(cmd), file_);
+  WriteRaw(&cmd, sizeof(cmd));
 }
 
 void TraceWriter::WriteIndirectBufferStart(uint32_t base_ptr, uint32_t count) {
@@ -104,7 +378,7 @@ void TraceWriter::WriteIndirectBufferStart(uint32_t base_ptr, uint32_t count) {
       base_ptr,
       0,
   };
-  fwrite(&cmd, 1, sizeof(cmd), file_);
+  WriteRaw(&cmd, sizeof(cmd));
 }
 
 void TraceWriter::WriteIndirectBufferEnd() {
@@ -114,7 +388,7 @@ void TraceWriter::WriteIndirectBufferEnd() {
   IndirectBufferEndCommand cmd = {
       TraceCommandType::kIndirectBufferEnd,
   };
-  fwrite(&cmd, 1, sizeof(cmd), file_);
+  WriteRaw(&cmd, sizeof(cmd));
 }
 
 void TraceWriter::WritePacketStart(uint32_t base_ptr, uint32_t count) {
@@ -126,8 +400,8 @@ void TraceWriter::WritePacketStart(uint32_t base_ptr, uint32_t count) {
       base_ptr,
       count,
   };
-  fwrite(&cmd, 1, sizeof(cmd), file_);
-  fwrite(membase_ + base_ptr, 4, count, file_);
+  WriteRaw(&cmd, sizeof(cmd));
+  WriteRaw(membase_ + base_ptr, sizeof(uint32_t) * count);
 }
 
 void TraceWriter::WritePacketEnd() {
@@ -137,7 +411,7 @@ void TraceWriter::WritePacketEnd() {
   PacketEndCommand cmd = {
       TraceCommandType::kPacketEnd,
   };
-  fwrite(&cmd, 1, sizeof(cmd), file_);
+  WriteRaw(&cmd, sizeof(cmd));
 }
 
 void TraceWriter::WriteMemoryRead(uint32_t base_ptr, size_t length,
@@ -182,18 +456,6 @@ void TraceWriter::WriteMemoryWrite(uint32_t base_ptr, size_t length,
                      host_ptr);
 }
 
-class SnappySink : public snappy::Sink {
- public:
-  SnappySink(FILE* file) : file_(file) {}
-
-  void Append(const char* bytes, size_t n) override {
-    fwrite(bytes, 1, n, file_);
-  }
-
- private:
-  FILE* file_ = nullptr;
-};
-
 void TraceWriter::WriteMemoryCommand(TraceCommandType type, uint32_t base_ptr,
                                      size_t length, const void* host_ptr) {
   MemoryCommand cmd = {};
@@ -206,62 +468,43 @@ void TraceWriter::WriteMemoryCommand(TraceCommandType type, uint32_t base_ptr,
     host_ptr = membase_ + cmd.base_ptr;
   }
 
-  bool compress = compress_output_ && length > compression_threshold_;
-  if (compress) {
-    // Write the header now so we reserve space in the buffer.
-    long header_position = std::ftell(file_);
-    cmd.encoding_format = MemoryEncodingFormat::kSnappy;
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-
-    // Stream the content right to the buffer.
-    snappy::ByteArraySource snappy_source(
-        reinterpret_cast<const char*>(host_ptr), cmd.decoded_length);
-    SnappySink snappy_sink(file_);
-    cmd.encoded_length =
-        static_cast<uint32_t>(snappy::Compress(&snappy_source, &snappy_sink));
-
-    // Seek back and overwrite the header with our final size.
-    std::fseek(file_, header_position, SEEK_SET);
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-    std::fseek(file_, header_position + sizeof(cmd) + cmd.encoded_length,
-               SEEK_SET);
-  } else {
-    // Uncompressed - write buffer directly to the file.
-    cmd.encoding_format = MemoryEncodingFormat::kNone;
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-    fwrite(host_ptr, 1, cmd.decoded_length, file_);
+  if (length <= compression_threshold_) {
+    // Small enough to be batched with the other commands as is.
+    WriteRaw(&cmd, sizeof(cmd));
+    WriteRaw(host_ptr, length);
+    return;
+  }
+
+  // Textures and buffers are often uploaded many times with the same contents,
+  // possibly at different addresses - store them only once.
+  XXH128_hash_t hash_128 = XXH3_128bits_withSeed(host_ptr, length, length);
+  MemoryDataHash hash = {hash_128.low64, hash_128.high64};
+  auto job_id_it = memory_job_ids_.find(hash);
+  if (job_id_it != memory_job_ids_.end()) {
+    SubmitRawJob();
+    auto job = std::make_unique<Job>();
+    job->type = Job::Type::kReference;
+    job->referenced_job_id = job_id_it->second;
+    cmd.encoding_format = MemoryEncodingFormat::kReference;
+    cmd.encoded_length = sizeof(uint64_t);
+    job->data.resize(sizeof(cmd));
+    std::memcpy(job->data.data(), &cmd, sizeof(cmd));
+    // The offset is appended by the writer.
+    job->ready = true;
+    SubmitJob(std::move(job));
+    return;
   }
+  memory_job_ids_.emplace(hash,
+                          WriteEncodedCommand(cmd, host_ptr, length, true));
 }
 
 void TraceWriter::WriteEdramSnapshot(const void* snapshot) {
+  if (!file_) {
+    return;
+  }
   EdramSnapshotCommand cmd = {};
   cmd.type = TraceCommandType::kEdramSnapshot;
-
-  if (compress_output_) {
-    // Write the header now so we reserve space in the buffer.
-    long header_position = std::ftell(file_);
-    cmd.encoding_format = MemoryEncodingFormat::kSnappy;
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-
-    // Stream the content right to the buffer.
-    snappy::ByteArraySource snappy_source(
-        reinterpret_cast<const char*>(snapshot), xenos::kEdramSizeBytes);
-    SnappySink snappy_sink(file_);
-    cmd.encoded_length =
-        static_cast<uint32_t>(snappy::Compress(&snappy_source, &snappy_sink));
-
-    // Seek back and overwrite the header with our final size.
-    std::fseek(file_, header_position, SEEK_SET);
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-    std::fseek(file_, header_position + sizeof(cmd) + cmd.encoded_length,
-               SEEK_SET);
-  } else {
-    // Uncompressed - write buffer directly to the file.
-    cmd.encoding_format = MemoryEncodingFormat::kNone;
-    cmd.encoded_length = xenos::kEdramSizeBytes;
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-    fwrite(snapshot, 1, xenos::kEdramSizeBytes, file_);
-  }
+  WriteEncodedCommand(cmd, snapshot, xenos::kEdramSizeBytes);
 }
 
 void TraceWriter::WriteEvent(EventCommand::Type event_type) {
@@ -272,51 +515,32 @@ void TraceWriter::WriteEvent(EventCommand::Type event_type) {
       TraceCommandType::kEvent,
       event_type,
   };
-  fwrite(&cmd, 1, sizeof(cmd), file_);
+  WriteRaw(&cmd, sizeof(cmd));
 }
 
 void TraceWriter::WriteRegisters(uint32_t first_register,
                                  const uint32_t* register_values,
                                  uint32_t register_count,
                                  bool execute_callbacks_on_play) {
+  if (!file_) {
+    return;
+  }
   RegistersCommand cmd = {};
   cmd.type = TraceCommandType::kRegisters;
   cmd.first_register = first_register;
   cmd.register_count = register_count;
   cmd.execute_callbacks = execute_callbacks_on_play;
-
-  uint32_t uncompressed_length = uint32_t(sizeof(uint32_t) * register_count);
-  if (compress_output_) {
-    // Write the header now so we reserve space in the buffer.
-    long header_position = std::ftell(file_);
-    cmd.encoding_format = MemoryEncodingFormat::kSnappy;
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-
-    // Stream the content right to the buffer.
-    snappy::ByteArraySource snappy_source(
-        reinterpret_cast<const char*>(register_values), uncompressed_length);
-    SnappySink snappy_sink(file_);
-    cmd.encoded_length =
-        static_cast<uint32_t>(snappy::Compress(&snappy_source, &snappy_sink));
-
-    // Seek back and overwrite the header with our final size.
-    std::fseek(file_, header_position, SEEK_SET);
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-    std::fseek(file_, header_position + sizeof(cmd) + cmd.encoded_length,
-               SEEK_SET);
-  } else {
-    // Uncompressed - write the values directly to the file.
-    cmd.encoding_format = MemoryEncodingFormat::kNone;
-    cmd.encoded_length = uncompressed_length;
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-    fwrite(register_values, 1, uncompressed_length, file_);
-  }
+  WriteEncodedCommand(cmd, register_values,
+                      sizeof(uint32_t) * register_count);
 }
 
 void TraceWriter::WriteGammaRamp(
     const reg::DC_LUT_30_COLOR* gamma_ramp_256_entry_table,
     const reg::DC_LUT_PWL_DATA* gamma_ramp_pwl_rgb,
     uint32_t gamma_ramp_rw_component) {
+  if (!file_) {
+    return;
+  }
   GammaRampCommand cmd = {};
   cmd.type = TraceCommandType::kGammaRamp;
   cmd.rw_component = uint8_t(gamma_ramp_rw_component);
@@ -325,42 +549,9 @@ void TraceWriter::WriteGammaRamp(
       sizeof(reg::DC_LUT_30_COLOR) * 256;
   constexpr uint32_t kPWLUncompressedLength =
       sizeof(reg::DC_LUT_PWL_DATA) * 3 * 128;
-  constexpr uint32_t kUncompressedLength =
-      k256EntryTableUncompressedLength + kPWLUncompressedLength;
-  if (compress_output_) {
-    // Write the header now so we reserve space in the buffer.
-    long header_position = std::ftell(file_);
-    cmd.encoding_format = MemoryEncodingFormat::kSnappy;
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-
-    // Stream the content right to the buffer.
-    {
-      std::unique_ptr<char[]> gamma_ramps(new char[kUncompressedLength]);
-      std::memcpy(gamma_ramps.get(), gamma_ramp_256_entry_table,
-                  k256EntryTableUncompressedLength);
-      std::memcpy(gamma_ramps.get() + k256EntryTableUncompressedLength,
-                  gamma_ramp_pwl_rgb, kPWLUncompressedLength);
-      snappy::ByteArraySource snappy_source(gamma_ramps.get(),
-                                            kUncompressedLength);
-      SnappySink snappy_sink(file_);
-      cmd.encoded_length =
-          static_cast<uint32_t>(snappy::Compress(&snappy_source, &snappy_sink));
-    }
-
-    // Seek back and overwrite the header with our final size.
-    std::fseek(file_, header_position, SEEK_SET);
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-    std::fseek(file_, header_position + sizeof(cmd) + cmd.encoded_length,
-               SEEK_SET);
-  } else {
-    // Uncompressed - write the values directly to the file.
-    cmd.encoding_format = MemoryEncodingFormat::kNone;
-    cmd.encoded_length = kUncompressedLength;
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-    fwrite(gamma_ramp_256_entry_table, 1, k256EntryTableUncompressedLength,
-           file_);
-    fwrite(gamma_ramp_pwl_rgb, 1, kPWLUncompressedLength, file_);
-  }
+  WriteEncodedCommand(cmd, gamma_ramp_256_entry_table,
+                      k256EntryTableUncompressedLength, false,
+                      gamma_ramp_pwl_rgb, kPWLUncompressedLength);
 }
 #endif
 }  //  namespace gpu
@@ -10,10 +10,17 @@
 #ifndef XENIA_GPU_TRACE_WRITER_H_
 #define XENIA_GPU_TRACE_WRITER_H_
 
+#include <condition_variable>
+#include <deque>
 #include <filesystem>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
+#include "xenia/base/threading.h"
 #include "xenia/gpu/registers.h"
 #include "xenia/gpu/trace_protocol.h"
 
@@ -63,16 +70,102 @@ class TraceWriter {
                       uint32_t gamma_ramp_rw_component);
 
  private:
+  // A part of the trace, written in the order of the IDs. Commands without
+  // data to encode are gathered into raw jobs, the ones with data are encoded
+  // on the encoder threads.
+  struct Job {
+    enum class Type {
+      kRaw,
+      // data is the command followed by the data to encode, and is replaced
+      // with the encoded command and data.
+      kEncode,
+      // data is a MemoryCommand with the same data as the one written by
+      // referenced_job_id, to which the writer thread appends its offset.
+      kReference,
+    };
+    Type type;
+    uint64_t id;
+    std::vector<uint8_t> data;
+    // For kEncode, the size of the command and the offsets of its
+    // encoding_format and encoded_length fields.
+    size_t command_size = 0;
+    size_t encoding_format_offset = 0;
+    size_t encoded_length_offset = 0;
+    // Whether later memory commands may reference the data of this one.
+    bool referenceable = false;
+    uint64_t referenced_job_id = 0;
+    // Size of data when submitted, counted in pending_job_bytes_.
+    size_t submitted_size = 0;
+    // Whether the writer thread may write the job.
+    bool ready = false;
+    // Whether the file should be flushed after writing the job.
+    bool flush = false;
+  };
+
+  // Returns the ID of the job.
+  template <typename Command>
+  uint64_t WriteEncodedCommand(const Command& cmd, const void* data,
+                               size_t length, bool referenceable = false,
+                               const void* data_2 = nullptr,
+                               size_t length_2 = 0);
   void WriteMemoryCommand(TraceCommandType type, uint32_t base_ptr,
                           size_t length, const void* host_ptr = nullptr);
+  void WriteRaw(const void* data, size_t length);
+  // Submits the pending raw commands.
+  void SubmitRawJob(bool flush = false);
+  // Returns the ID of the job.
+  uint64_t SubmitJob(std::unique_ptr<Job> job);
+  void EncoderThreadMain();
+  void WriterThreadMain();
 
   std::set<uint64_t> cached_memory_reads_;
   uint8_t* membase_;
   FILE* file_;
 
-  bool compress_output_ = true;
+  MemoryEncodingFormat compression_format_ = MemoryEncodingFormat::kNone;
+  int zstd_compression_level_ = 0;
   size_t compression_threshold_ = 1024;  // Min. number of bytes to compress.
 
+  std::unique_ptr<Job> raw_job_;
+  uint64_t next_job_id_ = 0;
+  // 128-bit XXH3 of data of memory commands, seeded with the length - with
+  // 128 bits, a collision that would make a reference point to different data
+  // is practically impossible even in traces with millions of commands.
+  struct MemoryDataHash {
+    uint64_t low64;
+    uint64_t high64;
+    bool operator==(const MemoryDataHash& other) const {
+      return low64 == other.low64 && high64 == other.high64;
+    }
+  };
+  struct MemoryDataHashHasher {
+    size_t operator()(const MemoryDataHash& hash) const {
+      return size_t(hash.low64);
+    }
+  };
+  // To the ID of the job that first wrote the data.
+  std::unordered_map<MemoryDataHash, uint64_t, MemoryDataHashHasher>
+      memory_job_ids_;
+
+  std::mutex jobs_mutex_;
+  // For the writer thread, in the order of the IDs.
+  std::deque<std::unique_ptr<Job>> jobs_;
+  std::deque<Job*> encode_jobs_;
+  std::condition_variable encode_jobs_cond_;
+  std::condition_variable write_cond_;
+  std::condition_variable jobs_written_cond_;
+  // Size of the data of jobs not written yet, limited to avoid running out of
+  // memory when the writer can't keep up.
+  size_t pending_job_bytes_ = 0;
+  size_t max_pending_job_bytes_ = 0;
+  bool shutting_down_ = false;
+  std::vector<std::unique_ptr<xe::threading::Thread>> encoder_threads_;
+  std::unique_ptr<xe::threading::Thread> writer_thread_;
+
+  // Owned by the writer thread.
+  uint64_t file_offset_ = 0;
+  std::unordered_map<uint64_t, uint64_t> memory_job_offsets_;
+
 #else
   // this could be annoying to maintain if new methods are added or the
   // signatures change
@@ -0,0 +1,166 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/ucode_analysis_cache.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/string.h"
+#include "xenia/base/xxhash.h"
+
+namespace xe {
+namespace gpu {
+
+bool UcodeAnalysisCache::Open(const std::filesystem::path& path) {
+  Close();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  FILE* file = xe::filesystem::OpenFile(path, "a+b");
+  if (!file) {
+    XELOGE("Failed to open the ucode analysis cache file for writing: {}",
+           xe::path_to_utf8(path));
+    return false;
+  }
+
+  FileHeader header;
+  uint64_t valid_bytes = 0;
+  if (fread(&header, sizeof(header), 1, file) && header.magic == kFileMagic &&
+      header.version == Shader::kUcodeAnalysisVersion &&
+      header.constant_register_map_size ==
+          sizeof(Shader::ConstantRegisterMap) &&
+      header.vertex_attribute_size ==
+          sizeof(Shader::VertexBinding::Attribute) &&
+      header.texture_binding_size == sizeof(Shader::TextureBinding) &&
+      header.cf_memexport_info_size ==
+          sizeof(Shader::ControlFlowMemExportInfo)) {
+    valid_bytes = sizeof(header);
+    // For validating the sizes in the entry headers before allocating the
+    // memory for the entries.
+    xe::filesystem::Seek(file, 0, SEEK_END);
+    int64_t file_told_end = xe::filesystem::Tell(file);
+    uint64_t file_size = uint64_t(std::max(file_told_end, int64_t(0)));
+    xe::filesystem::Seek(file, int64_t(valid_bytes), SEEK_SET);
+    FileEntryHeader entry_header;
+    std::vector<uint8_t> data;
+    while (fread(&entry_header, sizeof(entry_header), 1, file)) {
+      uint64_t entry_data_offset = valid_bytes + sizeof(entry_header);
+      if (entry_data_offset > file_size ||
+          entry_header.data_size > file_size - entry_data_offset) {
+        break;
+      }
+      data.resize(entry_header.data_size);
+      if (!data.empty() && !fread(data.data(), data.size(), 1, file)) {
+        break;
+      }
+      if (XXH3_64bits(data.data(), data.size()) != entry_header.data_hash) {
+        break;
+      }
+      valid_bytes += sizeof(entry_header) + data.size();
+      Entry& entry = entries_[entry_header.ucode_data_hash];
+      entry.ucode_dword_count = entry_header.ucode_dword_count;
+      entry.shader_type = xenos::ShaderType(entry_header.shader_type);
+      entry.data = std::move(data);
+    }
+    XELOGI("Loaded the ucode analysis results of {} shaders from the cache",
+           entries_.size());
+  }
+  if (valid_bytes) {
+    // Drop the incompletely written entry in the end, if any.
+    xe::filesystem::TruncateStdioFile(file, valid_bytes);
+  } else {
+    xe::filesystem::TruncateStdioFile(file, 0);
+    header.magic = kFileMagic;
+    header.version = Shader::kUcodeAnalysisVersion;
+    header.constant_register_map_size =
+        uint32_t(sizeof(Shader::ConstantRegisterMap));
+    header.vertex_attribute_size =
+        uint32_t(sizeof(Shader::VertexBinding::Attribute));
+    header.texture_binding_size = uint32_t(sizeof(Shader::TextureBinding));
+    header.cf_memexport_info_size =
+        uint32_t(sizeof(Shader::ControlFlowMemExportInfo));
+    fwrite(&header, sizeof(header), 1, file);
+  }
+  file_ = file;
+  return true;
+}
+
+void UcodeAnalysisCache::Close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (file_) {
+    fclose(file_);
+    file_ = nullptr;
+  }
+  entries_.clear();
+}
+
+bool UcodeAnalysisCache::AnalyzeUcode(Shader& shader,
+                                      StringBuffer& ucode_disasm_buffer) {
+  if (shader.is_ucode_analyzed()) {
+    return false;
+  }
+
+  uint64_t ucode_data_hash = shader.ucode_data_hash();
+  const Entry* entry = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(ucode_data_hash);
+    if (it != entries_.end()) {
+      entry = &it->second;
+    }
+  }
+  // Deserializing outside the lock, entries are not removed while open.
+  if (entry && entry->ucode_dword_count == shader.ucode_dword_count() &&
+      entry->shader_type == shader.type() &&
+      shader.DeserializeUcodeAnalysis(entry->data.data(),
+                                      entry->data.size())) {
+    return true;
+  }
+
+  shader.AnalyzeUcode(ucode_disasm_buffer);
+
+  if (entry) {
+    // Mismatching or malformed data (or a hash collision) - not replacing.
+    return false;
+  }
+  std::vector<uint8_t> data;
+  shader.SerializeUcodeAnalysis(data);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!file_) {
+    return false;
+  }
+  auto emplace_result = entries_.try_emplace(ucode_data_hash);
+  if (!emplace_result.second) {
+    // Analyzed on another thread simultaneously.
+    return false;
+  }
+  FileEntryHeader entry_header;
+  entry_header.ucode_data_hash = ucode_data_hash;
+  entry_header.ucode_dword_count = uint32_t(shader.ucode_dword_count());
+  entry_header.shader_type = uint32_t(shader.type());
+  entry_header.data_hash = XXH3_64bits(data.data(), data.size());
+  entry_header.data_size = uint32_t(data.size());
+  entry_header.reserved = 0;
+  fwrite(&entry_header, sizeof(entry_header), 1, file_);
+  if (!data.empty()) {
+    fwrite(data.data(), 1, data.size(), file_);
+  }
+  fflush(file_);
+  Entry& new_entry = emplace_result.first->second;
+  new_entry.ucode_dword_count = entry_header.ucode_dword_count;
+  new_entry.shader_type = shader.type();
+  new_entry.data = std::move(data);
+  return false;
+}
+
+}  // namespace gpu
+}  // namespace xe
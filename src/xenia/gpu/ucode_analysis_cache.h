@@ -0,0 +1,90 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_GPU_UCODE_ANALYSIS_CACHE_H_
+#define XENIA_GPU_UCODE_ANALYSIS_CACHE_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "xenia/base/hash.h"
+#include "xenia/base/string_buffer.h"
+#include "xenia/gpu/shader.h"
+
+namespace xe {
+namespace gpu {
+
+// Results of Shader::AnalyzeUcode (including the disassembly) keyed by the
+// ucode hash, loaded in bulk from a file when it's opened, so shaders already
+// encountered in the previous runs don't need to be disassembled and analyzed
+// again. The file is in the host's native structure layout, so it should be
+// stored in the local, not the shareable, shader storage.
+class UcodeAnalysisCache {
+ public:
+  UcodeAnalysisCache() = default;
+  UcodeAnalysisCache(const UcodeAnalysisCache& cache) = delete;
+  UcodeAnalysisCache& operator=(const UcodeAnalysisCache& cache) = delete;
+  ~UcodeAnalysisCache() { Close(); }
+
+  // Loads the analysis results from the file, and appends the new ones to it.
+  bool Open(const std::filesystem::path& path);
+  // Closes the file and drops the loaded analysis results.
+  void Close();
+  bool is_open() const { return file_ != nullptr; }
+
+  // Restores the analysis results of the shader from the cache if available,
+  // otherwise analyzes the ucode and adds the results to the cache if it's
+  // open. Returns whether the results have been taken from the cache. Can be
+  // called from multiple threads for different shaders.
+  bool AnalyzeUcode(Shader& shader, StringBuffer& ucode_disasm_buffer);
+
+ private:
+  struct FileHeader {
+    uint32_t magic;
+    uint32_t version;
+    // For detecting changes in the layout of the structures written directly.
+    uint32_t constant_register_map_size;
+    uint32_t vertex_attribute_size;
+    uint32_t texture_binding_size;
+    uint32_t cf_memexport_info_size;
+  };
+  // Followed by data_size bytes of Shader::SerializeUcodeAnalysis data.
+  struct FileEntryHeader {
+    uint64_t ucode_data_hash;
+    uint32_t ucode_dword_count;
+    uint32_t shader_type;
+    uint64_t data_hash;
+    uint32_t data_size;
+    uint32_t reserved;
+  };
+  // 'XEUA'.
+  static constexpr uint32_t kFileMagic = 0x41554558;
+
+  struct Entry {
+    uint32_t ucode_dword_count;
+    xenos::ShaderType shader_type;
+    std::vector<uint8_t> data;
+  };
+
+  std::mutex mutex_;
+  // Protected with mutex_, but not modified while the file is open other than
+  // by inserting, so references to the entries stay valid without the lock.
+  std::unordered_map<uint64_t, Entry, xe::hash::IdentityHasher<uint64_t>>
+      entries_;
+  FILE* file_ = nullptr;
+};
+
+}  // namespace gpu
+}  // namespace xe
+
+#endif  // XENIA_GPU_UCODE_ANALYSIS_CACHE_H_
@@ -30,7 +30,7 @@ DeferredCommandBuffer::DeferredCommandBuffer(
 
 void DeferredCommandBuffer::Reset() { command_stream_.clear(); }
 
-void DeferredCommandBuffer::Execute(VkCommandBuffer command_buffer) {
+uint32_t DeferredCommandBuffer::Execute(VkCommandBuffer command_buffer) {
 #if XE_UI_VULKAN_FINE_GRAINED_DRAW_SCOPES
   SCOPE_profile_cpu_f("gpu");
 #endif  // XE_UI_VULKAN_FINE_GRAINED_DRAW_SCOPES
@@ -39,6 +39,9 @@ void DeferredCommandBuffer::Execute(VkCommandBuffer command_buffer) {
       command_processor_.GetVulkanProvider().dfn();
   const uintmax_t* stream = command_stream_.data();
   size_t stream_remaining = command_stream_.size();
+  // Whether the currently bound graphics pipeline is not available.
+  bool skip_draws = false;
+  uint32_t draws_skipped = 0;
   while (stream_remaining) {
     const CommandHeader& header =
         *reinterpret_cast<const CommandHeader*>(stream);
@@ -101,6 +104,19 @@ void DeferredCommandBuffer::Execute(VkCommandBuffer command_buffer) {
         auto& args = *reinterpret_cast<const ArgsVkBindPipeline*>(stream);
         dfn.vkCmdBindPipeline(command_buffer, args.pipeline_bind_point,
                               args.pipeline);
+        if (args.pipeline_bind_point == VK_PIPELINE_BIND_POINT_GRAPHICS) {
+          skip_draws = false;
+        }
+      } break;
+
+      case Command::kBindGraphicsPipelineHandle: {
+        VkPipeline pipeline = command_processor_.GetVkPipelineByHandle(
+            *reinterpret_cast<void* const*>(stream));
+        skip_draws = pipeline == VK_NULL_HANDLE;
+        if (!skip_draws) {
+          dfn.vkCmdBindPipeline(command_buffer,
+                                VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        }
       } break;
 
       case Command::kVkBindVertexBuffers: {
@@ -172,12 +188,20 @@ void DeferredCommandBuffer::Execute(VkCommandBuffer command_buffer) {
       } break;
 
       case Command::kVkDraw: {
+        if (skip_draws) {
+          ++draws_skipped;
+          break;
+        }
         auto& args = *reinterpret_cast<const ArgsVkDraw*>(stream);
         dfn.vkCmdDraw(command_buffer, args.vertex_count, args.instance_count,
                       args.first_vertex, args.first_instance);
       } break;
 
       case Command::kVkDrawIndexed: {
+        if (skip_draws) {
+          ++draws_skipped;
+          break;
+        }
         auto& args = *reinterpret_cast<const ArgsVkDrawIndexed*>(stream);
         dfn.vkCmdDrawIndexed(command_buffer, args.index_count,
                              args.instance_count, args.first_index,
@@ -294,6 +318,8 @@ void DeferredCommandBuffer::Execute(VkCommandBuffer command_buffer) {
     stream += header.arguments_size_elements;
     stream_remaining -= header.arguments_size_elements;
   }
+
+  return draws_skipped;
 }
 
 void DeferredCommandBuffer::CmdVkPipelineBarrier(
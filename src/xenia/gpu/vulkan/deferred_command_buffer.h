@@ -30,7 +30,9 @@ class DeferredCommandBuffer {
                         size_t initial_size_bytes = 1024 * 1024);
 
   void Reset();
-  void Execute(VkCommandBuffer command_buffer);
+  // Returns the number of draws skipped because their graphics pipelines bound
+  // by handle were not available.
+  uint32_t Execute(VkCommandBuffer command_buffer);
 
   // render_pass_begin->pNext of all barriers must be null.
   void CmdVkBeginRenderPass(const VkRenderPassBeginInfo* render_pass_begin,
@@ -108,6 +110,14 @@ class DeferredCommandBuffer {
     args.pipeline = pipeline;
   }
 
+  // Binds a graphics pipeline with deferred creation from the pipeline cache,
+  // draws are skipped until the next pipeline binding if it's not available.
+  void BindGraphicsPipelineHandle(void* pipeline_handle) {
+    auto& arg = *reinterpret_cast<void**>(
+        WriteCommand(Command::kBindGraphicsPipelineHandle, sizeof(void*)));
+    arg = pipeline_handle;
+  }
+
   void CmdVkBindVertexBuffers(uint32_t first_binding, uint32_t binding_count,
                               const VkBuffer* buffers,
                               const VkDeviceSize* offsets) {
@@ -363,6 +373,7 @@ class DeferredCommandBuffer {
     kVkBindDescriptorSets,
     kVkBindIndexBuffer,
     kVkBindPipeline,
+    kBindGraphicsPipelineHandle,
     kVkBindVertexBuffers,
     kVkClearAttachments,
     kVkClearColorImage,
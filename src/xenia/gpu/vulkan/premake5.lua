@@ -55,6 +55,7 @@ project("xenia-gpu-vulkan-trace-viewer")
     "mspack",
     "snappy",
     "xxhash",
+    "zstd",
   })
   includedirs({
     project_root.."/third_party/Vulkan-Headers/include",
@@ -119,6 +120,7 @@ project("xenia-gpu-vulkan-trace-dump")
     "mspack",
     "snappy",
     "xxhash",
+    "zstd",
   })
   includedirs({
     project_root.."/third_party/Vulkan-Headers/include",
@@ -91,7 +91,8 @@ VulkanCommandProcessor::VulkanCommandProcessor(
               graphics_system->provider()),
           kDescriptorPoolSizeTextures,
           uint32_t(xe::countof(kDescriptorPoolSizeTextures)),
-          kLinkedTypeDescriptorPoolSetCount) {}
+          kLinkedTypeDescriptorPoolSetCount),
+      host_viewport_info_cache_(*register_file_) {}
 
 VulkanCommandProcessor::~VulkanCommandProcessor() = default;
 
@@ -100,6 +101,12 @@ void VulkanCommandProcessor::ClearCaches() {
   cache_clear_requested_ = true;
 }
 
+void VulkanCommandProcessor::InitializeShaderStorage(
+    const std::filesystem::path& cache_root, uint32_t title_id, bool blocking) {
+  CommandProcessor::InitializeShaderStorage(cache_root, title_id, blocking);
+  pipeline_cache_->InitializeShaderStorage(cache_root, title_id, blocking);
+}
+
 void VulkanCommandProcessor::TracePlaybackWroteMemory(uint32_t base_ptr,
                                                       uint32_t length) {
   shared_memory_->MemoryInvalidationCallback(base_ptr, length, true);
@@ -1232,9 +1239,82 @@ void VulkanCommandProcessor::WriteRegister(uint32_t index, uint32_t value) {
 void VulkanCommandProcessor::WriteRegistersFromMem(uint32_t start_index,
                                                    uint32_t* base,
                                                    uint32_t num_registers) {
-  for (uint32_t i = 0; i < num_registers; ++i) {
-    uint32_t data = xe::load_and_swap<uint32_t>(base + i);
-    VulkanCommandProcessor::WriteRegister(start_index + i, data);
+  CommandProcessor::WriteRegistersFromMem(start_index, base, num_registers);
+
+  // Same invalidation as in WriteRegister, but done once for the whole range.
+  uint32_t end_index = start_index + num_registers;
+
+  uint32_t float_constants_first_register =
+      std::max(start_index, uint32_t(XE_GPU_REG_SHADER_CONSTANT_000_X));
+  uint32_t float_constants_end_register =
+      std::min(end_index, uint32_t(XE_GPU_REG_SHADER_CONSTANT_511_W + 1));
+  if (frame_open_ &&
+      float_constants_first_register < float_constants_end_register) {
+    // Whether any of the constants in [first, last] is used by the shader.
+    auto is_float_constant_range_used = [](const uint64_t* float_constant_map,
+                                           uint32_t first, uint32_t last) {
+      for (uint32_t i = first >> 6; i <= last >> 6; ++i) {
+        uint64_t range_mask = ~UINT64_C(0);
+        if (i == first >> 6) {
+          range_mask &= ~UINT64_C(0) << (first & 63);
+        }
+        if (i == last >> 6) {
+          range_mask &= ~UINT64_C(0) >> (63 - (last & 63));
+        }
+        if (float_constant_map[i] & range_mask) {
+          return true;
+        }
+      }
+      return false;
+    };
+    uint32_t float_constant_first =
+        (float_constants_first_register - XE_GPU_REG_SHADER_CONSTANT_000_X) >>
+        2;
+    uint32_t float_constant_last =
+        (float_constants_end_register - 1 - XE_GPU_REG_SHADER_CONSTANT_000_X) >>
+        2;
+    if (float_constant_first < 256 &&
+        is_float_constant_range_used(current_float_constant_map_vertex_,
+                                     float_constant_first,
+                                     std::min(float_constant_last, 255u))) {
+      current_constant_buffers_up_to_date_ &= ~(
+          UINT32_C(1) << SpirvShaderTranslator::kConstantBufferFloatVertex);
+    }
+    if (float_constant_last >= 256 &&
+        is_float_constant_range_used(
+            current_float_constant_map_pixel_,
+            std::max(float_constant_first, 256u) - 256,
+            float_constant_last - 256)) {
+      current_constant_buffers_up_to_date_ &= ~(
+          UINT32_C(1) << SpirvShaderTranslator::kConstantBufferFloatPixel);
+    }
+  }
+
+  if (std::max(start_index, uint32_t(XE_GPU_REG_SHADER_CONSTANT_BOOL_000_031)) <
+      std::min(end_index, uint32_t(XE_GPU_REG_SHADER_CONSTANT_LOOP_31 + 1))) {
+    current_constant_buffers_up_to_date_ &=
+        ~(UINT32_C(1) << SpirvShaderTranslator::kConstantBufferBoolLoop);
+  }
+
+  uint32_t fetch_constants_first_register =
+      std::max(start_index, uint32_t(XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0));
+  uint32_t fetch_constants_end_register =
+      std::min(end_index, uint32_t(XE_GPU_REG_SHADER_CONSTANT_FETCH_31_5 + 1));
+  if (fetch_constants_first_register < fetch_constants_end_register) {
+    current_constant_buffers_up_to_date_ &=
+        ~(UINT32_C(1) << SpirvShaderTranslator::kConstantBufferFetch);
+    if (texture_cache_) {
+      uint32_t fetch_constant_last =
+          (fetch_constants_end_register - 1 -
+           XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0) /
+          6;
+      for (uint32_t fetch_constant = (fetch_constants_first_register -
+                                      XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0) /
+                                     6;
+           fetch_constant <= fetch_constant_last; ++fetch_constant) {
+        texture_cache_->TextureFetchConstantWritten(fetch_constant);
+      }
+    }
   }
 }
 void VulkanCommandProcessor::SparseBindBuffer(
@@ -2106,7 +2186,7 @@ void VulkanCommandProcessor::BindExternalGraphicsPipeline(
   deferred_command_buffer_.CmdVkBindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS,
                                              pipeline);
   current_external_graphics_pipeline_ = pipeline;
-  current_guest_graphics_pipeline_ = VK_NULL_HANDLE;
+  current_guest_graphics_pipeline_ = nullptr;
   current_guest_graphics_pipeline_layout_ = VK_NULL_HANDLE;
 }
 
@@ -2385,13 +2465,13 @@ bool VulkanCommandProcessor::IssueDraw(xenos::PrimitiveType prim_type,
   // Create the pipeline (for this, need the render pass from the render target
   // cache), translating the shaders - doing this now to obtain the used
   // textures.
-  VkPipeline pipeline;
+  void* pipeline_handle;
   const VulkanPipelineCache::PipelineLayoutProvider* pipeline_layout_provider;
   if (!pipeline_cache_->ConfigurePipeline(
           vertex_shader_translation, pixel_shader_translation,
           primitive_processing_result, normalized_depth_control,
           normalized_color_mask,
-          render_target_cache_->last_update_render_pass_key(), pipeline,
+          render_target_cache_->last_update_render_pass_key(), pipeline_handle,
           pipeline_layout_provider)) {
     return false;
   }
@@ -2409,10 +2489,19 @@ bool VulkanCommandProcessor::IssueDraw(xenos::PrimitiveType prim_type,
   // Update the graphics pipeline, and if the new graphics pipeline has a
   // different layout, invalidate incompatible descriptor sets before updating
   // current_guest_graphics_pipeline_layout_.
-  if (current_guest_graphics_pipeline_ != pipeline) {
-    deferred_command_buffer_.CmdVkBindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                               pipeline);
-    current_guest_graphics_pipeline_ = pipeline;
+  if (current_guest_graphics_pipeline_ != pipeline_handle) {
+    // Pipelines that already exist (always the case without the creation
+    // threads) are bound directly, only the ones still being created are
+    // resolved when the submission is executed.
+    VkPipeline pipeline =
+        pipeline_cache_->GetVkPipelineByHandle(pipeline_handle);
+    if (pipeline != VK_NULL_HANDLE) {
+      deferred_command_buffer_.CmdVkBindPipeline(
+          VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    } else {
+      deferred_command_buffer_.BindGraphicsPipelineHandle(pipeline_handle);
+    }
+    current_guest_graphics_pipeline_ = pipeline_handle;
     current_external_graphics_pipeline_ = VK_NULL_HANDLE;
   }
   auto pipeline_layout =
@@ -2450,7 +2539,6 @@ bool VulkanCommandProcessor::IssueDraw(xenos::PrimitiveType prim_type,
                                   RenderTargetCache::Path::kHostRenderTargets;
 
   // Get dynamic rasterizer state.
-  draw_util::ViewportInfo viewport_info;
 
   // Just handling maxViewportDimensions is enough - viewportBoundsRange[1] must
   // be at least 2 * max(maxViewportDimensions[0...1]) - 1, and
@@ -2474,9 +2562,8 @@ bool VulkanCommandProcessor::IssueDraw(xenos::PrimitiveType prim_type,
                 device_info.maxViewportDimensions[1], true,
                 normalized_depth_control, false, host_render_targets_used,
                 pixel_shader && pixel_shader->writes_depth());
-  gviargs.SetupRegisterValues(regs);
-
-  draw_util::GetHostViewportInfo(&gviargs, viewport_info);
+  const draw_util::ViewportInfo& viewport_info =
+      host_viewport_info_cache_.GetHostViewportInfo(gviargs);
 
   // Update dynamic graphics pipeline state.
   UpdateDynamicState(viewport_info, primitive_polygonal,
@@ -2870,7 +2957,7 @@ bool VulkanCommandProcessor::BeginSubmission(bool is_guest_command) {
     dynamic_stencil_reference_back_update_needed_ = true;
     current_render_pass_ = VK_NULL_HANDLE;
     current_framebuffer_ = nullptr;
-    current_guest_graphics_pipeline_ = VK_NULL_HANDLE;
+    current_guest_graphics_pipeline_ = nullptr;
     current_external_graphics_pipeline_ = VK_NULL_HANDLE;
     current_external_compute_pipeline_ = VK_NULL_HANDLE;
     current_guest_graphics_pipeline_layout_ = nullptr;
@@ -3031,6 +3118,8 @@ bool VulkanCommandProcessor::EndSubmission(bool is_swap) {
 
     EndRenderPass();
 
+    pipeline_cache_->EndSubmission();
+
     render_target_cache_->EndSubmission();
 
     primitive_processor_->EndSubmission();
@@ -3111,7 +3200,11 @@ bool VulkanCommandProcessor::EndSubmission(bool is_swap) {
       XELOGE("Failed to begin a Vulkan command buffer");
       return false;
     }
-    deferred_command_buffer_.Execute(command_buffer.buffer);
+    uint32_t draws_skipped =
+        deferred_command_buffer_.Execute(command_buffer.buffer);
+    if (draws_skipped) {
+      pipeline_cache_->CountSkippedDraws(draws_skipped);
+    }
     if (dfn.vkEndCommandBuffer(command_buffer.buffer) != VK_SUCCESS) {
       XELOGE("Failed to end a Vulkan command buffer");
       return false;
@@ -3177,6 +3270,10 @@ bool VulkanCommandProcessor::EndSubmission(bool is_swap) {
       shared_memory_->SetSystemPageBlocksValidWithGpuDataWritten();
     }
 
+    // After the last submission of the frame, to include its pipeline creation
+    // stalls.
+    pipeline_cache_->EndFrame();
+
     frame_open_ = false;
     // Submission already closed now, so minus 1.
     closed_frame_submissions_[(frame_current_++) % kMaxFramesInFlight] =
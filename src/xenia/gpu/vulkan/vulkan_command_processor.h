@@ -143,6 +143,9 @@ class VulkanCommandProcessor final : public CommandProcessor {
 
   void ClearCaches() override;
 
+  void InitializeShaderStorage(const std::filesystem::path& cache_root,
+                               uint32_t title_id, bool blocking) override;
+
   void TracePlaybackWroteMemory(uint32_t base_ptr, uint32_t length) override;
 
   void RestoreEdramSnapshot(const void* snapshot) override;
@@ -152,6 +155,12 @@ class VulkanCommandProcessor final : public CommandProcessor {
         graphics_system_->provider());
   }
 
+  // Returns a pipeline with deferred creation by its handle. May return
+  // VK_NULL_HANDLE if the pipeline is not available.
+  VkPipeline GetVkPipelineByHandle(void* handle) const {
+    return pipeline_cache_->GetVkPipelineByHandle(handle);
+  }
+
   // Returns the deferred drawing command list for the currently open
   // submission.
   DeferredCommandBuffer& deferred_command_buffer() {
@@ -700,12 +709,11 @@ class VulkanCommandProcessor final : public CommandProcessor {
   VkRenderPass current_render_pass_;
   const VulkanRenderTargetCache::Framebuffer* current_framebuffer_;
 
-  // Currently bound graphics pipeline, either from the pipeline cache (with
-  // potentially deferred creation - current_external_graphics_pipeline_ is
-  // VK_NULL_HANDLE in this case) or a non-Xenos one
-  // (current_guest_graphics_pipeline_ is VK_NULL_HANDLE in this case).
-  // TODO(Triang3l): Change to a deferred compilation handle.
-  VkPipeline current_guest_graphics_pipeline_;
+  // Currently bound graphics pipeline, either a handle from the pipeline cache
+  // (with potentially deferred creation - current_external_graphics_pipeline_
+  // is VK_NULL_HANDLE in this case) or a non-Xenos one
+  // (current_guest_graphics_pipeline_ is nullptr in this case).
+  void* current_guest_graphics_pipeline_;
   VkPipeline current_external_graphics_pipeline_;
   VkPipeline current_external_compute_pipeline_;
 
@@ -747,6 +755,8 @@ class VulkanCommandProcessor final : public CommandProcessor {
 
   // Temporary storage for memexport stream constants used in the draw.
   std::vector<draw_util::MemExportRange> memexport_ranges_;
+
+  draw_util::HostViewportInfoCache host_viewport_info_cache_;
 };
 
 }  // namespace vulkan
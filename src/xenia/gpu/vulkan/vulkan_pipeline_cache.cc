@@ -14,14 +14,22 @@
 #include <cstdint>
 #include <cstring>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <tuple>
 #include <utility>
 #include <vector>
 
 #include "third_party/fmt/include/fmt/format.h"
 #include "xenia/base/assert.h"
+#include "xenia/base/byte_order.h"
+#include "xenia/base/clock.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 #include "xenia/base/profiling.h"
+#include "xenia/base/string.h"
 #include "xenia/base/xxhash.h"
 #include "xenia/gpu/draw_util.h"
 #include "xenia/gpu/gpu_flags.h"
@@ -34,10 +42,56 @@
 #include "xenia/gpu/xenos.h"
 #include "xenia/ui/vulkan/vulkan_util.h"
 
+DEFINE_int32(
+    vulkan_pipeline_creation_threads, 0,
+    "Number of threads used for graphics pipeline creation. -1 to calculate "
+    "automatically (75% of logical CPU cores), a positive number to specify "
+    "the number of threads explicitly (up to the number of logical CPU cores), "
+    "0 to disable multithreaded pipeline creation. Experimental.",
+    "Vulkan");
+DEFINE_bool(
+    vulkan_pipeline_creation_skip_draws, false,
+    "Don't wait for the pipelines still being created on the pipeline creation "
+    "threads when ending a submission, skipping the draws using them instead. "
+    "Reduces stuttering when new pipelines are encountered, at the cost of "
+    "objects temporarily missing.",
+    "Vulkan");
+DEFINE_bool(
+    vulkan_shader_storage, false,
+    "Store the shaders and the pipelines used by the title, as well as the "
+    "Vulkan driver pipeline cache, in the cache directory, and create them "
+    "from the storage when the title is launched again. Experimental.",
+    "Vulkan");
+DEFINE_bool(
+    vulkan_spirv_optimization, false,
+    "Optimize the translated SPIR-V shaders with SPIRV-Tools (dead code "
+    "elimination, constant folding, control flow simplification) before "
+    "passing them to the driver. The optimized shaders are cached in the local "
+    "shader storage. Optimization is done when the shader is translated, so "
+    "the first draw with a shader that is not in the cache yet waits for the "
+    "optimization on the command processor thread (shaders loaded from the "
+    "shader storage are optimized by the translation threads at launch). "
+    "Requires the SPIRV-Tools shared library from the Vulkan SDK.",
+    "Vulkan");
+
 namespace xe {
 namespace gpu {
 namespace vulkan {
 
+// Wrapper around the VkPipelineCache data for detecting incomplete writes.
+struct PipelineCacheDataFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t data_size;
+  uint64_t data_hash;
+
+  static constexpr uint32_t kVersion = 0x20241019;
+};
+// 'XEVC'.
+constexpr uint32_t kPipelineCacheDataFileMagic = 0x43564558;
+// Sanity limit for a corrupted size.
+constexpr uint64_t kPipelineCacheDataMaxSize = UINT64_C(1) << 30;
+
 VulkanPipelineCache::VulkanPipelineCache(
     VulkanCommandProcessor& command_processor,
     const RegisterFile& register_file,
@@ -64,6 +118,23 @@ bool VulkanPipelineCache::Initialize() {
       render_target_cache_.msaa_2x_no_attachments_supported(),
       edram_fragment_shader_interlock);
 
+  if (cvars::vulkan_spirv_optimization) {
+    spirv_tools_context_ = std::make_unique<ui::vulkan::SpirvToolsContext>();
+    if (spirv_tools_context_->Initialize(
+            SpirvShaderTranslator::Features(provider.device_info())
+                .spirv_version) &&
+        spirv_tools_context_->IsOptimizerAvailable()) {
+      spirv_optimization_cache_ =
+          std::make_unique<ui::vulkan::SpirvOptimizationCache>(
+              *spirv_tools_context_);
+    } else {
+      XELOGW(
+          "VulkanPipelineCache: SPIR-V optimization is enabled, but the "
+          "SPIRV-Tools optimizer is not available");
+      spirv_tools_context_.reset();
+    }
+  }
+
   if (edram_fragment_shader_interlock) {
     std::vector<uint8_t> depth_only_fragment_shader_code =
         shader_translator_->CreateDepthOnlyFragmentShader();
@@ -81,6 +152,44 @@ bool VulkanPipelineCache::Initialize() {
     }
   }
 
+  // Initialize creation thread synchronization data even if not using creation
+  // threads because they may be used anyway to create pipelines from the
+  // storage.
+  creation_threads_busy_ = 0;
+  creation_threads_busy_for_drawing_ = 0;
+  creation_completion_event_ =
+      xe::threading::Event::CreateManualResetEvent(true);
+  assert_not_null(creation_completion_event_);
+  creation_completion_set_event_ = false;
+  creation_completion_include_preload_ = false;
+  creation_threads_shutdown_from_ = SIZE_MAX;
+  if (cvars::vulkan_pipeline_creation_threads != 0) {
+    uint32_t logical_processor_count = xe::threading::logical_processor_count();
+    if (!logical_processor_count) {
+      // Pick some reasonable amount if couldn't determine the number of cores.
+      logical_processor_count = 6;
+    }
+    size_t creation_thread_count;
+    if (cvars::vulkan_pipeline_creation_threads < 0) {
+      creation_thread_count =
+          std::max(logical_processor_count * 3 / 4, uint32_t(1));
+    } else {
+      creation_thread_count =
+          std::min(uint32_t(cvars::vulkan_pipeline_creation_threads),
+                   logical_processor_count);
+    }
+    for (size_t i = 0; i < creation_thread_count; ++i) {
+      std::unique_ptr<xe::threading::Thread> creation_thread =
+          xe::threading::Thread::Create({}, [this, i]() { CreationThread(i); });
+      assert_not_null(creation_thread);
+      creation_thread->set_name("Vulkan Pipelines");
+      creation_threads_.push_back(std::move(creation_thread));
+    }
+  }
+
+  pipeline_creation_frame_statistics_ = PipelineCreationStatistics();
+  last_frame_pipeline_creation_statistics_ = PipelineCreationStatistics();
+
   return true;
 }
 
@@ -90,11 +199,32 @@ void VulkanPipelineCache::Shutdown() {
   const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
   VkDevice device = provider.device();
 
+  // Shut down all threads, before destroying the pipelines since they may be
+  // creating them.
+  if (!creation_threads_.empty()) {
+    {
+      std::lock_guard<std::mutex> lock(creation_request_lock_);
+      creation_threads_shutdown_from_ = 0;
+    }
+    creation_request_cond_.notify_all();
+    for (size_t i = 0; i < creation_threads_.size(); ++i) {
+      xe::threading::Wait(creation_threads_[i].get(), false);
+    }
+    creation_threads_.clear();
+  }
+  creation_queue_.clear();
+  creation_preload_queue_.clear();
+  creation_completion_event_.reset();
+
+  // Shut down the persistent shader / pipeline storage.
+  ShutdownShaderStorage();
+
   // Destroy all pipelines.
   last_pipeline_ = nullptr;
   for (const auto& pipeline_pair : pipelines_) {
-    if (pipeline_pair.second.pipeline != VK_NULL_HANDLE) {
-      dfn.vkDestroyPipeline(device, pipeline_pair.second.pipeline, nullptr);
+    VkPipeline pipeline = pipeline_pair.second.pipeline;
+    if (pipeline != VK_NULL_HANDLE) {
+      dfn.vkDestroyPipeline(device, pipeline, nullptr);
     }
   }
   pipelines_.clear();
@@ -109,24 +239,626 @@ void VulkanPipelineCache::Shutdown() {
   }
   geometry_shaders_.clear();
 
+  ui::vulkan::util::DestroyAndNullHandle(dfn.vkDestroyPipelineCache, device,
+                                         vk_pipeline_cache_);
+
   // Destroy all translated shaders.
   for (auto it : shaders_) {
     delete it.second;
   }
   shaders_.clear();
+  shader_storage_index_ = 0;
   texture_binding_layout_map_.clear();
   texture_binding_layouts_.clear();
 
   // Shut down shader translation.
+  spirv_optimization_cache_.reset();
+  spirv_tools_context_.reset();
   shader_translator_.reset();
 }
 
+void VulkanPipelineCache::InitializeShaderStorage(
+    const std::filesystem::path& cache_root, uint32_t title_id, bool blocking) {
+  if (!cvars::vulkan_shader_storage) {
+    return;
+  }
+
+  // The Vulkan pipeline cache object is replaced, and pipelines from the
+  // previously open storage may still be being created with it.
+  AwaitPipelineCreationCompletion(true);
+
+  ShutdownShaderStorage();
+
+  auto shader_storage_root = cache_root / "shaders";
+  // For files that can be moved between different hosts.
+  auto shader_storage_shareable_root = shader_storage_root / "shareable";
+  if (!std::filesystem::exists(shader_storage_shareable_root)) {
+    if (!std::filesystem::create_directories(shader_storage_shareable_root)) {
+      XELOGE(
+          "Failed to create the shareable shader storage directory, persistent "
+          "shader storage will be disabled: {}",
+          xe::path_to_utf8(shader_storage_shareable_root));
+      return;
+    }
+  }
+  // For the driver pipeline cache, which is only usable with the same device
+  // and driver.
+  auto shader_storage_local_root = shader_storage_root / "local";
+  if (!std::filesystem::exists(shader_storage_local_root) &&
+      !std::filesystem::create_directories(shader_storage_local_root)) {
+    XELOGW(
+        "Failed to create the local shader storage directory, the Vulkan "
+        "pipeline cache will not be stored: {}",
+        xe::path_to_utf8(shader_storage_local_root));
+  } else {
+    // Before creating any pipelines, so they can be taken from the cache.
+    LoadVkPipelineCache(shader_storage_local_root /
+                        fmt::format("{:08X}.vulkan.bin", title_id));
+    // Before analyzing the shaders from the storage. Local because the
+    // structure layout depends on the host.
+    ucode_analysis_cache_.Open(
+        shader_storage_local_root /
+        fmt::format("{:08X}.ucode_analysis.bin", title_id));
+    // Before translating the shaders from the storage. Local because the
+    // result depends on the SPIRV-Tools version.
+    if (spirv_optimization_cache_) {
+      spirv_optimization_cache_->Open(
+          shader_storage_local_root /
+          fmt::format("{:08X}.spirv_opt.vulkan.bin", title_id));
+    }
+  }
+
+  const ui::vulkan::VulkanProvider& provider =
+      command_processor_.GetVulkanProvider();
+
+  bool edram_fragment_shader_interlock =
+      render_target_cache_.GetPath() ==
+      RenderTargetCache::Path::kPixelShaderInterlock;
+
+  // Initialize the pipeline storage stream - read pipeline descriptions and
+  // collect used shader modifications to translate.
+  std::vector<PipelineStoredDescription> pipeline_stored_descriptions;
+  // <Shader hash, modification bits>.
+  std::set<std::pair<uint64_t, uint64_t>> shader_translations_needed;
+  auto pipeline_storage_file_path =
+      shader_storage_shareable_root /
+      fmt::format("{:08X}.{}.vulkan.xpso", title_id,
+                  edram_fragment_shader_interlock ? "fsi" : "rtv");
+  pipeline_storage_file_ =
+      xe::filesystem::OpenFile(pipeline_storage_file_path, "a+b");
+  if (!pipeline_storage_file_) {
+    XELOGE(
+        "Failed to open the Vulkan pipeline description storage file for "
+        "writing, persistent shader storage will be disabled: {}",
+        xe::path_to_utf8(pipeline_storage_file_path));
+    return;
+  }
+  pipeline_storage_file_flush_needed_ = false;
+  // 'XEPS'.
+  const uint32_t pipeline_storage_magic = 0x53504558;
+  // 'VKFS' or 'VKRT'.
+  const uint32_t pipeline_storage_magic_api =
+      edram_fragment_shader_interlock ? 0x53464B56 : 0x54524B56;
+  // The SPIR-V modification version is a small number, not a date, so it's
+  // stored separately.
+  const uint32_t pipeline_storage_version_swapped =
+      xe::byte_swap(PipelineDescription::kVersion);
+  const uint32_t pipeline_storage_modification_version_swapped =
+      xe::byte_swap(SpirvShaderTranslator::Modification::kVersion);
+  struct {
+    uint32_t magic;
+    uint32_t magic_api;
+    uint32_t version_swapped;
+    uint32_t modification_version_swapped;
+  } pipeline_storage_file_header;
+  if (fread(&pipeline_storage_file_header, sizeof(pipeline_storage_file_header),
+            1, pipeline_storage_file_) &&
+      pipeline_storage_file_header.magic == pipeline_storage_magic &&
+      pipeline_storage_file_header.magic_api == pipeline_storage_magic_api &&
+      pipeline_storage_file_header.version_swapped ==
+          pipeline_storage_version_swapped &&
+      pipeline_storage_file_header.modification_version_swapped ==
+          pipeline_storage_modification_version_swapped) {
+    xe::filesystem::Seek(pipeline_storage_file_, 0, SEEK_END);
+    int64_t pipeline_storage_told_end =
+        xe::filesystem::Tell(pipeline_storage_file_);
+    size_t pipeline_storage_told_count =
+        size_t(pipeline_storage_told_end >=
+                       int64_t(sizeof(pipeline_storage_file_header))
+                   ? (uint64_t(pipeline_storage_told_end) -
+                      sizeof(pipeline_storage_file_header)) /
+                         sizeof(PipelineStoredDescription)
+                   : 0);
+    if (pipeline_storage_told_count &&
+        xe::filesystem::Seek(pipeline_storage_file_,
+                             int64_t(sizeof(pipeline_storage_file_header)),
+                             SEEK_SET)) {
+      pipeline_stored_descriptions.resize(pipeline_storage_told_count);
+      pipeline_stored_descriptions.resize(
+          fread(pipeline_stored_descriptions.data(),
+                sizeof(PipelineStoredDescription), pipeline_storage_told_count,
+                pipeline_storage_file_));
+      size_t pipeline_storage_read_count = pipeline_stored_descriptions.size();
+      for (size_t i = 0; i < pipeline_storage_read_count; ++i) {
+        const PipelineStoredDescription& pipeline_stored_description =
+            pipeline_stored_descriptions[i];
+        // Validate file integrity, stop and truncate the stream if data is
+        // corrupted.
+        if (pipeline_stored_description.description.GetHash() !=
+            pipeline_stored_description.description_hash) {
+          pipeline_stored_descriptions.resize(i);
+          break;
+        }
+        // Skip pipelines requiring unsupported device features (keeping them
+        // in the file so it stays shareable across devices).
+        if (!ArePipelineRequirementsMet(
+                pipeline_stored_description.description)) {
+          continue;
+        }
+        // Mark the shader modifications as needed for translation.
+        shader_translations_needed.emplace(
+            pipeline_stored_description.description.vertex_shader_hash,
+            pipeline_stored_description.description.vertex_shader_modification);
+        if (pipeline_stored_description.description.pixel_shader_hash) {
+          shader_translations_needed.emplace(
+              pipeline_stored_description.description.pixel_shader_hash,
+              pipeline_stored_description.description
+                  .pixel_shader_modification);
+        }
+      }
+    }
+  }
+
+  size_t logical_processor_count = xe::threading::logical_processor_count();
+  if (!logical_processor_count) {
+    // Pick some reasonable amount if couldn't determine the number of cores.
+    logical_processor_count = 6;
+  }
+
+  // Initialize the Xenos shader storage stream.
+  uint64_t shader_storage_initialization_start =
+      xe::Clock::QueryHostTickCount();
+  auto shader_storage_file_path =
+      shader_storage_shareable_root / fmt::format("{:08X}.xsh", title_id);
+  shader_storage_file_ =
+      xe::filesystem::OpenFile(shader_storage_file_path, "a+b");
+  if (!shader_storage_file_) {
+    XELOGE(
+        "Failed to open the guest shader storage file for writing, persistent "
+        "shader storage will be disabled: {}",
+        xe::path_to_utf8(shader_storage_file_path));
+    fclose(pipeline_storage_file_);
+    pipeline_storage_file_ = nullptr;
+    return;
+  }
+  ++shader_storage_index_;
+  shader_storage_file_flush_needed_ = false;
+  struct {
+    uint32_t magic;
+    uint32_t version_swapped;
+  } shader_storage_file_header;
+  // 'XESH'.
+  const uint32_t shader_storage_magic = 0x48534558;
+  if (fread(&shader_storage_file_header, sizeof(shader_storage_file_header), 1,
+            shader_storage_file_) &&
+      shader_storage_file_header.magic == shader_storage_magic &&
+      xe::byte_swap(shader_storage_file_header.version_swapped) ==
+          ShaderStoredHeader::kVersion) {
+    uint64_t shader_storage_valid_bytes = sizeof(shader_storage_file_header);
+    // Load and translate shaders written by previous Xenia executions until the
+    // end of the file or until a corrupted one is detected.
+    ShaderStoredHeader shader_header;
+    std::vector<uint32_t> ucode_dwords;
+    ucode_dwords.reserve(0xFFFF);
+    size_t shaders_translated = 0;
+
+    // Threads overlapping file reading.
+    std::mutex shaders_translation_thread_mutex;
+    std::condition_variable shaders_translation_thread_cond;
+    std::deque<VulkanShader*> shaders_to_translate;
+    size_t shader_translation_threads_busy = 0;
+    bool shader_translation_threads_shutdown = false;
+    std::mutex shaders_failed_to_translate_mutex;
+    std::vector<VulkanShader::VulkanTranslation*> shaders_failed_to_translate;
+    auto shader_translation_thread_function = [&]() {
+      StringBuffer ucode_disasm_buffer;
+      SpirvShaderTranslator translator(
+          SpirvShaderTranslator::Features(provider.device_info()),
+          render_target_cache_.msaa_2x_attachments_supported(),
+          render_target_cache_.msaa_2x_no_attachments_supported(),
+          edram_fragment_shader_interlock);
+      for (;;) {
+        VulkanShader* shader_to_translate;
+        for (;;) {
+          std::unique_lock<std::mutex> lock(shaders_translation_thread_mutex);
+          if (shaders_to_translate.empty()) {
+            if (shader_translation_threads_shutdown) {
+              return;
+            }
+            shaders_translation_thread_cond.wait(lock);
+            continue;
+          }
+          shader_to_translate = shaders_to_translate.front();
+          shaders_to_translate.pop_front();
+          ++shader_translation_threads_busy;
+          break;
+        }
+        ucode_analysis_cache_.AnalyzeUcode(*shader_to_translate,
+                                           ucode_disasm_buffer);
+        // Translate each needed modification on this thread after performing
+        // modification-independent analysis of the whole shader.
+        uint64_t ucode_data_hash = shader_to_translate->ucode_data_hash();
+        for (auto modification_it = shader_translations_needed.lower_bound(
+                 std::make_pair(ucode_data_hash, uint64_t(0)));
+             modification_it != shader_translations_needed.end() &&
+             modification_it->first == ucode_data_hash;
+             ++modification_it) {
+          VulkanShader::VulkanTranslation* translation =
+              static_cast<VulkanShader::VulkanTranslation*>(
+                  shader_to_translate->GetOrCreateTranslation(
+                      modification_it->second));
+          // Only try (and delete in case of failure) if it's a new translation.
+          // If it's a shader previously encountered in the game, translation of
+          // which has failed, and the shader storage is loaded later, keep it
+          // this way not to try to translate it again.
+          if (!translation->is_translated() &&
+              !TranslateAnalyzedShader(translator, *translation)) {
+            std::lock_guard<std::mutex> lock(shaders_failed_to_translate_mutex);
+            shaders_failed_to_translate.push_back(translation);
+          }
+        }
+        {
+          std::lock_guard<std::mutex> lock(shaders_translation_thread_mutex);
+          --shader_translation_threads_busy;
+        }
+      }
+    };
+    std::vector<std::unique_ptr<xe::threading::Thread>>
+        shader_translation_threads;
+
+    while (true) {
+      if (!fread(&shader_header, sizeof(shader_header), 1,
+                 shader_storage_file_)) {
+        break;
+      }
+      size_t ucode_byte_count =
+          shader_header.ucode_dword_count * sizeof(uint32_t);
+      ucode_dwords.resize(shader_header.ucode_dword_count);
+      if (shader_header.ucode_dword_count &&
+          !fread(ucode_dwords.data(), ucode_byte_count, 1,
+                 shader_storage_file_)) {
+        break;
+      }
+      uint64_t ucode_data_hash =
+          XXH3_64bits(ucode_dwords.data(), ucode_byte_count);
+      if (shader_header.ucode_data_hash != ucode_data_hash) {
+        // Validation failed.
+        break;
+      }
+      shader_storage_valid_bytes += sizeof(shader_header) + ucode_byte_count;
+      VulkanShader* shader =
+          LoadShader(shader_header.type, ucode_dwords.data(),
+                     shader_header.ucode_dword_count, ucode_data_hash);
+      if (shader->ucode_storage_index() == shader_storage_index_) {
+        // Appeared twice in this file for some reason - skip, otherwise race
+        // condition will be caused by translating twice in parallel.
+        continue;
+      }
+      // Loaded from the current storage - don't write again.
+      shader->set_ucode_storage_index(shader_storage_index_);
+      // Create new threads if the currently existing threads can't keep up
+      // with file reading, but not more than the number of logical processors
+      // minus one.
+      size_t shader_translation_threads_needed;
+      {
+        std::lock_guard<std::mutex> lock(shaders_translation_thread_mutex);
+        shader_translation_threads_needed =
+            std::min(shader_translation_threads_busy +
+                         shaders_to_translate.size() + size_t(1),
+                     logical_processor_count - size_t(1));
+      }
+      while (shader_translation_threads.size() <
+             shader_translation_threads_needed) {
+        auto thread = xe::threading::Thread::Create(
+            {}, shader_translation_thread_function);
+        assert_not_null(thread);
+        thread->set_name("Shader Translation");
+        shader_translation_threads.push_back(std::move(thread));
+      }
+      // Request ucode information gathering and translation of all the needed
+      // shaders.
+      {
+        std::lock_guard<std::mutex> lock(shaders_translation_thread_mutex);
+        shaders_to_translate.push_back(shader);
+      }
+      shaders_translation_thread_cond.notify_one();
+      ++shaders_translated;
+    }
+    if (!shader_translation_threads.empty()) {
+      {
+        std::lock_guard<std::mutex> lock(shaders_translation_thread_mutex);
+        shader_translation_threads_shutdown = true;
+      }
+      shaders_translation_thread_cond.notify_all();
+      for (auto& shader_translation_thread : shader_translation_threads) {
+        xe::threading::Wait(shader_translation_thread.get(), false);
+      }
+      shader_translation_threads.clear();
+      for (VulkanShader::VulkanTranslation* translation :
+           shaders_failed_to_translate) {
+        VulkanShader* shader =
+            static_cast<VulkanShader*>(&translation->shader());
+        shader->DestroyTranslation(translation->modification());
+        if (shader->translations().empty()) {
+          shaders_.erase(shader->ucode_data_hash());
+          delete shader;
+        }
+      }
+    }
+    XELOGGPU("Translated {} shaders from the storage in {} milliseconds",
+             shaders_translated,
+             (xe::Clock::QueryHostTickCount() -
+              shader_storage_initialization_start) *
+                 1000 / xe::Clock::QueryHostTickFrequency());
+    xe::filesystem::TruncateStdioFile(shader_storage_file_,
+                                      shader_storage_valid_bytes);
+  } else {
+    xe::filesystem::TruncateStdioFile(shader_storage_file_, 0);
+    shader_storage_file_header.magic = shader_storage_magic;
+    shader_storage_file_header.version_swapped =
+        xe::byte_swap(ShaderStoredHeader::kVersion);
+    fwrite(&shader_storage_file_header, sizeof(shader_storage_file_header), 1,
+           shader_storage_file_);
+  }
+
+  // Create the pipelines.
+  if (!pipeline_stored_descriptions.empty()) {
+    uint64_t pipeline_creation_start = xe::Clock::QueryHostTickCount();
+
+    // With non-blocking initialization, let the persistent creation threads
+    // create the pipelines in the background, with a lower priority than the
+    // pipelines needed for drawing. Otherwise, launch additional creation
+    // threads to use all cores to create pipelines faster. Will also be using
+    // the main thread, so minus 1.
+    bool create_in_background = !blocking && !creation_threads_.empty();
+    size_t creation_thread_original_count = creation_threads_.size();
+    if (!create_in_background) {
+      size_t creation_thread_needed_count = std::max(
+          std::min(pipeline_stored_descriptions.size(),
+                   logical_processor_count) -
+              size_t(1),
+          creation_thread_original_count);
+      while (creation_threads_.size() < creation_thread_needed_count) {
+        size_t creation_thread_index = creation_threads_.size();
+        std::unique_ptr<xe::threading::Thread> creation_thread =
+            xe::threading::Thread::Create({}, [this, creation_thread_index]() {
+              CreationThread(creation_thread_index);
+            });
+        assert_not_null(creation_thread);
+        creation_thread->set_name("Vulkan Pipelines");
+        creation_threads_.push_back(std::move(creation_thread));
+      }
+    }
+
+    size_t pipelines_created = 0;
+    for (const PipelineStoredDescription& pipeline_stored_description :
+         pipeline_stored_descriptions) {
+      const PipelineDescription& pipeline_description =
+          pipeline_stored_description.description;
+      if (!ArePipelineRequirementsMet(pipeline_description)) {
+        continue;
+      }
+      // Skip already known pipelines.
+      if (pipelines_.find(pipeline_description) != pipelines_.end()) {
+        continue;
+      }
+
+      auto vertex_shader_it =
+          shaders_.find(pipeline_description.vertex_shader_hash);
+      if (vertex_shader_it == shaders_.end()) {
+        continue;
+      }
+      auto vertex_shader = static_cast<VulkanShader::VulkanTranslation*>(
+          vertex_shader_it->second->GetTranslation(
+              pipeline_description.vertex_shader_modification));
+      if (!vertex_shader || !vertex_shader->is_translated() ||
+          !vertex_shader->is_valid()) {
+        continue;
+      }
+      VulkanShader::VulkanTranslation* pixel_shader = nullptr;
+      if (pipeline_description.pixel_shader_hash) {
+        auto pixel_shader_it =
+            shaders_.find(pipeline_description.pixel_shader_hash);
+        if (pixel_shader_it == shaders_.end()) {
+          continue;
+        }
+        pixel_shader = static_cast<VulkanShader::VulkanTranslation*>(
+            pixel_shader_it->second->GetTranslation(
+                pipeline_description.pixel_shader_modification));
+        if (!pixel_shader || !pixel_shader->is_translated() ||
+            !pixel_shader->is_valid()) {
+          continue;
+        }
+      }
+
+      const PipelineLayoutProvider* pipeline_layout;
+      VkShaderModule geometry_shader;
+      VkRenderPass render_pass;
+      if (!GetPipelineCreationObjects(pipeline_description, vertex_shader,
+                                      pixel_shader, pipeline_layout,
+                                      geometry_shader, render_pass)) {
+        continue;
+      }
+      auto& pipeline =
+          *pipelines_
+               .emplace(std::piecewise_construct,
+                        std::forward_as_tuple(pipeline_description),
+                        std::forward_as_tuple(pipeline_layout))
+               .first;
+      pipeline.second.creation_state = PipelineCreationState::kPreloadQueued;
+      pipeline.second.needed_for_drawing = false;
+      PipelineCreationArguments creation_arguments;
+      creation_arguments.pipeline = &pipeline;
+      creation_arguments.vertex_shader = vertex_shader;
+      creation_arguments.pixel_shader = pixel_shader;
+      creation_arguments.geometry_shader = geometry_shader;
+      creation_arguments.render_pass = render_pass;
+      {
+        std::lock_guard<std::mutex> lock(creation_request_lock_);
+        creation_preload_queue_.push_back(creation_arguments);
+      }
+      creation_request_cond_.notify_one();
+      ++pipelines_created;
+    }
+
+    if (!create_in_background) {
+      CreateQueuedPipelinesOnProcessorThread(true);
+      if (creation_threads_.size() > creation_thread_original_count) {
+        {
+          std::lock_guard<std::mutex> lock(creation_request_lock_);
+          creation_threads_shutdown_from_ = creation_thread_original_count;
+          // Assuming the queue is empty because of
+          // CreateQueuedPipelinesOnProcessorThread.
+        }
+        creation_request_cond_.notify_all();
+        while (creation_threads_.size() > creation_thread_original_count) {
+          xe::threading::Wait(creation_threads_.back().get(), false);
+          creation_threads_.pop_back();
+        }
+        {
+          // Cleanup so additional threads can be created later again.
+          std::lock_guard<std::mutex> lock(creation_request_lock_);
+          creation_threads_shutdown_from_ = SIZE_MAX;
+        }
+      }
+      // All the shader storage initialization is expected to be done before
+      // proceeding, to avoid latency in the command processor after the
+      // invocation.
+      AwaitPipelineCreationCompletion(true);
+    }
+
+    XELOGGPU(
+        "{} {} graphics pipelines (not including reading the descriptions) "
+        "from the storage in {} milliseconds",
+        create_in_background ? "Queued" : "Created", pipelines_created,
+        (xe::Clock::QueryHostTickCount() - pipeline_creation_start) * 1000 /
+            xe::Clock::QueryHostTickFrequency());
+    // If any pipeline descriptions were corrupted (or the whole file has excess
+    // bytes in the end), truncate to the last valid pipeline description.
+    xe::filesystem::TruncateStdioFile(
+        pipeline_storage_file_,
+        uint64_t(sizeof(pipeline_storage_file_header) +
+                 sizeof(PipelineStoredDescription) *
+                     pipeline_stored_descriptions.size()));
+  } else {
+    xe::filesystem::TruncateStdioFile(pipeline_storage_file_, 0);
+    pipeline_storage_file_header.magic = pipeline_storage_magic;
+    pipeline_storage_file_header.magic_api = pipeline_storage_magic_api;
+    pipeline_storage_file_header.version_swapped =
+        pipeline_storage_version_swapped;
+    pipeline_storage_file_header.modification_version_swapped =
+        pipeline_storage_modification_version_swapped;
+    fwrite(&pipeline_storage_file_header, sizeof(pipeline_storage_file_header),
+           1, pipeline_storage_file_);
+  }
+
+  shader_storage_cache_root_ = cache_root;
+  shader_storage_title_id_ = title_id;
+
+  // Start the storage writing thread.
+  storage_write_flush_shaders_ = false;
+  storage_write_flush_pipelines_ = false;
+  storage_write_thread_shutdown_ = false;
+  storage_write_thread_ =
+      xe::threading::Thread::Create({}, [this]() { StorageWriteThread(); });
+  assert_not_null(storage_write_thread_);
+  storage_write_thread_->set_name("Vulkan Storage writer");
+}
+
+void VulkanPipelineCache::ShutdownShaderStorage() {
+  if (storage_write_thread_) {
+    {
+      std::lock_guard<std::mutex> lock(storage_write_request_lock_);
+      storage_write_thread_shutdown_ = true;
+    }
+    storage_write_request_cond_.notify_all();
+    xe::threading::Wait(storage_write_thread_.get(), false);
+    storage_write_thread_.reset();
+  }
+  storage_write_shader_queue_.clear();
+  storage_write_pipeline_queue_.clear();
+
+  if (pipeline_storage_file_) {
+    fclose(pipeline_storage_file_);
+    pipeline_storage_file_ = nullptr;
+    pipeline_storage_file_flush_needed_ = false;
+  }
+
+  if (shader_storage_file_) {
+    fclose(shader_storage_file_);
+    shader_storage_file_ = nullptr;
+    shader_storage_file_flush_needed_ = false;
+  }
+
+  StoreVkPipelineCache();
+  vk_pipeline_cache_file_path_.clear();
+
+  if (spirv_optimization_cache_) {
+    spirv_optimization_cache_->Close();
+  }
+  ucode_analysis_cache_.Close();
+
+  shader_storage_cache_root_.clear();
+  shader_storage_title_id_ = 0;
+}
+
+void VulkanPipelineCache::EndSubmission() {
+  if (shader_storage_file_flush_needed_ ||
+      pipeline_storage_file_flush_needed_) {
+    {
+      std::lock_guard<std::mutex> lock(storage_write_request_lock_);
+      if (shader_storage_file_flush_needed_) {
+        storage_write_flush_shaders_ = true;
+      }
+      if (pipeline_storage_file_flush_needed_) {
+        storage_write_flush_pipelines_ = true;
+      }
+    }
+    storage_write_request_cond_.notify_one();
+    shader_storage_file_flush_needed_ = false;
+    pipeline_storage_file_flush_needed_ = false;
+  }
+  if (!cvars::vulkan_pipeline_creation_skip_draws) {
+    // Await creation of all the pipelines needed for drawing in the
+    // submission, leaving the ones from the storage in the background.
+    uint64_t stall_start = xe::Clock::QueryHostTickCount();
+    if (AwaitPipelineCreationCompletion(false)) {
+      ++pipeline_creation_frame_statistics_.submission_stalls;
+      pipeline_creation_frame_statistics_.submission_stall_microseconds +=
+          (xe::Clock::QueryHostTickCount() - stall_start) * 1000000 /
+          xe::Clock::QueryHostTickFrequency();
+    }
+  }
+}
+
+void VulkanPipelineCache::EndFrame() {
+  last_frame_pipeline_creation_statistics_ =
+      pipeline_creation_frame_statistics_;
+  pipeline_creation_frame_statistics_ = PipelineCreationStatistics();
+}
+
 VulkanShader* VulkanPipelineCache::LoadShader(xenos::ShaderType shader_type,
                                               const uint32_t* host_address,
                                               uint32_t dword_count) {
   // Hash the input memory and lookup the shader.
-  uint64_t data_hash =
-      XXH3_64bits(host_address, dword_count * sizeof(uint32_t));
+  return LoadShader(shader_type, host_address, dword_count,
+                    XXH3_64bits(host_address, dword_count * sizeof(uint32_t)));
+}
+
+VulkanShader* VulkanPipelineCache::LoadShader(xenos::ShaderType shader_type,
+                                              const uint32_t* host_address,
+                                              uint32_t dword_count,
+                                              uint64_t data_hash) {
   auto it = shaders_.find(data_hash);
   if (it != shaders_.end()) {
     // Shader has been previously loaded.
@@ -233,11 +965,12 @@ bool VulkanPipelineCache::EnsureShadersTranslated(
                   xenos::VertexShaderExportMode::kPosition2VectorsEdgeKill);
   assert_false(register_file_.Get<reg::SQ_PROGRAM_CNTL>().gen_index_vtx);
   if (!vertex_shader->is_translated()) {
-    vertex_shader->shader().AnalyzeUcode(ucode_disasm_buffer_);
+    AnalyzeShaderUcode(vertex_shader->shader());
     if (!TranslateAnalyzedShader(*shader_translator_, *vertex_shader)) {
       XELOGE("Failed to translate the vertex shader!");
       return false;
     }
+    StoreShader(vertex_shader->shader());
   }
   if (!vertex_shader->is_valid()) {
     // Translation attempted previously, but not valid.
@@ -245,11 +978,12 @@ bool VulkanPipelineCache::EnsureShadersTranslated(
   }
   if (pixel_shader != nullptr) {
     if (!pixel_shader->is_translated()) {
-      pixel_shader->shader().AnalyzeUcode(ucode_disasm_buffer_);
+      AnalyzeShaderUcode(pixel_shader->shader());
       if (!TranslateAnalyzedShader(*shader_translator_, *pixel_shader)) {
         XELOGE("Failed to translate the pixel shader!");
         return false;
       }
+      StoreShader(pixel_shader->shader());
     }
     if (!pixel_shader->is_valid()) {
       // Translation attempted previously, but not valid.
@@ -266,7 +1000,7 @@ bool VulkanPipelineCache::ConfigurePipeline(
     reg::RB_DEPTHCONTROL normalized_depth_control,
     uint32_t normalized_color_mask,
     VulkanRenderTargetCache::RenderPassKey render_pass_key,
-    VkPipeline& pipeline_out,
+    void*& pipeline_handle_out,
     const PipelineLayoutProvider*& pipeline_layout_out) {
 #if XE_UI_VULKAN_FINE_GRAINED_DRAW_SCOPES
   SCOPE_profile_cpu_f("gpu");
@@ -285,74 +1019,84 @@ bool VulkanPipelineCache::ConfigurePipeline(
     return false;
   }
   if (last_pipeline_ && last_pipeline_->first == description) {
-    pipeline_out = last_pipeline_->second.pipeline;
+    if (creation_threads_.empty() &&
+        last_pipeline_->second.pipeline.load(std::memory_order_relaxed) ==
+            VK_NULL_HANDLE) {
+      // Creation on the draw has already failed.
+      return false;
+    }
+    pipeline_handle_out = last_pipeline_;
     pipeline_layout_out = last_pipeline_->second.pipeline_layout;
     return true;
   }
   auto it = pipelines_.find(description);
   if (it != pipelines_.end()) {
+    if (creation_threads_.empty() &&
+        it->second.pipeline.load(std::memory_order_relaxed) == VK_NULL_HANDLE) {
+      return false;
+    }
+    if (!it->second.needed_for_drawing) {
+      PrioritizePipelineCreation(*it);
+    }
     last_pipeline_ = &*it;
-    pipeline_out = it->second.pipeline;
+    pipeline_handle_out = &*it;
     pipeline_layout_out = it->second.pipeline_layout;
     return true;
   }
 
   // Create the pipeline if not the latest and not already existing.
-  const PipelineLayoutProvider* pipeline_layout =
-      command_processor_.GetPipelineLayout(
-          pixel_shader
-              ? static_cast<const VulkanShader&>(pixel_shader->shader())
-                    .GetTextureBindingsAfterTranslation()
-                    .size()
-              : 0,
-          pixel_shader
-              ? static_cast<const VulkanShader&>(pixel_shader->shader())
-                    .GetSamplerBindingsAfterTranslation()
-                    .size()
-              : 0,
-          static_cast<const VulkanShader&>(vertex_shader->shader())
-              .GetTextureBindingsAfterTranslation()
-              .size(),
-          static_cast<const VulkanShader&>(vertex_shader->shader())
-              .GetSamplerBindingsAfterTranslation()
-              .size());
-  if (!pipeline_layout) {
-    return false;
-  }
-  VkShaderModule geometry_shader = VK_NULL_HANDLE;
-  GeometryShaderKey geometry_shader_key;
-  if (GetGeometryShaderKey(
-          description.geometry_shader,
-          SpirvShaderTranslator::Modification(vertex_shader->modification()),
-          SpirvShaderTranslator::Modification(
-              pixel_shader ? pixel_shader->modification() : 0),
-          geometry_shader_key)) {
-    geometry_shader = GetGeometryShader(geometry_shader_key);
-    if (geometry_shader == VK_NULL_HANDLE) {
-      return false;
-    }
-  }
-  VkRenderPass render_pass =
-      render_target_cache_.GetPath() ==
-              RenderTargetCache::Path::kPixelShaderInterlock
-          ? render_target_cache_.GetFragmentShaderInterlockRenderPass()
-          : render_target_cache_.GetHostRenderTargetsRenderPass(
-                render_pass_key);
-  if (render_pass == VK_NULL_HANDLE) {
+  const PipelineLayoutProvider* pipeline_layout;
+  VkShaderModule geometry_shader;
+  VkRenderPass render_pass;
+  if (!GetPipelineCreationObjects(description, vertex_shader, pixel_shader,
+                                  pipeline_layout, geometry_shader,
+                                  render_pass)) {
     return false;
   }
   PipelineCreationArguments creation_arguments;
-  auto& pipeline =
-      *pipelines_.emplace(description, Pipeline(pipeline_layout)).first;
+  auto& pipeline = *pipelines_
+                        .emplace(std::piecewise_construct,
+                                 std::forward_as_tuple(description),
+                                 std::forward_as_tuple(pipeline_layout))
+                        .first;
   creation_arguments.pipeline = &pipeline;
   creation_arguments.vertex_shader = vertex_shader;
   creation_arguments.pixel_shader = pixel_shader;
   creation_arguments.geometry_shader = geometry_shader;
   creation_arguments.render_pass = render_pass;
-  if (!EnsurePipelineCreated(creation_arguments)) {
-    return false;
+  if (!creation_threads_.empty()) {
+    // Submit the pipeline for creation to any available thread.
+    pipeline.second.creation_state = PipelineCreationState::kQueued;
+    {
+      std::lock_guard<std::mutex> lock(creation_request_lock_);
+      creation_queue_.push_back(creation_arguments);
+    }
+    creation_request_cond_.notify_one();
+    ++pipeline_creation_frame_statistics_.pipelines_queued;
+  } else {
+    ++pipeline_creation_frame_statistics_.pipelines_created_on_draw;
+    if (!EnsurePipelineCreated(creation_arguments)) {
+      return false;
+    }
+  }
+
+  if (pipeline_storage_file_) {
+    assert_not_null(storage_write_thread_);
+    pipeline_storage_file_flush_needed_ = true;
+    {
+      std::lock_guard<std::mutex> lock(storage_write_request_lock_);
+      storage_write_pipeline_queue_.emplace_back();
+      PipelineStoredDescription& stored_description =
+          storage_write_pipeline_queue_.back();
+      stored_description.description_hash = description.GetHash();
+      std::memcpy(&stored_description.description, &description,
+                  sizeof(description));
+    }
+    storage_write_request_cond_.notify_all();
   }
-  pipeline_out = pipeline.second.pipeline;
+
+  last_pipeline_ = &pipeline;
+  pipeline_handle_out = &pipeline;
   pipeline_layout_out = pipeline_layout;
   return true;
 }
@@ -369,6 +1113,27 @@ bool VulkanPipelineCache::TranslateAnalyzedShader(
            shader.ucode_data_hash());
     return false;
   }
+  if (spirv_optimization_cache_) {
+    // May be called on multiple threads when loading the storage, the cache is
+    // thread-safe. If the optimization fails, the unoptimized binary is used.
+    // When translating on a draw, this is done on the command processor thread,
+    // and the draw waits for it - the optimized module is needed for creating
+    // the shader module before the pipeline can be created (or queued on the
+    // creation threads).
+    const std::vector<uint8_t>& translated_binary =
+        translation.translated_binary();
+    std::vector<uint32_t> optimized_spirv;
+    if (spirv_optimization_cache_->GetOptimized(
+            reinterpret_cast<const uint32_t*>(translated_binary.data()),
+            translated_binary.size() / sizeof(uint32_t), optimized_spirv)) {
+      translation.SetOptimizedSpirv(std::move(optimized_spirv));
+    } else {
+      XELOGW(
+          "Failed to optimize the SPIR-V of shader {:016X} modification "
+          "{:016X}, using the unoptimized version",
+          shader.ucode_data_hash(), translation.modification());
+    }
+  }
   if (translation.GetOrCreateShaderModule() == VK_NULL_HANDLE) {
     return false;
   }
@@ -389,6 +1154,8 @@ bool VulkanPipelineCache::TranslateAnalyzedShader(
           texture_binding_count * sizeof(*texture_bindings.data());
       uint64_t texture_binding_layout_hash =
           XXH3_64bits(texture_bindings.data(), texture_binding_layout_bytes);
+      // May be translating on multiple threads when loading the storage.
+      std::lock_guard<std::mutex> layouts_lock(layouts_mutex_);
       auto found_range =
           texture_binding_layout_map_.equal_range(texture_binding_layout_hash);
       for (auto it = found_range.first; it != found_range.second; ++it) {
@@ -436,6 +1203,21 @@ bool VulkanPipelineCache::TranslateAnalyzedShader(
   return true;
 }
 
+void VulkanPipelineCache::StoreShader(Shader& shader) {
+  if (!shader_storage_file_ ||
+      shader.ucode_storage_index() == shader_storage_index_) {
+    return;
+  }
+  shader.set_ucode_storage_index(shader_storage_index_);
+  assert_not_null(storage_write_thread_);
+  shader_storage_file_flush_needed_ = true;
+  {
+    std::lock_guard<std::mutex> lock(storage_write_request_lock_);
+    storage_write_shader_queue_.push_back(&shader);
+  }
+  storage_write_request_cond_.notify_all();
+}
+
 void VulkanPipelineCache::WritePipelineRenderTargetDescription(
     reg::RB_BLENDCONTROL blend_control, uint32_t write_mask,
     PipelineRenderTarget& render_target_out) const {
@@ -849,6 +1631,62 @@ bool VulkanPipelineCache::ArePipelineRequirementsMet(
   return true;
 }
 
+bool VulkanPipelineCache::GetPipelineCreationObjects(
+    const PipelineDescription& description,
+    const VulkanShader::VulkanTranslation* vertex_shader,
+    const VulkanShader::VulkanTranslation* pixel_shader,
+    const PipelineLayoutProvider*& pipeline_layout_out,
+    VkShaderModule& geometry_shader_out, VkRenderPass& render_pass_out) {
+  const PipelineLayoutProvider* pipeline_layout =
+      command_processor_.GetPipelineLayout(
+          pixel_shader
+              ? static_cast<const VulkanShader&>(pixel_shader->shader())
+                    .GetTextureBindingsAfterTranslation()
+                    .size()
+              : 0,
+          pixel_shader
+              ? static_cast<const VulkanShader&>(pixel_shader->shader())
+                    .GetSamplerBindingsAfterTranslation()
+                    .size()
+              : 0,
+          static_cast<const VulkanShader&>(vertex_shader->shader())
+              .GetTextureBindingsAfterTranslation()
+              .size(),
+          static_cast<const VulkanShader&>(vertex_shader->shader())
+              .GetSamplerBindingsAfterTranslation()
+              .size());
+  if (!pipeline_layout) {
+    return false;
+  }
+  VkShaderModule geometry_shader = VK_NULL_HANDLE;
+  GeometryShaderKey geometry_shader_key;
+  if (GetGeometryShaderKey(
+          description.geometry_shader,
+          SpirvShaderTranslator::Modification(
+              description.vertex_shader_modification),
+          SpirvShaderTranslator::Modification(
+              description.pixel_shader_modification),
+          geometry_shader_key)) {
+    geometry_shader = GetGeometryShader(geometry_shader_key);
+    if (geometry_shader == VK_NULL_HANDLE) {
+      return false;
+    }
+  }
+  VkRenderPass render_pass =
+      render_target_cache_.GetPath() ==
+              RenderTargetCache::Path::kPixelShaderInterlock
+          ? render_target_cache_.GetFragmentShaderInterlockRenderPass()
+          : render_target_cache_.GetHostRenderTargetsRenderPass(
+                description.render_pass_key);
+  if (render_pass == VK_NULL_HANDLE) {
+    return false;
+  }
+  pipeline_layout_out = pipeline_layout;
+  geometry_shader_out = geometry_shader;
+  render_pass_out = render_pass;
+  return true;
+}
+
 bool VulkanPipelineCache::GetGeometryShaderKey(
     PipelineGeometryShader geometry_shader_type,
     SpirvShaderTranslator::Modification vertex_shader_modification,
@@ -1866,7 +2704,8 @@ VkShaderModule VulkanPipelineCache::GetGeometryShader(GeometryShaderKey key) {
 
 bool VulkanPipelineCache::EnsurePipelineCreated(
     const PipelineCreationArguments& creation_arguments) {
-  if (creation_arguments.pipeline->second.pipeline != VK_NULL_HANDLE) {
+  if (creation_arguments.pipeline->second.pipeline.load(
+          std::memory_order_relaxed) != VK_NULL_HANDLE) {
     return true;
   }
 
@@ -2279,7 +3118,7 @@ bool VulkanPipelineCache::EnsurePipelineCreated(
   const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
   VkDevice device = provider.device();
   VkPipeline pipeline;
-  if (dfn.vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1,
+  if (dfn.vkCreateGraphicsPipelines(device, vk_pipeline_cache_, 1,
                                     &pipeline_create_info, nullptr,
                                     &pipeline) != VK_SUCCESS) {
     // TODO(Triang3l): Move these error messages outside.
@@ -2294,10 +3133,357 @@ bool VulkanPipelineCache::EnsurePipelineCreated(
     } */
     return false;
   }
-  creation_arguments.pipeline->second.pipeline = pipeline;
+  creation_arguments.pipeline->second.pipeline.store(
+      pipeline, std::memory_order_release);
   return true;
 }
 
+void VulkanPipelineCache::PrioritizePipelineCreation(
+    std::pair<const PipelineDescription, Pipeline>& pipeline) {
+  assert_false(pipeline.second.needed_for_drawing);
+  pipeline.second.needed_for_drawing = true;
+  bool queued_for_drawing = false;
+  {
+    std::lock_guard<std::mutex> lock(creation_request_lock_);
+    switch (pipeline.second.creation_state) {
+      case PipelineCreationState::kPreloadQueued: {
+        auto it = std::find_if(
+            creation_preload_queue_.begin(), creation_preload_queue_.end(),
+            [&pipeline](const PipelineCreationArguments& creation_arguments) {
+              return creation_arguments.pipeline == &pipeline;
+            });
+        assert_true(it != creation_preload_queue_.end());
+        creation_queue_.push_back(*it);
+        creation_preload_queue_.erase(it);
+        pipeline.second.creation_state = PipelineCreationState::kQueued;
+        queued_for_drawing = true;
+      } break;
+      case PipelineCreationState::kPreloadCreating:
+        // The creation thread will decrement the drawing busy count when done.
+        pipeline.second.creation_state = PipelineCreationState::kCreating;
+        ++creation_threads_busy_for_drawing_;
+        break;
+      default:
+        // Already created.
+        return;
+    }
+  }
+  if (queued_for_drawing) {
+    creation_request_cond_.notify_one();
+  }
+  ++pipeline_creation_frame_statistics_.preload_pipelines_prioritized;
+}
+
+void VulkanPipelineCache::LoadVkPipelineCache(
+    const std::filesystem::path& file_path) {
+  vk_pipeline_cache_file_path_ = file_path;
+
+  const ui::vulkan::VulkanProvider& provider =
+      command_processor_.GetVulkanProvider();
+  const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
+  VkDevice device = provider.device();
+  const ui::vulkan::VulkanProvider::DeviceInfo& device_info =
+      provider.device_info();
+
+  std::vector<uint8_t> data;
+  FILE* file = xe::filesystem::OpenFile(file_path, "rb");
+  if (file) {
+    PipelineCacheDataFileHeader file_header;
+    if (fread(&file_header, sizeof(file_header), 1, file) &&
+        file_header.magic == kPipelineCacheDataFileMagic &&
+        file_header.version == PipelineCacheDataFileHeader::kVersion &&
+        file_header.data_size <= kPipelineCacheDataMaxSize) {
+      data.resize(size_t(file_header.data_size));
+      if (!data.empty() &&
+          (!fread(data.data(), data.size(), 1, file) ||
+           XXH3_64bits(data.data(), data.size()) != file_header.data_hash)) {
+        data.clear();
+      }
+    }
+    fclose(file);
+  }
+  // Not relying only on the validation done by the driver, as some drivers
+  // are known to crash when given the data created by a different device.
+  // VkPipelineCacheHeaderVersionOne: headerSize, headerVersion, vendorID,
+  // deviceID, pipelineCacheUUID.
+  uint32_t data_header[4];
+  if (data.size() >= sizeof(data_header) + VK_UUID_SIZE) {
+    std::memcpy(data_header, data.data(), sizeof(data_header));
+    if (data_header[0] < sizeof(data_header) + VK_UUID_SIZE ||
+        data_header[1] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+        data_header[2] != device_info.vendorID ||
+        data_header[3] != device_info.deviceID ||
+        std::memcmp(data.data() + sizeof(data_header),
+                    device_info.pipelineCacheUUID, VK_UUID_SIZE)) {
+      XELOGGPU(
+          "Vulkan pipeline cache data was created by a different device or "
+          "driver, discarding it");
+      data.clear();
+    }
+  } else {
+    data.clear();
+  }
+
+  // Recreating even without the initial data not to write pipelines of the
+  // previous title to the storage of this one. Pipelines don't depend on the
+  // cache they were created with.
+  VkPipelineCacheCreateInfo pipeline_cache_create_info;
+  pipeline_cache_create_info.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  pipeline_cache_create_info.pNext = nullptr;
+  pipeline_cache_create_info.flags = 0;
+  pipeline_cache_create_info.initialDataSize = data.size();
+  pipeline_cache_create_info.pInitialData = data.data();
+  ui::vulkan::util::DestroyAndNullHandle(dfn.vkDestroyPipelineCache, device,
+                                         vk_pipeline_cache_);
+  if (dfn.vkCreatePipelineCache(device, &pipeline_cache_create_info, nullptr,
+                                &vk_pipeline_cache_) != VK_SUCCESS) {
+    XELOGW("Failed to create a Vulkan pipeline cache for the storage");
+    vk_pipeline_cache_ = VK_NULL_HANDLE;
+    return;
+  }
+  if (!data.empty()) {
+    XELOGGPU("Loaded {} bytes of Vulkan pipeline cache data", data.size());
+  }
+}
+
+void VulkanPipelineCache::StoreVkPipelineCache() {
+  if (vk_pipeline_cache_ == VK_NULL_HANDLE ||
+      vk_pipeline_cache_file_path_.empty()) {
+    return;
+  }
+  const ui::vulkan::VulkanProvider& provider =
+      command_processor_.GetVulkanProvider();
+  const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
+  VkDevice device = provider.device();
+  size_t data_size;
+  if (dfn.vkGetPipelineCacheData(device, vk_pipeline_cache_, &data_size,
+                                 nullptr) != VK_SUCCESS ||
+      !data_size || data_size > kPipelineCacheDataMaxSize) {
+    return;
+  }
+  std::vector<uint8_t> data(data_size);
+  if (dfn.vkGetPipelineCacheData(device, vk_pipeline_cache_, &data_size,
+                                 data.data()) != VK_SUCCESS) {
+    return;
+  }
+  data.resize(data_size);
+  PipelineCacheDataFileHeader file_header;
+  file_header.magic = kPipelineCacheDataFileMagic;
+  file_header.version = PipelineCacheDataFileHeader::kVersion;
+  file_header.data_size = data_size;
+  file_header.data_hash = XXH3_64bits(data.data(), data.size());
+  FILE* file = xe::filesystem::OpenFile(vk_pipeline_cache_file_path_, "wb");
+  if (!file) {
+    XELOGW("Failed to open the Vulkan pipeline cache file for writing: {}",
+           xe::path_to_utf8(vk_pipeline_cache_file_path_));
+    return;
+  }
+  fwrite(&file_header, sizeof(file_header), 1, file);
+  fwrite(data.data(), data.size(), 1, file);
+  fclose(file);
+}
+
+void VulkanPipelineCache::StorageWriteThread() {
+  ShaderStoredHeader shader_header;
+  // Don't leak anything in unused bits.
+  std::memset(&shader_header, 0, sizeof(shader_header));
+
+  std::vector<uint32_t> ucode_guest_endian;
+  ucode_guest_endian.reserve(0xFFFF);
+
+  bool flush_shaders = false;
+  bool flush_pipelines = false;
+
+  while (true) {
+    if (flush_shaders) {
+      flush_shaders = false;
+      assert_not_null(shader_storage_file_);
+      fflush(shader_storage_file_);
+    }
+    if (flush_pipelines) {
+      flush_pipelines = false;
+      assert_not_null(pipeline_storage_file_);
+      fflush(pipeline_storage_file_);
+    }
+
+    const Shader* shader = nullptr;
+    PipelineStoredDescription pipeline_description;
+    bool write_pipeline = false;
+    {
+      std::unique_lock<std::mutex> lock(storage_write_request_lock_);
+      if (storage_write_thread_shutdown_) {
+        return;
+      }
+      if (!storage_write_shader_queue_.empty()) {
+        shader = storage_write_shader_queue_.front();
+        storage_write_shader_queue_.pop_front();
+      } else if (storage_write_flush_shaders_) {
+        storage_write_flush_shaders_ = false;
+        flush_shaders = true;
+      }
+      if (!storage_write_pipeline_queue_.empty()) {
+        std::memcpy(&pipeline_description,
+                    &storage_write_pipeline_queue_.front(),
+                    sizeof(pipeline_description));
+        storage_write_pipeline_queue_.pop_front();
+        write_pipeline = true;
+      } else if (storage_write_flush_pipelines_) {
+        storage_write_flush_pipelines_ = false;
+        flush_pipelines = true;
+      }
+      if (!shader && !write_pipeline) {
+        storage_write_request_cond_.wait(lock);
+        continue;
+      }
+    }
+
+    if (shader) {
+      shader_header.ucode_data_hash = shader->ucode_data_hash();
+      shader_header.ucode_dword_count = shader->ucode_dword_count();
+      shader_header.type = shader->type();
+      assert_not_null(shader_storage_file_);
+      fwrite(&shader_header, sizeof(shader_header), 1, shader_storage_file_);
+      if (shader_header.ucode_dword_count) {
+        ucode_guest_endian.resize(shader_header.ucode_dword_count);
+        // Need to swap because the hash is calculated for the shader with guest
+        // endianness.
+        xe::copy_and_swap(ucode_guest_endian.data(), shader->ucode_dwords(),
+                          shader_header.ucode_dword_count);
+        fwrite(ucode_guest_endian.data(),
+               shader_header.ucode_dword_count * sizeof(uint32_t), 1,
+               shader_storage_file_);
+      }
+    }
+
+    if (write_pipeline) {
+      assert_not_null(pipeline_storage_file_);
+      fwrite(&pipeline_description, sizeof(pipeline_description), 1,
+             pipeline_storage_file_);
+    }
+  }
+}
+
+void VulkanPipelineCache::CreationThread(size_t thread_index) {
+  while (true) {
+    PipelineCreationArguments creation_arguments;
+    bool for_drawing;
+
+    // Check if need to shut down or set the completion event and dequeue the
+    // pipeline if there is any, preferring the ones needed for drawing.
+    {
+      std::unique_lock<std::mutex> lock(creation_request_lock_);
+      if (creation_completion_set_event_ &&
+          IsPipelineCreationComplete(creation_completion_include_preload_)) {
+        // Last awaited pipeline created - signal the event if requested.
+        creation_completion_set_event_ = false;
+        creation_completion_event_->Set();
+      }
+      if (thread_index >= creation_threads_shutdown_from_) {
+        return;
+      }
+      std::deque<PipelineCreationArguments>* queue;
+      if (!creation_queue_.empty()) {
+        queue = &creation_queue_;
+        for_drawing = true;
+      } else if (!creation_preload_queue_.empty()) {
+        queue = &creation_preload_queue_;
+        for_drawing = false;
+      } else {
+        creation_request_cond_.wait(lock);
+        continue;
+      }
+      // Take the pipeline from the queue and increment the busy thread count
+      // until the pipeline is created - other threads must be able to dequeue
+      // requests, but can't set the completion event until the pipelines are
+      // fully created (rather than just started creating).
+      creation_arguments = queue->front();
+      queue->pop_front();
+      creation_arguments.pipeline->second.creation_state =
+          for_drawing ? PipelineCreationState::kCreating
+                      : PipelineCreationState::kPreloadCreating;
+      ++creation_threads_busy_;
+      if (for_drawing) {
+        ++creation_threads_busy_for_drawing_;
+      }
+    }
+
+    EnsurePipelineCreated(creation_arguments);
+
+    // Pipeline created - the thread is not busy anymore, safe to set the
+    // completion event if needed (at the next iteration, or in some other
+    // thread). The pipeline might have been prioritized while being created.
+    {
+      std::lock_guard<std::mutex> lock(creation_request_lock_);
+      PipelineCreationState& creation_state =
+          creation_arguments.pipeline->second.creation_state;
+      if (creation_state == PipelineCreationState::kCreating) {
+        --creation_threads_busy_for_drawing_;
+      }
+      creation_state = PipelineCreationState::kCreated;
+      --creation_threads_busy_;
+    }
+  }
+}
+
+void VulkanPipelineCache::CreateQueuedPipelinesOnProcessorThread(
+    bool include_preload) {
+  while (true) {
+    PipelineCreationArguments creation_arguments;
+    {
+      std::lock_guard<std::mutex> lock(creation_request_lock_);
+      std::deque<PipelineCreationArguments>* queue;
+      if (!creation_queue_.empty()) {
+        queue = &creation_queue_;
+      } else if (include_preload && !creation_preload_queue_.empty()) {
+        queue = &creation_preload_queue_;
+      } else {
+        break;
+      }
+      creation_arguments = queue->front();
+      queue->pop_front();
+      // The state is only checked on the processor thread, which will not
+      // proceed until the pipeline is created.
+      creation_arguments.pipeline->second.creation_state =
+          PipelineCreationState::kCreated;
+    }
+    EnsurePipelineCreated(creation_arguments);
+  }
+}
+
+bool VulkanPipelineCache::IsPipelineCreationComplete(
+    bool include_preload) const {
+  if (!creation_queue_.empty() || creation_threads_busy_for_drawing_) {
+    return false;
+  }
+  return !include_preload ||
+         (creation_preload_queue_.empty() && !creation_threads_busy_);
+}
+
+bool VulkanPipelineCache::AwaitPipelineCreationCompletion(
+    bool include_preload) {
+  CreateQueuedPipelinesOnProcessorThread(include_preload);
+  bool await_creation_completion_event;
+  {
+    std::lock_guard<std::mutex> lock(creation_request_lock_);
+    // Assuming the queues are already empty (because the processor thread
+    // also worked on creating the leftover pipelines), so only check if there
+    // are threads with pipelines currently being created.
+    await_creation_completion_event =
+        !IsPipelineCreationComplete(include_preload);
+    if (await_creation_completion_event) {
+      creation_completion_event_->Reset();
+      creation_completion_set_event_ = true;
+      creation_completion_include_preload_ = include_preload;
+    }
+  }
+  if (await_creation_completion_event) {
+    creation_request_cond_.notify_one();
+    xe::threading::Wait(creation_completion_event_.get(), false);
+  }
+  return await_creation_completion_event;
+}
+
 }  // namespace vulkan
 }  // namespace gpu
 }  // namespace xe
@@ -10,23 +10,36 @@
 #ifndef XENIA_GPU_VULKAN_VULKAN_PIPELINE_STATE_CACHE_H_
 #define XENIA_GPU_VULKAN_VULKAN_PIPELINE_STATE_CACHE_H_
 
+#include <atomic>
+#include <condition_variable>
 #include <cstddef>
+#include <cstdint>
+#include <cstdio>
 #include <cstring>
+#include <deque>
+#include <filesystem>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "xenia/base/hash.h"
 #include "xenia/base/platform.h"
+#include "xenia/base/string_buffer.h"
+#include "xenia/base/threading.h"
 #include "xenia/base/xxhash.h"
 #include "xenia/gpu/primitive_processor.h"
 #include "xenia/gpu/register_file.h"
 #include "xenia/gpu/registers.h"
 #include "xenia/gpu/spirv_shader_translator.h"
+#include "xenia/gpu/ucode_analysis_cache.h"
 #include "xenia/gpu/vulkan/vulkan_render_target_cache.h"
 #include "xenia/gpu/vulkan/vulkan_shader.h"
 #include "xenia/gpu/xenos.h"
+#include "xenia/ui/vulkan/spirv_optimization_cache.h"
+#include "xenia/ui/vulkan/spirv_tools_context.h"
 #include "xenia/ui/vulkan/vulkan_provider.h"
 
 namespace xe {
@@ -59,11 +72,44 @@ class VulkanPipelineCache {
   bool Initialize();
   void Shutdown();
 
+  void InitializeShaderStorage(const std::filesystem::path& cache_root,
+                               uint32_t title_id, bool blocking);
+  void ShutdownShaderStorage();
+
+  void EndSubmission();
+  void EndFrame();
+
+  struct PipelineCreationStatistics {
+    // Pipelines created on the command processor thread when first needed for
+    // drawing, with the creation threads disabled.
+    uint32_t pipelines_created_on_draw = 0;
+    // Pipelines submitted to the creation threads when first needed for
+    // drawing.
+    uint32_t pipelines_queued = 0;
+    // Pipelines from the storage that were needed for drawing before their
+    // creation in the background was complete, moved to the drawing queue.
+    uint32_t preload_pipelines_prioritized = 0;
+    // Submissions that had to wait for the creation threads before execution.
+    uint32_t submission_stalls = 0;
+    uint64_t submission_stall_microseconds = 0;
+    // Draws not executed because their pipelines were not created yet (with
+    // vulkan_pipeline_creation_skip_draws) or have failed to be created.
+    uint32_t draws_skipped = 0;
+  };
+  // For the frame last ended with EndFrame.
+  const PipelineCreationStatistics& last_frame_pipeline_creation_statistics()
+      const {
+    return last_frame_pipeline_creation_statistics_;
+  }
+  void CountSkippedDraws(uint32_t count) {
+    pipeline_creation_frame_statistics_.draws_skipped += count;
+  }
+
   VulkanShader* LoadShader(xenos::ShaderType shader_type,
                            const uint32_t* host_address, uint32_t dword_count);
   // Analyze shader microcode on the translator thread.
   void AnalyzeShaderUcode(Shader& shader) {
-    shader.AnalyzeUcode(ucode_disasm_buffer_);
+    ucode_analysis_cache_.AnalyzeUcode(shader, ucode_disasm_buffer_);
   }
 
   // Retrieves the shader modification for the current state. The shader must
@@ -78,7 +124,10 @@ class VulkanPipelineCache {
 
   bool EnsureShadersTranslated(VulkanShader::VulkanTranslation* vertex_shader,
                                VulkanShader::VulkanTranslation* pixel_shader);
-  // TODO(Triang3l): Return a deferred creation handle.
+  // Returns a handle of a pipeline with potentially deferred creation, to be
+  // resolved with GetVkPipelineByHandle when executing the submission. Without
+  // the creation threads, the pipeline is always created by the time this
+  // returns true.
   bool ConfigurePipeline(
       VulkanShader::VulkanTranslation* vertex_shader,
       VulkanShader::VulkanTranslation* pixel_shader,
@@ -86,10 +135,31 @@ class VulkanPipelineCache {
       reg::RB_DEPTHCONTROL normalized_depth_control,
       uint32_t normalized_color_mask,
       VulkanRenderTargetCache::RenderPassKey render_pass_key,
-      VkPipeline& pipeline_out,
+      void*& pipeline_handle_out,
       const PipelineLayoutProvider*& pipeline_layout_out);
 
+  // Returns a pipeline with deferred creation by its handle. May return
+  // VK_NULL_HANDLE if failed to create the pipeline, or if it's still being
+  // created with vulkan_pipeline_creation_skip_draws.
+  VkPipeline GetVkPipelineByHandle(void* handle) const {
+    return reinterpret_cast<const std::pair<const PipelineDescription,
+                                            Pipeline>*>(handle)
+        ->second.pipeline.load(std::memory_order_acquire);
+  }
+
  private:
+  XEPACKEDSTRUCT(ShaderStoredHeader, {
+    uint64_t ucode_data_hash;
+
+    uint32_t ucode_dword_count : 31;
+    xenos::ShaderType type : 1;
+
+    static constexpr uint32_t kVersion = 0x20201219;
+  });
+
+  // Update PipelineDescription::kVersion if any of the Pipeline* enums are
+  // changed!
+
   enum class PipelineGeometryShader : uint32_t {
     kNone,
     kPointList,
@@ -198,14 +268,42 @@ class VulkanPipelineCache {
         return size_t(description.GetHash());
       }
     };
+
+    static constexpr uint32_t kVersion = 0x20241019;
   });
 
+  XEPACKEDSTRUCT(PipelineStoredDescription, {
+    uint64_t description_hash;
+    PipelineDescription description;
+  });
+
+  enum class PipelineCreationState : uint32_t {
+    // In creation_preload_queue_.
+    kPreloadQueued,
+    // Taken from creation_preload_queue_ by a creation thread.
+    kPreloadCreating,
+    // In creation_queue_.
+    kQueued,
+    // Taken from creation_queue_ by a creation thread.
+    kCreating,
+    // Created, or failed to be created.
+    kCreated,
+  };
+
   struct Pipeline {
-    VkPipeline pipeline = VK_NULL_HANDLE;
+    // VK_NULL_HANDLE if creation has failed or is not complete yet. Written by
+    // the creation threads, may be read while executing the deferred command
+    // buffer.
+    std::atomic<VkPipeline> pipeline{VK_NULL_HANDLE};
     // The layouts are owned by the VulkanCommandProcessor, and must not be
     // destroyed by it while the pipeline cache is active.
     const PipelineLayoutProvider* pipeline_layout;
-    Pipeline(const PipelineLayoutProvider* pipeline_layout_provider)
+    // Protected with creation_request_lock_.
+    PipelineCreationState creation_state = PipelineCreationState::kCreated;
+    // Whether the pipeline has been requested for drawing, and thus is either
+    // created or in the drawing creation queue. Command processor thread only.
+    bool needed_for_drawing = true;
+    explicit Pipeline(const PipelineLayoutProvider* pipeline_layout_provider)
         : pipeline_layout(pipeline_layout_provider) {}
   };
 
@@ -246,9 +344,16 @@ class VulkanPipelineCache {
     }
   };
 
+  VulkanShader* LoadShader(xenos::ShaderType shader_type,
+                           const uint32_t* host_address, uint32_t dword_count,
+                           uint64_t data_hash);
+
   // Can be called from multiple threads.
   bool TranslateAnalyzedShader(SpirvShaderTranslator& translator,
                                VulkanShader::VulkanTranslation& translation);
+  // Queues the shader for writing to the storage if it hasn't been written to
+  // the currently open one yet.
+  void StoreShader(Shader& shader);
 
   void WritePipelineRenderTargetDescription(
       reg::RB_BLENDCONTROL blend_control, uint32_t write_mask,
@@ -265,6 +370,15 @@ class VulkanPipelineCache {
   // Whether the pipeline for the given description is supported by the device.
   bool ArePipelineRequirementsMet(const PipelineDescription& description) const;
 
+  // Obtains the objects needed for creating the pipeline with the description
+  // from the other caches. The shaders must be translated.
+  bool GetPipelineCreationObjects(
+      const PipelineDescription& description,
+      const VulkanShader::VulkanTranslation* vertex_shader,
+      const VulkanShader::VulkanTranslation* pixel_shader,
+      const PipelineLayoutProvider*& pipeline_layout_out,
+      VkShaderModule& geometry_shader_out, VkRenderPass& render_pass_out);
+
   static bool GetGeometryShaderKey(
       PipelineGeometryShader geometry_shader_type,
       SpirvShaderTranslator::Modification vertex_shader_modification,
@@ -278,6 +392,11 @@ class VulkanPipelineCache {
   bool EnsurePipelineCreated(
       const PipelineCreationArguments& creation_arguments);
 
+  // Moves a pipeline loaded from the storage that is still waiting for its
+  // creation to the drawing queue.
+  void PrioritizePipelineCreation(
+      std::pair<const PipelineDescription, Pipeline>& pipeline);
+
   VulkanCommandProcessor& command_processor_;
   const RegisterFile& register_file_;
   VulkanRenderTargetCache& render_target_cache_;
@@ -285,9 +404,18 @@ class VulkanPipelineCache {
 
   // Temporary storage for AnalyzeUcode calls on the processor thread.
   StringBuffer ucode_disasm_buffer_;
+  // Analysis results of the shaders from the previous runs, in the local shader
+  // storage of the current title.
+  UcodeAnalysisCache ucode_analysis_cache_;
   // Reusable shader translator on the command processor thread.
   std::unique_ptr<SpirvShaderTranslator> shader_translator_;
 
+  // Optional optimization of the translated SPIR-V before creating shader
+  // modules, only if enabled and SPIRV-Tools with the optimizer is available.
+  std::unique_ptr<ui::vulkan::SpirvToolsContext> spirv_tools_context_;
+  std::unique_ptr<ui::vulkan::SpirvOptimizationCache>
+      spirv_optimization_cache_;
+
   struct LayoutUID {
     size_t uid;
     size_t vector_span_offset;
@@ -322,8 +450,83 @@ class VulkanPipelineCache {
       pipelines_;
 
   // Previously used pipeline, to avoid lookups if the state wasn't changed.
-  const std::pair<const PipelineDescription, Pipeline>* last_pipeline_ =
-      nullptr;
+  std::pair<const PipelineDescription, Pipeline>* last_pipeline_ = nullptr;
+
+  // Host driver pipeline cache, serialized to the local shader storage
+  // directory because it's specific to the device and the driver version. Only
+  // created with vulkan_shader_storage, VK_NULL_HANDLE otherwise.
+  VkPipelineCache vk_pipeline_cache_ = VK_NULL_HANDLE;
+  std::filesystem::path vk_pipeline_cache_file_path_;
+  void LoadVkPipelineCache(const std::filesystem::path& file_path);
+  void StoreVkPipelineCache();
+
+  // Currently open shader storage path.
+  std::filesystem::path shader_storage_cache_root_;
+  uint32_t shader_storage_title_id_ = 0;
+
+  // Shader storage output stream, for preload in the next emulator runs.
+  FILE* shader_storage_file_ = nullptr;
+  // For only writing shaders to the currently open storage once, incremented
+  // when switching the storage.
+  uint32_t shader_storage_index_ = 0;
+  bool shader_storage_file_flush_needed_ = false;
+
+  // Pipeline storage output stream, for preload in the next emulator runs.
+  FILE* pipeline_storage_file_ = nullptr;
+  bool pipeline_storage_file_flush_needed_ = false;
+
+  // Thread for asynchronous writing to the storage streams.
+  void StorageWriteThread();
+  std::mutex storage_write_request_lock_;
+  std::condition_variable storage_write_request_cond_;
+  // Storage thread input is protected with storage_write_request_lock_, and the
+  // thread is notified about its change via storage_write_request_cond_.
+  std::deque<const Shader*> storage_write_shader_queue_;
+  std::deque<PipelineStoredDescription> storage_write_pipeline_queue_;
+  bool storage_write_flush_shaders_ = false;
+  bool storage_write_flush_pipelines_ = false;
+  bool storage_write_thread_shutdown_ = false;
+  std::unique_ptr<xe::threading::Thread> storage_write_thread_;
+
+  // Pipeline creation threads.
+  void CreationThread(size_t thread_index);
+  void CreateQueuedPipelinesOnProcessorThread(bool include_preload);
+  // Must be called with creation_request_lock_ held.
+  bool IsPipelineCreationComplete(bool include_preload) const;
+  // Returns whether had to wait for the creation threads.
+  bool AwaitPipelineCreationCompletion(bool include_preload);
+  std::mutex creation_request_lock_;
+  std::condition_variable creation_request_cond_;
+  // Pipelines needed for drawing in the current submission, taken by the
+  // creation threads before the ones in creation_preload_queue_. Protected with
+  // creation_request_lock_, notify_one creation_request_cond_ when set.
+  std::deque<PipelineCreationArguments> creation_queue_;
+  // Pipelines loaded from the storage with non-blocking shader storage
+  // initialization. Protected with creation_request_lock_, notify_one
+  // creation_request_cond_ when set.
+  std::deque<PipelineCreationArguments> creation_preload_queue_;
+  // Number of threads that are currently creating a pipeline - incremented when
+  // a pipeline is dequeued (the completion event can't be triggered before this
+  // is zero), and how many of them are creating pipelines needed for drawing.
+  // Protected with creation_request_lock_.
+  size_t creation_threads_busy_ = 0;
+  size_t creation_threads_busy_for_drawing_ = 0;
+  // Manual-reset event set when there are no more pipelines to create in the
+  // drawing queue, and in the preload queue too if requested. This is
+  // triggered by the thread creating the last pipeline.
+  std::unique_ptr<xe::threading::Event> creation_completion_event_;
+  // Whether setting the event on completion is queued. Protected with
+  // creation_request_lock_, notify_one creation_request_cond_ when set.
+  bool creation_completion_set_event_ = false;
+  bool creation_completion_include_preload_ = false;
+  // Creation threads with this index or above need to be shut down as soon as
+  // possible. Protected with creation_request_lock_, notify_all
+  // creation_request_cond_ when set.
+  size_t creation_threads_shutdown_from_ = SIZE_MAX;
+  std::vector<std::unique_ptr<xe::threading::Thread>> creation_threads_;
+
+  PipelineCreationStatistics pipeline_creation_frame_statistics_;
+  PipelineCreationStatistics last_frame_pipeline_creation_statistics_;
 };
 
 }  // namespace vulkan
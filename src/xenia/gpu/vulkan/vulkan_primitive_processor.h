@@ -36,7 +36,10 @@ class VulkanPrimitiveProcessor final : public PrimitiveProcessor {
 
   bool Initialize();
   void Shutdown(bool from_destructor = false);
-  void ClearCache() { frame_index_buffer_pool_->ClearCache(); }
+  void ClearCache() {
+    frame_index_buffer_pool_->ClearCache();
+    ClearPersistentCache();
+  }
 
   void CompletedSubmissionUpdated();
   void BeginSubmission();
@@ -40,9 +40,15 @@ VkShaderModule VulkanShader::VulkanTranslation::GetOrCreateShaderModule() {
   shader_module_create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
   shader_module_create_info.pNext = nullptr;
   shader_module_create_info.flags = 0;
-  shader_module_create_info.codeSize = translated_binary().size();
-  shader_module_create_info.pCode =
-      reinterpret_cast<const uint32_t*>(translated_binary().data());
+  if (!optimized_spirv_.empty()) {
+    shader_module_create_info.codeSize =
+        sizeof(uint32_t) * optimized_spirv_.size();
+    shader_module_create_info.pCode = optimized_spirv_.data();
+  } else {
+    shader_module_create_info.codeSize = translated_binary().size();
+    shader_module_create_info.pCode =
+        reinterpret_cast<const uint32_t*>(translated_binary().data());
+  }
   if (provider.dfn().vkCreateShaderModule(provider.device(),
                                           &shader_module_create_info, nullptr,
                                           &shader_module_) != VK_SUCCESS) {
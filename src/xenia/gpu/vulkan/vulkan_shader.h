@@ -11,6 +11,8 @@
 #define XENIA_GPU_VULKAN_VULKAN_SHADER_H_
 
 #include <cstdint>
+#include <utility>
+#include <vector>
 
 #include "xenia/gpu/spirv_shader.h"
 #include "xenia/gpu/xenos.h"
@@ -28,10 +30,19 @@ class VulkanShader : public SpirvShader {
         : SpirvTranslation(shader, modification) {}
     ~VulkanTranslation() override;
 
+    // If set before the module is created, the optimized SPIR-V is used
+    // instead of the translated binary (which is kept as is for storage and
+    // dumping).
+    void SetOptimizedSpirv(std::vector<uint32_t>&& optimized_spirv) {
+      optimized_spirv_ = std::move(optimized_spirv);
+    }
+    bool has_optimized_spirv() const { return !optimized_spirv_.empty(); }
+
     VkShaderModule GetOrCreateShaderModule();
     VkShaderModule shader_module() const { return shader_module_; }
 
    private:
+    std::vector<uint32_t> optimized_spirv_;
     VkShaderModule shader_module_ = VK_NULL_HANDLE;
   };
 
@@ -14,3 +14,9 @@ DEFINE_bool(headless, false,
             "UI");
 DEFINE_bool(log_high_frequency_kernel_calls, false,
             "Log kernel calls with the kHighFrequency tag.", "Kernel");
+DEFINE_bool(async_file_io, false,
+            "Execute overlapped NtReadFile / NtWriteFile requests on host I/O "
+            "worker threads instead of the calling guest thread.",
+            "Kernel");
+DEFINE_uint32(async_file_io_threads, 2,
+              "Number of host I/O worker threads for async_file_io.", "Kernel");
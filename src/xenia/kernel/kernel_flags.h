@@ -13,5 +13,7 @@
 
 DECLARE_bool(headless);
 DECLARE_bool(log_high_frequency_kernel_calls);
+DECLARE_bool(async_file_io);
+DECLARE_uint32(async_file_io_threads);
 
 #endif  // XENIA_KERNEL_KERNEL_FLAGS_H_
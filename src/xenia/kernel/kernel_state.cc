@@ -19,6 +19,7 @@
 #include "xenia/cpu/processor.h"
 #include "xenia/emulator.h"
 #include "xenia/hid/input_system.h"
+#include "xenia/kernel/kernel_flags.h"
 #include "xenia/kernel/user_module.h"
 #include "xenia/kernel/util/shim_utils.h"
 #include "xenia/kernel/xam/xam_module.h"
@@ -79,13 +80,28 @@ KernelState::KernelState(Emulator* emulator)
       kMemoryProtectRead | kMemoryProtectWrite);
 
   xenia_assert(fixed_alloc_worked);
+
+  if (cvars::async_file_io) {
+    file_io_pool_ =
+        std::make_unique<vfs::IoWorkerPool>(cvars::async_file_io_threads);
+  }
 }
 
 KernelState::~KernelState() {
   SetExecutableModule(nullptr);
 
+  // Finish the pending I/O before stopping the dispatch thread - the
+  // completions are queued for it, and it runs everything still in its queue
+  // before exiting.
+  file_io_pool_.reset();
+
   if (dispatch_thread_running_) {
-    dispatch_thread_running_ = false;
+    {
+      // Under the lock so the thread doesn't miss the notification between
+      // checking the flag and waiting.
+      auto global_lock = global_critical_region_.Acquire();
+      dispatch_thread_running_ = false;
+    }
     dispatch_cond_.notify_all();
     dispatch_thread_->Wait(0, 0, 0, nullptr);
   }
@@ -410,14 +426,16 @@ void KernelState::SetExecutableModule(object_ref<UserModule> module) {
           dispatch_thread_->set_can_debugger_suspend(true);
 
           auto global_lock = global_critical_region_.AcquireDeferred();
-          while (dispatch_thread_running_) {
+          while (true) {
             global_lock.lock();
-            if (dispatch_queue_.empty()) {
+            while (dispatch_queue_.empty() && dispatch_thread_running_) {
               dispatch_cond_.wait(global_lock);
-              if (!dispatch_thread_running_) {
-                global_lock.unlock();
-                break;
-              }
+            }
+            // When stopped, drain the queue before exiting, so callbacks
+            // enqueued during shutdown (such as I/O completions) still run.
+            if (dispatch_queue_.empty()) {
+              global_lock.unlock();
+              break;
             }
             auto fn = std::move(dispatch_queue_.front());
             dispatch_queue_.pop_front();
@@ -892,6 +910,12 @@ void KernelState::BroadcastNotification(XNotificationID id, uint32_t data) {
   }
 }
 
+void KernelState::EnqueueDispatch(std::function<void()> callback) {
+  auto global_lock = global_critical_region_.Acquire();
+  dispatch_queue_.push_back(std::move(callback));
+  dispatch_cond_.notify_all();
+}
+
 void KernelState::CompleteOverlapped(uint32_t overlapped_ptr, X_RESULT result) {
   CompleteOverlappedEx(overlapped_ptr, result, result, 0);
 }
@@ -34,6 +34,7 @@
 #include "xenia/kernel/xam/xam_state.h"
 #include "xenia/kernel/xevent.h"
 #include "xenia/memory.h"
+#include "xenia/vfs/io_worker_pool.h"
 #include "xenia/vfs/virtual_file_system.h"
 #include "xenia/xbox.h"
 
@@ -273,6 +274,14 @@ class KernelState {
 
   util::NativeList* dpc_list() { return &dpc_list_; }
 
+  // Runs the callback on the kernel dispatch thread, which has a guest
+  // context, so it can be used to queue APCs from host threads.
+  void EnqueueDispatch(std::function<void()> callback);
+
+  // Host I/O worker pool for overlapped file I/O, or nullptr if async_file_io
+  // is disabled.
+  vfs::IoWorkerPool* file_io_pool() const { return file_io_pool_.get(); }
+
   void CompleteOverlapped(uint32_t overlapped_ptr, X_RESULT result);
   void CompleteOverlappedEx(uint32_t overlapped_ptr, X_RESULT result,
                             uint32_t extended_error, uint32_t length);
@@ -370,6 +379,8 @@ class KernelState {
   std::condition_variable_any dispatch_cond_;
   std::list<std::function<void()>> dispatch_queue_;
 
+  std::unique_ptr<vfs::IoWorkerPool> file_io_pool_;
+
   BitMap tls_bitmap_;
   uint32_t ke_timestamp_bundle_ptr_ = 0;
   std::unique_ptr<xe::threading::HighResolutionTimer> timestamp_timer_;
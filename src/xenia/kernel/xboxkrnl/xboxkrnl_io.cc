@@ -125,6 +125,45 @@ dword_result_t NtOpenFile_entry(
 }
 DECLARE_XBOXKRNL_EXPORT1(NtOpenFile, kFileSystem, kImplemented);
 
+// Overlapped requests are executed on the host I/O worker pool when it's
+// enabled. The file position is only maintained for synchronous file objects,
+// so an explicit byte offset is required.
+static bool ShouldCompleteAsync(const XFile* file, lpqword_t byte_offset_ptr) {
+  if (!kernel_state()->file_io_pool() || file->is_synchronous() ||
+      !byte_offset_ptr) {
+    return false;
+  }
+  uint64_t byte_offset = *byte_offset_ptr;
+  return byte_offset != uint64_t(-1) && byte_offset != uint64_t(-2);
+}
+
+// Completion of an asynchronous NtReadFile / NtWriteFile, called on the kernel
+// dispatch thread: writes the I/O status block, signals the event and queues
+// the APC to the thread that issued the request.
+static XFile::AsyncCompletionCallback MakeAsyncIoCompletion(
+    object_ref<XEvent> ev, uint32_t io_status_block_ptr, uint32_t apc_routine,
+    uint32_t apc_context) {
+  return [ev = std::move(ev), io_status_block_ptr, apc_routine, apc_context,
+          thread = retain_object(XThread::GetCurrentThread())](
+             X_STATUS result, uint32_t bytes_transferred) {
+    if (io_status_block_ptr) {
+      auto io_status_block =
+          kernel_memory()->TranslateVirtual<X_IO_STATUS_BLOCK*>(
+              io_status_block_ptr);
+      io_status_block->status = result;
+      io_status_block->information = bytes_transferred;
+    }
+    if (ev) {
+      ev->Set(0, false);
+    }
+    // Low bit probably means do not queue to IO ports.
+    if ((apc_routine & ~1u) && apc_context && thread) {
+      thread->EnqueueApc(apc_routine & ~1u, apc_context, io_status_block_ptr,
+                         0);
+    }
+  };
+}
+
 dword_result_t NtReadFile_entry(dword_t file_handle, dword_t event_handle,
                                 lpvoid_t apc_routine_ptr, lpvoid_t apc_context,
                                 pointer_t<X_IO_STATUS_BLOCK> io_status_block,
@@ -143,7 +182,21 @@ dword_result_t NtReadFile_entry(dword_t file_handle, dword_t event_handle,
     result = X_STATUS_INVALID_HANDLE;
   }
 
-  if (XSUCCEEDED(result)) {
+  if (XSUCCEEDED(result) && ShouldCompleteAsync(file.get(), byte_offset_ptr)) {
+    if (ev) {
+      ev->Reset();
+    }
+    if (io_status_block) {
+      io_status_block->status = X_STATUS_PENDING;
+      io_status_block->information = 0;
+    }
+    result = file->ReadAsync(
+        buffer.guest_address(), buffer_length,
+        static_cast<uint64_t>(*byte_offset_ptr), apc_context,
+        MakeAsyncIoCompletion(ev, io_status_block.guest_address(),
+                              static_cast<uint32_t>(apc_routine_ptr),
+                              apc_context));
+  } else if (XSUCCEEDED(result)) {
     if (true || file->is_synchronous()) {
       // Synchronous.
       uint32_t bytes_read = 0;
@@ -316,8 +369,21 @@ dword_result_t NtWriteFile_entry(dword_t file_handle, dword_t event_handle,
   }
 
   // Execute write.
-  if (XSUCCEEDED(result)) {
-    // TODO(benvanik): async path.
+  if (XSUCCEEDED(result) && ShouldCompleteAsync(file.get(), byte_offset_ptr)) {
+    if (ev) {
+      ev->Reset();
+    }
+    if (io_status_block) {
+      io_status_block->status = X_STATUS_PENDING;
+      io_status_block->information = 0;
+    }
+    result = file->WriteAsync(
+        buffer.guest_address(), buffer_length,
+        static_cast<uint64_t>(*byte_offset_ptr), apc_context,
+        MakeAsyncIoCompletion(ev, io_status_block.guest_address(),
+                              static_cast<uint32_t>(apc_routine),
+                              apc_context));
+  } else if (XSUCCEEDED(result)) {
     if (true || file->is_synchronous()) {
       // Synchronous request.
       uint32_t bytes_written = 0;
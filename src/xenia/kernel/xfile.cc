@@ -93,6 +93,53 @@ X_STATUS XFile::QueryDirectory(X_FILE_DIRECTORY_INFORMATION* out_info,
   return X_STATUS_SUCCESS;
 }
 
+X_STATUS XFile::TranslateReadBuffer(uint32_t buffer_guest_address,
+                                    uint32_t buffer_length,
+                                    uint8_t** host_buffer_out,
+                                    xe::PhysicalHeap** physical_heap_out) {
+  if (UINT32_MAX - buffer_guest_address < buffer_length) {
+    return X_STATUS_ACCESS_VIOLATION;
+  }
+  // Games often read directly to texture/vertex buffer memory - in this case,
+  // invalidation notifications must be sent. However, having any memory
+  // callbacks in the range will result in STATUS_ACCESS_VIOLATION at least on
+  // Windows, without anything being read or any callbacks being triggered. So
+  // for physical memory, host protection must be bypassed, and invalidation
+  // callbacks must be triggered manually (it's also wrong to trigger
+  // invalidation callbacks before reading in this case, because during the
+  // read, the guest may still access the data around the buffer that is
+  // located in the same host pages as the buffer's start and end, on the GPU -
+  // and that must not trigger a race condition).
+  uint32_t buffer_guest_high_address = buffer_guest_address + buffer_length - 1;
+  xe::BaseHeap* buffer_start_heap = memory()->LookupHeap(buffer_guest_address);
+  const xe::BaseHeap* buffer_end_heap =
+      memory()->LookupHeap(buffer_guest_high_address);
+  if (!buffer_start_heap || !buffer_end_heap ||
+      (buffer_start_heap->heap_type() == HeapType::kGuestPhysical) !=
+          (buffer_end_heap->heap_type() == HeapType::kGuestPhysical) ||
+      (buffer_start_heap->heap_type() == HeapType::kGuestPhysical &&
+       buffer_start_heap != buffer_end_heap)) {
+    return X_STATUS_ACCESS_VIOLATION;
+  }
+  xe::PhysicalHeap* buffer_physical_heap =
+      buffer_start_heap->heap_type() == HeapType::kGuestPhysical
+          ? static_cast<xe::PhysicalHeap*>(buffer_start_heap)
+          : nullptr;
+  if (buffer_physical_heap &&
+      buffer_physical_heap->QueryRangeAccess(buffer_guest_address,
+                                             buffer_guest_high_address) !=
+          memory::PageAccess::kReadWrite) {
+    return X_STATUS_ACCESS_VIOLATION;
+  }
+  *host_buffer_out =
+      buffer_physical_heap
+          ? memory()->TranslatePhysical(
+                buffer_physical_heap->GetPhysicalAddress(buffer_guest_address))
+          : memory()->TranslateVirtual(buffer_guest_address);
+  *physical_heap_out = buffer_physical_heap;
+  return X_STATUS_SUCCESS;
+}
+
 X_STATUS XFile::Read(uint32_t buffer_guest_address, uint32_t buffer_length,
                      uint64_t byte_offset, uint32_t* out_bytes_read,
                      uint32_t apc_context, bool notify_completion) {
@@ -106,58 +153,20 @@ X_STATUS XFile::Read(uint32_t buffer_guest_address, uint32_t buffer_length,
   // Zero length means success for a valid file object according to Windows
   // tests.
   if (buffer_length) {
-    if (UINT32_MAX - buffer_guest_address < buffer_length) {
-      result = X_STATUS_ACCESS_VIOLATION;
-    } else {
-      // Games often read directly to texture/vertex buffer memory - in this
-      // case, invalidation notifications must be sent. However, having any
-      // memory callbacks in the range will result in STATUS_ACCESS_VIOLATION at
-      // least on Windows, without anything being read or any callbacks being
-      // triggered. So for physical memory, host protection must be bypassed,
-      // and invalidation callbacks must be triggered manually (it's also wrong
-      // to trigger invalidation callbacks before reading in this case, because
-      // during the read, the guest may still access the data around the buffer
-      // that is located in the same host pages as the buffer's start and end,
-      // on the GPU - and that must not trigger a race condition).
-      uint32_t buffer_guest_high_address =
-          buffer_guest_address + buffer_length - 1;
-      xe::BaseHeap* buffer_start_heap =
-          memory()->LookupHeap(buffer_guest_address);
-      const xe::BaseHeap* buffer_end_heap =
-          memory()->LookupHeap(buffer_guest_high_address);
-      if (!buffer_start_heap || !buffer_end_heap ||
-          (buffer_start_heap->heap_type() == HeapType::kGuestPhysical) !=
-              (buffer_end_heap->heap_type() == HeapType::kGuestPhysical) ||
-          (buffer_start_heap->heap_type() == HeapType::kGuestPhysical &&
-           buffer_start_heap != buffer_end_heap)) {
-        result = X_STATUS_ACCESS_VIOLATION;
-      } else {
-        xe::PhysicalHeap* buffer_physical_heap =
-            buffer_start_heap->heap_type() == HeapType::kGuestPhysical
-                ? static_cast<xe::PhysicalHeap*>(buffer_start_heap)
-                : nullptr;
-        if (buffer_physical_heap &&
-            buffer_physical_heap->QueryRangeAccess(buffer_guest_address,
-                                                   buffer_guest_high_address) !=
-                memory::PageAccess::kReadWrite) {
-          result = X_STATUS_ACCESS_VIOLATION;
-        } else {
-          result = file_->ReadSync(
-              buffer_physical_heap
-                  ? memory()->TranslatePhysical(
-                        buffer_physical_heap->GetPhysicalAddress(
-                            buffer_guest_address))
-                  : memory()->TranslateVirtual(buffer_guest_address),
-              buffer_length, size_t(byte_offset), &bytes_read);
-          if (XSUCCEEDED(result)) {
-            if (buffer_physical_heap) {
-              buffer_physical_heap->TriggerCallbacks(
-                  xe::global_critical_region::AcquireDirect(),
-                  buffer_guest_address, buffer_length, true, true);
-            }
-            position_ += bytes_read;
-          }
+    uint8_t* host_buffer;
+    xe::PhysicalHeap* buffer_physical_heap;
+    result = TranslateReadBuffer(buffer_guest_address, buffer_length,
+                                 &host_buffer, &buffer_physical_heap);
+    if (XSUCCEEDED(result)) {
+      result = file_->ReadSync(host_buffer, buffer_length, size_t(byte_offset),
+                               &bytes_read);
+      if (XSUCCEEDED(result)) {
+        if (buffer_physical_heap) {
+          buffer_physical_heap->TriggerCallbacks(
+              xe::global_critical_region::AcquireDirect(), buffer_guest_address,
+              buffer_length, true, true);
         }
+        position_ += bytes_read;
       }
     }
   }
@@ -267,6 +276,97 @@ X_STATUS XFile::Write(uint32_t buffer_guest_address, uint32_t buffer_length,
   return result;
 }
 
+X_STATUS XFile::ReadAsync(uint32_t buffer_guest_address,
+                          uint32_t buffer_length, uint64_t byte_offset,
+                          uint32_t apc_context,
+                          AsyncCompletionCallback completion) {
+  vfs::IoWorkerPool* io_pool = kernel_state()->file_io_pool();
+  assert_not_null(io_pool);
+
+  uint8_t* host_buffer = nullptr;
+  xe::PhysicalHeap* buffer_physical_heap = nullptr;
+  if (buffer_length) {
+    X_STATUS result = TranslateReadBuffer(buffer_guest_address, buffer_length,
+                                          &host_buffer, &buffer_physical_heap);
+    if (XFAILED(result)) {
+      return result;
+    }
+  }
+
+  // The file object is signaled when the I/O completes.
+  async_event_->Reset();
+
+  vfs::IoWorkerPool::Request request;
+  request.operation = vfs::IoWorkerPool::Operation::kRead;
+  request.file = file_;
+  request.buffer = host_buffer;
+  request.length = buffer_length;
+  request.offset = size_t(byte_offset);
+  request.completion = [file = retain_object(this), buffer_guest_address,
+                        buffer_length, buffer_physical_heap, apc_context,
+                        completion = std::move(completion)](
+                           X_STATUS result, size_t bytes_read) {
+    if (XSUCCEEDED(result) && buffer_physical_heap) {
+      buffer_physical_heap->TriggerCallbacks(
+          xe::global_critical_region::AcquireDirect(), buffer_guest_address,
+          buffer_length, true, true);
+    }
+    file->CompleteAsync(result, uint32_t(bytes_read), apc_context, completion);
+  };
+  io_pool->Submit(std::move(request));
+  return X_STATUS_PENDING;
+}
+
+X_STATUS XFile::WriteAsync(uint32_t buffer_guest_address,
+                           uint32_t buffer_length, uint64_t byte_offset,
+                           uint32_t apc_context,
+                           AsyncCompletionCallback completion) {
+  vfs::IoWorkerPool* io_pool = kernel_state()->file_io_pool();
+  assert_not_null(io_pool);
+
+  async_event_->Reset();
+
+  vfs::IoWorkerPool::Request request;
+  request.operation = vfs::IoWorkerPool::Operation::kWrite;
+  request.file = file_;
+  request.buffer = memory()->TranslateVirtual(buffer_guest_address);
+  request.length = buffer_length;
+  request.offset = size_t(byte_offset);
+  request.completion = [file = retain_object(this), apc_context,
+                        completion = std::move(completion)](
+                           X_STATUS result, size_t bytes_written) {
+    file->CompleteAsync(result, uint32_t(bytes_written), apc_context,
+                        completion);
+  };
+  io_pool->Submit(std::move(request));
+  return X_STATUS_PENDING;
+}
+
+void XFile::CompleteAsync(X_STATUS result, uint32_t bytes_transferred,
+                          uint32_t apc_context,
+                          const AsyncCompletionCallback& completion) {
+  // APCs can only be queued from a thread with a guest context, so the
+  // notification is done on the kernel dispatch thread rather than on the host
+  // I/O worker.
+  kernel_state()->EnqueueDispatch([file = retain_object(this), result,
+                                   bytes_transferred, apc_context,
+                                   completion]() {
+    // The status block must be written before anything waiting for the
+    // completion is woken up.
+    if (completion) {
+      completion(result, bytes_transferred);
+    }
+
+    XIOCompletion::IONotification notify;
+    notify.apc_context = apc_context;
+    notify.num_bytes = bytes_transferred;
+    notify.status = result;
+    file->NotifyIOCompletionPorts(notify);
+
+    file->async_event_->Set();
+  });
+}
+
 X_STATUS XFile::SetLength(size_t length) { return file_->SetLength(length); }
 X_STATUS XFile::Rename(const std::filesystem::path file_path) {
   entry()->Rename(file_path);
@@ -10,6 +10,7 @@
 #ifndef XENIA_KERNEL_XFILE_H_
 #define XENIA_KERNEL_XFILE_H_
 
+#include <functional>
 #include <string>
 
 #include "xenia/kernel/xevent.h"
@@ -165,6 +166,21 @@ class XFile : public XObject {
                  uint64_t byte_offset, uint32_t* out_bytes_written,
                  uint32_t apc_context);
 
+  // Called on the kernel dispatch thread after the file object and its
+  // completion ports have been signaled.
+  using AsyncCompletionCallback =
+      std::function<void(X_STATUS result, uint32_t bytes_transferred)>;
+
+  // Overlapped I/O through the kernel's host I/O worker pool. Returns
+  // X_STATUS_PENDING if the request has been submitted, or the error if it
+  // can't be started, in which case the callback is not called.
+  X_STATUS ReadAsync(uint32_t buffer_guest_address, uint32_t buffer_length,
+                     uint64_t byte_offset, uint32_t apc_context,
+                     AsyncCompletionCallback completion);
+  X_STATUS WriteAsync(uint32_t buffer_guest_address, uint32_t buffer_length,
+                      uint64_t byte_offset, uint32_t apc_context,
+                      AsyncCompletionCallback completion);
+
   X_STATUS SetLength(size_t length);
   X_STATUS Rename(const std::filesystem::path file_path);
 
@@ -180,6 +196,17 @@ class XFile : public XObject {
  protected:
   void NotifyIOCompletionPorts(XIOCompletion::IONotification& notification);
 
+  // Validates the guest buffer a read will be done to, returning where to
+  // write the data, and the physical heap if invalidation callbacks must be
+  // triggered manually after writing.
+  X_STATUS TranslateReadBuffer(uint32_t buffer_guest_address,
+                               uint32_t buffer_length,
+                               uint8_t** host_buffer_out,
+                               xe::PhysicalHeap** physical_heap_out);
+  void CompleteAsync(X_STATUS result, uint32_t bytes_transferred,
+                     uint32_t apc_context,
+                     const AsyncCompletionCallback& completion);
+
   xe::threading::WaitHandle* GetWaitHandle() override {
     return async_event_.get();
   }
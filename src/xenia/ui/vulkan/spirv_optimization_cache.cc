@@ -0,0 +1,152 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/ui/vulkan/spirv_optimization_cache.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/string.h"
+#include "xenia/base/xxhash.h"
+
+namespace xe {
+namespace ui {
+namespace vulkan {
+
+bool SpirvOptimizationCache::Open(const std::filesystem::path& path) {
+  Close();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  FILE* file = xe::filesystem::OpenFile(path, "a+b");
+  if (!file) {
+    XELOGE("Failed to open the SPIR-V optimization cache file for writing: {}",
+           xe::path_to_utf8(path));
+    return false;
+  }
+
+  FileHeader header;
+  uint64_t valid_bytes = 0;
+  if (fread(&header, sizeof(header), 1, file) &&
+      header.magic == kFileMagic && header.version == kVersion &&
+      header.target_env == uint32_t(spirv_tools_context_.target_env())) {
+    valid_bytes = sizeof(header);
+    // For validating the sizes in the entry headers before allocating the
+    // memory for the entries.
+    xe::filesystem::Seek(file, 0, SEEK_END);
+    int64_t file_told_end = xe::filesystem::Tell(file);
+    uint64_t file_size = uint64_t(std::max(file_told_end, int64_t(0)));
+    xe::filesystem::Seek(file, int64_t(valid_bytes), SEEK_SET);
+    FileEntryHeader entry_header;
+    std::vector<uint32_t> optimized;
+    size_t entries_loaded = 0;
+    while (fread(&entry_header, sizeof(entry_header), 1, file)) {
+      uint64_t entry_data_offset = valid_bytes + sizeof(entry_header);
+      if (entry_data_offset > file_size ||
+          entry_header.optimized_word_count >
+              (file_size - entry_data_offset) / sizeof(uint32_t)) {
+        break;
+      }
+      optimized.resize(entry_header.optimized_word_count);
+      size_t optimized_bytes = sizeof(uint32_t) * optimized.size();
+      if (optimized_bytes &&
+          !fread(optimized.data(), optimized_bytes, 1, file)) {
+        break;
+      }
+      if (XXH3_64bits(optimized.data(), optimized_bytes) !=
+          entry_header.optimized_hash) {
+        break;
+      }
+      valid_bytes += sizeof(entry_header) + optimized_bytes;
+      Entry& entry = entries_[entry_header.source_hash];
+      entry.source_word_count = entry_header.source_word_count;
+      entry.optimized = std::move(optimized);
+      ++entries_loaded;
+    }
+    XELOGI("Loaded {} optimized SPIR-V modules from the cache",
+           entries_loaded);
+  }
+  if (valid_bytes) {
+    // Drop the incompletely written entry in the end, if any.
+    xe::filesystem::TruncateStdioFile(file, valid_bytes);
+  } else {
+    xe::filesystem::TruncateStdioFile(file, 0);
+    header.magic = kFileMagic;
+    header.version = kVersion;
+    header.target_env = uint32_t(spirv_tools_context_.target_env());
+    header.reserved = 0;
+    fwrite(&header, sizeof(header), 1, file);
+  }
+  file_ = file;
+  return true;
+}
+
+void SpirvOptimizationCache::Close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (file_) {
+    fclose(file_);
+    file_ = nullptr;
+  }
+}
+
+bool SpirvOptimizationCache::GetOptimized(const uint32_t* words,
+                                          size_t word_count,
+                                          std::vector<uint32_t>& optimized_out,
+                                          bool* was_cached_out) {
+  uint64_t source_hash = XXH3_64bits(words, sizeof(uint32_t) * word_count);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(source_hash);
+    if (it != entries_.end() && it->second.source_word_count == word_count) {
+      optimized_out = it->second.optimized;
+      if (was_cached_out) {
+        *was_cached_out = true;
+      }
+      return !optimized_out.empty();
+    }
+  }
+  if (was_cached_out) {
+    *was_cached_out = false;
+  }
+
+  // Optimize without holding the lock, other threads may be optimizing other
+  // modules. If multiple threads optimize the same module simultaneously, the
+  // results are identical.
+  if (spirv_tools_context_.Optimize(words, word_count, optimized_out) !=
+      SPV_SUCCESS) {
+    optimized_out.clear();
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto emplace_result = entries_.try_emplace(source_hash);
+  Entry& entry = emplace_result.first->second;
+  entry.source_word_count = uint32_t(word_count);
+  entry.optimized = optimized_out;
+  if (file_ && emplace_result.second) {
+    FileEntryHeader entry_header;
+    entry_header.source_hash = source_hash;
+    entry_header.source_word_count = uint32_t(word_count);
+    entry_header.optimized_word_count = uint32_t(optimized_out.size());
+    entry_header.optimized_hash = XXH3_64bits(
+        optimized_out.data(), sizeof(uint32_t) * optimized_out.size());
+    fwrite(&entry_header, sizeof(entry_header), 1, file_);
+    if (!optimized_out.empty()) {
+      fwrite(optimized_out.data(), sizeof(uint32_t), optimized_out.size(),
+             file_);
+    }
+    fflush(file_);
+  }
+  return !optimized_out.empty();
+}
+
+}  // namespace vulkan
+}  // namespace ui
+}  // namespace xe
@@ -0,0 +1,94 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_UI_VULKAN_SPIRV_OPTIMIZATION_CACHE_H_
+#define XENIA_UI_VULKAN_SPIRV_OPTIMIZATION_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "xenia/base/hash.h"
+#include "xenia/ui/vulkan/spirv_tools_context.h"
+
+namespace xe {
+namespace ui {
+namespace vulkan {
+
+// Optimized SPIR-V modules keyed by the hash of the unoptimized module, so the
+// optimization cost is only paid once for every distinct translation, with
+// optional persistence across runs in a file.
+class SpirvOptimizationCache {
+ public:
+  // Update when changing the optimization passes or the file format.
+  static constexpr uint32_t kVersion = 0x20241019;
+
+  explicit SpirvOptimizationCache(const SpirvToolsContext& spirv_tools_context)
+      : spirv_tools_context_(spirv_tools_context) {}
+  SpirvOptimizationCache(const SpirvOptimizationCache& cache) = delete;
+  SpirvOptimizationCache& operator=(const SpirvOptimizationCache& cache) =
+      delete;
+  ~SpirvOptimizationCache() { Close(); }
+
+  // Loads the modules optimized in the previous runs from the file, and appends
+  // the newly optimized ones to it. Without a file open, the cache is kept only
+  // in memory.
+  bool Open(const std::filesystem::path& path);
+  // Closes the file, keeping the cached modules in memory.
+  void Close();
+
+  // Returns the optimized version of the module, optimizing it if it's not in
+  // the cache yet. Returns false if the optimization has failed (the failure is
+  // cached too). Can be called from multiple threads.
+  bool GetOptimized(const uint32_t* words, size_t word_count,
+                    std::vector<uint32_t>& optimized_out,
+                    bool* was_cached_out = nullptr);
+
+ private:
+  struct FileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t target_env;
+    uint32_t reserved;
+  };
+  // Followed by optimized_word_count words.
+  struct FileEntryHeader {
+    uint64_t source_hash;
+    uint32_t source_word_count;
+    // 0 if the optimization has failed.
+    uint32_t optimized_word_count;
+    uint64_t optimized_hash;
+  };
+  // 'XESO'.
+  static constexpr uint32_t kFileMagic = 0x4F534558;
+
+  struct Entry {
+    uint32_t source_word_count;
+    // Empty if the optimization has failed.
+    std::vector<uint32_t> optimized;
+  };
+
+  const SpirvToolsContext& spirv_tools_context_;
+
+  std::mutex mutex_;
+  // Protected with mutex_.
+  std::unordered_map<uint64_t, Entry, xe::hash::IdentityHasher<uint64_t>>
+      entries_;
+  FILE* file_ = nullptr;
+};
+
+}  // namespace vulkan
+}  // namespace ui
+}  // namespace xe
+
+#endif  // XENIA_UI_VULKAN_SPIRV_OPTIMIZATION_CACHE_H_
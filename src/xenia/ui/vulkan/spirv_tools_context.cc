@@ -12,6 +12,7 @@
 #include <cstdlib>
 #include <filesystem>
 #include <string>
+#include <vector>
 
 #include "xenia/base/logging.h"
 #include "xenia/base/platform.h"
@@ -26,6 +27,27 @@ namespace xe {
 namespace ui {
 namespace vulkan {
 
+// Update SpirvOptimizationCache::kVersion when changing the passes.
+static const char* const kOptimizationPassFlags[] = {
+    // Control flow simplification.
+    "--eliminate-dead-branches",
+    "--merge-blocks",
+    // Scalar replacement of composite variables, and promotion of variables to
+    // SSA values for the passes below.
+    "--scalar-replacement=100",
+    "--ssa-rewrite",
+    // Constant folding and propagation.
+    "--ccp",
+    "--simplify-instructions",
+    "--redundancy-elimination",
+    // Cleanup of the code and the control flow made unneeded by the passes
+    // above.
+    "--eliminate-dead-branches",
+    "--merge-blocks",
+    "--eliminate-dead-code-aggressive",
+    "--cfg-cleanup",
+};
+
 bool SpirvToolsContext::Initialize(unsigned int spirv_version) {
   const char* vulkan_sdk_env = std::getenv("VULKAN_SDK");
   if (!vulkan_sdk_env) {
@@ -63,17 +85,34 @@ bool SpirvToolsContext::Initialize(unsigned int spirv_version) {
     Shutdown();
     return false;
   }
-  spv_target_env target_env;
+  optimizer_available_ =
+      LoadLibraryFunction(fn_spvOptimizerCreate_, "spvOptimizerCreate") &&
+      LoadLibraryFunction(fn_spvOptimizerDestroy_, "spvOptimizerDestroy") &&
+      LoadLibraryFunction(fn_spvOptimizerRegisterPassFromFlag_,
+                          "spvOptimizerRegisterPassFromFlag") &&
+      LoadLibraryFunction(fn_spvOptimizerOptionsCreate_,
+                          "spvOptimizerOptionsCreate") &&
+      LoadLibraryFunction(fn_spvOptimizerOptionsDestroy_,
+                          "spvOptimizerOptionsDestroy") &&
+      LoadLibraryFunction(fn_spvOptimizerOptionsSetRunValidator_,
+                          "spvOptimizerOptionsSetRunValidator") &&
+      LoadLibraryFunction(fn_spvOptimizerRun_, "spvOptimizerRun") &&
+      LoadLibraryFunction(fn_spvBinaryDestroy_, "spvBinaryDestroy");
+  if (!optimizer_available_) {
+    XELOGW(
+        "SPIRV-Tools: The optimizer is not available in the loaded library "
+        "version");
+  }
   if (spirv_version >= 0x10500) {
-    target_env = SPV_ENV_VULKAN_1_2;
+    target_env_ = SPV_ENV_VULKAN_1_2;
   } else if (spirv_version >= 0x10400) {
-    target_env = SPV_ENV_VULKAN_1_1_SPIRV_1_4;
+    target_env_ = SPV_ENV_VULKAN_1_1_SPIRV_1_4;
   } else if (spirv_version >= 0x10300) {
-    target_env = SPV_ENV_VULKAN_1_1;
+    target_env_ = SPV_ENV_VULKAN_1_1;
   } else {
-    target_env = SPV_ENV_VULKAN_1_0;
+    target_env_ = SPV_ENV_VULKAN_1_0;
   }
-  context_ = fn_spvContextCreate_(target_env);
+  context_ = fn_spvContextCreate_(target_env_);
   if (!context_) {
     XELOGE("SPIRV-Tools: Failed to create a Vulkan 1.0 context");
     Shutdown();
@@ -87,6 +126,7 @@ void SpirvToolsContext::Shutdown() {
     fn_spvContextDestroy_(context_);
     context_ = nullptr;
   }
+  optimizer_available_ = false;
   if (library_) {
 #if XE_PLATFORM_LINUX
     dlclose(library_);
@@ -118,6 +158,46 @@ spv_result_t SpirvToolsContext::Validate(const uint32_t* words,
   return result;
 }
 
+spv_result_t SpirvToolsContext::Optimize(
+    const uint32_t* words, size_t num_words,
+    std::vector<uint32_t>& optimized_out) const {
+  optimized_out.clear();
+  if (!context_ || !optimizer_available_) {
+    return SPV_UNSUPPORTED;
+  }
+  // The optimizer object is not used concurrently, create one for each call.
+  spv_optimizer_t* optimizer = fn_spvOptimizerCreate_(target_env_);
+  if (!optimizer) {
+    return SPV_ERROR_OUT_OF_MEMORY;
+  }
+  for (const char* pass_flag : kOptimizationPassFlags) {
+    if (!fn_spvOptimizerRegisterPassFromFlag_(optimizer, pass_flag)) {
+      XELOGE("SPIRV-Tools: Failed to register the optimization pass {}",
+             pass_flag);
+      fn_spvOptimizerDestroy_(optimizer);
+      return SPV_ERROR_INVALID_LOOKUP;
+    }
+  }
+  spv_optimizer_options options = fn_spvOptimizerOptionsCreate_();
+  // The translator output is expected to be valid, and validation is done
+  // separately if needed.
+  fn_spvOptimizerOptionsSetRunValidator_(options, false);
+  spv_binary optimized_binary = nullptr;
+  spv_result_t result = fn_spvOptimizerRun_(optimizer, words, num_words,
+                                            &optimized_binary, options);
+  fn_spvOptimizerOptionsDestroy_(options);
+  fn_spvOptimizerDestroy_(optimizer);
+  if (optimized_binary) {
+    if (result == SPV_SUCCESS) {
+      optimized_out.assign(
+          optimized_binary->code,
+          optimized_binary->code + optimized_binary->wordCount);
+    }
+    fn_spvBinaryDestroy_(optimized_binary);
+  }
+  return result;
+}
+
 }  // namespace vulkan
 }  // namespace ui
 }  // namespace xe
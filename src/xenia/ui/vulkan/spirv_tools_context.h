@@ -12,6 +12,7 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #include "third_party/SPIRV-Tools/include/spirv-tools/libspirv.h"
 #include "xenia/base/platform.h"
@@ -35,9 +36,20 @@ class SpirvToolsContext {
   bool Initialize(unsigned int spirv_version);
   void Shutdown();
 
+  spv_target_env target_env() const { return target_env_; }
+
   spv_result_t Validate(const uint32_t* words, size_t num_words,
                         std::string* error) const;
 
+  // The optimizer is optional, not available in older versions of
+  // SPIRV-Tools.
+  bool IsOptimizerAvailable() const { return optimizer_available_; }
+  // Runs the dead code elimination, constant folding, control flow
+  // simplification and scalar replacement passes. Can be called from multiple
+  // threads.
+  spv_result_t Optimize(const uint32_t* words, size_t num_words,
+                        std::vector<uint32_t>& optimized_out) const;
+
  private:
 #if XE_PLATFORM_LINUX
   void* library_ = nullptr;
@@ -61,7 +73,20 @@ class SpirvToolsContext {
   decltype(&spvContextDestroy) fn_spvContextDestroy_ = nullptr;
   decltype(&spvValidateBinary) fn_spvValidateBinary_ = nullptr;
   decltype(&spvDiagnosticDestroy) fn_spvDiagnosticDestroy_ = nullptr;
+  decltype(&spvOptimizerCreate) fn_spvOptimizerCreate_ = nullptr;
+  decltype(&spvOptimizerDestroy) fn_spvOptimizerDestroy_ = nullptr;
+  decltype(&spvOptimizerRegisterPassFromFlag)
+      fn_spvOptimizerRegisterPassFromFlag_ = nullptr;
+  decltype(&spvOptimizerOptionsCreate) fn_spvOptimizerOptionsCreate_ = nullptr;
+  decltype(&spvOptimizerOptionsDestroy) fn_spvOptimizerOptionsDestroy_ =
+      nullptr;
+  decltype(&spvOptimizerOptionsSetRunValidator)
+      fn_spvOptimizerOptionsSetRunValidator_ = nullptr;
+  decltype(&spvOptimizerRun) fn_spvOptimizerRun_ = nullptr;
+  decltype(&spvBinaryDestroy) fn_spvBinaryDestroy_ = nullptr;
+  bool optimizer_available_ = false;
 
+  spv_target_env target_env_ = SPV_ENV_VULKAN_1_0;
   spv_context context_ = nullptr;
 };
 
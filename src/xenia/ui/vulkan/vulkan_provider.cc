@@ -744,6 +744,10 @@ void VulkanProvider::TryCreateDevice() {
   }
 
   device_info_.apiVersion = properties.apiVersion;
+  device_info_.vendorID = properties.vendorID;
+  device_info_.deviceID = properties.deviceID;
+  std::memcpy(device_info_.pipelineCacheUUID, properties.pipelineCacheUUID,
+              sizeof(device_info_.pipelineCacheUUID));
 
   XELOGVK("Device Vulkan API version: {}.{}.{}",
           VK_API_VERSION_MAJOR(properties.apiVersion),
@@ -73,6 +73,9 @@ class VulkanProvider : public GraphicsProvider {
     uint32_t memory_types_host_cached;
 
     uint32_t apiVersion;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
     uint32_t maxImageDimension2D;
     uint32_t maxImageDimension3D;
     uint32_t maxImageDimensionCube;
@@ -16,6 +16,7 @@
 #include "xenia/base/mutex.h"
 #include "xenia/base/string_buffer.h"
 #include "xenia/vfs/entry.h"
+#include "xenia/vfs/path_index.h"
 
 namespace xe {
 namespace vfs {
@@ -29,6 +30,10 @@ class Device {
 
   const std::string& mount_path() const { return mount_path_; }
   virtual bool is_read_only() const { return true; }
+  // Whether I/O on different files of the device must not be executed
+  // concurrently, for devices that access all their files through shared host
+  // state, such as a host file that is seeked for every read.
+  virtual bool requires_serialized_io() const { return false; }
 
   virtual void Dump(StringBuffer* string_buffer) = 0;
   virtual Entry* ResolvePath(const std::string_view path) = 0;
@@ -42,9 +47,14 @@ class Device {
   virtual uint32_t sectors_per_allocation_unit() const = 0;
   virtual uint32_t bytes_per_sector() const = 0;
 
+  // Index of the entries of the device, if it has built one, used by
+  // ResolvePath instead of walking the entry tree.
+  PathIndex* path_index() const { return path_index_.get(); }
+
  protected:
   xe::global_critical_region global_critical_region_;
   std::string mount_path_;
+  std::unique_ptr<PathIndex> path_index_;
 };
 
 }  // namespace vfs
@@ -9,11 +9,24 @@
 
 #include "xenia/vfs/devices/disc_image_device.h"
 
+#include <algorithm>
+#include <atomic>
+
+#include "third_party/fmt/include/fmt/format.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
 #include "xenia/base/literals.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
+#include "xenia/base/threading.h"
+#include "xenia/base/xxhash.h"
 #include "xenia/vfs/devices/disc_image_entry.h"
 
+DEFINE_bool(disc_image_index_cache, true,
+            "Store the directory tree of disc images in the host cache to "
+            "mount them faster the next time.",
+            "Storage");
+
 namespace xe {
 namespace vfs {
 
@@ -21,9 +34,42 @@ using namespace xe::literals;
 
 const size_t kXESectorSize = 2_KiB;
 
+// Upper bound of threads reading directory tables, which are mostly waiting
+// for the pages of the image to be read from the host disk.
+constexpr uint32_t kMaxParseThreads = 8;
+
+// Cached directory tree of a disc image. Entries are stored in the order of a
+// depth-first traversal, followed by their UTF-8 names.
+constexpr uint32_t kIndexMagic = make_fourcc("XGDI");
+constexpr uint32_t kIndexVersion = 1;
+
+struct DiscImageIndexHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t image_size;
+  uint64_t image_write_time;
+  uint32_t entry_count;
+  uint32_t names_size;
+};
+
+struct DiscImageIndexEntry {
+  // Index of the parent entry, UINT32_MAX for the root.
+  uint32_t parent;
+  uint32_t attributes;
+  uint64_t size;
+  uint64_t data_offset;
+  uint32_t name_offset;
+  uint32_t name_length;
+};
+static_assert(sizeof(DiscImageIndexEntry) == 32);
+
 DiscImageDevice::DiscImageDevice(const std::string_view mount_path,
-                                 const std::filesystem::path& host_path)
-    : Device(mount_path), name_("GDFX"), host_path_(host_path) {}
+                                 const std::filesystem::path& host_path,
+                                 const std::filesystem::path& index_cache_path)
+    : Device(mount_path),
+      name_("GDFX"),
+      host_path_(host_path),
+      index_cache_path_(index_cache_path) {}
 
 DiscImageDevice::~DiscImageDevice() = default;
 
@@ -45,12 +91,19 @@ bool DiscImageDevice::Initialize() {
     return false;
   }
 
-  result = ReadAllEntries(&state, state.ptr + state.root_offset);
-  if (result != Error::kSuccess) {
-    XELOGE("Failed to read all GDFX entries: {}", result);
-    return false;
+  std::filesystem::path index_path = GetIndexPath(&state);
+  if (index_path.empty() || !LoadIndex(index_path)) {
+    result = ReadAllEntries(&state, state.ptr + state.root_offset);
+    if (result != Error::kSuccess) {
+      XELOGE("Failed to read all GDFX entries: {}", result);
+      return false;
+    }
+    if (!index_path.empty()) {
+      SaveIndex(index_path);
+    }
   }
 
+  path_index_ = std::make_unique<PathIndex>(root_entry_.get(), false);
   return true;
 }
 
@@ -64,7 +117,7 @@ Entry* DiscImageDevice::ResolvePath(const std::string_view path) {
   // be in the form:
   // some\PATH.foo
   XELOGFS("DiscImageDevice::ResolvePath({})", path);
-  return root_entry_->ResolvePath(path);
+  return path_index_->Find(path);
 }
 
 DiscImageDevice::Error DiscImageDevice::Verify(ParseState* state) {
@@ -116,16 +169,61 @@ DiscImageDevice::Error DiscImageDevice::ReadAllEntries(
   root_entry->attributes_ = kFileAttributeDirectory;
   root_entry_ = std::unique_ptr<Entry>(root_entry);
 
-  if (!ReadEntry(state, root_buffer, 0, root_entry)) {
+  // Read the root directory first, its subdirectories are independent.
+  std::vector<PendingDirectory> root_directories;
+  if (!ReadEntry(state, root_buffer, 0, root_entry, &root_directories) ||
+      !ReadDirectories(state, root_directories)) {
     return Error::kErrorOutOfMemory;
   }
 
   return Error::kSuccess;
 }
 
-bool DiscImageDevice::ReadEntry(ParseState* state, const uint8_t* buffer,
-                                uint16_t entry_ordinal,
-                                DiscImageEntry* parent) {
+bool DiscImageDevice::ReadDirectories(
+    const ParseState* state, const std::vector<PendingDirectory>& directories) {
+  std::atomic<size_t> next_directory = 0;
+  std::atomic<bool> succeeded = true;
+  auto read_directories = [&]() {
+    size_t i;
+    while (succeeded && (i = next_directory++) < directories.size()) {
+      auto [entry, sector] = directories[i];
+      if (state->size < state->game_offset + (sector * kXESectorSize)) {
+        // Out of bounds read.
+        succeeded = false;
+        break;
+      }
+      // Read child list.
+      uint8_t* folder_ptr =
+          state->ptr + state->game_offset + (sector * kXESectorSize);
+      if (!ReadEntry(state, folder_ptr, 0, entry, nullptr)) {
+        succeeded = false;
+      }
+    }
+  };
+
+  uint32_t thread_count =
+      uint32_t(std::min({size_t(kMaxParseThreads), directories.size(),
+                         size_t(xe::threading::logical_processor_count())}));
+  std::vector<std::unique_ptr<xe::threading::Thread>> threads;
+  for (uint32_t i = 1; i < thread_count; ++i) {
+    auto thread = xe::threading::Thread::Create({}, read_directories);
+    if (!thread) {
+      break;
+    }
+    thread->set_name(fmt::format("GDFX Parser {}", i));
+    threads.push_back(std::move(thread));
+  }
+  read_directories();
+  for (auto& thread : threads) {
+    xe::threading::Wait(thread.get(), false);
+  }
+  return succeeded;
+}
+
+bool DiscImageDevice::ReadEntry(
+    const ParseState* state, const uint8_t* buffer, uint16_t entry_ordinal,
+    DiscImageEntry* parent,
+    std::vector<PendingDirectory>* pending_directories) {
   const uint8_t* p = buffer + (entry_ordinal * 4);
 
   uint16_t node_l = xe::load<uint16_t>(p + 0);
@@ -136,7 +234,8 @@ bool DiscImageDevice::ReadEntry(ParseState* state, const uint8_t* buffer,
   uint8_t name_length = xe::load<uint8_t>(p + 13);
   auto name_buffer = reinterpret_cast<const char*>(p + 14);
 
-  if (node_l && !ReadEntry(state, buffer, node_l, parent)) {
+  if (node_l &&
+      !ReadEntry(state, buffer, node_l, parent, pending_directories)) {
     return false;
   }
 
@@ -160,15 +259,19 @@ bool DiscImageDevice::ReadEntry(ParseState* state, const uint8_t* buffer,
     entry->data_size_ = 0;
     if (length) {
       // Not a leaf - read in children.
-      if (state->size < state->game_offset + (sector * kXESectorSize)) {
-        // Out of bounds read.
-        return false;
-      }
-      // Read child list.
-      uint8_t* folder_ptr =
-          state->ptr + state->game_offset + (sector * kXESectorSize);
-      if (!ReadEntry(state, folder_ptr, 0, entry.get())) {
-        return false;
+      if (pending_directories) {
+        pending_directories->emplace_back(entry.get(), sector);
+      } else {
+        if (state->size < state->game_offset + (sector * kXESectorSize)) {
+          // Out of bounds read.
+          return false;
+        }
+        // Read child list.
+        uint8_t* folder_ptr =
+            state->ptr + state->game_offset + (sector * kXESectorSize);
+        if (!ReadEntry(state, folder_ptr, 0, entry.get(), nullptr)) {
+          return false;
+        }
       }
     }
   } else {
@@ -181,12 +284,173 @@ bool DiscImageDevice::ReadEntry(ParseState* state, const uint8_t* buffer,
   parent->children_.emplace_back(std::move(entry));
 
   // Read next file in the list.
-  if (node_r && !ReadEntry(state, buffer, node_r, parent)) {
+  if (node_r &&
+      !ReadEntry(state, buffer, node_r, parent, pending_directories)) {
+    return false;
+  }
+
+  return true;
+}
+
+std::filesystem::path DiscImageDevice::GetIndexPath(
+    const ParseState* state) const {
+  if (!cvars::disc_image_index_cache || index_cache_path_.empty()) {
+    return {};
+  }
+  // Identify the image by its size, the volume descriptor and the root
+  // directory table rather than by its host path, so the index stays valid
+  // if the image is moved.
+  XXH3_state_t hash_state;
+  XXH3_64bits_reset(&hash_state);
+  XXH3_64bits_update(&hash_state, &state->size, sizeof(state->size));
+  XXH3_64bits_update(&hash_state, &state->game_offset,
+                     sizeof(state->game_offset));
+  XXH3_64bits_update(&hash_state,
+                     state->ptr + state->game_offset + (32 * kXESectorSize),
+                     std::min(kXESectorSize, state->size - state->game_offset -
+                                                 (32 * kXESectorSize)));
+  if (state->root_offset < state->size) {
+    XXH3_64bits_update(
+        &hash_state, state->ptr + state->root_offset,
+        std::min(state->root_size, state->size - state->root_offset));
+  }
+  return index_cache_path_ /
+         fmt::format("{:016X}.gdfx_index", XXH3_64bits_digest(&hash_state));
+}
+
+static uint64_t GetImageWriteTime(const std::filesystem::path& path) {
+  std::error_code ec;
+  auto write_time = std::filesystem::last_write_time(path, ec);
+  return ec ? 0 : uint64_t(write_time.time_since_epoch().count());
+}
+
+bool DiscImageDevice::LoadIndex(const std::filesystem::path& index_path) {
+  auto index = MappedMemory::Open(index_path, MappedMemory::Mode::kRead);
+  if (!index || index->size() < sizeof(DiscImageIndexHeader)) {
+    return false;
+  }
+  DiscImageIndexHeader header;
+  std::memcpy(&header, index->data(), sizeof(header));
+  if (header.magic != kIndexMagic || header.version != kIndexVersion ||
+      header.image_size != mmap_->size() ||
+      header.image_write_time != GetImageWriteTime(host_path_) ||
+      !header.entry_count ||
+      index->size() != sizeof(header) +
+                           sizeof(DiscImageIndexEntry) * header.entry_count +
+                           header.names_size) {
     return false;
   }
+  auto index_entries = reinterpret_cast<const DiscImageIndexEntry*>(
+      index->data() + sizeof(header));
+  auto names =
+      reinterpret_cast<const char*>(index_entries + header.entry_count);
+
+  std::vector<DiscImageEntry*> entries(header.entry_count);
+  std::unique_ptr<Entry> root_entry;
+  for (uint32_t i = 0; i < header.entry_count; ++i) {
+    const DiscImageIndexEntry& index_entry = index_entries[i];
+    if ((i ? index_entry.parent >= i : index_entry.parent != UINT32_MAX) ||
+        uint64_t(index_entry.name_offset) + index_entry.name_length >
+            header.names_size ||
+        (!(index_entry.attributes & kFileAttributeDirectory) &&
+         index_entry.data_offset + index_entry.size > mmap_->size())) {
+      XELOGW("Disc image index {} is damaged, ignoring it",
+             xe::path_to_utf8(index_path));
+      return false;
+    }
+    if (!i) {
+      auto entry = new DiscImageEntry(this, nullptr, "", "", mmap_.get());
+      entry->attributes_ = kFileAttributeDirectory;
+      entries[0] = entry;
+      root_entry.reset(entry);
+      continue;
+    }
+    DiscImageEntry* parent = entries[index_entry.parent];
+    auto entry = DiscImageEntry::Create(
+        this, parent,
+        std::string_view(names + index_entry.name_offset,
+                         index_entry.name_length),
+        mmap_.get());
+    entry->attributes_ = index_entry.attributes;
+    entry->size_ = size_t(index_entry.size);
+    entry->allocation_size_ = xe::round_up(entry->size_, bytes_per_sector());
+    // Set to January 1, 1970 (UTC) in 100-nanosecond intervals
+    entry->create_timestamp_ = 10000 * 11644473600000LL;
+    entry->access_timestamp_ = 10000 * 11644473600000LL;
+    entry->write_timestamp_ = 10000 * 11644473600000LL;
+    if (!(entry->attributes_ & kFileAttributeDirectory)) {
+      entry->data_offset_ = size_t(index_entry.data_offset);
+      entry->data_size_ = entry->size_;
+    }
+    entries[i] = entry.get();
+    parent->children_.emplace_back(std::move(entry));
+  }
 
+  root_entry_ = std::move(root_entry);
+  XELOGI("Loaded disc image directory tree from {}",
+         xe::path_to_utf8(index_path));
   return true;
 }
 
+void DiscImageDevice::SaveIndex(const std::filesystem::path& index_path) const {
+  std::vector<DiscImageIndexEntry> index_entries;
+  std::string names;
+  // Depth-first, so the parent of every entry comes before it.
+  std::vector<std::pair<const Entry*, uint32_t>> stack;
+  stack.emplace_back(root_entry_.get(), UINT32_MAX);
+  while (!stack.empty()) {
+    auto [entry, parent] = stack.back();
+    stack.pop_back();
+    auto disc_entry = static_cast<const DiscImageEntry*>(entry);
+    DiscImageIndexEntry& index_entry = index_entries.emplace_back();
+    index_entry.parent = parent;
+    index_entry.attributes = entry->attributes();
+    index_entry.size = entry->size();
+    index_entry.data_offset = disc_entry->data_offset();
+    index_entry.name_offset = uint32_t(names.size());
+    index_entry.name_length = uint32_t(entry->name().size());
+    names += entry->name();
+    uint32_t entry_index = uint32_t(index_entries.size() - 1);
+    // Pushed in reverse to keep the order of the children.
+    const auto& children = entry->children();
+    for (auto it = children.crbegin(); it != children.crend(); ++it) {
+      stack.emplace_back(it->get(), entry_index);
+    }
+  }
+
+  DiscImageIndexHeader header = {};
+  header.magic = kIndexMagic;
+  header.version = kIndexVersion;
+  header.image_size = mmap_->size();
+  header.image_write_time = GetImageWriteTime(host_path_);
+  header.entry_count = uint32_t(index_entries.size());
+  header.names_size = uint32_t(names.size());
+
+  // Written to a temporary file first so a partially written index is never
+  // loaded.
+  std::filesystem::path temp_path = index_path;
+  temp_path += ".tmp";
+  if (!xe::filesystem::CreateParentFolder(temp_path)) {
+    return;
+  }
+  FILE* file = xe::filesystem::OpenFile(temp_path, "wb");
+  if (!file) {
+    return;
+  }
+  bool written =
+      fwrite(&header, sizeof(header), 1, file) == 1 &&
+      fwrite(index_entries.data(), sizeof(DiscImageIndexEntry),
+             index_entries.size(), file) == index_entries.size() &&
+      fwrite(names.data(), 1, names.size(), file) == names.size();
+  fclose(file);
+  std::error_code ec;
+  if (written) {
+    std::filesystem::rename(temp_path, index_path, ec);
+  }
+  if (!written || ec) {
+    std::filesystem::remove(temp_path, ec);
+  }
+}
+
 }  // namespace vfs
 }  // namespace xe
@@ -10,8 +10,11 @@
 #ifndef XENIA_VFS_DEVICES_DISC_IMAGE_DEVICE_H_
 #define XENIA_VFS_DEVICES_DISC_IMAGE_DEVICE_H_
 
+#include <filesystem>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "xenia/base/mapped_memory.h"
 #include "xenia/vfs/device.h"
@@ -25,8 +28,11 @@ constexpr fourcc_t kXSFSignature = make_fourcc(0x58, 0x53, 0x46, 0x1A);
 
 class DiscImageDevice : public Device {
  public:
+  // If index_cache_path is not empty, the parsed directory tree is stored in a
+  // file there and loaded instead of parsing the image again on later mounts.
   DiscImageDevice(const std::string_view mount_path,
-                  const std::filesystem::path& host_path);
+                  const std::filesystem::path& host_path,
+                  const std::filesystem::path& index_cache_path = {});
   ~DiscImageDevice() override;
 
   bool Initialize() override;
@@ -56,6 +62,7 @@ class DiscImageDevice : public Device {
 
   std::string name_;
   std::filesystem::path host_path_;
+  std::filesystem::path index_cache_path_;
   std::unique_ptr<Entry> root_entry_;
   std::unique_ptr<MappedMemory> mmap_;
 
@@ -68,11 +75,24 @@ class DiscImageDevice : public Device {
     size_t root_size;    // Size (bytes) of root.
   } ParseState;
 
+  // Directory whose table is yet to be read, and the sector of the table.
+  using PendingDirectory = std::pair<DiscImageEntry*, size_t>;
+
   Error Verify(ParseState* state);
   bool VerifyMagic(ParseState* state, size_t offset);
   Error ReadAllEntries(ParseState* state, const uint8_t* root_buffer);
-  bool ReadEntry(ParseState* state, const uint8_t* buffer,
-                 uint16_t entry_ordinal, DiscImageEntry* parent);
+  // Reads the subtrees of the directories on multiple threads.
+  bool ReadDirectories(const ParseState* state,
+                       const std::vector<PendingDirectory>& directories);
+  // If pending_directories is not null, tables of subdirectories are not read,
+  // but the subdirectories are added to it instead.
+  bool ReadEntry(const ParseState* state, const uint8_t* buffer,
+                 uint16_t entry_ordinal, DiscImageEntry* parent,
+                 std::vector<PendingDirectory>* pending_directories);
+
+  std::filesystem::path GetIndexPath(const ParseState* state) const;
+  bool LoadIndex(const std::filesystem::path& index_path);
+  void SaveIndex(const std::filesystem::path& index_path) const;
 };
 
 }  // namespace vfs
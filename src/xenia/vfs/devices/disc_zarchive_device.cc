@@ -43,7 +43,11 @@ bool DiscZarchiveDevice::Initialize() {
   root_entry->absolute_path_ = root_path;
   root_entry_ = std::unique_ptr<Entry>(root_entry);
 
-  return ReadAllEntries("", root_entry, nullptr);
+  if (!ReadAllEntries("", root_entry, nullptr)) {
+    return false;
+  }
+  path_index_ = std::make_unique<PathIndex>(root_entry_.get(), false);
+  return true;
 }
 
 void DiscZarchiveDevice::Dump(StringBuffer* string_buffer) {
@@ -57,16 +61,11 @@ Entry* DiscZarchiveDevice::ResolvePath(const std::string_view path) {
   // some\PATH.foo
   XELOGFS("DiscZarchiveDevice::ResolvePath({})", path);
 
-  if (!reader_) {
-    return nullptr;
-  }
-
-  const ZArchiveNodeHandle handle = reader_->LookUp(path);
-  if (handle == ZARCHIVE_INVALID_NODE) {
+  if (!path_index_) {
     return nullptr;
   }
 
-  return root_entry_->ResolvePath(path);
+  return path_index_->Find(path);
 }
 
 bool DiscZarchiveDevice::ReadAllEntries(const std::string& path,
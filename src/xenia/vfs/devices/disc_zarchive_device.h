@@ -41,6 +41,9 @@ class DiscZarchiveDevice : public Device {
   const std::string& name() const override { return name_; }
   uint32_t attributes() const override { return 0; }
   uint32_t component_name_max_length() const override { return 255; }
+  // The ZArchiveReader with its shared file and block cache is not
+  // thread-safe.
+  bool requires_serialized_io() const override { return true; }
 
   uint32_t total_allocation_units() const override { return 128 * 1024; }
   uint32_t available_allocation_units() const override { return 0; }
@@ -44,6 +44,8 @@ bool HostPathDevice::Initialize() {
   root_entry_ = std::unique_ptr<Entry>(root_entry);
   PopulateEntry(root_entry);
 
+  // Entries may be created, deleted and renamed even on read-only devices.
+  path_index_ = std::make_unique<PathIndex>(root_entry_.get(), true);
   return true;
 }
 
@@ -57,7 +59,7 @@ Entry* HostPathDevice::ResolvePath(const std::string_view path) {
   // be in the form:
   // some\PATH.foo
   XELOGFS("HostPathDevice::ResolvePath({})", path);
-  return root_entry_->ResolvePath(path);
+  return path_index_->Find(path);
 }
 
 void HostPathDevice::PopulateEntry(HostPathEntry* parent_entry) {
@@ -0,0 +1,153 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/vfs/devices/xcontent_block_cache.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "xenia/base/filesystem.h"
+
+namespace xe {
+namespace vfs {
+
+ContainerBlockCache::ContainerBlockCache(size_t capacity_bytes,
+                                         uint32_t read_ahead_lines)
+    : max_lines_(capacity_bytes / kLineSize),
+      read_ahead_lines_(read_ahead_lines) {}
+
+size_t ContainerBlockCache::Read(FILE* file, size_t file_index,
+                                 uint64_t offset, void* buffer,
+                                 size_t length) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (!max_lines_) {
+    ++statistics_.host_reads;
+    xe::filesystem::Seek(file, offset, SEEK_SET);
+    size_t bytes_read = fread(buffer, 1, length, file);
+    statistics_.host_bytes_read += bytes_read;
+    return bytes_read;
+  }
+
+  uint8_t* dest = static_cast<uint8_t*>(buffer);
+  size_t bytes_read = 0;
+  while (bytes_read < length) {
+    uint64_t position = offset + bytes_read;
+    uint64_t line_index = position / kLineSize;
+    const Line* line = FindLine(LineKey(file_index, line_index));
+    if (line) {
+      ++statistics_.line_hits;
+    } else {
+      ++statistics_.line_misses;
+      // Load everything the rest of the request needs at once, plus more if
+      // the file is being read sequentially.
+      uint64_t request_end_line = (offset + length - 1) / kLineSize;
+      uint64_t line_count = request_end_line - line_index + 1;
+      auto last_read_line = last_read_lines_.find(file_index);
+      if (last_read_line != last_read_lines_.end() &&
+          (last_read_line->second == line_index ||
+           last_read_line->second + 1 == line_index)) {
+        line_count += read_ahead_lines_;
+      }
+      line_count = std::min(line_count, uint64_t(max_lines_));
+      // Don't reload lines that are already cached.
+      uint32_t load_count = 1;
+      while (load_count < line_count &&
+             !lines_.count(LineKey(file_index, line_index + load_count))) {
+        ++load_count;
+      }
+      line = LoadLines(file, file_index, line_index, load_count);
+      if (!line) {
+        break;
+      }
+      if (line_index + load_count - 1 > request_end_line) {
+        statistics_.lines_read_ahead +=
+            line_index + load_count - 1 - request_end_line;
+      }
+    }
+    size_t line_offset = size_t(position - line_index * kLineSize);
+    if (line_offset >= line->data.size()) {
+      // End of the host file.
+      break;
+    }
+    size_t copy_length =
+        std::min(length - bytes_read, line->data.size() - line_offset);
+    std::memcpy(dest + bytes_read, line->data.data() + line_offset,
+                copy_length);
+    bytes_read += copy_length;
+  }
+
+  if (bytes_read) {
+    last_read_lines_[file_index] = (offset + bytes_read - 1) / kLineSize;
+  }
+  return bytes_read;
+}
+
+void ContainerBlockCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  lines_.clear();
+  lru_.clear();
+  last_read_lines_.clear();
+}
+
+ContainerBlockCache::Statistics ContainerBlockCache::statistics() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return statistics_;
+}
+
+const ContainerBlockCache::Line* ContainerBlockCache::FindLine(uint64_t key) {
+  auto it = lines_.find(key);
+  if (it == lines_.end()) {
+    return nullptr;
+  }
+  lru_.splice(lru_.begin(), lru_, it->second);
+  return &*it->second;
+}
+
+const ContainerBlockCache::Line* ContainerBlockCache::LoadLines(
+    FILE* file, size_t file_index, uint64_t line_index, uint32_t line_count) {
+  ++statistics_.host_reads;
+  xe::filesystem::Seek(file, line_index * kLineSize, SEEK_SET);
+  // The lines are read one after another without seeking, directly into their
+  // storage. Storage of the least recently used lines is reused once the cache
+  // is full.
+  std::list<Line> loaded;
+  for (uint32_t i = 0; i < line_count; ++i) {
+    if (lines_.size() >= max_lines_) {
+      lines_.erase(lru_.back().key);
+      loaded.splice(loaded.end(), lru_, std::prev(lru_.end()));
+    } else {
+      loaded.emplace_back();
+    }
+    Line& line = loaded.back();
+    line.key = LineKey(file_index, line_index + i);
+    line.data.resize(kLineSize);
+    size_t bytes_loaded = fread(line.data.data(), 1, kLineSize, file);
+    statistics_.host_bytes_read += bytes_loaded;
+    if (!bytes_loaded) {
+      loaded.pop_back();
+      break;
+    }
+    line.data.resize(bytes_loaded);
+    lines_.emplace(line.key, std::prev(loaded.end()));
+    if (bytes_loaded < kLineSize) {
+      // End of the host file.
+      break;
+    }
+  }
+  if (loaded.empty()) {
+    return nullptr;
+  }
+  // The requested line becomes the most recently used one.
+  lru_.splice(lru_.begin(), loaded);
+  return &lru_.front();
+}
+
+}  // namespace vfs
+}  // namespace xe
@@ -0,0 +1,96 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_VFS_DEVICES_XCONTENT_BLOCK_CACHE_H_
+#define XENIA_VFS_DEVICES_XCONTENT_BLOCK_CACHE_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "xenia/base/literals.h"
+
+namespace xe {
+namespace vfs {
+
+using namespace xe::literals;
+
+// LRU cache of fixed-size lines of the host files backing an XContent
+// container, with read-ahead when a host file is accessed sequentially.
+// Streaming a file stored in STFS otherwise results in a seek and a small read
+// for every 4 KiB block.
+//
+// All accesses to the host files of a container must go through the cache as
+// it also serializes seeking and reading the shared FILE handles.
+//
+// Each container has its own cache (so containers don't contend for one lock
+// around host reads), and the capacity is per cache, not shared between them.
+class ContainerBlockCache {
+ public:
+  static constexpr size_t kLineSize = 64_KiB;
+
+  struct Statistics {
+    uint64_t line_hits = 0;
+    uint64_t line_misses = 0;
+    // Lines loaded ahead of the request that triggered the load.
+    uint64_t lines_read_ahead = 0;
+    uint64_t host_reads = 0;
+    uint64_t host_bytes_read = 0;
+  };
+
+  // A capacity smaller than one line disables caching, every read goes to the
+  // host file directly.
+  ContainerBlockCache(size_t capacity_bytes, uint32_t read_ahead_lines);
+
+  // Returns the number of bytes read, which is less than length only if the
+  // end of the host file has been reached or a host read has failed.
+  size_t Read(FILE* file, size_t file_index, uint64_t offset, void* buffer,
+              size_t length);
+
+  void Clear();
+
+  Statistics statistics() const;
+
+ private:
+  struct Line {
+    uint64_t key;
+    std::vector<uint8_t> data;
+  };
+
+  static uint64_t LineKey(size_t file_index, uint64_t line_index) {
+    return (uint64_t(file_index) << 40) | line_index;
+  }
+
+  const Line* FindLine(uint64_t key);
+  // Loads line_count consecutive lines that aren't in the cache yet, seeking
+  // the host file once. Returns the first line, or nullptr if nothing could be
+  // read.
+  const Line* LoadLines(FILE* file, size_t file_index, uint64_t line_index,
+                        uint32_t line_count);
+
+  size_t max_lines_;
+  uint32_t read_ahead_lines_;
+
+  mutable std::mutex mutex_;
+  // Most recently used at the front.
+  std::list<Line> lru_;
+  std::unordered_map<uint64_t, std::list<Line>::iterator> lines_;
+  // Line where the last read from each host file ended, for detecting
+  // sequential access.
+  std::unordered_map<size_t, uint64_t> last_read_lines_;
+  Statistics statistics_;
+};
+
+}  // namespace vfs
+}  // namespace xe
+
+#endif  // XENIA_VFS_DEVICES_XCONTENT_BLOCK_CACHE_H_
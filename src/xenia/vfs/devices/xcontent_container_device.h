@@ -12,12 +12,14 @@
 
 #include <filesystem>
 #include <map>
+#include <memory>
 #include <string_view>
 
 #include "xenia/base/math.h"
 #include "xenia/kernel/util/xex2_info.h"
 #include "xenia/kernel/xam/content_manager.h"
 #include "xenia/vfs/device.h"
+#include "xenia/vfs/devices/xcontent_block_cache.h"
 #include "xenia/vfs/devices/stfs_xbox.h"
 
 namespace xe {
@@ -41,6 +43,8 @@ class XContentContainerDevice : public Device {
 
   const std::string& name() const override { return name_; }
   uint32_t attributes() const override { return 0; }
+  // All the files are read by seeking the shared package FILE*s.
+  bool requires_serialized_io() const override { return true; }
 
   uint32_t sectors_per_allocation_unit() const override { return 8; }
   uint32_t bytes_per_sector() const override { return 0x200; }
@@ -68,6 +72,14 @@ class XContentContainerDevice : public Device {
     return header_->content_header.licenses[0].license_bits;
   }
 
+  // Reads from one of the host files of the container through the block
+  // cache. Safe to call from multiple threads. Returns the number of bytes
+  // read.
+  size_t ReadHostData(size_t file_index, uint64_t offset, void* buffer,
+                      size_t length);
+
+  const ContainerBlockCache* block_cache() const { return block_cache_.get(); }
+
  protected:
   XContentContainerDevice(const std::string_view mount_path,
                           const std::filesystem::path& host_path);
@@ -111,6 +123,7 @@ class XContentContainerDevice : public Device {
   size_t files_total_size_;
   std::unique_ptr<Entry> root_entry_;
   std::unique_ptr<XContentContainerHeader> header_;
+  std::unique_ptr<ContainerBlockCache> block_cache_;
 
  private:
   static XContentContainerHeader* ReadContainerHeader(FILE* host_file);
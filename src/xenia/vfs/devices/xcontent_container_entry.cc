@@ -10,6 +10,7 @@
 #include "xenia/vfs/devices/xcontent_container_entry.h"
 #include "xenia/vfs/devices/xcontent_container_file.h"
 
+#include <algorithm>
 #include <map>
 
 namespace xe {
@@ -37,6 +38,47 @@ std::unique_ptr<XContentContainerEntry> XContentContainerEntry::Create(
   return std::move(entry);
 }
 
+size_t XContentContainerEntry::FindBlockRecord(size_t byte_offset) const {
+  auto it = std::upper_bound(block_record_starts_.cbegin(),
+                             block_record_starts_.cend(), byte_offset);
+  if (it == block_record_starts_.cbegin()) {
+    return block_list_.size();
+  }
+  size_t record_index = size_t(it - block_record_starts_.cbegin()) - 1;
+  if (byte_offset - block_record_starts_[record_index] >=
+      block_list_[record_index].length) {
+    return block_list_.size();
+  }
+  return record_index;
+}
+
+void XContentContainerEntry::FinalizeBlockList() {
+  // STFS stores files as chains of 4 KiB blocks, which are usually laid out
+  // sequentially apart from the hash tables interleaved with them.
+  size_t merged_count = 0;
+  for (size_t i = 0; i < block_list_.size(); ++i) {
+    const BlockRecord& record = block_list_[i];
+    if (merged_count) {
+      BlockRecord& last = block_list_[merged_count - 1];
+      if (last.file == record.file &&
+          last.offset + last.length == record.offset) {
+        last.length += record.length;
+        continue;
+      }
+    }
+    block_list_[merged_count++] = record;
+  }
+  block_list_.resize(merged_count);
+  block_list_.shrink_to_fit();
+
+  block_record_starts_.resize(block_list_.size());
+  size_t record_start = 0;
+  for (size_t i = 0; i < block_list_.size(); ++i) {
+    block_record_starts_[i] = record_start;
+    record_start += block_list_[i].length;
+  }
+}
+
 X_STATUS XContentContainerEntry::Open(uint32_t desired_access,
                                       File** out_file) {
   *out_file = new XContentContainerFile(desired_access, this);
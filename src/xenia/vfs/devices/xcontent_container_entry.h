@@ -48,15 +48,29 @@ class XContentContainerEntry : public Entry {
   };
   const std::vector<BlockRecord>& block_list() const { return block_list_; }
 
+  // Index of the block record containing the given offset in the file data,
+  // or block_list().size() if it's past the end of the records.
+  size_t FindBlockRecord(size_t byte_offset) const;
+  // Offset in the file data where the block record starts.
+  size_t block_record_start(size_t record_index) const {
+    return block_record_starts_[record_index];
+  }
+
  private:
   friend class StfsContainerDevice;
   friend class SvodContainerDevice;
 
+  // Merges block records that are contiguous in the host file and builds the
+  // table for looking up records by file offset. Must be called once all
+  // records have been added.
+  void FinalizeBlockList();
+
   MultiFileHandles* files_;
   size_t data_offset_;
   size_t data_size_;
   size_t block_;
   std::vector<BlockRecord> block_list_;
+  std::vector<size_t> block_record_starts_;
 };
 
 }  // namespace vfs
@@ -11,6 +11,7 @@
 #include <cmath>
 
 #include "xenia/base/math.h"
+#include "xenia/vfs/devices/xcontent_container_device.h"
 #include "xenia/vfs/devices/xcontent_container_entry.h"
 #include "xenia/vfs/devices/xcontent_container_file.h"
 
@@ -32,34 +33,29 @@ X_STATUS XContentContainerFile::ReadSync(void* buffer, size_t buffer_length,
     return X_STATUS_END_OF_FILE;
   }
 
-  size_t src_offset = 0;
+  auto device = static_cast<XContentContainerDevice*>(entry_->device());
   uint8_t* p = reinterpret_cast<uint8_t*>(buffer);
   size_t remaining_length =
       std::min(buffer_length, entry_->size() - byte_offset);
 
   *out_bytes_read = 0;
-  for (size_t i = 0; i < entry_->block_list().size(); i++) {
-    auto& record = entry_->block_list()[i];
-    if (src_offset + record.length <= byte_offset) {
-      // Doesn't begin in this region. Skip it.
-      src_offset += record.length;
-      continue;
-    }
-
+  const auto& block_list = entry_->block_list();
+  for (size_t i = entry_->FindBlockRecord(byte_offset);
+       i < block_list.size() && remaining_length; ++i) {
+    auto& record = block_list[i];
     size_t read_offset =
-        (byte_offset > src_offset) ? byte_offset - src_offset : 0;
+        std::max(byte_offset, entry_->block_record_start(i)) -
+        entry_->block_record_start(i);
     size_t read_length =
         std::min(record.length - read_offset, remaining_length);
 
-    auto& file = entry_->files()->at(record.file);
-    xe::filesystem::Seek(file, record.offset + read_offset, SEEK_SET);
-    auto num_read = fread(p, 1, read_length, file);
+    auto num_read = device->ReadHostData(
+        record.file, record.offset + read_offset, p, read_length);
 
     *out_bytes_read += num_read;
     p += num_read;
-    src_offset += record.length;
     remaining_length -= read_length;
-    if (remaining_length == 0) {
+    if (num_read != read_length) {
       break;
     }
   }
@@ -173,6 +173,8 @@ std::unique_ptr<XContentContainerEntry> StfsContainerDevice::ReadEntry(
           dir_entry->allocated_data_blocks());
       assert_always();
     }
+
+    entry->FinalizeBlockList();
   }
 
   return entry;
@@ -230,6 +230,7 @@ SvodContainerDevice::Result SvodContainerDevice::ReadEntry(
         last_record = entry->block_list_.size() - 1;
         last_offset = offset;
       }
+      entry->FinalizeBlockList();
     }
   }
 
@@ -100,6 +100,9 @@ Entry* Entry::CreateEntry(const std::string_view name, uint32_t attributes) {
     return nullptr;
   }
   children_.push_back(std::move(entry));
+  if (auto path_index = device_->path_index()) {
+    path_index->AddTree(children_.back().get());
+  }
   // TODO(benvanik): resort? would break iteration?
   Touch();
   return children_.back().get();
@@ -116,12 +119,23 @@ bool Entry::Delete(Entry* entry) {
   if (!DeleteEntryInternal(entry)) {
     return false;
   }
+  auto path_index = device_->path_index();
+  if (path_index) {
+    path_index->RemoveTree(entry);
+  }
+  std::string name = entry->name();
   for (auto it = children_.begin(); it != children_.end(); ++it) {
     if (it->get() == entry) {
       children_.erase(it);
       break;
     }
   }
+  if (path_index) {
+    // Another child with a name differing only in case may now be found.
+    if (auto sibling = GetChild(name)) {
+      path_index->AddTree(sibling);
+    }
+  }
   Touch();
   return true;
 }
@@ -144,12 +158,28 @@ void Entry::Rename(const std::filesystem::path file_path) {
   const std::string guest_path_without_root =
       xe::utf8::join_guest_paths(splitted_path);
 
+  auto global_lock = global_critical_region_.Acquire();
+  auto path_index = device_->path_index();
+  if (path_index) {
+    path_index->RemoveTree(this);
+  }
+
   RenameEntryInternal(guest_path_without_root);
 
   absolute_path_ = xe::utf8::join_guest_paths(device_->mount_path(),
                                               guest_path_without_root);
   path_ = guest_path_without_root;
+  std::string old_name = std::move(name_);
   name_ = xe::path_to_utf8(file_path.filename());
+
+  if (path_index) {
+    path_index->AddTree(this);
+    if (parent_) {
+      if (auto sibling = parent_->GetChild(old_name)) {
+        path_index->AddTree(sibling);
+      }
+    }
+  }
 }
 
 }  // namespace vfs
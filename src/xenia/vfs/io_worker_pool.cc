@@ -0,0 +1,213 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/vfs/io_worker_pool.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "third_party/fmt/include/fmt/format.h"
+#include "xenia/base/assert.h"
+#include "xenia/vfs/device.h"
+#include "xenia/vfs/entry.h"
+
+namespace xe {
+namespace vfs {
+
+IoWorkerPool::IoWorkerPool(uint32_t thread_count, size_t max_merge_length)
+    : max_merge_length_(max_merge_length) {
+  thread_count = std::max(thread_count, uint32_t(1));
+  for (uint32_t i = 0; i < thread_count; ++i) {
+    auto thread =
+        threading::Thread::Create({}, [this]() { WorkerThreadMain(); });
+    assert_not_null(thread);
+    thread->set_name(fmt::format("Host I/O Worker {}", i));
+    threads_.push_back(std::move(thread));
+  }
+}
+
+IoWorkerPool::~IoWorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutting_down_ = true;
+  }
+  request_cond_.notify_all();
+  for (auto& thread : threads_) {
+    threading::Wait(thread.get(), false);
+  }
+}
+
+void IoWorkerPool::Submit(Request request) {
+  assert_not_null(request.file);
+  PendingRequest pending;
+  const Device* device = request.file->entry()->device();
+  pending.serialization_key =
+      device->requires_serialized_io()
+          ? static_cast<const void*>(device)
+          : static_cast<const void*>(request.file);
+  pending.request = std::move(request);
+  pending.submit_time = Clock::now();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    assert_false(shutting_down_);
+    queue_.push_back(std::move(pending));
+    ++requests_in_flight_;
+  }
+  request_cond_.notify_one();
+}
+
+void IoWorkerPool::WaitIdle() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_cond_.wait(lock, [this]() { return !requests_in_flight_; });
+}
+
+IoWorkerPool::Statistics IoWorkerPool::statistics() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return statistics_;
+}
+
+void IoWorkerPool::WorkerThreadMain() {
+  std::vector<PendingRequest> batch;
+  std::vector<uint8_t> bounce_buffer;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    // Take the oldest request for a file or a device no other worker is
+    // accessing.
+    auto it = std::find_if(
+        queue_.begin(), queue_.end(), [this](const PendingRequest& pending) {
+          return std::find(busy_keys_.cbegin(), busy_keys_.cend(),
+                           pending.serialization_key) == busy_keys_.cend();
+        });
+    if (it == queue_.end()) {
+      if (shutting_down_ && queue_.empty()) {
+        break;
+      }
+      request_cond_.wait(lock);
+      continue;
+    }
+
+    const void* serialization_key = it->serialization_key;
+    batch.clear();
+    batch.push_back(std::move(*it));
+    it = queue_.erase(it);
+
+    // Merge the following requests with the same key while they continue
+    // reading the same file from where the previous one ended. Stopping at the
+    // first request with the key that can't be merged keeps the order.
+    const Request& first = batch.front().request;
+    if (first.operation == Operation::kRead) {
+      size_t merged_end = first.offset + first.length;
+      while (it != queue_.end()) {
+        if (it->serialization_key != serialization_key) {
+          ++it;
+          continue;
+        }
+        const Request& next = it->request;
+        if (next.operation != Operation::kRead || next.file != first.file ||
+            next.offset != merged_end ||
+            merged_end + next.length - first.offset > max_merge_length_) {
+          break;
+        }
+        merged_end += next.length;
+        batch.push_back(std::move(*it));
+        it = queue_.erase(it);
+      }
+    }
+
+    busy_keys_.push_back(serialization_key);
+    lock.unlock();
+
+    ExecuteBatch(batch, bounce_buffer);
+
+    lock.lock();
+    busy_keys_.erase(
+        std::find(busy_keys_.begin(), busy_keys_.end(), serialization_key));
+    requests_in_flight_ -= batch.size();
+    if (!requests_in_flight_) {
+      idle_cond_.notify_all();
+    }
+    // Requests with this key may have been skipped by other workers.
+    if (!queue_.empty()) {
+      request_cond_.notify_all();
+    }
+  }
+}
+
+void IoWorkerPool::ExecuteBatch(std::vector<PendingRequest>& batch,
+                                std::vector<uint8_t>& bounce_buffer) {
+  const Request& first = batch.front().request;
+  std::vector<std::pair<X_STATUS, size_t>> results(batch.size());
+
+  if (first.operation == Operation::kWrite) {
+    assert_true(batch.size() == 1);
+    size_t bytes_written = 0;
+    X_STATUS result = first.file->WriteSync(first.buffer, first.length,
+                                            first.offset, &bytes_written);
+    results[0] = {result, XSUCCEEDED(result) ? bytes_written : 0};
+  } else if (batch.size() == 1) {
+    size_t bytes_read = 0;
+    X_STATUS result = first.file->ReadSync(first.buffer, first.length,
+                                           first.offset, &bytes_read);
+    results[0] = {result, XSUCCEEDED(result) ? bytes_read : 0};
+  } else {
+    const Request& last = batch.back().request;
+    size_t merged_length = last.offset + last.length - first.offset;
+    if (bounce_buffer.size() < merged_length) {
+      bounce_buffer.resize(merged_length);
+    }
+    size_t bytes_read = 0;
+    X_STATUS result = first.file->ReadSync(bounce_buffer.data(), merged_length,
+                                           first.offset, &bytes_read);
+    if (XFAILED(result)) {
+      bytes_read = 0;
+    }
+    for (size_t i = 0; i < batch.size(); ++i) {
+      const Request& request = batch[i].request;
+      size_t relative_offset = request.offset - first.offset;
+      size_t request_bytes_read =
+          bytes_read > relative_offset
+              ? std::min(request.length, bytes_read - relative_offset)
+              : 0;
+      if (request_bytes_read) {
+        std::memcpy(request.buffer, bounce_buffer.data() + relative_offset,
+                    request_bytes_read);
+        results[i] = {X_STATUS_SUCCESS, request_bytes_read};
+      } else {
+        // Requests starting past the end of the file, like ReadSync.
+        results[i] = {XFAILED(result) ? result : X_STATUS_END_OF_FILE, 0};
+      }
+    }
+  }
+
+  for (size_t i = 0; i < batch.size(); ++i) {
+    if (batch[i].request.completion) {
+      batch[i].request.completion(results[i].first, results[i].second);
+    }
+  }
+
+  Clock::time_point completion_time = Clock::now();
+  std::lock_guard<std::mutex> lock(mutex_);
+  statistics_.requests_completed += batch.size();
+  statistics_.requests_merged += batch.size() - 1;
+  ++statistics_.host_operations;
+  for (size_t i = 0; i < batch.size(); ++i) {
+    if (first.operation == Operation::kWrite) {
+      statistics_.bytes_written += results[i].second;
+    } else {
+      statistics_.bytes_read += results[i].second;
+    }
+    auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        completion_time - batch[i].submit_time);
+    statistics_.total_latency += latency;
+    statistics_.max_latency = std::max(statistics_.max_latency, latency);
+  }
+}
+
+}  // namespace vfs
+}  // namespace xe
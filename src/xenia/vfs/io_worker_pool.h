@@ -0,0 +1,121 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_VFS_IO_WORKER_POOL_H_
+#define XENIA_VFS_IO_WORKER_POOL_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "xenia/base/threading.h"
+#include "xenia/vfs/file.h"
+#include "xenia/xbox.h"
+
+namespace xe {
+namespace vfs {
+
+class Device;
+
+// Executes File::ReadSync / File::WriteSync on host worker threads so the
+// thread that requested the I/O (usually a guest thread that issued an
+// overlapped NtReadFile / NtWriteFile) doesn't block on the host disk.
+//
+// Requests targeting the same file are executed one at a time in submission
+// order - or, for devices that require serialized I/O (container devices that
+// seek a shared host file), requests targeting the same device. Requests for
+// other files, such as separate host files of a HostPathDevice, are executed
+// concurrently. Consecutive reads of adjacent ranges of the same file are
+// merged into a single host read through a bounce buffer.
+class IoWorkerPool {
+ public:
+  enum class Operation {
+    kRead,
+    kWrite,
+  };
+
+  // Called on a worker thread once the request has been executed.
+  using CompletionCallback =
+      std::function<void(X_STATUS result, size_t bytes_transferred)>;
+
+  struct Request {
+    Operation operation = Operation::kRead;
+    File* file = nullptr;
+    // Must stay valid until the completion callback is called.
+    void* buffer = nullptr;
+    size_t length = 0;
+    size_t offset = 0;
+    CompletionCallback completion;
+  };
+
+  struct Statistics {
+    uint64_t requests_completed = 0;
+    // Requests executed as part of a host read started for another request.
+    uint64_t requests_merged = 0;
+    uint64_t host_operations = 0;
+    uint64_t bytes_read = 0;
+    uint64_t bytes_written = 0;
+    // Time from Submit to the call of the completion callback.
+    std::chrono::nanoseconds total_latency{0};
+    std::chrono::nanoseconds max_latency{0};
+  };
+
+  static constexpr size_t kDefaultMaxMergeLength = size_t(2) << 20;
+
+  explicit IoWorkerPool(uint32_t thread_count,
+                        size_t max_merge_length = kDefaultMaxMergeLength);
+  // Executes all requests that are still pending before returning.
+  ~IoWorkerPool();
+
+  void Submit(Request request);
+  // Waits until all submitted requests have been completed.
+  void WaitIdle();
+
+  Statistics statistics() const;
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  struct PendingRequest {
+    Request request;
+    // The File or, if the device requires serialized I/O, the Device - requests
+    // with the same key are executed sequentially.
+    const void* serialization_key;
+    Clock::time_point submit_time;
+  };
+
+  void WorkerThreadMain();
+  // Called without the lock held.
+  void ExecuteBatch(std::vector<PendingRequest>& batch,
+                    std::vector<uint8_t>& bounce_buffer);
+
+  size_t max_merge_length_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable request_cond_;
+  std::condition_variable idle_cond_;
+  std::deque<PendingRequest> queue_;
+  // Serialization keys of the requests being executed by the workers.
+  std::vector<const void*> busy_keys_;
+  size_t requests_in_flight_ = 0;
+  bool shutting_down_ = false;
+  Statistics statistics_;
+
+  std::vector<std::unique_ptr<threading::Thread>> threads_;
+};
+
+}  // namespace vfs
+}  // namespace xe
+
+#endif  // XENIA_VFS_IO_WORKER_POOL_H_
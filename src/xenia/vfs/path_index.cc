@@ -0,0 +1,111 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/vfs/path_index.h"
+
+#include <vector>
+
+#include "xenia/vfs/entry.h"
+
+namespace xe {
+namespace vfs {
+
+PathIndex::PathIndex(Entry* root_entry, bool is_mutable)
+    : is_mutable_(is_mutable) {
+  // Sized up front, rehashing dominates building the index of large images.
+  entries_.reserve(CountTree(root_entry));
+  std::string key;
+  AddTree(root_entry, key);
+}
+
+Entry* PathIndex::Find(const std::string_view path) const {
+  // Reused to avoid allocating for every lookup.
+  thread_local std::string key;
+  key.clear();
+  AppendKey(key, path);
+  auto global_lock = is_mutable_ ? global_critical_region_.Acquire()
+                                 : global_critical_region_.AcquireDeferred();
+  auto it = entries_.find(key);
+  return it != entries_.end() ? it->second : nullptr;
+}
+
+void PathIndex::AddTree(Entry* entry) {
+  std::string key = EntryKey(entry);
+  AddTree(entry, key);
+}
+
+void PathIndex::RemoveTree(Entry* entry) {
+  std::string key = EntryKey(entry);
+  RemoveTree(entry, key);
+}
+
+void PathIndex::AppendKey(std::string& key, const std::string_view path) {
+  bool component_start = true;
+  for (char c : path) {
+    if (c == '\\' || c == '/') {
+      component_start = true;
+      continue;
+    }
+    if (component_start) {
+      if (!key.empty()) {
+        key.push_back('\\');
+      }
+      component_start = false;
+    }
+    key.push_back(c >= 'A' && c <= 'Z' ? char(c + ('a' - 'A')) : c);
+  }
+}
+
+std::string PathIndex::EntryKey(const Entry* entry) {
+  // Built from the names in the tree rather than Entry::path, which isn't
+  // updated for descendants when a directory is renamed.
+  std::vector<const Entry*> ancestors;
+  for (; entry->parent(); entry = entry->parent()) {
+    ancestors.push_back(entry);
+  }
+  std::string key;
+  for (auto it = ancestors.crbegin(); it != ancestors.crend(); ++it) {
+    AppendKey(key, (*it)->name());
+  }
+  return key;
+}
+
+size_t PathIndex::CountTree(const Entry* entry) {
+  size_t count = 1;
+  for (const auto& child : entry->children()) {
+    count += CountTree(child.get());
+  }
+  return count;
+}
+
+void PathIndex::AddTree(Entry* entry, std::string& key) {
+  entries_.emplace(key, entry);
+  size_t key_length = key.size();
+  for (const auto& child : entry->children()) {
+    AppendKey(key, child->name());
+    AddTree(child.get(), key);
+    key.resize(key_length);
+  }
+}
+
+void PathIndex::RemoveTree(Entry* entry, std::string& key) {
+  auto it = entries_.find(key);
+  if (it != entries_.end() && it->second == entry) {
+    entries_.erase(it);
+  }
+  size_t key_length = key.size();
+  for (const auto& child : entry->children()) {
+    AppendKey(key, child->name());
+    RemoveTree(child.get(), key);
+    key.resize(key_length);
+  }
+}
+
+}  // namespace vfs
+}  // namespace xe
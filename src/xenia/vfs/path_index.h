@@ -0,0 +1,67 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_VFS_PATH_INDEX_H_
+#define XENIA_VFS_PATH_INDEX_H_
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "xenia/base/mutex.h"
+
+namespace xe {
+namespace vfs {
+
+class Entry;
+
+// Case-insensitive hash index of all entries of a device by their path
+// relative to the device root, so resolving a path doesn't need to search the
+// children of every directory along it.
+//
+// The index of a device whose entries never change after it has been mounted
+// is read without locking. Mutable indices are updated by Entry as entries are
+// created, deleted and renamed under the global critical region, and lookups
+// in them take it as well.
+class PathIndex {
+ public:
+  PathIndex(Entry* root_entry, bool is_mutable);
+
+  // Returns the same entry as root_entry->ResolvePath(path) would.
+  Entry* Find(const std::string_view path) const;
+
+  // Adds the entry and all of its descendants. Entries already present at the
+  // same path take precedence, as in Entry::GetChild.
+  void AddTree(Entry* entry);
+  // Removes the entry and all of its descendants.
+  void RemoveTree(Entry* entry);
+
+  bool is_mutable() const { return is_mutable_; }
+  size_t size() const { return entries_.size(); }
+
+ private:
+  // Appends the path with separators normalized to a single backslash, no
+  // leading or trailing separators, and ASCII letters folded to lowercase,
+  // matching the comparisons done by xe::utf8::equal_case.
+  static void AppendKey(std::string& key, const std::string_view path);
+  static std::string EntryKey(const Entry* entry);
+  static size_t CountTree(const Entry* entry);
+
+  void AddTree(Entry* entry, std::string& key);
+  void RemoveTree(Entry* entry, std::string& key);
+
+  xe::global_critical_region global_critical_region_;
+  bool is_mutable_;
+  std::unordered_map<std::string, Entry*> entries_;
+};
+
+}  // namespace vfs
+}  // namespace xe
+
+#endif  // XENIA_VFS_PATH_INDEX_H_
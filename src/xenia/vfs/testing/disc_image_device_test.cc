@@ -0,0 +1,180 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/vfs/devices/disc_image_device.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "third_party/catch/include/catch.hpp"
+#include "third_party/fmt/include/fmt/format.h"
+
+#include "xenia/base/clock.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/vfs/devices/disc_image_entry.h"
+#include "xenia/vfs/testing/gdfx_test_image.h"
+
+namespace xe::vfs::test {
+
+static std::filesystem::path TestPath(const std::string_view name) {
+  return std::filesystem::temp_directory_path() /
+         fmt::format("xenia_disc_image_test_{}_{}", name,
+                     Clock::QueryHostTickCount());
+}
+
+static std::vector<std::filesystem::path> ListIndices(
+    const std::filesystem::path& cache_path) {
+  std::vector<std::filesystem::path> indices;
+  if (std::filesystem::exists(cache_path)) {
+    for (const auto& file : std::filesystem::directory_iterator(cache_path)) {
+      indices.push_back(file.path());
+    }
+  }
+  return indices;
+}
+
+// Lists the path, the attributes, the size and the data offset of all entries
+// in the order they're stored in.
+static std::vector<std::string> DescribeTree(const Entry* entry) {
+  std::vector<std::string> lines;
+  auto disc_entry = static_cast<const DiscImageEntry*>(entry);
+  lines.push_back(fmt::format("{} {:X} {} {}", entry->path(),
+                              entry->attributes(), entry->size(),
+                              disc_entry->data_offset()));
+  for (const auto& child : entry->children()) {
+    auto child_lines = DescribeTree(child.get());
+    lines.insert(lines.end(), child_lines.cbegin(), child_lines.cend());
+  }
+  return lines;
+}
+
+TEST_CASE("Parse disc image directories", "[disc_image]") {
+  auto image_path = TestPath("gdfx");
+  auto file_paths = WriteGdfxImage(image_path, 24, 16);
+  {
+    DiscImageDevice device("\\Device\\Cdrom0", image_path);
+    REQUIRE(device.Initialize());
+    Entry* root_entry = device.ResolvePath("");
+    REQUIRE(root_entry);
+    REQUIRE(DescribeTree(root_entry).size() == GdfxImageEntryCount(24, 16));
+    REQUIRE(root_entry->children().size() == 24);
+    // The order of the children is the order in the directory tables.
+    for (size_t i = 0; i < root_entry->children().size(); ++i) {
+      const Entry* directory = root_entry->children()[i].get();
+      REQUIRE(directory->name() == fmt::format("Directory{:04}", i));
+      REQUIRE(directory->children().size() == 1 + 16);
+      REQUIRE(directory->children()[0]->name() == "Nested");
+      REQUIRE(directory->children()[0]->children().size() == 2);
+    }
+    for (const std::string& file_path : file_paths) {
+      REQUIRE(device.ResolvePath(file_path));
+    }
+  }
+  std::filesystem::remove(image_path);
+}
+
+TEST_CASE("Cache disc image directory tree", "[disc_image]") {
+  auto image_path = TestPath("gdfx");
+  auto cache_path = TestPath("cache");
+  WriteGdfxImage(image_path, 8, 32);
+
+  std::vector<std::string> parsed_tree;
+  {
+    DiscImageDevice device("\\Device\\Cdrom0", image_path, cache_path);
+    REQUIRE(device.Initialize());
+    parsed_tree = DescribeTree(device.ResolvePath(""));
+  }
+  auto indices = ListIndices(cache_path);
+  REQUIRE(indices.size() == 1);
+  REQUIRE(indices[0].extension() == ".gdfx_index");
+
+  SECTION("Loaded on the next mount") {
+    // Damage a directory table that doesn't identify the image, keeping the
+    // modification time, so the names only stay intact if they're loaded from
+    // the index.
+    auto write_time = std::filesystem::last_write_time(image_path);
+    FILE* file = xe::filesystem::OpenFile(image_path, "r+b");
+    REQUIRE(file);
+    xe::filesystem::Seek(file, 33 * kGdfxSectorSize + 14, SEEK_SET);
+    REQUIRE(fwrite("X", 1, 1, file) == 1);
+    fclose(file);
+    std::filesystem::last_write_time(image_path, write_time);
+
+    DiscImageDevice device("\\Device\\Cdrom0", image_path, cache_path);
+    REQUIRE(device.Initialize());
+    REQUIRE(DescribeTree(device.ResolvePath("")) == parsed_tree);
+    REQUIRE(device.ResolvePath("Directory0000\\Nested\\Nested0.bin"));
+  }
+
+  SECTION("Damaged index is ignored") {
+    FILE* file = xe::filesystem::OpenFile(indices[0], "r+b");
+    REQUIRE(file);
+    // Parent of the second entry, after the header.
+    xe::filesystem::Seek(file, 32 + 32, SEEK_SET);
+    uint32_t parent = 1000;
+    REQUIRE(fwrite(&parent, sizeof(parent), 1, file) == 1);
+    fclose(file);
+
+    DiscImageDevice device("\\Device\\Cdrom0", image_path, cache_path);
+    REQUIRE(device.Initialize());
+    REQUIRE(DescribeTree(device.ResolvePath("")) == parsed_tree);
+  }
+
+  SECTION("Modified image is parsed again") {
+    std::filesystem::last_write_time(
+        image_path, std::filesystem::last_write_time(image_path) +
+                        std::chrono::seconds(10));
+
+    DiscImageDevice device("\\Device\\Cdrom0", image_path, cache_path);
+    REQUIRE(device.Initialize());
+    REQUIRE(DescribeTree(device.ResolvePath("")) == parsed_tree);
+    // Replaced by an index for the new modification time.
+    REQUIRE(ListIndices(cache_path).size() == 1);
+  }
+
+  std::filesystem::remove(image_path);
+  std::filesystem::remove_all(cache_path);
+}
+
+// Not run by default. Run with the "[disc_image_benchmark]" tag.
+TEST_CASE("Disc image mount performance", "[.][disc_image_benchmark]") {
+  auto image_path = TestPath("gdfx");
+  auto cache_path = TestPath("cache");
+  WriteGdfxImage(image_path, 256, 256);
+
+  auto measure = [&](const char* name,
+                     const std::filesystem::path& index_cache_path) {
+    constexpr uint32_t kMounts = 8;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < kMounts; ++i) {
+      DiscImageDevice device("\\Device\\Cdrom0", image_path, index_cache_path);
+      REQUIRE(device.Initialize());
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    fmt::print("{}: {} entries, {:.2f} ms per mount\n", name,
+               GdfxImageEntryCount(256, 256),
+               std::chrono::duration<double, std::milli>(elapsed).count() /
+                   kMounts);
+  };
+  measure("Parse directory tables", {});
+  {
+    // Creates the index.
+    DiscImageDevice device("\\Device\\Cdrom0", image_path, cache_path);
+    REQUIRE(device.Initialize());
+  }
+  measure("Load cached index", cache_path);
+
+  std::filesystem::remove(image_path);
+  std::filesystem::remove_all(cache_path);
+}
+
+}  // namespace xe::vfs::test
@@ -0,0 +1,120 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_VFS_TESTING_GDFX_TEST_IMAGE_H_
+#define XENIA_VFS_TESTING_GDFX_TEST_IMAGE_H_
+
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "third_party/catch/include/catch.hpp"
+#include "third_party/fmt/include/fmt/format.h"
+
+#include "xenia/base/filesystem.h"
+#include "xenia/base/literals.h"
+#include "xenia/base/math.h"
+#include "xenia/vfs/entry.h"
+
+namespace xe::vfs::test {
+
+using namespace xe::literals;
+
+constexpr size_t kGdfxSectorSize = 2_KiB;
+
+// Writes a GDFX image with directory_count directories in the root, each
+// containing file_count files and a "Nested" directory with two more files.
+// Files have no data, only their size is set. Returns the paths of all files.
+inline std::vector<std::string> WriteGdfxImage(
+    const std::filesystem::path& path, uint32_t directory_count,
+    uint32_t file_count) {
+  std::vector<uint8_t> image(33 * kGdfxSectorSize);
+  std::vector<std::string> file_paths;
+
+  struct TableEntry {
+    std::string name;
+    uint8_t attributes;
+    uint32_t sector;
+    uint32_t length;
+  };
+  // Tables are written as a chain through the right nodes. Returns the entry
+  // for the directory the table belongs to.
+  auto write_table = [&image](const std::string& name,
+                              const std::vector<TableEntry>& entries) {
+    std::vector<uint8_t> table;
+    for (size_t i = 0; i < entries.size(); ++i) {
+      const TableEntry& entry = entries[i];
+      size_t entry_offset = table.size();
+      size_t entry_size = xe::round_up(14 + entry.name.size(), size_t(4));
+      table.resize(entry_offset + entry_size, 0xFF);
+      uint8_t* p = table.data() + entry_offset;
+      uint16_t node_l = 0;
+      uint16_t node_r = i + 1 < entries.size()
+                            ? uint16_t((entry_offset + entry_size) / 4)
+                            : 0;
+      std::memcpy(p + 0, &node_l, 2);
+      std::memcpy(p + 2, &node_r, 2);
+      std::memcpy(p + 4, &entry.sector, 4);
+      std::memcpy(p + 8, &entry.length, 4);
+      p[12] = entry.attributes;
+      p[13] = uint8_t(entry.name.size());
+      std::memcpy(p + 14, entry.name.data(), entry.name.size());
+    }
+    uint32_t table_sector = uint32_t(image.size() / kGdfxSectorSize);
+    image.resize(xe::round_up(image.size() + table.size(), kGdfxSectorSize));
+    std::memcpy(image.data() + table_sector * kGdfxSectorSize, table.data(),
+                table.size());
+    return TableEntry{name, uint8_t(kFileAttributeDirectory), table_sector,
+                      uint32_t(table.size())};
+  };
+
+  std::vector<TableEntry> root_entries;
+  for (uint32_t i = 0; i < directory_count; ++i) {
+    std::string directory_name = fmt::format("Directory{:04}", i);
+    std::vector<TableEntry> directory_entries;
+    std::vector<TableEntry> nested_entries;
+    for (uint32_t j = 0; j < 2; ++j) {
+      nested_entries.push_back({fmt::format("Nested{}.bin", j),
+                                uint8_t(kFileAttributeNormal), 0, j});
+      file_paths.push_back(fmt::format("{}\\Nested\\{}", directory_name,
+                                       nested_entries.back().name));
+    }
+    directory_entries.push_back(write_table("Nested", nested_entries));
+    for (uint32_t j = 0; j < file_count; ++j) {
+      directory_entries.push_back({fmt::format("File{:04}.bin", j),
+                                   uint8_t(kFileAttributeNormal), 0, j});
+      file_paths.push_back(
+          fmt::format("{}\\{}", directory_name, directory_entries.back().name));
+    }
+    root_entries.push_back(write_table(directory_name, directory_entries));
+  }
+  TableEntry root = write_table("", root_entries);
+
+  uint8_t* header = image.data() + 32 * kGdfxSectorSize;
+  std::memcpy(header, "MICROSOFT*XBOX*MEDIA", 20);
+  std::memcpy(header + 20, &root.sector, 4);
+  std::memcpy(header + 24, &root.length, 4);
+
+  FILE* file = xe::filesystem::OpenFile(path, "wb");
+  REQUIRE(file);
+  REQUIRE(fwrite(image.data(), 1, image.size(), file) == image.size());
+  fclose(file);
+  return file_paths;
+}
+
+// Number of entries in an image written by WriteGdfxImage, including the root.
+constexpr size_t GdfxImageEntryCount(uint32_t directory_count,
+                                     uint32_t file_count) {
+  return 1 + directory_count * (1 + file_count + 3);
+}
+
+}  // namespace xe::vfs::test
+
+#endif  // XENIA_VFS_TESTING_GDFX_TEST_IMAGE_H_
@@ -0,0 +1,205 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/vfs/io_worker_pool.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <vector>
+
+#include "third_party/catch/include/catch.hpp"
+#include "third_party/fmt/include/fmt/format.h"
+
+#include "xenia/base/clock.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/vfs/devices/host_path_device.h"
+
+namespace xe::vfs::test {
+
+using namespace xe::literals;
+
+static uint32_t StreamPattern(size_t dword_index) {
+  return uint32_t(dword_index * 2654435761u);
+}
+
+// Streams a file through a HostPathDevice the way a title's loader thread
+// would with overlapped reads: keeps a window of requests in flight and
+// submits the next chunk as soon as one completes.
+static void StreamHostFile(size_t file_size, size_t chunk_size,
+                           uint32_t window, uint32_t thread_count,
+                           bool print_results) {
+  auto root = std::filesystem::temp_directory_path() /
+              fmt::format("xenia_vfs_test_{}", Clock::QueryHostTickCount());
+  REQUIRE(std::filesystem::create_directories(root));
+  {
+    std::vector<uint32_t> data(file_size / sizeof(uint32_t));
+    for (size_t i = 0; i < data.size(); ++i) {
+      data[i] = StreamPattern(i);
+    }
+    FILE* host_file = xe::filesystem::OpenFile(root / "stream.bin", "wb");
+    REQUIRE(host_file);
+    REQUIRE(fwrite(data.data(), sizeof(uint32_t), data.size(), host_file) ==
+            data.size());
+    fclose(host_file);
+  }
+
+  {
+    HostPathDevice device("\\TEST", root, true);
+    REQUIRE(device.Initialize());
+    Entry* entry = device.ResolvePath("stream.bin");
+    REQUIRE(entry);
+    File* file = nullptr;
+    REQUIRE(entry->Open(xe::filesystem::FileAccess::kGenericRead, &file) ==
+            X_STATUS_SUCCESS);
+
+    size_t chunk_count = file_size / chunk_size;
+    std::vector<uint8_t> buffer(window * chunk_size);
+    std::atomic<size_t> chunks_completed = 0;
+    std::atomic<bool> contents_valid = true;
+    {
+      IoWorkerPool pool(thread_count);
+      auto start = std::chrono::steady_clock::now();
+      std::function<void(size_t)> submit_chunk;
+      submit_chunk = [&](size_t chunk) {
+        IoWorkerPool::Request request;
+        request.file = file;
+        request.buffer = buffer.data() + (chunk % window) * chunk_size;
+        request.length = chunk_size;
+        request.offset = chunk * chunk_size;
+        request.completion = [&, chunk](X_STATUS result, size_t bytes_read) {
+          auto dwords = reinterpret_cast<const uint32_t*>(
+              buffer.data() + (chunk % window) * chunk_size);
+          size_t first_dword = chunk * chunk_size / sizeof(uint32_t);
+          if (result != X_STATUS_SUCCESS || bytes_read != chunk_size ||
+              dwords[0] != StreamPattern(first_dword) ||
+              dwords[chunk_size / sizeof(uint32_t) - 1] !=
+                  StreamPattern(first_dword + chunk_size / sizeof(uint32_t) -
+                                1)) {
+            contents_valid = false;
+          }
+          ++chunks_completed;
+          if (chunk + window < chunk_count) {
+            submit_chunk(chunk + window);
+          }
+        };
+        pool.Submit(std::move(request));
+      };
+      for (size_t i = 0; i < std::min(size_t(window), chunk_count); ++i) {
+        submit_chunk(i);
+      }
+      while (chunks_completed < chunk_count) {
+        pool.WaitIdle();
+      }
+      auto elapsed = std::chrono::steady_clock::now() - start;
+
+      IoWorkerPool::Statistics statistics = pool.statistics();
+      REQUIRE(statistics.requests_completed == chunk_count);
+      REQUIRE(statistics.bytes_read == file_size);
+      if (print_results) {
+        double seconds = std::chrono::duration<double>(elapsed).count();
+        fmt::print(
+            "{} MiB in {} KiB chunks, {} in flight, {} threads: {:.1f} MiB/s, "
+            "{} host reads, average latency {:.1f} us, max {:.1f} us\n",
+            file_size / 1_MiB, chunk_size / 1_KiB, window, thread_count,
+            double(file_size) / 1_MiB / seconds, statistics.host_operations,
+            statistics.total_latency.count() / 1000.0 /
+                statistics.requests_completed,
+            statistics.max_latency.count() / 1000.0);
+      }
+    }
+    REQUIRE(contents_valid);
+    file->Destroy();
+  }
+
+  std::filesystem::remove_all(root);
+}
+
+TEST_CASE("Stream file through IoWorkerPool", "[io_worker_pool]") {
+  StreamHostFile(4_MiB, 64_KiB, 8, 2, false);
+}
+
+TEST_CASE("IoWorkerPool executes different host files concurrently",
+          "[io_worker_pool]") {
+  auto root = std::filesystem::temp_directory_path() /
+              fmt::format("xenia_vfs_test_{}", Clock::QueryHostTickCount());
+  REQUIRE(std::filesystem::create_directories(root));
+  for (const char* name : {"a.bin", "b.bin"}) {
+    FILE* host_file = xe::filesystem::OpenFile(root / name, "wb");
+    REQUIRE(host_file);
+    REQUIRE(fwrite(name, 1, 4, host_file) == 4);
+    fclose(host_file);
+  }
+
+  {
+    HostPathDevice device("\\TEST", root, true);
+    REQUIRE(device.Initialize());
+    REQUIRE(!device.requires_serialized_io());
+    File* files[2] = {};
+    REQUIRE(device.ResolvePath("a.bin")->Open(
+                xe::filesystem::FileAccess::kGenericRead, &files[0]) ==
+            X_STATUS_SUCCESS);
+    REQUIRE(device.ResolvePath("b.bin")->Open(
+                xe::filesystem::FileAccess::kGenericRead, &files[1]) ==
+            X_STATUS_SUCCESS);
+
+    // The completion of the read of the first file waits for the read of the
+    // second one, which only finishes if it's not queued behind the first.
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool second_completed = false;
+    std::atomic<bool> second_completed_first = false;
+    uint8_t buffers[2][4];
+    {
+      IoWorkerPool pool(2);
+      IoWorkerPool::Request request;
+      request.file = files[0];
+      request.buffer = buffers[0];
+      request.length = 4;
+      request.completion = [&](X_STATUS result, size_t bytes_read) {
+        std::unique_lock<std::mutex> lock(mutex);
+        second_completed_first = cond.wait_for(
+            lock, std::chrono::seconds(5), [&]() { return second_completed; });
+      };
+      pool.Submit(std::move(request));
+      request = IoWorkerPool::Request();
+      request.file = files[1];
+      request.buffer = buffers[1];
+      request.length = 4;
+      request.completion = [&](X_STATUS result, size_t bytes_read) {
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          second_completed = true;
+        }
+        cond.notify_all();
+      };
+      pool.Submit(std::move(request));
+      pool.WaitIdle();
+    }
+    REQUIRE(second_completed_first);
+    files[0]->Destroy();
+    files[1]->Destroy();
+  }
+
+  std::filesystem::remove_all(root);
+}
+
+// Not run by default. Run with the "[io_worker_pool_benchmark]" tag.
+TEST_CASE("IoWorkerPool streaming throughput",
+          "[.][io_worker_pool_benchmark]") {
+  for (uint32_t thread_count : {1, 4}) {
+    StreamHostFile(256_MiB, 64_KiB, 1, thread_count, true);
+    StreamHostFile(256_MiB, 64_KiB, 16, thread_count, true);
+  }
+}
+
+}  // namespace xe::vfs::test
@@ -0,0 +1,158 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/vfs/path_index.h"
+
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "third_party/catch/include/catch.hpp"
+#include "third_party/fmt/include/fmt/format.h"
+
+#include "xenia/base/clock.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/vfs/devices/disc_image_device.h"
+#include "xenia/vfs/devices/host_path_device.h"
+#include "xenia/vfs/testing/gdfx_test_image.h"
+
+namespace xe::vfs::test {
+
+// Varies the case and separators of a path in ways that must not change which
+// entry it resolves to.
+static std::string MangledPath(const std::string& path, size_t seed) {
+  std::string result = seed & 1 ? "\\" : "";
+  for (size_t i = 0; i < path.size(); ++i) {
+    char c = path[i];
+    if (c == '\\') {
+      result += seed & 2 ? "/" : "\\\\";
+      continue;
+    }
+    if ((i + seed) % 3 == 0) {
+      c = char(std::toupper(c));
+    } else if ((i + seed) % 3 == 1) {
+      c = char(std::tolower(c));
+    }
+    result.push_back(c);
+  }
+  return result;
+}
+
+static std::filesystem::path TestPath(const std::string_view name) {
+  return std::filesystem::temp_directory_path() /
+         fmt::format("xenia_path_index_test_{}_{}", name,
+                     Clock::QueryHostTickCount());
+}
+
+TEST_CASE("Resolve paths in a disc image", "[path_index]") {
+  auto image_path = TestPath("gdfx");
+  auto file_paths = WriteGdfxImage(image_path, 16, 64);
+  {
+    DiscImageDevice device("\\Device\\Cdrom0", image_path);
+    REQUIRE(device.Initialize());
+    REQUIRE(device.path_index());
+    REQUIRE_FALSE(device.path_index()->is_mutable());
+    REQUIRE(device.path_index()->size() == GdfxImageEntryCount(16, 64));
+
+    Entry* root_entry = device.ResolvePath("");
+    REQUIRE(root_entry);
+    REQUIRE(root_entry->parent() == nullptr);
+    REQUIRE(device.ResolvePath("\\") == root_entry);
+
+    for (size_t i = 0; i < file_paths.size(); ++i) {
+      Entry* entry = device.ResolvePath(MangledPath(file_paths[i], i));
+      REQUIRE(entry);
+      REQUIRE(entry->path() == file_paths[i]);
+      REQUIRE(entry == root_entry->ResolvePath(file_paths[i]));
+    }
+    Entry* directory = device.ResolvePath("directory0003");
+    REQUIRE(directory);
+    REQUIRE(directory->name() == "Directory0003");
+
+    REQUIRE_FALSE(device.ResolvePath("Directory0003\\File9999.bin"));
+    REQUIRE_FALSE(device.ResolvePath("Directory0003\\File0001.bin\\x"));
+    REQUIRE_FALSE(device.ResolvePath("File0001.bin"));
+    REQUIRE_FALSE(device.ResolvePath("Directory00"));
+  }
+  std::filesystem::remove(image_path);
+}
+
+TEST_CASE("Update path index of a host path device", "[path_index]") {
+  auto root = TestPath("host");
+  REQUIRE(std::filesystem::create_directories(root / "Existing"));
+  fclose(xe::filesystem::OpenFile(root / "Existing" / "a.bin", "wb"));
+  {
+    HostPathDevice device("\\CACHE", root, false);
+    REQUIRE(device.Initialize());
+    REQUIRE(device.path_index());
+    REQUIRE(device.path_index()->is_mutable());
+
+    REQUIRE(device.ResolvePath("existing\\A.BIN"));
+
+    Entry* existing = device.ResolvePath("Existing");
+    REQUIRE(existing);
+    Entry* created = existing->CreateEntry("New", kFileAttributeDirectory);
+    REQUIRE(created);
+    REQUIRE(device.ResolvePath("EXISTING\\new") == created);
+    Entry* nested = created->CreateEntry("Data.bin", kFileAttributeNormal);
+    REQUIRE(nested);
+    REQUIRE(device.ResolvePath("Existing/New/data.bin") == nested);
+
+    REQUIRE(existing->Delete(created));
+    REQUIRE_FALSE(device.ResolvePath("Existing\\New"));
+    REQUIRE_FALSE(device.ResolvePath("Existing\\New\\Data.bin"));
+    REQUIRE(device.ResolvePath("Existing\\a.bin"));
+  }
+  std::filesystem::remove_all(root);
+}
+
+// Not run by default. Run with the "[path_index_benchmark]" tag.
+TEST_CASE("Path index resolution performance", "[.][path_index_benchmark]") {
+  auto image_path = TestPath("gdfx");
+  auto file_paths = WriteGdfxImage(image_path, 64, 512);
+  {
+    DiscImageDevice device("\\Device\\Cdrom0", image_path);
+    REQUIRE(device.Initialize());
+    Entry* root_entry = device.ResolvePath("");
+    REQUIRE(root_entry);
+
+    std::vector<std::string> lookup_paths;
+    for (size_t i = 0; i < file_paths.size(); ++i) {
+      lookup_paths.push_back(MangledPath(file_paths[i], i * 7));
+    }
+
+    auto measure = [&](const char* name, auto resolve) {
+      constexpr uint32_t kPasses = 4;
+      size_t resolved = 0;
+      auto start = std::chrono::steady_clock::now();
+      for (uint32_t pass = 0; pass < kPasses; ++pass) {
+        for (const std::string& path : lookup_paths) {
+          resolved += resolve(path) != nullptr;
+        }
+      }
+      auto elapsed = std::chrono::steady_clock::now() - start;
+      REQUIRE(resolved == lookup_paths.size() * kPasses);
+      fmt::print("{}: {} entries, {:.1f} ns per path\n", name,
+                 device.path_index()->size(),
+                 std::chrono::duration<double, std::nano>(elapsed).count() /
+                     resolved);
+    };
+    measure("Entry tree walk", [&](const std::string& path) {
+      return root_entry->ResolvePath(path);
+    });
+    measure("Path index", [&](const std::string& path) {
+      return device.ResolvePath(path);
+    });
+  }
+  std::filesystem::remove(image_path);
+}
+
+}  // namespace xe::vfs::test
@@ -0,0 +1,444 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2024 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "third_party/catch/include/catch.hpp"
+#include "third_party/fmt/include/fmt/format.h"
+
+#include "xenia/base/clock.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/math.h"
+#include "xenia/vfs/devices/stfs_xbox.h"
+#include "xenia/vfs/devices/xcontent_block_cache.h"
+#include "xenia/vfs/devices/xcontent_container_device.h"
+#include "xenia/vfs/devices/xcontent_container_entry.h"
+
+namespace xe::vfs::test {
+
+using namespace xe::literals;
+
+constexpr size_t kStfsBlockSize = 4_KiB;
+constexpr uint32_t kStfsBlocksPerHashTable = 170;
+constexpr uint32_t kStfsEndOfChain = 0xFFFFFF;
+// The header rounded up to the block size.
+constexpr size_t kStfsDataOffset = 0xA000;
+
+// Index of the host block of the level 0 hash table covering a data block in
+// a read-only STFS package (one block per hash table), which has the level 1
+// hash table before the second level 0 one. Only for packages with a single
+// level 1 table.
+static uint32_t StfsHashTableHostBlock(uint32_t block) {
+  uint32_t group = block / kStfsBlocksPerHashTable;
+  return group * (kStfsBlocksPerHashTable + 1) + (group ? 1 : 0);
+}
+
+static uint64_t StfsBlockHostOffset(uint32_t block) {
+  return kStfsDataOffset +
+         (uint64_t(StfsHashTableHostBlock(block)) + 1 +
+          block % kStfsBlocksPerHashTable) *
+             kStfsBlockSize;
+}
+
+static uint8_t FilePattern(size_t file_index, uint64_t offset) {
+  return uint8_t((offset * 31) ^ (offset >> 12) ^ (file_index * 0x5A));
+}
+
+struct StfsTestFile {
+  std::string name;
+  // Chain of the data blocks of the file.
+  std::vector<uint32_t> blocks;
+  uint32_t length;
+};
+
+// Writes a read-only STFS package with the files in the root directory, the
+// data of every file filled with FilePattern.
+static void WriteStfsPackage(const std::filesystem::path& path,
+                             const std::vector<StfsTestFile>& files) {
+  uint32_t block_count = 0;
+  for (const StfsTestFile& file : files) {
+    REQUIRE(file.blocks.size() ==
+            xe::round_up(file.length, uint32_t(kStfsBlockSize)) /
+                kStfsBlockSize);
+    for (uint32_t block : file.blocks) {
+      block_count = std::max(block_count, block + 1);
+    }
+  }
+  uint32_t file_table_block = block_count++;
+  REQUIRE(block_count < kStfsBlocksPerHashTable * kStfsBlocksPerHashTable);
+
+  std::vector<uint8_t> package(StfsBlockHostOffset(block_count - 1) +
+                               kStfsBlockSize);
+  auto hash_entry = [&package](uint32_t block) {
+    auto table = reinterpret_cast<StfsHashTable*>(
+        package.data() + kStfsDataOffset +
+        StfsHashTableHostBlock(block) * kStfsBlockSize);
+    return &table->entries[block % kStfsBlocksPerHashTable];
+  };
+
+  auto header = std::make_unique<XContentContainerHeader>();
+  std::memset(header.get(), 0, sizeof(XContentContainerHeader));
+  header->content_header.magic = XContentPackageType::kCon;
+  header->content_header.header_size = sizeof(XContentContainerHeader);
+  header->content_metadata.volume_type = XContentVolumeType::kStfs;
+  StfsVolumeDescriptor& descriptor =
+      header->content_metadata.volume_descriptor.stfs;
+  descriptor.descriptor_length = sizeof(StfsVolumeDescriptor);
+  descriptor.flags.bits.read_only_format = 1;
+  descriptor.file_table_block_count = 1;
+  descriptor.set_file_table_block_number(file_table_block);
+  descriptor.total_block_count = block_count;
+  std::memcpy(package.data(), header.get(), sizeof(XContentContainerHeader));
+
+  auto directory = reinterpret_cast<StfsDirectoryBlock*>(
+      package.data() + StfsBlockHostOffset(file_table_block));
+  hash_entry(file_table_block)->set_level0_next_block(kStfsEndOfChain);
+  for (size_t i = 0; i < files.size(); ++i) {
+    const StfsTestFile& file = files[i];
+    StfsDirectoryEntry& entry = directory->entries[i];
+    std::memcpy(entry.name, file.name.data(), file.name.size());
+    entry.flags.name_length = uint8_t(file.name.size());
+    entry.set_valid_data_blocks(uint32_t(file.blocks.size()));
+    entry.set_allocated_data_blocks(uint32_t(file.blocks.size()));
+    entry.set_start_block_number(file.blocks.front());
+    entry.directory_index = 0xFFFF;
+    entry.length = file.length;
+    for (size_t j = 0; j < file.blocks.size(); ++j) {
+      hash_entry(file.blocks[j])
+          ->set_level0_next_block(j + 1 < file.blocks.size()
+                                      ? file.blocks[j + 1]
+                                      : kStfsEndOfChain);
+      uint8_t* data = package.data() + StfsBlockHostOffset(file.blocks[j]);
+      for (size_t k = 0; k < kStfsBlockSize; ++k) {
+        data[k] = FilePattern(i, j * kStfsBlockSize + k);
+      }
+    }
+  }
+
+  FILE* file = xe::filesystem::OpenFile(path, "wb");
+  REQUIRE(file);
+  REQUIRE(fwrite(package.data(), 1, package.size(), file) == package.size());
+  fclose(file);
+}
+
+static std::vector<uint32_t> BlockRange(uint32_t first, uint32_t count) {
+  std::vector<uint32_t> blocks(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    blocks[i] = first + i;
+  }
+  return blocks;
+}
+
+class StfsTestPackage {
+ public:
+  explicit StfsTestPackage(const std::vector<StfsTestFile>& files) {
+    path_ = std::filesystem::temp_directory_path() /
+            fmt::format("xenia_xcontent_test_{}.bin",
+                        Clock::QueryHostTickCount());
+    WriteStfsPackage(path_, files);
+  }
+  ~StfsTestPackage() { std::filesystem::remove(path_); }
+
+  const std::filesystem::path& path() const { return path_; }
+
+  std::unique_ptr<XContentContainerDevice> Mount() const {
+    auto device = XContentContainerDevice::CreateContentDevice("\\TEST", path_);
+    REQUIRE(device);
+    auto xcontent_device =
+        std::unique_ptr<XContentContainerDevice>(
+            static_cast<XContentContainerDevice*>(device.release()));
+    REQUIRE(xcontent_device->Initialize());
+    return xcontent_device;
+  }
+
+ private:
+  std::filesystem::path path_;
+};
+
+// A file crossing two hash tables, and a fragmented one with its blocks out of
+// order.
+static const std::vector<StfsTestFile> kTestFiles = {
+    {"Contiguous.bin", BlockRange(0, 400), 400 * kStfsBlockSize - 100},
+    {"Fragmented.bin", {400, 401, 402, 405, 403, 404}, 6 * kStfsBlockSize},
+};
+
+static XContentContainerEntry* ResolveFile(Device& device,
+                                           const std::string_view path) {
+  Entry* entry = device.ResolvePath(path);
+  REQUIRE(entry);
+  return static_cast<XContentContainerEntry*>(entry);
+}
+
+TEST_CASE("XContent container block records", "[xcontent]") {
+  StfsTestPackage package(kTestFiles);
+  auto device = package.Mount();
+
+  SECTION("Contiguous blocks are merged up to the hash tables") {
+    XContentContainerEntry* entry = ResolveFile(*device, "Contiguous.bin");
+    const auto& records = entry->block_list();
+    REQUIRE(records.size() == 3);
+    REQUIRE(records[0].offset == StfsBlockHostOffset(0));
+    REQUIRE(records[0].length == 170 * kStfsBlockSize);
+    REQUIRE(records[1].offset == StfsBlockHostOffset(170));
+    REQUIRE(records[1].length == 170 * kStfsBlockSize);
+    REQUIRE(records[2].offset == StfsBlockHostOffset(340));
+    REQUIRE(records[2].length == 60 * kStfsBlockSize - 100);
+    REQUIRE(entry->block_record_start(1) == 170 * kStfsBlockSize);
+    REQUIRE(entry->block_record_start(2) == 340 * kStfsBlockSize);
+
+    REQUIRE(entry->FindBlockRecord(0) == 0);
+    REQUIRE(entry->FindBlockRecord(170 * kStfsBlockSize - 1) == 0);
+    REQUIRE(entry->FindBlockRecord(170 * kStfsBlockSize) == 1);
+    REQUIRE(entry->FindBlockRecord(entry->size() - 1) == 2);
+    REQUIRE(entry->FindBlockRecord(entry->size()) == records.size());
+  }
+
+  SECTION("Blocks out of order are kept as separate records") {
+    XContentContainerEntry* entry = ResolveFile(*device, "Fragmented.bin");
+    const auto& records = entry->block_list();
+    REQUIRE(records.size() == 3);
+    REQUIRE(records[0].offset == StfsBlockHostOffset(400));
+    REQUIRE(records[0].length == 3 * kStfsBlockSize);
+    REQUIRE(records[1].offset == StfsBlockHostOffset(405));
+    REQUIRE(records[1].length == kStfsBlockSize);
+    REQUIRE(records[2].offset == StfsBlockHostOffset(403));
+    REQUIRE(records[2].length == 2 * kStfsBlockSize);
+
+    REQUIRE(entry->FindBlockRecord(3 * kStfsBlockSize - 1) == 0);
+    REQUIRE(entry->FindBlockRecord(3 * kStfsBlockSize) == 1);
+    REQUIRE(entry->FindBlockRecord(4 * kStfsBlockSize - 1) == 1);
+    REQUIRE(entry->FindBlockRecord(4 * kStfsBlockSize) == 2);
+    REQUIRE(entry->FindBlockRecord(6 * kStfsBlockSize) == records.size());
+  }
+}
+
+static bool DataMatchesPattern(size_t file_index, uint64_t offset,
+                               const uint8_t* data, size_t length) {
+  for (size_t i = 0; i < length; ++i) {
+    if (data[i] != FilePattern(file_index, offset + i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+TEST_CASE("XContent container file reads", "[xcontent]") {
+  StfsTestPackage package(kTestFiles);
+  auto device = package.Mount();
+
+  for (size_t i = 0; i < kTestFiles.size(); ++i) {
+    Entry* entry = ResolveFile(*device, kTestFiles[i].name);
+    File* file = nullptr;
+    REQUIRE(entry->Open(xe::filesystem::FileAccess::kGenericRead, &file) ==
+            X_STATUS_SUCCESS);
+    size_t file_size = entry->size();
+    std::vector<uint8_t> data(file_size + 4_KiB);
+    size_t bytes_read = 0;
+
+    // Whole file, with the request going past the end.
+    REQUIRE(file->ReadSync(data.data(), data.size(), 0, &bytes_read) ==
+            X_STATUS_SUCCESS);
+    REQUIRE(bytes_read == file_size);
+    REQUIRE(DataMatchesPattern(i, 0, data.data(), bytes_read));
+
+    // Unaligned requests crossing the block records.
+    for (size_t offset : {size_t(1), 3 * kStfsBlockSize - 7,
+                          170 * kStfsBlockSize - 1}) {
+      if (offset >= file_size) {
+        continue;
+      }
+      size_t length = std::min(size_t(2 * kStfsBlockSize), file_size - offset);
+      REQUIRE(file->ReadSync(data.data(), length, offset, &bytes_read) ==
+              X_STATUS_SUCCESS);
+      REQUIRE(bytes_read == length);
+      REQUIRE(DataMatchesPattern(i, offset, data.data(), bytes_read));
+    }
+
+    REQUIRE(file->ReadSync(data.data(), 1, file_size, &bytes_read) ==
+            X_STATUS_END_OF_FILE);
+    file->Destroy();
+  }
+}
+
+TEST_CASE("XContent block cache reads", "[xcontent_block_cache]") {
+  StfsTestPackage package(kTestFiles);
+  const auto& blocks = kTestFiles[0].blocks;
+  std::vector<XContentContainerEntry::BlockRecord> extents;
+  {
+    auto device = package.Mount();
+    extents = ResolveFile(*device, kTestFiles[0].name)->block_list();
+  }
+  REQUIRE(extents.size() == 3);
+  FILE* host_file = xe::filesystem::OpenFile(package.path(), "rb");
+  REQUIRE(host_file);
+
+  size_t file_size = kTestFiles[0].length;
+  std::vector<uint8_t> data(blocks.size() * kStfsBlockSize);
+
+  SECTION("Sequential extents") {
+    ContainerBlockCache cache(8_MiB, 4);
+    uint8_t* dest = data.data();
+    for (const auto& extent : extents) {
+      REQUIRE(cache.Read(host_file, 0, extent.offset, dest, extent.length) ==
+              extent.length);
+      dest += extent.length;
+    }
+    REQUIRE(DataMatchesPattern(0, 0, data.data(), file_size));
+    auto statistics = cache.statistics();
+    REQUIRE(statistics.host_bytes_read < data.size() * 2);
+    REQUIRE(statistics.host_reads < extents.size() * 2);
+
+    // Everything is in the cache now.
+    uint64_t host_reads = statistics.host_reads;
+    REQUIRE(cache.Read(host_file, 0, extents[1].offset, data.data(),
+                       extents[1].length) == extents[1].length);
+    REQUIRE(cache.statistics().host_reads == host_reads);
+  }
+
+  SECTION("Small capacity") {
+    // Two lines, less than a single extent.
+    ContainerBlockCache cache(2 * ContainerBlockCache::kLineSize, 4);
+    uint8_t* dest = data.data();
+    for (uint32_t block : blocks) {
+      REQUIRE(cache.Read(host_file, 0, StfsBlockHostOffset(block), dest,
+                         kStfsBlockSize) == kStfsBlockSize);
+      dest += kStfsBlockSize;
+    }
+    REQUIRE(DataMatchesPattern(0, 0, data.data(), file_size));
+  }
+
+  SECTION("Disabled") {
+    ContainerBlockCache cache(0, 4);
+    uint8_t* dest = data.data();
+    for (const auto& extent : extents) {
+      REQUIRE(cache.Read(host_file, 0, extent.offset, dest, extent.length) ==
+              extent.length);
+      dest += extent.length;
+    }
+    REQUIRE(DataMatchesPattern(0, 0, data.data(), file_size));
+    REQUIRE(cache.statistics().host_reads == extents.size());
+  }
+
+  SECTION("End of file") {
+    ContainerBlockCache cache(8_MiB, 4);
+    // The file table block is the last one in the package.
+    uint64_t package_size = std::filesystem::file_size(package.path());
+    uint64_t offset = package_size - kStfsBlockSize;
+    REQUIRE(cache.Read(host_file, 0, offset, data.data(),
+                       kStfsBlockSize + 100) == kStfsBlockSize);
+    REQUIRE(cache.Read(host_file, 0, package_size, data.data(), 100) == 0);
+  }
+
+  fclose(host_file);
+}
+
+// Reads the first range_size bytes of the file passes times.
+static void BenchmarkStfsRead(
+    const char* name, size_t range_size, uint32_t passes, size_t request_size,
+    const std::function<size_t(uint64_t, size_t, uint8_t*)>& read,
+    const std::function<uint64_t()>& host_reads) {
+  std::vector<uint8_t> buffer(request_size);
+  uint64_t host_reads_before = host_reads();
+  auto start = std::chrono::steady_clock::now();
+  size_t total_read = 0;
+  for (uint32_t i = 0; i < passes; ++i) {
+    for (size_t offset = 0; offset < range_size; offset += request_size) {
+      total_read += read(offset, request_size, buffer.data());
+    }
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  REQUIRE(total_read == range_size * passes);
+  double seconds = std::chrono::duration<double>(elapsed).count();
+  fmt::print("{}, {} MiB x {}, {} KiB requests: {:.1f} MB/s, {} host reads\n",
+             name, range_size / 1_MiB, passes, request_size / 1_KiB,
+             double(total_read) / 1e6 / seconds,
+             host_reads() - host_reads_before);
+}
+
+// Not run by default. Run with the "[xcontent_block_cache_benchmark]" tag.
+// The host file is likely to be in the page cache of the OS, so this mostly
+// measures the overhead of the host reads themselves rather than disk access.
+TEST_CASE("XContent streaming throughput",
+          "[.][xcontent_block_cache_benchmark]") {
+  // Within a single level 1 hash table.
+  constexpr size_t kFileSize = 96_MiB;
+  const auto blocks = BlockRange(0, uint32_t(kFileSize / kStfsBlockSize));
+  StfsTestPackage package({{"Stream.bin", blocks, uint32_t(kFileSize)}});
+
+  // How XContentContainerFile used to read: a seek and a read per block.
+  FILE* host_file = xe::filesystem::OpenFile(package.path(), "rb");
+  REQUIRE(host_file);
+  uint64_t per_block_host_reads = 0;
+  auto read_per_block = [&](uint64_t offset, size_t length, uint8_t* dest) {
+    size_t bytes_read = 0;
+    for (size_t i = offset / kStfsBlockSize;
+         bytes_read < length && i < blocks.size(); ++i) {
+      xe::filesystem::Seek(host_file, StfsBlockHostOffset(blocks[i]),
+                           SEEK_SET);
+      bytes_read += fread(dest + bytes_read, 1, kStfsBlockSize, host_file);
+      ++per_block_host_reads;
+    }
+    return bytes_read;
+  };
+  auto per_block_host_read_count = [&]() { return per_block_host_reads; };
+
+  for (size_t request_size : {size_t(4_KiB), size_t(64_KiB), size_t(1_MiB)}) {
+    BenchmarkStfsRead("Per-block reads", kFileSize, 1, request_size,
+                      read_per_block, per_block_host_read_count);
+    // Mounted again for an empty cache.
+    auto device = package.Mount();
+    File* file = nullptr;
+    REQUIRE(ResolveFile(*device, "Stream.bin")
+                ->Open(xe::filesystem::FileAccess::kGenericRead, &file) ==
+            X_STATUS_SUCCESS);
+    BenchmarkStfsRead(
+        "Container file", kFileSize, 1, request_size,
+        [file](uint64_t offset, size_t length, uint8_t* dest) {
+          size_t bytes_read = 0;
+          file->ReadSync(dest, length, size_t(offset), &bytes_read);
+          return bytes_read;
+        },
+        [&device]() { return device->block_cache()->statistics().host_reads; });
+    file->Destroy();
+  }
+  fclose(host_file);
+}
+
+// Not run by default. Run with the "[xcontent_block_cache_benchmark]" tag.
+// Data that is read repeatedly, such as a level being reloaded.
+TEST_CASE("XContent repeated reads", "[.][xcontent_block_cache_benchmark]") {
+  constexpr size_t kFileSize = 16_MiB;
+  StfsTestPackage package(
+      {{"Level.bin", BlockRange(0, uint32_t(kFileSize / kStfsBlockSize)),
+        uint32_t(kFileSize)}});
+  auto device = package.Mount();
+  File* file = nullptr;
+  REQUIRE(ResolveFile(*device, "Level.bin")
+              ->Open(xe::filesystem::FileAccess::kGenericRead, &file) ==
+          X_STATUS_SUCCESS);
+  BenchmarkStfsRead(
+      "Container file", kFileSize, 8, 64_KiB,
+      [file](uint64_t offset, size_t length, uint8_t* dest) {
+        size_t bytes_read = 0;
+        file->ReadSync(dest, length, size_t(offset), &bytes_read);
+        return bytes_read;
+      },
+      [&device]() { return device->block_cache()->statistics().host_reads; });
+  file->Destroy();
+}
+
+}  // namespace xe::vfs::test